@@ -121,6 +121,9 @@ OBJECTS += $(OUTDIR)/mbed_custom.o
 
 OBJECTS += $(OUTDIR)/configdefault.o
 
+# the table of the config keys the modules read, see build/config-keys.sh
+OBJECTS += $(OUTDIR)/configkeys.o
+
 # List of the header dependency files, one per object file.
 DEPFILES = $(patsubst %.o,%.d,$(OBJECTS))
 
@@ -302,6 +305,14 @@ $(OUTDIR)/%.o : %.s makefile
 	$(Q) $(MKDIR) $(call convert-slash,$(dir $@)) $(QUIET)
 	$(Q) $(AS) $(AS_FLAGS) -o $@ $<
 
+$(OUTDIR)/configkeys.cpp : $(CPPSRCS) $(wildcard $(SRC)/*/*.h $(SRC)/*/*/*.h $(SRC)/*/*/*/*.h $(SRC)/*/*/*/*/*.h) $(BUILD_DIR)/config-keys.sh
+	$(Q) $(MKDIR) $(call convert-slash,$(dir $@)) $(QUIET)
+	$(Q) $(BUILD_DIR)/config-keys.sh $(SRC) $@
+
+$(OUTDIR)/configkeys.o : $(OUTDIR)/configkeys.cpp makefile
+	@echo Compiling $<
+	$(Q) $(GPP) $(GPFLAGS) -c $< -o $@
+
 $(OUTDIR)/configdefault.o : config.default
 	$(Q) $(OBJCOPY) -I binary -O elf32-littlearm -B arm --readonly-text --rename-section .data=.rodata.configdefault $< $@
 
@@ -0,0 +1,29 @@
+#!/bin/sh
+# Writes the table of the config key names known to the firmware, the names the sources in $1 pass to CHECKSUM(),
+# as a C++ file to $2. The checksums are worked out here the same way get_checksum() does, and sorted, so
+# ConfigKeys::is_known() is a binary search and the names themselves take no flash
+src=$1
+out=$2
+names() {
+    grep -rhoE "$1" --include='*.cpp' --include='*.h' --exclude-dir=testframework "$src" | sed -e 's/^[^"]*"//' -e 's/"[^"]*$//'
+}
+# a macro of CHECKSUM(X "_suffix") names, like the ones of each actuator in Robot.cpp, is called with each prefix
+prefixes=`names '[A-Z_]+_CHECKSUMS\("[A-Za-z0-9_-]+"\)' | sort -u`
+{
+    names 'CHECKSUM\("[A-Za-z0-9_-]+"\)'
+    for suffix in `names 'CHECKSUM\(X "[A-Za-z0-9_-]+"\)' | sort -u`; do
+        for prefix in $prefixes; do echo "$prefix$suffix"; done
+    done
+} | sort -u |
+    awk 'BEGIN { for(i = 32; i < 127; i++) ord[sprintf("%c", i)] = i }
+        {
+            s1 = 0; s2 = 0
+            for(i = 1; i <= length($0); i++) { s1 = (s1 + ord[substr($0, i, 1)]) % 255; s2 = (s2 + s1) % 255 }
+            print s2 * 256 + s1
+        }' | sort -n -u |
+    awk 'BEGIN { print "// generated by build/config-keys.sh, do not edit"; print "#include \"ConfigKeys.h\"\n"
+                 print "const uint16_t ConfigKeys::keys[]= {" }
+        { printf("    0x%04X,\n", $0); n++ }
+        END { print "};\nconst uint16_t ConfigKeys::count= " n ";" }' > "$out.tmp"
+# only replaced when the names changed, so it is not compiled again every build
+if cmp -s "$out.tmp" "$out"; then rm -f "$out.tmp"; else mv -f "$out.tmp" "$out"; fi
@@ -241,7 +241,41 @@ static int doesHeapCollideWithStack(unsigned int newHeap)
 }
 
 
-/* Optional functionality which will tag each heap allocation with the caller's return address. */
+/* Bytes of heap in use, counting the chunk headers, and the most there has been in use at once. Kept up to date by
+   the malloc wraps below and shown by the mem command. */
+unsigned int g_heapAllocated;
+unsigned int g_heapAllocatedPeak;
+
+static unsigned int *headerForChunk(void *pv);
+static unsigned int sizeOfChunk(void *pv);
+static void countHeapChange(unsigned int freedSize, void *allocated);
+
+static unsigned int *headerForChunk(void *pv)
+{
+    // newlib-nano keeps the chunk size in the word in front of the returned pointer. When the pointer had to be
+    // aligned that word is the negative offset back to the chunk size instead.
+    int *p = (int *)pv - 1;
+    if (*p < 0)
+        p = (int *)((char *)p + *p);
+    return (unsigned int *)p;
+}
+
+static unsigned int sizeOfChunk(void *pv)
+{
+    /* The size includes the header and any alignment padding. */
+    return pv ? *headerForChunk(pv) : 0;
+}
+
+static void countHeapChange(unsigned int freedSize, void *allocated)
+{
+    g_heapAllocated = g_heapAllocated - freedSize + sizeOfChunk(allocated);
+    if (g_heapAllocated > g_heapAllocatedPeak)
+        g_heapAllocatedPeak = g_heapAllocated;
+}
+
+
+/* Optional functionality which will tag each heap allocation with the caller's return address. The tag is the last
+   word of the chunk, 4 extra bytes are allocated so it never overlaps what the caller asked for. */
 #ifdef HEAP_TAGS
 
 const unsigned int *__smoothieHeapBase = &__end__;
@@ -252,9 +286,6 @@ extern "C" void  __real_free(void *ptr);
 
 static void setTag(void *pv, unsigned int tag);
 static unsigned int *footerForChunk(void *pv);
-static unsigned int *headerForChunk(void *pv);
-static unsigned int sizeOfChunk(unsigned int *pHeader);
-static int isChunkInUse(void *pv);
 
 extern "C" __attribute__((naked)) void __wrap_malloc(size_t size)
 {
@@ -269,9 +300,10 @@ extern "C" __attribute__((naked)) void __wrap_malloc(size_t size)
 extern "C" void *mallocWithTag(size_t size, unsigned int tag)
 {
     void *p = __real_malloc(size + sizeof(tag));
-    if (!p && __smoothieHeapBase)
+    if (!p)
         return p;
     setTag(p, tag);
+    countHeapChange(0, p);
     return p;
 }
 
@@ -284,21 +316,7 @@ static void setTag(void *pv, unsigned int tag)
 static unsigned int *footerForChunk(void *pv)
 {
     unsigned int *pHeader = headerForChunk(pv);
-    unsigned int  size = sizeOfChunk(pHeader);
-    return (unsigned int *)(void *)((char *)pHeader + size);
-}
-
-static unsigned int *headerForChunk(void *pv)
-{
-    // Header is allocated two words (8 bytes) before the publicly returned allocation chunk address.
-    unsigned int *p = (unsigned int *)pv;
-    return &p[-2];
-}
-
-static unsigned int sizeOfChunk(unsigned int *pHeader)
-{
-    /* Remove previous chunk in use flag. */
-    return pHeader[1] & ~1;
+    return (unsigned int *)(void *)((char *)pHeader + *pHeader) - 1;
 }
 
 extern "C" __attribute__((naked)) void __wrap_realloc(void *ptr, size_t size)
@@ -313,26 +331,23 @@ extern "C" __attribute__((naked)) void __wrap_realloc(void *ptr, size_t size)
 
 extern "C" void *reallocWithTag(void *ptr, size_t size, unsigned int tag)
 {
+    unsigned int oldSize = sizeOfChunk(ptr);
     void *p = __real_realloc(ptr, size + sizeof(tag));
     if (!p)
         return p;
     setTag(p, tag);
+    countHeapChange(oldSize, p);
     return p;
 }
 
 extern "C" void __wrap_free(void *ptr)
 {
-    if (!isChunkInUse(ptr))
+    if (__get_IPSR() != 0)
         __debugbreak();
+    countHeapChange(sizeOfChunk(ptr), nullptr);
     __real_free(ptr);
 }
 
-static int isChunkInUse(void *pv)
-{
-    unsigned int *pFooter = footerForChunk(pv);
-    return pFooter[1] & 1;
-}
-
 __attribute__((naked)) void *operator new(size_t size)
 {
     __asm (
@@ -363,7 +378,9 @@ extern "C" void *__real_malloc(size_t size);
 extern "C" void *__wrap_malloc(size_t size)
 {
     breakOnHeapOpFromInterruptHandler();
-    return __real_malloc(size);
+    void *p = __real_malloc(size);
+    countHeapChange(0, p);
+    return p;
 }
 
 
@@ -371,7 +388,11 @@ extern "C" void *__real_realloc(void *ptr, size_t size);
 extern "C" void *__wrap_realloc(void *ptr, size_t size)
 {
     breakOnHeapOpFromInterruptHandler();
-    return __real_realloc(ptr, size);
+    unsigned int oldSize = sizeOfChunk(ptr);
+    void *p = __real_realloc(ptr, size);
+    if (p || !size)
+        countHeapChange(oldSize, p);
+    return p;
 }
 
 
@@ -379,6 +400,7 @@ extern "C" void __real_free(void *ptr);
 extern "C" void __wrap_free(void *ptr)
 {
     breakOnHeapOpFromInterruptHandler();
+    countHeapChange(sizeOfChunk(ptr), nullptr);
     __real_free(ptr);
 }
 
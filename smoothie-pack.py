@@ -0,0 +1,111 @@
+#!/usr/bin/env python
+"""\
+Convert a g-code file to packed g-code
+
+Each G or M command whose arguments are all numbers is replaced by a packed line,
+which Smoothie decodes without parsing text. Anything else is copied unchanged.
+The result can be streamed (eg with smoothie-stream.py) or played from the sdcard.
+
+Packed line format (see Gcode::decode_packed):
+  \\x01 followed by the base64 (no padding) of
+    opcode  uint16, bit 15 set for M else G, bits 12-14 subcode, bits 0-11 code
+    nwords  uint8, at most 8
+    words   header byte, bits 0-4 letter - 'A', bits 5-6 value type
+            (0 float, 1 int16 in 1/1000, 2 int24 in 1/1000, 3 int16), then the value
+    crc     uint16, CRC-16/CCITT of all the above
+  all little endian
+"""
+
+from __future__ import print_function
+import sys
+import re
+import struct
+import base64
+import argparse
+
+MAX_WORDS = 8
+
+# these are handled specially by Smoothie and can not be packed
+UNPACKABLE_M = (2, 28, 30, 112, 117, 500, 502, 503, 1000)
+
+word_re = re.compile(r'([A-Z])\s*([-+]?(?:\d+\.?\d*|\.\d+))')
+
+
+def crc16_ccitt(data, crc=0xFFFF):
+    for c in bytearray(data):
+        crc ^= c << 8
+        for i in range(8):
+            crc = ((crc << 1) ^ 0x1021) if (crc & 0x8000) else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def pack_value(letter, text):
+    v = float(text)
+    l = ord(letter) - ord('A')
+    if '.' not in text and -32768 <= v <= 32767:
+        return struct.pack('<Bh', l | (3 << 5), int(v))
+    q = v * 1000.0
+    if abs(q - round(q)) < 1e-6:
+        q = int(round(q))
+        if -32768 <= q <= 32767:
+            return struct.pack('<Bh', l | (1 << 5), q)
+        if -8388608 <= q <= 8388607:
+            return struct.pack('<B', l | (2 << 5)) + struct.pack('<i', q)[0:3]
+    return struct.pack('<Bf', l, v)
+
+
+def pack_line(line):
+    """returns the packed line, or None if it can not be packed"""
+    cmd = line.split(';', 1)[0].split('(', 1)[0].strip().upper()
+    m = re.match(r'([GM])(\d+)(?:\.(\d))?(.*)$', cmd)
+    if not m:
+        return None
+    code = int(m.group(2))
+    subcode = int(m.group(3) or 0)
+    rest = m.group(4)
+    if code > 0xFFF or subcode > 7:
+        return None
+    if m.group(1) == 'G' and code == 53:
+        return None
+    if m.group(1) == 'M' and code in UNPACKABLE_M:
+        return None
+
+    words = word_re.findall(rest)
+    # anything left over (a second command, a filename, ...) means it is not just numeric words
+    if word_re.sub('', rest).strip() or len(words) > MAX_WORDS:
+        return None
+    letters = [w[0] for w in words]
+    if len(set(letters)) != len(letters) or 'G' in letters or 'M' in letters:
+        return None
+
+    op = code | (subcode << 12) | (0x8000 if m.group(1) == 'M' else 0)
+    data = struct.pack('<HB', op, len(words))
+    for letter, text in words:
+        data += pack_value(letter, text)
+    data += struct.pack('<H', crc16_ccitt(data))
+    return '\x01' + base64.b64encode(data).decode('ascii').rstrip('=')
+
+
+parser = argparse.ArgumentParser(description='Convert a g-code file to packed g-code.')
+parser.add_argument('gcode_file', type=argparse.FileType('r'),
+        help='g-code filename to be converted')
+parser.add_argument('output', nargs='?', type=argparse.FileType('w'), default=sys.stdout,
+        help='packed g-code filename, default is stdout')
+args = parser.parse_args()
+
+packed = 0
+total = 0
+for line in args.gcode_file:
+    line = line.rstrip('\r\n')
+    if not line.strip():
+        continue
+    total += 1
+    p = pack_line(line)
+    if p is None:
+        args.output.write(line + '\n')
+    else:
+        args.output.write(p + '\n')
+        packed += 1
+
+print("Packed " + str(packed) + " of " + str(total) + " lines", file=sys.stderr)
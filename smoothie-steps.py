@@ -0,0 +1,100 @@
+#!/usr/bin/env python
+"""\
+Compare the steps recorded by the host simulator, smoothiesim -s file.steps, with a golden recording of the same job
+
+For each motor it reports the steps and where they end up, how far the time of each step moved and where the first one
+that moved is, then the time the job took. Either file may be gzipped. The exit status is 1 when the steps differ, or a
+step moved by more than --tolerance ticks, so it can be used to check a change to the StepTicker, Stepper or Planner.
+"""
+
+from __future__ import print_function
+import sys
+import io
+import gzip
+import struct
+import argparse
+
+MAGIC = b'SMSTEPS1'
+
+def read_steps(fn):
+    with open(fn, 'rb') as f:
+        data = f.read()
+    if data[:2] == b'\x1f\x8b':
+        data = gzip.GzipFile(fileobj=io.BytesIO(data)).read()
+    if data[:8] != MAGIC:
+        sys.exit('%s is not a step recording' % fn)
+    frequency, motors = struct.unpack_from('<IB', data, 8)
+    data = bytearray(data[13:])
+
+    # the ticks and directions each motor stepped at
+    ticks = [[] for _ in range(motors)]
+    dirs = [[] for _ in range(motors)]
+    tick = 0
+    i = 0
+    n = len(data)
+    while i < n:
+        dt = 0
+        shift = 0
+        while True:
+            b = data[i]
+            i += 1
+            dt |= (b & 0x7F) << shift
+            shift += 7
+            if b < 0x80: break
+        tick += dt
+        stepped = data[i]
+        d = data[i + 1]
+        i += 2
+        for m in range(motors):
+            if stepped & (1 << m):
+                ticks[m].append(tick)
+                dirs[m].append((d >> m) & 1)
+    return frequency, ticks, dirs, tick
+
+def position(dirs):
+    # the direction bit is set for the negative direction, as Block::direction_bits
+    return sum(-1 if d else 1 for d in dirs)
+
+parser = argparse.ArgumentParser(description='Compare a step recording with a golden one.')
+parser.add_argument('golden', help='the recording to compare with')
+parser.add_argument('new', help='the recording of the change')
+parser.add_argument('-t', '--tolerance', type=int, default=0,
+        help='the most ticks a step may move by, 0 by default so any change is reported')
+args = parser.parse_args()
+
+gf, gticks, gdirs, gend = read_steps(args.golden)
+nf, nticks, ndirs, nend = read_steps(args.new)
+if gf != nf:
+    sys.exit('the recordings are at different base stepping frequencies, %d and %d' % (gf, nf))
+us = 1e6 / gf
+
+failed = False
+print('%-6s %10s %10s %10s %10s %12s %12s  %s' % ('motor', 'steps', 'new steps', 'position', 'new pos', 'max dev us', 'mean dev us', 'first moved'))
+for m in range(max(len(gticks), len(nticks))):
+    gt = gticks[m] if m < len(gticks) else []
+    nt = nticks[m] if m < len(nticks) else []
+    gd = gdirs[m] if m < len(gdirs) else []
+    nd = ndirs[m] if m < len(ndirs) else []
+    common = min(len(gt), len(nt))
+    worst = 0
+    total = 0
+    first = None
+    for i in range(common):
+        dev = abs(nt[i] - gt[i])
+        if dev > 0 or gd[i] != nd[i]:
+            if first is None: first = i
+            total += dev
+            if dev > worst: worst = dev
+    gp = position(gd)
+    np = position(nd)
+    if len(gt) != len(nt) or gp != np or worst > args.tolerance or (args.tolerance == 0 and first is not None):
+        failed = True
+    where = '-' if first is None else 'step %d at %1.6f s' % (first, gt[first] / float(gf))
+    print('%-6d %10d %10d %10d %10d %12.1f %12.3f  %s' % (m, len(gt), len(nt), gp, np, worst * us,
+          total * us / common if common else 0, where))
+
+gs = gend / float(gf)
+ns = nend / float(nf)
+print('\nJob time: %1.6f s, new %1.6f s (%+1.6f s, %+1.4f%%)' % (gs, ns, ns - gs, 100 * (ns - gs) / gs if gs else 0))
+print('Steps are %s' % ('different' if failed else 'the same' if args.tolerance == 0 else 'within %d ticks' % args.tolerance))
+sys.exit(1 if failed else 0)
@@ -0,0 +1,96 @@
+#!/usr/bin/env python
+"""\
+Decode a telemetry file written by Smoothie with telemetry.enable set
+
+Prints the samples of a session, the last one by default, as CSV with the time in seconds and each channel in its
+units, mm for the actuators, C for the temperatures and targets, or with --summary the range and mean of each channel
+and the gaps where nothing was kept, which is also printed after the CSV when that goes to a file with --output. A
+temperature with no good reading is left empty.
+"""
+
+from __future__ import print_function
+import sys
+import struct
+import argparse
+
+# keep in step with Telemetry::header_t, channel_t and sector_t in src/modules/utils/telemetry/Telemetry.h
+SECTOR = 512
+HEADER = '<4sHHIIfHH'
+CHANNEL = '<14scBf'
+RECORDS = '<IIIHH'
+NO_READING = -32768
+
+parser = argparse.ArgumentParser(description='Decode a Smoothie telemetry file.')
+parser.add_argument('telemetry_file', type=argparse.FileType('rb'),
+        help='the file telemetry.file names, /sd/telemetry.bin by default')
+parser.add_argument('-s','--session', type=int,
+        help='the session to decode, what is left of an earlier boot, the last one by default')
+parser.add_argument('-o','--output', type=argparse.FileType('w'), default=sys.stdout,
+        help='write the CSV to this file')
+parser.add_argument('--summary', action='store_true', default=False,
+        help='only print the summary')
+args = parser.parse_args()
+
+data = args.telemetry_file.read()
+magic, version, record_size, session, sectors, rate, n_channels, _ = struct.unpack_from(HEADER, data, 0)
+if magic != b'SMTL' or version != 1:
+    sys.exit('not a version 1 Smoothie telemetry file')
+
+channels = []
+fmt = '<I'
+for i in range(n_channels):
+    name, kind, _, scale = struct.unpack_from(CHANNEL, data, struct.calcsize(HEADER) + i * struct.calcsize(CHANNEL))
+    channels.append((name.rstrip(b'\0').decode('ascii', 'replace'), kind.decode('ascii'), scale))
+    fmt += kind.decode('ascii')
+if struct.calcsize(fmt) != record_size:
+    sys.exit('the channels do not add up to the %d byte records' % record_size)
+
+if args.session is not None: session = args.session
+
+# the sectors are a ring, the sequence puts them back in order, one written before it filled is there once
+found = {}
+for slot in range(1, min(sectors, len(data) // SECTOR - 1) + 1):
+    base = slot * SECTOR
+    s, sequence, first, records, size = struct.unpack_from(RECORDS, data, base)
+    if s != session or records == 0 or size != record_size: continue
+    if sequence not in found or records > found[sequence][1]: found[sequence] = (base, records)
+
+samples = []
+for sequence in sorted(found):
+    base, records = found[sequence]
+    for r in range(records):
+        samples.append(struct.unpack_from(fmt, data, base + struct.calcsize(RECORDS) + r * record_size))
+
+if not samples:
+    sys.exit('nothing was logged in session %d' % session)
+
+def value(c, v):
+    if channels[c][1] == 'h' and v == NO_READING and channels[c][2] != 1: return None
+    return v * channels[c][2]
+
+if not args.summary:
+    out = args.output
+    out.write(','.join(['time'] + [c[0] for c in channels]) + '\n')
+    for s in samples:
+        vals = [value(c, v) for c, v in enumerate(s[1:])]
+        out.write(','.join(['%1.3f' % (s[0] / float(rate))] + ['' if v is None else '%g' % v for v in vals]) + '\n')
+    if out is sys.stdout: sys.exit(0)
+
+# the sample numbers count every tick, so the ones that were not kept show as gaps
+gaps = []
+for a, b in zip(samples, samples[1:]):
+    if b[0] - a[0] > 1: gaps.append((a[0], b[0]))
+start = samples[0][0] / float(rate)
+end = samples[-1][0] / float(rate)
+print('session %d: %d samples at %g Hz from %1.1f s to %1.1f s after boot, %d gaps, %d of %d sectors used' %
+      (session, len(samples), rate, start, end, len(gaps), len(found), sectors))
+print('%-16s %12s %12s %12s' % ('channel', 'min', 'max', 'mean'))
+for c in range(len(channels)):
+    vals = [v for v in (value(c, s[c + 1]) for s in samples) if v is not None]
+    if not vals:
+        print('%-16s %12s' % (channels[c][0], 'no readings'))
+        continue
+    print('%-16s %12.3f %12.3f %12.3f' % (channels[c][0], min(vals), max(vals), sum(vals) / len(vals)))
+for a, b in gaps[:20]:
+    print('gap of %1.1f s at %1.1f s' % ((b - a) / float(rate), a / float(rate)))
+if len(gaps) > 20: print('and %d more gaps' % (len(gaps) - 20))
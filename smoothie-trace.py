@@ -0,0 +1,106 @@
+#!/usr/bin/env python
+"""\
+Decode an event trace written by Smoothie with get trace dump, or on a halt with trace_halt_file
+
+Prints the records as a timeline, with a summary of the queue depth and the time spent in PendSV and SD reads.
+With --chrome the timeline is also written as a Chrome trace, open it in chrome://tracing or ui.perfetto.dev
+"""
+
+from __future__ import print_function
+import sys
+import struct
+import json
+import argparse
+
+# keep in step with EventTrace::EVENT in src/libs/EventTrace.h
+EVENTS = {1: 'block_begin', 2: 'block_end', 3: 'block_queued', 4: 'line_received', 5: 'sd_read_begin',
+          6: 'sd_read_end', 7: 'usb_rx', 8: 'pendsv_begin', 9: 'pendsv_end', 10: 'halt'}
+ARGS = {1: 'depth', 2: 'depth', 3: 'depth', 4: 'length', 5: 'sectors', 6: 'error', 7: 'bytes'}
+# the ones recorded at both ends of what they time
+SPANS = {'pendsv': (8, 9), 'sd_read': (5, 6)}
+
+# exception numbers of the LPC1768, IRQs are 16 on
+IRQS = ['WDT', 'TIMER0', 'TIMER1', 'TIMER2', 'TIMER3', 'UART0', 'UART1', 'UART2', 'UART3', 'PWM1', 'I2C0', 'I2C1',
+        'I2C2', 'SPI', 'SSP0', 'SSP1', 'PLL0', 'RTC', 'EINT0', 'EINT1', 'EINT2', 'EINT3', 'ADC', 'BOD', 'USB', 'CAN',
+        'DMA', 'I2S', 'ENET', 'RIT', 'MCPWM', 'QEI', 'PLL1', 'USBActivity', 'CANActivity']
+
+def context_name(n):
+    if n == 0: return 'main'
+    if n == 14: return 'PendSV'
+    if n == 15: return 'SysTick'
+    if n >= 16 and n - 16 < len(IRQS): return IRQS[n - 16]
+    return 'exception %d' % n
+
+parser = argparse.ArgumentParser(description='Decode a Smoothie event trace.')
+parser.add_argument('trace_file', type=argparse.FileType('rb'),
+        help='trace file from get trace dump')
+parser.add_argument('-c','--chrome', type=argparse.FileType('w'),
+        help='also write the timeline as a Chrome trace to this file')
+parser.add_argument('-s','--summary', action='store_true', default=False,
+        help='only print the summary')
+args = parser.parse_args()
+
+data = args.trace_file.read()
+magic, version, record_size, core_hz, count = struct.unpack_from('<4sHHII', data, 0)
+if magic != b'SMTR' or version != 1 or record_size != 8:
+    print("not a version 1 Smoothie trace file")
+    sys.exit(1)
+
+# the cycle counter wraps every few tens of seconds, the records are in order so each wrap is added back
+records = []
+last = None
+offset = 0
+for i in range(count):
+    cycles, event, exception, arg = struct.unpack_from('<IBBH', data, 16 + i * 8)
+    if last is not None and cycles < last: offset += 1 << 32
+    last = cycles
+    records.append((cycles + offset, event, exception, arg))
+
+if not records:
+    print("the trace is empty")
+    sys.exit(0)
+
+start = records[0][0]
+to_us = 1e6 / core_hz
+
+if not args.summary:
+    prev = start
+    for cycles, event, exception, arg in records:
+        name = EVENTS.get(event, 'event %d' % event)
+        extra = ' %s=%d' % (ARGS[event], arg) if event in ARGS else ''
+        print('%12.3f ms %+10.1f us  %-8s %s%s' % ((cycles - start) * to_us / 1000, (cycles - prev) * to_us,
+              context_name(exception), name, extra))
+        prev = cycles
+
+# spans are matched within the context they were recorded in, an unmatched begin is still running at the end
+spans = {k: [] for k in SPANS}
+open_spans = {}
+depths = []
+for cycles, event, exception, arg in records:
+    for k, (b, e) in SPANS.items():
+        if event == b: open_spans[(k, exception)] = cycles
+        elif event == e and (k, exception) in open_spans:
+            spans[k].append(cycles - open_spans.pop((k, exception)))
+    if event in (1, 2, 3): depths.append(arg)
+
+print('%d records over %.3f ms at %d MHz' % (len(records), (records[-1][0] - start) * to_us / 1000, core_hz // 1000000))
+if depths:
+    print('queue depth: min %d, avg %.1f, max %d, empty %d times' % (min(depths), float(sum(depths)) / len(depths),
+          max(depths), depths.count(0)))
+for k, d in sorted(spans.items()):
+    if d:
+        print('%s: %d times, avg %.1f us, max %.1f us' % (k, len(d), float(sum(d)) / len(d) * to_us, max(d) * to_us))
+
+if args.chrome:
+    trace = []
+    for cycles, event, exception, arg in records:
+        name = EVENTS.get(event, 'event %d' % event)
+        e = {'name': name, 'ts': (cycles - start) * to_us, 'pid': 0, 'tid': exception, 'ph': 'i', 's': 't'}
+        for k, (b, end) in SPANS.items():
+            if event == b: e.update(name=k, ph='B')
+            elif event == end: e.update(name=k, ph='E')
+        if event in ARGS: e['args'] = {ARGS[event]: arg}
+        trace.append(e)
+    trace += [{'name': 'thread_name', 'ph': 'M', 'pid': 0, 'tid': t, 'args': {'name': context_name(t)}}
+              for t in set(r[2] for r in records)]
+    json.dump({'traceEvents': trace, 'displayTimeUnit': 'ms'}, args.chrome)
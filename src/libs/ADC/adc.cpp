@@ -4,11 +4,14 @@
  */
 #include "mbed.h"
 #include "adc.h"
+#include "CycleProfile.h"
 
 using namespace mbed;
 
 ADC *ADC::instance;
 
+static CycleProfile adc_cycles("ADC");
+
 ADC::ADC(int sample_rate, int cclk_div)
     {
 
@@ -92,7 +95,9 @@ ADC::ADC(int sample_rate, int cclk_div)
 
 void ADC::_adcisr(void)
 {
+    uint32_t t= adc_cycles.begin();
     instance->adcisr();
+    adc_cycles.end(t);
 }
 
 
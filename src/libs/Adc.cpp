@@ -11,7 +11,6 @@
 #include "libs/Pin.h"
 #include "libs/ADC/adc.h"
 #include "libs/Pin.h"
-#include "libs/Median.h"
 
 #include <cstring>
 #include <algorithm>
@@ -25,12 +24,13 @@ Adc *Adc::instance;
 
 static void sample_isr(int chan, uint32_t value)
 {
-    Adc::instance->new_sample(chan, value);
+    Adc::instance->scan_done();
 }
 
 Adc::Adc()
 {
     instance = this;
+    enabled_channels = 0;
     // ADC sample rate need to be fast enough to be able to read the enabled channels within the thermistor poll time
     // even though ther maybe 32 samples we only need one new one within the polling time
     const uint32_t sample_rate= 1000; // 1KHz sample rate
@@ -52,27 +52,69 @@ AD6 P0.3    0-GPIO,     1-RXD0, 2-AD0[6], 3-                6,7 bits of PINSEL0
 AD7 P0.2    0-GPIO,     1-TXD0, 2-AD0[7], 3-                4,5 bits of PINSEL0
 */
 
-// Enables ADC on a given pin
-void Adc::enable_pin(Pin *pin)
+// Enables ADC on a given pin, each sample it keeps is the mean of oversample readings
+void Adc::enable_pin(Pin *pin, int oversample)
 {
     PinName pin_name = this->_pin_to_pinname(pin);
     int channel = adc->_pin_to_channel(pin_name);
+    if(channel >= num_channels) return;
     memset(sample_buffers[channel], 0, sizeof(sample_buffers[0]));
+    memset(sorted_buffers[channel], 0, sizeof(sorted_buffers[0]));
+    sample_pos[channel] = 0;
+    accumulators[channel] = 0;
+    accumulated[channel] = 0;
+    this->oversample[channel] = oversample < 1 ? 1 : oversample > max_oversample ? max_oversample : oversample;
 
     this->adc->burst(1);
     this->adc->setup(pin_name, 1);
-    this->adc->interrupt_state(pin_name, 1);
+
+    // burst mode converts the enabled channels lowest first, so only the last one needs to interrupt and the
+    // others are read with it, that is one interrupt per scan rather than one per channel
+    __disable_irq();
+    enabled_channels |= 1 << channel;
+    __enable_irq();
+    LPC_ADC->ADINTEN = 1 << (31 - __builtin_clz(enabled_channels));
+    NVIC_EnableIRQ(ADC_IRQn);
+}
+
+// every enabled channel has a new reading when the last one in the scan is done
+void Adc::scan_done()
+{
+    for (int chan = 0; chan < num_channels; chan++) {
+        if(enabled_channels & (1 << chan)) new_sample(chan, (&LPC_ADC->ADDR0)[chan]);
+    }
 }
 
-// Keeps the last 8 values for each channel
+// Adds up oversample readings and keeps their mean, at the full resolution, as one sample
 // This is called in an ISR, so sample_buffers needs to be accessed atomically
 void Adc::new_sample(int chan, uint32_t value)
 {
-    // Shuffle down and add new value to the end
-    if(chan < num_channels) {
-        memmove(&sample_buffers[chan][0], &sample_buffers[chan][1], sizeof(sample_buffers[0]) - sizeof(sample_buffers[0][0]));
-        sample_buffers[chan][num_samples - 1] = (value >> 4) & 0xFFF; // the 12 bit ADC reading
+    accumulators[chan] += (value >> 4) & 0xFFF; // the 12 bit ADC reading
+    if(++accumulated[chan] < oversample[chan]) return;
+
+    uint16_t v = (accumulators[chan] << OVERSAMPLE) / accumulated[chan];
+    accumulators[chan] = 0;
+    accumulated[chan] = 0;
+    add_sample(chan, v);
+}
+
+// Keeps the last num_samples values for each channel
+void Adc::add_sample(int chan, uint16_t v)
+{
+    // replace the oldest reading
+    uint16_t old = sample_buffers[chan][sample_pos[chan]];
+    sample_buffers[chan][sample_pos[chan]] = v;
+    if(++sample_pos[chan] >= num_samples) sample_pos[chan] = 0;
+
+    // and move the new one from where the oldest was in the sorted readings to where it goes
+    uint16_t *s = sorted_buffers[chan];
+    int i = std::lower_bound(s, s + num_samples, old) - s;
+    if(v > old) {
+        for (; i < num_samples - 1 && s[i + 1] < v; i++) s[i] = s[i + 1];
+    } else {
+        for (; i > 0 && s[i - 1] > v; i--) s[i] = s[i - 1];
     }
+    s[i] = v;
 }
 
 //#define USE_MEDIAN_FILTER
@@ -81,43 +123,28 @@ unsigned int Adc::read(Pin *pin)
 {
     PinName p = this->_pin_to_pinname(pin);
     int channel = adc->_pin_to_channel(p);
+    if(channel >= num_channels) return 0;
 
-    uint16_t median_buffer[num_samples];
+    // the samples are already sorted, only the middle half is needed
     // needs atomic access TODO maybe be able to use std::atomic here or some lockless mutex
+    const uint16_t *sorted = sorted_buffers[channel];
+    uint32_t sum = 0;
     __disable_irq();
-    memcpy(median_buffer, sample_buffers[channel], sizeof(median_buffer));
-    __enable_irq();
-
 #ifdef USE_MEDIAN_FILTER
-    // returns the median value of the last 8 samples
-    return median_buffer[quick_median(median_buffer, num_samples)];
-
-#elif defined(OVERSAMPLE)
-    // Oversample to get 2 extra bits of resolution
-    // weed out top and bottom worst values then oversample the rest
-    // put into a 4 element moving average and return the average of the last 4 oversampled readings
-    static uint16_t ave_buf[num_channels][4] =  { {0} };
-    std::sort(median_buffer, median_buffer + num_samples);
-    uint32_t sum = 0;
-    for (int i = num_samples / 4; i < (num_samples - (num_samples / 4)); ++i) {
-        sum += median_buffer[i];
-    }
-    // this slows down the rate of change a little bit
-    ave_buf[channel][3]= ave_buf[channel][2];
-    ave_buf[channel][2]= ave_buf[channel][1];
-    ave_buf[channel][1]= ave_buf[channel][0];
-    ave_buf[channel][0]= sum >> OVERSAMPLE;
-    return roundf((ave_buf[channel][0]+ave_buf[channel][1]+ave_buf[channel][2]+ave_buf[channel][3])/4.0F);
-
+    sum = sorted[num_samples / 2];
 #else
-    // sort the 8 readings and return the average of the middle 4
-    std::sort(median_buffer, median_buffer + num_samples);
-    int sum = 0;
     for (int i = num_samples / 4; i < (num_samples - (num_samples / 4)); ++i) {
-        sum += median_buffer[i];
+        sum += sorted[i];
     }
-    return sum / (num_samples / 2);
+#endif
+    __enable_irq();
 
+#ifdef USE_MEDIAN_FILTER
+    // returns the median value of the last samples
+    return sum;
+#else
+    // the mean of the middle 4 of the 8 samples, rounded
+    return (sum + num_samples / 4) / (num_samples / 2);
 #endif
 }
 
@@ -19,39 +19,45 @@ namespace mbed {
     class ADC;
 }
 
-// define how many bits of extra resolution required
-// 2 bits means the 12bit ADC is 14 bits of resolution
-#define OVERSAMPLE 2
+// how many bits of extra resolution the readings are scaled to, 4 bits means the 12bit ADC reads as 16 bits. The
+// resolution is really there when enough readings are averaged for each sample, oversample of 4^n gives n more bits
+#define OVERSAMPLE 4
 
 class Adc
 {
 public:
     Adc();
-    void enable_pin(Pin *pin);
+    void enable_pin(Pin *pin, int oversample= default_oversample);
     unsigned int read(Pin *pin);
 
     static Adc *instance;
+    void scan_done();
     void new_sample(int chan, uint32_t value);
     // return the maximum ADC value, base is 12bits 4095.
-#ifdef OVERSAMPLE
     int get_max_value() const { return 4095 << OVERSAMPLE;}
-#else
-    int get_max_value() const { return 4095;}
-#endif
+
+    static const int default_oversample= 4;
+    static const int max_oversample= 64;
 
 private:
     PinName _pin_to_pinname(Pin *pin);
     mbed::ADC *adc;
 
     static const int num_channels= 6;
-#ifdef OVERSAMPLE
-    // we need 4^n sample to oversample and we get double that to filter out spikes
-    static const int num_samples= powf(4, OVERSAMPLE)*2;
-#else
+    // each sample is the mean of oversample readings, decimated in the interrupt, and a read takes the mean of the
+    // middle half of the last num_samples of them, so a spike only spoils the sample it falls in
     static const int num_samples= 8;
-#endif
-    // buffers storing the last num_samples readings for each channel
+    // the last num_samples samples for each channel in the order they came, and the same samples kept sorted
+    // as they come in so a read does not have to sort them
     uint16_t sample_buffers[num_channels][num_samples];
+    uint16_t sorted_buffers[num_channels][num_samples];
+    uint32_t accumulators[num_channels];
+    uint8_t accumulated[num_channels];
+    uint8_t oversample[num_channels];
+    uint8_t sample_pos[num_channels];
+    uint8_t enabled_channels;
+
+    void add_sample(int chan, uint16_t v);
 };
 
 #endif
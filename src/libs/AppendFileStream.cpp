@@ -1,12 +1,90 @@
 #include "AppendFileStream.h"
+#include "us_ticker_api.h"
 #include <stdio.h>
 
-int AppendFileStream::puts(const char *str)
+AppendFileStream *AppendFileStream::buffered= nullptr;
+volatile bool AppendFileStream::flush_pending= false;
+
+AppendFileStream::AppendFileStream(const char *filename, size_t buffer_size, uint32_t flush_ms)
+{
+    fn= strdup(filename);
+    buf= (buffer_size > 0) ? (char *)malloc(buffer_size) : nullptr;
+    size= (buf != nullptr) ? buffer_size : 0;
+    used= 0;
+    this->flush_ms= flush_ms;
+    first_us= 0;
+    next= nullptr;
+    if(buf != nullptr) {
+        next= buffered;
+        buffered= this;
+    }
+}
+
+AppendFileStream::~AppendFileStream()
+{
+    if(buf != nullptr) {
+        flush();
+        for (AppendFileStream **p = &buffered; *p != nullptr; p = &(*p)->next) {
+            if(*p == this) {
+                *p= next;
+                break;
+            }
+        }
+        free(buf);
+    }
+    free(fn);
+}
+
+int AppendFileStream::write(const char *str, size_t n)
 {
     FILE *fd= fopen(this->fn, "a");
     if(fd == NULL) return 0;
 
-    int n= fwrite(str, 1, strlen(str), fd);
+    n= fwrite(str, 1, n, fd);
     fclose(fd);
     return n;
 }
+
+int AppendFileStream::puts(const char *str)
+{
+    size_t n= strlen(str);
+    if(buf == nullptr) return write(str, n);
+
+    if(used + n > size) flush();
+    if(n >= size) return write(str, n);
+
+    if(used == 0) first_us= us_ticker_read();
+    memcpy(buf + used, str, n);
+    used += n;
+    return n;
+}
+
+// write out what is held, closing the file updates its size on the card
+void AppendFileStream::flush()
+{
+    if(used == 0) return;
+    write(buf, used);
+    used= 0;
+}
+
+void AppendFileStream::poll_all()
+{
+    bool all= flush_pending;
+    flush_pending= false;
+    uint32_t now= us_ticker_read();
+    for (AppendFileStream *s = buffered; s != nullptr; s = s->next) {
+        if(s->used > 0 && (all || now - s->first_us >= s->flush_ms * 1000UL)) s->flush();
+    }
+}
+
+void AppendFileStream::flush_all(bool now)
+{
+    if(!now) {
+        // the file system can't be used from an interrupt
+        flush_pending= true;
+        return;
+    }
+    for (AppendFileStream *s = buffered; s != nullptr; s = s->next) {
+        s->flush();
+    }
+}
@@ -4,15 +4,37 @@
 #include "StreamOutput.h"
 #include "string.h"
 #include "stdlib.h"
+#include <stdint.h>
 
+// Appends what is written to it to a file. Without a buffer every puts opens, writes and closes the file. With one the
+// output is held in RAM and written with one open and close when the buffer is full, flush_ms after the oldest output
+// still held, on halt, and when the stream is deleted.
 class AppendFileStream : public StreamOutput {
     public:
-        AppendFileStream(const char *filename) { fn= strdup(filename); }
-        virtual ~AppendFileStream(){ free(fn); }
+        AppendFileStream(const char *filename, size_t buffer_size= 0, uint32_t flush_ms= 1000);
+        virtual ~AppendFileStream();
         int puts(const char*);
+        void flush();
+
+        // called from the main loop to write out the buffers that are due
+        static void poll_all();
+        // writes out every buffer now, or from the next poll_all when called from an interrupt
+        static void flush_all(bool now);
 
     private:
+        int write(const char *str, size_t n);
+
         char *fn;
+        char *buf;
+        size_t size;
+        size_t used;
+        uint32_t flush_ms;
+        uint32_t first_us;                  // when the oldest output still held was written
+
+        // the streams that have a buffer
+        AppendFileStream *next;
+        static AppendFileStream *buffered;
+        static volatile bool flush_pending;
 };
 
 #endif
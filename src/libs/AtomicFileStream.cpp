@@ -0,0 +1,74 @@
+#include "AtomicFileStream.h"
+#include <stdio.h>
+#include <string.h>
+
+AtomicFileStream::AtomicFileStream(const char *filename, size_t limit) : fn(filename), fd(NULL), limit(limit), failed(false)
+{
+    buf.reserve(limit > 0 ? limit : 1024);
+}
+
+// a file that was not committed is left as it was
+AtomicFileStream::~AtomicFileStream()
+{
+    if(fd != NULL) {
+        fclose(fd);
+        remove((fn + ".tmp").c_str());
+    }
+}
+
+int AtomicFileStream::puts(const char *str)
+{
+    return write(str, strlen(str));
+}
+
+int AtomicFileStream::write(const char *str, size_t n)
+{
+    buf.append(str, n);
+    if(limit > 0 && buf.size() >= limit) flush();
+    return n;
+}
+
+void AtomicFileStream::flush()
+{
+    if(fd == NULL && !failed) {
+        fd= fopen((fn + ".tmp").c_str(), "w");
+        failed= (fd == NULL);
+    }
+    if(!failed && fwrite(buf.data(), 1, buf.size(), fd) != buf.size()) failed= true;
+    buf.clear();
+}
+
+// returns false and leaves the file as it was if the temp file could not be written in full
+bool AtomicFileStream::commit()
+{
+    std::string tmp= fn + ".tmp";
+    flush();
+    bool ok= !failed;
+    if(fd != NULL && fclose(fd) != 0) ok= false;
+    fd= NULL;
+    if(!ok) {
+        remove(tmp.c_str());
+        return false;
+    }
+
+    remove(fn.c_str());
+    return rename(tmp.c_str(), fn.c_str()) == 0;
+}
+
+// called at boot before the file is read
+void AtomicFileStream::recover(const char *filename)
+{
+    std::string tmp= std::string(filename) + ".tmp";
+    FILE *fd= fopen(tmp.c_str(), "r");
+    if(fd == NULL) return;
+    fclose(fd);
+
+    fd= fopen(filename, "r");
+    if(fd != NULL) {
+        // the old file is only removed once the temp file is complete
+        fclose(fd);
+        remove(tmp.c_str());
+    }else{
+        rename(tmp.c_str(), filename);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef _ATOMICFILESTREAM_H_
+#define _ATOMICFILESTREAM_H_
+
+#include "StreamOutput.h"
+#include <string>
+#include <stdio.h>
+
+// Holds everything written to it in RAM, commit() then writes it in one pass to filename.tmp and renames that over
+// the file. FAT can't rename onto a file that exists so the old one is removed first, recover() finishes a commit that
+// power was lost in the middle of, or drops a temp file that was not completely written. With a limit only that much
+// is held, the rest goes on to the temp file as it comes, for a file too big to hold
+class AtomicFileStream : public StreamOutput {
+    public:
+        AtomicFileStream(const char *filename, size_t limit= 0);
+        virtual ~AtomicFileStream();
+        int puts(const char*);
+        int write(const char *buf, size_t n);
+        bool commit();
+
+        static void recover(const char *filename);
+
+    private:
+        void flush();
+
+        std::string fn;
+        std::string buf;
+        FILE *fd;
+        size_t limit;
+        bool failed;
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include <stdlib.h>
 #include "ff.h"
 #include "FATFileSystem.h"
+#include "platform_memory.h"
 
 namespace mbed {
 
@@ -32,11 +33,47 @@ static const char *FR_ERRORS[] = {
 
 FATFileHandle::FATFileHandle(FIL_t fh) {
     _fh = fh;
+    // fast seek can not extend a file, so only read only files get a map, eg the ones being played
+    if(!(_fh.flag & FA_WRITE) && _fh.fsize >= link_map_min_size) {
+        create_link_map();
+    }
 }
-    
+
+// the map has two words for each contiguous run of clusters, so it is small unless the file is badly fragmented
+bool FATFileHandle::create_link_map() {
+    DWORD n = 32;
+    for(int tries = 0; tries < 2; tries++) {
+        DWORD *tbl = (DWORD *)AHB0.alloc(n * sizeof(DWORD));
+        if(tbl == NULL) tbl = (DWORD *)malloc(n * sizeof(DWORD));
+        if(tbl == NULL) return false;
+
+        tbl[0] = n;
+        _fh.cltbl = tbl;
+        FRESULT res = f_lseek(&_fh, CREATE_LINKMAP);
+        if(res == FR_OK) {
+            FFSDEBUG("link map of %lu words\n", tbl[0]);
+            return true;
+        }
+
+        // the first word is now the size that is needed
+        n = tbl[0];
+        free_link_map();
+        if(res != FR_NOT_ENOUGH_CORE) return false;
+    }
+    return false;
+}
+
+void FATFileHandle::free_link_map() {
+    if(_fh.cltbl == NULL) return;
+    if(AHB0.has(_fh.cltbl)) AHB0.dealloc(_fh.cltbl);
+    else free(_fh.cltbl);
+    _fh.cltbl = NULL;
+}
+
 int FATFileHandle::close() {
     FFSDEBUG("close\n");
     int retval = f_close(&_fh);
+    free_link_map();
     delete this;
     return retval;
 }
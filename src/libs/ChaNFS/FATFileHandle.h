@@ -24,6 +24,11 @@ public:
 
 protected:
 
+    // files opened read only and at least this big get a cluster link map, so seeking does not follow the FAT chain
+    static const DWORD link_map_min_size = 256 * 1024;
+    bool create_link_map();
+    void free_link_map();
+
     FIL_t _fh;
 
 };
@@ -52,6 +52,16 @@ public:
     virtual int disk_status() { return 0; }
     virtual int disk_read(char *buffer, int sector) = 0;
     virtual int disk_write(const char *buffer, int sector) = 0;
+    virtual int disk_read_multi(char *buffer, int sector, int count) {
+        for (int i = 0; i < count; i++, buffer += 512)
+            if (int r = disk_read(buffer, sector + i)) return r;
+        return 0;
+    }
+    virtual int disk_write_multi(const char *buffer, int sector, int count) {
+        for (int i = 0; i < count; i++, buffer += 512)
+            if (int r = disk_write(buffer, sector + i)) return r;
+        return 0;
+    }
     virtual int disk_sync() { return 0; }
     virtual int disk_sectors() = 0;
 
@@ -20,16 +20,30 @@ using namespace std;
 #include "libs/ConfigSources/FileConfigSource.h"
 #include "libs/ConfigSources/FirmConfigSource.h"
 #include "StreamOutputPool.h"
+#include "ConfigSnapshot.h"
+#include "AtomicFileStream.h"
+
+#include <stdio.h>
+
+#define config_snapshot_checksum CHECKSUM("config_snapshot")
+#define config_snapshot_file     "/sd/config-snapshot"
 
 // Add various config sources. Config can be fetched from several places.
 // All values are read into a cache, that is then used by modules to read their configuration
 Config::Config()
 {
     this->config_cache = NULL;
+    this->saved_bytes = 0;
 
     // Config source for firm config found in src/config.default
     this->config_sources.push_back( new FirmConfigSource("firm") );
 
+    // a config-set that rewrote the file and was cut short leaves the old or the new one, never half of it
+    AtomicFileStream::recover("/local/config");
+    AtomicFileStream::recover("/local/config.txt");
+    AtomicFileStream::recover("/sd/config");
+    AtomicFileStream::recover("/sd/config.txt");
+
     // Config source for */config files
     FileConfigSource *fcs = NULL;
     if( file_exists("/local/config") )
@@ -51,6 +65,7 @@ Config::Config()
 Config::Config(ConfigSource *cs)
 {
     this->config_cache = NULL;
+    this->saved_bytes = 0;
     this->config_sources.push_back( cs );
 }
 
@@ -76,11 +91,40 @@ void Config::config_cache_load(bool parse)
 
     this->config_cache= new ConfigCache;
     if(parse) {
-        // For each ConfigSource in our stack
-        for( ConfigSource *source : this->config_sources ) {
-            source->transfer_values_to_cache(this->config_cache);
+        // a snapshot of an earlier parse is used as long as none of the config files changed
+        bool snapshot= ConfigSnapshot::load(this->config_cache, this->config_sources, config_snapshot_file);
+        if(!snapshot) {
+            // For each ConfigSource in our stack
+            for( ConfigSource *source : this->config_sources ) {
+                source->transfer_values_to_cache(this->config_cache);
+            }
         }
+        // modules look up hundreds of values while loading
+        this->config_cache->build_index();
+        this->saved_bytes= this->config_cache->saved_bytes();
+
+        if(!snapshot) {
+            // an out of date snapshot is removed, and replaced if they are enabled
+            remove(config_snapshot_file);
+            if(value(config_snapshot_checksum)->by_default(false)->as_bool()) {
+                ConfigSnapshot::save(this->config_cache, this->config_sources, config_snapshot_file);
+            }
+        }
+    }
+}
+
+// Only the settings of one family, like temperature_control, so a module can read its settings again without all of
+// the config taking up the heap
+void Config::config_cache_load_family(uint16_t family)
+{
+    this->config_cache_clear();
+
+    this->config_cache= new ConfigCache;
+    this->config_cache->set_family(family);
+    for( ConfigSource *source : this->config_sources ) {
+        source->transfer_values_to_cache(this->config_cache);
     }
+    this->config_cache->build_index();
 }
 
 // Command to clear the config cache after init
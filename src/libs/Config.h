@@ -17,6 +17,13 @@ class ConfigValue;
 class ConfigSource;
 class ConfigCache;
 
+// passed with ON_CONFIG_CHANGED, the module a changed setting is for reads it again if it can and counts itself in applied
+struct ConfigChange {
+    uint16_t check_sums[3];
+    uint8_t applied;
+    bool is_for(uint16_t family, uint16_t name) const { return check_sums[0] == family && check_sums[1] == name; }
+};
+
 class Config  {
     public:
         Config();
@@ -25,6 +32,7 @@ class Config  {
 
         void config_cache_load(bool parse= true);
         void config_cache_clear();
+        void config_cache_load_family(uint16_t family);
         void set_string( string setting , string value);
 
         ConfigValue* value(uint16_t check_sum_a, uint16_t check_sum_b= 0, uint16_t check_sum_c= 0 );
@@ -32,6 +40,7 @@ class Config  {
 
         void get_module_list(vector<uint16_t>* list, uint16_t family);
         bool is_config_cache_loaded() { return config_cache != NULL; };    // Whether or not the cache is currently popluated
+        int get_saved_bytes() const { return saved_bytes; }                // heap the last loaded cache saved by packing its values
 
         friend class  Configurator;
 
@@ -40,6 +49,7 @@ class Config  {
 
         ConfigCache* config_cache;            // A cache in which ConfigValues are kept
         vector<ConfigSource*> config_sources; // A list of all possible coniguration sources
+        int saved_bytes;
 };
 
 #endif
@@ -1,9 +1,15 @@
 #include "ConfigCache.h"
 #include "ConfigValue.h"
+#include "checksumm.h"
 
 #include "libs/StreamOutput.h"
 
-ConfigCache::ConfigCache()
+#include <algorithm>
+#include <string.h>
+
+const uint16_t ConfigCache::include_checksum= CHECKSUM("include");
+
+ConfigCache::ConfigCache() : family(0), block_used(block_size), string_heap(0), block_heap(0)
 {
 }
 
@@ -19,11 +25,58 @@ void ConfigCache::clear()
     }
     store.clear();
     storage_t().swap(store);   //  makes sure the vector releases its memory
+    storage_t().swap(index);
+    vector<string>().swap(files);
+    for(auto b : blocks) {
+        delete [] b;
+    }
+    vector<char*>().swap(blocks);
+    block_used= block_size;
+    string_heap= block_heap= 0;
+}
+
+// newlib malloc rounds to 8 bytes with a 4 byte header, a std::string adds a 12 byte header to the characters
+static int heap_used(size_t n)
+{
+    return (n + 4 + 7) & ~7;
+}
+
+const char *ConfigCache::intern(const char *s, size_t n)
+{
+    char *p;
+    if(n + 1 > block_size) {
+        // too long to share a block, goes in front of the block being filled
+        p= new char[n + 1];
+        blocks.insert(blocks.end() - (blocks.empty() ? 0 : 1), p);
+        block_heap += heap_used(n + 1);
+
+    } else {
+        if(block_used + n + 1 > block_size) {
+            blocks.push_back(new char[block_size]);
+            block_used= 0;
+            block_heap += heap_used(block_size);
+        }
+        p= blocks.back() + block_used;
+        block_used += n + 1;
+    }
+
+    memcpy(p, s, n);
+    p[n]= '\0';
+    string_heap += heap_used(n + 1 + 12);
+    return p;
+}
+
+bool ConfigCache::by_checksums(const ConfigValue *a, const ConfigValue *b)
+{
+    return key(a->check_sums) < key(b->check_sums);
 }
 
 void ConfigCache::add(ConfigValue *v)
 {
     store.push_back(v);
+    if(!index.empty()) {
+        index.insert(std::upper_bound(index.begin(), index.end(), v, by_checksums), v);
+    }
 }
 
 // If we find an existing value, replace it, otherwise, push it at the back of the list
@@ -34,6 +87,11 @@ void ConfigCache::replace_or_push_back(ConfigValue *new_value)
         // If this configvalue matches the checksum
         if(memcmp(new_value->check_sums, cv->check_sums, sizeof(cv->check_sums)) == 0) {
             // Replace with the provided value
+            if(is_indexed()) {
+                auto i= std::lower_bound(index.begin(), index.end(), cv, by_checksums);
+                *i= new_value;
+            }
+            delete cv;
             cv =  new_value;
             printf("WARNING: duplicate config line replaced\n");
             return;
@@ -41,11 +99,31 @@ void ConfigCache::replace_or_push_back(ConfigValue *new_value)
     }
 
     // Value does not already exists, add to the list
-    store.push_back(new_value);
+    add(new_value);
+}
+
+void ConfigCache::build_index()
+{
+    index= store;
+    std::stable_sort(index.begin(), index.end(), by_checksums);
+}
+
+// binary search the index, returns index.end() if it is not there
+ConfigCache::storage_t::const_iterator ConfigCache::find(const uint16_t *check_sums) const
+{
+    uint64_t k= key(check_sums);
+    auto i= std::lower_bound(index.begin(), index.end(), k, [](const ConfigValue *a, uint64_t k) { return key(a->check_sums) < k; });
+    if(i != index.end() && key((*i)->check_sums) != k) return index.end();
+    return i;
 }
 
 ConfigValue *ConfigCache::lookup(const uint16_t *check_sums) const
 {
+    if(is_indexed()) {
+        auto i= find(check_sums);
+        return i == index.end() ? NULL : *i;
+    }
+
     for( auto &cv : store) {
         if(memcmp(check_sums, cv->check_sums, sizeof(cv->check_sums)) == 0)
             return cv;
@@ -70,6 +148,6 @@ void ConfigCache::dump(StreamOutput *stream)
     for( auto &kv : store ) {
         ConfigValue *v = kv;
         stream->printf("%3d - %04X %04X %04X : '%s' - found: %d, default: %d, default-double: %f, default-int: %d\n",
-                       l++, v->check_sums[0], v->check_sums[1], v->check_sums[2], v->value.c_str(), v->found, v->default_set, v->default_double, v->default_int );
+                       l++, v->check_sums[0], v->check_sums[1], v->check_sums[2], v->value, v->found, v->default_set, v->default_double, v->default_int );
     }
 }
@@ -12,6 +12,7 @@ using namespace std;
 #include <vector>
 #include <stdint.h>
 #include <map>
+#include <string>
 
 class ConfigValue;
 class StreamOutput;
@@ -24,6 +25,18 @@ class ConfigCache {
 
         void add(ConfigValue* v);
 
+        // only keep the values of this family, and the includes that may have them, 0 keeps all of them
+        void set_family(uint16_t f) { family= f; }
+        bool wants(const uint16_t *check_sums) const { return family == 0 || check_sums[0] == family || check_sums[0] == include_checksum; }
+        // the keys no module reads are reported once, while all of the config is loaded
+        bool reports_unknown() const { return family == 0; }
+
+        // copy a value into the cache, values are packed into a few blocks instead of a heap allocation each
+        const char *intern(const char *s, size_t n);
+
+        // heap the values would have used as a string each, minus what the blocks use
+        int saved_bytes() const { return string_heap - block_heap; }
+
         // lookup and return the entru that matches the check sums,return NULL if not found
         ConfigValue *lookup(const uint16_t *check_sums) const;
 
@@ -33,12 +46,35 @@ class ConfigCache {
         // If we find an existing value, replace it, otherwise, push it at the back of the list
         void replace_or_push_back(ConfigValue* new_value);
 
+        // sort an index of the entries by checksum so lookup can do a binary search, called once all sources are loaded
+        void build_index();
+
         // used for debugging, dumps the cache to a stream
         void dump(StreamOutput *stream);
 
+        // remember a file the values were read from, ConfigSnapshot checks none of them changed
+        void add_file(const char *filename) { files.push_back(filename); }
+
+        friend class ConfigSnapshot;
+
     private:
         typedef vector<ConfigValue*> storage_t;
-        storage_t store;
+        static uint64_t key(const uint16_t *check_sums) { return ((uint64_t)check_sums[0] << 32) | ((uint32_t)check_sums[1] << 16) | check_sums[2]; }
+        static bool by_checksums(const ConfigValue *a, const ConfigValue *b);
+        storage_t::const_iterator find(const uint16_t *check_sums) const;
+        bool is_indexed() const { return !index.empty() && index.size() == store.size(); }
+
+        storage_t store;  // in the order the values were read, modules are found in this order
+        storage_t index;  // the same values sorted by their checksums, empty until build_index()
+        vector<string> files;
+        uint16_t family;
+        static const uint16_t include_checksum;
+
+        static const size_t block_size= 512;
+        vector<char*> blocks;
+        size_t block_used;
+        int string_heap;
+        int block_heap;
 };
 
 
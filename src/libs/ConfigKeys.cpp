@@ -0,0 +1,21 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ConfigKeys.h"
+
+#include <algorithm>
+
+bool ConfigKeys::is_known(uint16_t check_sum)
+{
+    return std::binary_search(keys, keys + count, check_sum);
+}
+
+bool ConfigKeys::is_known(const uint16_t check_sums[3], int nodes)
+{
+    if(nodes <= 1) return is_known(check_sums[0]);
+    return is_known(check_sums[0]) && is_known(check_sums[nodes - 1]);
+}
@@ -0,0 +1,27 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONFIGKEYS_H
+#define CONFIGKEYS_H
+
+#include <stdint.h>
+
+// The checksums of every name a module looks up in the config, so a key in the config file no module reads, mostly a
+// typo, can be reported while it is parsed. The table is generated at build time by build/config-keys.sh
+class ConfigKeys {
+    public:
+        static bool is_known(uint16_t check_sum);
+
+        // the family and the setting have to be known, the middle of a three part key is the name of a module instance
+        static bool is_known(const uint16_t check_sums[3], int nodes);
+
+    private:
+        static const uint16_t keys[];
+        static const uint16_t count;
+};
+
+#endif
@@ -0,0 +1,133 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ConfigSnapshot.h"
+#include "ConfigCache.h"
+#include "ConfigValue.h"
+#include "ConfigSource.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+using std::string;
+
+const char ConfigSnapshot::magic[4]{'S', 'C', 'S', '1'};
+
+uint32_t ConfigSnapshot::sources_hash(const std::vector<ConfigSource*> &sources)
+{
+    uint32_t h= fnv1a(magic, sizeof(magic));
+    for(auto s : sources) {
+        h= s->hash(h);
+    }
+    return h;
+}
+
+// hash of the contents of the file, false if it can not be read
+bool ConfigSnapshot::file_hash(const char *filename, uint32_t &h)
+{
+    FILE *fp= fopen(filename, "r");
+    if(fp == NULL) return false;
+
+    char buf[128];
+    size_t n;
+    h= fnv1a(NULL, 0);
+    while((n= fread(buf, 1, sizeof(buf), fp)) > 0) {
+        h= fnv1a(buf, n, h);
+    }
+    fclose(fp);
+    return true;
+}
+
+// fill the cache from the snapshot, false and an empty cache if there is no snapshot or it is out of date
+bool ConfigSnapshot::load(ConfigCache *cache, const std::vector<ConfigSource*> &sources, const char *filename)
+{
+    FILE *fp= fopen(filename, "r");
+    if(fp == NULL) return false;
+
+    auto get= [fp](void *data, size_t n) { return fread(data, 1, n, fp) == n; };
+
+    header_t header;
+    bool ok= get(&header, sizeof(header)) && memcmp(header.magic, magic, sizeof(magic)) == 0 && header.sources_hash == sources_hash(sources);
+
+    char buf[256];
+    for (int i = 0; ok && i < header.nfiles; i++) {
+        uint8_t n;
+        uint32_t h, now;
+        ok= get(&n, sizeof(n)) && get(buf, n) && get(&h, sizeof(h));
+        if(!ok) break;
+        buf[n]= '\0';
+        ok= file_hash(buf, now) && now == h;
+        cache->add_file(buf);
+    }
+
+    for (int i = 0; ok && i < header.nvalues; i++) {
+        uint16_t cs[3];
+        uint8_t n;
+        ok= get(cs, sizeof(cs)) && get(&n, sizeof(n)) && get(buf, n);
+        if(!ok) break;
+        ConfigValue *cv= new ConfigValue(cs);
+        cv->value= cache->intern(buf, n);
+        cv->found= true;
+        cache->add(cv);
+    }
+    fclose(fp);
+
+    if(!ok) {
+        cache->clear();
+        return false;
+    }
+    printf("Config loaded from %s\n", filename);
+    return true;
+}
+
+bool ConfigSnapshot::save(const ConfigCache *cache, const std::vector<ConfigSource*> &sources, const char *filename)
+{
+    FILE *fp= fopen(filename, "w");
+    if(fp == NULL) return false;
+
+    bool ok= true;
+    auto put= [&ok, fp](const void *data, size_t n) {
+        if(fwrite(data, 1, n, fp) != n) ok= false;
+    };
+
+    header_t header;
+    memcpy(header.magic, magic, sizeof(header.magic));
+    header.sources_hash= sources_hash(sources);
+    header.nfiles= cache->files.size();
+    header.nvalues= cache->store.size();
+    put(&header, sizeof(header));
+
+    for(auto &f : cache->files) {
+        uint8_t n= f.size();
+        uint32_t h;
+        if(f.size() > 255 || !file_hash(f.c_str(), h)) {
+            ok= false;
+            break;
+        }
+        put(&n, sizeof(n));
+        put(f.data(), n);
+        put(&h, sizeof(h));
+    }
+
+    for(auto cv : cache->store) {
+        size_t len= strlen(cv->value);
+        uint8_t n= len;
+        if(len > 255) {
+            ok= false;
+            break;
+        }
+        put(cv->check_sums, sizeof(cv->check_sums));
+        put(&n, sizeof(n));
+        put(cv->value, n);
+    }
+
+    if(fclose(fp) != 0) ok= false;
+    if(!ok) remove(filename);
+    return ok;
+}
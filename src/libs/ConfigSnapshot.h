@@ -0,0 +1,38 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONFIGSNAPSHOT_H
+#define CONFIGSNAPSHOT_H
+
+#include <stdint.h>
+#include <vector>
+
+class ConfigCache;
+class ConfigSource;
+
+// A binary copy of the config cache, so boot does not have to parse the config files again while they are unchanged.
+// It records the files the values came from with a hash of their contents, and is ignored once any of them differ.
+class ConfigSnapshot {
+    public:
+        static bool load(ConfigCache *cache, const std::vector<ConfigSource*> &sources, const char *filename);
+        static bool save(const ConfigCache *cache, const std::vector<ConfigSource*> &sources, const char *filename);
+
+    private:
+        // file header, followed by nfiles of uint8 length, name, uint32 hash and nvalues of uint16 checksums[3], uint8 length, value
+        struct header_t {
+            char magic[4];
+            uint32_t sources_hash;                          // ConfigSource::hash() of all the sources
+            uint16_t nfiles;
+            uint16_t nvalues;
+        };
+        static const char magic[4];
+
+        static uint32_t sources_hash(const std::vector<ConfigSource*> &sources);
+        static bool file_hash(const char *filename, uint32_t &h);
+};
+
+#endif
@@ -26,13 +26,16 @@ class ConfigSource {
         virtual bool write( string setting, string value ) = 0;
         virtual string read( uint16_t check_sums[3] ) = 0;
 
+        // add what identifies this source to the hash, a config snapshot is only used while none of its sources change
+        virtual uint32_t hash(uint32_t h) const { return h; }
+        // when it includes other files read() does not see the values in them
+        virtual bool has_includes() { return false; }
+
     protected:
         virtual ConfigValue* process_line_from_ascii_config(const string& line, ConfigCache* cache);
         virtual string process_line_from_ascii_config(const string& line, uint16_t line_checksums[3]);
+        bool process_line(const string &buffer, uint16_t check_sums[3], size_t &begin_value, size_t &value_size, bool report_unknown= false);
         uint16_t name_checksum;
-
-    private:
-        ConfigValue* process_line(const string &buffer);
 };
 
 
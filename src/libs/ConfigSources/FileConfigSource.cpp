@@ -11,6 +11,7 @@
 #include "ConfigCache.h"
 #include "checksumm.h"
 #include "utils.h"
+#include "AtomicFileStream.h"
 #include <malloc.h>
 
 using namespace std;
@@ -24,6 +25,7 @@ FileConfigSource::FileConfigSource(string config_file, const char *name)
     this->name_checksum = get_checksum(name);
     this->config_file = config_file;
     this->config_file_found = false;
+    this->indexed_size = -1;
 }
 
 bool FileConfigSource::readLine(string& line, int lineno, FILE *fp)
@@ -66,6 +68,7 @@ void FileConfigSource::transfer_values_to_cache( ConfigCache *cache, const char
 
     // Open the config file ( find it if we haven't already found it )
     FILE *lp = fopen(file_name, "r");
+    cache->add_file(file_name);
 
     int ln= 1;
     // For each line
@@ -76,8 +79,8 @@ void FileConfigSource::transfer_values_to_cache( ConfigCache *cache, const char
             ConfigValue* cv = process_line_from_ascii_config(line, cache);
 
             // if this line is an include directive then attempt to read the included file
-            if(cv->check_sums[0] == include_checksum) {
-                string inc_file_name = cv->value.c_str();
+            if(cv != NULL && cv->check_sums[0] == include_checksum) {
+                string inc_file_name = cv->value;
                 if(!file_exists(inc_file_name)) {
                     // if the file is not found at the location entered then look around for it a bit
                     if(inc_file_name[0] != '/') inc_file_name = "/" + inc_file_name;
@@ -113,12 +116,107 @@ void FileConfigSource::transfer_values_to_cache( ConfigCache *cache, const char
     fclose(lp);
 }
 
+// only the file name, the snapshot checks the contents of every file that was read
+uint32_t FileConfigSource::hash(uint32_t h) const
+{
+    return fnv1a(this->config_file.data(), this->config_file.size(), h);
+}
+
 // Return true if the check_sums match
 bool FileConfigSource::is_named( uint16_t check_sum )
 {
     return check_sum == this->name_checksum;
 }
 
+// opens the config file with an index that is up to date with its size
+FILE *FileConfigSource::open_indexed(const char *mode)
+{
+    FILE *fp = fopen(this->get_config_file().c_str(), mode);
+    if(fp == NULL) return NULL;
+    fseek(fp, 0, SEEK_END);
+    if(ftell(fp) != this->indexed_size) build_index(fp);
+    return fp;
+}
+
+// one pass over the file noting the first line of each setting, a later one is not read
+void FileConfigSource::build_index(FILE *fp)
+{
+    this->index.clear();
+    fseek(fp, 0, SEEK_END);
+    this->indexed_size = ftell(fp);
+    rewind(fp);
+
+    string line;
+    uint16_t check_sums[3];
+    size_t begin_value, value_size;
+    while(true) {
+        long bol = ftell(fp);
+        if(!readLine(line, 0, fp)) break;
+        if(!process_line(line, check_sums, begin_value, value_size) || find(check_sums) != nullptr) continue;
+        line_t l;
+        memcpy(l.check_sums, check_sums, sizeof(l.check_sums));
+        l.length = ftell(fp) - bol;
+        l.offset = bol;
+        this->index.push_back(l);
+    }
+    this->index.shrink_to_fit();
+}
+
+const FileConfigSource::line_t *FileConfigSource::find(const uint16_t check_sums[3]) const
+{
+    for(auto &l : this->index) {
+        if(l.check_sums[0] == check_sums[0] && l.check_sums[1] == check_sums[1] && l.check_sums[2] == check_sums[2]) return &l;
+    }
+    return nullptr;
+}
+
+// the indexed line of the setting, read into line, nullptr if the file does not have it
+const FileConfigSource::line_t *FileConfigSource::find_line(FILE *fp, const uint16_t check_sums[3], string &line)
+{
+    uint16_t cs[3] = { check_sums[0], check_sums[1], check_sums[2] };
+    for(int tries = 0; tries < 2; tries++) {
+        const line_t *l = find(check_sums);
+        if(l == nullptr) return nullptr;
+        fseek(fp, l->offset, SEEK_SET);
+        if(readLine(line, 0, fp) && !process_line_from_ascii_config(line, cs).empty()) return l;
+        // it was edited without changing its size
+        build_index(fp);
+    }
+    return nullptr;
+}
+
+// the whole file is written again with the line in place of the one that was there
+bool FileConfigSource::rewrite_line(FILE *fp, const line_t &l, const string &line)
+{
+    AtomicFileStream fs(this->get_config_file().c_str(), 1024);
+    char buf[256];
+    rewind(fp);
+    for(long left = l.offset; left > 0; ) {
+        size_t n = fread(buf, 1, std::min(left, (long)sizeof(buf)), fp);
+        if(n == 0) return false;
+        fs.write(buf, n);
+        left -= n;
+    }
+    fs.write(line.data(), line.size());
+    fseek(fp, l.offset + l.length, SEEK_SET);
+    for(size_t n; (n = fread(buf, 1, sizeof(buf), fp)) > 0; ) fs.write(buf, n);
+    fclose(fp);
+    this->indexed_size = -1;
+    return fs.commit();
+}
+
+bool FileConfigSource::has_includes()
+{
+    if( !this->has_config_file() ) {
+        return false;
+    }
+    FILE *lp = open_indexed("r");
+    if(lp == NULL) return false;
+    fclose(lp);
+    uint16_t cs[3] = { include_checksum, 0, 0 };
+    return find(cs) != nullptr;
+}
+
 // OverWrite or append a config setting to the file
 bool FileConfigSource::write( string setting, string value )
 {
@@ -129,40 +227,36 @@ bool FileConfigSource::write( string setting, string value )
     uint16_t setting_checksums[3];
     get_checksums(setting_checksums, setting );
 
-    // Open the config file ( find it if we haven't already found it )
-    FILE *lp = fopen(this->get_config_file().c_str(), "r+");
-
-    // search each line for a match
-    while(!feof(lp)) {
-        string line;
-        fpos_t bol, eol;
-        fgetpos( lp, &bol ); // get start of line
-        if(readLine(line, 0, lp)) {
-            fgetpos( lp, &eol ); // get end of line
-            if(!process_line_from_ascii_config(line, setting_checksums).empty()) {
-                // found it
-                unsigned int free_space = eol - bol - 4; // length of line
-                // check we have enough space for this insertion
-                if( (setting.length() + value.length() + 3) > free_space ) {
-                    //THEKERNEL->streams->printf("ERROR: Not enough room for value\r\n");
-                    fclose(lp);
-                    return false;
-                }
+    FILE *lp = open_indexed("r+");
+    if(lp == NULL) return false;
+
+    string line;
+    const line_t *l = find_line(lp, setting_checksums, line);
+    if(l != nullptr) {
+        unsigned int free_space = l->length - 4; // length of line
+        if( (setting.length() + value.length() + 3) <= free_space ) {
+            // Update line, leaves whatever was at end of line there just overwrites the key and value, so the lines
+            // stay where the index has them
+            fseek(lp, l->offset, SEEK_SET);
+            fputs(setting.c_str(), lp);
+            fputs(" ", lp);
+            fputs(value.c_str(), lp);
+            fputs(" #", lp);
+            fclose(lp);
+            return true;
+        }
 
-                // Update line, leaves whatever was at end of line there just overwrites the key and value
-                fseek(lp, bol, SEEK_SET);
-                fputs(setting.c_str(), lp);
-                fputs(" ", lp);
-                fputs(value.c_str(), lp);
-                fputs(" #", lp);
-                fclose(lp);
-                return true;
-            }
-        }else break;
+        // too long for the line, it keeps its comment
+        size_t comment = line.find('#');
+        string replaced = setting + " " + value;
+        if(comment != string::npos) replaced += "    " + line.substr(comment);
+        if(replaced.back() != '\n') replaced += "\n";
+        return rewrite_line(lp, *l, replaced);
     }
 
     // not found so append the new value
     fclose(lp);
+    this->indexed_size = -1;
     lp = fopen(this->get_config_file().c_str(), "a");
     fputs("\n", lp);
     fputs(setting.c_str(), lp);
@@ -183,16 +277,10 @@ string FileConfigSource::read( uint16_t check_sums[3] )
         return value;
     }
 
-    // Open the config file ( find it if we haven't already found it )
-    FILE *lp = fopen(this->get_config_file().c_str(), "r");
-    // For each line
-    while(!feof(lp)) {
-        string line;
-         if(readLine(line, 0, lp)) {
-            value = process_line_from_ascii_config(line, check_sums);
-            if(!value.empty()) break; // found it
-        }else break;
-    }
+    FILE *lp = open_indexed("r");
+    if(lp == NULL) return value;
+    string line;
+    if(find_line(lp, check_sums, line) != nullptr) value = process_line_from_ascii_config(line, check_sums);
     fclose(lp);
 
     return value;
@@ -25,12 +25,30 @@ public:
     bool is_named( uint16_t check_sum );
     bool write( string setting, string value );
     string read( uint16_t check_sums[3] );
+    uint32_t hash(uint32_t h) const;
+    bool has_includes();
     bool has_config_file();
     void try_config_file(string candidate);
     string get_config_file();
 
 private:
     bool readLine(string& line, int lineno, FILE *fp);
+
+    // where each setting is in the file, so a read or a write goes straight to its line. It is built by the first that
+    // needs it, and again once the file has changed size or a line is not where the index has it
+    struct line_t {
+        uint16_t check_sums[3];
+        uint16_t length;        // with the newline
+        uint32_t offset;
+    };
+    FILE *open_indexed(const char *mode);
+    void build_index(FILE *fp);
+    const line_t *find(const uint16_t check_sums[3]) const;
+    const line_t *find_line(FILE *fp, const uint16_t check_sums[3], string &line);
+    bool rewrite_line(FILE *fp, const line_t &l, const string &line);
+
+    vector<line_t> index;
+    long indexed_size;          // of the file when it was indexed, -1 when there is no index
     string config_file;         // Path to the config file
     bool   config_file_found;   // Wether or not the config file's location is known
 };
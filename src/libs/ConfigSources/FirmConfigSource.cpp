@@ -50,6 +50,12 @@ void FirmConfigSource::transfer_values_to_cache( ConfigCache* cache ){
     }
 }
 
+// the config is part of the firmware, so this changes when a different config.default is built in
+uint32_t FirmConfigSource::hash(uint32_t h) const
+{
+    return fnv1a(this->start, this->end - this->start, h);
+}
+
 // Return true if the check_sums match
 bool FirmConfigSource::is_named( uint16_t check_sum ){
     return check_sum == this->name_checksum;
@@ -11,6 +11,7 @@
 
 #include <vector>
 #include <stdio.h>
+#include <string.h>
 
 ConfigValue::ConfigValue()
 {
@@ -27,6 +28,7 @@ void ConfigValue:: clear()
     this->default_double= 0.0F;
     this->default_int= 0;
     this->value= "";
+    this->default_string.clear();
 }
 
 ConfigValue::ConfigValue(uint16_t *cs) {
@@ -41,7 +43,8 @@ ConfigValue::ConfigValue(const ConfigValue& to_copy)
     this->found = to_copy.found;
     this->default_set = to_copy.default_set;
     memcpy(this->check_sums, to_copy.check_sums, sizeof(this->check_sums));
-    this->value.assign(to_copy.value);
+    this->value= to_copy.value;
+    this->default_string= to_copy.default_string;
 }
 
 ConfigValue& ConfigValue::operator= (const ConfigValue& to_copy)
@@ -50,7 +53,8 @@ ConfigValue& ConfigValue::operator= (const ConfigValue& to_copy)
         this->found = to_copy.found;
         this->default_set = to_copy.default_set;
         memcpy(this->check_sums, to_copy.check_sums, sizeof(this->check_sums));
-        this->value.assign(to_copy.value);
+        this->value= to_copy.value;
+        this->default_string= to_copy.default_string;
     }
     return *this;
 }
@@ -69,11 +73,11 @@ float ConfigValue::as_number()
         return this->default_double;
     } else {
         char *endptr = NULL;
-        string str = remove_non_number(this->value);
+        string str = remove_non_number(this->str());
         const char *cp= str.c_str();
         float result = strtof(cp, &endptr);
         if( endptr <= cp ) {
-            printErrorandExit("config setting with value '%s' and checksums[%04X,%04X,%04X] is not a valid number, please see http://smoothieware.org/configuring-smoothie\r\n", this->value.c_str(), this->check_sums[0], this->check_sums[1], this->check_sums[2] );
+            printErrorandExit("config setting with value '%s' and checksums[%04X,%04X,%04X] is not a valid number, please see http://smoothieware.org/configuring-smoothie\r\n", this->str(), this->check_sums[0], this->check_sums[1], this->check_sums[2] );
         }
         return result;
     }
@@ -85,11 +89,11 @@ int ConfigValue::as_int()
         return this->default_int;
     } else {
         char *endptr = NULL;
-        string str = remove_non_number(this->value);
+        string str = remove_non_number(this->str());
         const char *cp= str.c_str();
         int result = strtol(cp, &endptr, 10);
         if( endptr <= cp ) {
-            printErrorandExit("config setting with value '%s' and checksums[%04X,%04X,%04X] is not a valid int, please see http://smoothieware.org/configuring-smoothie\r\n", this->value.c_str(), this->check_sums[0], this->check_sums[1], this->check_sums[2] );
+            printErrorandExit("config setting with value '%s' and checksums[%04X,%04X,%04X] is not a valid int, please see http://smoothieware.org/configuring-smoothie\r\n", this->str(), this->check_sums[0], this->check_sums[1], this->check_sums[2] );
         }
         return result;
     }
@@ -97,7 +101,7 @@ int ConfigValue::as_int()
 
 std::string ConfigValue::as_string()
 {
-    return this->value;
+    return this->str();
 }
 
 bool ConfigValue::as_bool()
@@ -105,7 +109,7 @@ bool ConfigValue::as_bool()
     if( this->found == false && this->default_set == true ) {
         return this->default_int;
     } else {
-        return this->value.find_first_of("ty1") != string::npos;
+        return strpbrk(this->str(), "ty1") != NULL;
     }
 }
 
@@ -130,13 +134,13 @@ ConfigValue *ConfigValue::by_default(string val)
         return this;
     }
     this->default_set = true;
-    this->value = val;
+    this->default_string = val;
     return this;
 }
 
 bool ConfigValue::has_characters( const char *mask )
 {
-    if( this->value.find_first_of(mask) != string::npos ) {
+    if( strpbrk(this->str(), mask) != NULL ) {
         return true;
     } else {
         return false;
@@ -35,10 +35,13 @@ class ConfigValue{
         friend class ConfigSource;
         friend class Configurator;
         friend class FileConfigSource;
+        friend class ConfigSnapshot;
 
     private:
         bool has_characters( const char* mask );
-        string value;
+        const char *str() const { return found ? value : default_string.c_str(); }
+        const char *value;      // in the ConfigCache that holds this value
+        string default_string;
         int default_int;
         float default_double;
         uint16_t check_sums[3];
@@ -0,0 +1,84 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CycleProfile.h"
+#include "StreamOutput.h"
+
+#include "LPC17xx.h"
+#include "system_LPC17xx.h" // for SystemCoreClock
+
+#include <vector>
+
+// both are constant initialised so profiles can be made by static constructors in any order
+CycleProfile *CycleProfile::first= nullptr;
+volatile bool CycleProfile::enabled= false;
+
+CycleProfile::CycleProfile(const char *name, const char *group) : name(name), group(group), next(nullptr)
+{
+    calls= 0;
+    min_cycles= UINT32_MAX;
+    max_cycles= 0;
+    total_cycles= 0;
+
+    // added at the end so they print in the order they were made
+    CycleProfile **p= &first;
+    while(*p != nullptr) p= &(*p)->next;
+    *p= this;
+}
+
+void CycleProfile::record(uint32_t cycles)
+{
+    calls= calls + 1;
+    total_cycles= total_cycles + cycles;
+    if(cycles < min_cycles) min_cycles= cycles;
+    if(cycles > max_cycles) max_cycles= cycles;
+}
+
+// the cycle counter is left running when turned off, MRI may be using the trace unit too
+void CycleProfile::enable(bool on)
+{
+    if(on) {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+    enabled= on;
+}
+
+void CycleProfile::reset()
+{
+    __disable_irq();
+    for(CycleProfile *p= first; p != nullptr; p= p->next) {
+        p->calls= 0;
+        p->min_cycles= UINT32_MAX;
+        p->max_cycles= 0;
+        p->total_cycles= 0;
+    }
+    __enable_irq();
+}
+
+// everything called since the last reset, the interrupts are only held off while taking a copy
+void CycleProfile::print(StreamOutput *stream)
+{
+    struct snap_t {
+        const char *name, *group;
+        uint32_t calls, min_cycles, max_cycles;
+        uint64_t total_cycles;
+    };
+    std::vector<snap_t> snap;
+    for(CycleProfile *p= first; p != nullptr; p= p->next) {
+        __disable_irq();
+        snap_t s{p->name, p->group, p->calls, p->min_cycles, p->max_cycles, p->total_cycles};
+        __enable_irq();
+        if(s.calls != 0) snap.push_back(s);
+    }
+
+    stream->printf("cycles @ %luMHz, profiling is %s:\n", SystemCoreClock / 1000000, enabled ? "on" : "off");
+    for(auto &s : snap) {
+        stream->printf(" %s%s%s: avg %lu, min %lu, max %lu (%lu calls)\n", s.group ? s.group : "", s.group ? " " : "", s.name,
+                       (uint32_t)(s.total_cycles / s.calls), s.min_cycles, s.max_cycles, s.calls);
+    }
+}
@@ -0,0 +1,62 @@
+#include "DirIndex.h"
+
+#include "DirHandle.h"
+#include "SDCard.h"
+
+#include <string.h>
+#include <algorithm>
+
+extern SDCard sd;
+
+DirIndex *DirIndex::cached= nullptr;
+
+// the folder at path, from the last time it was read if the card has not been written since
+const DirIndex *DirIndex::get(const std::string &path)
+{
+    if(cached != nullptr && cached->path == path && cached->write_count == sd.get_write_count()) return cached;
+
+    clear();
+    DirIndex *d= new DirIndex;
+    if(!d->read(path)) {
+        delete d;
+        return nullptr;
+    }
+    cached= d;
+    return cached;
+}
+
+void DirIndex::clear()
+{
+    delete cached;
+    cached= nullptr;
+}
+
+bool DirIndex::read(const std::string &p)
+{
+    // a write in the middle of reading the folder has it read again next time
+    this->path= p;
+    this->write_count= sd.get_write_count();
+
+    DIR *d= opendir(p.c_str());
+    if(d == NULL) return false;
+    struct dirent *e;
+    size_t bytes= 0;
+    while ((e = readdir(d)) != NULL) {
+        size_t n= strlen(e->d_name) + 1;
+        bytes += n + sizeof(entry_t);
+        if(bytes > max_bytes) {
+            closedir(d);
+            return false;
+        }
+        entries.push_back({(uint16_t)names.size(), e->d_isdir, e->d_fsize});
+        names.insert(names.end(), e->d_name, e->d_name + n);
+    }
+    closedir(d);
+
+    std::sort(entries.begin(), entries.end(), [this](const entry_t &a, const entry_t &b) {
+        return strcasecmp(&names[a.name], &names[b.name]) < 0;
+    });
+    entries.shrink_to_fit();
+    names.shrink_to_fit();
+    return true;
+}
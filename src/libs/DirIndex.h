@@ -0,0 +1,43 @@
+#ifndef _DIRINDEX_H_
+#define _DIRINDEX_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// The entries of one folder on the sd card read once and sorted by name, so the panel can scroll through it and ls
+// can list it without reading the directory every time. It is read again once anything has been written to the card,
+// from the filesystem or USB MSD, so it can't go out of date. The last folder asked for is kept, get() returns nullptr
+// if it can't be read or has too many entries to keep, then it has to be read through opendir() as before.
+class DirIndex {
+    public:
+        static const DirIndex *get(const std::string &path);
+        static void clear();
+
+        size_t size() const { return entries.size(); }
+        const char *name(size_t i) const { return &names[entries[i].name]; }
+        bool is_dir(size_t i) const { return entries[i].isdir; }
+        uint32_t file_size(size_t i) const { return entries[i].size; }
+        uint32_t get_write_count() const { return write_count; }
+
+    private:
+        // the names and entries of a folder take no more than this
+        static const size_t max_bytes= 8192;
+
+        struct entry_t {
+            uint16_t name;          // offset of the name in names
+            bool isdir;
+            uint32_t size;
+        };
+
+        bool read(const std::string &path);
+
+        std::string path;
+        uint32_t write_count;       // of the card, when it was read
+        std::vector<char> names;
+        std::vector<entry_t> entries;
+
+        static DirIndex *cached;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "EventTrace.h"
+
+#include "Kernel.h"
+#include "Config.h"
+#include "ConfigValue.h"
+#include "checksumm.h"
+#include "StreamOutput.h"
+#include "StreamOutputPool.h"
+#include "platform_memory.h"
+
+#include "LPC17xx.h"
+#include "system_LPC17xx.h" // for SystemCoreClock
+
+#include <stdio.h>
+#include <string.h>
+
+#define trace_buffer_size_checksum CHECKSUM("trace_buffer_size")
+#define trace_halt_file_checksum   CHECKSUM("trace_halt_file")
+
+EventTrace::record_t *EventTrace::ring= nullptr;
+uint32_t EventTrace::mask= 0;
+volatile uint32_t EventTrace::head= 0;
+volatile bool EventTrace::paused= false;
+
+EventTrace::EventTrace()
+{
+    dump_pending= false;
+}
+
+void EventTrace::on_module_loaded()
+{
+    // rounded down to a power of two records
+    uint32_t size= THEKERNEL->config->value(trace_buffer_size_checksum)->by_default(0)->as_number();
+    if(size < 2) {
+        delete this;
+        return;
+    }
+    size= 1UL << (31 - __builtin_clz(size));
+
+    record_t *r= (record_t *)AHB0.alloc(size * sizeof(record_t));
+    if(r == nullptr) r= (record_t *)AHB1.alloc(size * sizeof(record_t));
+    if(r == nullptr) {
+        THEKERNEL->streams->printf("WARNING: the trace buffer of %lu records does not fit in AHB RAM\n", size);
+        delete this;
+        return;
+    }
+
+#ifndef SIMULATION
+    // the cycle counter is shared with CycleProfile, it is never stopped once it runs
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+    mask= size - 1;
+    head= 0;
+    ring= r;
+
+    halt_file= THEKERNEL->config->value(trace_halt_file_checksum)->by_default("")->as_string();
+    register_for_event(ON_HALT);
+    register_for_event(ON_MAIN_LOOP);
+}
+
+// the records up to the halt are kept until they are written from the main loop, the flush after it is not recorded
+void EventTrace::on_halt(void *argument)
+{
+    if(argument != nullptr) return;
+    record(HALT);
+    if(halt_file.empty()) return;
+    paused= true;
+    dump_pending= true;
+}
+
+void EventTrace::on_main_loop(void *argument)
+{
+    if(!dump_pending) return;
+    dump_pending= false;
+    if(dump(halt_file.c_str())) THEKERNEL->streams->printf("trace written to %s\r\n", halt_file.c_str());
+    paused= false;
+}
+
+// a header of "SMTR", the version, the record size, the core clock and the number of records, then the records oldest first
+bool EventTrace::dump(const char *filename)
+{
+    if(ring == nullptr) return false;
+    FILE *fp= fopen(filename, "w");
+    if(fp == NULL) return false;
+
+    bool was_paused= paused;
+    paused= true;
+    uint32_t n= head;
+    uint32_t count= (n > mask) ? mask + 1 : n;
+
+    struct {
+        char magic[4];
+        uint16_t version;
+        uint16_t record_size;
+        uint32_t core_hz;
+        uint32_t count;
+    } header= {{'S', 'M', 'T', 'R'}, 1, sizeof(record_t), SystemCoreClock, count};
+    bool ok= fwrite(&header, sizeof(header), 1, fp) == 1;
+
+    // the ring in up to two pieces
+    uint32_t first= (n - count) & mask;
+    uint32_t len= (first + count > mask + 1) ? mask + 1 - first : count;
+    if(ok && len > 0) ok= fwrite(&ring[first], sizeof(record_t), len, fp) == len;
+    if(ok && count > len) ok= fwrite(&ring[0], sizeof(record_t), count - len, fp) == count - len;
+
+    paused= was_paused;
+    return fclose(fp) == 0 && ok;
+}
+
+void EventTrace::reset()
+{
+    head= 0;
+}
+
+void EventTrace::print(StreamOutput *stream)
+{
+    if(ring == nullptr) {
+        stream->printf("trace is off, set trace_buffer_size to record\n");
+        return;
+    }
+    uint32_t n= head;
+    stream->printf("trace: %lu of %lu records, %lu made\n", n > mask ? mask + 1 : n, mask + 1, n);
+}
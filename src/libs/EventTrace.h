@@ -0,0 +1,82 @@
+#ifndef EVENTTRACE_H
+#define EVENTTRACE_H
+
+#include "Module.h"
+
+#include <stdint.h>
+#include <string>
+
+class StreamOutput;
+
+// A ring of timestamped records from the points where work is handed between the main loop and the interrupts, to find
+// out after the fact why a job stuttered. Each record is 8 bytes, the DWT cycle count, the event, the exception number it
+// was recorded in (0 in the main loop) and a 16 bit argument. Nothing is recorded unless trace_buffer_size is set, then the
+// ring is in AHB RAM and a record costs about 20 cycles. "get trace dump file" writes it out, and so does a halt when
+// trace_halt_file is set, smoothie-trace.py decodes the file. The newest records overwrite the oldest.
+class EventTrace : public Module {
+    public:
+        // the numbers are in the file, keep smoothie-trace.py in step with them
+        enum EVENT {
+            BLOCK_BEGIN= 1,     // queue depth
+            BLOCK_END,          // queue depth
+            BLOCK_QUEUED,       // queue depth
+            LINE_RECEIVED,      // length of the line
+            SD_READ_BEGIN,      // sectors
+            SD_READ_END,        // 0 if it was read
+            USB_RX,             // bytes
+            PENDSV_BEGIN,
+            PENDSV_END,
+            HALT,
+        };
+
+        EventTrace();
+        void on_module_loaded();
+        void on_halt(void *argument);
+        void on_main_loop(void *argument);
+
+        static void record(EVENT event, uint16_t arg= 0)
+        {
+            if(ring == nullptr || paused) return;
+            // claimed first so an interrupt recording in between takes the next slot
+            record_t &r= ring[__sync_fetch_and_add(&head, 1) & mask];
+            r.cycles= cycle_count();
+            r.event= event;
+            r.exception= exception_number();
+            r.arg= arg;
+        }
+
+        static bool dump(const char *filename);
+        static void reset();
+        static void print(StreamOutput *stream);
+
+    private:
+        struct record_t {
+            uint32_t cycles;
+            uint8_t event;
+            uint8_t exception;
+            uint16_t arg;
+        };
+
+        // DWT->CYCCNT and IPSR, without the CMSIS headers, never called in the simulator as nothing is recorded there
+        static uint32_t cycle_count() { return *(volatile uint32_t *)0xE0001004; }
+        static uint8_t exception_number()
+        {
+#ifndef SIMULATION
+            uint32_t ipsr;
+            __asm volatile ("mrs %0, ipsr" : "=r" (ipsr));
+            return ipsr;
+#else
+            return 0;
+#endif
+        }
+
+        static record_t *ring;
+        static uint32_t mask;
+        static volatile uint32_t head;      // records ever made, the slot is this modulo the size
+        static volatile bool paused;
+
+        std::string halt_file;
+        bool dump_pending;
+};
+
+#endif
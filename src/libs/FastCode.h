@@ -0,0 +1,15 @@
+#ifndef FASTCODE_H
+#define FASTCODE_H
+
+// FAST_CODE puts a function in the .fastcode section, which the linker script places in .data, so the startup code copies
+// it to the main SRAM with the initialised data and it runs from there without the flash wait states and accelerator
+// misses. Only the step and acceleration interrupts are, as every byte of it is taken from the heap. Calls between that
+// code and the code left in flash are too far for a branch, the linker adds veneers for them.
+// Build with STEP_CODE_IN_FLASH=1 to leave it all in flash, get cycles shows what it saves.
+#if defined(SIMULATION) || defined(STEP_CODE_IN_FLASH)
+#define FAST_CODE
+#else
+#define FAST_CODE __attribute__ ((section (".fastcode")))
+#endif
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef FASTTRIG_H
+#define FASTTRIG_H
+
+#include <math.h>
+#include <string.h>
+
+// Polynomial atan2, atan, sin and cos for the arm solutions, which call them for every actuator of every segment.
+// With software floating point the libm functions take hundreds of cycles each, these take a divide and a few multiplies.
+// HIGH is within 5e-7 radians of the exact result, a few roundings of a float like libm, LOW is within 4e-5 radians
+// and quicker still, EXACT calls libm. The atan polynomials are minimax on [0, 1], sin and cos are Taylor series on [-pi/4, pi/4].
+class FastTrig {
+    public:
+        enum PRECISION { EXACT, HIGH, LOW };
+
+        FastTrig(PRECISION p= HIGH) : precision(p) {}
+        void set_precision(PRECISION p) { precision= p; }
+        PRECISION get_precision() const { return precision; }
+
+        static PRECISION precision_from_string(const char *name)
+        {
+            if(strcasecmp(name, "exact") == 0) return EXACT;
+            if(strcasecmp(name, "low") == 0) return LOW;
+            return HIGH;
+        }
+
+        float atan2(float y, float x) const;
+        float atan(float x) const { return precision == EXACT ? atanf(x) : atan2(x, 1.0F); }
+        void sincos(float a, float &s, float &c) const;
+        float sin(float a) const { float s, c; sincos(a, s, c); return s; }
+        float cos(float a) const { float s, c; sincos(a, s, c); return c; }
+
+    private:
+        PRECISION precision;
+};
+
+inline float FastTrig::atan2(float y, float x) const
+{
+    if(precision == EXACT) return atan2f(y, x);
+
+    float ax= fabsf(x), ay= fabsf(y);
+    float mx= ax > ay ? ax : ay;
+    if(mx == 0.0F) return 0.0F;
+    float q= (ax > ay ? ay : ax) / mx;
+    float q2= q * q;
+    float r;
+    if(precision == LOW) {
+        r= q * (0.999866329F + q2 * (-0.330304786F + q2 * (0.180159295F + q2 * (-0.0851563509F + q2 * 0.0208451142F))));
+    } else {
+        r= q * (0.999999336F + q2 * (-0.333298608F + q2 * (0.199465657F + q2 * (-0.139086296F + q2 * (0.0964219741F
+             + q2 * (-0.0559123279F + q2 * (0.0218629587F + q2 * -0.00405456745F)))))));
+    }
+    if(ay > ax) r= 1.57079632679F - r;
+    if(x < 0.0F) r= 3.14159265359F - r;
+    return y < 0.0F ? -r : r;
+}
+
+inline void FastTrig::sincos(float a, float &s, float &c) const
+{
+    if(precision == EXACT) {
+        s= sinf(a);
+        c= cosf(a);
+        return;
+    }
+
+    // to within pi/4 of a multiple of pi/2, which is taken off in two parts so the remainder keeps its bits
+    float k= floorf(a * 0.636619772F + 0.5F);
+    float r= (a - k * 1.5703125F) - k * 4.83826795e-4F;
+    float r2= r * r;
+    float sr, cr;
+    if(precision == LOW) {
+        sr= r * (1.0F + r2 * (-1.0F / 6 + r2 * (1.0F / 120)));
+        cr= 1.0F + r2 * (-0.5F + r2 * (1.0F / 24 + r2 * (-1.0F / 720)));
+    } else {
+        sr= r * (1.0F + r2 * (-1.0F / 6 + r2 * (1.0F / 120 + r2 * (-1.0F / 5040 + r2 * (1.0F / 362880)))));
+        cr= 1.0F + r2 * (-0.5F + r2 * (1.0F / 24 + r2 * (-1.0F / 720 + r2 * (1.0F / 40320 + r2 * (-1.0F / 3628800)))));
+    }
+    switch((int)k & 3) {
+        case 0: s= sr;  c= cr;  break;
+        case 1: s= cr;  c= -sr; break;
+        case 2: s= -sr; c= -cr; break;
+        default: s= -cr; c= sr; break;
+    }
+}
+
+#endif
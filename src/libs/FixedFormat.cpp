@@ -0,0 +1,88 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FixedFormat.h"
+
+#include <math.h>
+
+static const uint32_t powers_of_ten[]{1, 10, 100, 1000, 10000, 100000, 1000000};
+
+FixedFormat& FixedFormat::chr(char c)
+{
+    if(n + 1 < size) {
+        buf[n++]= c;
+        buf[n]= '\0';
+    }
+    return *this;
+}
+
+FixedFormat& FixedFormat::str(const char *s)
+{
+    while(*s != '\0' && n + 1 < size) buf[n++]= *s++;
+    buf[n]= '\0';
+    return *this;
+}
+
+// v as at least min_digits digits, a minus sign in front if neg and spaces in front of that to make width
+FixedFormat& FixedFormat::digits(uint32_t v, int min_digits, int width, bool neg)
+{
+    char tmp[12];
+    int i= 0;
+    do {
+        tmp[i++]= '0' + (v % 10);
+        v /= 10;
+    } while(v > 0 || i < min_digits);
+
+    for (int w = i + (neg ? 1 : 0); w < width; w++) chr(' ');
+    if(neg) chr('-');
+    while(i > 0) chr(tmp[--i]);
+    return *this;
+}
+
+FixedFormat& FixedFormat::integer(int32_t v, int width)
+{
+    uint32_t u= v < 0 ? -(uint32_t)v : v;
+    return digits(u, 1, width, v < 0);
+}
+
+FixedFormat& FixedFormat::fixed(float v, int decimals, int width)
+{
+    if(isnan(v) || isinf(v)) return str(isnan(v) ? "nan" : (v < 0 ? "-inf" : "inf"));
+    if(decimals < 0) decimals= 0;
+    if(decimals > 6) decimals= 6;
+
+    bool neg= v < 0;
+    if(neg) v= -v;
+    if(v >= 4294967295.0F) v= 4294967295.0F;
+
+    // the fraction is rounded on its own so no precision is lost scaling a large value
+    uint32_t ip= v;
+    uint32_t scale= powers_of_ten[decimals];
+    uint32_t fp= (v - ip) * scale + 0.5F;
+    if(fp >= scale) {
+        ++ip;
+        fp -= scale;
+    }
+    if(ip == 0 && fp == 0) neg= false;
+
+    if(decimals == 0) return digits(ip, 1, width, neg);
+
+    digits(ip, 1, width - decimals - 1, neg);
+    chr('.');
+    return digits(fp, decimals, 0, false);
+}
+
+FixedFormat& FixedFormat::axes(const char *labels, const float *v, int count, char sep, char mark, int decimals)
+{
+    for (int i = 0; i < count && labels[i] != '\0'; i++) {
+        if(i > 0) chr(sep);
+        chr(labels[i]);
+        if(mark != '\0') chr(mark);
+        fixed(v[i], decimals);
+    }
+    return *this;
+}
@@ -0,0 +1,40 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FIXEDFORMAT_H
+#define FIXEDFORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Formats text and numbers into a fixed buffer without printf or the heap, for reports that are sent many times a
+// second. Numbers are written in fixed point like %1.4f, rounded half up so the last digit can differ from printf
+// on a tie. Output that does not fit is cut off, the buffer is always terminated.
+class FixedFormat {
+    public:
+        FixedFormat(char *buf, size_t size) : buf(buf), size(size), n(0) { buf[0]= '\0'; }
+
+        FixedFormat& str(const char *s);
+        FixedFormat& chr(char c);
+        // width pads on the left with spaces, like %4d and %7.2f
+        FixedFormat& integer(int32_t v, int width= 0);
+        FixedFormat& fixed(float v, int decimals= 4, int width= 0);
+        // labelled values, "X:1.0000 Y:2.0000 Z:3.0000" with sep ' ' and mark ':'
+        FixedFormat& axes(const char *labels, const float *v, int count, char sep= ' ', char mark= ':', int decimals= 4);
+
+        const char *c_str() const { return buf; }
+        size_t length() const { return n; }
+
+    private:
+        FixedFormat& digits(uint32_t v, int min_digits, int width, bool neg);
+
+        char *buf;
+        size_t size;
+        size_t n;
+};
+
+#endif
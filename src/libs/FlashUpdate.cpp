@@ -0,0 +1,221 @@
+#include "FlashUpdate.h"
+
+#include "libs/Kernel.h"
+#include "crc32.h"
+#include "platform_memory.h"
+#include "FastCode.h"
+#include "cmsis.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IAP_LOCATION 0x1FFF1FF1
+typedef void (*IAP)(uint32_t *, uint32_t *);
+
+// the IAP commands and the one status the code checks for
+#define IAP_PREPARE         50
+#define IAP_COPY            51
+#define IAP_ERASE           52
+#define IAP_COMPARE         56
+#define IAP_SUCCESS         0
+
+FlashUpdate::FlashUpdate()
+{
+    changed= 0;
+    size= 0;
+    crc= 0;
+}
+
+FlashUpdate::~FlashUpdate()
+{
+    release();
+}
+
+// the first 16 sectors are 4K, the rest 32K
+uint32_t FlashUpdate::sector_number(uint32_t address)
+{
+    return address < 0x10000 ? address / 0x1000 : 16 + (address - 0x10000) / 0x8000;
+}
+
+uint32_t FlashUpdate::sector_start(uint32_t number)
+{
+    return number < 16 ? number * 0x1000 : 0x10000 + (number - 16) * 0x8000;
+}
+
+uint32_t FlashUpdate::sector_size(uint32_t number)
+{
+    return number < 16 ? 0x1000 : 0x8000;
+}
+
+int FlashUpdate::get_changed_sectors() const
+{
+    return __builtin_popcount(changed);
+}
+
+uint32_t FlashUpdate::get_changed_bytes() const
+{
+    uint32_t bytes= 0;
+    for(uint32_t s= 0; s < 32; s++) {
+        if(changed & (1 << s)) bytes+= sector_size(s);
+    }
+    return bytes;
+}
+
+const char *FlashUpdate::check(const char *filename, bool has_crc, uint32_t expected_crc)
+{
+    release();
+    changed= 0;
+    size= 0;
+    crc= 0;
+
+    FILE *fp= fopen(filename, "r");
+    if(fp == nullptr) return "can not be opened";
+    // unbuffered so FatFs reads the sectors straight into the buffer
+    setvbuf(fp, nullptr, _IONBF, 0);
+
+    uint32_t buf[piece_size / 4];
+    size_t n;
+    while((n= fread(buf, 1, sizeof(buf), fp)) > 0) {
+        if(size == 0) {
+            // the stack pointer has to be in the main SRAM and the reset handler in the flash after the bootloader
+            if(n < 8 || buf[0] < 0x10000000 || buf[0] > 0x10008000 || buf[1] < image_base || buf[1] >= flash_end || (buf[1] & 1) == 0) {
+                fclose(fp);
+                return "is not a firmware image";
+            }
+        }
+        if(image_base + size + n > flash_end) {
+            fclose(fp);
+            return "is too big for the flash";
+        }
+        crc= crc32_update(crc, buf, n);
+        if(memcmp(buf, (const void *)(image_base + size), n) != 0) changed|= 1 << sector_number(image_base + size);
+        size+= n;
+        THEKERNEL->call_event(ON_IDLE);
+    }
+    bool failed= ferror(fp);
+    fclose(fp);
+
+    if(failed) return "could not be read";
+    if(size == 0) return "is empty";
+    if(has_crc && crc != expected_crc) return "does not have the CRC it should";
+    return nullptr;
+}
+
+// holds the sectors that changed as they are to be programmed, the end of the last one past the image left erased
+const char *FlashUpdate::stage(const char *filename)
+{
+    release();
+
+    for(uint32_t s= 0; s < 32; s++) {
+        if((changed & (1 << s)) == 0) continue;
+        sector_t sector;
+        sector.address= sector_start(s);
+        sector.number= s;
+        sector.pieces= sector_size(s) / piece_size;
+        for(uint32_t i= 0; i < sector.pieces; i++) {
+            void *p= malloc(piece_size);
+            if(p == nullptr) p= AHB0.alloc(piece_size);
+            if(p == nullptr) p= AHB1.alloc(piece_size);
+            sector.piece[i]= (uint32_t *)p;
+            if(p == nullptr) {
+                sector.pieces= i;
+                staged.push_back(sector);
+                release();
+                return "does not fit in RAM";
+            }
+            memset(p, 0xFF, piece_size);
+        }
+        staged.push_back(sector);
+    }
+
+    FILE *fp= fopen(filename, "r");
+    if(fp == nullptr) {
+        release();
+        return "can not be opened";
+    }
+    setvbuf(fp, nullptr, _IONBF, 0);
+
+    // read all of it again, a sector read wrongly off the sdcard is then caught by the CRC
+    uint32_t buf[piece_size / 4];
+    uint32_t again= 0, offset= 0;
+    size_t n;
+    auto sector= staged.begin();
+    while((n= fread(buf, 1, sizeof(buf), fp)) > 0) {
+        again= crc32_update(again, buf, n);
+        uint32_t address= image_base + offset;
+        while(sector != staged.end() && sector->address + sector->pieces * piece_size <= address) ++sector;
+        if(sector != staged.end() && address >= sector->address) {
+            memcpy(sector->piece[(address - sector->address) / piece_size], buf, n);
+        }
+        offset+= n;
+    }
+    fclose(fp);
+
+    if(offset != size || again != crc) {
+        release();
+        return "changed or could not be read the same twice";
+    }
+    return nullptr;
+}
+
+void FlashUpdate::release()
+{
+    for(auto &s : staged) {
+        for(uint32_t i= 0; i < s.pieces; i++) {
+            void *p= s.piece[i];
+            if(AHB0.has(p)) AHB0.dealloc(p);
+            else if(AHB1.has(p)) AHB1.dealloc(p);
+            else free(p);
+        }
+    }
+    staged.clear();
+}
+
+void FlashUpdate::program()
+{
+    // nothing in the flash runs once this starts, the interrupts included
+    __disable_irq();
+    program_sectors(staged.data(), staged.size(), SystemCoreClock / 1000);
+}
+
+// runs from RAM, so it can not call anything left in the flash, the IAP is in the boot ROM. A sector that does not
+// compare the same as it was staged is erased and programmed again
+FAST_CODE void FlashUpdate::program_sectors(const sector_t *sectors, uint32_t n, uint32_t cclk_khz)
+{
+    IAP iap= (IAP)IAP_LOCATION;
+    uint32_t command[5];
+    uint32_t result[5];
+
+    for(uint32_t s= 0; s < n; s++) {
+        const sector_t &sector= sectors[s];
+        for(int tries= 0; tries < 3; tries++) {
+            // a WDT_MRI watchdog would break into the debugger in flash
+            LPC_WDT->WDFEED= 0xAA;
+            LPC_WDT->WDFEED= 0x55;
+
+            command[0]= IAP_PREPARE; command[1]= sector.number; command[2]= sector.number;
+            iap(command, result);
+            command[0]= IAP_ERASE; command[1]= sector.number; command[2]= sector.number; command[3]= cclk_khz;
+            iap(command, result);
+
+            bool same= result[0] == IAP_SUCCESS;
+            for(uint32_t i= 0; i < sector.pieces && same; i++) {
+                uint32_t address= sector.address + i * piece_size;
+                command[0]= IAP_PREPARE; command[1]= sector.number; command[2]= sector.number;
+                iap(command, result);
+                command[0]= IAP_COPY; command[1]= address; command[2]= (uint32_t)sector.piece[i]; command[3]= piece_size; command[4]= cclk_khz;
+                iap(command, result);
+                command[0]= IAP_COMPARE; command[1]= address; command[2]= (uint32_t)sector.piece[i]; command[3]= piece_size;
+                iap(command, result);
+                same= result[0] == IAP_SUCCESS;
+            }
+            if(same) break;
+        }
+    }
+
+    // as NVIC_SystemReset, which may not be inlined into RAM
+    SCB->AIRCR= (0x5FA << SCB_AIRCR_VECTKEY_Pos) | (SCB->AIRCR & SCB_AIRCR_PRIGROUP_Msk) | SCB_AIRCR_SYSRESETREQ_Msk;
+    __DSB();
+    while(1);
+}
@@ -0,0 +1,52 @@
+#ifndef FLASHUPDATE_H
+#define FLASHUPDATE_H
+
+#include <stdint.h>
+#include <vector>
+
+// Programs a firmware image from the sdcard over the one that is running, only erasing and programming the flash
+// sectors that differ from it. check() reads the image once to CRC it and find those sectors, stage() reads it again
+// holding the sectors that changed in RAM and checks the CRC came out the same, and program() then runs from RAM with
+// everything else stopped, as the flash can not be read while it is being written, and resets into the new firmware.
+// The bootloader takes the first 16K, the image goes at 0x4000 as it does for firmware.bin.
+class FlashUpdate {
+    public:
+        FlashUpdate();
+        ~FlashUpdate();
+
+        // nullptr when it is an image that can be programmed, or what is wrong with it
+        const char *check(const char *filename, bool has_crc, uint32_t expected_crc);
+        const char *stage(const char *filename);
+        void program() __attribute__ ((noreturn));
+
+        uint32_t get_size() const { return size; }
+        uint32_t get_crc() const { return crc; }
+        int get_changed_sectors() const;
+        uint32_t get_changed_bytes() const;
+
+        static const uint32_t image_base= 0x4000;
+        static const uint32_t flash_end= 0x80000;
+
+    private:
+        // programmed 4K at a time, the most the IAP copies at once, so a 32K sector needs no run of RAM that long
+        static const uint32_t piece_size= 4096;
+        struct sector_t {
+            uint32_t address;
+            uint32_t number;
+            uint32_t pieces;
+            uint32_t *piece[8];
+        };
+
+        static uint32_t sector_number(uint32_t address);
+        static uint32_t sector_start(uint32_t number);
+        static uint32_t sector_size(uint32_t number);
+        static void program_sectors(const sector_t *sectors, uint32_t n, uint32_t cclk_khz) __attribute__ ((noreturn));
+        void release();
+
+        std::vector<sector_t> staged;
+        uint32_t changed;           // a bit for each sector that differs
+        uint32_t size;
+        uint32_t crc;
+};
+
+#endif
@@ -127,22 +127,15 @@ template<class kind> void HeapRing<kind>::consume_tail()
  * queue status accessors
  */
 
+// head_i and tail_i are each only moved by one side and read in one go, so these do not need interrupts masked
 template<class kind> bool HeapRing<kind>::is_full()
 {
-    __disable_irq();
-    bool r = (next(head_i) == tail_i);
-    __enable_irq();
-
-    return r;
+    return next(head_i) == tail_i;
 }
 
 template<class kind> bool HeapRing<kind>::is_empty()
 {
-    __disable_irq();
-    bool r = (head_i == tail_i);
-    __enable_irq();
-
-    return r;
+    return head_i == tail_i;
 }
 
 /*
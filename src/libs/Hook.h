@@ -2,13 +2,16 @@
 #define HOOK_H
 #include "libs/FPointer.h"
 
+#include <stdint.h>
+
 // Hook is just a glorified FPointer
 
 class Hook : public FPointer {
     public:
         Hook();
-        int     interval;
-        int     countdown;
+        uint32_t interval;
+        uint32_t next;                  // SlowTicker timer count it is due at
+        uint32_t max_late;              // most timer counts it has been called after it was due
 };
 
 #endif
@@ -0,0 +1,121 @@
+#include "InputArbiter.h"
+
+#include "libs/Kernel.h"
+#include "Config.h"
+#include "ConfigValue.h"
+#include "checksumm.h"
+#include "Conveyor.h"
+#include "StreamOutput.h"
+#include "utils.h"
+#include "us_ticker_api.h"
+
+#include <string.h>
+#include <string>
+#include <algorithm>
+
+#define input_arbiter_checksum      CHECKSUM("input_arbiter")
+#define job_stream_checksum         CHECKSUM("job_stream")
+#define max_wait_ms_checksum        CHECKSUM("max_wait_ms")
+#define lines_per_loop_checksum     CHECKSUM("lines_per_loop")
+#define bytes_per_second_checksum   CHECKSUM("bytes_per_second")
+
+InputArbiter::InputArbiter()
+{
+    loop= 0;
+    job= -1;
+    std::string name= THEKERNEL->config->value(input_arbiter_checksum, job_stream_checksum)->by_default("")->as_string();
+    strncpy(job_name, name.c_str(), sizeof(job_name) - 1);
+    job_name[sizeof(job_name) - 1]= '\0';
+    limited= job_name[0] != '\0';
+    max_wait_us= THEKERNEL->config->value(input_arbiter_checksum, max_wait_ms_checksum)->by_default(250)->as_int() * 1000;
+}
+
+uint8_t InputArbiter::add_source(const char *name, std::function<bool(void)> pending)
+{
+    uint16_t cs= get_checksum(name);
+    source_t s;
+    s.name= name;
+    s.pending= pending;
+    s.lines_per_loop= THEKERNEL->config->value(input_arbiter_checksum, cs, lines_per_loop_checksum)->by_default(0)->as_int();
+    s.bytes_per_second= THEKERNEL->config->value(input_arbiter_checksum, cs, bytes_per_second_checksum)->by_default(0)->as_int();
+    s.tokens= s.bytes_per_second;
+    s.refilled_us= us_ticker_read();
+    s.waiting_since_us= 0;
+    s.lines= 0;
+    s.bytes= 0;
+    s.deferred= 0;
+    s.loop= 0;
+    s.loop_lines= 0;
+    if(s.lines_per_loop > 0 || s.bytes_per_second > 0) limited= true;
+
+    sources.push_back(s);
+    uint8_t id= sources.size() - 1;
+    if(strcmp(name, job_name) == 0) job= id;
+    return id;
+}
+
+// the job stream is being waited on to fill the queue
+bool InputArbiter::job_has_precedence(uint8_t source) const
+{
+    return job >= 0 && source != job && THEKERNEL->conveyor->is_queue_low() && sources[job].pending();
+}
+
+bool InputArbiter::may_take(uint8_t source)
+{
+    if(!limited) return true;
+    source_t &s= sources[source];
+    uint32_t now= us_ticker_read();
+
+    if(s.loop != loop) {
+        s.loop= loop;
+        s.loop_lines= 0;
+    }
+    if(s.lines_per_loop > 0 && s.loop_lines >= s.lines_per_loop) return false;
+
+    if(s.bytes_per_second > 0) {
+        // the bucket holds a second of bytes at most
+        uint32_t dt= now - s.refilled_us;
+        int32_t add= (uint64_t)dt * s.bytes_per_second / 1000000;
+        if(add > 0) {
+            s.tokens= std::min<int32_t>(s.tokens + add, s.bytes_per_second);
+            s.refilled_us+= (uint64_t)add * 1000000 / s.bytes_per_second;
+        }
+        if(s.tokens <= 0) return false;
+    }
+
+    if(job_has_precedence(source)) {
+        if(s.waiting_since_us == 0) {
+            s.waiting_since_us= now | 1;
+            ++s.deferred;
+        }
+        if(now - s.waiting_since_us < max_wait_us) return false;
+    }
+    return true;
+}
+
+void InputArbiter::took(uint8_t source, size_t bytes)
+{
+    source_t &s= sources[source];
+    ++s.lines;
+    s.bytes+= bytes;
+    if(!limited) return;
+    if(s.loop != loop) {
+        s.loop= loop;
+        s.loop_lines= 0;
+    }
+    ++s.loop_lines;
+    if(s.bytes_per_second > 0) s.tokens-= bytes;
+    s.waiting_since_us= 0;
+}
+
+void InputArbiter::print_stats(StreamOutput *stream) const
+{
+    for(size_t i= 0; i < sources.size(); i++) {
+        const source_t &s= sources[i];
+        stream->printf("%s%s: %lu lines, %lu bytes, held up %lu times", s.name, (int)i == job ? " (job)" : "",
+                       (unsigned long)s.lines, (unsigned long)s.bytes, (unsigned long)s.deferred);
+        if(s.lines_per_loop > 0) stream->printf(", %u lines a loop", s.lines_per_loop);
+        if(s.bytes_per_second > 0) stream->printf(", %lu bytes/s", (unsigned long)s.bytes_per_second);
+        stream->printf("\n");
+    }
+}
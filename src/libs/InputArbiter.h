@@ -0,0 +1,55 @@
+#ifndef INPUTARBITER_H
+#define INPUTARBITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <vector>
+
+class StreamOutput;
+
+// Shares the main loop out between the sources of lines, the serial console, the usb serials, the network and the
+// player. Each asks may_take() before it dispatches a line and says how long it was with took(). A source can be held
+// to input_arbiter.<name>.lines_per_loop lines each pass of the main loop and input_arbiter.<name>.bytes_per_second,
+// which it can save up a second of. While the planner queue is below its low watermark and the source named by
+// input_arbiter.job_stream has a line waiting, the others wait for it, but never for more than max_wait_ms so a
+// command from them still gets in. With none of that configured every line is taken as it was before.
+class InputArbiter {
+    public:
+        InputArbiter();
+
+        // the name is the one its settings are under, pending says whether it has a line waiting
+        uint8_t add_source(const char *name, std::function<bool(void)> pending);
+        bool may_take(uint8_t source);
+        void took(uint8_t source, size_t bytes);
+        // called as each pass of the main loop starts
+        void new_loop() { ++loop; }
+
+        void print_stats(StreamOutput *stream) const;
+
+    private:
+        struct source_t {
+            const char *name;
+            std::function<bool(void)> pending;
+            uint32_t bytes_per_second;      // 0 for no limit
+            int32_t tokens;                 // bytes it may still take, taking a line can leave it owing
+            uint32_t refilled_us;
+            uint32_t waiting_since_us;      // when the job stream first held it up, 0 when it is not waiting
+            uint32_t lines;
+            uint32_t bytes;
+            uint32_t deferred;              // times it was held up
+            uint32_t loop;                  // the pass loop_lines were taken in
+            uint16_t lines_per_loop;        // 0 for no limit
+            uint16_t loop_lines;
+        };
+        bool job_has_precedence(uint8_t source) const;
+
+        std::vector<source_t> sources;
+        uint32_t loop;
+        uint32_t max_wait_us;
+        int16_t job;                        // the source that goes first, -1 for none
+        bool limited;                       // some source has a limit, or there is a job stream
+        char job_name[24];
+};
+
+#endif
@@ -12,7 +12,13 @@
 #include "libs/SlowTicker.h"
 #include "libs/Adc.h"
 #include "libs/StreamOutputPool.h"
+#include "libs/FixedFormat.h"
+#include "libs/CycleProfile.h"
+#include "libs/LatencyStats.h"
+#include "libs/InputArbiter.h"
+#include "libs/AppendFileStream.h"
 #include <mri.h>
+#include "us_ticker_api.h"
 #include "checksumm.h"
 #include "ConfigValue.h"
 
@@ -33,6 +39,7 @@
 #include "platform_memory.h"
 
 #include <malloc.h>
+#include <algorithm>
 #include <array>
 #include <string>
 
@@ -42,18 +49,33 @@
 #define base_stepping_frequency_checksum            CHECKSUM("base_stepping_frequency")
 #define microseconds_per_step_pulse_checksum        CHECKSUM("microseconds_per_step_pulse")
 #define acceleration_ticks_per_second_checksum      CHECKSUM("acceleration_ticks_per_second")
+#define scheduled_stepping_checksum                 CHECKSUM("scheduled_stepping")
 #define disable_leds_checksum                       CHECKSUM("leds_disable")
 #define grbl_mode_checksum                          CHECKSUM("grbl_mode")
 #define ok_per_line_checksum                        CHECKSUM("ok_per_line")
+#define latency_log_file_checksum                   CHECKSUM("latency_log_file")
+#define idle_sleep_checksum                         CHECKSUM("idle_sleep")
 
 Kernel* Kernel::instance;
 
+// the cycles taken to call all the handlers of each event
+static CycleProfile *event_cycles[NUMBER_OF_DEFINED_EVENTS];
+
 // The kernel is the central point in Smoothie : it stores modules, and handles event calls
 Kernel::Kernel(){
     halted= false;
     feed_hold= false;
+    booted= false;
+    first_line= false;
 
     instance= this; // setup the Singleton instance of the kernel
+    running_module= nullptr;
+    running_event= 0;
+    latency= new LatencyStats();
+
+    for (int e = 0; e < NUMBER_OF_DEFINED_EVENTS; ++e) {
+        event_cycles[e]= new CycleProfile(kernel_event_names[e], "event");
+    }
 
     // serial first at fixed baud rate (DEFAULT_SERIAL_BAUD_RATE) so config can report errors to serial
 	// Set to UART0, this will be changed to use the same UART as MRI if it's enabled
@@ -63,7 +85,11 @@ Kernel::Kernel(){
     this->config = new Config();
 
     // Pre-load the config cache, do after setting up serial so we can report errors to serial
+    uint32_t t= us_ticker_read();
     this->config->config_cache_load();
+    this->config_load_us= us_ticker_read() - t;
+    this->boot_depth= 0;
+    boot_mark("config loaded");
 
     // now config is loaded we can do normal setup for serial based on config
     delete this->serial;
@@ -102,11 +128,26 @@ Kernel::Kernel(){
     this->use_leds= !this->config->value( disable_leds_checksum )->by_default(false)->as_bool();
     this->grbl_mode= this->config->value( grbl_mode_checksum )->by_default(false)->as_bool();
     this->ok_per_line= this->config->value( ok_per_line_checksum )->by_default(true)->as_bool();
+    this->idle_sleep= this->config->value( idle_sleep_checksum )->by_default(true)->as_bool();
+    this->sleeps= 0;
+
+    // append the queue starvations to a file as they happen
+    string latency_log= this->config->value( latency_log_file_checksum )->by_default("")->as_string();
+    if(!latency_log.empty()) {
+        this->latency->set_log_file(latency_log.c_str());
+    }
+
+    // the line sources add themselves as they are loaded
+    this->input_arbiter= new InputArbiter();
 
-    this->add_module( this->serial );
+    this->add_module( this->serial, "serial" );
 
     // HAL stuff
-    add_module( this->slow_ticker = new SlowTicker());
+    add_module( this->slow_ticker = new SlowTicker(), "slowticker");
+    if(this->idle_sleep) {
+        // the timed work in the main loop, like the flushes of the log files, is done within this of being due
+        this->slow_ticker->attach(idle_wake_hz, this, &Kernel::wake_tick);
+    }
 
     this->step_ticker = new StepTicker();
     this->adc = new(AHB0) Adc();
@@ -146,13 +187,14 @@ Kernel::Kernel(){
     this->step_ticker->set_reset_delay( microseconds_per_step_pulse );
     this->step_ticker->set_frequency( this->base_stepping_frequency );
     this->step_ticker->set_acceleration_ticks_per_second(acceleration_ticks_per_second); // must be set after set_frequency
+    this->step_ticker->set_scheduled(this->config->value(scheduled_stepping_checksum)->by_default(false)->as_bool());
 
     // Core modules
-    this->add_module( this->gcode_dispatch = new GcodeDispatch() );
-    this->add_module( this->robot          = new Robot()         );
-    this->add_module( this->stepper        = new Stepper()       );
-    this->add_module( this->conveyor       = new Conveyor()      );
-    this->add_module( this->simpleshell    = new SimpleShell()   );
+    this->add_module( this->gcode_dispatch = new GcodeDispatch(), "gcodedispatch" );
+    this->add_module( this->robot          = new Robot(),         "robot" );
+    this->add_module( this->stepper        = new Stepper(),       "stepper" );
+    this->add_module( this->conveyor       = new Conveyor(),      "conveyor" );
+    this->add_module( this->simpleshell    = new SimpleShell(),   "simpleshell" );
 
     this->planner = new(AHB0) Planner();
     this->configurator   = new Configurator();
@@ -161,92 +203,189 @@ Kernel::Kernel(){
 // return a GRBL-like query string for serial ?
 std::string Kernel::get_query_string()
 {
-    std::string str;
+    char buf[128];
+    format_query(buf, sizeof(buf));
+    return std::string(buf);
+}
+
+// format the GRBL-like query string into buf without allocating, returns its length
+size_t Kernel::format_query(char *buf, size_t size)
+{
     bool homing;
     bool ok = PublicData::get_value(endstops_checksum, get_homing_status_checksum, 0, &homing);
     if(!ok) homing= false;
     bool running= false;
 
-    str.append("<");
+    const char *state;
     if(halted) {
-        str.append("Alarm,");
+        state= "Alarm";
     }else if(homing) {
-        str.append("Home,");
+        state= "Home";
     }else if(feed_hold) {
-        str.append("Hold,");
+        state= "Hold";
     }else if(this->conveyor->is_queue_empty()) {
-        str.append("Idle,");
+        state= "Idle";
     }else{
         running= true;
-        str.append("Run,");
+        state= "Run";
     }
 
+    float mpos[3];
     if(running) {
-        // get real time current actuator position in mm
-        ActuatorCoordinates current_position{
-            robot->actuators[X_AXIS]->get_current_position(),
-            robot->actuators[Y_AXIS]->get_current_position(),
-            robot->actuators[Z_AXIS]->get_current_position()
-        };
-
-        // get machine position from the actuator position using FK
-        float mpos[3];
-        robot->arm_solution->actuator_to_cartesian(current_position, mpos);
-
-        char buf[128];
-        // machine position
-        size_t n= snprintf(buf, sizeof(buf), "%1.4f,%1.4f,%1.4f,", robot->from_millimeters(mpos[0]), robot->from_millimeters(mpos[1]), robot->from_millimeters(mpos[2]));
-        str.append("MPos:").append(buf, n);
-
-        // work space position
-        Robot::wcs_t pos= robot->mcs2wcs(mpos);
-        n= snprintf(buf, sizeof(buf), "%1.4f,%1.4f,%1.4f", robot->from_millimeters(std::get<X_AXIS>(pos)), robot->from_millimeters(std::get<Y_AXIS>(pos)), robot->from_millimeters(std::get<Z_AXIS>(pos)));
-        str.append("WPos:").append(buf, n);
-        str.append(">\r\n");
+        // get machine position from the real time actuator position using FK
+        robot->get_realtime_position(mpos);
 
     }else{
         // return the last milestone if idle
-        char buf[128];
-        // machine position
-        Robot::wcs_t mpos= robot->get_axis_position();
-        size_t n= snprintf(buf, sizeof(buf), "%1.4f,%1.4f,%1.4f,", robot->from_millimeters(std::get<X_AXIS>(mpos)), robot->from_millimeters(std::get<Y_AXIS>(mpos)), robot->from_millimeters(std::get<Z_AXIS>(mpos)));
-        str.append("MPos:").append(buf, n);
-
-        // work space position
-        Robot::wcs_t pos= robot->mcs2wcs(mpos);
-        n= snprintf(buf, sizeof(buf), "%1.4f,%1.4f,%1.4f", robot->from_millimeters(std::get<X_AXIS>(pos)), robot->from_millimeters(std::get<Y_AXIS>(pos)), robot->from_millimeters(std::get<Z_AXIS>(pos)));
-        str.append("WPos:").append(buf, n);
-        str.append(">\r\n");
-
+        Robot::wcs_t p= robot->get_axis_position();
+        mpos[X_AXIS]= std::get<X_AXIS>(p);
+        mpos[Y_AXIS]= std::get<Y_AXIS>(p);
+        mpos[Z_AXIS]= std::get<Z_AXIS>(p);
     }
-    return str;
+
+    // machine position then work space position
+    Robot::wcs_t pos= robot->mcs2wcs(mpos);
+    FixedFormat f(buf, size);
+    f.chr('<').str(state).str(",MPos:");
+    f.fixed(robot->from_millimeters(mpos[X_AXIS])).chr(',').fixed(robot->from_millimeters(mpos[Y_AXIS])).chr(',').fixed(robot->from_millimeters(mpos[Z_AXIS]));
+    f.str(",WPos:");
+    f.fixed(robot->from_millimeters(std::get<X_AXIS>(pos))).chr(',').fixed(robot->from_millimeters(std::get<Y_AXIS>(pos))).chr(',').fixed(robot->from_millimeters(std::get<Z_AXIS>(pos)));
+    f.str(">\r\n");
+    return f.length();
 }
 
-// Add a module to Kernel. We don't actually hold a list of modules we just call its on_module_loaded
-void Kernel::add_module(Module* module){
+// Add a module to Kernel. We don't actually hold a list of modules we just call its on_module_loaded, timing how long it takes
+void Kernel::add_module(Module* module, const char *name){
+    size_t i= boot_times.size();
+    boot_times.push_back({module, name, 0, boot_depth, false});
+    ++boot_depth;
+    uint32_t t= us_ticker_read();
     module->on_module_loaded();
+    boot_times[i].us= us_ticker_read() - t;
+    --boot_depth;
 }
 
 // Adds a hook for a given module and event
 void Kernel::register_for_event(_EVENT_ENUM id_event, Module *mod){
-    this->hooks[id_event].push_back(mod);
+    this->hooks[id_event].push_back({mod, 0, 0, 0, 0, false, false, PRIORITY_NORMAL});
 }
 
 // Call a specific event with an argument
 void Kernel::call_event(_EVENT_ENUM id_event, void * argument){
+    uint32_t cycles= event_cycles[id_event]->begin();
+    // only the main loop is followed, some events are called from the step interrupts
+    bool main_loop= ((SCB->ICSR & 0x1FF) == 0); // VECTACTIVE, 0 when not in an interrupt
+    uint32_t idle_start= (main_loop && id_event == ON_IDLE) ? us_ticker_read() : 0;
     if(id_event == ON_HALT) {
         this->halted= (argument == nullptr);
+        // the logs are written out so they show what led up to it
+        if(this->halted) AppendFileStream::flush_all(main_loop);
+    }
+    if(id_event == ON_CONSOLE_LINE_RECEIVED && booted && !first_line) {
+        first_line= true;
+        boot_mark("first line received");
+    }
+    if(id_event == ON_MAIN_LOOP) input_arbiter->new_loop();
+    bool feeding= main_loop && (id_event == ON_IDLE || id_event == ON_MAIN_LOOP) && is_feeding();
+    for (auto &h : hooks[id_event]) {
+        uint32_t t= us_ticker_read();
+        if(h.woken) {
+            h.woken= false;
+
+        } else if(h.wake_only || (h.interval_ms != 0 && t - h.last_us < h.interval_ms * 1000UL)) {
+            // nothing for it to do yet
+            continue;
+
+        } else if(feeding && h.priority == PRIORITY_HOUSEKEEPING && t - h.last_us < housekeeping_defer_ms * 1000UL) {
+            // it can wait until the queue has caught up
+            continue;
+        }
+        h.last_us= t;
+
+        if(main_loop) {
+            Module *last_module= running_module;
+            uint8_t last_event= running_event;
+            running_event= id_event;
+            running_module= h.module;
+            (h.module->*kernel_callback_functions[id_event])(argument);
+            running_module= last_module;
+            running_event= last_event;
+        } else {
+            (h.module->*kernel_callback_functions[id_event])(argument);
+        }
+
+        h.total_us += us_ticker_read() - t;
+        ++h.calls;
+    }
+    if(main_loop && id_event == ON_IDLE) {
+        latency->add_idle(us_ticker_read() - idle_start);
+    }
+    event_cycles[id_event]->end(cycles);
+}
+
+bool Kernel::is_input_pending() const
+{
+    for (auto &c : input_checks) {
+        if(c()) return true;
+    }
+    return false;
+}
+
+// WFI is taken with the interrupts off, so an interrupt that comes while the checks are made still wakes it, and is
+// then run as they are turned back on. It is the sleep mode where the peripherals and their interrupts go on as before
+void Kernel::sleep_if_idle()
+{
+    if(!idle_sleep || !deferred_inits.empty()) return;
+
+    __disable_irq();
+    bool busy= is_input_pending();
+    for (auto &c : busy_checks) {
+        if(busy) break;
+        busy= c();
     }
-    for (auto m : hooks[id_event]) {
-        (m->*kernel_callback_functions[id_event])(argument);
+    if(!busy) {
+        __WFI();
+        ++sleeps;
+    }
+    __enable_irq();
+}
+
+void Kernel::boot_mark(const char *what)
+{
+    boot_marks.push_back({what, us_ticker_read()});
+}
+
+// called each pass of the main loop, the inits put off are done one a pass so the lines received in between are seen to
+void Kernel::run_deferred_init()
+{
+    booted= true;
+    if(deferred_inits.empty()) return;
+
+    auto d= deferred_inits.front();
+    deferred_inits.erase(deferred_inits.begin());
+    size_t i= boot_times.size();
+    boot_times.push_back({d.first, get_module_name(d.first), 0, boot_depth, true});
+    ++boot_depth;
+    uint32_t t= us_ticker_read();
+    d.second();
+    boot_times[i].us= us_ticker_read() - t;
+    --boot_depth;
+    if(deferred_inits.empty()) boot_mark("deferred inits done");
+}
+
+const char *Kernel::get_module_name(const Module *module) const
+{
+    for (auto &b : boot_times) {
+        if(b.module == module) return b.name;
     }
+    return nullptr;
 }
 
 // These are used by tests to test for various things. basically mocks
 bool Kernel::kernel_has_event(_EVENT_ENUM id_event, Module *mod)
 {
-    for (auto m : hooks[id_event]) {
-        if(m == mod) return true;
+    for (auto &h : hooks[id_event]) {
+        if(h.module == mod) return true;
     }
     return false;
 }
@@ -254,10 +393,69 @@ bool Kernel::kernel_has_event(_EVENT_ENUM id_event, Module *mod)
 void Kernel::unregister_for_event(_EVENT_ENUM id_event, Module *mod)
 {
     for (auto i = hooks[id_event].begin(); i != hooks[id_event].end(); ++i) {
-        if(*i == mod) {
+        if(i->module == mod) {
             hooks[id_event].erase(i);
             return;
         }
     }
 }
 
+void Kernel::set_event_rate(_EVENT_ENUM id_event, Module *mod, uint16_t interval_ms, bool wake_only)
+{
+    for (auto &h : hooks[id_event]) {
+        if(h.module == mod) {
+            h.interval_ms= interval_ms;
+            h.wake_only= wake_only;
+        }
+    }
+}
+
+// the feeders go first, otherwise the handlers stay in the order they registered in
+void Kernel::set_event_priority(_EVENT_ENUM id_event, Module *mod, EVENT_PRIORITY priority)
+{
+    auto &v= hooks[id_event];
+    for (auto &h : v) {
+        if(h.module == mod) h.priority= priority;
+    }
+    std::stable_sort(v.begin(), v.end(), [](const hook_t &a, const hook_t &b) {
+        return (a.priority == PRIORITY_FEED && b.priority != PRIORITY_FEED) || (a.priority != PRIORITY_HOUSEKEEPING && b.priority == PRIORITY_HOUSEKEEPING);
+    });
+}
+
+// the planner queue is running low while there are lines waiting to become moves
+bool Kernel::is_feeding() const
+{
+    return conveyor != nullptr && conveyor->is_queue_low() && is_input_pending();
+}
+
+// safe to call from an interrupt, the handler is called the next time the event is
+void Kernel::wake_for_event(_EVENT_ENUM id_event, Module *mod)
+{
+    for (auto &h : hooks[id_event]) {
+        if(h.module == mod) h.woken= true;
+    }
+}
+
+// every handler that has been called, named as the module was when it was added
+std::vector<Kernel::event_profile_t> Kernel::get_event_profile() const
+{
+    std::vector<event_profile_t> profile;
+    for (int e = 0; e < NUMBER_OF_DEFINED_EVENTS; ++e) {
+        for (auto &h : hooks[e]) {
+            if(h.calls == 0) continue;
+            profile.push_back({(_EVENT_ENUM)e, get_module_name(h.module), h.total_us, h.calls});
+        }
+    }
+    return profile;
+}
+
+void Kernel::reset_event_profile()
+{
+    for (auto &e : hooks) {
+        for (auto &h : e) {
+            h.total_us= 0;
+            h.calls= 0;
+        }
+    }
+}
+
@@ -14,6 +14,7 @@
 #include <array>
 #include <vector>
 #include <string>
+#include <functional>
 
 //Module manager
 class Config;
@@ -31,6 +32,8 @@ class Adc;
 class PublicData;
 class SimpleShell;
 class Configurator;
+class LatencyStats;
+class InputArbiter;
 
 class Kernel {
     public:
@@ -38,13 +41,30 @@ class Kernel {
         static Kernel* instance; // the Singleton instance of Kernel usable anywhere
         const char* config_override_filename(){ return "/sd/config-override"; }
 
-        void add_module(Module* module);
+        void add_module(Module* module, const char *name= nullptr);
         void register_for_event(_EVENT_ENUM id_event, Module *module);
         void call_event(_EVENT_ENUM id_event, void * argument= nullptr);
 
         bool kernel_has_event(_EVENT_ENUM id_event, Module *module);
         void unregister_for_event(_EVENT_ENUM id_event, Module *module);
 
+        // see Module::set_event_rate() and Module::wake_for_event()
+        void set_event_rate(_EVENT_ENUM id_event, Module *module, uint16_t interval_ms, bool wake_only);
+        void wake_for_event(_EVENT_ENUM id_event, Module *module);
+        void set_event_priority(_EVENT_ENUM id_event, Module *module, EVENT_PRIORITY priority);
+        // the longest housekeeping handlers are put off for while the planner is being fed
+        static const uint16_t housekeeping_defer_ms= 50;
+
+        // time spent in each handler, includes any events called from within it
+        struct event_profile_t {
+            _EVENT_ENUM event;
+            const char *name;
+            uint32_t us;
+            uint32_t calls;
+        };
+        std::vector<event_profile_t> get_event_profile() const;
+        void reset_event_profile();
+
         bool is_using_leds() const { return use_leds; }
         bool is_halted() const { return halted; }
         bool is_grbl_mode() const { return grbl_mode; }
@@ -54,6 +74,46 @@ class Kernel {
         bool get_feed_hold() const { return feed_hold; }
 
         std::string get_query_string();
+        size_t format_query(char *buf, size_t size);
+
+        // how long each module took in on_module_loaded, in the order they were loaded
+        struct boot_time_t {
+            Module *module;
+            const char *name;
+            uint32_t us;
+            uint8_t depth;                  // modules added while another module is loading are one deeper
+            bool deferred;                  // the part of its init it put off until the main loop was running
+        };
+        const std::vector<boot_time_t>& get_boot_times() const { return boot_times; }
+        // when each step of the boot was done, in us since the ticker started as the kernel was made
+        struct boot_mark_t {
+            const char *what;
+            uint32_t us;
+        };
+        void boot_mark(const char *what);
+        const std::vector<boot_mark_t>& get_boot_marks() const { return boot_marks; }
+        // work that can wait until the console answers, like bringing up the network, is done one a pass of the main
+        // loop once it is running, the config cache is gone by then so it has to be read in on_module_loaded
+        void defer_init(Module *module, std::function<void(void)> init) { deferred_inits.push_back({module, init}); }
+        void run_deferred_init();
+        uint32_t get_config_load_time() const { return config_load_us; }
+        // the name it was added with, nullptr if none
+        const char *get_module_name(const Module *module) const;
+
+        // the handler the main loop is in, module is nullptr between handlers
+        // safe to call from an interrupt, the two can be from different handlers if it is called right as one returns
+        _EVENT_ENUM get_running_event() const { return (_EVENT_ENUM)running_event; }
+        Module *get_running_module() const { return running_module; }
+
+        // line sources add a check for input waiting to be read, it is called from the step interrupts
+        void add_input_check(std::function<bool(void)> check) { input_checks.push_back(check); }
+        bool is_input_pending() const;
+
+        // the main loop sleeps until the next interrupt while no module has work waiting, a module whose work is not
+        // made by an interrupt adds a check that says when it has some. The SlowTicker wakes it at least idle_wake_hz
+        void add_busy_check(std::function<bool(void)> check) { busy_checks.push_back(check); }
+        void sleep_if_idle();
+        uint32_t get_sleeps() const { return sleeps; }
 
         // These modules are available to all other modules
         SerialConsole*    serial;
@@ -71,19 +131,47 @@ class Kernel {
         SlowTicker*       slow_ticker;
         StepTicker*       step_ticker;
         Adc*              adc;
+        LatencyStats*     latency;
+        InputArbiter*     input_arbiter;
         std::string       current_path;
         uint32_t          base_stepping_frequency;
         uint32_t          acceleration_ticks_per_second;
 
     private:
         // When a module asks to be called for a specific event ( a hook ), this is where that request is remembered
-        std::array<std::vector<Module*>, NUMBER_OF_DEFINED_EVENTS> hooks;
+        struct hook_t {
+            Module *module;
+            uint32_t last_us;               // when it was last called, only kept with an interval
+            uint32_t total_us;
+            uint32_t calls;
+            uint16_t interval_ms;           // 0 to be called every time
+            bool wake_only;                 // only called after wake_for_event()
+            volatile bool woken;
+            uint8_t priority;               // EVENT_PRIORITY
+        };
+        bool is_feeding() const;
+        std::array<std::vector<hook_t>, NUMBER_OF_DEFINED_EVENTS> hooks;
+        std::vector<boot_time_t> boot_times;
+        std::vector<boot_mark_t> boot_marks;
+        std::vector<std::pair<Module *, std::function<void(void)>>> deferred_inits;
+        std::vector<std::function<bool(void)>> input_checks;
+        std::vector<std::function<bool(void)>> busy_checks;
+        uint32_t wake_tick(uint32_t dummy) { return 0; }
+        static const uint32_t idle_wake_hz= 100;
+        uint32_t sleeps;
+        Module * volatile running_module;
+        volatile uint8_t running_event;
+        uint32_t config_load_us;
+        uint8_t boot_depth;
         struct {
             bool use_leds:1;
             bool halted:1;
             bool grbl_mode:1;
             bool feed_hold:1;
             bool ok_per_line:1;
+            bool booted:1;                  // the main loop is running
+            bool first_line:1;              // a line has been received since
+            bool idle_sleep:1;
         };
 
 };
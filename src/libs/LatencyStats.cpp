@@ -0,0 +1,104 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LatencyStats.h"
+#include "Kernel.h"
+#include "StreamOutput.h"
+#include "AppendFileStream.h"
+
+#include "us_ticker_api.h"
+
+#include <string.h>
+
+LatencyStats::LatencyStats()
+{
+    log= nullptr;
+    reset();
+}
+
+void LatencyStats::reset()
+{
+    memset(&main_loop, 0, sizeof(main_loop));
+    memset(&idle, 0, sizeof(idle));
+    starve_count= 0;
+    logged_count= 0;
+}
+
+void LatencyStats::set_log_file(const char *filename)
+{
+    delete log;
+    // buffered so logging does not hold up the main loop while printing, it is written out every second
+    log= new AppendFileStream(filename, 512);
+}
+
+void LatencyStats::starved(_EVENT_ENUM event, Module *module)
+{
+    starve_t &s= starves[starve_count % max_starves];
+    s.us= us_ticker_read();
+    s.module= module;
+    s.event= event;
+    starve_count= starve_count + 1;
+}
+
+static const char *handler_name(Module *module)
+{
+    const char *name= THEKERNEL->get_module_name(module);
+    return name != nullptr ? name : "unknown";
+}
+
+void LatencyStats::flush_log()
+{
+    if(log == nullptr || logged_count == starve_count) return;
+
+    uint32_t n= starve_count;
+    // any that were overwritten before they could be written are only counted
+    if(n - logged_count > max_starves) {
+        log->printf("%lu queue starvations not logged\n", n - logged_count - max_starves);
+        logged_count= n - max_starves;
+    }
+    for (; logged_count != n; ++logged_count) {
+        const starve_t &s= starves[logged_count % max_starves];
+        if(s.module == nullptr) {
+            log->printf("%lu ms: queue starved between handlers\n", s.us / 1000);
+        } else {
+            log->printf("%lu ms: queue starved in %s %s\n", s.us / 1000, kernel_event_names[s.event], handler_name(s.module));
+        }
+    }
+}
+
+void LatencyStats::histogram_t::print(StreamOutput *stream, const char *name) const
+{
+    uint32_t total= 0;
+    for (int i = 0; i < buckets; ++i) total += counts[i];
+    stream->printf("%s: %lu passes, max %lu us\n", name, total, max_us);
+    for (int i = 0; i < buckets; ++i) {
+        if(counts[i] == 0) continue;
+        if(i == buckets - 1) {
+            stream->printf(" >=%lu us: %lu\n", 1UL << (i - 1), counts[i]);
+        } else {
+            stream->printf(" <%lu us: %lu\n", 1UL << i, counts[i]);
+        }
+    }
+}
+
+void LatencyStats::print(StreamOutput *stream) const
+{
+    main_loop.print(stream, "main loop");
+    idle.print(stream, "on_idle");
+
+    uint32_t n= starve_count;
+    stream->printf("queue starved with input waiting: %lu times\n", n);
+    uint32_t now= us_ticker_read();
+    for (uint32_t i = (n > max_starves) ? n - max_starves : 0; i < n; ++i) {
+        const starve_t &s= starves[i % max_starves];
+        if(s.module == nullptr) {
+            stream->printf(" %lu ms ago between handlers\n", (now - s.us) / 1000);
+        } else {
+            stream->printf(" %lu ms ago in %s %s\n", (now - s.us) / 1000, kernel_event_names[s.event], handler_name(s.module));
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include "Module.h"
+
+#include <stdint.h>
+
+class StreamOutput;
+class AppendFileStream;
+
+// How long each pass of the main loop and of on_idle took, in log2 buckets of microseconds, and the times the queue
+// ran dry while a line source still had input waiting, with the handler the main loop was in when it did.
+class LatencyStats {
+    public:
+        LatencyStats();
+
+        void add_main_loop(uint32_t us) { main_loop.add(us); }
+        void add_idle(uint32_t us) { idle.add(us); }
+
+        // called from the step interrupts when the last block finished
+        void starved(_EVENT_ENUM event, Module *module);
+        // writes the starvations since the last call to the log file if there is one, from the main loop
+        void flush_log();
+        void set_log_file(const char *filename);
+
+        void print(StreamOutput *stream) const;
+        void reset();
+
+    private:
+        struct histogram_t {
+            // bucket 0 is 0us, bucket n is [2^(n-1), 2^n) and the last is everything longer
+            static const int buckets= 16;
+            uint32_t counts[buckets];
+            uint32_t max_us;
+
+            void add(uint32_t us)
+            {
+                int b= (us == 0) ? 0 : 32 - __builtin_clz(us);
+                ++counts[b < buckets ? b : buckets - 1];
+                if(us > max_us) max_us= us;
+            }
+            void print(StreamOutput *stream, const char *name) const;
+        };
+
+        // the last few, older ones are only counted
+        struct starve_t {
+            uint32_t us;                    // us_ticker_read() when it happened
+            Module *module;
+            uint8_t event;
+        };
+        static const uint8_t max_starves= 8;
+
+        histogram_t main_loop;
+        histogram_t idle;
+        starve_t starves[max_starves];
+        volatile uint32_t starve_count;
+        uint32_t logged_count;
+        AppendFileStream *log;
+};
+
+#endif
@@ -42,6 +42,8 @@ MemoryPool::MemoryPool(void* base, uint16_t size)
 {
     this->base = base;
     this->size = size;
+    this->used = 0;
+    this->peak = 0;
 
     ((_poolregion*) base)->used = 0;
     ((_poolregion*) base)->next = size;
@@ -121,6 +123,10 @@ void* MemoryPool::alloc(size_t nbytes)
                 }
             }
 
+            used += p->next;
+            if (used > peak)
+                peak = used;
+
             // then return the data region for the block
             return &p->data;
         }
@@ -139,6 +145,7 @@ void MemoryPool::dealloc(void* d)
 {
     _poolregion* p = (_poolregion*) (((uint8_t*) d) - sizeof(_poolregion));
     p->used = 0;
+    used -= p->next;
 
     MDEBUG("\tdeallocating %p (%+d, %db)\n", p, offset(p), p->next);
 
@@ -242,3 +249,21 @@ uint32_t MemoryPool::free()
         p = (_poolregion*) (((uint8_t*) p) + p->next);
     } while (1);
 }
+
+// the biggest free chunk including its header, an allocation up to that less the header will still succeed
+uint32_t MemoryPool::largest_free()
+{
+    uint32_t largest = 0;
+
+    _poolregion* p = (_poolregion*) base;
+
+    do {
+        if (p->used == 0 && p->next > largest)
+            largest = p->next;
+        if (offset(p) + p->next >= size)
+            return largest;
+        if (p->next <= sizeof(_poolregion))
+            return largest;
+        p = (_poolregion*) (((uint8_t*) p) + p->next);
+    } while (1);
+}
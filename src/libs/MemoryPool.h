@@ -33,6 +33,12 @@ public:
     bool  has(void*);
 
     uint32_t free(void);
+    uint32_t largest_free(void);
+
+    // bytes allocated including the chunk headers, and the most that has been allocated at once
+    uint32_t get_used(void) const { return used; }
+    uint32_t get_peak(void) const { return peak; }
+    uint16_t get_size(void) const { return size; }
 
     MemoryPool* next;
 
@@ -41,6 +47,8 @@ public:
 private:
     void* base;
     uint16_t size;
+    uint16_t used;
+    uint16_t peak;
 };
 
 // this overloads "placement new"
@@ -55,4 +63,16 @@ inline void  operator delete(void* p, MemoryPool& pool)
     pool.dealloc(p);
 }
 
+// array versions, declared nothrow so the compiler checks for a NULL return before running the constructors
+// the array can then be freed with delete [] as operator delete checks the pools
+inline void* operator new[](size_t nbytes, MemoryPool& pool) throw()
+{
+    return pool.alloc(nbytes);
+}
+
+inline void  operator delete[](void* p, MemoryPool& pool)
+{
+    pool.dealloc(p);
+}
+
 #endif /* _MEMORYPOOL_H */
@@ -0,0 +1,177 @@
+#include "ModbusRTU.h"
+
+#include "libs/Kernel.h"
+#include "SlowTicker.h"
+#include "Serial.h" // mbed
+#include "port_api.h" // mbed
+#include "us_ticker_api.h"
+#include "cmsis.h"
+
+ModbusRTU::ModbusRTU(Pin &tx, Pin &rx, Pin &dir, int baud, uint32_t timeout_ms) : dir(dir)
+{
+    wr= sent= rd= 0;
+    state= IDLE;
+    reply_len= 0;
+    errors= 0;
+    // 11 bits a character as the standard has it, with parity or two stop bits
+    char_us= 11000000 / baud + 1;
+    timeout_us= timeout_ms * 1000;
+    until_us= us_ticker_read();
+
+    this->dir.as_output();
+    this->dir.set(false);
+    uart= new mbed::Serial(port_pin((PortName)tx.port_number, tx.pin), port_pin((PortName)rx.port_number, rx.pin));
+    uart->baud(baud);
+    uart->attach(this, &ModbusRTU::on_rx, mbed::Serial::RxIrq);
+    THEKERNEL->slow_ticker->attach(1000, this, &ModbusRTU::tick);
+}
+
+bool ModbusRTU::read_register(uint8_t slave, uint16_t reg, callback_t callback)
+{
+    return queue(slave, read_holding_registers, reg, 1, callback);
+}
+
+bool ModbusRTU::write_register(uint8_t slave, uint16_t reg, uint16_t value, callback_t callback)
+{
+    return queue(slave, write_single_register, reg, value, callback);
+}
+
+bool ModbusRTU::queue(uint8_t slave, uint8_t function, uint16_t reg, uint16_t value, callback_t callback)
+{
+    uint8_t next= (wr + 1) % queue_size;
+    if(next == rd) return false;
+
+    Request &r= requests[wr];
+    r.callback= callback;
+    r.slave= slave;
+    r.function= function;
+    r.reg= reg;
+    r.value= value;
+    r.ok= false;
+    wr= next; // the tick can send it now
+    return true;
+}
+
+// the callbacks of the requests that are done, in the order they were queued
+void ModbusRTU::dispatch()
+{
+    while(rd != sent) {
+        Request &r= requests[rd];
+        if(r.callback) r.callback(r.ok, r.value);
+        r.callback= nullptr;
+        rd= (rd + 1) % queue_size;
+    }
+}
+
+uint32_t ModbusRTU::tick(uint32_t dummy)
+{
+    uint32_t now= us_ticker_read();
+    if((int32_t)(now - until_us) < 0) return 0;
+
+    __disable_irq();
+    until_us= now; // kept up to date so a long idle spell does not wrap round
+    if(state == IDLE && sent != wr) {
+        Request &r= requests[sent];
+        size_t n= build_request(frame, r.slave, r.function, r.reg, r.value);
+        dir.set(true);
+        for(size_t i= 0; i < n; ++i) uart->putc(frame[i]); // the FIFO takes 16, this does not wait
+        until_us= now + (n + 1) * char_us;
+        state= SENDING;
+
+    } else if(state == SENDING) {
+        // the last character is out, anything heard while sending was our own echo
+        dir.set(false);
+        reply_len= 0;
+        until_us= now + timeout_us;
+        state= WAITING;
+
+    } else if(state == WAITING) {
+        finish(false, 0); // no answer
+    }
+    __enable_irq();
+    return 0;
+}
+
+void ModbusRTU::on_rx()
+{
+    while(uart->readable()) {
+        uint8_t c= uart->getc();
+        if(state != WAITING || reply_len >= sizeof(reply)) continue;
+        reply[reply_len++]= c;
+
+        Request &r= requests[sent];
+        uint16_t value;
+        int result= parse_reply(reply, reply_len, r.slave, r.function, value);
+        if(result != 0) {
+            __disable_irq();
+            if(state == WAITING) finish(result > 0, value);
+            __enable_irq();
+        }
+    }
+}
+
+// called with the interrupts off
+void ModbusRTU::finish(bool ok, uint16_t value)
+{
+    Request &r= requests[sent];
+    r.ok= ok;
+    if(ok) r.value= value;
+    else ++errors;
+    sent= (sent + 1) % queue_size;
+    state= IDLE;
+
+    // the silence of 3.5 characters that ends a frame, fixed at 1750us above 19200 baud
+    uint32_t gap= char_us * 7 / 2;
+    until_us= us_ticker_read() + (gap < 1750 ? 1750 : gap);
+}
+
+uint16_t ModbusRTU::crc16(const uint8_t *data, size_t n)
+{
+    uint16_t crc= 0xFFFF;
+    for(size_t i= 0; i < n; ++i) {
+        crc^= data[i];
+        for(int b= 0; b < 8; ++b) crc= (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    }
+    return crc;
+}
+
+// both functions used have the same request, the register then the count to read or the value to write
+size_t ModbusRTU::build_request(uint8_t *frame, uint8_t slave, uint8_t function, uint16_t reg, uint16_t value)
+{
+    frame[0]= slave;
+    frame[1]= function;
+    frame[2]= reg >> 8;
+    frame[3]= reg & 0xFF;
+    frame[4]= value >> 8;
+    frame[5]= value & 0xFF;
+    uint16_t crc= crc16(frame, 6);
+    frame[6]= crc & 0xFF; // the CRC goes low byte first
+    frame[7]= crc >> 8;
+    return 8;
+}
+
+int ModbusRTU::parse_reply(const uint8_t *frame, size_t n, uint8_t slave, uint8_t function, uint16_t &value)
+{
+    if(n < 2) return 0;
+    if(frame[0] != slave) return -1;
+
+    size_t len;
+    if(frame[1] == (function | 0x80)) len= 5; // an exception, with its code
+    else if(frame[1] != function) return -1;
+    else if(function == read_holding_registers) {
+        if(n < 3) return 0;
+        len= 5 + frame[2];
+    } else len= 8; // the echo of the request
+
+    if(n < len) return 0;
+    if(crc16(frame, len - 2) != (frame[len - 2] | frame[len - 1] << 8)) return -1;
+    if(frame[1] & 0x80) return -1;
+
+    if(function == read_holding_registers) {
+        if(frame[2] < 2) return -1;
+        value= frame[3] << 8 | frame[4];
+    } else {
+        value= frame[4] << 8 | frame[5];
+    }
+    return 1;
+}
@@ -0,0 +1,72 @@
+#ifndef MODBUSRTU_H
+#define MODBUSRTU_H
+
+#include "Pin.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+
+namespace mbed {
+    class Serial;
+}
+
+// A Modbus RTU master on one of the UARTs, for RS485 devices such as spindle VFDs. Requests are queued and the main
+// loop goes on: a 1kHz SlowTicker hook sends the next one when the line is free, the frame fits in the UART FIFO so
+// nothing waits for it to go, turns the line round once it is out and times out a device that does not answer, the
+// receive interrupt collects the reply. The callback of each request is called from dispatch() in the main loop.
+class ModbusRTU {
+    public:
+        typedef std::function<void(bool ok, uint16_t value)> callback_t;
+
+        ModbusRTU(Pin &tx, Pin &rx, Pin &dir, int baud, uint32_t timeout_ms);
+
+        // false when the queue is full, the value given to the callback is the register read or the one written
+        bool read_register(uint8_t slave, uint16_t reg, callback_t callback);
+        bool write_register(uint8_t slave, uint16_t reg, uint16_t value, callback_t callback= nullptr);
+        void dispatch();
+        bool is_idle() const { return rd == wr; }
+        uint32_t get_errors() const { return errors; }
+
+        static const uint8_t read_holding_registers= 0x03;
+        static const uint8_t write_single_register= 0x06;
+
+        // the framing, which does not need the UART
+        static uint16_t crc16(const uint8_t *data, size_t n);
+        static size_t build_request(uint8_t *frame, uint8_t slave, uint8_t function, uint16_t reg, uint16_t value);
+        // 0 while more of the reply is to come, 1 when it is complete and good, -1 for an exception or a bad reply
+        static int parse_reply(const uint8_t *frame, size_t n, uint8_t slave, uint8_t function, uint16_t &value);
+
+    private:
+        bool queue(uint8_t slave, uint8_t function, uint16_t reg, uint16_t value, callback_t callback);
+        uint32_t tick(uint32_t dummy);
+        void on_rx();
+        void finish(bool ok, uint16_t value);
+
+        struct Request {
+            callback_t callback;
+            uint16_t reg;
+            uint16_t value;
+            uint8_t slave;
+            uint8_t function;
+            bool ok;
+        };
+        static const uint8_t queue_size= 8;
+        Request requests[queue_size];
+        volatile uint8_t wr;            // where the main loop queues the next one
+        volatile uint8_t sent;          // the one on the line, the ones from rd up to it are done
+        uint8_t rd;                     // the next one for dispatch
+
+        mbed::Serial *uart;
+        Pin dir;
+        enum { IDLE, SENDING, WAITING } volatile state;
+        uint32_t char_us;               // the time of one character on the line
+        uint32_t timeout_us;
+        uint32_t until_us;              // when the frame is out, the reply is late, or the line is free again
+        uint8_t frame[8];
+        uint8_t reply[16];
+        uint8_t reply_len;
+        volatile uint32_t errors;
+};
+
+#endif
@@ -7,9 +7,13 @@
 
 #include "libs/Module.h"
 #include "libs/Kernel.h"
+#include "PublicData.h"
 
 Module::Module(){}
-Module::~Module(){}
+Module::~Module()
+{
+    PublicData::unregister_handlers(this);
+}
 
 // this is used to callback the specific method in the Module instance, there must be one for each _EVENT_ENUM and in the same order
 // NOTE this is stored in Flash so takes up no RAM
@@ -26,8 +30,26 @@ const ModuleCallback kernel_callback_functions[NUMBER_OF_DEFINED_EVENTS] = {
     &Module::on_get_public_data,
     &Module::on_set_public_data,
     &Module::on_halt,
-    &Module::on_enable
+    &Module::on_enable,
+    &Module::on_config_changed
+};
 
+// in the same order too, for get profile
+const char * const kernel_event_names[NUMBER_OF_DEFINED_EVENTS] = {
+    "main_loop",
+    "console_line_received",
+    "gcode_received",
+    "gcode_execute",
+    "speed_change",
+    "block_begin",
+    "block_end",
+    "idle",
+    "second_tick",
+    "get_public_data",
+    "set_public_data",
+    "halt",
+    "enable",
+    "config_changed"
 };
 
 
@@ -36,3 +58,15 @@ void Module::register_for_event(_EVENT_ENUM event_id){
     // You add things to Smoothie by making a new class that inherits the Module class. See http://smoothieware.org/moduleexample for a crude introduction
     THEKERNEL->register_for_event(event_id, this);
 }
+
+void Module::set_event_rate(_EVENT_ENUM event_id, uint16_t interval_ms, bool wake_only){
+    THEKERNEL->set_event_rate(event_id, this, interval_ms, wake_only);
+}
+
+void Module::set_event_priority(_EVENT_ENUM event_id, EVENT_PRIORITY priority){
+    THEKERNEL->set_event_priority(event_id, this, priority);
+}
+
+void Module::wake_for_event(_EVENT_ENUM event_id){
+    THEKERNEL->wake_for_event(event_id, this);
+}
@@ -8,6 +8,8 @@
 #ifndef MODULE_H
 #define MODULE_H
 
+#include <stdint.h>
+
 // See : http://smoothieware.org/listofevents
 // When adding a new event the virtual method needs to be defined in class Module and the method pointer need to be defined in
 // Module.cpp:16 in the same order
@@ -25,12 +27,21 @@ enum _EVENT_ENUM {
     ON_SET_PUBLIC_DATA,
     ON_HALT,
     ON_ENABLE,
+    ON_CONFIG_CHANGED,
     NUMBER_OF_DEFINED_EVENTS
 };
 
+// the order of the handlers of an event, and which ones can wait, see Module::set_event_priority()
+enum EVENT_PRIORITY {
+    PRIORITY_NORMAL,
+    PRIORITY_FEED,          // reads the lines that become moves, called before the others
+    PRIORITY_HOUSEKEEPING   // put off while the planner queue is running low and there are lines to read
+};
+
 class Module;
 typedef void (Module::*ModuleCallback)(void *argument);
 extern const ModuleCallback kernel_callback_functions[NUMBER_OF_DEFINED_EVENTS];
+extern const char * const kernel_event_names[NUMBER_OF_DEFINED_EVENTS];
 
 // Module base class
 // All modules must extend this class, see http://smoothieware.org/moduleexample
@@ -43,6 +54,14 @@ public:
 
     void register_for_event(_EVENT_ENUM event_id);
 
+    // for events a module only polls in, like ON_IDLE or ON_MAIN_LOOP: call the handler at most every interval_ms,
+    // or with wake_only just once after each wake_for_event(), which may be called from an interrupt
+    void set_event_rate(_EVENT_ENUM event_id, uint16_t interval_ms, bool wake_only= false);
+    // for ON_IDLE and ON_MAIN_LOOP: the handlers that feed the planner run first, and housekeeping (the panel, status
+    // reports, driver polling) runs at most every Kernel::housekeeping_defer_ms while feeding them has to catch up
+    void set_event_priority(_EVENT_ENUM event_id, EVENT_PRIORITY priority);
+    void wake_for_event(_EVENT_ENUM event_id);
+
     // event callbacks, not every module will implement all of these
     // there should be one for each _EVENT_ENUM
     virtual void on_main_loop(void *) {};
@@ -58,6 +77,7 @@ public:
     virtual void on_set_public_data(void *) {};
     virtual void on_halt(void *) {};
     virtual void on_enable(void *) {};
+    virtual void on_config_changed(void *) {};
 
 };
 
@@ -194,8 +194,11 @@ LPC17XX_Ethernet::LPC17XX_Ethernet()
     memcpy(interface_name, "eth0", 5);
 
     instance = this;
+    dropped_broadcasts = 0;
 
     up = false;
+    phy_resetting = false;
+    phy_reset_seconds = 0;
 }
 
 void LPC17XX_Ethernet::on_module_loaded()
@@ -228,6 +231,19 @@ void LPC17XX_Ethernet::check_interface()
 //     setEmacAddr(mac_address);
 
     uint32_t st;
+
+    if (phy_resetting) {
+        st = read_PHY (EMAC_PHY_REG_BMCR);
+        if (st & (EMAC_PHY_BMCR_RESET | EMAC_PHY_BMCR_POWERDOWN)) {
+            if (++phy_reset_seconds == 5) DEBUG_PRINTF("ETH: PHY TIMEOUT\n");
+            return;
+        }
+        // Set PHY mode
+        write_PHY (EMAC_PHY_REG_BMCR, EMAC_PHY_AUTO_NEG);
+        phy_resetting = false;
+        return;
+    }
+
     st  = read_PHY (EMAC_PHY_REG_BMSR);
 
     if ((st & EMAC_PHY_BMSR_LINK_ESTABLISHED) && (st & EMAC_PHY_BMSR_AUTO_DONE) && (up == false))
@@ -277,7 +293,7 @@ void LPC17XX_Ethernet::check_interface()
 void LPC17XX_Ethernet::emac_init()
 {
     /* Initialize the EMAC Ethernet controller. */
-    int32_t regv,tout, tmp;
+    int32_t tout, tmp;
     volatile uint32_t d;
 
     /* Set up clock and power for Ethernet module */
@@ -323,26 +339,10 @@ void LPC17XX_Ethernet::emac_init()
     /* Put the DP83848C in reset mode */
     write_PHY (EMAC_PHY_REG_BMCR, EMAC_PHY_BMCR_RESET);
 
-    /* Wait for hardware reset to end. */
-    for (tout = EMAC_PHY_RESP_TOUT; tout; tout--) {
-        regv = read_PHY (EMAC_PHY_REG_BMCR);
-        if (!(regv & (EMAC_PHY_BMCR_RESET | EMAC_PHY_BMCR_POWERDOWN))) {
-            /* Reset complete, device not Power Down. */
-            break;
-        }
-        if (tout == 0){
-            // Time out, return ERROR
-            DEBUG_PRINTF("ETH: PHY TIMEOUT\n");
-            return;
-        }
-    }
-
-    // Set PHY mode
-//     if (emac_SetPHYMode(EMAC_MODE_AUTO) < 0){
-//         DEBUG_PRINTF("ETH: Error Setting Mode\n");
-//         return;
-//     }
-    write_PHY (EMAC_PHY_REG_BMCR, EMAC_PHY_AUTO_NEG);
+    /* The end of the reset is not waited for here, check_interface starts the
+       auto negotiation once it is done. */
+    phy_resetting = true;
+    phy_reset_seconds = 0;
 
     // Set EMAC address
     setEmacAddr(mac_address);
@@ -356,7 +356,7 @@ void LPC17XX_Ethernet::emac_init()
     LPC_EMAC->TxStatus           = (uint32_t) txbuf.txstat;
     LPC_EMAC->TxDescriptorNumber = LPC17XX_TXBUFS-1;
 
-    // Set Receive Filter register: enable broadcast and multicast
+    // Set Receive Filter register: only our address and broadcast, no multicast
     LPC_EMAC->RxFilterCtrl = EMAC_RFC_BCAST_EN | EMAC_RFC_PERFECT_EN;
 
     /* Enable Rx Done and Tx Done interrupt for EMAC */
@@ -377,9 +377,35 @@ void LPC17XX_Ethernet::set_mac(uint8_t* newmac)
     memcpy(mac_address, newmac, 6);
 }
 
+// the only broadcasts uIP does anything with are ARP and the DHCP replies, the rest (NetBIOS, discovery protocols
+// and the like) can be a lot of frames on a busy network, they are dropped here before they are copied
+bool LPC17XX_Ethernet::wanted_broadcast(const uint8_t *frame, int len)
+{
+    static const uint8_t bcast[6]= {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    if (len < 14 || memcmp(frame, bcast, 6) != 0) return true;
+
+    uint16_t type = (frame[12] << 8) | frame[13];
+    if (type == 0x0806) return true; // ARP
+    if (type != 0x0800 || len < 14 + 20 + 4) return false;
+
+    // IPv4 UDP to the DHCP client port
+    const uint8_t *ip = frame + 14;
+    int ihl = (ip[0] & 0x0F) * 4;
+    if (ip[9] != 17 || len < 14 + ihl + 4) return false;
+    return ((ip[ihl + 2] << 8) | ip[ihl + 3]) == 68;
+}
+
 // size must be preloaded with max size of packet buffer
 bool LPC17XX_Ethernet::_receive_frame(void *packet, int *size)
 {
+    // skip the broadcasts nobody wants
+    while (can_read_packet()) {
+        int i = LPC_EMAC->RxConsumeIndex;
+        if (wanted_broadcast(rxbuf.buf[i], (rxbuf.rxstat[i].Info & EMAC_RINFO_SIZE) + 1)) break;
+        dropped_broadcasts++;
+        release_read_packet(NULL);
+    }
+
     if (can_read_packet() && can_write_packet())
     {
         int i = LPC_EMAC->RxConsumeIndex;
@@ -11,9 +11,26 @@
 // SMSC 8720A special control/status register
 #define EMAC_PHY_REG_SCSR 0x1F
 
+// the buffers all go in AHBSRAM1, each descriptor count can be set with the NETWORK_TXBUFS and NETWORK_RXBUFS build
+// options, what they take is no longer there for the AHB1 pool. More receive buffers ride out a burst of frames
+#ifdef NETWORK_FULL_MTU
+// full size frames, with fewer buffers to fit in AHBSRAM1. uIP has at most the two halves of a split segment queued
+#define LPC17XX_MAX_PACKET 1536
+#ifndef LPC17XX_TXBUFS
+#define LPC17XX_TXBUFS     3
+#endif
+#ifndef LPC17XX_RXBUFS
+#define LPC17XX_RXBUFS     3
+#endif
+#else
 #define LPC17XX_MAX_PACKET 600
+#ifndef LPC17XX_TXBUFS
 #define LPC17XX_TXBUFS     4
+#endif
+#ifndef LPC17XX_RXBUFS
 #define LPC17XX_RXBUFS     4
+#endif
+#endif
 
 typedef struct {
     void* packet;
@@ -50,6 +67,7 @@ public:
     void irq(void);
 
     bool _receive_frame(void *packet, int* size);
+    uint32_t get_dropped_broadcasts() const { return dropped_broadcasts; }
 
     // NetworkInterface methods
 //     void provide_net(netcore* n);
@@ -76,6 +94,10 @@ private:
     static _rxbuf_t rxbuf;
     static _txbuf_t txbuf;
 
+    uint32_t dropped_broadcasts;
+    bool phy_resetting;             // the PHY reset emac_init started has not finished yet
+    uint8_t phy_reset_seconds;
+    static bool wanted_broadcast(const uint8_t *frame, int len);
     void check_interface();
 };
 
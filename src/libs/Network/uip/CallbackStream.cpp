@@ -3,6 +3,8 @@
 #include <stdio.h>
 
 #include "SerialConsole.h"
+#include "StatusReport.h"
+#include "MotorDriverControl.h"
 #define DEBUG_PRINTF THEKERNEL->serial->printf
 
 CallbackStream::CallbackStream(cb_t cb, void *u)
@@ -46,9 +48,24 @@ int CallbackStream::puts(const char *s)
     return len;
 }
 
+// does not wait for room in the output queue, the string is dropped if it is full
+int CallbackStream::try_puts(const char *s)
+{
+    if(closed || s == NULL) return puts(s);
+
+    int n= (*callback)(s, user);
+    if(n == -1) {
+        closed= true;
+        return strlen(s);
+    }
+    return n == 0 ? 0 : strlen(s);
+}
+
 void CallbackStream::mark_closed()
 {
     closed= true;
+    StatusReport::unsubscribe(this);
+    MotorDriverControl::stop_telemetry(this);
     if(use_count <= 0) delete this;
 }
 void CallbackStream::dec()
@@ -12,6 +12,7 @@ class CallbackStream : public StreamOutput {
         CallbackStream(cb_t cb, void *u);
         virtual ~CallbackStream();
         int puts(const char*);
+        int try_puts(const char*);
         void inc() { use_count++; }
         void dec();
         int get_count() { return use_count; }
@@ -16,6 +16,7 @@ CommandQueue::CommandQueue()
 {
     command_queue_instance = this;
     null_stream= &(StreamOutput::NullStream);
+    head= used= 0;
 }
 
 CommandQueue* CommandQueue::getInstance()
@@ -33,35 +34,57 @@ extern "C" {
 
 int CommandQueue::add(const char *cmd, StreamOutput *pstream)
 {
-    cmd_t c= {strdup(cmd), pstream==NULL?null_stream:pstream};
-    q.push(c);
-    if(pstream != NULL) {
+    if(pstream == NULL) pstream= null_stream;
+    size_t n= strlen(cmd);
+    if(q.size() == 0 && used < num_slots && n < slot_size) {
+        slot_t &s= slots[(head + used) % num_slots];
+        memcpy(s.str, cmd, n + 1);
+        s.pstream= pstream;
+        used++;
+    } else {
+        // behind the ones in the fifo, so the commands stay in order
+        cmd_t c= {strdup(cmd), pstream};
+        q.push(c);
+    }
+    if(pstream != null_stream) {
         // count how many times this is on the queue
         CallbackStream *s= static_cast<CallbackStream *>(pstream);
         s->inc();
     }
-    return q.size();
+    return size();
 }
 
 // pops the next command off the queue and submits it.
-bool CommandQueue::pop()
+bool CommandQueue::pop(size_t *bytes)
 {
-    if (q.size() == 0) return false;
+    // the slots are older than anything in the fifo
+    if(used > 0) {
+        slot_t &s= slots[head];
+        message.message.assign(s.str);
+        message.stream = s.pstream;
+        head= (head + 1) % num_slots;
+        used--;
+
+    } else if(q.size() > 0) {
+        cmd_t c= q.pop();
+        message.message.assign(c.str);
+        message.stream = c.pstream;
+        free(c.str);
 
-    cmd_t c= q.pop();
-    char *cmd= c.str;
+    } else {
+        return false;
+    }
 
-    struct SerialMessage message;
-    message.message = cmd;
-    message.stream = c.pstream;
+    if(bytes != nullptr) *bytes= message.message.size();
 
-    free(cmd);
+    // the slot is free again already, as this may add more commands
+    StreamOutput *stream= message.stream;
     THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
 
-    if(message.stream != null_stream) {
-        message.stream->puts(NULL); // indicates command is done
+    if(stream != null_stream) {
+        stream->puts(NULL); // indicates command is done
         // decrement usage count
-        CallbackStream *s= static_cast<CallbackStream *>(message.stream);
+        CallbackStream *s= static_cast<CallbackStream *>(stream);
         s->dec();
     }
     return true;
@@ -4,23 +4,38 @@
 #ifdef __cplusplus
 
 #include "fifo.h"
+#include "libs/SerialMessage.h"
+#include <stdint.h>
 #include <string>
 
 class StreamOutput;
 
+// The commands from the network, waiting for the main loop. They are copied into a ring of fixed line slots and
+// submitted from one message whose string keeps its buffer, so a command does not allocate on the way through.
+// Lines longer than a slot, and any added while the ring is full, wait in the spill fifo as before until it is empty.
 class CommandQueue
 {
 public:
     CommandQueue();
     ~CommandQueue();
-    bool pop();
+    bool pop(size_t *bytes= nullptr);
     int add(const char* cmd, StreamOutput *pstream);
-    int size() {return q.size();}
+    int size() {return used + q.size();}
     static CommandQueue* getInstance();
 
 private:
+    static const int num_slots= 4;
+    static const int slot_size= 132;    // as long as a telnet line
     typedef struct {char* str; StreamOutput *pstream; } cmd_t;
+    struct slot_t {
+        char str[slot_size];
+        StreamOutput *pstream;
+    };
+    slot_t slots[num_slots];
+    uint8_t head;                       // next slot to pop
+    uint8_t used;
     Fifo<cmd_t> q;
+    SerialMessage message;
     static CommandQueue *instance;
     StreamOutput *null_stream;
 };
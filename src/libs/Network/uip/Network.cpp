@@ -5,11 +5,14 @@
 #include "CommandQueue.h"
 
 #include "Kernel.h"
+#include "InputArbiter.h"
 #include "Config.h"
+#include "us_ticker_api.h"
 #include "SlowTicker.h"
 
 #include "Network.h"
 #include "PublicDataRequest.h"
+#include "PublicData.h"
 #include "PlayerPublicAccess.h"
 #include "net_util.h"
 #include "uip_arp.h"
@@ -24,6 +27,8 @@
 #include "dhcpc.h"
 #include "sftpd.h"
 #include "plan9.h"
+#include "gcodestream.h"
+#include "WriteBehind.h"
 
 #include <mri.h>
 
@@ -33,11 +38,19 @@
 #define network_webserver_checksum CHECKSUM("webserver")
 #define network_telnet_checksum CHECKSUM("telnet")
 #define network_plan9_checksum CHECKSUM("plan9")
+#define network_stream_checksum CHECKSUM("stream")
+#define network_port_checksum CHECKSUM("port")
+#define network_msize_checksum CHECKSUM("msize")
 #define network_mac_override_checksum CHECKSUM("mac_override")
 #define network_ip_address_checksum CHECKSUM("ip_address")
 #define network_hostname_checksum CHECKSUM("hostname")
 #define network_ip_gateway_checksum CHECKSUM("ip_gateway")
 #define network_ip_mask_checksum CHECKSUM("ip_mask")
+#define network_status_checksum CHECKSUM("status")
+#define network_address_checksum CHECKSUM("address")
+#define network_interval_checksum CHECKSUM("interval")
+#define network_dhcp_timeout_checksum CHECKSUM("dhcp_timeout")
+#define network_dhcp_fallback_checksum CHECKSUM("dhcp_fallback")
 
 extern "C" void uip_log(char *m)
 {
@@ -45,15 +58,35 @@ extern "C" void uip_log(char *m)
 }
 
 static bool webserver_enabled, telnet_enabled, plan9_enabled, use_dhcp;
+static uint16_t stream_port;
+static uint32_t plan9_msize;
 static Network *theNetwork;
 static Sftpd *sftpd;
+static GcodeStream *gcode_stream;
 static CommandQueue *command_q= CommandQueue::getInstance();
+static uint8_t command_source;          // in the InputArbiter
+
+// the status datagram, sent every status_interval_us to status_address while enabled
+static uint8_t status_address[4];
+static uint16_t status_port;
+static uint32_t status_interval_us, status_last_us;
+static struct uip_udp_conn *status_conn;
+static bool status_due;
+
+// the bring up goes on from on_idle, DHCP starts once the link is up and after dhcp_timeout seconds without a lease
+// the fallback address is used, a lease that comes later still replaces it
+static enum { BRINGUP_LINK, BRINGUP_DHCP, BRINGUP_DONE } bringup;
+static enum { FALLBACK_NONE, FALLBACK_LINKLOCAL, FALLBACK_STATIC } dhcp_fallback;
+static uint32_t dhcp_timeout;
+static struct timer dhcp_timer;
+static bool servers_started;
 
 Network* Network::instance;
 Network::Network()
 {
     ethernet = new LPC17XX_Ethernet();
     tickcnt= 0;
+    more_frames= false;
     theNetwork= this;
     sftpd= NULL;
     instance= this;
@@ -131,6 +164,22 @@ void Network::on_module_loaded()
     webserver_enabled = THEKERNEL->config->value( network_checksum, network_webserver_checksum, network_enable_checksum )->by_default(false)->as_bool();
     telnet_enabled = THEKERNEL->config->value( network_checksum, network_telnet_checksum, network_enable_checksum )->by_default(false)->as_bool();
     plan9_enabled = THEKERNEL->config->value( network_checksum, network_plan9_checksum, network_enable_checksum )->by_default(false)->as_bool();
+    plan9_msize = THEKERNEL->config->value( network_checksum, network_plan9_checksum, network_msize_checksum )->by_default(2072)->as_number();
+    if (THEKERNEL->config->value( network_checksum, network_stream_checksum, network_enable_checksum )->by_default(false)->as_bool()) {
+        stream_port = THEKERNEL->config->value( network_checksum, network_stream_checksum, network_port_checksum )->by_default(2323)->as_int();
+        gcode_stream = new GcodeStream();
+    }
+    command_source = THEKERNEL->input_arbiter->add_source("network", []() { return command_q->size() > 0; });
+
+    if (THEKERNEL->config->value( network_checksum, network_status_checksum, network_enable_checksum )->by_default(false)->as_bool()) {
+        string a = THEKERNEL->config->value( network_checksum, network_status_checksum, network_address_checksum )->by_default("239.255.42.42")->as_string();
+        if (parse_ip_str(a, status_address, 4)) {
+            status_port = THEKERNEL->config->value( network_checksum, network_status_checksum, network_port_checksum )->by_default(4242)->as_int();
+            status_interval_us = THEKERNEL->config->value( network_checksum, network_status_checksum, network_interval_checksum )->by_default(1000)->as_int() * 1000;
+        } else {
+            printf("Invalid status address: %s\n", a.c_str());
+        }
+    }
 
     string mac = THEKERNEL->config->value( network_checksum, network_mac_override_checksum )->by_default("")->as_string();
     if (mac.size() == 17 ) { // parse mac address
@@ -165,6 +214,28 @@ void Network::on_module_loaded()
                 printf("Invalid hostname: %s\n", s.c_str());
             }
         }
+
+        dhcp_timeout = THEKERNEL->config->value( network_checksum, network_dhcp_timeout_checksum )->by_default(30)->as_int();
+        s = THEKERNEL->config->value( network_checksum, network_dhcp_fallback_checksum )->by_default("linklocal")->as_string();
+        if (s == "none") {
+            dhcp_fallback = FALLBACK_NONE;
+        } else if (s == "linklocal") {
+            // 169.254.1.0 to 169.254.254.255 as RFC 3927 has it, picked from the serial number so it is the same each time
+            uint32_t h = getSerialNumberHash();
+            ipaddr[0] = 169; ipaddr[1] = 254; ipaddr[2] = 1 + (h >> 8) % 254; ipaddr[3] = h & 0xFF;
+            ipmask[0] = 255; ipmask[1] = 255; ipmask[2] = 0; ipmask[3] = 0;
+            memset(ipgw, 0, sizeof(ipgw));
+            dhcp_fallback = FALLBACK_LINKLOCAL;
+        } else {
+            string m = THEKERNEL->config->value( network_checksum, network_ip_mask_checksum )->by_default("255.255.255.0")->as_string();
+            string g = THEKERNEL->config->value( network_checksum, network_ip_gateway_checksum )->by_default("192.168.3.1")->as_string();
+            if (parse_ip_str(s, ipaddr, 4) && parse_ip_str(m, ipmask, 4) && parse_ip_str(g, ipgw, 4)) {
+                dhcp_fallback = FALLBACK_STATIC;
+            } else {
+                printf("Invalid DHCP fallback: %s\n", s.c_str());
+                dhcp_fallback = FALLBACK_NONE;
+            }
+        }
     } else {
         bool bad = false;
         use_dhcp = false;
@@ -188,15 +259,20 @@ void Network::on_module_loaded()
         }
     }
 
-    THEKERNEL->add_module( ethernet );
-    THEKERNEL->slow_ticker->attach( 100, this, &Network::tick );
+    // the PHY reset and the stack are started once the console is answering, the host can connect meanwhile
+    THEKERNEL->defer_init(this, [this]() {
+        THEKERNEL->add_module( ethernet, "ethernet" );
+        THEKERNEL->slow_ticker->attach( 100, this, &Network::tick );
 
-    // Register for events
-    this->register_for_event(ON_IDLE);
-    this->register_for_event(ON_MAIN_LOOP);
-    this->register_for_event(ON_GET_PUBLIC_DATA);
+        // Register for events
+        this->register_for_event(ON_IDLE);
+        this->register_for_event(ON_MAIN_LOOP);
+        THEKERNEL->add_busy_check([this]() { return more_frames || WriteBehind::has_pending(); });
+        this->register_for_event(ON_GET_PUBLIC_DATA);
+        PublicData::register_handler(this, network_checksum);
 
-    this->init();
+        this->init();
+    });
 }
 
 void Network::on_get_public_data(void* argument) {
@@ -234,13 +310,44 @@ uint32_t Network::tick(uint32_t dummy)
 void Network::on_idle(void *argument)
 {
     if (!ethernet->isUp()) return;
-
-    int len= sizeof(uip_buf); // set maximum size
-    if (ethernet->_receive_frame(uip_buf, &len)) {
+    if (bringup != BRINGUP_DONE) bring_up();
+
+    // a few frames at a time, so a burst does not overflow the receive buffers and does not hold up the main loop for long
+    uint32_t start= us_ticker_read();
+    int frames= 0;
+    while (frames < max_frames_per_idle && us_ticker_read() - start < idle_budget_us) {
+        int len= sizeof(uip_buf); // set maximum size
+        if (!ethernet->_receive_frame(uip_buf, &len)) break;
         uip_len = len;
         this->handlePacket();
+        frames++;
+    }
+    more_frames= frames > 0;
 
-    } else {
+    if (frames == 0) {
+
+        // write out buffered uploads while there is nothing to receive, then let a stopped upload carry on
+        struct uip_conn *conn = WriteBehind::flush_next();
+        if (conn != NULL) {
+            uip_poll_conn(conn);
+            if (uip_len > 0) {
+                uip_arp_out();
+                tapdev_send(uip_buf, uip_len);
+            }
+        }
+
+        if (status_conn != NULL && us_ticker_read() - status_last_us >= status_interval_us) {
+            send_status();
+        }
+
+        // same for a gcode stream once enough of its lines have been played
+        if (gcode_stream != NULL && (conn = gcode_stream->wake_conn()) != NULL) {
+            uip_poll_conn(conn);
+            if (uip_len > 0) {
+                uip_arp_out();
+                tapdev_send(uip_buf, uip_len);
+            }
+        }
 
         if (timer_expired(&periodic_timer)) { /* no packet but periodic_timer time out (0.1s)*/
             timer_reset(&periodic_timer);
@@ -294,6 +401,10 @@ void Network::on_idle(void *argument)
 
 static void setup_servers()
 {
+    // once, a lease that replaces the fallback address only changes the address
+    if (servers_started) return;
+    servers_started = true;
+
     if (webserver_enabled) {
         // Initialize the HTTP server, listen to port 80.
         httpd_init();
@@ -308,12 +419,59 @@ static void setup_servers()
 
     if (plan9_enabled) {
         // Initialize the plan9 server
-        Plan9::init();
+        Plan9::init(plan9_msize);
         printf("Plan9 initialized\n");
     }
 
+    if (gcode_stream != NULL) {
+        // raw gcode stream, played without ok handshakes
+        gcode_stream->init(stream_port);
+        printf("Gcode stream initialized on port %d\n", stream_port);
+    }
+
     // sftpd service, which is lazily created on reciept of first packet
     uip_listen(HTONS(115));
+
+    if (status_interval_us > 0 && status_conn == NULL) {
+        uip_ipaddr_t addr;
+        uip_ipaddr(addr, status_address[0], status_address[1], status_address[2], status_address[3]);
+        status_conn = uip_udp_new(&addr, HTONS(status_port));
+        if (status_conn != NULL) {
+            printf("Status sent to %d.%d.%d.%d:%d every %lu ms\n", status_address[0], status_address[1], status_address[2], status_address[3],
+                status_port, status_interval_us / 1000);
+        }
+    }
+}
+
+// the same JSON as GET /status with the hostname added, one datagram serves any number of observers
+int Network::status_datagram(char *buf, int size)
+{
+    return httpd_status_datagram(buf, size, hostname != NULL ? hostname : "");
+}
+
+void Network::send_status()
+{
+    status_last_us = us_ticker_read();
+    status_due = true;
+    uip_udp_periodic_conn(status_conn);
+    if (uip_len > 0) {
+        uip_arp_out();
+        tapdev_send(uip_buf, uip_len);
+    }
+}
+
+// dhcpc has the udp connections to itself, but for the status one
+extern "C" void app_select_udp_appcall(void)
+{
+    if (uip_udp_conn == status_conn) {
+        // the periodic poll of the connection comes here too, only a due status is sent
+        if (status_due) {
+            status_due = false;
+            uip_udp_send(theNetwork->status_datagram((char *)uip_appdata, UIP_BUFSIZE - UIP_LLH_LEN - UIP_IPUDPH_LEN));
+        }
+        return;
+    }
+    dhcpc_appcall();
 }
 
 extern "C" void dhcpc_configured(const struct dhcpc_state *s)
@@ -345,9 +503,33 @@ void Network::dhcpc_configured(uint32_t ipaddr, uint32_t ipmask, uint32_t ipgw)
     uip_setnetmask((u16_t*)this->ipmask);
     uip_setdraddr((u16_t*)this->ipgw);
 
+    bringup = BRINGUP_DONE;
     setup_servers();
 }
 
+// one step of the bring up each pass, none of them wait
+void Network::bring_up()
+{
+    if (bringup == BRINGUP_LINK) {
+    #if UIP_CONF_UDP
+        dhcpc_init(mac_address, sizeof(mac_address), hostname);
+        dhcpc_request();
+        printf("Getting IP address....\n");
+    #endif
+        timer_set(&dhcp_timer, CLOCK_SECOND * dhcp_timeout);
+        bringup = BRINGUP_DHCP;
+
+    } else if (dhcp_fallback != FALLBACK_NONE && dhcp_timeout > 0 && timer_expired(&dhcp_timer)) {
+        // dhcpc goes on asking, it replaces this address if it gets a lease
+        printf("No DHCP lease after %lu seconds, using %d.%d.%d.%d\n", dhcp_timeout, ipaddr[0], ipaddr[1], ipaddr[2], ipaddr[3]);
+        uip_sethostaddr((u16_t*)this->ipaddr);
+        uip_setnetmask((u16_t*)this->ipmask);
+        uip_setdraddr((u16_t*)this->ipgw);
+        bringup = BRINGUP_DONE;
+        setup_servers();
+    }
+}
+
 void Network::init(void)
 {
     // two timers for tcp/ip
@@ -372,23 +554,25 @@ void Network::init(void)
         uip_ipaddr(tip, ipmask[0], ipmask[1], ipmask[2], ipmask[3]);
         uip_setnetmask(tip); /* mask */
         printf("IP mask: %d.%d.%d.%d\n", ipmask[0], ipmask[1], ipmask[2], ipmask[3]);
+        bringup = BRINGUP_DONE;
         setup_servers();
 
     }else{
-    #if UIP_CONF_UDP
-        dhcpc_init(mac_address, sizeof(mac_address), hostname);
-        dhcpc_request();
-        printf("Getting IP address....\n");
-    #endif
+        // DHCP waits for the link, on_idle starts it
+        bringup = BRINGUP_LINK;
     }
 }
 
 void Network::on_main_loop(void *argument)
 {
-    // issue commands here if any available
-    while(command_q->pop()) {
-        // keep feeding them until empty
+    // issue commands here if any available, until empty or the arbiter holds them
+    size_t bytes;
+    while(THEKERNEL->input_arbiter->may_take(command_source) && command_q->pop(&bytes)) {
+        THEKERNEL->input_arbiter->took(command_source, bytes);
     }
+
+    // then as many streamed lines as the queue has room for
+    if (gcode_stream != NULL) gcode_stream->play_lines();
 }
 
 // select between webserver and telnetd server
@@ -417,13 +601,23 @@ extern "C" void app_select_appcall(void)
             break;
 
         default:
-            printf("unknown app for port: %d\n", uip_conn->lport);
-
+            if (gcode_stream != NULL && uip_conn->lport == HTONS(stream_port)) {
+                gcode_stream->appcall();
+            } else {
+                printf("unknown app for port: %d\n", uip_conn->lport);
+            }
+            break;
     }
 }
 
 void Network::tapdev_send(void *pPacket, unsigned int size)
 {
+    // wait for the EMAC to free a transmit buffer instead of dropping the frame, a dropped segment stalls the
+    // connection until uIP retransmits it. A full frame takes 1.2ms at 10Mbit
+    uint32_t t= us_ticker_read();
+    while(!ethernet->can_write_packet() && us_ticker_read() - t < 2000) ;
+
+    // uIP builds the next frame in uip_buf straight away, so it is copied rather than sent from there
     memcpy(ethernet->request_packet_buffer(), pPacket, size);
     ethernet->write_packet((uint8_t *) pPacket, size);
 }
@@ -19,11 +19,18 @@ public:
     void dhcpc_configured(uint32_t ipaddr, uint32_t ipmask, uint32_t ipgw);
     static Network *getInstance() { return instance;}
     void tapdev_send(void *pPacket, unsigned int size);
+    int status_datagram(char *buf, int size);
 
 private:
     void init();
+    void bring_up();
     uint32_t tick(uint32_t dummy);
     void handlePacket();
+    void send_status();
+
+    // frames handled in one on_idle, within this time
+    static const int max_frames_per_idle= 4;
+    static const uint32_t idle_budget_us= 1000;
 
     static Network *instance;
 
@@ -36,6 +43,7 @@ private:
     uint8_t ipgw[4];
     char *hostname;
     volatile uint32_t tickcnt;
+    bool more_frames;                   // the last on_idle stopped at its limit, there can be more waiting
 
 };
 
@@ -0,0 +1,132 @@
+#include "WriteBehind.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include "uip.h"
+}
+
+WriteBehind *WriteBehind::first= NULL;
+
+WriteBehind::WriteBehind()
+{
+    wake_conn= NULL;
+    next= NULL;
+    fp= NULL;
+    buf= NULL;
+    used= 0;
+    offset= 0;
+    failed= false;
+}
+
+WriteBehind::~WriteBehind()
+{
+    close();
+}
+
+bool WriteBehind::open(const char *filename, const char *mode, long offset)
+{
+    close();
+
+    buf= (char *)malloc(buffer_size);
+    if(buf == NULL) return false;
+
+    fp= fopen(filename, mode);
+    if(fp != NULL && offset >= 0 && fseek(fp, offset, SEEK_SET) != 0) {
+        fclose(fp);
+        fp= NULL;
+    }
+    if(fp == NULL) {
+        free(buf);
+        buf= NULL;
+        return false;
+    }
+
+    this->offset= ftell(fp);
+    used= 0;
+    failed= false;
+    wake_conn= NULL;
+
+    next= first;
+    first= this;
+    return true;
+}
+
+bool WriteBehind::close()
+{
+    if(fp == NULL) return !failed;
+
+    while(used > 0 && flush_chunk()) ;
+    if(fclose(fp) != 0) failed= true;
+    fp= NULL;
+    free(buf);
+    buf= NULL;
+    used= 0;
+    wake_conn= NULL;
+
+    for (WriteBehind **p = &first; *p != NULL; p = &(*p)->next) {
+        if(*p == this) {
+            *p= next;
+            break;
+        }
+    }
+    return !failed;
+}
+
+// write up to the end of the next chunk, so after the first one every write starts on a sector and covers whole sectors
+bool WriteBehind::flush_chunk()
+{
+    size_t n= chunk_size - (offset % 512);
+    if(n > used) n= used;
+
+    if(!failed && fwrite(buf, 1, n, fp) != n) failed= true;
+    used -= n;
+    offset += n;
+    memmove(buf, buf + n, used);
+    return !failed;
+}
+
+bool WriteBehind::write(const void *data, size_t len)
+{
+    if(fp == NULL || failed) return false;
+
+    // a segment that does not fit has to wait for the sdcard
+    while(len > space() && used > 0 && flush_chunk()) ;
+    if(failed) return false;
+
+    if(len > buffer_size) {
+        if(fwrite(data, 1, len, fp) != len) failed= true;
+        offset += len;
+        return !failed;
+    }
+
+    memcpy(buf + used, data, len);
+    used += len;
+    return true;
+}
+
+bool WriteBehind::has_pending()
+{
+    for (WriteBehind *w = first; w != NULL; w = w->next) {
+        if(w->used >= chunk_size || (w->used > 0 && w->wake_conn != NULL)) return true;
+    }
+    return false;
+}
+
+struct uip_conn *WriteBehind::flush_next()
+{
+    for (WriteBehind *w = first; w != NULL; w = w->next) {
+        // partial chunks wait for more data or the close, unless its connection is waiting for room
+        if(w->used == 0 || (w->used < chunk_size && w->wake_conn == NULL)) continue;
+
+        w->flush_chunk();
+        if(w->wake_conn != NULL && (w->failed || w->space() >= w->wake_conn->initialmss)) {
+            struct uip_conn *c= w->wake_conn;
+            w->wake_conn= NULL;
+            return c;
+        }
+        return NULL;
+    }
+    return NULL;
+}
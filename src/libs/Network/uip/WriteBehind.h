@@ -0,0 +1,50 @@
+#ifndef WRITEBEHIND_H
+#define WRITEBEHIND_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+struct uip_conn;
+
+// Buffers what a network upload writes to a file, so the handler can take the next segment without waiting for the
+// sdcard. Network::on_idle writes the buffer out in sector aligned chunks while there are no packets to handle.
+// A handler that stops its connection when the buffer is nearly full sets wake_conn, it is polled to restart it
+// once there is room again.
+class WriteBehind {
+    public:
+        WriteBehind();
+        ~WriteBehind();
+
+        // offset is where to start writing, -1 to write from wherever mode starts
+        bool open(const char *filename, const char *mode, long offset= -1);
+        bool close();                       // writes what is left, false if any of the data could not be written
+        bool write(const void *data, size_t len);
+
+        bool is_open() const { return fp != NULL; }
+        bool has_failed() const { return failed; }
+        long tell() const { return offset + used; }
+        size_t space() const { return buffer_size - used; }
+
+        struct uip_conn *wake_conn;
+
+        // write a chunk of one of the buffers, returns a connection that has room again and should be polled
+        static struct uip_conn *flush_next();
+        // there is a chunk flush_next() would write
+        static bool has_pending();
+
+    private:
+        bool flush_chunk();
+
+        static const size_t buffer_size= 2048;
+        static const size_t chunk_size= 1024;
+        static WriteBehind *first;
+
+        WriteBehind *next;
+        FILE *fp;
+        char *buf;
+        size_t used;
+        long offset;                        // file position of buf[0]
+        bool failed;
+};
+
+#endif
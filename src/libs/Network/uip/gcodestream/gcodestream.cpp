@@ -0,0 +1,155 @@
+#include "gcodestream.h"
+
+#include "Kernel.h"
+#include "InputArbiter.h"
+#include "Conveyor.h"
+#include "libs/SerialMessage.h"
+#include "StreamOutput.h"
+
+#include "string.h"
+#include "stdlib.h"
+
+extern "C" {
+#include "uip.h"
+}
+
+#define DEBUG_PRINTF(...)
+
+GcodeStream::GcodeStream()
+{
+    conn = NULL;
+    buf = NULL;
+    used = 0;
+    discarding = false;
+    halted = false;
+    input_source = THEKERNEL->input_arbiter->add_source("network_stream", [this]() { return used > 0; });
+}
+
+GcodeStream::~GcodeStream()
+{
+    free(buf);
+}
+
+void GcodeStream::close(void)
+{
+    free(buf);
+    buf = NULL;
+    conn = NULL;
+}
+
+void GcodeStream::newdata(void)
+{
+    size_t len = uip_datalen();
+    if (len > buffer_size - used) {
+        // can not happen as the connection is stopped before the buffer has less than a segment of room
+        len = buffer_size - used;
+    }
+    memcpy(&buf[used], uip_appdata, len);
+    used += len;
+
+    if (buffer_size - used < uip_initialmss()) {
+        DEBUG_PRINTF("gcodestream: stopped %d\n", used);
+        uip_stop();
+    }
+}
+
+void GcodeStream::play_lines(void)
+{
+    if (buf == NULL || used == 0) return;
+
+    if (THEKERNEL->is_halted()) {
+        // the rest of the stream makes no sense after a halt, the sender sees the connection aborted
+        used = 0;
+        halted = true;
+        return;
+    }
+
+    size_t start = 0;
+    for (int n = 0; n < max_lines && !THEKERNEL->conveyor->is_queue_full() && THEKERNEL->input_arbiter->may_take(input_source); ++n) {
+        char *nl = (char *)memchr(&buf[start], '\n', used - start);
+        if (nl == NULL) break;
+
+        size_t end = nl - buf;
+        size_t len = end - start;
+        if (len > 0 && buf[end - 1] == '\r') --len;
+
+        if (discarding) {
+            discarding = false;
+        } else if (len > 0) {
+            struct SerialMessage message;
+            message.message.assign(&buf[start], len);
+            message.stream = &(StreamOutput::NullStream);
+            THEKERNEL->input_arbiter->took(input_source, len);
+            THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message);
+        }
+        start = end + 1;
+    }
+
+    if (start == 0 && used == buffer_size) {
+        // no end of line in a full buffer, drop it and the rest of the line
+        DEBUG_PRINTF("gcodestream: line too long\n");
+        discarding = true;
+        start = used;
+    }
+
+    used -= start;
+    memmove(buf, &buf[start], used);
+}
+
+struct uip_conn *GcodeStream::wake_conn(void)
+{
+    if (conn == NULL || !uip_stopped(conn)) return NULL;
+    if (halted || buffer_size - used >= conn->initialmss) return conn;
+    return NULL;
+}
+
+void GcodeStream::appcall(void)
+{
+    if (uip_connected()) {
+        if (conn != NULL) {
+            // only one stream at a time
+            uip_abort();
+            return;
+        }
+        buf = (char *)malloc(buffer_size);
+        if (buf == NULL) {
+            uip_abort();
+            return;
+        }
+        conn = uip_conn;
+        used = 0;
+        discarding = false;
+        halted = false;
+    }
+
+    if (uip_conn != conn) {
+        uip_abort();
+        return;
+    }
+
+    if (uip_closed() || uip_aborted() || uip_timedout()) {
+        DEBUG_PRINTF("gcodestream: closed\n");
+        close();
+        return;
+    }
+
+    if (halted) {
+        close();
+        uip_abort();
+        return;
+    }
+
+    if (uip_newdata()) {
+        newdata();
+    }
+
+    // polled by Network once play_lines has made room for another segment
+    if (uip_poll() && uip_stopped(uip_conn) && buffer_size - used >= uip_initialmss()) {
+        uip_restart();
+    }
+}
+
+void GcodeStream::init(unsigned int port)
+{
+    uip_listen(HTONS(port));
+}
@@ -0,0 +1,43 @@
+#ifndef __GCODESTREAM_H__
+#define __GCODESTREAM_H__
+
+/*
+ * Raw gcode streaming, lines sent to the port are played as they arrive without any ok handshake. The sender is held
+ * off with the TCP window while the buffer is full, so it can send as fast as the planner takes the lines.
+ * Replies to the commands are discarded, use telnet for anything that needs an answer.
+ */
+
+#include <stddef.h>
+
+struct uip_conn;
+
+class GcodeStream
+{
+public:
+    GcodeStream();
+    ~GcodeStream();
+
+    void appcall(void);
+    void init(unsigned int port);
+
+    // play the buffered lines while the queue has room, called from on_main_loop
+    void play_lines(void);
+    // the connection to poll so it can carry on, once it was stopped and there is room again
+    struct uip_conn *wake_conn(void);
+
+private:
+    void newdata(void);
+    void close(void);
+
+    static const size_t buffer_size= 2048;
+    static const int max_lines= 32;         // most lines played in one main loop pass
+
+    struct uip_conn *conn;
+    char *buf;
+    size_t used;
+    bool discarding;                        // skipping the rest of a line too long for the buffer
+    bool halted;                            // dropped what was buffered on a halt, the connection is aborted
+    uint8_t input_source;                   // in the InputArbiter
+};
+
+#endif /* __GCODESTREAM_H__ */
@@ -11,6 +11,7 @@
 #include "Kernel.h"
 #include "utils.h"
 #include "uip.h"
+#include "platform_memory.h"
 
 //#define DEBUG_PRINTF(...) printf("9p " __VA_ARGS__)
 #define DEBUG_PRINTF(...)
@@ -18,6 +19,8 @@
 #define ERROR(...)       do { error(bufout, msize, __LINE__, ##__VA_ARGS__); return 0; } while (0)
 #define CHECK(cond, ...) do { if (!(cond)) ERROR(__VA_ARGS__); } while (0)
 #define IOUNIT           (msize - sizeof (Message::Twrite))
+// offered to the client, whole sectors once msize is large enough so sequential reads and writes stay sector aligned
+#define IOUNIT_ALIGNED   (IOUNIT >= 512 ? IOUNIT & ~511 : IOUNIT)
 #define PACKEDSTRUCT     struct __attribute__ ((packed))
 #define RESPONSE(t)      response->size = sizeof (response->t); response->type = request->type+1; response->tag = request->tag
 
@@ -365,17 +368,51 @@ std::string join_path(const std::string& a, const std::string& b)
 
 } // anonymous namespace
 
+uint32_t Plan9::max_msize = INITIAL_MSIZE;
+
 Plan9::Plan9()
-: msize(INITIAL_MSIZE), queue_bytes(0)
+: queue_bytes(0), reader(nullptr)
 {
-    PSOCK_INIT(&sin, bufin + 4, sizeof(bufin) - 4);
-    PSOCK_INIT(&sout, bufout + 4, sizeof(bufout) - 4);
+    // the buffers come from the AHB RAM the network already uses, then the other bank, else they are small ones on the heap
+    bufsize = max_msize;
+    bufin = (char*)AHB1.alloc(2 * bufsize);
+    if (!bufin)
+        bufin = (char*)AHB0.alloc(2 * bufsize);
+    if (!bufin) {
+        bufsize = INITIAL_MSIZE;
+        bufin = new char[2 * bufsize];
+    }
+    bufout = bufin + bufsize;
+    msize = bufsize;
+
+    PSOCK_INIT(&sin, bufin + 4, bufsize - 4);
+    PSOCK_INIT(&sout, bufout + 4, bufsize - 4);
 }
 
 Plan9::~Plan9()
 {
     PSOCK_CLOSE(&sin);
     PSOCK_CLOSE(&sout);
+    close_reader();
+    while (!queue.empty()) {
+        delete[] queue.front()->buf;
+        queue.pop();
+    }
+    if (AHB1.has(bufin))
+        AHB1.dealloc(bufin);
+    else if (AHB0.has(bufin))
+        AHB0.dealloc(bufin);
+    else
+        delete[] bufin;
+}
+
+bool Plan9::close_reader()
+{
+    if (!reader)
+        return true;
+    bool ok = fclose(reader) == 0;
+    reader = nullptr;
+    return ok;
 }
 
 Plan9::Entry Plan9::add_entry(uint32_t fid, uint8_t type, const std::string& path)
@@ -421,8 +458,9 @@ void Plan9::remove_fid(uint32_t fid)
     }
 }
 
-void Plan9::init()
+void Plan9::init(uint32_t msize)
 {
+    max_msize = msize > INITIAL_MSIZE ? msize : INITIAL_MSIZE;
     uip_listen(HTONS(564));
 }
 
@@ -525,11 +563,20 @@ bool Plan9::process(Message* request, Message* response)
 {
     Entry entry;
 
+    // writes are buffered, anything else sees the file as written
+    if (request->type != Twrite && writer.is_open()) {
+        CHECK(writer.close(), EIO);
+    }
+    // and the file being read is only kept open for reads
+    if (request->type != Tread) {
+        CHECK(close_reader(), EIO);
+    }
+
     switch (request->type) {
     case Tversion:
         DEBUG_PRINTF("Tversion\n");
         RESPONSE(Rversion);
-        msize = response->Rversion.msize = min(INITIAL_MSIZE, request->Tversion.msize);
+        msize = response->Rversion.msize = min(bufsize, request->Tversion.msize);
         response->size = putstr(response->buf + response->size, response->buf + msize, "9P2000") - response->buf;
         break;
 
@@ -621,7 +668,7 @@ bool Plan9::process(Message* request, Message* response)
 
         RESPONSE(Ropen);
         response->Ropen.qid = entry;
-        response->Ropen.iounit = IOUNIT;
+        response->Ropen.iounit = IOUNIT_ALIGNED;
         break;
 
     case Tread:
@@ -660,11 +707,17 @@ bool Plan9::process(Message* request, Message* response)
                 }
             }
         } else {
-            File fp(entry->first, "r");
-            CHECK(fp, EIO);
-            CHECK(!fseek(fp, request->Tread.offset, SEEK_SET), EIO);
-            response->Rread.count = fread(response->buf + response->size, 1, request->Tread.count, fp);
-            CHECK(response->Rread.count == request->Tread.count || !ferror(fp), EIO);
+            // a file read from start to end is opened once, rather than opened and seeked for every read,
+            // and the data goes straight into the response, whole sectors are read by FatFs without going through its window
+            if (!reader || reader_path != entry->first || ftell(reader) != (long)request->Tread.offset) {
+                close_reader();
+                reader = fopen(entry->first.c_str(), "r");
+                CHECK(reader, EIO);
+                reader_path = entry->first;
+                CHECK(!fseek(reader, request->Tread.offset, SEEK_SET), EIO);
+            }
+            response->Rread.count = fread(response->buf + response->size, 1, request->Tread.count, reader);
+            CHECK(response->Rread.count == request->Tread.count || !ferror(reader), EIO);
             response->size += response->Rread.count;
         }
         break;
@@ -690,7 +743,7 @@ bool Plan9::process(Message* request, Message* response)
             CHECK(entry = add_entry(request->fid, (perm & DMDIR) ? QTDIR : QTFILE, path));
             RESPONSE(Rcreate);
             response->Rcreate.qid = entry;
-            response->Rcreate.iounit = IOUNIT;
+            response->Rcreate.iounit = IOUNIT_ALIGNED;
         }
         break;
 
@@ -701,13 +754,15 @@ bool Plan9::process(Message* request, Message* response)
                   request->Twrite.count <= IOUNIT, EBADMSG);
             CHECK(entry = get_entry(request->fid));
 
-            File fp(entry->first, "r+");
-            CHECK(fp, EIO);
-            CHECK(!fseek(fp, request->Twrite.offset, SEEK_SET), EIO);
+            if (!writer.is_open() || writer_path != entry->first || writer.tell() != (long)request->Twrite.offset) {
+                CHECK(writer.close(), EIO);
+                CHECK(writer.open(entry->first.c_str(), "r+", request->Twrite.offset), EIO);
+                writer_path = entry->first;
+            }
+            CHECK(writer.write(request->buf + sizeof (request->Twrite), request->Twrite.count), EIO);
 
             RESPONSE(Rwrite);
-            response->Rwrite.count = fwrite(request->buf + sizeof (request->Twrite), 1, request->Twrite.count, fp);
-            CHECK(response->Rwrite.count == request->Twrite.count || !ferror(fp), EIO);
+            response->Rwrite.count = request->Twrite.count;
         }
         break;
 
@@ -16,13 +16,18 @@
  * How to use it:
  *
  *   1. Add "network.plan9.enable true" to the config
- *   2. Mount under Linux with "mount -t 9p $ip /mnt/smoothie
+ *   2. Mount under Linux with "mount -t 9p -o msize=2072 $ip /mnt/smoothie
+ *
+ * The largest msize offered is set with network.plan9.msize, the client may ask for less.
  */
 
 #include <map>
 #include <queue>
 #include <string>
 #include <stdint.h>
+#include <stdio.h>
+
+#include "WriteBehind.h"
 
 extern "C" {
 #include "psock.h"
@@ -34,7 +39,7 @@ public:
     Plan9();
     ~Plan9();
 
-    static void init();
+    static void init(uint32_t max_msize);
     static void appcall();
 
     struct EntryData {
@@ -60,14 +65,21 @@ private:
     Entry get_entry(uint32_t);
     bool add_fid(uint32_t, Entry);
     void remove_fid(uint32_t);
+    bool close_reader();
 
     static const uint32_t INITIAL_MSIZE = 300;
+    static uint32_t      max_msize;
     EntryMap             entries;
     FidMap               fids;
     psock                sin, sout;
-    char                 bufin[INITIAL_MSIZE], bufout[INITIAL_MSIZE];
+    char                 *bufin, *bufout;     // bufsize each, in AHB RAM unless there was no room
+    uint32_t             bufsize;
     std::queue<Message*> queue;
     uint32_t             msize, queue_bytes;
+    WriteBehind          writer;              // the file being written, while the writes follow on from each other
+    std::string          writer_path;
+    FILE                 *reader;             // the file being read, kept open while the reads follow on from each other
+    std::string          reader_path;
 };
 
 #endif
@@ -16,17 +16,12 @@ extern "C" {
 
 Sftpd::Sftpd()
 {
-    fd = NULL;
     state = STATE_NORMAL;
     outbuf = NULL;
-    filename= NULL;
 }
 
 Sftpd::~Sftpd()
 {
-    if (fd != NULL) {
-        fclose(fd);
-    }
 }
 
 int Sftpd::senddata()
@@ -72,21 +67,17 @@ int Sftpd::handle_command()
                     outbuf = "- incomplete STOR command\n";
                 } else {
                     char *fn = &buf[9];
-                    if(this->filename != NULL) free(this->filename);
-                    this->filename= strdup(fn); // REMOVE when bug fixed
                     // get { NEW|OLD|APP }
                     if (strncmp(&buf[5], "OLD", 3) == 0) {
                         DEBUG_PRINTF("sftp: Opening file: %s\n", fn);
-                        fd = fopen(fn, "w");
-                        if (fd != NULL) {
+                        if (file.open(fn, "w")) {
                             outbuf = "+ new file\n";
                             state = STATE_GET_LENGTH;
                         } else {
                             outbuf = "- failed\n";
                         }
                     } else if (strncmp(&buf[5], "APP", 3) == 0) {
-                        fd = fopen(fn, "a");
-                        if (fd != NULL) {
+                        if (file.open(fn, "a")) {
                             outbuf = "+ append file\n";
                             state = STATE_GET_LENGTH;
                         } else {
@@ -103,8 +94,7 @@ int Sftpd::handle_command()
 
         } else if (state == STATE_GET_LENGTH) {
             if (len < 6 || strncmp(buf, "SIZE", 4) != 0) {
-                fclose(fd);
-                fd = NULL;
+                file.close();
                 outbuf = "- Expected size\n";
                 state = STATE_CONNECTED;
 
@@ -114,8 +104,7 @@ int Sftpd::handle_command()
                     outbuf = "+ ok, waiting for file\n";
                     state = STATE_DOWNLOAD;
                 } else {
-                    fclose(fd);
-                    fd = NULL;
+                    file.close();
                     outbuf = "- bad filesize\n";
                     state = STATE_CONNECTED;
                 }
@@ -139,29 +128,28 @@ int Sftpd::handle_download()
 
     if (filesize > 0 && readlen > 0) {
         if (readlen > filesize) readlen = filesize;
-        if (fwrite(readptr, 1, readlen, fd) != readlen) {
+        if (!file.write(readptr, readlen)) {
             DEBUG_PRINTF("sftp: Error writing file\n");
-            fclose(fd);
-            fd = NULL;
+            file.close();
             outbuf = "- Error saving file\n";
             state = STATE_CONNECTED;
             return 0;
         }
         filesize -= readlen;
-        DEBUG_PRINTF("sftp: saved %d bytes %d left\n", readlen, filesize);
-        // HACK ALERT... to work around the fwrite/filesystem bug where writing large amounts of data corrupts the file
-        // we workaround by closing the file, the reopening for append until we are done
-        fclose(fd);
-        fd = fopen(this->filename, "a");
+        DEBUG_PRINTF("sftp: buffered %d bytes %d left\n", readlen, filesize);
     }
     if (filesize == 0) {
         DEBUG_PRINTF("sftp: download complete\n");
-        fclose(fd);
-        fd = NULL;
-        outbuf = "+ Saved file\n";
+        outbuf = file.close() ? "+ Saved file\n" : "- Error saving file\n";
         state = STATE_CONNECTED;
         return 0;
     }
+
+    // hold the sender off until Network::on_idle has written enough of the buffer to take another segment
+    if (file.space() < uip_initialmss()) {
+        uip_stop();
+        file.wake_conn = uip_conn;
+    }
     return 1;
 }
 
@@ -190,9 +178,7 @@ void Sftpd::appcall(void)
 
     if (uip_closed() || uip_aborted() || uip_timedout()) {
         DEBUG_PRINTF("sftp: closed\n");
-        if (fd != NULL)
-            fclose(fd);
-        fd = NULL;
+        file.close();
         state = STATE_NORMAL;
         return;
     }
@@ -218,6 +204,18 @@ void Sftpd::appcall(void)
         this->senddata();
     }
 
+    // polled by Network once the upload buffer has room again, or it failed and there is an error to send
+    if (uip_poll() && uip_stopped(uip_conn) && (!file.is_open() || file.has_failed() || file.space() >= uip_initialmss())) {
+        if (file.has_failed()) {
+            file.close();
+            outbuf = "- Error saving file\n";
+            state = STATE_CONNECTED;
+            PSOCK_INIT(&sin, buf, sizeof(buf));
+            this->senddata();
+        }
+        uip_restart();
+    }
+
 }
 
 void Sftpd::init(void)
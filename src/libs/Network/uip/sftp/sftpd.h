@@ -7,6 +7,7 @@
 
 
 #include <stdio.h>
+#include "WriteBehind.h"
 extern "C" {
 #include "psock.h"
 }
@@ -21,7 +22,7 @@ public:
     void init(void);
 
 private:
-    FILE *fd;
+    WriteBehind file;
     enum STATES { STATE_NORMAL, STATE_CONNECTED, STATE_GET_LENGTH, STATE_DOWNLOAD, STATE_CLOSE };
     STATES state;
     int acked();
@@ -33,7 +34,6 @@ private:
     char buf[80];
     const char *outbuf;
     unsigned int filesize;
-    char *filename;
 };
 
 #endif /* __sftpd_H__ */
@@ -45,6 +45,7 @@
 #include "CallbackStream.h"
 #include "StreamOutputPool.h"
 #include "CommandQueue.h"
+#include "LPC17XX_Ethernet.h"
 
 //#define DEBUG_PRINTF(...)
 #define DEBUG_PRINTF printf
@@ -101,6 +102,8 @@ static void connections(char *str, Shell *sh)
     struct uip_conn *connr;
     snprintf(istr, sizeof(istr), "Initial MSS: %d, MSS: %d\n", uip_initialmss(), uip_mss());
     sh->output(istr);
+    snprintf(istr, sizeof(istr), "Broadcasts dropped: %lu\n", LPC17XX_Ethernet::instance->get_dropped_broadcasts());
+    sh->output(istr);
     sh->output("Current connections: \n");
 
     for (connr = &uip_conns[0]; connr <= &uip_conns[UIP_CONNS - 1]; ++connr) {
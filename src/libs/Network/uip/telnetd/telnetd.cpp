@@ -64,137 +64,63 @@
 //#define DEBUG_PRINTF(...)
 #define DEBUG_PRINTF printf
 
-static char *alloc_line(int size)
-{
-    return (char *)malloc(size);
-}
-
-static void dealloc_line(char *line)
-{
-    free(line);
-}
-
 void Telnetd::close()
 {
     state = STATE_CLOSE;
 }
 
-int Telnetd::sendline(char *line)
-{
-    int i;
-    for (i = 0; i < TELNETD_CONF_NUMLINES; ++i) {
-        if (lines[i] == NULL) {
-            lines[i] = line;
-            return i;
-        }
-    }
-    if (i == TELNETD_CONF_NUMLINES) {
-        dealloc_line(line);
-    }
-    return TELNETD_CONF_NUMLINES;
-}
-
 void Telnetd::output_prompt(const char *str)
 {
     if(prompt) output(str);
 }
 
+// adds the output to the ring, it goes out with whatever else is there on the next ack or poll
+// what does not fit is dropped, returns how much was added
 int Telnetd::output(const char *str)
 {
     if(state == STATE_CLOSE) return -1;
+    if(outbuf == NULL) return 0;
 
-    unsigned chunk = 256; // small chunk size so we don't allocate huge blocks, and must be less than mss
     unsigned len = strlen(str);
-    char *line;
-    if (len < chunk) {
-        // can be sent in one tcp buffer
-        line = alloc_line(len + 1);
-        if (line != NULL) {
-            strcpy(line, str);
-            return sendline(line);
-        }else{
-            // out of memory treat like full
-            return TELNETD_CONF_NUMLINES;
-        }
-    } else {
-        // need to split line over multiple send lines
-        int size = chunk; // size to copy
-        int off = 0;
-        int n= 0;
-        while (len >= chunk) {
-            line = alloc_line(chunk + 1);
-            if (line != NULL) {
-                memcpy(line, str + off, size);
-                line[size] = 0;
-                n= sendline(line);
-                len -= size;
-                off += size;
-            }else{
-                // out of memory treat like full
-                return TELNETD_CONF_NUMLINES;
-            }
-        }
-        if (len > 0) {
-            // send rest
-            line = alloc_line(len + 1);
-            if (line != NULL) {
-                strcpy(line, str + off);
-                n= sendline(line);
-            }else{
-                // out of memory treat like full
-                return TELNETD_CONF_NUMLINES;
-            }
-        }
-        return n;
-    }
+    unsigned room = TELNETD_CONF_OUTBUFSIZE - out_len;
+    if (len > room) len = room;
+
+    unsigned tail = (out_head + out_len) % TELNETD_CONF_OUTBUFSIZE;
+    unsigned n = TELNETD_CONF_OUTBUFSIZE - tail;
+    if (n > len) n = len;
+    memcpy(outbuf + tail, str, n);
+    memcpy(outbuf, str + n, len - n);
+    out_len += len;
+    return len;
 }
 
 // check if we can queue or if queue is full
 int Telnetd::can_output()
 {
     if(state == STATE_CLOSE) return -1;
-
-    int i;
-    int cnt = 0;
-    for (i = 0; i < TELNETD_CONF_NUMLINES; ++i) {
-        if (lines[i] == NULL) cnt++;
-    }
-    return cnt < 4 ? 0 : 1;
+    return (outbuf != NULL && TELNETD_CONF_OUTBUFSIZE - out_len >= TELNETD_CONF_MINFREE) ? 1 : 0;
 }
 
 void Telnetd::acked(void)
 {
-    while (numsent > 0) {
-        dealloc_line(lines[0]);
-        for (int i = 1; i < TELNETD_CONF_NUMLINES; ++i) {
-            lines[i - 1] = lines[i];
-        }
-        lines[TELNETD_CONF_NUMLINES - 1] = NULL;
-        --numsent;
-    }
+    out_head = (out_head + sent_len) % TELNETD_CONF_OUTBUFSIZE;
+    out_len -= sent_len;
+    sent_len = 0;
 }
 
+// a new segment takes as much of the output as fits, while one is waiting for its ack only that one can be sent again
 void Telnetd::senddata(void)
 {
-    // NOTE this sends as many lines as it can fit in one tcp frame
-    // we need to keep the lines under the size of the tcp frame
-    char *bufptr, *lineptr;
-    int buflen, linelen;
-
-    bufptr = (char *)uip_appdata;
-    buflen = 0;
-    for (numsent = 0; numsent < TELNETD_CONF_NUMLINES && lines[numsent] != NULL ; ++numsent) {
-        lineptr = lines[numsent];
-        linelen = strlen(lineptr);
-        if (buflen + linelen < uip_mss()) {
-            memcpy(bufptr, lineptr, linelen);
-            bufptr += linelen;
-            buflen += linelen;
-        } else {
-            break;
-        }
+    if (sent_len == 0) {
+        sent_len = out_len < uip_mss() ? out_len : uip_mss();
     }
-    uip_send(uip_appdata, buflen);
+    if (sent_len == 0) return;
+
+    unsigned n = TELNETD_CONF_OUTBUFSIZE - out_head;
+    if (n > sent_len) n = sent_len;
+    memcpy(uip_appdata, outbuf + out_head, n);
+    memcpy((char *)uip_appdata + n, outbuf, sent_len - n);
+    uip_send(uip_appdata, sent_len);
 }
 
 void Telnetd::get_char(u8_t c)
@@ -329,9 +255,8 @@ void Telnetd::poll()
 Telnetd::Telnetd()
 {
     DEBUG_PRINTF("Telnetd: ctor %p\n", this);
-    for (int i = 0; i < TELNETD_CONF_NUMLINES; ++i) {
-        lines[i] = NULL;
-    }
+    outbuf= (char *)malloc(TELNETD_CONF_OUTBUFSIZE);
+    out_head= out_len= sent_len= 0;
 
     first_time= true;
     bufptr = 0;
@@ -343,9 +268,7 @@ Telnetd::Telnetd()
 Telnetd::~Telnetd()
 {
     DEBUG_PRINTF("Telnetd: dtor %p\n", this);
-    for (int i = 0; i < TELNETD_CONF_NUMLINES; ++i) {
-        if (lines[i] != NULL) dealloc_line(lines[i]);
-    }
+    free(outbuf);
     delete shell;
 }
 
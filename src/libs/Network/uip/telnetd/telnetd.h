@@ -55,15 +55,18 @@ public:
 
 private:
     static const int TELNETD_CONF_MAXCOMMANDLENGTH= 132;
-    static const int TELNETD_CONF_NUMLINES= 32;
+    // the output is held in a ring until it is sent and acked, and is sent in segments as big as the mss
+    static const int TELNETD_CONF_OUTBUFSIZE= 1024;
+    static const int TELNETD_CONF_MINFREE= 256;    // can_output() is false with less room than this
 
     Shell *shell;
 
-    // FIXME this needs to be a FIFO
-    char *lines[TELNETD_CONF_NUMLINES];
+    char *outbuf;
+    uint16_t out_head;  // the oldest byte that is not acked
+    uint16_t out_len;   // bytes held
+    uint16_t sent_len;  // of them sent in the segment waiting for its ack, which is what a retransmit sends again
     char buf[TELNETD_CONF_MAXCOMMANDLENGTH];
     char bufptr;
-    uint8_t numsent;
     uint8_t state;
     uint16_t rport;
 
@@ -71,7 +74,6 @@ private:
 
     bool first_time;
 
-    int sendline(char *line);
     void acked(void);
     void senddata(void);
     void get_char(uint8_t c);
@@ -370,6 +370,15 @@ uip_arp_out(void)
   /* First check if destination is a local broadcast. */
   if(uip_ipaddr_cmp(IPBUF->destipaddr, broadcast_ipaddr)) {
     memcpy(IPBUF->ethhdr.dest.addr, broadcast_ethaddr.addr, 6);
+  } else if((((u8_t *)IPBUF->destipaddr)[0] & 0xf0) == 0xe0) {
+    /* An IPv4 multicast group, its MAC address is 01:00:5e and the
+       low 23 bits of the group, there is nothing to ARP for. */
+    IPBUF->ethhdr.dest.addr[0] = 0x01;
+    IPBUF->ethhdr.dest.addr[1] = 0x00;
+    IPBUF->ethhdr.dest.addr[2] = 0x5e;
+    IPBUF->ethhdr.dest.addr[3] = ((u8_t *)IPBUF->destipaddr)[1] & 0x7f;
+    IPBUF->ethhdr.dest.addr[4] = ((u8_t *)IPBUF->destipaddr)[2];
+    IPBUF->ethhdr.dest.addr[5] = ((u8_t *)IPBUF->destipaddr)[3];
   } else {
     /* Check if the destination address is on the local network. */
     if(!uip_ipaddr_maskcmp(IPBUF->destipaddr, uip_hostaddr, uip_netmask)) {
@@ -9,6 +9,9 @@ extern const char http_11[9];
 extern const char http_content_type[15];
 extern const char http_content_length[17];
 extern const char http_cache_control[16];
+extern const char http_accept_encoding[18];
+extern const char http_if_none_match[16];
+extern const char http_gzip[5];
 extern const char http_no_cache[9];
 extern const char http_texthtml[10];
 extern const char http_location[11];
@@ -16,9 +19,11 @@ extern const char http_host[7];
 extern const char http_crnl[3];
 extern const char http_index_html[12];
 extern const char http_404_html[10];
+extern const char http_status[8];
+extern const char http_webif[10];
 extern const char http_referer[9];
 extern const char http_header_200[86];
-extern const char http_header_304[152];
+extern const char http_header_304[64];
 extern const char http_header_404[61];
 extern const char http_header_503[58];
 extern const char http_content_type_plain[29];
@@ -28,11 +33,14 @@ extern const char http_content_type_text[28];
 extern const char http_content_type_png [28];
 extern const char http_content_type_gif [28];
 extern const char http_content_type_jpg [29];
+extern const char http_content_type_js  [41];
+extern const char http_content_type_json[60];
 extern const char http_content_type_binary[43];
 extern const char http_html[6];
 extern const char http_shtml[7];
 extern const char http_htm[5];
 extern const char http_css[5];
+extern const char http_js[4];
 extern const char http_png[5];
 extern const char http_gif[5];
 extern const char http_jpg[5];
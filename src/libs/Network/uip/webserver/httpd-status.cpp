@@ -0,0 +1,145 @@
+#include "httpd.h"
+
+#include "Kernel.h"
+#include "libs/nuts_bolts.h"
+#include "Robot.h"
+#include "Conveyor.h"
+#include "StepperMotor.h"
+#include "BaseSolution.h"
+#include "PublicData.h"
+#include "checksumm.h"
+#include "EndstopsPublicAccess.h"
+#include "PlayerPublicAccess.h"
+#include "TemperatureControlPublicAccess.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string>
+#include <vector>
+
+// append to buf, n is left at the length it would have been had it fitted
+static void put(char *buf, int size, int &n, const char *fmt, ...)
+{
+    if (n >= size) return;
+    va_list args;
+    va_start(args, fmt);
+    n += vsnprintf(&buf[n], size - n, fmt, args);
+    va_end(args);
+}
+
+// the state as the ? query names it, running is set while it is moving
+static const char *machine_state(bool &running)
+{
+    bool homing;
+    if (!PublicData::get_value(endstops_checksum, get_homing_status_checksum, 0, &homing)) homing = false;
+
+    running = false;
+    if (THEKERNEL->is_halted()) return "Alarm";
+    if (homing) return "Home";
+    if (THEKERNEL->get_feed_hold()) return "Hold";
+    if (THEKERNEL->conveyor->is_queue_empty()) return "Idle";
+    running = true;
+    return "Run";
+}
+
+// same positions as the ? query, real time while moving
+static void machine_position(bool running, float mpos[3])
+{
+    Robot *robot = THEKERNEL->robot;
+    if (running) {
+        robot->get_realtime_position(mpos);
+    } else {
+        Robot::wcs_t p = robot->get_axis_position();
+        mpos[X_AXIS] = std::get<X_AXIS>(p);
+        mpos[Y_AXIS] = std::get<Y_AXIS>(p);
+        mpos[Z_AXIS] = std::get<Z_AXIS>(p);
+    }
+}
+
+// The machine state for GET /status, so a web UI can poll it instead of parsing console replies
+extern "C" int httpd_status_json(char *buf, int size)
+{
+    Robot *robot = THEKERNEL->robot;
+    int n = 0;
+
+    bool running;
+    const char *state = machine_state(running);
+    float mpos[3];
+    machine_position(running, mpos);
+    Robot::wcs_t wpos = robot->mcs2wcs(mpos);
+
+    put(buf, size, n, "{\"state\":\"%s\",\"mpos\":[%1.4f,%1.4f,%1.4f],\"wpos\":[%1.4f,%1.4f,%1.4f]", state,
+        robot->from_millimeters(mpos[X_AXIS]), robot->from_millimeters(mpos[Y_AXIS]), robot->from_millimeters(mpos[Z_AXIS]),
+        robot->from_millimeters(std::get<X_AXIS>(wpos)), robot->from_millimeters(std::get<Y_AXIS>(wpos)), robot->from_millimeters(std::get<Z_AXIS>(wpos)));
+
+    void *returned_data;
+    if (PublicData::get_value(player_checksum, get_progress_checksum, &returned_data)) {
+        struct pad_progress p = *static_cast<struct pad_progress *>(returned_data);
+        // quotes and backslashes would need escaping, they are not expected in a filename
+        for (auto &c : p.filename) {
+            if (c == '"' || c == '\\' || c < ' ') c = '_';
+        }
+        put(buf, size, n, ",\"playing\":{\"file\":\"%s\",\"percent\":%u,\"elapsed\":%lu", p.filename.c_str(), p.percent_complete, p.elapsed_secs);
+        if (p.remaining_secs > 0) put(buf, size, n, ",\"remaining\":%lu", p.remaining_secs);
+        put(buf, size, n, "}");
+    }
+
+    const char *upload_name;
+    long received, upload_size;
+    if (httpd_upload_progress(&upload_name, &received, &upload_size)) {
+        put(buf, size, n, ",\"upload\":{\"file\":\"%s\",\"received\":%ld,\"size\":%ld}", upload_name, received, upload_size);
+    }
+
+    if (PublicData::get_value(temperature_control_checksum, temperature_snapshot_checksum, &returned_data)) {
+        const pad_temperature_snapshot *s = static_cast<const pad_temperature_snapshot *>(returned_data);
+        put(buf, size, n, ",\"temperatures\":[");
+        const char *sep = "";
+        for (int i = 0; i < s->count; ++i) {
+            const pad_temperature_row &c = s->rows[i];
+            put(buf, size, n, "%s{\"name\":\"%s\",\"current\":%1.1f,\"target\":%1.1f,\"pwm\":%d}", sep, c.designator, c.current_temperature, c.target_temperature, c.pwm);
+            sep = ",";
+        }
+        put(buf, size, n, "]");
+    }
+
+    put(buf, size, n, "}\r\n");
+    return n < size ? n : size - 1;
+}
+
+// A shorter form of the same for the status datagram Network sends, it has to fit in one of uIP's 400 byte buffers:
+// {"host":"name","state":"Run","mpos":[x,y,z],"queue":n,"job":[percent,elapsed,remaining],"temps":[["T",cur,target],...]}
+extern "C" int httpd_status_datagram(char *buf, int size, const char *host)
+{
+    Robot *robot = THEKERNEL->robot;
+    int n = 0;
+
+    bool running;
+    const char *state = machine_state(running);
+    float mpos[3];
+    machine_position(running, mpos);
+
+    put(buf, size, n, "{\"host\":\"%s\",\"state\":\"%s\",\"mpos\":[%1.3f,%1.3f,%1.3f],\"queue\":%u", host, state,
+        robot->from_millimeters(mpos[X_AXIS]), robot->from_millimeters(mpos[Y_AXIS]), robot->from_millimeters(mpos[Z_AXIS]),
+        THEKERNEL->conveyor->queue_depth());
+
+    void *returned_data;
+    if (PublicData::get_value(player_checksum, get_progress_checksum, &returned_data)) {
+        struct pad_progress *p = static_cast<struct pad_progress *>(returned_data);
+        put(buf, size, n, ",\"job\":[%u,%lu,%lu]", p->percent_complete, p->elapsed_secs, p->remaining_secs);
+    }
+
+    if (PublicData::get_value(temperature_control_checksum, temperature_snapshot_checksum, &returned_data)) {
+        const pad_temperature_snapshot *s = static_cast<const pad_temperature_snapshot *>(returned_data);
+        put(buf, size, n, ",\"temps\":[");
+        const char *sep = "";
+        for (int i = 0; i < s->count; ++i) {
+            const pad_temperature_row &c = s->rows[i];
+            put(buf, size, n, "%s[\"%s\",%1.1f,%1.0f]", sep, c.designator, c.current_temperature, c.target_temperature);
+            sep = ",";
+        }
+        put(buf, size, n, "]");
+    }
+
+    put(buf, size, n, "}\n");
+    return n < size ? n : size - 1;
+}
@@ -0,0 +1,84 @@
+#include "httpd.h"
+#include "WriteBehind.h"
+#include "crc32.h"
+
+extern "C" {
+#include "uip.h"
+}
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+// The body of a POST or PUT to /upload goes through a WriteBehind, so the connection takes the next segment while
+// Network::on_idle writes the last ones to the sdcard, and is only held off when the buffer is nearly full.
+// There is one upload at a time, the state of the connection doing it is kept so GET /status can show its progress.
+static WriteBehind upload;
+static std::string upload_path;
+static void *upload_owner;
+static long upload_size, upload_received;
+static uint32_t upload_crc;
+
+extern "C" int httpd_upload_open(void *owner, const char *name, long size)
+{
+    if (upload.is_open()) return 0;
+
+    upload_path = std::string("/sd/") + name;
+    if (!upload.open(upload_path.c_str(), "w")) return 0;
+    upload_owner = owner;
+    upload_size = size;
+    upload_received = 0;
+    upload_crc = 0;
+    return 1;
+}
+
+extern "C" int httpd_upload_write(const void *data, int len)
+{
+    upload_crc = crc32_update(upload_crc, data, len);
+    upload_received += len;
+    if (!upload.write(data, len)) return 0;
+
+    // hold the sender off until Network::on_idle has written enough of the buffer to take another segment
+    if (upload.space() < uip_initialmss()) {
+        uip_stop();
+        upload.wake_conn = uip_conn;
+    }
+    return 1;
+}
+
+// polled by Network once the buffer has room again, or it failed and the connection has to go on to say so
+extern "C" int httpd_upload_ready(void)
+{
+    return !upload.is_open() || upload.has_failed() || upload.space() >= uip_initialmss();
+}
+
+// 1 when all of it was written, and it matches the CRC-32 the sender gave if it gave one, otherwise the file is removed
+extern "C" int httpd_upload_close(int check, uint32_t crc)
+{
+    int ok = upload.close() ? 1 : 0;
+    if (ok && check && crc != upload_crc) {
+        printf("upload of %s failed, CRC-32 %08lx expected %08lx\n", upload_path.c_str(), (unsigned long)upload_crc, (unsigned long)crc);
+        ok = -1;
+    }
+    if (ok != 1) remove(upload_path.c_str());
+    upload_owner = NULL;
+    return ok;
+}
+
+// a connection that closes part way through leaves no partial file
+extern "C" void httpd_upload_abort(void *owner)
+{
+    if (owner == NULL || owner != upload_owner) return;
+    upload.close();
+    remove(upload_path.c_str());
+    upload_owner = NULL;
+}
+
+extern "C" int httpd_upload_progress(const char **name, long *received, long *size)
+{
+    if (upload_owner == NULL) return 0;
+    *name = upload_path.c_str();
+    *received = upload_received;
+    *size = upload_size;
+    return 1;
+}
@@ -76,6 +76,7 @@
 #include "CallbackStream.h"
 
 #include "c-fifo.h"
+#include "ff.h"
 
 #define STATE_WAITING 0
 #define STATE_HEADERS 1
@@ -85,6 +86,7 @@
 
 #define GET  1
 #define POST 2
+#define PUT  3
 
 #define ISO_nl      0x0a
 #define ISO_space   0x20
@@ -139,66 +141,77 @@ static void create_callback_stream(struct httpd_state *s)
     s->pstream = new_callback_stream(command_result, s);
 }
 
-// Used to save files to SDCARD during upload
-static FILE *fd;
-static char *output_filename = NULL;
-static int file_cnt = 0;
-static int open_file(const char *fn)
+// a POST or a PUT of a file, the name is in X-Filename
+static int is_upload(struct httpd_state *s)
 {
-    if (output_filename != NULL) free(output_filename);
-    output_filename = malloc(strlen(fn) + 5);
-    strcpy(output_filename, "/sd/");
-    strcat(output_filename, fn);
-    fd = fopen(output_filename, "w");
-    if (fd == NULL) {
-        free(output_filename);
-        output_filename = NULL;
-        return 0;
-    }
-    return 1;
+    return (s->method == POST || s->method == PUT) && strcmp(s->filename, "/upload") == 0;
 }
 
-static int close_file()
+static uint32_t etag_hash(const void *data, int len, uint32_t h)
 {
-    free(output_filename);
-    output_filename = NULL;
-    fclose(fd);
-    return 1;
+    const uint8_t *p = (const uint8_t *)data;
+    while (len-- > 0) {
+        h = (h ^ *p++) * 16777619UL;
+    }
+    return h;
 }
 
-static int save_file(uint8_t *buf, unsigned int len)
+static int sd_open(struct httpd_state *s, const char *fn)
 {
-    if (fwrite(buf, 1, len, fd) == len) {
-        file_cnt += len;
-        // HACK alert work around bug causing file corruption when writing large amounts of data
-        if (file_cnt >= 400) {
-            file_cnt = 0;
-            fclose(fd);
-            fd = fopen(output_filename, "a");
-        }
-        return 1;
+    FILINFO fno;
+    char path[80];
 
-    } else {
-        close_file();
+    DEBUG_PRINTF("Opening file %s\n", fn);
+    s->fd = fopen(fn, "r");
+    if (s->fd == NULL) {
+        DEBUG_PRINTF("Failed to open: %s\n", fn);
         return 0;
     }
+
+    // the size and modified time make the etag, the sdcard is the first FAT drive so /sd/x is 0:/x
+    s->sd_size = -1;
+    s->sd_pos = 0;
+    fno.lfname = NULL;
+    fno.lfsize = 0;
+    snprintf(path, sizeof(path), "0:%s", &fn[3]);
+    if (f_stat(path, &fno) == FR_OK) {
+        s->sd_size = fno.fsize;
+        s->etag = etag_hash(&fno.fsize, sizeof(fno.fsize), 2166136261UL);
+        s->etag = etag_hash(&fno.fdate, sizeof(fno.fdate), s->etag);
+        s->etag = etag_hash(&fno.ftime, sizeof(fno.ftime), s->etag);
+    }
+    return 1;
 }
 
 static int fs_open(struct httpd_state *s)
 {
+    char path[80];
+
+    s->fd = NULL;
+    s->gzip = 0;
+    s->etag = 0;
     if (strncmp(s->filename, "/sd/", 4) == 0) {
-        DEBUG_PRINTF("Opening file %s\n", s->filename);
-        s->fd = fopen(s->filename, "r");
-        if (s->fd == NULL) {
-            DEBUG_PRINTF("Failed to open: %s\n", s->filename);
-            return 0;
-        }
-        return 1;
+        return sd_open(s, s->filename);
+    }
 
-    } else {
-        s->fd = NULL;
-        return httpd_fs_open(s->filename, &s->file);
+    // a web UI on the sdcard is served in place of the compiled in one, a gzip'd copy as it is if the browser takes it
+    if (strlen(http_webif) + strlen(s->filename) + 4 <= sizeof(path)) {
+        strcpy(path, http_webif);
+        strcat(path, s->filename);
+        if (s->accept_gzip) {
+            strcat(path, ".gz");
+            if (sd_open(s, path)) {
+                s->gzip = 1;
+                return 1;
+            }
+            path[strlen(path) - 3] = 0;
+        }
+        if (sd_open(s, path)) return 1;
     }
+
+    if (!httpd_fs_open(s->filename, &s->file)) return 0;
+    s->etag = etag_hash(s->file.data, s->file.len, 2166136261UL);
+    return 1;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -243,8 +256,18 @@ static unsigned short generate_part_of_file(void *state)
 static unsigned short generate_part_of_sd_file(void *state)
 {
     struct httpd_state *s = (struct httpd_state *)state;
+    int len;
+
+    // a retransmission has to send the same part again
+    if (uip_rexmit()) {
+        fseek(s->fd, s->sd_pos, SEEK_SET);
+    } else {
+        s->sd_pos = ftell(s->fd);
+    }
+    len = uip_mss();
+    if (s->sd_size >= 0 && s->sd_size - s->sd_pos < len) len = s->sd_size - s->sd_pos;
 
-    int len = fread(uip_appdata, 1, uip_mss(), s->fd);
+    if (len > 0) len = fread(uip_appdata, 1, len, s->fd);
     if (len <= 0) {
         // we need to send something
         strcpy(uip_appdata, "\r\n");
@@ -275,9 +298,10 @@ static PT_THREAD(send_sd_file(struct httpd_state *s))
 {
     PSOCK_BEGIN(&s->sout);
 
+    // sent a segment at a time, until the size from the directory entry or the end of the file
     do {
         PSOCK_GENERATOR_SEND(&s->sout, generate_part_of_sd_file, s);
-    } while (s->len > 0);
+    } while (s->len > 0 && (s->sd_size < 0 || s->sd_pos + s->len < s->sd_size));
 
     fclose(s->fd);
     s->fd = NULL;
@@ -294,7 +318,27 @@ static PT_THREAD(send_headers_3(struct httpd_state *s, const char *statushdr, ch
 
     PSOCK_SEND_STR(&s->sout, statushdr);
 
-    if (send_content_type) {
+    // inputbuf is free once the request has been read
+    if (s->method == GET) {
+        int n = 0;
+        s->inputbuf[0] = 0;
+        if (s->gzip) {
+            n += snprintf(&s->inputbuf[n], sizeof(s->inputbuf) - n, "Content-Encoding: gzip\r\n");
+        }
+        if (s->etag != 0) {
+            // the browser has to check it is still the same, which the etag makes a 304 with no body
+            n += snprintf(&s->inputbuf[n], sizeof(s->inputbuf) - n, "ETag: \"%08lx\"\r\nCache-Control: no-cache\r\n", (unsigned long)s->etag);
+        }
+        if (s->fd != NULL && s->sd_size >= 0 && send_content_type) {
+            n += snprintf(&s->inputbuf[n], sizeof(s->inputbuf) - n, "Content-Length: %ld\r\n", s->sd_size);
+        }
+        if (n > 0) PSOCK_SEND_STR(&s->sout, s->inputbuf);
+    }
+
+    if (!send_content_type) {
+        PSOCK_SEND_STR(&s->sout, http_crnl);
+
+    } else {
         ptr = strrchr(s->filename, ISO_period);
         if (ptr == NULL) {
             PSOCK_SEND_STR(&s->sout, http_content_type_plain); // http_content_type_binary);
@@ -302,6 +346,8 @@ static PT_THREAD(send_headers_3(struct httpd_state *s, const char *statushdr, ch
             PSOCK_SEND_STR(&s->sout, http_content_type_html);
         } else if (strncmp(http_css, ptr, 4) == 0) {
             PSOCK_SEND_STR(&s->sout, http_content_type_css);
+        } else if (strncmp(http_js, ptr, 4) == 0) {
+            PSOCK_SEND_STR(&s->sout, http_content_type_js);
         } else if (strncmp(http_png, ptr, 4) == 0) {
             PSOCK_SEND_STR(&s->sout, http_content_type_png);
         } else if (strncmp(http_gif, ptr, 4) == 0) {
@@ -319,12 +365,23 @@ static PT_THREAD(send_headers(struct httpd_state *s, const char *statushdr))
     return send_headers_3(s, statushdr, 1);
 }
 /*---------------------------------------------------------------------------*/
+static PT_THREAD(send_status(struct httpd_state *s))
+{
+    PSOCK_BEGIN(&s->sout);
+
+    PSOCK_SEND_STR(&s->sout, http_header_200);
+    PSOCK_SEND_STR(&s->sout, http_content_type_json);
+    PSOCK_SEND_STR(&s->sout, s->strbuf);
+
+    PSOCK_END(&s->sout);
+}
+/*---------------------------------------------------------------------------*/
 static
 PT_THREAD(handle_output(struct httpd_state *s))
 {
     PT_BEGIN(&s->outputpt);
 
-    if (s->method == POST) {
+    if (s->method != GET) {
         if (strcmp(s->filename, "/command") == 0) {
             DEBUG_PRINTF("Executed command post\n");
             PT_WAIT_THREAD(&s->outputpt, send_headers(s, http_header_200));
@@ -335,11 +392,14 @@ PT_THREAD(handle_output(struct httpd_state *s))
             DEBUG_PRINTF("Executed silent command post\n");
             PT_WAIT_THREAD(&s->outputpt, send_headers(s, http_header_200));
 
-        } else if (strcmp(s->filename, "/upload") == 0) {
+        } else if (is_upload(s)) {
             DEBUG_PRINTF("upload output: %d\n", s->uploadok);
             if (s->uploadok == 0) {
                 PT_WAIT_THREAD(&s->outputpt, send_headers(s, http_header_503));
                 PSOCK_SEND_STR(&s->sout, "FAILED\r\n");
+            } else if (s->uploadok < 0) {
+                PT_WAIT_THREAD(&s->outputpt, send_headers(s, http_header_503));
+                PSOCK_SEND_STR(&s->sout, "CRC MISMATCH\r\n");
             } else {
                 PT_WAIT_THREAD(&s->outputpt, send_headers(s, http_header_200));
                 PSOCK_SEND_STR(&s->sout, "OK\r\n");
@@ -353,6 +413,17 @@ PT_THREAD(handle_output(struct httpd_state *s))
             PT_WAIT_THREAD(&s->outputpt, send_file(s));
         }
 
+    } else if (strcmp(s->filename, http_status) == 0) {
+        s->strbuf = malloc(512);
+        if (s->strbuf == NULL) {
+            PT_WAIT_THREAD(&s->outputpt, send_headers_3(s, http_header_503, 0));
+        } else {
+            httpd_status_json(s->strbuf, 512);
+            PT_WAIT_THREAD(&s->outputpt, send_status(s));
+            free(s->strbuf);
+            s->strbuf = NULL;
+        }
+
     } else {
         // Presume method GET
         if (!fs_open(s)) { // Note this has the side effect of opening the file
@@ -362,7 +433,7 @@ PT_THREAD(handle_output(struct httpd_state *s))
             PT_WAIT_THREAD(&s->outputpt, send_headers(s, http_header_404));
             PT_WAIT_THREAD(&s->outputpt, send_file(s));
 
-        } else if (s->cache_page) {
+        } else if (s->etag != 0 && s->etag == s->if_none_match) {
             if (s->fd != NULL) {
                 // if it was an sd file then we need to close it
                 fclose(s->fd);
@@ -418,7 +489,7 @@ static PT_THREAD(handle_uploaded_data(struct httpd_state *s, uint8_t *buf, int l
     DEBUG_PRINTF("Uploading file: %s, %d\n", s->upload_name, s->content_length);
 
     // The body is the raw data to be stored to the file
-    if (!open_file(s->upload_name)) {
+    if (!httpd_upload_open(s, s->upload_name, s->content_length)) {
         DEBUG_PRINTF("failed to open file\n");
         s->uploadok = 0;
         PT_EXIT(&s->inputpt);
@@ -426,10 +497,12 @@ static PT_THREAD(handle_uploaded_data(struct httpd_state *s, uint8_t *buf, int l
 
     DEBUG_PRINTF("opened file: %s\n", s->upload_name);
 
+    if (len > s->content_length) len = s->content_length;
     if (len > 0) {
         // write the first part of the buffer
-        if (!save_file(buf, len)) {
+        if (!httpd_upload_write(buf, len)) {
             DEBUG_PRINTF("initial write failed\n");
+            httpd_upload_close(0, 0);
             s->uploadok = 0;
             PT_EXIT(&s->inputpt);
         }
@@ -447,9 +520,11 @@ static PT_THREAD(handle_uploaded_data(struct httpd_state *s, uint8_t *buf, int l
         int readlen = uip_datalen();
         //DEBUG_PRINTF("read %d bytes of data\n", readlen);
 
+        if (readlen > s->content_length) readlen = s->content_length;
         if (readlen > 0) {
-            if (!save_file(readptr, readlen)) {
+            if (!httpd_upload_write(readptr, readlen)) {
                 DEBUG_PRINTF("write failed\n");
+                httpd_upload_close(0, 0);
                 s->uploadok = 0;
                 PT_EXIT(&s->inputpt);
             }
@@ -457,9 +532,9 @@ static PT_THREAD(handle_uploaded_data(struct httpd_state *s, uint8_t *buf, int l
         }
     }
 
-    close_file();
-    s->uploadok = 1;
-    DEBUG_PRINTF("finished upload\n");
+    // what is still buffered is written out here, and then checked against the X-CRC32 the sender gave
+    s->uploadok = httpd_upload_close(s->upload_check, s->upload_crc);
+    DEBUG_PRINTF("finished upload: %d\n", s->uploadok);
 
     PT_END(&s->inputpt);
 }
@@ -475,12 +550,14 @@ PT_THREAD(handle_input(struct httpd_state *s))
         s->method = GET;
     } else if (strncmp(s->inputbuf, http_post, 4) == 0) {
         s->method = POST;
+    } else if (strncmp(s->inputbuf, "PUT ", 4) == 0) {
+        s->method = PUT;
     } else {
         DEBUG_PRINTF("Unexpected method: %s\n", s->inputbuf);
         PSOCK_CLOSE_EXIT(&s->sin);
     }
 
-    DEBUG_PRINTF("Method: %s\n", s->method == POST ? "POST" : "GET");
+    DEBUG_PRINTF("Method: %s\n", s->method == POST ? "POST" : s->method == PUT ? "PUT" : "GET");
 
     PSOCK_READTO(&s->sin, ISO_space);
 
@@ -501,7 +578,11 @@ PT_THREAD(handle_input(struct httpd_state *s))
 
     s->state = STATE_HEADERS;
     s->content_length = 0;
-    s->cache_page = 0;
+    s->accept_gzip = 0;
+    s->gzip = 0;
+    s->etag = 0;
+    s->if_none_match = 0;
+    s->upload_check = 0;
     while (1) {
         if (s->state == STATE_HEADERS) {
             // read the headers of the request
@@ -512,12 +593,13 @@ PT_THREAD(handle_input(struct httpd_state *s))
                 if (s->method == GET) {
                     s->state = STATE_OUTPUT;
                     break;
+                } else if (is_upload(s)) {
+                    s->state = STATE_UPLOAD;
                 } else if (s->method == POST) {
-                    if (strcmp(s->filename, "/upload") == 0) {
-                        s->state = STATE_UPLOAD;
-                    } else {
-                        s->state = STATE_BODY;
-                    }
+                    s->state = STATE_BODY;
+                } else {
+                    s->state = STATE_OUTPUT;
+                    break;
                 }
             } else {
                 DEBUG_PRINTF("reading header: %s\n", s->inputbuf);
@@ -532,10 +614,18 @@ PT_THREAD(handle_input(struct httpd_state *s))
                     strncpy(s->upload_name, &s->inputbuf[12], sizeof(s->upload_name) - 1);
                     DEBUG_PRINTF("Upload name= %s\n", s->upload_name);
 
-                } else if (strncmp(s->inputbuf, http_cache_control, sizeof(http_cache_control) - 1) == 0) {
-                    s->inputbuf[PSOCK_DATALEN(&s->sin) - 2] = 0;
-                    s->cache_page = strncmp(http_no_cache, &s->inputbuf[sizeof(http_cache_control) - 1], sizeof(http_no_cache) - 1) != 0;
-                    DEBUG_PRINTF("cache page= %d\n", s->cache_page);
+                } else if (strncmp(s->inputbuf, "X-CRC32: ", 9) == 0) {
+                    // the CRC-32 of the whole file, as zlib works it out, in hex
+                    s->upload_crc = strtoul(&s->inputbuf[9], NULL, 16);
+                    s->upload_check = 1;
+
+                } else if (strncmp(s->inputbuf, http_accept_encoding, sizeof(http_accept_encoding) - 1) == 0) {
+                    s->accept_gzip = strstr(&s->inputbuf[sizeof(http_accept_encoding) - 1], http_gzip) != NULL;
+
+                } else if (strncmp(s->inputbuf, http_if_none_match, sizeof(http_if_none_match) - 1) == 0) {
+                    // the etags we send are 8 hex digits in quotes
+                    s->if_none_match = strtoul(&s->inputbuf[sizeof(http_if_none_match)], NULL, 16);
+                    DEBUG_PRINTF("if none match= %08lx\n", (unsigned long)s->if_none_match);
                 }
             }
 
@@ -650,7 +740,8 @@ httpd_appcall(void)
 
     if (uip_closed() || uip_aborted() || uip_timedout()) {
         DEBUG_PRINTF("Closing connection: %d\n", HTONS(uip_conn->rport));
-        if (s->fd != NULL) fclose(fd); // clean up
+        if (s->fd != NULL) fclose(s->fd); // clean up
+        httpd_upload_abort(s);
         if (s->strbuf != NULL) free(s->strbuf);
         if (s->pstream != NULL) {
             // free these if they were allocated
@@ -661,6 +752,10 @@ httpd_appcall(void)
         uip_conn->appstate = NULL;
 
     } else {
+        // polled by Network once a held off upload can take another segment
+        if (uip_poll() && uip_stopped(uip_conn) && httpd_upload_ready()) {
+            uip_restart();
+        }
         handle_connection(s);
     }
 }
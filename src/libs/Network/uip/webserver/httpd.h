@@ -54,9 +54,16 @@ struct httpd_state {
   char *strbuf;
   int content_length;
   uint16_t count;
-  uint8_t uploadok;
+  int8_t uploadok;
+  uint8_t upload_check;
+  uint32_t upload_crc;
   uint8_t upload_state;
-  uint8_t cache_page;
+  uint8_t accept_gzip;
+  uint8_t gzip;
+  uint32_t etag;
+  uint32_t if_none_match;
+  long sd_size;
+  long sd_pos;
   void *pstream;
   void *fifo;
   uint16_t command_count;
@@ -68,6 +75,16 @@ extern "C" {
 
 void httpd_init(void);
 void httpd_appcall(void);
+int httpd_status_json(char *buf, int size);
+int httpd_status_datagram(char *buf, int size, const char *host);
+
+// streaming the body of an upload to the sdcard, see httpd-upload.cpp
+int httpd_upload_open(void *owner, const char *name, long size);
+int httpd_upload_write(const void *data, int len);
+int httpd_upload_ready(void);
+int httpd_upload_close(int check, uint32_t crc);
+void httpd_upload_abort(void *owner);
+int httpd_upload_progress(const char **name, long *received, long *size);
 
 void httpd_log(char *msg);
 void httpd_log_file(u16_t *requester, char *file);
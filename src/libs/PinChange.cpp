@@ -0,0 +1,104 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PinChange.h"
+#include "Kernel.h"
+#include "SlowTicker.h"
+#include "InterruptIn.h" // mbed
+#include "cmsis.h"
+
+PinChange *PinChange::instance= nullptr;
+
+PinChange::PinChange()
+{
+    ticking= false;
+}
+
+void PinChange::on_module_loaded()
+{
+    register_for_event(ON_MAIN_LOOP);
+    set_event_rate(ON_MAIN_LOOP, 0, true); // only for the deferred changes
+}
+
+bool PinChange::attach(const Pin &pin, callback_t callback, uint8_t debounce_ms, bool deferred)
+{
+    Pin p= pin;
+    if(!p.connected() || (p.port_number != 0 && p.port_number != 2)) return false;
+
+    if(instance == nullptr) {
+        instance= new PinChange();
+        THEKERNEL->add_module(instance, "pinchange");
+    }
+    if(debounce_ms > 0 && !instance->ticking) {
+        instance->ticking= true;
+        THEKERNEL->slow_ticker->attach(1000, instance, &PinChange::debounce_tick);
+    }
+
+    // creating the InterruptIn sets a pull down, the two mode bits of the pin are put back as they were
+    volatile uint32_t *pinmode= &LPC_PINCON->PINMODE0 + p.port_number * 2 + p.pin / 16;
+    uint32_t shift= (p.pin % 16) * 2;
+    uint32_t mode= *pinmode & (3 << shift);
+
+    Watch *w= new Watch(p, callback, debounce_ms, deferred);
+    *pinmode= (*pinmode & ~(3 << shift)) | mode;
+
+    // the debounce tick may be going through the list already
+    __disable_irq();
+    instance->watches.push_back(w);
+    __enable_irq();
+    w->irq->rise(w, &Watch::on_edge);
+    w->irq->fall(w, &Watch::on_edge);
+    return true;
+}
+
+PinChange::Watch::Watch(const Pin &pin, callback_t callback, uint8_t debounce_ms, bool deferred) : pin(pin), callback(callback)
+{
+    this->irq= this->pin.interrupt_pin();
+    this->debounce_ms= debounce_ms;
+    this->deferred= deferred;
+    this->countdown= 0;
+    this->pending= false;
+    this->state= this->pin.get();
+}
+
+// in the pin interrupt, each edge starts the debounce over so it ends the given time after the last bounce
+void PinChange::Watch::on_edge()
+{
+    if(debounce_ms == 0) settle();
+    else countdown= debounce_ms;
+}
+
+void PinChange::Watch::settle()
+{
+    bool now= pin.get();
+    if(now == state) return;
+    state= now;
+    if(deferred) {
+        pending= true;
+        instance->wake_for_event(ON_MAIN_LOOP);
+    } else {
+        callback(now);
+    }
+}
+
+uint32_t PinChange::debounce_tick(uint32_t dummy)
+{
+    for(auto w : watches) {
+        if(w->countdown > 0 && --w->countdown == 0) w->settle();
+    }
+    return 0;
+}
+
+void PinChange::on_main_loop(void *argument)
+{
+    for(auto w : watches) {
+        if(w->pending) {
+            w->pending= false;
+            w->callback(w->state);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PINCHANGE_H
+#define PINCHANGE_H
+
+#include "Module.h"
+#include "Pin.h"
+
+#include <stdint.h>
+#include <vector>
+#include <functional>
+
+namespace mbed {
+    class InterruptIn;
+}
+
+// One place for the inputs that want to know when a pin changes, instead of each polling it from on_idle or its own
+// SlowTicker hook. The pin must be on port 0 or 2, the ports with edge interrupts, otherwise attach() returns false and
+// the caller goes on polling it. The callback is given the state as Pin::get() reads it. With a debounce it is only
+// called once the pin has held a new state for that many ms, and it is called in an interrupt unless it is deferred to
+// the main loop. The edges come through mbed's InterruptIn, which owns the EINT3 vector the raw edge users share.
+class PinChange : public Module {
+    public:
+        typedef std::function<void(bool)> callback_t;
+
+        static bool attach(const Pin &pin, callback_t callback, uint8_t debounce_ms= 0, bool deferred= false);
+
+        void on_module_loaded();
+        void on_main_loop(void *argument);
+
+    private:
+        PinChange();
+
+        class Watch {
+            public:
+                Watch(const Pin &pin, callback_t callback, uint8_t debounce_ms, bool deferred);
+                void on_edge();
+                void settle();
+
+                Pin pin;
+                mbed::InterruptIn *irq;
+                callback_t callback;
+                uint8_t debounce_ms;
+                volatile uint8_t countdown;     // ms left until a changed pin is taken as settled
+                volatile bool state;            // the state last reported
+                volatile bool pending;          // changed, the main loop is to call the callback
+                bool deferred;
+        };
+
+        uint32_t debounce_tick(uint32_t dummy);
+
+        static PinChange *instance;
+        std::vector<Watch *> watches;
+        bool ticking;                           // the debounce hook is attached
+};
+
+#endif
@@ -2,12 +2,54 @@
 #include "PublicData.h"
 #include "PublicDataRequest.h"
 
+#include <algorithm>
+#include <vector>
+
+namespace {
+    struct handler_t {
+        uint16_t csa;
+        uint16_t csb;
+        Module *module;
+    };
+    bool by_csa(const handler_t &h, uint16_t csa) { return h.csa < csa; }
+
+    // sorted by csa
+    std::vector<handler_t> handlers;
+}
+
+void PublicData::register_handler(Module *module, uint16_t csa, uint16_t csb)
+{
+    auto i= std::upper_bound(handlers.begin(), handlers.end(), csa, [](uint16_t cs, const handler_t &h) { return cs < h.csa; });
+    handlers.insert(i, {csa, csb, module});
+}
+
+void PublicData::unregister_handlers(Module *module)
+{
+    handlers.erase(std::remove_if(handlers.begin(), handlers.end(), [module](const handler_t &h) { return h.module == module; }), handlers.end());
+}
+
+// pass the request to the modules registered for its csa, or to every module if there are none
+static void dispatch(_EVENT_ENUM id_event, uint16_t csa, uint16_t csb, PublicDataRequest *pdr)
+{
+    auto i= std::lower_bound(handlers.begin(), handlers.end(), csa, by_csa);
+    if(i == handlers.end() || i->csa != csa) {
+        THEKERNEL->call_event(id_event, pdr);
+        return;
+    }
+
+    for (; i != handlers.end() && i->csa == csa; ++i) {
+        if(i->csb == 0 || i->csb == csb) {
+            (i->module->*kernel_callback_functions[id_event])(pdr);
+        }
+    }
+}
+
 bool PublicData::get_value(uint16_t csa, uint16_t csb, uint16_t csc, void *data) {
     PublicDataRequest pdr(csa, csb, csc);
     // the caller may have created the storage for the returned data so we clear the flag,
     // if it gets set by the callee setting the data ptr that means the data is a pointer to a pointer and is set to a pointer to the returned data
     pdr.set_data_ptr(data, false);
-    THEKERNEL->call_event(ON_GET_PUBLIC_DATA, &pdr );
+    dispatch(ON_GET_PUBLIC_DATA, csa, csb, &pdr);
     if(pdr.is_taken() && pdr.has_returned_data()) {
         // the callee set the returned data pointer
         *(void**)data= pdr.get_data_ptr();
@@ -18,6 +60,6 @@ bool PublicData::get_value(uint16_t csa, uint16_t csb, uint16_t csc, void *data)
 bool PublicData::set_value(uint16_t csa, uint16_t csb, uint16_t csc, void *data) {
     PublicDataRequest pdr(csa, csb, csc);
     pdr.set_data_ptr(data);
-    THEKERNEL->call_event(ON_SET_PUBLIC_DATA, &pdr );
+    dispatch(ON_SET_PUBLIC_DATA, csa, csb, &pdr);
     return pdr.is_taken();
 }
@@ -8,8 +8,18 @@
 #ifndef PUBLICDATA_H
 #define PUBLICDATA_H
 
+#include <stdint.h>
+
+class Module;
+
 class PublicData {
     public:
+        // a module answering requests that start with csa (and csb when it is not 0) registers for them, those requests are then
+        // passed straight to the modules registered for them instead of to every module. Every module answering a csa has to register it,
+        // requests for a csa nobody registered are still passed to every module that registered for the event
+        static void register_handler(Module *module, uint16_t csa, uint16_t csb= 0);
+        static void unregister_handlers(Module *module);
+
         // there are two ways to get data from a module
         // 1. pass in a pointer to a data storage area that the caller creates, the callee module will put the returned data in that pointer
         // 2. pass in a pointer to a pointer, the callee will set that pointer to some storage the callee has control over, with the requested data
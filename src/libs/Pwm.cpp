@@ -1,28 +1,87 @@
 #include "Pwm.h"
 
 #include "nuts_bolts.h"
+#include "Kernel.h"
+#include "SlowTicker.h"
+#include "PwmOut.h" // mbed
 
 #define PID_PWM_MAX 256
 
 // What ?
 
+std::vector<Pwm::Group*> Pwm::groups;
+
 Pwm::Pwm()
 {
+    _hw = nullptr;
     _max = PID_PWM_MAX - 1;
     _pwm = -1;
     _sd_direction= false;
     _sd_accumulator= 0;
+    _started= false;
+}
+
+void Pwm::start(uint32_t frequency, bool hardware)
+{
+    if(_started) return;
+    _started= true;
+
+    // the hardware channels share the period set by whoever uses them, a heater only sets the duty cycle
+    if(hardware) {
+        _hw = hardware_pwm();
+        if(_hw != nullptr) {
+            write_hardware();
+            return;
+        }
+    }
+
+    Group *g= nullptr;
+    for(auto i : groups) {
+        if(i->frequency == frequency) g= i;
+    }
+
+    if(g == nullptr) {
+        g= new Group();
+        g->frequency= frequency;
+        groups.push_back(g);
+        __disable_irq();
+        g->pins.push_back(this);
+        __enable_irq();
+        THEKERNEL->slow_ticker->attach(frequency, g, &Group::tick);
+
+    } else {
+        // the tick walks the group from the interrupt
+        __disable_irq();
+        g->pins.push_back(this);
+        __enable_irq();
+    }
+}
+
+uint32_t Pwm::Group::tick(uint32_t dummy)
+{
+    for(auto p : pins) {
+        p->on_tick(dummy);
+    }
+    return dummy;
+}
+
+void Pwm::write_hardware()
+{
+    float duty= _pwm < 0 ? 0.0F : (float)_pwm / (PID_PWM_MAX - 1);
+    _hw->write(is_inverting() ? 1.0F - duty : duty);
 }
 
 void Pwm::pwm(int new_pwm)
 {
     _pwm = confine(new_pwm, 0, _max);
+    if(_hw != nullptr) write_hardware();
 }
 
 Pwm* Pwm::max_pwm(int new_max)
 {
     _max = confine(new_max, 0, PID_PWM_MAX - 1);
     _pwm = confine(   _pwm, 0, _max);
+    if(_hw != nullptr) write_hardware();
     return this;
 }
 
@@ -34,6 +93,10 @@ int Pwm::max_pwm()
 void Pwm::set(bool value)
 {
     _pwm = -1;
+    if(_hw != nullptr) {
+        _hw->write(value != is_inverting() ? 1.0F : 0.0F);
+        return;
+    }
     Pin::set(value);
 }
 
@@ -6,6 +6,8 @@
 #include "Pin.h"
 #include "Module.h"
 
+#include <vector>
+
 class Pwm : public Module, public Pin {
 public:
     Pwm();
@@ -13,6 +15,11 @@ public:
     void     on_module_load(void);
     uint32_t on_tick(uint32_t);
 
+    // starts the output, on the pin's hardware PWM channel if hardware is set and it has one, otherwise the pin is
+    // modulated from one SlowTicker hook shared by all the pins started at the same frequency
+    void     start(uint32_t frequency, bool hardware= false);
+    bool     is_hardware() const { return _hw != nullptr; }
+
     Pwm*     max_pwm(int);
     int      max_pwm(void);
 
@@ -21,10 +28,22 @@ public:
     void     set(bool);
 
 private:
+    // the pins modulated at one frequency, so each tick is one call however many heaters and fans there are
+    struct Group {
+        uint32_t frequency;
+        std::vector<Pwm*> pins;
+        uint32_t tick(uint32_t dummy);
+    };
+    static std::vector<Group*> groups;
+
+    void write_hardware();
+
+    mbed::PwmOut *_hw;
     int  _max;
     int  _pwm;
     int  _sd_accumulator;
     bool _sd_direction;
+    bool _started;
 };
 
 #endif /* _PWM_H */
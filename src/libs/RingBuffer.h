@@ -41,12 +41,10 @@ template<class kind, int length>  int RingBuffer<kind, length>::capacity(){
     return length-1;
 }
 
+// head and tail are each written by one side only, so a copy of both is consistent without masking interrupts
 template<class kind, int length>  int RingBuffer<kind, length>::size(){
-	//return((this->tail>this->head)?length:0)+this->head-tail;
-	__disable_irq();
-	int i = head - tail + ((tail > head)?length:0);
-	__enable_irq();
-	return i;
+    int h = head, t = tail;
+    return (h - t) & (length - 1);
 }
 
 template<class kind, int length> int RingBuffer<kind, length>::next_block_index(int index){
@@ -75,34 +73,17 @@ template<class kind, int length> kind* RingBuffer<kind, length>::get_tail_ref(){
 }
 
 template<class kind, int length> void RingBuffer<kind, length>::get(int index, kind &object){
-    int j= 0;
-    int k= this->tail;
-    while (k != this->head){
-        if (j == index) break;
-        j++;
-        k= (k + 1) & (length - 1);
-    }
-    // TODO : this checks wether we are asked a value out of range
-    //if (k == this->head){
-    //    return NULL;
-    //}
-    object = this->buffer[k];
+    // an index out of range gets the head slot, as walking up to it used to
+    if (index > size()) index = size();
+    object = this->buffer[(this->tail + index) & (length - 1)];
 }
 
 
 template<class kind, int length> kind* RingBuffer<kind, length>::get_ref(int index){
-    int j= 0;
-    int k= this->tail;
-    while (k != this->head){
-        if (j == index) break;
-        j++;
-        k= (k + 1) & (length - 1);
-    }
-    // TODO : this checks wether we are asked a value out of range
-    if (k == this->head){
+    if (index < 0 || index >= size()) {
         return 0;
     }
-    return &(this->buffer[k]);
+    return &(this->buffer[(this->tail + index) & (length - 1)]);
 }
 
 template<class kind, int length> void RingBuffer<kind, length>::pop_front(kind &object){
@@ -1,8 +1,74 @@
 #include "SDFAT.h"
+#include "platform_memory.h"
+
+#include <string.h>
 
 SDFAT::SDFAT(const char *n, MSD_Disk *disk) : mbed::FATFileSystem(n)
 {
     d = disk;
+    cache = nullptr;
+    cache_data = nullptr;
+    cache_size = cache_valid = 0;
+    cache_uses = cache_hits = cache_misses = 0;
+}
+
+// called once the config is read, 0 or no room in AHB RAM leaves it without a cache
+void SDFAT::set_cache_size(int sectors)
+{
+    if (cache != nullptr || sectors <= 0) return;
+    if (sectors > 64) sectors = 64;
+
+    cache_data = (char *)AHB0.alloc(sectors * 512);
+    if (cache_data == nullptr) return;
+    cache = (CachedSector *)AHB0.alloc(sectors * sizeof(CachedSector));
+    if (cache == nullptr) {
+        AHB0.dealloc(cache_data);
+        cache_data = nullptr;
+        return;
+    }
+    cache_size = sectors;
+    cache_valid = 0;
+}
+
+int SDFAT::cached_read(char *buffer, uint32_t sector)
+{
+    int lru = 0;
+    for (int i = 0; i < cache_valid; i++) {
+        if (cache[i].sector == sector) {
+            cache[i].used = ++cache_uses;
+            memcpy(buffer, &cache_data[i * 512], 512);
+            cache_hits++;
+            return 0;
+        }
+        if (cache[i].used < cache[lru].used) lru = i;
+    }
+
+    cache_misses++;
+    int r = d->disk_read(buffer, sector);
+    if (r) return r;
+
+    int i = cache_valid < cache_size ? cache_valid++ : lru;
+    cache[i].sector = sector;
+    cache[i].used = ++cache_uses;
+    memcpy(&cache_data[i * 512], buffer, 512);
+    return 0;
+}
+
+// a failed write leaves the card in doubt, so the copies of those sectors are dropped rather than updated
+void SDFAT::cache_update(const char *buffer, uint32_t sector, uint32_t count, bool ok)
+{
+    for (int i = 0; i < cache_valid; i++) {
+        if (cache[i].sector < sector || cache[i].sector >= sector + count) continue;
+        if (ok) {
+            memcpy(&cache_data[i * 512], &buffer[(cache[i].sector - sector) * 512], 512);
+        } else {
+            // the last entry takes its place
+            --cache_valid;
+            cache[i] = cache[cache_valid];
+            memmove(&cache_data[i * 512], &cache_data[cache_valid * 512], 512);
+            i--;
+        }
+    }
 }
 
 int SDFAT::disk_initialize()
@@ -17,12 +83,26 @@ int SDFAT::disk_status()
 
 int SDFAT::disk_read(char *buffer, int sector)
 {
-    return d->disk_read(buffer, sector);
+    return disk_read_multi(buffer, sector, 1);
 }
 
 int SDFAT::disk_write(const char *buffer, int sector)
 {
-    return d->disk_write(buffer, sector);
+    return disk_write_multi(buffer, sector, 1);
+}
+
+int SDFAT::disk_read_multi(char *buffer, int sector, int count)
+{
+    // only what FatFs reads into its window is cached, the file data is read into the file's own buffer
+    if (cache_size > 0 && count == 1 && buffer == (char *)_fs.win) return cached_read(buffer, sector);
+    return d->disk_read_multi(buffer, sector, count);
+}
+
+int SDFAT::disk_write_multi(const char *buffer, int sector, int count)
+{
+    int r = d->disk_write_multi(buffer, sector, count);
+    if (cache_valid > 0) cache_update(buffer, sector, count, r == 0);
+    return r;
 }
 
 int SDFAT::disk_sync()
@@ -34,7 +114,18 @@ int SDFAT::disk_sectors()
 {
     return d->disk_sectors();
 }
+// the card was written behind FatFs's back, by the host through USBMSD, so the sector it holds of the FAT or a
+// directory is read again and the free space counted again. The files that are open are left as they are
+void SDFAT::invalidate()
+{
+    cache_valid = 0;
+    if (_fs.fs_type == 0 || _fs.wflag) return;
+    _fs.winsect = 0xFFFFFFFF;
+    _fs.free_clust = 0xFFFFFFFF;
+}
+
 int SDFAT::remount() {
+    cache_valid = 0;
     f_mount(_fsid, NULL);
     f_mount(_fsid, &_fs);
     
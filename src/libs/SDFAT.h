@@ -12,13 +12,36 @@ public:
     virtual int disk_status();
     virtual int disk_read(char *buffer, int sector);
     virtual int disk_write(const char *buffer, int sector);
+    virtual int disk_read_multi(char *buffer, int sector, int count);
+    virtual int disk_write_multi(const char *buffer, int sector, int count);
     virtual int disk_sync();
     virtual int disk_sectors();
 
     int remount();
+    void invalidate();
+    void set_cache_size(int sectors);
+    void get_cache_stats(uint32_t &hits, uint32_t &misses) const { hits = cache_hits; misses = cache_misses; }
 
 protected:
     MSD_Disk *d;
+
+private:
+    // The sectors FatFs reads into its window, the FAT, directories and the boot and FSInfo sectors, are kept in a
+    // few more sectors of AHB RAM so following a cluster chain or walking a directory does not read them again.
+    // File data is not cached. Writes go through to the card and update the copies they overlap
+    struct CachedSector {
+        uint32_t sector;
+        uint32_t used;          // the use count when it was last read, the least recently used is replaced
+    };
+    CachedSector *cache;
+    char *cache_data;
+    uint16_t cache_size;
+    uint16_t cache_valid;       // entries that hold a sector
+    uint32_t cache_uses;
+    uint32_t cache_hits, cache_misses;
+
+    int cached_read(char *buffer, uint32_t sector);
+    void cache_update(const char *buffer, uint32_t sector, uint32_t count, bool ok);
 };
 
 #endif /* _SDFAT_H */
@@ -15,11 +15,22 @@ using namespace std;
 #include "libs/Hook.h"
 #include "modules/robot/Conveyor.h"
 #include "Gcode.h"
+#include "libs/SerialMessage.h"
+#include "libs/StreamOutput.h"
 
 #include <mri.h>
+#include <algorithm>
 
 // This module uses a Timer to periodically call hooks
 // Modules register with a function ( callback ) and a frequency, and we then call that function at the given frequency.
+// The timer runs freely and its match register is set to the deadline of the next hook due, the hooks are kept in a
+// heap ordered by deadline so a tick only looks at the ones that are due however many are attached.
+
+// the timer wraps, deadlines are compared by their difference which is fine while they are less than 85s apart
+static bool later(const Hook *a, const Hook *b)
+{
+    return (int32_t)(a->next - b->next) > 0;
+}
 
 SlowTicker* global_slow_ticker;
 
@@ -30,13 +41,16 @@ SlowTicker::SlowTicker(){
     ispbtn.from_string("2.10")->as_input()->pull_up();
 
     LPC_SC->PCONP |= (1 << 22);     // Power Ticker ON
-    LPC_TIM2->MCR = 3;              // Match on MR0, reset on MR0
+    LPC_TIM2->MCR = 1;              // Interrupt on MR0, the timer keeps counting
     // do not enable interrupt until setup is complete
+    LPC_TIM2->TCR = 2;              // Reset and hold
     LPC_TIM2->TCR = 0;              // Disable interrupt
 
-    max_frequency = 5;  // initial max frequency is set to 5Hz
-    set_frequency(max_frequency);
+    flag_1s_count = 0;
     flag_1s_flag = 0;
+
+    // the ISP button and the second flag
+    attach(10, this, &SlowTicker::housekeeping_tick);
 }
 
 void SlowTicker::start()
@@ -47,38 +61,59 @@ void SlowTicker::start()
 
 void SlowTicker::on_module_loaded(){
     register_for_event(ON_IDLE);
+    register_for_event(ON_CONSOLE_LINE_RECEIVED);
+}
+
+void SlowTicker::add_hook(Hook *hook)
+{
+    // to avoid race conditions we must stop the interupts before updating these non thread safe vectors
+    __disable_irq();
+    hook->next = LPC_TIM2->TC + hook->interval;
+    hook->max_late = 0;
+    this->hooks.push_back(hook);
+    this->queue.push_back(hook);
+    std::push_heap(this->queue.begin(), this->queue.end(), later);
+    schedule();
+    __enable_irq();
 }
 
-// Set the base frequency we use for all sub-frequencies
-void SlowTicker::set_frequency( int frequency ){
-    this->interval = (SystemCoreClock >> 2) / frequency;   // SystemCoreClock/4 = Timer increments in a second
-    LPC_TIM2->MR0 = this->interval;
-    LPC_TIM2->TCR = 3;  // Reset
-    LPC_TIM2->TCR = 1;  // Reset
-    flag_1s_count= SystemCoreClock>>2;
+// set the match for the next hook due, called with the interrupt disabled or from it
+void SlowTicker::schedule()
+{
+    LPC_TIM2->MR0 = this->queue.front()->next;
+    // the match is only on equal, if the deadline went by while setting it the tick has to be forced
+    if((int32_t)(this->queue.front()->next - LPC_TIM2->TC) <= 0) NVIC_SetPendingIRQ(TIMER2_IRQn);
 }
 
 // The actual interrupt being called by the timer, this is where work is done
 void SlowTicker::tick(){
 
-    // Call all hooks that need to be called ( bresenham )
-    for (Hook* hook : this->hooks){
-        hook->countdown -= this->interval;
-        if (hook->countdown < 0)
-        {
-            hook->countdown += hook->interval;
-            hook->call();
-        }
+    // Call all hooks that are due, each is put back in the heap at its next deadline
+    while(true) {
+        Hook *hook = this->queue.front();
+        uint32_t now = LPC_TIM2->TC;
+        uint32_t late = now - hook->next;
+        if((int32_t)late < 0) break;
+
+        std::pop_heap(this->queue.begin(), this->queue.end(), later);
+        if(late > hook->max_late) hook->max_late = late;
+        hook->next += hook->interval;
+        // if it has fallen a whole interval behind drop the missed calls rather than run them back to back
+        if((int32_t)(hook->next - now) <= 0) hook->next = now + hook->interval;
+        std::push_heap(this->queue.begin(), this->queue.end(), later);
+
+        hook->call();
     }
 
-    // deduct tick time from secound counter
-    flag_1s_count -= this->interval;
-    // if a whole second has elapsed,
-    if (flag_1s_count < 0)
+    schedule();
+}
+
+uint32_t SlowTicker::housekeeping_tick(uint32_t dummy)
+{
+    // if a whole second has elapsed set a flag for idle event to pick up
+    if (++flag_1s_count >= 10)
     {
-        // add a second to our counter
-        flag_1s_count += SystemCoreClock >> 2;
-        // and set a flag for idle event to pick up
+        flag_1s_count = 0;
         flag_1s_flag++;
     }
 
@@ -87,6 +122,7 @@ void SlowTicker::tick(){
     if (ispbtn.get() == 0)
         __debugbreak();
 
+    return dummy;
 }
 
 bool SlowTicker::flag_1s(){
@@ -124,6 +160,23 @@ void SlowTicker::on_idle(void*)
         THEKERNEL->call_event(ON_SECOND_TICK);
 }
 
+// ticks lists the hooks with their period and the most they have been late since last listed
+void SlowTicker::on_console_line_received(void *argument)
+{
+    SerialMessage *msg = static_cast<SerialMessage *>(argument);
+    if(msg->message != "ticks") return;
+
+    uint32_t counts_per_us = (SystemCoreClock >> 2) / 1000000;
+    for (size_t i = 0; i < this->hooks.size(); i++) {
+        Hook *hook = this->hooks[i];
+        __disable_irq();
+        uint32_t late = hook->max_late;
+        hook->max_late = 0;
+        __enable_irq();
+        msg->stream->printf("hook %u: %lu Hz, period %lu us, max late %lu us\r\n", i, (SystemCoreClock >> 2) / hook->interval, hook->interval / counts_per_us, late / counts_per_us);
+    }
+}
+
 extern "C" void TIMER2_IRQHandler (void){
     if((LPC_TIM2->IR >> 0) & 1){  // If interrupt register set for MR0
         LPC_TIM2->IR |= 1 << 0;   // Reset it
@@ -27,8 +27,8 @@ class SlowTicker : public Module{
 
         void on_module_loaded(void);
         void on_idle(void*);
+        void on_console_line_received(void*);
         void start();
-        void set_frequency( int frequency );
         void tick();
         // For some reason this can't go in the .cpp, see :  http://mbed.org/forum/mbed/topic/2774/?page=1#comment-14221
         // TODO replace this with std::function()
@@ -36,25 +36,18 @@ class SlowTicker : public Module{
             Hook* hook = new Hook();
             hook->interval = floorf((SystemCoreClock/4)/frequency);
             hook->attach(optr, fptr);
-            hook->countdown = hook->interval;
-
-            // to avoid race conditions we must stop the interupts before updating this non thread safe vector
-            __disable_irq();
-            if( frequency > this->max_frequency ){
-                this->max_frequency = frequency;
-                this->set_frequency(frequency);
-            }
-            this->hooks.push_back(hook);
-            __enable_irq();
+            add_hook(hook);
             return hook;
         }
 
     private:
         bool flag_1s();
+        void add_hook(Hook *hook);
+        void schedule();
+        uint32_t housekeeping_tick(uint32_t);
 
-        vector<Hook*> hooks;
-        uint32_t max_frequency;
-        uint32_t interval;
+        vector<Hook*> hooks;                // in the order they were attached, for the ticks command
+        vector<Hook*> queue;                // heap with the next hook due at the front
 
         Pin ispbtn;
 protected:
@@ -0,0 +1,97 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// A ring for one producer and one consumer, typically one of them an ISR, that never disables interrupts.
+// head is only written by the producer and tail only by the consumer. Both count up forever and are masked to
+// index the buffer, so all length slots can be used and the size is always head - tail.
+// Everything can be called from either side unless it says producer or consumer.
+template<class kind, size_t length> class SpscRing {
+    static_assert(length > 0 && (length & (length - 1)) == 0, "SpscRing length must be a power of two");
+
+    public:
+        SpscRing() : head(0), tail(0) {}
+
+        size_t capacity() const { return length; }
+        size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+        size_t free() const { return length - size(); }
+        bool empty() const { return size() == 0; }
+        bool full() const { return size() == length; }
+
+        // producer, returns false if there is no room
+        bool push(const kind &object)
+        {
+            uint32_t h = head.load(std::memory_order_relaxed);
+            if (h - tail.load(std::memory_order_acquire) == length) return false;
+            buffer[h & mask] = object;
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        // producer, pushes as many of the n objects as fit and returns how many that was
+        size_t push(const kind *objects, size_t n)
+        {
+            uint32_t h = head.load(std::memory_order_relaxed);
+            size_t room = length - (h - tail.load(std::memory_order_acquire));
+            if (n > room) n = room;
+            for (size_t i = 0; i < n; i++) buffer[(h + i) & mask] = objects[i];
+            head.store(h + n, std::memory_order_release);
+            return n;
+        }
+
+        // producer, drops everything that has not been read yet
+        // NOTE only safe while the consumer is known not to be reading, use clear() from the consumer side
+        void discard()
+        {
+            head.store(tail.load(std::memory_order_acquire), std::memory_order_release);
+        }
+
+        // consumer, returns false if there is nothing to pop
+        bool pop(kind &object)
+        {
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            if (head.load(std::memory_order_acquire) == t) return false;
+            object = buffer[t & mask];
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer, pops up to n objects and returns how many that was
+        size_t pop(kind *objects, size_t n)
+        {
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            size_t used = head.load(std::memory_order_acquire) - t;
+            if (n > used) n = used;
+            for (size_t i = 0; i < n; i++) objects[i] = buffer[(t + i) & mask];
+            tail.store(t + n, std::memory_order_release);
+            return n;
+        }
+
+        // consumer, the object index places after the oldest one, index must be less than size()
+        kind &operator[](size_t index) { return buffer[(tail.load(std::memory_order_relaxed) + index) & mask]; }
+
+        // consumer, drops the n oldest objects, n must not be more than size()
+        void drop(size_t n = 1) { tail.store(tail.load(std::memory_order_relaxed) + n, std::memory_order_release); }
+
+        // consumer, drops everything pushed so far
+        void clear() { tail.store(head.load(std::memory_order_acquire), std::memory_order_release); }
+
+    private:
+        static const uint32_t mask = length - 1;
+
+        kind buffer[length];
+        std::atomic<uint32_t> head;
+        std::atomic<uint32_t> tail;
+};
+
+#endif
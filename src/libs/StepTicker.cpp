@@ -13,8 +13,13 @@
 #include "libs/Kernel.h"
 #include "StepperMotor.h"
 #include "StreamOutputPool.h"
+#include "CycleProfile.h"
+#include "FastCode.h"
+#include "EventTrace.h"
 #include "system_LPC17xx.h" // mbed.h lib
 #include <math.h>
+#include <string.h>
+#include <algorithm>
 #include <mri.h>
 
 #ifdef STEPTICKER_DEBUG_PIN
@@ -29,6 +34,11 @@ extern GPIO stepticker_debug_pin;
 
 StepTicker* StepTicker::global_step_ticker;
 
+static CycleProfile timer0_cycles("TIMER0");
+static CycleProfile timer1_cycles("TIMER1 unstep");
+static CycleProfile pendsv_cycles("PendSV");
+static CycleProfile rit_cycles("RIT");
+
 StepTicker::StepTicker(){
     StepTicker::global_step_ticker = this;
 
@@ -55,14 +65,33 @@ StepTicker::StepTicker(){
 
     // Default start values
     this->a_move_finished = false;
+    this->step_hook_mask = 0;
+    this->handoff_wait= this->handoff_start= 0;
+    this->handoff_done= false;
+    this->lead= nullptr;
+    this->follow_mask= this->lead_mask= 0;
+    this->num_acceleration_tick_handlers= 0;
+    this->acceleration_tick_mask= 0;
     this->do_move_finished = 0;
-    this->unstep.reset();
+    this->skip= 1;
+    this->max_skip= 1;
+    this->scheduled= false;
+    this->num_pin_groups= 0;
+    memset(this->pin_group, 0, sizeof(this->pin_group));
+    memset(this->pulse, 0, sizeof(this->pulse));
+    memset((void*)this->unstep, 0, sizeof(this->unstep));
     this->set_frequency(100000);
     this->set_reset_delay(100);
     this->set_acceleration_ticks_per_second(1000);
     this->num_motors= 0;
-    this->active_motor.reset();
+    this->active_motor= 0;
+    this->steps_held= false;
+    memset(this->motor, 0, sizeof(this->motor));
     this->tick_cnt= 0;
+
+#ifdef STEPTICKER_PROFILE
+    memset((void*)this->isr_profile, 0, sizeof(this->isr_profile));
+#endif
 }
 
 StepTicker::~StepTicker() {
@@ -79,6 +108,7 @@ void StepTicker::start() {
 void StepTicker::set_frequency( float frequency ){
     this->frequency = frequency;
     this->period = floorf((SystemCoreClock/4.0F)/frequency);  // SystemCoreClock/4 = Timer increments in a second
+    this->skip= 1;
     LPC_TIM0->MR0 = this->period;
     if( LPC_TIM0->TC > LPC_TIM0->MR0 ){
         LPC_TIM0->TCR = 3;  // Reset
@@ -95,6 +125,7 @@ void StepTicker::set_reset_delay( float microseconds ){
 // this is the number of acceleration ticks per second
 void StepTicker::set_acceleration_ticks_per_second(uint32_t acceleration_ticks_per_second) {
     uint32_t us= roundf(1000000.0F/acceleration_ticks_per_second); // period in microseconds
+    this->max_skip= std::max(1L, lroundf(this->frequency / acceleration_ticks_per_second));
     LPC_RIT->RICOMPVAL = (uint32_t)(((SystemCoreClock / 1000000L) * us)-1); // us
     LPC_RIT->RICOUNTER = 0;
     LPC_RIT->RICTRL |= (8L); // Enable rit
@@ -117,53 +148,131 @@ void StepTicker::synchronize_acceleration(bool fire_now) {
 
 // Call signal_move_finished() on each active motor that asked to be signaled. We do this instead of inside of tick() so that
 // all tick()s are called before we do the move finishing
+// NOTE a snapshot of the active motors is taken, as signal_move_finished() may start a new block which changes the active list
 void StepTicker::signal_a_move_finished(){
-     for (int motor = 0; motor < num_motors; motor++){
-        if (this->active_motor[motor] && this->motor[motor]->is_move_finished){
-            this->motor[motor]->signal_move_finished();
-                // Theoretically this does nothing and the reason for it is currently unknown and/or forgotten
-                // if(this->motor[motor]->moving == false){
-                //     if (motor > 0){
-                //         motor--;
-                //         bitmask >>= 1;
-                //     }
-                // }
+    uint32_t bits= this->active_motor;
+    while(bits != 0) {
+        uint32_t m= __builtin_ctz(bits); // RBIT + CLZ on the M3
+        bits &= bits - 1; // clear lowest set bit
+        if (this->motor[m]->is_move_finished){
+            this->motor[m]->signal_move_finished();
         }
     }
 }
 
-// Reset step pins on any motor that was stepped
-inline void StepTicker::unstep_tick(){
-    for (int i = 0; i < num_motors; i++) {
-        if(this->unstep[i]){
-            this->motor[i]->unstep();
+// start the next block on its motors once all of the running one have finished, a move that was cut short by
+// force_finish_move() is not followed on from
+FAST_CODE void StepTicker::handoff(){
+    uint32_t bits= this->handoff_wait;
+    while(bits != 0) {
+        uint32_t m= __builtin_ctz(bits);
+        bits &= bits - 1;
+        StepperMotor *a= this->motor[m];
+        if(a->force_finish) {
+            this->handoff_start= 0;
+            return;
         }
+        if(a->moving && !a->is_move_finished) return;
+    }
+
+    bits= this->handoff_start;
+    this->handoff_start= 0;
+    while(bits != 0) {
+        uint32_t m= __builtin_ctz(bits);
+        bits &= bits - 1;
+        this->motor[m]->start_next_move();
+    }
+    this->handoff_done= true;
+}
+
+// set while the motors are set up for a block, before the lead has stepped
+void StepTicker::set_followers(StepperMotor *lead, uint32_t mask)
+{
+    for(uint32_t bits= this->follow_mask; bits != 0; bits &= bits - 1) this->motor[__builtin_ctz(bits)]->follow_lead= nullptr;
+    this->follow_mask= 0;
+    this->lead= lead;
+    if(lead == nullptr || mask == 0) return;
+
+    // starting half way, each steps on the lead step nearest its own share of the way
+    for(uint32_t bits= mask; bits != 0; bits &= bits - 1) {
+        StepperMotor *f= this->motor[__builtin_ctz(bits)];
+        f->follow_error= lead->steps_to_move / 2;
+        f->follow_lead= lead;
     }
-    this->unstep.reset();
+    this->lead_mask= 1 << lead->index;
+    this->follow_mask= mask;
 }
 
-extern "C" void TIMER1_IRQHandler (void){
+// called in the ticks the lead steps in, returns the followers that step with it. One that is cut short is finished
+FAST_CODE uint32_t StepTicker::step_followers()
+{
+    uint32_t stepped= 0;
+    uint32_t lead_steps= this->lead->steps_to_move;
+    for(uint32_t bits= this->follow_mask & this->active_motor; bits != 0; bits &= bits - 1) {
+        uint32_t m= __builtin_ctz(bits);
+        StepperMotor *f= this->motor[m];
+        if(!f->force_finish) {
+            f->follow_error += f->steps_to_move;
+            if(f->follow_error < lead_steps) continue;
+            f->follow_error -= lead_steps;
+        }
+        if(f->step()) {
+            stepped |= (1 << m);
+            this->pulse[this->step_group[m]] |= this->step_bit[m];
+        }
+    }
+    return stepped;
+}
+
+// Reset step pins on any motor that was stepped, a port at a time
+FAST_CODE void StepTicker::unstep_tick(){
+    for (uint8_t g = 0; g < this->num_pin_groups; ++g) {
+        uint32_t pins= this->unstep[g];
+        if(pins == 0) continue;
+        if(this->pin_group[g].inverting) this->pin_group[g].port->FIOSET= pins;
+        else this->pin_group[g].port->FIOCLR= pins;
+        this->unstep[g]= 0;
+    }
+}
+
+extern "C" FAST_CODE void TIMER1_IRQHandler (void){
+    uint32_t t= timer1_cycles.begin();
     LPC_TIM1->IR |= 1 << 0;
     StepTicker::global_step_ticker->unstep_tick();
+    timer1_cycles.end(t);
 }
 
 // The actual interrupt handler where we do all the work
-extern "C" void TIMER0_IRQHandler (void){
+extern "C" FAST_CODE void TIMER0_IRQHandler (void){
+    uint32_t t= timer0_cycles.begin();
     StepTicker::global_step_ticker->TIMER0_IRQHandler();
+    timer0_cycles.end(t);
 }
 
-extern "C" void RIT_IRQHandler (void){
+extern "C" FAST_CODE void RIT_IRQHandler (void){
+    uint32_t t= rit_cycles.begin();
     LPC_RIT->RICTRL |= 1L;
     StepTicker::global_step_ticker->acceleration_tick();
+    StepTicker::global_step_ticker->reschedule();
+    rit_cycles.end(t);
 }
 
 extern "C" void PendSV_Handler(void) {
+    uint32_t t= pendsv_cycles.begin();
+    EventTrace::record(EventTrace::PENDSV_BEGIN);
     StepTicker::global_step_ticker->PendSV_IRQHandler();
+    EventTrace::record(EventTrace::PENDSV_END);
+    pendsv_cycles.end(t);
 }
 
 // slightly lower priority than TIMER0, the whole end of block/start of block is done here allowing the timer to continue ticking
 void StepTicker::PendSV_IRQHandler (void) {
 
+    if(this->handoff_done) {
+        this->handoff_done= false;
+        this->handoff_hook();
+    }
+
     if(this->do_move_finished.load() > 0) {
         this->do_move_finished--;
         #ifdef STEPTICKER_DEBUG_PIN
@@ -176,35 +285,101 @@ void StepTicker::PendSV_IRQHandler (void) {
         stepticker_debug_pin= 0;
         #endif
     }
+
+    // a new block may have begun
+    this->reschedule();
 }
 
 // run in RIT lower priority than PendSV
-void  StepTicker::acceleration_tick() {
-    // call registered acceleration handlers
-    for (size_t i = 0; i < acceleration_tick_handlers.size(); ++i) {
-        acceleration_tick_handlers[i]();
+FAST_CODE void StepTicker::acceleration_tick() {
+    // call the registered acceleration handlers that are enabled, a handler may disable itself
+    for (uint32_t bits= this->acceleration_tick_mask; bits != 0; bits &= bits - 1) {
+        acceleration_tick_handler_t &h= this->acceleration_tick_handlers[__builtin_ctz(bits)];
+        uint32_t t= h.profile->begin();
+        h.fn(h.context);
+        h.profile->end(t);
+    }
+}
+
+uint8_t StepTicker::register_acceleration_tick_handler(acceleration_tick_fn fn, void *context, const char *name, bool enabled)
+{
+    if(this->num_acceleration_tick_handlers >= max_acceleration_tick_handlers) {
+        // there is a fixed number of them
+        __debugbreak();
+        return max_acceleration_tick_handlers - 1;
     }
+    uint8_t id= this->num_acceleration_tick_handlers++;
+    this->acceleration_tick_handlers[id]= {fn, context, new CycleProfile(name)};
+    enable_acceleration_tick_handler(id, enabled);
+    return id;
 }
 
-void StepTicker::TIMER0_IRQHandler (void){
+// called from the main loop and from the interrupts
+void StepTicker::enable_acceleration_tick_handler(uint8_t id, bool on)
+{
+    __disable_irq();
+    if(on) this->acceleration_tick_mask |= (1 << id);
+    else this->acceleration_tick_mask &= ~(1 << id);
+    __enable_irq();
+}
+
+FAST_CODE void StepTicker::TIMER0_IRQHandler (void){
+#ifdef STEPTICKER_PROFILE
+    uint32_t tc_start= LPC_TIM0->TC;
+#endif
     // Reset interrupt register
     LPC_TIM0->IR |= 1 << 0;
-    tick_cnt++; // count number of ticks
-
-    // Step pins NOTE takes 1.2us when nothing to step, 1.8-2us for one motor stepped and 2.6us when two motors stepped, 3.167us when three motors stepped
-    for (uint32_t motor = 0; motor < num_motors; motor++){
-        // send tick to all active motors
-        if(this->active_motor[motor] && this->motor[motor]->tick()){
-            // we stepped so schedule an unstep
-            this->unstep[motor]= 1;
+    uint32_t ticks= this->skip;
+    tick_cnt += ticks; // count number of ticks
+
+    // Step pins, only the active motors are visited by walking the set bits of the active mask
+    // (with a loop over all registered motors this took 1.2us when nothing stepped)
+    uint32_t bits= this->steps_held ? 0 : this->active_motor & ~this->follow_mask;
+    if(ticks > 1) {
+        // none of them stepped in the ticks that were skipped, this one is the tick the first of them steps in
+        uint32_t fx_skipped= (ticks - 1) << StepperMotor::fx_shift;
+        for(uint32_t b= bits; b != 0; b &= b - 1) this->motor[__builtin_ctz(b)]->fx_counter += fx_skipped;
+    }
+    uint32_t stepped= 0;
+#ifdef STEPTICKER_PROFILE
+    uint32_t nactive= __builtin_popcount(bits);
+#endif
+    while(bits != 0) {
+        uint32_t m= __builtin_ctz(bits);
+        bits &= bits - 1;
+        // send tick to the active motor
+        if(this->motor[m]->tick()){
+            stepped |= (1 << m);
+            this->pulse[this->step_group[m]] |= this->step_bit[m];
+        }
+    }
+    // the followers only need looking at when the lead has stepped, or is cut short
+    if(this->follow_mask != 0 && !this->steps_held && ((stepped & this->lead_mask) != 0 || this->lead->force_finish)) {
+        stepped |= step_followers();
+    }
+
+    // the step pins go up together, then we schedule an unstep
+    if(stepped != 0) {
+        for (uint8_t g = 0; g < this->num_pin_groups; ++g) {
+            uint32_t pins= this->pulse[g];
+            if(pins == 0) continue;
+            if(this->pin_group[g].inverting) this->pin_group[g].port->FIOCLR= pins;
+            else this->pin_group[g].port->FIOSET= pins;
+            this->unstep[g] |= pins;
+            this->pulse[g]= 0;
         }
     }
 
+    // used by the laser to follow the steps of the main axis when rastering
+    if((stepped & this->step_hook_mask) != 0) {
+        this->step_hook();
+    }
+
     // We may have set a pin on in this tick, now we reset the timer to set it off
     // Note there could be a race here if we run another tick before the unsteps have happened,
     // right now it takes about 3-4us but if the unstep were near 10uS or greater it would be an issue
     // also it takes at least 2us to get here so even when set to 1us pulse width it will still be about 3us
-    if( this->unstep.any()){
+    if( stepped != 0 ){
         LPC_TIM1->TCR = 3;
         LPC_TIM1->TCR = 1;
     }
@@ -215,6 +390,8 @@ void StepTicker::TIMER0_IRQHandler (void){
 
     if(this->a_move_finished) {
         this->a_move_finished= false;
+        // if that was the end of the running block the next one starts now, before PendSV has caught up with it
+        if(this->handoff_start != 0) this->handoff();
         this->do_move_finished++; // Note this is an atomic variable because it is updated in two interrupts of different priorities so can be pre-empted
     }
 
@@ -224,32 +401,149 @@ void StepTicker::TIMER0_IRQHandler (void){
         //NVIC_SetPendingIRQ(PendSV_IRQn); this doesn't work
         SCB->ICSR = 0x10000000; // SCB_ICSR_PENDSVSET_Msk;
     }
+
+    if(this->scheduled) schedule_next();
+
+#ifdef STEPTICKER_PROFILE
+    // TC is reset on the MR0 match that fired this interrupt, so the difference is the time spent in here
+    // TIMER0 counts at SystemCoreClock/4
+    uint32_t cycles= (LPC_TIM0->TC - tc_start) * 4;
+    volatile isr_profile_t& p= isr_profile[nactive < profile_slots ? nactive : profile_slots-1];
+    p.ticks++;
+    p.total_cycles += cycles;
+    if(cycles > p.max_cycles) p.max_cycles= cycles;
+#endif
 }
 
-// returns index of the stepper motor in the array and bitset
+// set the timer for the tick the first of the active motors steps in, at the rates they have now
+FAST_CODE void StepTicker::schedule_next()
+{
+    uint32_t ticks= this->max_skip;
+    if(this->do_move_finished.load() > 0 || this->a_move_finished) {
+        // the end of the block is being seen to, and the next may start any tick
+        ticks= 1;
+
+    } else if(!this->steps_held) {
+        for(uint32_t bits= this->active_motor & ~this->follow_mask; bits != 0 && ticks > 1; bits &= bits - 1) {
+            StepperMotor *a= this->motor[__builtin_ctz(bits)];
+            if(a->is_move_finished || a->force_finish || a->fx_counter >= a->fx_ticks_per_step) {
+                ticks= 1;
+                break;
+            }
+            // the ticks until the counter gets to the step, as tick() counts them
+            uint32_t n= ((a->fx_ticks_per_step - a->fx_counter - 1) >> StepperMotor::fx_shift) + 1;
+            if(n < ticks) ticks= n;
+        }
+    }
+
+    // TC was reset by the match that fired this interrupt
+    this->skip= ticks;
+    LPC_TIM0->MR0= ticks * this->period;
+}
+
+// called after the rates may have been changed outside the step interrupt, a longer wait the timer is set for is cut
+// short to the next tick so the new rates are stepped at from then on
+void StepTicker::reschedule()
+{
+    if(!this->scheduled) return;
+
+    __disable_irq();
+    // a pending match has already ended the wait, the interrupt sets the next one
+    if(this->skip > 1 && (LPC_TIM0->IR & 1) == 0) {
+        // a few counts of margin so the match is not set behind TC as it is written
+        uint32_t next= (LPC_TIM0->TC + 8) / this->period + 1;
+        if(next < this->skip) {
+            this->skip= next;
+            LPC_TIM0->MR0= next * this->period;
+        }
+    }
+    __enable_irq();
+}
+
+#ifdef STEPTICKER_PROFILE
+// report the ISR cost per tick for each number of active motors, then reset the statistics
+void StepTicker::print_profile(StreamOutput *stream)
+{
+    isr_profile_t snap[profile_slots];
+    __disable_irq();
+    for (int i = 0; i < profile_slots; ++i) {
+        snap[i].ticks= isr_profile[i].ticks;
+        snap[i].total_cycles= isr_profile[i].total_cycles;
+        snap[i].max_cycles= isr_profile[i].max_cycles;
+    }
+    memset((void*)this->isr_profile, 0, sizeof(this->isr_profile));
+    __enable_irq();
+
+    stream->printf("StepTicker ISR cycles per tick @ %luMHz:\n", SystemCoreClock / 1000000);
+    for (int i = 0; i < profile_slots; ++i) {
+        if(snap[i].ticks == 0) continue;
+        stream->printf(" %d%s active: avg %lu, max %lu cycles (%lu ticks)\n", i, i == profile_slots-1 ? "+" : "",
+                       snap[i].total_cycles / snap[i].ticks, snap[i].max_cycles, snap[i].ticks);
+    }
+}
+#endif
+
+// returns index of the stepper motor in the array and bitmask
 int StepTicker::register_motor(StepperMotor* motor)
 {
-    this->motor.push_back(motor);
-    this->num_motors= this->motor.size();
-    return this->num_motors-1;
+    if(this->num_motors >= max_motors) {
+        // we can't handle any more motors
+        __debugbreak();
+        return this->num_motors-1;
+    }
+    this->motor[this->num_motors]= motor;
+    add_step_pin(this->num_motors);
+    return this->num_motors++;
+}
+
+// put the step pin of motor[m] in the group for its port and polarity
+void StepTicker::add_step_pin(uint8_t m)
+{
+    Pin &pin= this->motor[m]->step_pin;
+    this->step_group[m]= 0;
+    this->step_bit[m]= 0;
+    if(!pin.connected()) return;
+
+    uint8_t g= 0;
+    while(g < this->num_pin_groups && !(this->pin_group[g].port == pin.port && this->pin_group[g].inverting == pin.is_inverting())) ++g;
+    if(g == this->num_pin_groups) {
+        if(g == max_pin_groups) return; // can't happen, there are only that many ports either way up
+        this->pin_group[g].port= pin.port;
+        this->pin_group[g].inverting= pin.is_inverting();
+        this->num_pin_groups++;
+    }
+    this->step_group[m]= g;
+    this->step_bit[m]= 1 << pin.pin;
 }
 
 // activate the specified motor, must have been registered
 void StepTicker::add_motor_to_active_list(StepperMotor* motor)
 {
-    bool enabled= active_motor.any(); // see if interrupt was previously enabled
-    active_motor[motor->index]= 1;
+    bool enabled= (active_motor != 0); // see if interrupt was previously enabled
+    active_motor |= (1 << motor->index);
     if(!enabled) {
+        if(this->scheduled) {
+            // it starts ticking from the beginning, TC may have been left past one period
+            this->skip= 1;
+            LPC_TIM0->TCR = 2;
+            LPC_TIM0->MR0= this->period;
+        }
         LPC_TIM0->TCR = 1;               // Enable interrupt
     }
 }
 
+// call the step hook when this motor steps, nullptr to stop calling it
+void StepTicker::set_step_hook_motor(StepperMotor* motor)
+{
+    this->step_hook_mask = (motor == nullptr) ? 0 : (1 << motor->index);
+}
+
 // Remove a stepper from the list of active motors
 void StepTicker::remove_motor_from_active_list(StepperMotor* motor)
 {
-    active_motor[motor->index]= 0;
+    active_motor &= ~(1 << motor->index);
     // If we have no motor to work on, disable the whole interrupt
-    if(this->active_motor.none()){
+    if(this->active_motor == 0){
         LPC_TIM0->TCR = 0;               // Disable interrupt
         tick_cnt= 0;
     }
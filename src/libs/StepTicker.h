@@ -12,11 +12,14 @@
 
 #include <stdint.h>
 #include <vector>
-#include <bitset>
 #include <functional>
 #include <atomic>
 
+#include "libs/LPC17xx/sLPC17xx.h"
+
 class StepperMotor;
+class StreamOutput;
+class CycleProfile;
 
 class StepTicker{
     public:
@@ -28,36 +31,116 @@ class StepTicker{
         void signal_a_move_finished();
         void set_reset_delay( float seconds );
         int register_motor(StepperMotor* motor);
+        uint8_t get_num_motors() const { return num_motors; }
         void add_motor_to_active_list(StepperMotor* motor);
         void remove_motor_from_active_list(StepperMotor* motor);
         void set_acceleration_ticks_per_second(uint32_t acceleration_ticks_per_second);
+        // when scheduled the timer is set for the tick the next step of the active motors is due in, not every tick
+        void set_scheduled(bool on) { scheduled= on; }
+        void reschedule();
         float get_frequency() const { return frequency; }
         void unstep_tick();
         uint32_t get_tick_cnt() const { return tick_cnt; }
+        bool has_active_motors() const { return active_motor != 0; }
+        // a feed hold that has come to a stop holds all the motors where they are, part way through their moves
+        void hold_steps(bool on) { steps_held= on; if(!on) reschedule(); }
         uint32_t ticks_since(uint32_t last) const { return (tick_cnt>=last) ? tick_cnt-last : (UINT32_MAX-last) + tick_cnt + 1; }
 
         void TIMER0_IRQHandler (void);
         void PendSV_IRQHandler (void);
-        void register_acceleration_tick_handler(std::function<void(void)> cb){
-            acceleration_tick_handlers.push_back(cb);
-        }
+        // the RIT only calls the handlers that are enabled, a module enables its own while it has something to do in
+        // them. Returns the id to enable it with, the name labels it in the cycle profile
+        typedef void (*acceleration_tick_fn)(void *context);
+        uint8_t register_acceleration_tick_handler(acceleration_tick_fn fn, void *context, const char *name= "RIT handler", bool enabled= true);
+        void enable_acceleration_tick_handler(uint8_t id, bool on);
         void acceleration_tick();
         void synchronize_acceleration(bool fire_now);
 
+        // the step hook is called from the step ISR after every tick the hooked motor stepped in, nullptr unhooks it
+        void register_step_hook(std::function<void(void)> cb) { step_hook= cb; }
+        void set_step_hook_motor(StepperMotor *motor);
+
+        // the Stepper's next block is started in the step ISR in the tick the motors of the running one have all finished,
+        // on the motors it set the next move of. The hook is called from PendSV after, to end the block and begin the next
+        void register_handoff_hook(std::function<void(void)> cb) { handoff_hook= cb; }
+        void arm_handoff(uint32_t wait_mask, uint32_t start_mask) { handoff_start= 0; handoff_wait= wait_mask; handoff_start= start_mask; }
+        void cancel_handoff() { handoff_start= 0; }
+
+        // with followers only the lead motor is timed, the others step from Bresenham counters of its steps in the ticks
+        // it steps in, so they end on its last step. nullptr and 0 go back to timing each of them
+        void set_followers(StepperMotor *lead, uint32_t mask);
+
         void start();
 
+#ifdef STEPTICKER_PROFILE
+        void print_profile(StreamOutput *stream);
+#endif
+
         friend class StepperMotor;
 
+        // limited by the width of the active bitmask
+        static const uint8_t max_motors= 32;
+
     private:
         float frequency;
         uint32_t period;
+        uint32_t max_skip;              // the most ticks one interrupt stands for when scheduled, an acceleration tick of them
+        volatile uint32_t skip;         // the ticks the timer is set for now, 1 unless scheduled
+        bool scheduled;
+        void schedule_next();
         volatile uint32_t tick_cnt;
-        std::vector<std::function<void(void)>> acceleration_tick_handlers;
-        std::vector<StepperMotor*> motor;
-        std::bitset<32> active_motor; // limit to 32 motors
-        std::bitset<32> unstep;       // limit to 32 motors
+        struct acceleration_tick_handler_t {
+            acceleration_tick_fn fn;
+            void *context;
+            CycleProfile *profile;
+        };
+        static const uint8_t max_acceleration_tick_handlers= 16;
+        acceleration_tick_handler_t acceleration_tick_handlers[max_acceleration_tick_handlers];
+        uint8_t num_acceleration_tick_handlers;
+        volatile uint32_t acceleration_tick_mask;   // bit n set if handler n is enabled
+        std::function<void(void)> step_hook;
+        volatile uint32_t step_hook_mask; // bit of the hooked motor, 0 when none
+        std::function<void(void)> handoff_hook;
+        volatile uint32_t handoff_wait;   // the motors of the running block
+        volatile uint32_t handoff_start;  // the motors that start the next one, 0 when it is not set up
+        volatile bool handoff_done;
+        void handoff();
+        StepperMotor *lead;
+        volatile uint32_t follow_mask;    // the motors that follow the lead, 0 when each is timed
+        uint32_t lead_mask;
+        uint32_t step_followers();
+        // the ISR walks the set bits of active_motor and indexes straight into this array
+        StepperMotor* motor[max_motors];
+        volatile uint32_t active_motor; // bit n set if motor[n] is active
+        volatile bool steps_held;
+
+        // the step pins grouped by GPIO port and whether they are inverted, so all the pins that step in a tick go up with
+        // one FIOSET or FIOCLR for each group and come down the same way
+        static const uint8_t max_pin_groups= 10;   // 5 ports, either way up
+        struct pin_group_t {
+            LPC_GPIO_TypeDef *port;
+            bool inverting;
+        };
+        pin_group_t pin_group[max_pin_groups];
+        uint8_t num_pin_groups;
+        uint8_t step_group[max_motors];  // the group of the step pin of motor[n]
+        uint32_t step_bit[max_motors];   // and its bit in the port, 0 if it has none
+        uint32_t pulse[max_pin_groups];  // pins to step in this tick
+        volatile uint32_t unstep[max_pin_groups]; // pins that need to be unstepped
+        void add_step_pin(uint8_t m);
         std::atomic_uchar do_move_finished;
 
+#ifdef STEPTICKER_PROFILE
+        // TIMER0 ISR time in core cycles, indexed by number of active motors (last entry is that many or more)
+        struct isr_profile_t {
+            uint32_t ticks;
+            uint32_t total_cycles;
+            uint32_t max_cycles;
+        };
+        static const uint8_t profile_slots= 7;
+        volatile isr_profile_t isr_profile[profile_slots];
+#endif
+
         uint8_t num_motors;
         volatile bool a_move_finished;
 };
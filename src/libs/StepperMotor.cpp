@@ -9,6 +9,7 @@
 #include "Kernel.h"
 #include "MRI_Hooks.h"
 #include "StepTicker.h"
+#include "FastCode.h"
 
 #include <math.h>
 
@@ -31,6 +32,7 @@ StepperMotor::StepperMotor(Pin &step, Pin &dir, Pin &en) : step_pin(step), dir_p
 
 StepperMotor::~StepperMotor()
 {
+    delete [] runs;
 }
 
 void StepperMotor::init()
@@ -50,26 +52,46 @@ void StepperMotor::init()
     steps_per_mm         = 1.0F;
     max_rate             = 50.0F;
     minimum_step_rate    = default_minimum_actuator_rate;
+    acceleration         = 0.0F;
 
     last_milestone_steps = 0;
     last_milestone_mm    = 0.0F;
     current_position_steps= 0;
+    position_resets= 0;
+    microstep_rate= 0;
+    phase_offset= 0;
+    step_size= 1;
+    max_microstep_shift= 0;
+    plan_shift= 0;
+    step_shift= 0;
     signal_step= 0;
+    accel_every_step= false;
+    next_steps= 0;
+    next_fx_ticks_per_step= 0xFFFFF000UL;
+    next_direction= false;
+
+    runs= nullptr;
+    run_head= run_tail= 0;
+    runs_active= false;
+    run_left= 0;
+    run_add= 0;
+
+    follow_lead= nullptr;
+    follow_error= 0;
 }
 
 
 // This is called ( see the .h file, we had to put a part of things there for obscure inline reasons ) when a step has to be generated
 // we also here check if the move is finished etc ..
 // This is in highest priority interrupt so cannot be pre-empted
-void StepperMotor::step()
+// returns true if the step pin is to be pulsed, the StepTicker does that for all the motors that step in a tick at once
+FAST_CODE bool StepperMotor::step()
 {
     // ignore if we are still processing the end of a block
-    if(this->is_move_finished) return;
-
-    if(!this->force_finish) {
-        // output to pins 37t
-        this->step_pin.set( 1 );
+    if(this->is_move_finished) return false;
 
+    bool stepped_now= !this->force_finish;
+    if(stepped_now) {
         // move counter back 11t
         this->fx_counter -= this->fx_ticks_per_step;
 
@@ -77,12 +99,19 @@ void StepperMotor::step()
         this->stepped++;
 
         // keep track of actuators actual position in steps
-        this->current_position_steps += (this->direction ? -1 : 1);
+        this->current_position_steps += (this->direction ? -this->step_size : this->step_size);
+
+        // in queue mode the interval to the next step comes from the runs
+        if(this->runs_active) next_run();
 
         // we may need to callback on a specific step, usually used to synchronize deceleration timer
         if(this->signal_step != 0 && this->stepped == this->signal_step) {
             THEKERNEL->step_ticker->synchronize_acceleration(true);
             this->signal_step= 0;
+
+        } else if(this->accel_every_step) {
+            // per step acceleration, the rate is worked out from the step count in the acceleration tick
+            THEKERNEL->step_ticker->synchronize_acceleration(true);
         }
     }
 
@@ -95,6 +124,7 @@ void StepperMotor::step()
         this->last_step_tick= THEKERNEL->step_ticker->get_tick_cnt(); // remember when last step was
         if(this->force_finish) this->steps_to_move = stepped;
     }
+    return stepped_now;
 }
 
 // If the move is finished, the StepTicker will call this ( because we asked it to in tick() )
@@ -129,21 +159,52 @@ void StepperMotor::update_exit_tick()
     }
 }
 
-// Instruct the StepperMotor to move a certain number of steps
-StepperMotor* StepperMotor::move( bool direction, unsigned int steps, float initial_speed)
+// the runs are only allocated when the Stepper is in queue mode
+void StepperMotor::enable_runs(bool on)
 {
-    this->dir_pin.set(direction);
-    this->direction = direction;
-    this->force_finish= false;
+    if(on && this->runs == nullptr) {
+        this->runs= new step_run_t[max_runs];
+    } else if(!on && this->runs != nullptr) {
+        this->runs_active= false;
+        delete [] this->runs;
+        this->runs= nullptr;
+    }
+    clear_runs(false);
+}
 
-    // How many steps we have to move until the move is done
-    this->steps_to_move = steps;
+// empty the queue at the start of a move, when active the runs queued next set the intervals
+void StepperMotor::clear_runs(bool active)
+{
+    this->runs_active= false;
+    this->run_head= this->run_tail= 0;
+    this->run_left= 0;
+    this->run_add= 0;
+    this->runs_active= active && this->runs != nullptr;
+}
 
-    // Zero our tool counters
-    this->stepped = 0;
-    this->fx_ticks_per_step = 0xFFFFF000UL; // some big number so we don't start stepping before it is set again
+// queue a run of step intervals, called with interrupts off
+// when the motor is not stepping through a run it starts on it straight away, a run of no steps then just sets the interval
+void StepperMotor::queue_run(uint32_t fx_interval, int32_t fx_add, uint32_t count)
+{
+    if(is_run_dry()) {
+        this->run_add= fx_add;
+        this->run_left= count;
+        this->fx_ticks_per_step= fx_interval;
+        return;
+    }
+    if(count == 0) return;
+
+    step_run_t &r= this->runs[this->run_head & (max_runs - 1)];
+    r.fx_interval= fx_interval;
+    r.fx_add= fx_add;
+    r.count= count;
+    this->run_head= this->run_head + 1;
+}
+
+// the counter of a new move starts from when the last step was, thus compensating for missed ticks
+FAST_CODE void StepperMotor::restart_counter()
+{
     if(this->last_step_tick_valid) {
-        // we set this based on when the last step was, thus compensating for missed ticks
         uint32_t ts= THEKERNEL->step_ticker->ticks_since(this->last_step_tick);
         // if an axis stops too soon then we can get a huge number of ticks here which causes problems, so if the number of ticks is too great we ignore them
         // example of when this happens is when one axis is going very slow and the min 20steps/sec kicks in, the axis will reach its target much sooner leaving a long gap
@@ -155,6 +216,45 @@ StepperMotor* StepperMotor::move( bool direction, unsigned int steps, float init
     }else{
         this->fx_counter = 0; // set to zero as there was no step last block
     }
+}
+
+// starts the move set by set_next_move() from the step interrupt, in the tick the last one ended
+// a motor that stepped in this tick carries on counting from that step, one that finished before starts as move() does
+FAST_CODE void StepperMotor::start_next_move()
+{
+    this->dir_pin.set(this->next_direction);
+    this->direction = this->next_direction;
+    this->force_finish= false;
+    this->accel_every_step= false;
+    this->signal_step= 0;
+    clear_runs(false);
+
+    this->steps_to_move = this->next_steps;
+    this->stepped = 0;
+    this->fx_ticks_per_step = this->next_fx_ticks_per_step;
+    if(this->last_step_tick != THEKERNEL->step_ticker->get_tick_cnt()) restart_counter();
+
+    this->moving = true;
+    this->is_move_finished = false;
+    THEKERNEL->step_ticker->add_motor_to_active_list(this);
+}
+
+// Instruct the StepperMotor to move a certain number of steps
+StepperMotor* StepperMotor::move( bool direction, unsigned int steps, float initial_speed)
+{
+    this->dir_pin.set(direction);
+    this->direction = direction;
+    this->force_finish= false;
+    this->accel_every_step= false; // the Stepper sets it again for the main stepper if needed
+    clear_runs(false); // as are the runs in queue mode, others that move the motor set the speed
+
+    // How many steps we have to move until the move is done
+    this->steps_to_move = steps;
+
+    // Zero our tool counters
+    this->stepped = 0;
+    this->fx_ticks_per_step = 0xFFFFF000UL; // some big number so we don't start stepping before it is set again
+    restart_counter();
 
     // Starting now we are moving
     if( steps > 0 ) {
@@ -183,26 +283,93 @@ StepperMotor* StepperMotor::set_speed( float speed )
     //     return;
     // }
 
-    // How many steps we must output per second
-    this->steps_per_second = speed;
-
     // set the new speed, NOTE this can be pre-empted by stepticker so the following write needs to be atomic
     this->fx_ticks_per_step= floor(fx_increment * THEKERNEL->step_ticker->get_frequency() / speed);
     return this;
 }
 
+// the step rate is only held as ticks per step, as the Stepper sets that directly in fixed point
+float StepperMotor::get_steps_per_second() const
+{
+    // one that follows another goes at its share of the rate of that one
+    const StepperMotor *lead= this->follow_lead;
+    if(lead != nullptr) {
+        uint32_t n= lead->steps_to_move;
+        return n == 0 ? 0 : lead->get_steps_per_second() * this->steps_to_move / n;
+    }
+
+    uint32_t t= this->fx_ticks_per_step;
+    if(t == 0) return 0;
+    return fx_increment * THEKERNEL->step_ticker->get_frequency() / t;
+}
+
 void StepperMotor::change_steps_per_mm(float new_steps)
 {
+    int32_t was= current_position_steps;
     steps_per_mm = new_steps;
     last_milestone_steps = lroundf(last_milestone_mm * steps_per_mm);
     current_position_steps = last_milestone_steps;
+    phase_offset += current_position_steps - was;
+    ++position_resets;
 }
 
 void StepperMotor::change_last_milestone(float new_milestone)
 {
+    int32_t was= current_position_steps;
     last_milestone_mm = new_milestone;
     last_milestone_steps = lroundf(last_milestone_mm * steps_per_mm);
     current_position_steps = last_milestone_steps;
+    phase_offset += current_position_steps - was;
+    ++position_resets;
+}
+
+// the motor is really steps from where its steps put it, found from an encoder. The steps are counted from there, and the
+// next move planned makes them up, as it is planned from the steps the moves already queued end at
+void StepperMotor::correct_position(int32_t steps)
+{
+    __disable_irq();
+    current_position_steps += steps;
+    __enable_irq();
+    last_milestone_steps += steps;
+    // the driver was not stepped for them
+    phase_offset += steps;
+}
+
+void StepperMotor::set_microstep_switching(uint8_t max_shift, float rate, std::function<void(uint8_t)> fn)
+{
+    max_microstep_shift= max_shift;
+    microstep_rate= rate;
+    microstep_fn= fn;
+}
+
+// the coarsest microsteps the rate of a block of steps needs, it only goes finer again once the rate is well under, so
+// blocks near the rate do not switch back and forth. The driver steps from where it is, so it can only switch on a whole
+// step of the coarser microsteps, a block that starts between them goes as coarse as it can and ends on one for the next
+// to switch. steps is changed to the steps the block moves, a multiple of the shift returned
+uint8_t StepperMotor::plan_microsteps(int32_t &steps, float moves_per_second)
+{
+    float rate= labs(steps) * moves_per_second;
+    uint8_t want= 0;
+    while(want < max_microstep_shift && rate > microstep_rate * (1 << want) * (want < plan_shift ? 0.75F : 1.0F)) ++want;
+
+    int32_t phase= last_milestone_steps - phase_offset;
+    uint8_t shift= 0;
+    while(shift < want && (phase & ((2 << shift) - 1)) == 0) ++shift;
+
+    // to the nearest whole step of the microsteps wanted
+    int32_t mask= (1 << want) - 1;
+    steps= ((phase + steps + (mask + 1) / 2) & ~mask) - phase;
+    plan_shift= shift;
+    return shift;
+}
+
+// called as a block begins, before it steps the motor
+void StepperMotor::begin_microsteps(uint8_t shift)
+{
+    if(shift == step_shift) return;
+    if(microstep_fn) microstep_fn(shift);
+    step_shift= shift;
+    step_size= 1 << shift;
 }
 
 int  StepperMotor::steps_to_target(float target)
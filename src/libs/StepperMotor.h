@@ -22,10 +22,10 @@ class StepperMotor {
         StepperMotor(Pin& step, Pin& dir, Pin& en);
         ~StepperMotor();
 
-        void step();
-        inline void unstep() { step_pin.set(0); };
+        bool step();
 
         inline void enable(bool state) { en_pin.set(!state); };
+        bool is_enabled() { return !en_pin.get(); }
 
         bool is_moving() const { return moving; }
         bool which_direction() const { return direction; }
@@ -36,22 +36,56 @@ class StepperMotor {
         void set_moved_last_block(bool flg) { last_step_tick_valid= flg; }
         void update_exit_tick();
 
-        float get_steps_per_second()  const { return steps_per_second; }
+        float get_steps_per_second() const;
         float get_steps_per_mm()  const { return steps_per_mm; }
         void change_steps_per_mm(float);
         void change_last_milestone(float);
         float get_last_milestone(void) const { return last_milestone_mm; }
         float get_current_position(void) const { return (float)current_position_steps/steps_per_mm; }
+        int32_t get_current_position_steps(void) const { return current_position_steps; }
+        // counts the times the position was set rather than stepped to, so anything following it knows to start again
+        uint8_t get_position_resets(void) const { return position_resets; }
+        void correct_position(int32_t steps);
+
+        // automatic microstepping, a block that would step faster than rate steps/sec is stepped 1 << shift steps at a time,
+        // up to max_shift, and the positions stay in the steps of steps_per_mm. fn sets the driver as a block begins
+        void set_microstep_switching(uint8_t max_shift, float rate, std::function<void(uint8_t)> fn);
+        bool has_microstep_switching() const { return max_microstep_shift > 0; }
+        uint8_t get_max_microstep_shift() const { return max_microstep_shift; }
+        uint8_t get_microstep_shift() const { return step_shift; }
+        uint8_t plan_microsteps(int32_t &steps, float moves_per_second);
+        void begin_microsteps(uint8_t shift);
         float get_max_rate(void) const { return max_rate; }
         void set_max_rate(float mr) { max_rate= mr; }
         float get_min_rate(void) const { return minimum_step_rate; }
         void set_min_rate(float mr) { minimum_step_rate= mr; }
+        float get_acceleration(void) const { return acceleration; }
+        void set_acceleration(float a) { acceleration= a; }
 
         int  steps_to_target(float);
         uint32_t get_steps_to_move() const { return steps_to_move; }
         uint32_t get_stepped() const { return stepped; }
         void force_finish_move() { force_finish= true; }
 
+        // the move of the next block is set up ahead, so the StepTicker can start it in the tick this one ends
+        void set_next_move(bool dir, uint32_t steps, uint32_t fx_ticks) { next_direction= dir; next_steps= steps; next_fx_ticks_per_step= fx_ticks; }
+        void start_next_move();
+
+        // in queue mode the Stepper queues runs of step intervals ahead of the step interrupt, which just steps through them
+        struct step_run_t {
+            uint32_t fx_interval;       // ticks to the first step of the run, fixed point like fx_ticks_per_step
+            int32_t fx_add;             // added to the interval after each step of the run
+            uint32_t count;             // steps in the run
+        };
+        static const uint8_t max_runs= 32;  // a power of two
+        void enable_runs(bool on);
+        void clear_runs(bool active);
+        void stop_runs() { runs_active= false; }
+        bool can_queue_run() const { return (uint8_t)(run_head - run_tail) < max_runs; }
+        uint8_t queued_runs() const { return run_head - run_tail; }
+        bool is_run_dry() const { return run_left == 0 && run_head == run_tail; }
+        void queue_run(uint32_t fx_interval, int32_t fx_add, uint32_t count);
+
         template<typename T> void attach( T *optr, uint32_t ( T::*fptr )( uint32_t ) ){
             Hook* hook = new Hook();
             hook->attach(optr, fptr);
@@ -65,6 +99,7 @@ class StepperMotor {
 
     private:
         void init();
+        void restart_counter();
 
         int index;
         Hook* end_hook;
@@ -73,20 +108,42 @@ class StepperMotor {
         Pin dir_pin;
         Pin en_pin;
 
-        float steps_per_second;
         float steps_per_mm;
         float max_rate; // this is not really rate it is in mm/sec, misnamed used in Robot and Extruder
         float minimum_step_rate; // this is the minimum step_rate in steps/sec for this motor for this block
+        float acceleration; // mm/sec^2 (or degrees for a rotary actuator) of this actuator, 0 leaves it to the Planner
         static float default_minimum_actuator_rate;
 
         volatile int32_t current_position_steps;
         int32_t last_milestone_steps;
         float   last_milestone_mm;
+        uint8_t position_resets;
+
+        std::function<void(uint8_t)> microstep_fn;
+        float microstep_rate;           // steps/sec above which a block is stepped coarser
+        int32_t phase_offset;           // the position in steps less the steps the driver has been stepped
+        int32_t step_size;              // 1 << step_shift, what each step adds to the position
+        uint8_t max_microstep_shift;    // 0 when it does not switch
+        uint8_t plan_shift;             // of the last block planned
+        uint8_t step_shift;             // the driver is set to
 
         uint32_t steps_to_move;
         uint32_t stepped;
         uint32_t last_step_tick;
         uint32_t signal_step;
+        volatile bool accel_every_step; // set by the Stepper to run the acceleration tick after every step
+
+        uint32_t next_steps;
+        uint32_t next_fx_ticks_per_step;
+        bool next_direction;
+
+        // the queued runs, written by the Stepper with interrupts off and read in the step interrupt
+        step_run_t *runs;
+        volatile uint8_t run_head;
+        volatile uint8_t run_tail;
+        volatile bool runs_active;      // the intervals come from the runs this move
+        uint32_t run_left;              // steps left in the run being stepped through
+        int32_t run_add;
 
         // set to 32 bit fixed point, 18:14 bits fractional
         static const uint32_t fx_shift= 14;
@@ -94,6 +151,27 @@ class StepperMotor {
         uint32_t fx_counter;
         uint32_t fx_ticks_per_step;
 
+        // when it follows another motor it steps each time this gets to the steps of that one, the StepTicker counts it
+        StepperMotor *follow_lead;
+        uint32_t follow_error;
+
+        // after each step, the interval to the next one from the runs
+        inline void next_run() {
+            if(run_left > 1) {
+                --run_left;
+                fx_ticks_per_step += run_add;
+            } else if(run_tail != run_head) {
+                const step_run_t &r= runs[run_tail & (max_runs - 1)];
+                fx_ticks_per_step= r.fx_interval;
+                run_add= r.fx_add;
+                run_left= r.count;
+                run_tail= run_tail + 1;
+            } else {
+                // the queue ran dry, carry on at this interval until there is more
+                run_left= 0;
+            }
+        }
+
         volatile struct {
             volatile bool is_move_finished:1; // Whether the move just finished
             volatile bool moving:1;
@@ -107,10 +185,9 @@ class StepperMotor {
             // increase the ( 32 fixed point 18:14 ) counter by one tick 11t
             fx_counter += fx_increment;
 
-            // if we are to step now
+            // if we are to step now, the StepTicker sets the step pin
             if (fx_counter >= fx_ticks_per_step){
-                step();
-                return true;
+                return step();
             }
             return false;
         };
@@ -7,8 +7,9 @@ int StreamOutput::printf(const char *format, ...)
     char b[64];
     char *buffer;
     // Make the message
-    va_list args;
+    va_list args, args2;
     va_start(args, format);
+    va_copy(args2, args); // the first vsnprintf may use up args, it does on x86-64
 
     int size = vsnprintf(b, 64, format, args) + 1; // we add one to take into account space for the terminating \0
 
@@ -16,8 +17,9 @@ int StreamOutput::printf(const char *format, ...)
         buffer = b;
     } else {
         buffer = new char[size];
-        vsnprintf(buffer, size, format, args);
+        vsnprintf(buffer, size, format, args2);
     }
+    va_end(args2);
     va_end(args);
 
     puts(buffer);
@@ -27,6 +27,8 @@ class StreamOutput {
         virtual int _putc(int c) { return 1; }
         virtual int _getc(void) { return 0; }
         virtual int puts(const char* str) = 0;
+        // for text sent to every stream, one that can not take it now drops it rather than wait, and returns 0
+        virtual int try_puts(const char* str) { return puts(str); }
         virtual bool ready() { return true; };
 
         static NullStreamOutput NullStream;
@@ -22,12 +22,13 @@ public:
     StreamOutputPool(){
     }
 
+    // a broadcast never waits for a stream, so one that is not being read can not hold up the others or the main loop
     int puts(const char* s)
     {
         int r = 0;
         for(set<StreamOutput*>::iterator i = this->streams.begin(); i != this->streams.end(); i++)
         {
-            int k = (*i)->puts(s);
+            int k = (*i)->try_puts(s);
             if (k > r)
                 r = k;
         }
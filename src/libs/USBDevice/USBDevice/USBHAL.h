@@ -53,6 +53,7 @@ public:
     EP_STATUS endpointWrite(uint8_t bEP, uint8_t *data, uint32_t size);
     EP_STATUS endpointWriteResult(uint8_t bEP);
     uint8_t endpointStatus(uint8_t bEP);
+    uint8_t endpointBuffersReady(uint8_t bEP);
     void stallEndpoint(uint8_t bEP);
     void unstallEndpoint(uint8_t bEP);
     bool realiseEndpoint(uint8_t bEP, uint32_t maxPacket, uint32_t options);
@@ -35,6 +35,7 @@
 #include "wait_api.h"
 
 #include "debug.h"
+#include "CycleProfile.h"
 
 #ifndef ENTER_ISR
     #define ENTER_ISR() do {} while (0)
@@ -678,6 +679,13 @@ uint8_t USBHAL::endpointStatus(uint8_t bEP)
     return bEPStat;
 }
 
+// the bulk and isochronous endpoints are double buffered, this is how many of the buffers of an IN endpoint can be
+// written now, or how many of an OUT endpoint hold a packet
+uint8_t USBHAL::endpointBuffersReady(uint8_t bEP)
+{
+    return can_transfer[EP2IDX(bEP)];
+}
+
 bool USBHAL::realiseEndpoint(uint8_t bEP, uint32_t maxPacket, uint32_t flags)
 {
     uint8_t endpoint = EP2IDX(bEP);
@@ -772,12 +780,16 @@ uint16_t USBHAL::lastFrame(void)
     return SIEgetFrameNumber();
 }
 
+static CycleProfile usb_cycles("USB");
+
 extern "C" {
     __attribute__ ((interrupt)) void USB_IRQHandler() {
 //         iprintf("!0x%08lX/0x%08lX:", LPC_USB->USBDevIntSt, LPC_USB->USBDevIntEn);
+        uint32_t t= usb_cycles.begin();
         ENTER_ISR();
         USBHAL::_usbisr();
         LEAVE_ISR();
+        usb_cycles.end(t);
     }
 }
 
@@ -119,19 +119,46 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "SDCard.h"
+#include "platform_memory.h"
+#include "lpc17xx_clkpwr.h"
 
 static const uint8_t OXFF = 0xFF;
 
 #define SD_COMMAND_TIMEOUT 5000
+#define SD_TOKEN_TIMEOUT   50000
+
+// the two lowest priority GPDMA channels, rx has the higher priority of the two so it never overruns
+#define SD_DMA_RX           LPC_GPDMACH6
+#define SD_DMA_TX           LPC_GPDMACH7
+#define SD_DMA_CHANNELS     ((1 << 6) | (1 << 7))
+
+#define DMA_CONTROL_SI      (1UL << 26)
+#define DMA_CONTROL_DI      (1UL << 27)
+#define DMA_CONFIG_E        (1UL << 0)
+#define DMA_CONFIG_M2P      (1UL << 11)
+#define DMA_CONFIG_P2M      (2UL << 11)
+
+#define SSP_SR_RNE          (1 << 2)
+#define SSP_DMACR_BOTH      3
+
+// we only point the GPDMA straight at buffers in the AHB SRAM banks, anything else goes through dma_buffer
+static bool dma_reachable(const void *p, int length)
+{
+    uint32_t a = (uint32_t)p;
+    return a >= 0x2007C000 && a + length <= 0x20084000;
+}
 
 SDCard::SDCard(PinName mosi, PinName miso, PinName sclk, PinName cs) :
   _spi(mosi, miso, sclk), _cs(cs) {
     _cs.output();
     _cs = 1;
     busyflag = false;
+    write_count = 0;
     _sectors = 0;
+    dma_buffer = NULL;
 }
 
 #define R1_IDLE_STATE           (1 << 0)
@@ -259,6 +286,12 @@ int SDCard::disk_initialize()
 {
     busyflag = true;
 
+    if (dma_buffer == NULL) {
+        dma_buffer = (char *)AHB0.alloc(512 + 1);
+        LPC_SC->PCONP |= CLKPWR_PCONP_PCGPDMA;
+        LPC_GPDMA->DMACConfig = 1; // enabled, little endian
+    }
+
     _sectors = 0;
 
     CARD_TYPE i = initialise_card();
@@ -289,21 +322,24 @@ int SDCard::disk_write(const char *buffer, uint32_t block_number)
     if (busyflag)
         return 0;
 
-    busyflag = true;
-
     if (cardtype == SDCARD_FAIL)
         return -1;
+
+    busyflag = true;
+    write_count++;
+
     // set write address for single block (CMD24)
     if(_cmd(SDCMD_WRITE_BLOCK, BLOCK2ADDR(block_number)) != 0) {
+        busyflag = false;
         return 1;
     }
 
     // send the data block
-    _write(buffer, 512);
+    int r = _write(buffer, 512);
 
     busyflag = false;
 
-    return 0;
+    return r;
 }
 
 int SDCard::disk_read(char *buffer, uint32_t block_number)
@@ -311,21 +347,90 @@ int SDCard::disk_read(char *buffer, uint32_t block_number)
     if (busyflag)
         return 0;
 
-    busyflag = true;
-
     if (cardtype == SDCARD_FAIL)
         return -1;
+
+    busyflag = true;
+
     // set read address for single block (CMD17)
     if(_cmd(SDCMD_READ_SINGLE_BLOCK, BLOCK2ADDR(block_number)) != 0) {
+        busyflag = false;
         return 1;
     }
 
     // receive the data
-    _read(buffer, 512);
+    int r = _read(buffer, 512);
 
     busyflag = false;
 
-    return 0;
+    return r;
+}
+
+int SDCard::disk_read_multi(char *buffer, uint32_t block_number, uint32_t count)
+{
+    if (count == 1)
+        return disk_read(buffer, block_number);
+
+    if (busyflag)
+        return 0;
+
+    if (cardtype == SDCARD_FAIL)
+        return -1;
+
+    busyflag = true;
+
+    // CMD18 keeps sending blocks, each with its own start token, until it is stopped with CMD12
+    int r = _cmdx(SDCMD_READ_MULTIPLE_BLOCK, BLOCK2ADDR(block_number));
+    if (r == 0) {
+        for (uint32_t i = 0; r == 0 && i < count; i++, buffer += 512)
+            r = _read_data(buffer, 512);
+        _stop_transmission();
+    } else {
+        r = 1;
+    }
+
+    _cs = 1;
+    _spi.write(0xFF);
+
+    busyflag = false;
+
+    return r;
+}
+
+int SDCard::disk_write_multi(const char *buffer, uint32_t block_number, uint32_t count)
+{
+    if (count == 1)
+        return disk_write(buffer, block_number);
+
+    if (busyflag)
+        return 0;
+
+    if (cardtype == SDCARD_FAIL)
+        return -1;
+
+    busyflag = true;
+    write_count++;
+
+    // CMD25 takes blocks with the multi block start token until the stop token
+    int r = _cmdx(SDCMD_WRITE_MULTIPLE_BLOCK, BLOCK2ADDR(block_number));
+    if (r == 0) {
+        for (uint32_t i = 0; r == 0 && i < count; i++, buffer += 512) {
+            _spi.write(0xFF);
+            r = _write_data(buffer, 512, 0xFC);
+        }
+        _spi.write(0xFD); // stop token
+        _spi.write(0xFF);
+        while(_spi.write(0xFF) == 0); // wait for the card to finish programming
+    } else {
+        r = 1;
+    }
+
+    _cs = 1;
+    _spi.write(0xFF);
+
+    busyflag = false;
+
+    return r;
 }
 
 int SDCard::disk_status() { return (_sectors > 0)?0:1; }
@@ -336,7 +441,7 @@ int SDCard::disk_sync() {
 uint32_t SDCard::disk_sectors() { return _sectors; }
 uint64_t SDCard::disk_size() { return ((uint64_t) _sectors) << 9; }
 uint32_t SDCard::disk_blocksize() { return (1<<9); }
-bool SDCard::disk_canDMA() { return false; }
+bool SDCard::disk_canDMA() { return true; }
 
 SDCard::CARD_TYPE SDCard::card_type()
 {
@@ -456,38 +561,58 @@ int SDCard::_cmd8() {
 int SDCard::_read(char *buffer, int length) {
     _cs = 0;
 
-    // read until start byte (0xFF)
-    while(_spi.write(0xFF) != 0xFE);
-//     uint8_t r;
-//     while((r = _spi.write(0xFF)) != 0xFE)
-//     {
-//         iprintf("0x%02X ", r);
-//         for (volatile uint32_t j = 262144; j; j--);
-//     }
-//
-//     iprintf("Got start byte, reading data\n");
-
-    // read data
-    for(int i=0; i<length; i++) {
-        buffer[i] = _spi.write(0xFF);
-    }
-    _spi.write(0xFF); // checksum
-    _spi.write(0xFF);
+    int r = _read_data(buffer, length);
 
     _cs = 1;
     _spi.write(0xFF);
-    return 0;
+    return r;
 }
 
 int SDCard::_write(const char *buffer, int length) {
     _cs = 0;
 
+    int r = _write_data(buffer, length, 0xFE);
+
+    _cs = 1;
+    _spi.write(0xFF);
+    return r;
+}
+
+// receive a data block, card must be selected
+int SDCard::_read_data(char *buffer, int length) {
+    // wait for the start token
+    int i;
+    for(i=0; i<SD_TOKEN_TIMEOUT; i++) {
+        if(_spi.write(0xFF) == 0xFE)
+            break;
+    }
+    if(i == SD_TOKEN_TIMEOUT)
+        return 1;
+
+    int r;
+    if(dma_reachable(buffer, length)) {
+        r = _dma_transfer(buffer, NULL, length);
+    } else {
+        r = _dma_transfer(dma_buffer, NULL, length);
+        memcpy(buffer, dma_buffer, length);
+    }
+
+    _spi.write(0xFF); // checksum
+    _spi.write(0xFF);
+    return r;
+}
+
+// send a data block with the given start token, card must be selected
+int SDCard::_write_data(const char *buffer, int length, uint8_t token) {
     // indicate start of block
-    _spi.write(0xFE);
+    _spi.write(token);
 
-    // write the data
-    for(int i=0; i<length; i++) {
-        _spi.write(buffer[i]);
+    int r;
+    if(dma_reachable(buffer, length)) {
+        r = _dma_transfer(NULL, buffer, length);
+    } else {
+        memcpy(dma_buffer, buffer, length);
+        r = _dma_transfer(NULL, dma_buffer, length);
     }
 
     // write the checksum
@@ -495,20 +620,80 @@ int SDCard::_write(const char *buffer, int length) {
     _spi.write(0xFF);
 
     // check the repsonse token
-    if((_spi.write(0xFF) & 0x1F) != 0x05) {
-        _cs = 1;
-        _spi.write(0xFF);
+    if(r != 0 || (_spi.write(0xFF) & 0x1F) != 0x05)
         return 1;
-    }
 
     // wait for write to finish
     while(_spi.write(0xFF) == 0);
 
-    _cs = 1;
-    _spi.write(0xFF);
     return 0;
 }
 
+// clock length bytes through the SSP with the GPDMA, the CPU only waits for it to finish,
+// if rx is NULL what is received is dropped, if tx is NULL 0xFF is sent
+int SDCard::_dma_transfer(char *rx, const char *tx, int length) {
+    LPC_SSP_TypeDef *ssp = _spi.ssp();
+    uint32_t tx_request = (ssp == LPC_SSP0) ? 0 : 2; // the rx request is the next one
+    char *dummy = &dma_buffer[512];
+    *dummy = 0xFF;
+
+    // anything left over in the receive fifo would be taken as data
+    while(ssp->SR & SSP_SR_RNE)
+        (void)ssp->DR;
+
+    LPC_GPDMA->DMACIntTCClear = SD_DMA_CHANNELS;
+    LPC_GPDMA->DMACIntErrClr = SD_DMA_CHANNELS;
+
+    SD_DMA_RX->DMACCSrcAddr = (uint32_t)&ssp->DR;
+    SD_DMA_RX->DMACCDestAddr = (uint32_t)(rx ? rx : dummy);
+    SD_DMA_RX->DMACCLLI = 0;
+    SD_DMA_RX->DMACCControl = length | (rx ? DMA_CONTROL_DI : 0);
+    SD_DMA_RX->DMACCConfig = DMA_CONFIG_E | ((tx_request + 1) << 1) | DMA_CONFIG_P2M;
+
+    SD_DMA_TX->DMACCSrcAddr = (uint32_t)(tx ? tx : dummy);
+    SD_DMA_TX->DMACCDestAddr = (uint32_t)&ssp->DR;
+    SD_DMA_TX->DMACCLLI = 0;
+    SD_DMA_TX->DMACCControl = length | (tx ? DMA_CONTROL_SI : 0);
+    SD_DMA_TX->DMACCConfig = DMA_CONFIG_E | (tx_request << 6) | DMA_CONFIG_M2P;
+
+    ssp->DMACR = SSP_DMACR_BOTH;
+
+    // the rx channel finishes last, once every byte has been clocked in
+    bool error = false;
+    while(LPC_GPDMA->DMACEnbldChns & (1 << 6)) {
+        if(LPC_GPDMA->DMACRawIntErrStat & SD_DMA_CHANNELS) {
+            error = true;
+            break;
+        }
+    }
+
+    SD_DMA_TX->DMACCConfig = 0;
+    SD_DMA_RX->DMACCConfig = 0;
+    ssp->DMACR = 0;
+
+    return error ? 1 : 0;
+}
+
+// CMD12, card must be selected
+void SDCard::_stop_transmission() {
+    _spi.write(0x40 | SDCMD_STOP_TRANSMISSION);
+    _spi.write(0x00);
+    _spi.write(0x00);
+    _spi.write(0x00);
+    _spi.write(0x00);
+    _spi.write(0x95);
+
+    _spi.write(0xFF); // skip the stuff byte
+
+    for(int i=0; i<SD_COMMAND_TIMEOUT; i++) {
+        if(!(_spi.write(0xFF) & 0x80))
+            break;
+    }
+
+    // wait for the card to be ready again
+    while(_spi.write(0xFF) == 0);
+}
+
 static int ext_bits(char *data, int msb, int lsb) {
     int bits = 0;
     int size = 1 + msb - lsb;
@@ -32,7 +32,12 @@
 #include "disk.h"
 #include "mbed.h"
 
-// #include "DMA.h"
+// mbed::SPI keeps its SSP to itself, we need it to drive the transfers with the GPDMA
+class SDCardSPI : public mbed::SPI {
+public:
+    SDCardSPI(PinName mosi, PinName miso, PinName sclk) : mbed::SPI(mosi, miso, sclk) {}
+    LPC_SSP_TypeDef *ssp() const { return _spi.spi; }
+};
 
 /** Access the filesystem on an SD Card using SPI
  *
@@ -72,6 +77,8 @@ public:
     virtual int disk_initialize();
     virtual int disk_write(const char *buffer, uint32_t block_number);
     virtual int disk_read(char *buffer, uint32_t block_number);
+    virtual int disk_read_multi(char *buffer, uint32_t block_number, uint32_t count);
+    virtual int disk_write_multi(const char *buffer, uint32_t block_number, uint32_t count);
     virtual int disk_status();
     virtual int disk_sync();
     virtual uint32_t disk_sectors();
@@ -83,6 +90,9 @@ public:
 
     bool busy();
 
+    // goes up with every write, from the filesystem or USB MSD, so what is cached from the card can tell it is out of date
+    uint32_t get_write_count() const { return write_count; }
+
 protected:
 
     int _cmd(int cmd, uint32_t arg);
@@ -95,14 +105,21 @@ protected:
 
     int _read(char *buffer, int length);
     int _write(const char *buffer, int length);
+    int _read_data(char *buffer, int length);
+    int _write_data(const char *buffer, int length, uint8_t token);
+    int _dma_transfer(char *rx, const char *tx, int length);
+    void _stop_transmission();
 
     uint32_t _sd_sectors();
     uint32_t _sectors;
 
-    mbed::SPI _spi;
+    SDCardSPI _spi;
     GPIO _cs;
 
+    char *dma_buffer; // one block in AHB SRAM for buffers the GPDMA should not be pointed at, plus a dummy byte
+
     volatile bool busyflag;
+    volatile uint32_t write_count;
 
     CARD_TYPE cardtype;
 };
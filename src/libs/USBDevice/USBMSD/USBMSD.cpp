@@ -26,6 +26,13 @@
 #include "descriptor_msc.h"
 
 #include "Kernel.h"
+#include "Config.h"
+#include "ConfigValue.h"
+#include "checksumm.h"
+#include "PublicData.h"
+#include "PlayerPublicAccess.h"
+#include "SDFAT.h"
+#include "us_ticker_api.h"
 
 #include "platform_memory.h"
 
@@ -67,9 +74,16 @@
 
 #define DEFAULT_CONFIGURATION (1)
 
+// blocks transferred to or from the disk at once, if there is room for them in AHB RAM
+#define CACHE_BLOCKS    4
+
 // max packet size
 #define MAX_PACKET  MAX_PACKET_SIZE_EPBULK
 
+#define msd_play_share_checksum    CHECKSUM("msd_play_share")
+
+extern SDFAT mounter;
+
 // #define iprintf(...) THEKERNEL->streams->printf(__VA_ARGS__)
 #define iprintf(...) do { } while (0)
 
@@ -83,6 +97,9 @@ enum Status {
 USBMSD::USBMSD(USB *u, MSD_Disk *d) {
     this->usb = u;
     this->disk = d;
+    this->disk_op = DISK_NONE;
+    this->play_share = 20;
+    this->next_disk_us = 0;
 
     usbdesc_interface i = {
         DL_INTERFACE,           // bLength
@@ -191,9 +208,15 @@ bool USBMSD::connect()
     BlockSize = disk->disk_blocksize();
 
     if ((BlockCount > 0) && (BlockSize != 0)) {
-        page = (uint8_t*) AHB0.alloc(BlockSize);
+        cache_size = CACHE_BLOCKS;
+        page = (uint8_t*) AHB0.alloc(cache_size * BlockSize);
+        if (page == NULL) {
+            cache_size = 1;
+            page = (uint8_t*) AHB0.alloc(BlockSize);
+        }
         if (page == NULL)
             return false;
+        cache_count = write_count = 0;
     } else {
         return false;
     }
@@ -204,6 +227,7 @@ bool USBMSD::connect()
 
 void USBMSD::reset() {
     stage = READ_CBW;
+    disk_op = DISK_NONE;
     usb->endpointSetInterrupt(MSC_BulkOut.bEndpointAddress, true);
     usb->endpointSetInterrupt(MSC_BulkIn.bEndpointAddress, false);
 }
@@ -213,6 +237,17 @@ void USBMSD::reset() {
 // bool USBMSD::EP2_OUT_callback() {
 bool USBMSD::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus) {
     uint32_t size = 0;
+
+    // the packet waits in the endpoint until on_idle has done the transfer
+    if (disk_op != DISK_NONE)
+        return false;
+
+    // the block a VERIFY compares the packets with is read first
+    if (stage == PROCESS_CBW && cbw.CB[0] == VERIFY10 && addr_in_block == 0 && (cache_count == 0 || cache_lba != lba)) {
+        disk_request(DISK_READ, MSC_BulkOut.bEndpointAddress, lba, 1);
+        return false;
+    }
+
 //     uint8_t buf[MAX_PACKET_SIZE_EPBULK];
     usb->readEP(MSC_BulkOut.bEndpointAddress, buffer, &size, MAX_PACKET_SIZE_EPBULK);
     iprintf("MSD:EPOut:Read %lu\n", size);
@@ -245,7 +280,7 @@ bool USBMSD::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus) {
 
     //reactivate readings on the OUT bulk endpoint
     usb->readStart(MSC_BulkOut.bEndpointAddress, MAX_PACKET_SIZE_EPBULK);
-    return true;
+    return disk_op == DISK_NONE;
 }
 
 // Called in ISR context when a data has been transferred
@@ -269,8 +304,7 @@ bool USBMSD::USBEvent_EPIn(uint8_t bEP, uint8_t bEPStatus) {
             switch (cbw.CB[0]) {
                 case READ10:
                 case READ12:
-                    memoryRead();
-                    gotMoreData = true;
+                    gotMoreData = memoryRead();
                     break;
             }
             break;
@@ -309,16 +343,12 @@ void USBMSD::memoryWrite (uint8_t * buf, uint16_t size) {
         usb->stallEndpoint(MSC_BulkOut.bEndpointAddress);
     }
 
-    // we fill an array in RAM of 1 block before writing it in memory
+    // we fill the cache in RAM with consecutive blocks before writing them in memory
+    if (addr_in_block == 0 && write_count == 0)
+        cache_lba = lba;
+    uint8_t *block = page + write_count * BlockSize;
     for (int i = 0; i < size; i++)
-        page[addr_in_block + i] = buf[i];
-
-    // if the array is filled, write it in memory
-    if ((addr_in_block + size) >= BlockSize) {
-        if (!(disk->disk_status() & WRITE_PROTECT)) {
-            disk->disk_write((const char *)page, lba);
-        }
-    }
+        block[addr_in_block + i] = buf[i];
 
     addr_in_block += size;
     length -= size;
@@ -327,6 +357,18 @@ void USBMSD::memoryWrite (uint8_t * buf, uint16_t size) {
     {
         addr_in_block = 0;
         lba++;
+        write_count++;
+    }
+
+    // if the cache is filled, or the host has sent all of them, write them in memory with one transfer, on_idle
+    // sends the CSW after it if that was the last of them
+    if (write_count > 0 && (write_count == cache_size || !length || stage != PROCESS_CBW)) {
+        if (!(disk->disk_status() & WRITE_PROTECT)) {
+            disk_request(DISK_WRITE, MSC_BulkOut.bEndpointAddress, cache_lba, write_count);
+            write_count = 0;
+            return;
+        }
+        write_count = 0;
     }
 
     if ((!length) || (stage != PROCESS_CBW)) {
@@ -344,10 +386,7 @@ void USBMSD::memoryVerify (uint8_t * buf, uint16_t size) {
         usb->stallEndpoint(MSC_BulkOut.bEndpointAddress);
     }
 
-    // beginning of a new block -> load a whole block in RAM
-    if (addr_in_block == 0)
-        disk->disk_read((char *)page, lba);
-
+    // the block was read into the cache by on_idle before this packet was taken
     // info are in RAM -> no need to re-read memory
     for (n = 0; n < size; n++) {
         if (page[addr_in_block + n] != buf[n]) {
@@ -545,6 +584,8 @@ void USBMSD::CBWDecode(uint8_t * buf, uint16_t size) {
                             if ((cbw.Flags & 0x80)) {
                                 iprintf("MSD: Read %lu blocks from LBA %lu\n", blocks, lba);
                                 stage = PROCESS_CBW;
+                                // the firmware may have written the disk since, so nothing is kept from one read to the next
+                                cache_count = 0;
 //                                 memoryRead();
                                 usb->endpointSetInterrupt(MSC_BulkIn.bEndpointAddress, true);
                             } else {
@@ -578,6 +619,7 @@ void USBMSD::CBWDecode(uint8_t * buf, uint16_t size) {
                                 iprintf("MSD: Verify %lu blocks from LBA %lu\n", blocks, lba);
                                 stage = PROCESS_CBW;
                                 memOK = true;
+                                cache_count = 0;
                             } else {
                                 usb->stallEndpoint(MSC_BulkIn.bEndpointAddress);
                                 csw.Status = CSW_ERROR;
@@ -636,7 +678,8 @@ void USBMSD::testUnitReady (void) {
     sendCSW();
 }
 
-void USBMSD::memoryRead (void) {
+// false while on_idle reads the blocks to send, it enables the IN endpoint again when they are in the cache
+bool USBMSD::memoryRead (void) {
     uint32_t n;
 
     n = (length > MAX_PACKET_SIZE_EPBULK) ? MAX_PACKET_SIZE_EPBULK : length;
@@ -647,17 +690,26 @@ void USBMSD::memoryRead (void) {
         stage = ERROR;
     }
 
-    // we read an entire block
+    // we read as many of the blocks still to send as fit in the cache, with one transfer
     if (addr_in_block == 0)
     {
         iprintf("MSD:LBA %lu:", lba);
-        disk->disk_read((char *)page, lba);
+        if (cache_count == 0 || lba < cache_lba || lba >= cache_lba + cache_count) {
+            uint32_t count = length / BlockSize;
+            if (count > cache_size)
+                count = cache_size;
+            if (count == 0)
+                count = 1;
+            disk_request(DISK_READ, MSC_BulkIn.bEndpointAddress, lba, count);
+            return false;
+        }
+        current = page + (lba - cache_lba) * BlockSize;
     }
 
     iprintf(" %u", addr_in_block / MAX_PACKET_SIZE_EPBULK);
 
     // write data which are in RAM
-    usb->writeNB(MSC_BulkIn.bEndpointAddress, &page[addr_in_block], n, MAX_PACKET_SIZE_EPBULK);
+    usb->writeNB(MSC_BulkIn.bEndpointAddress, &current[addr_in_block], n, MAX_PACKET_SIZE_EPBULK);
 
     addr_in_block += n;
 
@@ -676,6 +728,7 @@ void USBMSD::memoryRead (void) {
         stage = (stage == PROCESS_CBW) ? SEND_CSW : stage;
     }
     usb->endpointSetInterrupt(MSC_BulkIn.bEndpointAddress, true);
+    return true;
 }
 
 bool USBMSD::infoTransfer (void) {
@@ -734,7 +787,77 @@ bool USBMSD::infoTransfer (void) {
 
 void USBMSD::on_module_loaded()
 {
+    play_share = THEKERNEL->config->value( msd_play_share_checksum )->by_default(20)->as_int();
+    if (play_share < 1) play_share = 1;
+    if (play_share > 100) play_share = 100;
+
     connect();
+    register_for_event(ON_IDLE);
+    THEKERNEL->add_busy_check([this]() { return disk_op != DISK_NONE; });
+}
+
+// called in ISR context, the endpoint is left disabled until on_idle has done it
+void USBMSD::disk_request(uint8_t op, uint8_t ep, uint32_t block, uint32_t count)
+{
+    disk_ep = ep;
+    disk_lba = block;
+    disk_count = count;
+    disk_op = op;
+}
+
+void USBMSD::on_idle(void *)
+{
+    uint8_t op = disk_op;
+    if (op == DISK_NONE) return;
+
+    bool playing = false;
+    if (play_share < 100) {
+        void *returned_data;
+        if (PublicData::get_value( player_checksum, is_playing_checksum, &returned_data )) {
+            playing = *static_cast<bool *>(returned_data);
+        }
+    }
+    uint32_t start = us_ticker_read();
+    if (playing && (int32_t)(start - next_disk_us) < 0) return;
+
+    int r;
+    if (op == DISK_READ) {
+        r = disk->disk_read_multi((char *)page, disk_lba, disk_count);
+    } else {
+        r = disk->disk_write_multi((const char *)page, disk_lba, disk_count);
+        // what FatFs has cached of the FAT and the directories may be out of date now
+        mounter.invalidate();
+    }
+
+    if (playing) {
+        uint32_t t = us_ticker_read() - start;
+        next_disk_us = start + t + t * (100 - play_share) / play_share;
+    }
+
+    // a reset from the host meanwhile has started again
+    if (disk_op != op) return;
+
+    if (op == DISK_READ) {
+        cache_lba = disk_lba;
+        cache_count = disk_count;
+        // the endpoint then stalls and sends a failed CSW
+        if (r) {
+            csw.Status = CSW_FAILED;
+            stage = ERROR;
+        }
+        disk_op = DISK_NONE;
+        usb->endpointSetInterrupt(disk_ep, true);
+    } else {
+        if (r) stage = ERROR;
+        disk_op = DISK_NONE;
+        if (!length || stage != PROCESS_CBW) {
+            // the EPIn for the CSW sends it
+            csw.Status = (stage == ERROR) ? CSW_FAILED : CSW_PASSED;
+            stage = SEND_CSW;
+            usb->endpointSetInterrupt(MSC_BulkIn.bEndpointAddress, true);
+        }
+        usb->endpointSetInterrupt(MSC_BulkOut.bEndpointAddress, true);
+    }
 }
 
 bool USBMSD::USBEvent_busReset(void)
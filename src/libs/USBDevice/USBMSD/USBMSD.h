@@ -90,6 +90,7 @@ public:
     bool USBEvent_suspendStateChanged(bool suspended);
 
     virtual void on_module_loaded(void);
+    void on_idle(void *);
 
     // USB descriptors
     usbdesc_interface MSC_Interface;
@@ -159,7 +160,24 @@ private:
     bool memOK;
 
     // cache in RAM before writing in memory. Useful also to read a block.
+    // it holds cache_size blocks, so consecutive blocks are read or written with one multi block transfer
     uint8_t * page;
+    uint8_t * current;          // the block being sent to the host
+    uint32_t cache_size;
+    uint32_t cache_lba;         // the first block in the cache
+    uint32_t cache_count;       // blocks read into the cache for the current READ, 0 if none
+    uint32_t write_count;       // blocks received from the host that are still to be written
+
+    // The USB interrupt does not use the disk, it leaves the transfer for on_idle where it cannot interleave with the
+    // ones FatFs makes for the firmware, the endpoint waiting on it is enabled again once it is done. While a file plays
+    // the host gets play_share percent of the time, so the player's read ahead always comes first
+    enum DiskOp { DISK_NONE, DISK_READ, DISK_WRITE };
+    volatile uint8_t disk_op;
+    uint8_t disk_ep;            // the endpoint to enable once it is done
+    uint32_t disk_lba;
+    uint32_t disk_count;
+    uint32_t play_share;
+    uint32_t next_disk_us;      // while a file plays, the next transfer for the host waits until then
 
     // USB packet buffer
     uint8_t buffer[MAX_PACKET_SIZE_EPBULK];
@@ -175,13 +193,14 @@ private:
     bool readFormatCapacity();
     bool readCapacity (void);
     bool infoTransfer (void);
-    void memoryRead (void);
+    bool memoryRead (void);
     bool modeSense6 (void);
     void testUnitReady (void);
     bool requestSense (void);
     void memoryVerify (uint8_t * buf, uint16_t size);
     void memoryWrite (uint8_t * buf, uint16_t size);
     void reset();
+    void disk_request(uint8_t op, uint8_t ep, uint32_t block, uint32_t count);
     void fail();
 };
 
@@ -23,6 +23,24 @@ public:
      */
     virtual int disk_write(const char * data, uint32_t block) { return 0; };
 
+    /*
+     * read or write count consecutive blocks, a disk that can do multi block transfers overrides these
+     *
+     * @returns 0 if successful
+     */
+    virtual int disk_read_multi(char * data, uint32_t block, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; i++, data += 512)
+            if (int r = disk_read(data, block + i)) return r;
+        return 0;
+    };
+    virtual int disk_write_multi(const char * data, uint32_t block, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; i++, data += 512)
+            if (int r = disk_write(data, block + i)) return r;
+        return 0;
+    };
+
     /*
      * Disk initilization
      */
@@ -22,15 +22,46 @@
 #include "USBSerial.h"
 
 #include "libs/Kernel.h"
+#include "libs/InputArbiter.h"
 #include "libs/SerialMessage.h"
 #include "StreamOutputPool.h"
+#include "utils.h"
+#include "us_ticker_api.h"
+#include "EventTrace.h"
+#include "Robot.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 
 // extern void setled(int, bool);
 #define setled(a, b) do {} while (0)
 
 #define iprintf(...) do { } while (0)
 
-USBSerial::USBSerial(USB *u): USBCDC(u), rxbuf(256 + 8), txbuf(128 + 8)
+// Block transfer streaming
+// Instead of waiting for an ok after each line the host can send lines in numbered blocks, and keep several blocks in flight.
+// A block is a header line followed by the lines of the block, all terminated with \n only:
+//   \x02<seq> <nlines> <crc>\n
+// crc is the CRC-16/CCITT (hex) of all the bytes of the block lines, including their \n.
+// The lines are only executed once the whole block is in the buffer and the crc has matched, their ok is not sent,
+// other replies are. Then the block is acknowledged with the free space left in the receive buffer:
+//   \x06<seq> <free>\r\n
+// the host may send as many bytes as that beyond what it already has in flight.
+// A bad crc, a block that does not fit in the buffer or an unexpected sequence number is answered with
+//   \x15<seq> <free>\r\n
+// where seq is the block expected next, everything is then dropped until that block is sent again.
+// A header with no lines (re)starts a session with seq, the first block is then seq+1.
+// The realtime characters (? ^X, and ! ~ in grbl mode) are taken out of the stream before the crc is checked.
+#define BLOCK_START 0x02
+#define BLOCK_ACK   0x06
+#define BLOCK_NAK   0x15
+
+// how long output waits for the host to read more of txbuf, before it is dropped instead
+#define TX_STALL_US     100000
+#define TX_BROADCAST_US 2000
+
+USBSerial::USBSerial(USB *u): USBCDC(u)
 {
     usb = u;
     nl_in_rx = 0;
@@ -39,23 +70,50 @@ USBSerial::USBSerial(USB *u): USBCDC(u), rxbuf(256 + 8), txbuf(128 + 8)
     halt_flag= false;
     query_flag= false;
     last_char_was_dollar= false;
+    block_stream.parent= this;
+    block_seq= 0;
+    block_lines= 0;
+    block_crc= 0;
+    block_checked= false;
+    block_discard= false;
+    tx_stalled= false;
 }
 
-void USBSerial::ensure_tx_space(int space)
+// waits for room in txbuf, returns false if the host read none of it for timeout_us
+bool USBSerial::ensure_tx_space(int space, uint32_t timeout_us)
 {
-    while (txbuf.free() < space)
+    if (tx_stalled) {
+        // nothing is sent to a host that stopped reading until it has caught up
+        if (!txbuf.empty())
+            return false;
+        tx_stalled = false;
+    }
+
+    size_t last_free = txbuf.free();
+    uint32_t start = us_ticker_read();
+    while (txbuf.free() < (size_t)space)
     {
         usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
         usb->usbisr();
+        if (txbuf.free() != last_free) {
+            last_free = txbuf.free();
+            start = us_ticker_read();
+        } else if (us_ticker_read() - start > timeout_us) {
+            return false;
+        }
     }
+    return true;
 }
 
 int USBSerial::_putc(int c)
 {
     if (!attached)
         return 1;
-    ensure_tx_space(1);
-    txbuf.queue(c);
+    if (!ensure_tx_space(1, TX_STALL_US)) {
+        tx_stalled = true;
+        return 1;
+    }
+    txbuf.push(c);
 
     usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
     return 1;
@@ -66,8 +124,8 @@ int USBSerial::_getc()
     if (!attached)
         return 0;
     uint8_t c = 0;
-    setled(4, 1); while (rxbuf.isEmpty()); setled(4, 0);
-    rxbuf.dequeue(&c);
+    setled(4, 1); while (rxbuf.empty()); setled(4, 0);
+    rxbuf.pop(c);
     if (rxbuf.free() == MAX_PACKET_SIZE_EPBULK)
     {
         usb->endpointSetInterrupt(CDC_BulkOut.bEndpointAddress, true);
@@ -76,7 +134,7 @@ int USBSerial::_getc()
     else if ((rxbuf.free() < MAX_PACKET_SIZE_EPBULK) && (nl_in_rx == 0))
     {
         // handle potential deadlock where a short line, and the beginning of a very long line are bundled in one usb packet
-        rxbuf.flush();
+        rxbuf.clear();
         flush_to_nl = true;
 
         usb->endpointSetInterrupt(CDC_BulkOut.bEndpointAddress, true);
@@ -89,22 +147,39 @@ int USBSerial::_getc()
     return c;
 }
 
+// a string that fits in txbuf is sent or dropped whole, so a stall never leaves half a line for the host
 int USBSerial::puts(const char *str)
 {
+    int len = strlen(str);
     if (!attached)
-        return strlen(str);
-    int i = 0;
-    while (*str)
+        return len;
+    int sent = 0;
+    while (sent < len)
     {
-        ensure_tx_space(1);
-        txbuf.queue(*str);
-        if ((txbuf.available() % 64) == 0)
-            usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
-        i++;
-        str++;
+        int n = std::min<int>(len - sent, txbuf.capacity());
+        if (!ensure_tx_space(n, TX_STALL_US)) {
+            tx_stalled = true;
+            break;
+        }
+        sent += txbuf.push((const uint8_t *)str + sent, n);
+        usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
     }
+    return len;
+}
+
+// broadcasts only wait while the host is reading, and do not mark the port stalled when they are dropped
+int USBSerial::try_puts(const char *str)
+{
+    int len = strlen(str);
+    if (!attached)
+        return len;
+    if ((size_t)len > txbuf.capacity())
+        return puts(str);
+    if (!ensure_tx_space(len, TX_BROADCAST_US))
+        return 0;
+    txbuf.push((const uint8_t *)str, len);
     usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
-    return i;
+    return len;
 }
 
 uint16_t USBSerial::writeBlock(const uint8_t * buf, uint16_t size)
@@ -117,10 +192,7 @@ uint16_t USBSerial::writeBlock(const uint8_t * buf, uint16_t size)
     }
     if (size > 0)
     {
-        for (uint8_t i = 0; i < size; i++)
-        {
-            txbuf.queue(buf[i]);
-        }
+        txbuf.push(buf, size);
         usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
     }
     return size;
@@ -143,32 +215,17 @@ bool USBSerial::USBEvent_EPIn(uint8_t bEP, uint8_t bEPStatus)
 
     uint8_t b[MAX_PACKET_SIZE_EPBULK];
 
-    int l = txbuf.available();
-    iprintf("%d bytes queued\n", l);
-    if (l > 0)
+    // the endpoint is double buffered, filling both lets the host read one packet while the next is written
+    while (usb->endpointBuffersReady(bEP) > 0)
     {
-        if (l > MAX_PACKET_SIZE_EPBULK)
-            l = MAX_PACKET_SIZE_EPBULK;
-        iprintf("Sending %d bytes:\n\t", l);
-        int i;
-        for (i = 0; i < l; i++) {
-            txbuf.dequeue(&b[i]);
-            if (b[i] >= 32 && b[i] < 128)
-                iprintf("%c", b[i]);
-            else {
-                iprintf("\\x%02X", b[i]);
-            }
-        }
-        iprintf("\nSending...\n");
+        int l = txbuf.pop(b, MAX_PACKET_SIZE_EPBULK);
+        if (l == 0)
+            break;
+        iprintf("Sending %d bytes\n", l);
         send(b, l);
-        iprintf("Sent\n");
-        if (txbuf.available() == 0)
-            r = false;
     }
-    else
-    {
+    if (txbuf.empty())
         r = false;
-    }
     iprintf("USBSerial:EpIn Complete\n");
     return r;
 }
@@ -191,12 +248,43 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
         return false;
     }
 
-    uint8_t c[MAX_PACKET_SIZE_EPBULK];
-    uint32_t size = 64;
+    // both buffers of the endpoint are emptied while there is room, so the host can send the next two packets
+    do {
+        uint8_t c[MAX_PACKET_SIZE_EPBULK];
+        uint32_t size = 64;
+
+        //we read the packet received and put it on the circular buffer
+        readEP(c, &size);
+        iprintf("Read %ld bytes\n", size);
+        receive_packet(c, size);
+    } while (usb->endpointBuffersReady(bEP) > 0 && rxbuf.free() >= MAX_PACKET_SIZE_EPBULK);
+    iprintf("\nQueued, %d empty\n", rxbuf.free());
+
+    if (rxbuf.free() < MAX_PACKET_SIZE_EPBULK)
+    {
+        // if buffer is full, stall endpoint, do not accept more data
+        r = false;
 
-    //we read the packet received and put it on the circular buffer
-    readEP(c, &size);
-    iprintf("Read %ld bytes:\n\t", size);
+        if (nl_in_rx == 0)
+        {
+            // we have to check for long line deadlock here too
+            flush_to_nl = true;
+            rxbuf.discard();
+
+            // and since our buffer is empty, we can accept more data
+            r = true;
+        }
+    }
+
+    usb->readStart(CDC_BulkOut.bEndpointAddress, MAX_PACKET_SIZE_EPBULK);
+    iprintf("USBSerial:EpOut Complete\n");
+    return r;
+}
+
+// puts the chars of a packet in rxbuf, taking out the realtime ones, called in ISR context
+void USBSerial::receive_packet(const uint8_t *c, uint32_t size)
+{
+    EventTrace::record(EventTrace::USB_RX, size);
     for (uint8_t i = 0; i < size; i++) {
         if(c[i] == 'X'-'A'+1){ // ^X
             THEKERNEL->set_feed_hold(false); // required to free stuff up
@@ -209,6 +297,11 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
             continue;
         }
 
+        if(c[i] == 0x85){ // jog cancel
+            THEKERNEL->robot->cancel_jog();
+            continue;
+        }
+
         if(THEKERNEL->is_grbl_mode()) {
             if(c[i] == '!'){ // safe pause
                 THEKERNEL->set_feed_hold(true);
@@ -228,7 +321,7 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
         last_char_was_dollar= (c[i] == '$');
 
         if (flush_to_nl == false)
-            rxbuf.queue(c[i]);
+            rxbuf.push(c[i]);
 
         // if (c[i] >= 32 && c[i] < 128)
         // {
@@ -246,51 +339,38 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
             else
                 nl_in_rx++;
         }
-        else if (rxbuf.isFull() && (nl_in_rx == 0))
+        else if (rxbuf.full() && (nl_in_rx == 0))
         {
             // to avoid a deadlock with very long lines, we must dump the buffer
             // and continue flushing to the next newline
-            rxbuf.flush();
-            flush_to_nl = true;
-        }
-    }
-    iprintf("\nQueued, %d empty\n", rxbuf.free());
-
-    if (rxbuf.free() < MAX_PACKET_SIZE_EPBULK)
-    {
-        // if buffer is full, stall endpoint, do not accept more data
-        r = false;
-
-        if (nl_in_rx == 0)
-        {
-            // we have to check for long line deadlock here too
+            // the main loop does not read until there is a whole line, so it is safe to drop it from here
+            rxbuf.discard();
             flush_to_nl = true;
-            rxbuf.flush();
-
-            // and since our buffer is empty, we can accept more data
-            r = true;
         }
     }
-
-    usb->readStart(CDC_BulkOut.bEndpointAddress, MAX_PACKET_SIZE_EPBULK);
-    iprintf("USBSerial:EpOut Complete\n");
-    return r;
 }
 
-uint8_t USBSerial::available()
+uint16_t USBSerial::available()
 {
-    return rxbuf.available();
+    return rxbuf.size();
 }
 
 bool USBSerial::ready()
 {
-    return rxbuf.available();
+    return !rxbuf.empty();
 }
 
 void USBSerial::on_module_loaded()
 {
     this->register_for_event(ON_MAIN_LOOP);
     this->register_for_event(ON_IDLE);
+    // reads the lines that keep the planner fed
+    this->set_event_priority(ON_MAIN_LOOP, PRIORITY_FEED);
+    this->set_event_priority(ON_IDLE, PRIORITY_FEED);
+    THEKERNEL->add_input_check([this]() { return nl_in_rx > 0; });
+    // usbserial or usbserial2, as it was added
+    const char *name = THEKERNEL->get_module_name(this);
+    input_source = THEKERNEL->input_arbiter->add_source(name != nullptr ? name : "usbserial", [this]() { return nl_in_rx > 0; });
 }
 
 void USBSerial::on_idle(void *argument)
@@ -306,8 +386,17 @@ void USBSerial::on_idle(void *argument)
     }
 
     if(query_flag) {
-        query_flag= false;
-        puts(THEKERNEL->get_query_string().c_str());
+        // a status that does not fit yet is formatted again next time, so the queries made meanwhile get one up to date
+        // reply rather than a queue of stale ones, it is dropped if the host has stopped reading
+        char buf[128];
+        size_t n = THEKERNEL->format_query(buf, sizeof(buf));
+        if (!attached || tx_stalled) {
+            query_flag= false;
+        } else if (txbuf.free() >= n) {
+            query_flag= false;
+            txbuf.push((const uint8_t *)buf, n);
+            usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
+        }
     }
 
 }
@@ -330,9 +419,12 @@ void USBSerial::on_main_loop(void *argument)
         {
             attached = false;
             THEKERNEL->streams->remove_stream(this);
-            txbuf.flush();
-            rxbuf.flush();
+            txbuf.discard();
+            tx_stalled = false;
+            rxbuf.clear();
             nl_in_rx = 0;
+            block_lines = 0;
+            block_discard = false;
         }
     }
 
@@ -341,25 +433,159 @@ void USBSerial::on_main_loop(void *argument)
 
     if (nl_in_rx)
     {
+        char c = rxbuf[0];
+        if (c == BLOCK_START) {
+            string header;
+            get_line(header);
+            block_header(header);
+            return;
+        }
+
+        // the lines of a block are only run once all of them are in and checked
+        if (block_lines > 0 && !block_checked && !block_check())
+            return;
+
+        if (!THEKERNEL->input_arbiter->may_take(input_source))
+            return;
+
         string received;
-        while (available())
-        {
-            char c = _getc();
-            if( c == '\n' || c == '\r')
-            {
-                struct SerialMessage message;
-                message.message = received;
-                message.stream = this;
-                iprintf("USBSerial Received: %s\n", message.message.c_str());
-                THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
-                return;
-            }
-            else
-            {
-                received += c;
+        get_line(received);
+        THEKERNEL->input_arbiter->took(input_source, received.size());
+
+        if (block_lines > 0) {
+            struct SerialMessage message;
+            message.message = received;
+            message.stream = &block_stream;
+            THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
+            if (--block_lines == 0) {
+                block_checked = false;
+                block_reply(BLOCK_ACK, block_seq);
             }
+            return;
         }
+
+        // dropping whatever was in flight after a rejected block
+        if (block_discard)
+            return;
+
+        struct SerialMessage message;
+        message.message = received;
+        message.stream = this;
+        iprintf("USBSerial Received: %s\n", message.message.c_str());
+        THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
+    }
+}
+
+// read the next line out of the receive buffer, without its line ending
+// the line is found then popped a packet sized chunk at a time, rather than a char at a time through _getc
+void USBSerial::get_line(string &line)
+{
+    size_t n = rxbuf.size();
+    size_t len = 0;
+    while (len < n && rxbuf[len] != '\n' && rxbuf[len] != '\r')
+        len++;
+
+    line.reserve(line.size() + len);
+    char chunk[MAX_PACKET_SIZE_EPBULK];
+    while (len > 0) {
+        size_t k = rxbuf.pop((uint8_t *)chunk, std::min(len, sizeof(chunk)));
+        line.append(chunk, k);
+        len -= k;
+        n -= k;
+    }
+    if (n > 0) {
+        rxbuf.drop();
+        if (nl_in_rx > 0)
+            nl_in_rx--;
     }
+
+    if (rxbuf.free() >= MAX_PACKET_SIZE_EPBULK)
+    {
+        usb->endpointSetInterrupt(CDC_BulkOut.bEndpointAddress, true);
+    }
+    else if (nl_in_rx == 0)
+    {
+        // handle potential deadlock where a short line, and the beginning of a very long line are bundled in one usb packet
+        rxbuf.clear();
+        flush_to_nl = true;
+        usb->endpointSetInterrupt(CDC_BulkOut.bEndpointAddress, true);
+    }
+}
+
+void USBSerial::block_header(const string &line)
+{
+    char *p;
+    uint16_t seq = strtoul(line.c_str() + 1, &p, 10);
+    uint16_t n = strtoul(p, &p, 10);
+    uint16_t crc = strtoul(p, &p, 16);
+
+    if (n == 0) {
+        // start of a session
+        block_discard = false;
+        block_lines = 0;
+        block_seq = seq;
+        block_reply(BLOCK_ACK, seq);
+        return;
+    }
+
+    if (seq != (uint16_t)(block_seq + 1) || block_lines > 0) {
+        // when discarding the blocks that were in flight are expected, the host has been told already
+        if (!block_discard) {
+            block_discard = true;
+            block_lines = 0;
+            block_reply(BLOCK_NAK, block_seq + 1);
+        }
+        return;
+    }
+
+    block_discard = false;
+    block_seq = seq;
+    block_lines = n;
+    block_crc = crc;
+    block_checked = false;
+}
+
+// returns true once all the lines of the current block are in the buffer and match the crc
+bool USBSerial::block_check()
+{
+    uint16_t crc = 0xFFFF;
+    uint16_t lines = 0;
+    uint16_t n = rxbuf.size();
+    for (uint16_t i = 0; i < n && lines < block_lines; i++) {
+        uint8_t c = rxbuf[i];
+        crc = crc16_ccitt(&c, 1, crc);
+        if (c == '\n') lines++;
+    }
+
+    if (lines < block_lines) {
+        // if the buffer is already full the block can never fit
+        if (rxbuf.free() >= MAX_PACKET_SIZE_EPBULK)
+            return false;
+
+    } else if (crc == block_crc) {
+        block_checked = true;
+        return true;
+    }
+
+    block_lines = 0;
+    block_discard = true;
+    block_reply(BLOCK_NAK, block_seq);
+    block_seq--; // the same block has to be sent again
+    return false;
+}
+
+void USBSerial::block_reply(char code, uint16_t seq)
+{
+    char buf[20];
+    snprintf(buf, sizeof(buf), "%c%u %u\r\n", code, seq, rxbuf.free());
+    puts(buf);
+}
+
+int USBSerial::BlockStream::puts(const char *str)
+{
+    if (strcmp(str, "ok\r\n") == 0)
+        return 4;
+    return parent->puts(str);
 }
 
 void USBSerial::on_attach()
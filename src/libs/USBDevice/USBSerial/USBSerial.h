@@ -21,11 +21,13 @@
 
 #include "USBCDC.h"
 // #include "Stream.h"
-#include "CircBuffer.h"
+#include "SpscRing.h"
 
 #include "Module.h"
 #include "StreamOutput.h"
 
+#include <string>
+
 class USBSerial_Receiver {
 protected:
     virtual bool SerialEvent_RX(void) = 0;
@@ -38,14 +40,16 @@ public:
     int _putc(int c);
     int _getc();
     int puts(const char *);
+    int try_puts(const char *);
 
-    uint8_t available();
+    uint16_t available();
     bool ready();
 
     uint16_t writeBlock(const uint8_t * buf, uint16_t size);
 
-    CircBuffer<uint8_t> rxbuf;
-    CircBuffer<uint8_t> txbuf;
+    // filled by the USB interrupt and read from the main loop, and the other way around
+    SpscRing<uint8_t, 1024> rxbuf;
+    SpscRing<uint8_t, 256> txbuf;
 
     void on_module_loaded(void);
     void on_main_loop(void *);
@@ -58,10 +62,30 @@ protected:
 
     virtual bool SerialEvent_RX(void){return false;};
 
+    void receive_packet(const uint8_t *, uint32_t);
+
     virtual void on_attach(void);
     virtual void on_detach(void);
 
-    void ensure_tx_space(int);
+    bool ensure_tx_space(int, uint32_t);
+
+    // block transfer streaming
+    void get_line(std::string &line);
+    void block_header(const std::string &line);
+    bool block_check();
+    void block_reply(char code, uint16_t seq);
+
+    // replies to lines received in a block, the per line ok is dropped as the block is acknowledged as a whole
+    class BlockStream : public StreamOutput {
+    public:
+        int puts(const char *);
+        USBSerial *parent;
+    } block_stream;
+
+    uint16_t block_seq;       // sequence number of the block being received, or the next one expected
+    uint16_t block_lines;     // lines still to come in the current block
+    uint16_t block_crc;
+    uint8_t input_source;     // in the InputArbiter
 
     // keep track of number of newlines in the buffer
     // this makes it trivial to detect if there's a new line available
@@ -80,6 +104,12 @@ protected:
         // flushing until we find a newline.
         // this flag asserts when we are doing this
         bool flush_to_nl:1;
+        // the current block has been received completely and its crc matched
+        bool block_checked:1;
+        // a block was rejected, drop lines until the host restarts with the expected block
+        bool block_discard:1;
+        // the host stopped reading, output is dropped until what is already in txbuf has been read
+        bool tx_stalled:1;
     };
 
 private:
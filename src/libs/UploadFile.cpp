@@ -0,0 +1,58 @@
+#include "UploadFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool UploadFile::open(const std::string &filename)
+{
+    close();
+    FILE *fd= fopen(filename.c_str(), "w");
+    if(fd == NULL) return false;
+    fclose(fd);
+
+    buf= (char *)malloc(buffer_size);
+    if(buf == nullptr) return false;
+    fn= filename;
+    used= 0;
+    written= 0;
+    failed= false;
+    return true;
+}
+
+bool UploadFile::write(const void *data, size_t n)
+{
+    if(buf == nullptr || failed) return false;
+
+    const char *p= (const char *)data;
+    while(n > 0) {
+        size_t c= buffer_size - used;
+        if(c > n) c= n;
+        memcpy(buf + used, p, c);
+        used += c;
+        p += c;
+        n -= c;
+        if(used == buffer_size && !flush()) return false;
+    }
+    return true;
+}
+
+bool UploadFile::flush()
+{
+    if(used == 0) return true;
+    FILE *fd= fopen(fn.c_str(), "a");
+    if(fd == NULL || fwrite(buf, 1, used, fd) != used) failed= true;
+    if(fd != NULL) fclose(fd);
+    written += used;
+    used= 0;
+    return !failed;
+}
+
+bool UploadFile::close()
+{
+    if(buf == nullptr) return false;
+    bool ok= flush() && !failed;
+    free(buf);
+    buf= nullptr;
+    return ok;
+}
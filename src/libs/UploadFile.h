@@ -0,0 +1,39 @@
+#ifndef _UPLOADFILE_H_
+#define _UPLOADFILE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// Receives a file being uploaded. What is written is held in RAM and written to the card a buffer at a time, so the
+// writes start on a sector boundary and cover whole clusters of up to buffer_size, instead of a FatFs write per line.
+// Each buffer is appended with its own open and close, which the uploads also did every 400 bytes to get around fwrite
+// corrupting files that are kept open.
+class UploadFile {
+    public:
+        static const size_t buffer_size= 4096;
+
+        UploadFile() : buf(nullptr), used(0), written(0), failed(false) {}
+        ~UploadFile() { close(); }
+
+        // creates the file, or empties it
+        bool open(const std::string &filename);
+        bool write(const void *data, size_t n);
+        bool putc(char c) { return write(&c, 1); }
+        // writes out what is held, false if anything could not be written
+        bool close();
+
+        bool is_open() const { return buf != nullptr; }
+        size_t size() const { return written + used; }
+
+    private:
+        bool flush();
+
+        std::string fn;
+        char *buf;
+        size_t used;
+        size_t written;
+        bool failed;
+};
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// the CRC-32 of zlib and python's zlib.crc32, a lot cheaper than MD5 to check a file with
+uint32_t crc32_update(uint32_t crc, const void *buf, size_t len);
+
+#endif
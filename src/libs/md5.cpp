@@ -170,7 +170,12 @@ void MD5::encode(uint1 output[], const uint4 input[], size_type len)
 void MD5::transform(const uint1 block[blocksize])
 {
     uint4 a = state[0], b = state[1], c = state[2], d = state[3], x[16];
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // the words are already in the right order, a copy is a few word loads where decode is four byte loads per word
+    memcpy(x, block, blocksize);
+#else
     decode (x, block, blocksize);
+#endif
 
     /* Round 1 */
     FF (a, b, c, d, x[ 0], S11, 0xd76aa478); /* 1 */
@@ -248,9 +253,6 @@ void MD5::transform(const uint1 block[blocksize])
     state[1] += b;
     state[2] += c;
     state[3] += d;
-
-    // Zeroize sensitive information.
-    memset(x, 0, sizeof x);
 }
 
 //////////////////////////////
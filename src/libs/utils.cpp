@@ -39,27 +39,67 @@ uint16_t get_checksum(const char *to_check)
     return (sum2 << 8) | sum1;
 }
 
+uint16_t get_checksum(const char *to_check, size_t len)
+{
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    for(size_t i = 0; i < len; i++) {
+        sum1 = (sum1 + to_check[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return (sum2 << 8) | sum1;
+}
+
+// CRC-16/CCITT, pass the previous result as crc to continue a crc over several buffers
+uint16_t crc16_ccitt(const uint8_t *data, size_t len, uint16_t crc)
+{
+    while(len--) {
+        crc ^= (uint16_t)*data++ << 8;
+        for (int i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+    return crc;
+}
+
+// 32 bit FNV-1a hash, pass the previous result as h to hash more data
+uint32_t fnv1a(const void *data, size_t len, uint32_t h)
+{
+    const uint8_t *p= static_cast<const uint8_t *>(data);
+    while(len--) {
+        h ^= *p++;
+        h *= 16777619UL;
+    }
+    return h;
+}
+
 void get_checksums(uint16_t check_sums[], const string &key)
+{
+    get_checksums(check_sums, key.data(), key.size());
+}
+
+int get_checksums(uint16_t check_sums[], const char *key, size_t len)
 {
     check_sums[0] = 0x0000;
     check_sums[1] = 0x0000;
     check_sums[2] = 0x0000;
-    size_t begin_key = 0;
-    unsigned int counter = 0;
-    while( begin_key < key.size() && counter < 3 ) {
-        size_t end_key =  key.find_first_of(".", begin_key);
-        string key_node;
-        if(end_key == string::npos) {
-            key_node = key.substr(begin_key);
-        } else {
-            key_node = key.substr(begin_key, end_key - begin_key);
+    if(len == 0) return 0;
+
+    // the same sums as get_checksum(), started again at each dot
+    int counter = 0;
+    uint16_t sum1 = 0, sum2 = 0;
+    for(size_t i = 0; i < len; i++) {
+        char c = key[i];
+        if(c == '.') {
+            check_sums[counter] = (sum2 << 8) | sum1;
+            if(++counter == 3) return 3;
+            sum1 = sum2 = 0;
+            continue;
         }
-
-        check_sums[counter] = get_checksum(key_node);
-        if(end_key == string::npos) break;
-        begin_key = end_key + 1;
-        counter++;
+        sum1 = (sum1 + c) % 255;
+        sum2 = (sum2 + sum1) % 255;
     }
+    check_sums[counter] = (sum2 << 8) | sum1;
+    return counter + 1;
 }
 
 bool is_alpha(int c)
@@ -132,6 +172,16 @@ string shift_parameter( string &parameters )
     return temp;
 }
 
+ParameterView shift_parameter( const char *&parameters )
+{
+    while(*parameters == ' ') parameters++;
+    ParameterView word{parameters, 0};
+    while(parameters[word.size] != '\0' && parameters[word.size] != ' ') word.size++;
+    parameters += word.size;
+    while(*parameters == ' ') parameters++;
+    return word;
+}
+
 // Separate command from arguments
 string get_arguments( string possible_command )
 {
@@ -149,8 +199,8 @@ bool file_exists( const string file_name )
     FILE *lp = fopen(file_name.c_str(), "r");
     if(lp) {
         exists = true;
+        fclose(lp);
     }
-    fclose(lp);
     return exists;
 }
 
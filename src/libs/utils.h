@@ -2,6 +2,8 @@
 #define UTILS_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <string.h>
 #include <string>
 #include <vector>
 
@@ -24,11 +26,32 @@ string remove_non_number( string str );
 
 uint16_t get_checksum(const string& to_check);
 uint16_t get_checksum(const char* to_check);
+uint16_t get_checksum(const char* to_check, size_t len);
 
 void get_checksums(uint16_t check_sums[], const string& key);
+// the same for the len characters of key, nothing is copied, returns how many of the dotted parts it had
+int get_checksums(uint16_t check_sums[], const char *key, size_t len);
+
+uint16_t crc16_ccitt(const uint8_t *data, size_t len, uint16_t crc= 0xFFFF);
+uint32_t fnv1a(const void *data, size_t len, uint32_t h= 2166136261UL);
 
 string shift_parameter( string &parameters );
 
+// a word of a command line, pointing into the line instead of a copy of it, so it is not nul terminated
+struct ParameterView {
+    const char *data;
+    size_t size;
+    bool empty() const { return size == 0; }
+    bool operator==(const char *s) const { return strncmp(data, s, size) == 0 && s[size] == '\0'; }
+    bool operator!=(const char *s) const { return !(*this == s); }
+    bool has_any_of(const char *chars) const { for(size_t i = 0; i < size; i++) if(strchr(chars, data[i])) return true; return false; }
+    uint16_t checksum() const { return get_checksum(data, size); }
+    string str() const { return string(data, size); }
+};
+
+// shift_parameter() without the allocations, parameters is left at the next word
+ParameterView shift_parameter( const char *&parameters );
+
 string get_arguments( string possible_command );
 
 bool file_exists( const string file_name );
@@ -20,9 +20,14 @@
 #include "modules/tools/drillingcycles/Drillingcycles.h"
 #include "FilamentDetector.h"
 #include "MotorDriverControl.h"
+#include "MotionSync.h"
+#include "Subprograms.h"
+#include "EncoderFeedback.h"
+#include "Telemetry.h"
 
 #include "modules/robot/Conveyor.h"
 #include "modules/utils/simpleshell/SimpleShell.h"
+#include "modules/communication/StatusReport.h"
 #include "modules/utils/configurator/Configurator.h"
 #include "modules/utils/currentcontrol/CurrentControl.h"
 #include "modules/utils/player/Player.h"
@@ -53,15 +58,21 @@
 #include "ToolManager.h"
 
 #include "libs/Watchdog.h"
+#include "libs/LatencyStats.h"
+#include "libs/EventTrace.h"
+#include "libs/AppendFileStream.h"
+#include "libs/AtomicFileStream.h"
 
 #include "version.h"
 #include "system_LPC17xx.h"
+#include "us_ticker_api.h"
 #include "platform_memory.h"
 
 #include "mbed.h"
 
 #define second_usb_serial_enable_checksum  CHECKSUM("second_usb_serial_enable")
 #define disable_msd_checksum  CHECKSUM("msd_disable")
+#define sd_sector_cache_checksum  CHECKSUM("sd_sector_cache")
 #define dfu_enable_checksum  CHECKSUM("dfu_enable")
 #define watchdog_timeout_checksum  CHECKSUM("watchdog_timeout")
 
@@ -115,6 +126,8 @@ void init() {
 
     bool sdok= (sd.disk_initialize() == 0);
     if(!sdok) kernel->streams->printf("SDCard failed to initialize\r\n");
+    mounter.set_cache_size(kernel->config->value( sd_sector_cache_checksum )->by_default(8)->as_int());
+    kernel->boot_mark("sd mounted");
 
     #ifdef NONETWORK
         kernel->streams->printf("NETWORK is disabled\r\n");
@@ -136,12 +149,14 @@ void init() {
 
 
     // Create and add main modules
-    kernel->add_module( new(AHB0) Player() );
+    kernel->add_module( new EventTrace(), "eventtrace" );
+    kernel->add_module( new(AHB0) Player(), "player" );
+    kernel->add_module( new StatusReport(), "statusreport" );
 
-    kernel->add_module( new(AHB0) CurrentControl() );
-    kernel->add_module( new(AHB0) KillButton() );
-    kernel->add_module( new(AHB0) PlayLed() );
-    kernel->add_module( new(AHB0) Endstops() );
+    kernel->add_module( new(AHB0) CurrentControl(), "currentcontrol" );
+    kernel->add_module( new(AHB0) KillButton(), "killbutton" );
+    kernel->add_module( new(AHB0) PlayLed(), "playled" );
+    kernel->add_module( new(AHB0) Endstops(), "endstops" );
 
 
     // these modules can be completely disabled in the Makefile by adding to EXCLUDE_MODULES
@@ -163,71 +178,87 @@ void init() {
     delete tp;
     #endif
     #ifndef NO_TOOLS_LASER
-    kernel->add_module( new Laser() );
+    kernel->add_module( new Laser(), "laser" );
     #endif
     #ifndef NO_TOOLS_SPINDLE
-    kernel->add_module( new Spindle() );
+    kernel->add_module( new Spindle(), "spindle" );
     #endif
     #ifndef NO_UTILS_PANEL
-    kernel->add_module( new(AHB0) Panel() );
+    kernel->add_module( new(AHB0) Panel(), "panel" );
     #endif
     #ifndef NO_TOOLS_ZPROBE
-    kernel->add_module( new(AHB0) ZProbe() );
+    kernel->add_module( new(AHB0) ZProbe(), "zprobe" );
     #endif
     #ifndef NO_TOOLS_SCARACAL
-    kernel->add_module( new(AHB0) SCARAcal() );
+    kernel->add_module( new(AHB0) SCARAcal(), "scaracal" );
     #endif
     #ifndef NO_TOOLS_ROTARYDELTACALIBRATION
-    kernel->add_module( new RotaryDeltaCalibration() );
+    kernel->add_module( new RotaryDeltaCalibration(), "rotarydeltacalibration" );
     #endif
     #ifndef NONETWORK
-    kernel->add_module( new Network() );
+    kernel->add_module( new Network(), "network" );
     #endif
     #ifndef NO_TOOLS_TEMPERATURESWITCH
     // Must be loaded after TemperatureControl
-    kernel->add_module( new TemperatureSwitch() );
+    kernel->add_module( new TemperatureSwitch(), "temperatureswitch" );
     #endif
     #ifndef NO_TOOLS_DRILLINGCYCLES
-    kernel->add_module( new Drillingcycles() );
+    kernel->add_module( new Drillingcycles(), "drillingcycles" );
     #endif
     #ifndef NO_TOOLS_FILAMENTDETECTOR
-    kernel->add_module( new FilamentDetector() );
+    kernel->add_module( new FilamentDetector(), "filamentdetector" );
     #endif
     #ifndef NO_UTILS_MOTORDRIVERCONTROL
-    kernel->add_module( new MotorDriverControl(0) );
+    kernel->add_module( new MotorDriverControl(0), "motordrivercontrol" );
     #endif
+    #ifndef NO_UTILS_MOTIONSYNC
+    kernel->add_module( new MotionSync(), "motionsync" );
+    #endif
+    #ifndef NO_UTILS_SUBPROGRAMS
+    kernel->add_module( new Subprograms(), "subprograms" );
+    #endif
+    #ifndef NO_UTILS_ENCODERFEEDBACK
+    kernel->add_module( new EncoderFeedback(), "encoder_feedback" );
+    #endif
+    #ifndef NO_UTILS_TELEMETRY
+    // after the temperature controls, it samples them
+    kernel->add_module( new Telemetry(), "telemetry" );
+    #endif
+    kernel->boot_mark("modules loaded");
+
     // Create and initialize USB stuff
     u.init();
 
 #ifdef DISABLEMSD
     if(sdok && msc != NULL){
-        kernel->add_module( msc );
+        kernel->add_module( msc, "msd" );
     }
 #else
-    kernel->add_module( &msc );
+    kernel->add_module( &msc, "msd" );
 #endif
 
-    kernel->add_module( &usbserial );
+    kernel->add_module( &usbserial, "usbserial" );
     if( kernel->config->value( second_usb_serial_enable_checksum )->by_default(false)->as_bool() ){
-        kernel->add_module( new(AHB0) USBSerial(&u) );
+        kernel->add_module( new(AHB0) USBSerial(&u), "usbserial2" );
     }
 
     if( kernel->config->value( dfu_enable_checksum )->by_default(false)->as_bool() ){
-        kernel->add_module( new(AHB0) DFU(&u));
+        kernel->add_module( new(AHB0) DFU(&u), "dfu");
     }
 
     // 10 second watchdog timeout (or config as seconds)
     float t= kernel->config->value( watchdog_timeout_checksum )->by_default(10.0F)->as_number();
     if(t > 0.1F) {
         // NOTE setting WDT_RESET with the current bootloader would leave it in DFU mode which would be suboptimal
-        kernel->add_module( new Watchdog(t*1000000, WDT_MRI)); // WDT_RESET));
+        kernel->add_module( new Watchdog(t*1000000, WDT_MRI), "watchdog"); // WDT_RESET));
         kernel->streams->printf("Watchdog enabled for %f seconds\n", t);
     }else{
         kernel->streams->printf("WARNING Watchdog is disabled\n");
     }
 
 
-    kernel->add_module( &u );
+    kernel->add_module( &u, "usb" );
+    kernel->boot_mark("usb connected");
 
     // memory before cache is cleared
     //SimpleShell::print_mem(kernel->streams);
@@ -244,6 +275,7 @@ void init() {
     if(sdok) {
         // load config override file if present
         // NOTE only Mxxx commands that set values should be put in this file. The file is generated by M500
+        AtomicFileStream::recover(kernel->config_override_filename());
         FILE *fp= fopen(kernel->config_override_filename(), "r");
         if(fp != NULL) {
             char buf[132];
@@ -256,6 +288,7 @@ void init() {
             }
             kernel->streams->printf("config override file executed\n");
             fclose(fp);
+            kernel->boot_mark("config override loaded");
         }
     }
 
@@ -267,15 +300,21 @@ void init() {
 int main()
 {
     init();
+    THEKERNEL->boot_mark("main loop");
 
-    uint16_t cnt= 0;
     // Main loop
     while(1){
+        uint32_t t= us_ticker_read();
         if(THEKERNEL->is_using_leds()) {
             // flash led 2 to show we are alive
-            leds[1]= (cnt++ & 0x1000) ? 1 : 0;
+            leds[1]= (t & 0x40000) ? 1 : 0;
         }
         THEKERNEL->call_event(ON_MAIN_LOOP);
         THEKERNEL->call_event(ON_IDLE);
+        THEKERNEL->latency->add_main_loop(us_ticker_read() - t);
+        THEKERNEL->latency->flush_log();
+        AppendFileStream::poll_all();
+        THEKERNEL->run_deferred_init();
+        THEKERNEL->sleep_if_idle();
     }
 }
@@ -15,23 +15,55 @@
 #include "libs/SerialMessage.h"
 #include "libs/StreamOutput.h"
 #include "libs/StreamOutputPool.h"
-#include "libs/FileStream.h"
-#include "libs/AppendFileStream.h"
+#include "libs/AtomicFileStream.h"
 #include "Config.h"
 #include "checksumm.h"
 #include "ConfigValue.h"
 #include "PublicDataRequest.h"
 #include "PublicData.h"
+#include "PlayerPublicAccess.h"
+#include "LaserPublicAccess.h"
 #include "SimpleShell.h"
 #include "utils.h"
+#include "EventTrace.h"
 #include "LPC17xx.h"
 
+#include <algorithm>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
 #define return_error_on_unhandled_gcode_checksum    CHECKSUM("return_error_on_unhandled_gcode")
 #define panel_display_message_checksum CHECKSUM("display_message")
 #define panel_checksum             CHECKSUM("panel")
 
 // goes in Flash, list of Mxxx codes that are allowed when in Halted state
 static const int allowed_mcodes[]= {105,114,119,80,81,911,503,106,107}; // get temp, get pos, get endstops etc
+// the XOR of the bytes of a line, a word at a time
+static uint8_t line_checksum(const char *p, size_t n)
+{
+    uint32_t x= 0;
+    for (; n > 0 && ((uintptr_t)p & 3) != 0; n--) x ^= (uint8_t)*p++;
+    for (; n >= 4; n -= 4, p += 4) {
+        uint32_t w;
+        memcpy(&w, p, 4);
+        x ^= w;
+    }
+    for (; n > 0; n--) x ^= (uint8_t)*p++;
+    x ^= x >> 16;
+    x ^= x >> 8;
+    return x & 0xFF;
+}
+
+// where the first of the characters of set is in text[0] up to text[n], n when it has none of them
+static size_t find_first_of(const char *text, size_t n, const char *set)
+{
+    for (size_t i = 0; i < n; i++) {
+        if(text[i] != '\0' && strchr(set, text[i]) != nullptr) return i;
+    }
+    return n;
+}
+
 static bool is_allowed_mcode(int m) {
     for (size_t i = 0; i < sizeof(allowed_mcodes)/sizeof(int); ++i) {
         if(allowed_mcodes[i] == m) return true;
@@ -43,6 +75,7 @@ GcodeDispatch::GcodeDispatch()
 {
     uploading = false;
     currentline = -1;
+    forget_recent_lines();
     modal_group_1= 0;
 }
 
@@ -55,22 +88,32 @@ void GcodeDispatch::on_module_loaded()
 // When a command is received, if it is a Gcode, dispatch it as an object via an event
 void GcodeDispatch::on_console_line_received(void *line)
 {
-    SerialMessage new_message = *static_cast<SerialMessage *>(line);
-    string possible_command = new_message.message;
+    const SerialMessage &new_message = *static_cast<SerialMessage *>(line);
+    // the line is not copied, what is left of it to run is text[pos] up to text[end]
+    const char *text = new_message.message.data();
+    size_t pos = 0;
+    size_t end = new_message.message.size();
+    string pycam; // only a line that is given the last G0-G3 is copied
+    EventTrace::record(EventTrace::LINE_RECEIVED, end);
 
     int ln = 0;
     int cs = 0;
 
     // just reply ok to empty lines
-    if(possible_command.empty()) {
+    if(end == 0) {
         new_message.stream->printf("ok\r\n");
         return;
     }
 
+    if(text[0] == Gcode::packed_marker) {
+        dispatch_packed(new_message);
+        return;
+    }
+
 try_again:
 
-    char first_char = possible_command[0];
-    unsigned int n;
+    char first_char = text[0];
+    size_t n;
 
     if(first_char == '$') {
         // ignore as simpleshell will handle it
@@ -85,32 +128,35 @@ try_again:
 
         //Get linenumber
         if ( first_char == 'N' ) {
-            Gcode full_line = Gcode(possible_command, new_message.stream, false);
-            ln = (int) full_line.get_value('N');
-            int chksum = (int) full_line.get_value('*');
+            ln = strtol(text + 1, nullptr, 10);
+
+            //Strip checksum value from the line
+            const char *star = static_cast<const char *>(memchr(text, '*', end));
+            size_t chkpos = star != nullptr ? star - text : end;
+            uint8_t line_cs = line_checksum(text, chkpos);
+            if ( star != nullptr ) {
+                cs = line_cs - (int)strtol(star + 1, nullptr, 10);
+                end = chkpos;
+            }
+            //Strip line number value from the line
+            while ( pos < end && memchr("N0123456789.,- ", text[pos], 15) != nullptr ) pos++;
 
             //Catch message if it is M110: Set Current Line Number
-            if ( full_line.has_m ) {
-                if ( full_line.m == 110 ) {
-                    currentline = ln;
-                    new_message.stream->printf("ok\r\n");
-                    return;
-                }
+            if ( end - pos >= 4 && strncmp(text + pos, "M110", 4) == 0 && (end - pos == 4 || !isdigit(text[pos + 4])) ) {
+                currentline = ln;
+                forget_recent_lines();
+                new_message.stream->printf("ok\r\n");
+                return;
             }
 
-            //Strip checksum value from possible_command
-            size_t chkpos = possible_command.find_first_of("*");
-            possible_command = possible_command.substr(0, chkpos);
-            //Calculate checksum
-            if ( chkpos != string::npos ) {
-                for (auto c = possible_command.cbegin(); *c != '*' && c != possible_command.cend(); c++)
-                    cs = cs ^ *c;
-                cs &= 0xff;  // Defensive programming...
-                cs -= chksum;
+            if ( cs == 0x00 && is_recent_line(ln, line_cs) ) {
+                // the host sent again a line that was already run, most likely it missed the ok, so it just gets that
+                new_message.stream->printf("ok\r\n");
+                return;
+            }
+            if ( cs == 0x00 && ln == currentline + 1 ) {
+                recent_lines[(unsigned)ln % max_recent_lines] = {ln, line_cs};
             }
-            //Strip line number value from possible_command
-            size_t lnsize = possible_command.find_first_not_of("N0123456789.,- ");
-            possible_command = possible_command.substr(lnsize);
 
         } else {
             //Assume checks succeeded
@@ -119,10 +165,7 @@ try_again:
         }
 
         //Remove comments
-        size_t comment = possible_command.find_first_of(";(");
-        if( comment != string::npos ) {
-            possible_command = possible_command.substr(0, comment);
-        }
+        end = pos + find_first_of(text + pos, end - pos, ";(");
 
         //If checksum passes then process message, else request resend
         int nextline = currentline + 1;
@@ -131,22 +174,15 @@ try_again:
                 currentline = nextline;
             }
 
-            while(possible_command.size() > 0) {
-                // assumes G or M are always the first on the line
-                size_t nextcmd = possible_command.find_first_of("GM", 2);
-                string single_command;
-                if(nextcmd == string::npos) {
-                    single_command = possible_command;
-                    possible_command = "";
-                } else {
-                    single_command = possible_command.substr(0, nextcmd);
-                    possible_command = possible_command.substr(nextcmd);
-                }
-
+            while(pos < end) {
+                // assumes G or M are always the first on the line, the command is text[start] up to text[pos]
+                size_t start = pos;
+                pos = end - start > 2 ? start + 2 + find_first_of(text + start + 2, end - start - 2, "GM") : end;
+                size_t len = pos - start;
 
                 if(!uploading || upload_stream != new_message.stream) {
                     // Prepare gcode for dispatch
-                    Gcode *gcode = new Gcode(single_command, new_message.stream);
+                    Gcode *gcode = new Gcode(text + start, len, new_message.stream);
 
                     if(THEKERNEL->is_halted()) {
                         // we ignore all commands until M999, unless it is in the exceptions list (like M105 get temp)
@@ -172,7 +208,7 @@ try_again:
                         if(gcode->g == 53) { // G53 makes next movement command use machine coordinates
                             // this is ugly to implement as there may or may not be a G0/G1 on the same line
                             // valid version seem to include G53 G0 X1 Y2 Z3 G53 X1 Y2
-                            if(possible_command.empty()) {
+                            if(pos == end) {
                                 // use last gcode G1 or G0 if none on the line, and pass through as if it was a G0/G1
                                 // TODO it is really an error if the last is not G0 thru G3
                                 if(modal_group_1 > 3) {
@@ -186,8 +222,8 @@ try_again:
                             }else{
                                 delete gcode;
                                 // extract next G0/G1 from the rest of the line, ignore if it is not one of these
-                                gcode = new Gcode(possible_command, new_message.stream);
-                                possible_command= "";
+                                gcode = new Gcode(text + pos, end - pos, new_message.stream);
+                                pos = end;
                                 if(!gcode->has_g || gcode->g > 1) {
                                     // not G0 or G1 so ignore it as it is invalid
                                     delete gcode;
@@ -211,10 +247,10 @@ try_again:
                             case 28: // start upload command
                                 delete gcode;
 
-                                this->upload_filename = "/sd/" + single_command.substr(4); // rest of line is filename
+                                this->upload_filename = "/sd/";
+                                if(len > 4) this->upload_filename.append(text + start + 4, len - 4); // rest of line is filename
                                 // open file
-                                upload_fd = fopen(this->upload_filename.c_str(), "w");
-                                if(upload_fd != NULL) {
+                                if(upload_file.open(this->upload_filename)) {
                                     this->uploading = true;
                                     new_message.stream->printf("Writing to file: %s\r\nok\r\n", this->upload_filename.c_str());
                                 } else {
@@ -224,7 +260,6 @@ try_again:
                                 // only save stuff from this stream
                                 upload_stream= new_message.stream;
 
-                                //printf("Start Uploading file: %s, %p\n", upload_filename.c_str(), upload_fd);
                                 continue;
 
                             case 30: // end of program
@@ -250,19 +285,32 @@ try_again:
                                 return;
 
                             case 117: // M117 is a special non compliant Gcode as it allows arbitrary text on the line following the command
-                            {    // concatenate the command again and send to panel if enabled
-                                string str= single_command.substr(4) + possible_command;
+                            {    // the rest of the line after the command goes to the panel if enabled
+                                string str= len > 4 ? string(text + start + 4, end - start - 4) : string();
                                 PublicData::set_value( panel_checksum, panel_display_message_checksum, &str );
                                 delete gcode;
                                 new_message.stream->printf("ok\r\n");
                                 return;
                             }
 
+                            case 650: // M650 is raster data for the laser, the base64 after the command is not gcode so it is passed on as is
+                            {
+                                string str= len > 4 ? string(text + start + 4, end - start - 4) : string();
+                                delete gcode;
+                                if(PublicData::set_value( laser_checksum, raster_data_checksum, &str )) {
+                                    new_message.stream->printf("ok\r\n");
+                                } else {
+                                    new_message.stream->printf("ok - Invalid raster data or laser not enabled\r\n");
+                                }
+                                return;
+                            }
+
                             case 1000: // M1000 is a special command that will pass thru the raw lowercased command to the simpleshell (for hosts that do not allow such things)
                             {
-                                // reconstruct entire command line again
-                                string str= single_command.substr(5) + possible_command;
-                                while(is_whitespace(str.front())){ str= str.substr(1); } // strip leading whitespace
+                                // the rest of the line after the command, less the leading whitespace
+                                size_t from= std::min(start + 5, end);
+                                while(from < end && is_whitespace(text[from])) from++;
+                                string str(text + from, end - from);
 
                                 delete gcode;
 
@@ -273,7 +321,7 @@ try_again:
                                     string args= lc(str);
                                     string cmd = shift_parameter(args);
                                     // find command and execute it
-                                    if(!SimpleShell::parse_command(cmd.c_str(), args, new_message.stream)) {
+                                    if(!SimpleShell::parse_command(cmd.c_str(), args.c_str(), new_message.stream)) {
                                         new_message.stream->printf("Command not found: %s\n", cmd.c_str());
                                     }
                                 }
@@ -284,21 +332,23 @@ try_again:
 
                             case 500: // M500 save volatile settings to config-override
                                 THEKERNEL->conveyor->wait_for_empty_queue(); //just to be safe as it can take a while to run
-                                //remove(THEKERNEL->config_override_filename()); // seems to cause a hang every now and then
                                 __disable_irq();
                                 {
-                                    FileStream fs(THEKERNEL->config_override_filename());
+                                    // the settings are gathered in RAM and replace config-override in one go
+                                    AtomicFileStream fs(THEKERNEL->config_override_filename());
                                     fs.printf("; DO NOT EDIT THIS FILE\n");
-                                    // this also will truncate the existing file instead of deleting it
+                                    gcode->stream = &fs;
+                                    // dispatch the M500 here so we can free up the stream when done
+                                    THEKERNEL->call_event(ON_GCODE_RECEIVED, gcode );
+                                    delete gcode;
+                                    bool ok= fs.commit();
+                                    __enable_irq();
+                                    if(ok) {
+                                        new_message.stream->printf("Settings Stored to %s\r\nok\r\n", THEKERNEL->config_override_filename());
+                                    }else{
+                                        new_message.stream->printf("Error: unable to store settings to %s\r\nok\r\n", THEKERNEL->config_override_filename());
+                                    }
                                 }
-                                // replace stream with one that writes to config-override file
-                                gcode->stream = new AppendFileStream(THEKERNEL->config_override_filename());
-                                // dispatch the M500 here so we can free up the stream when done
-                                THEKERNEL->call_event(ON_GCODE_RECEIVED, gcode );
-                                delete gcode->stream;
-                                delete gcode;
-                                __enable_irq();
-                                new_message.stream->printf("Settings Stored to %s\r\nok\r\n", THEKERNEL->config_override_filename());
                                 continue;
 
                             case 502: // M502 deletes config-override so everything defaults to what is in config
@@ -335,7 +385,7 @@ try_again:
                     } else {
                         if(THEKERNEL->is_ok_per_line() || THEKERNEL->is_grbl_mode()) {
                             // only send ok once per line if this is a multi g code line send ok on the last one
-                            if(possible_command.empty())
+                            if(pos == end)
                                 new_message.stream->printf("ok\r\n");
                         } else {
                             // maybe should do the above for all hosts?
@@ -347,43 +397,35 @@ try_again:
 
                 } else {
                     // we are uploading and it is the upload stream so so save it
-                    if(single_command.substr(0, 3) == "M29") {
-                        // done uploading, close file
-                        fclose(upload_fd);
-                        upload_fd = NULL;
+                    if(len >= 3 && strncmp(text + start, "M29", 3) == 0) {
+                        // done uploading, write out the rest and close file
+                        bool ok= !upload_file.is_open() || upload_file.close();
                         uploading = false;
+                        {
+                            // Player compiles the file if it is set to
+                            struct pad_compile c{upload_filename, new_message.stream};
+                            PublicData::set_value(player_checksum, compile_job_checksum, &c);
+                        }
                         upload_filename.clear();
                         upload_stream= nullptr;
-                        new_message.stream->printf("Done saving file.\r\nok\r\n");
+                        new_message.stream->printf(ok ? "Done saving file.\r\nok\r\n" : "Error:error writing to file.\r\nok\r\n");
                         continue;
                     }
 
-                    if(upload_fd == NULL) {
+                    if(!upload_file.is_open()) {
                         // error detected writing to file so discard everything until it stops
                         new_message.stream->printf("ok\r\n");
                         continue;
                     }
 
-                    single_command.append("\n");
-                    static int cnt = 0;
-                    if(fwrite(single_command.c_str(), 1, single_command.size(), upload_fd) != single_command.size()) {
+                    // held until there is a buffer full to write
+                    if(!upload_file.write(text + start, len) || !upload_file.putc('\n')) {
                         // error writing to file
                         new_message.stream->printf("Error:error writing to file.\r\n");
-                        fclose(upload_fd);
-                        upload_fd = NULL;
+                        upload_file.close();
                         continue;
-
-                    } else {
-                        cnt += single_command.size();
-                        if (cnt > 400) {
-                            // HACK ALERT to get around fwrite corruption close and re open for append
-                            fclose(upload_fd);
-                            upload_fd = fopen(upload_filename.c_str(), "a");
-                            cnt = 0;
-                        }
-                        new_message.stream->printf("ok\r\n");
-                        //printf("uploading file write ok\n");
                     }
+                    new_message.stream->printf("ok\r\n");
                 }
             }
 
@@ -392,11 +434,13 @@ try_again:
             new_message.stream->printf("rs N%d\r\n", nextline);
         }
 
-    } else if( (n=possible_command.find_first_of("XYZF")) == 0 || (first_char == ' ' && n != string::npos) ) {
+    } else if( (n=find_first_of(text, end, "XYZF")) == 0 || (first_char == ' ' && n != end) ) {
         // handle pycam syntax, use last modal group 1 command and resubmit if an X Y Z or F is found on its own line
         char buf[6];
         snprintf(buf, sizeof(buf), "G%d ", modal_group_1);
-        possible_command.insert(0, buf);
+        pycam.assign(buf).append(text, end);
+        text = pycam.data();
+        end = pycam.size();
         goto try_again;
 
         // Ignore comments and blank lines
@@ -405,3 +449,64 @@ try_again:
     }
 }
 
+// a packed gcode is decoded straight into a Gcode, it only carries a single command with numeric arguments,
+// so the commands that need the rest of the line or special handling here are not accepted
+void GcodeDispatch::dispatch_packed(const SerialMessage &message)
+{
+    if(uploading && upload_stream == message.stream) {
+        message.stream->printf("error:packed gcode can not be uploaded\r\n");
+        return;
+    }
+
+    Gcode *gcode = Gcode::decode_packed(message.message.c_str(), message.stream);
+    if(gcode == nullptr) {
+        message.stream->printf("error:Bad packed gcode\r\n");
+        return;
+    }
+
+    if(gcode->has_g && gcode->g == 53) {
+        message.stream->printf("error:G53 can not be packed\r\n");
+        delete gcode;
+        return;
+    }
+
+    if(gcode->has_m) {
+        switch(gcode->m) {
+            case 2: case 28: case 30: case 112: case 117: case 500: case 502: case 503: case 1000:
+                message.stream->printf("error:M%d can not be packed\r\n", gcode->m);
+                delete gcode;
+                return;
+        }
+    }
+
+    if(THEKERNEL->is_halted()) {
+        if(gcode->has_m && gcode->m == 999) {
+            THEKERNEL->call_event(ON_HALT, (void *)1); // clears on_halt
+
+        }else if(!is_allowed_mcode(gcode->m)) {
+            if(THEKERNEL->is_grbl_mode()) {
+                message.stream->printf("error:Alarm lock\n");
+            }else{
+                message.stream->printf("!!\r\n");
+            }
+            delete gcode;
+            return;
+        }
+    }
+
+    if(gcode->has_g && gcode->g < 4) {
+        modal_group_1= gcode->g;
+    }
+
+    THEKERNEL->call_event(ON_GCODE_RECEIVED, gcode );
+    if(gcode->add_nl)
+        message.stream->printf("\r\n");
+
+    if(!gcode->txt_after_ok.empty()) {
+        message.stream->printf("ok %s\r\n", gcode->txt_after_ok.c_str());
+    } else {
+        message.stream->printf("ok\r\n");
+    }
+
+    delete gcode;
+}
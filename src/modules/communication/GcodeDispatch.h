@@ -9,12 +9,13 @@
 #define GCODE_DISPATCH_H
 
 #include "libs/Module.h"
+#include "UploadFile.h"
 
-#include <stdio.h>
 #include <string>
 using std::string;
 
 class StreamOutput;
+struct SerialMessage;
 
 class GcodeDispatch : public Module
 {
@@ -26,9 +27,24 @@ public:
 
     uint8_t get_modal_command() const { return modal_group_1<4 ? modal_group_1 : 0; }
 private:
+    void dispatch_packed(const SerialMessage &message);
+
+    // the last few numbered lines that were run, by line number, with their checksums
+    static const int max_recent_lines= 16;
+    struct recent_line_t {
+        int line;
+        uint8_t checksum;
+    };
+    recent_line_t recent_lines[max_recent_lines];
+    bool is_recent_line(int ln, uint8_t cs) const {
+        const recent_line_t &r= recent_lines[(unsigned)ln % max_recent_lines];
+        return ln <= currentline && r.line == ln && r.checksum == cs;
+    }
+    void forget_recent_lines() { for (auto &r : recent_lines) r.line= -1; }
+
     int currentline;
     string upload_filename;
-    FILE *upload_fd;
+    UploadFile upload_file;
     StreamOutput* upload_stream{nullptr};
     uint8_t modal_group_1;
     struct {
@@ -10,31 +10,66 @@
 using std::string;
 #include "libs/Module.h"
 #include "libs/Kernel.h"
+#include "libs/InputArbiter.h"
 #include "libs/nuts_bolts.h"
 #include "SerialConsole.h"
-#include "libs/RingBuffer.h"
 #include "libs/SerialMessage.h"
 #include "libs/StreamOutput.h"
 #include "libs/StreamOutputPool.h"
+#include "Config.h"
+#include "ConfigValue.h"
+#include "checksumm.h"
+#include "platform_memory.h"
+#include "sLPC17xx.h"
+#include "Robot.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#define uart0_checksum             CHECKSUM("uart0")
 
 // Serial reading module
 // Treats every received line as a command and passes it ( via event call ) to the command dispatcher.
 // The command dispatcher will then ask other modules if they can do something with it
 SerialConsole::SerialConsole( PinName rx_pin, PinName tx_pin, int baud_rate ){
-    this->serial = new mbed::Serial( rx_pin, tx_pin );
+    this->serial = new FifoSerial( rx_pin, tx_pin );
     this->serial->baud(baud_rate);
+    this->rx_buffer= nullptr;
+    this->rx_mask= 0;
+    this->rx_head= this->rx_tail= this->rx_line_start= 0;
+    this->rx_lines= 0;
+    this->overflow_chars= 0;
+    this->overflow_lines= 0;
+    this->query_flag= false;
+    this->halt_flag= false;
+    this->flush_to_nl= false;
+    this->tx_active= false;
+    this->tx_dropped= 0;
 }
 
 // Called when the module has just been loaded
 void SerialConsole::on_module_loaded() {
+    // the receive ring must be a power of two, it has to hold the longest line we accept
+    uint32_t n= THEKERNEL->config->value(uart0_checksum, rx_buffer_size_checksum)->by_default(512)->as_number();
+    uint32_t size= 128;
+    while(size < n && size < 8192) size <<= 1;
+    this->rx_buffer= (char *)AHB0.alloc(size);
+    if(this->rx_buffer == nullptr) this->rx_buffer= (char *)malloc(size);
+    this->rx_mask= size - 1;
+
     // We want to be called every time a new char is received
     this->serial->attach(this, &SerialConsole::on_serial_char_received, mbed::Serial::RxIrq);
-    query_flag= false;
-    halt_flag= false;
+    // and every time the transmit FIFO has been sent
+    this->serial->attach(this, &SerialConsole::on_serial_tx_empty, mbed::Serial::TxIrq);
 
     // We only call the command dispatcher in the main loop, nowhere else
     this->register_for_event(ON_MAIN_LOOP);
     this->register_for_event(ON_IDLE);
+    // reads the lines that keep the planner fed
+    this->set_event_priority(ON_MAIN_LOOP, PRIORITY_FEED);
+    this->set_event_priority(ON_IDLE, PRIORITY_FEED);
+    THEKERNEL->add_input_check([this]() { return rx_lines != 0; });
+    input_source= THEKERNEL->input_arbiter->add_source("serial", [this]() { return rx_lines != 0; });
 
     // Add to the pack of streams kernel can call to, for example for broadcasting
     THEKERNEL->streams->append_stream(this);
@@ -52,9 +87,77 @@ void SerialConsole::on_serial_char_received(){
             halt_flag= true;
             continue;
         }
+        if(received == (char)0x85) { // jog cancel
+            THEKERNEL->robot->cancel_jog();
+            continue;
+        }
         // convert CR to NL (for host OSs that don't send NL)
         if( received == '\r' ){ received = '\n'; }
-        this->buffer.push_back(received);
+
+        if(flush_to_nl) {
+            // discarding the rest of a line that did not fit
+            overflow_chars++;
+            if(received == '\n') flush_to_nl= false;
+            continue;
+        }
+
+        uint16_t next= (rx_head + 1) & rx_mask;
+        if(next == rx_tail) {
+            // ring is full, drop the partial line so we never hand on a corrupted one, and skip to its end
+            overflow_chars += ((rx_head - rx_line_start) & rx_mask) + 1;
+            overflow_lines++;
+            rx_head= rx_line_start;
+            if(received != '\n') flush_to_nl= true;
+            continue;
+        }
+
+        rx_buffer[rx_head]= received;
+        rx_head= next;
+        if(received == '\n') {
+            rx_line_start= next;
+            rx_lines++;
+        }
+    }
+}
+
+// Called on Serial::TxIrq interrupt, meaning the transmit FIFO is empty
+void SerialConsole::on_serial_tx_empty()
+{
+    fill_tx_fifo();
+}
+
+// the FIFO can only be known to have room once it is empty, it is then filled from the ring
+// when the ring is empty too the interrupt that follows never comes, so the next send starts it again
+void SerialConsole::fill_tx_fifo()
+{
+    if(!serial->writeable()) return;
+    char c;
+    int n= 0;
+    while(n < FifoSerial::fifo_size && tx_ring.pop(c)) {
+        serial->write_fifo(c);
+        n++;
+    }
+    tx_active= (n > 0);
+}
+
+// queues the chars for the TX interrupt, when the ring is full it waits or, if wait is false, drops them all
+// waiting is only as long as the UART takes to send what is ahead, and it sends it itself if interrupts are off
+bool SerialConsole::send(const char *s, size_t n, bool wait)
+{
+    if(!wait && n > tx_ring.free()) {
+        tx_dropped++;
+        return false;
+    }
+    while(true) {
+        size_t k= tx_ring.push(s, n);
+        s += k;
+        n -= k;
+        // the ring is popped here as well as in the interrupt, so it must not run meanwhile
+        uint32_t primask= __get_PRIMASK();
+        __disable_irq();
+        if(!tx_active || (n > 0 && serial->writeable())) fill_tx_fifo();
+        __set_PRIMASK(primask);
+        if(n == 0) return true;
     }
 }
 
@@ -62,7 +165,9 @@ void SerialConsole::on_idle(void * argument)
 {
     if(query_flag) {
         query_flag= false;
-        puts(THEKERNEL->get_query_string().c_str());
+        char buf[128];
+        THEKERNEL->format_query(buf, sizeof(buf));
+        puts(buf);
     }
     if(halt_flag) {
         halt_flag= false;
@@ -72,49 +177,63 @@ void SerialConsole::on_idle(void * argument)
 
 // Actual event calling must happen in the main loop because if it happens in the interrupt we will loose data
 void SerialConsole::on_main_loop(void * argument){
-    if( this->has_char('\n') ){
-        string received;
-        received.reserve(20);
-        while(1){
-           char c;
-           this->buffer.pop_front(c);
-           if( c == '\n' ){
-                struct SerialMessage message;
-                message.message = received;
-                message.stream = this;
-                THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
-                return;
-            }else{
-                received += c;
-            }
-        }
+    if(rx_lines == 0 || !THEKERNEL->input_arbiter->may_take(input_source)) return;
+
+    // the interrupt counted a whole line, so there is a newline between tail and head
+    uint16_t tail= rx_tail;
+    uint16_t end= tail;
+    while(rx_buffer[end] != '\n') end= (end + 1) & rx_mask;
+
+    struct SerialMessage message;
+    if(end >= tail) {
+        message.message.assign(&rx_buffer[tail], end - tail);
+    } else {
+        // the line wraps around the end of the ring
+        message.message.reserve(rx_mask + 1 - tail + end);
+        message.message.assign(&rx_buffer[tail], rx_mask + 1 - tail);
+        message.message.append(rx_buffer, end);
     }
+    message.stream = this;
+
+    // release the line before dispatching it, the handler may take a while
+    rx_tail= (end + 1) & rx_mask;
+    __disable_irq();
+    rx_lines--;
+    __enable_irq();
+
+    THEKERNEL->input_arbiter->took(input_source, message.message.size());
+    THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
+}
+
+void SerialConsole::print_stats(StreamOutput *stream) const
+{
+    stream->printf("serial rx buffer: %u bytes, %u used, %u lines pending\n", rx_mask + 1, (rx_head - rx_tail) & rx_mask, rx_lines);
+    stream->printf("serial rx overflows: %lu lines dropped, %lu chars dropped\n", overflow_lines, overflow_chars);
+    stream->printf("serial tx buffer: %u bytes, %u used, %lu broadcasts dropped\n", tx_ring.capacity(), tx_ring.size(), tx_dropped);
 }
 
 
 int SerialConsole::puts(const char* s)
 {
-    return fwrite(s, strlen(s), 1, (FILE*)(*this->serial));
+    size_t n= strlen(s);
+    send(s, n, true);
+    return n;
+}
+
+int SerialConsole::try_puts(const char* s)
+{
+    size_t n= strlen(s);
+    return send(s, n, false) ? n : 0;
 }
 
 int SerialConsole::_putc(int c)
 {
-    return this->serial->putc(c);
+    char ch= c;
+    send(&ch, 1, true);
+    return c;
 }
 
 int SerialConsole::_getc()
 {
     return this->serial->getc();
 }
-
-// Does the queue have a given char ?
-bool SerialConsole::has_char(char letter){
-    int index = this->buffer.tail;
-    while( index != this->buffer.head ){
-        if( this->buffer.buffer[index] == letter ){
-            return true;
-        }
-        index = this->buffer.next_block_index(index);
-    }
-    return false;
-}
@@ -14,11 +14,20 @@
 #include <vector>
 #include <string>
 using std::string;
-#include "libs/RingBuffer.h"
 #include "libs/StreamOutput.h"
+#include "SpscRing.h"
 
 
 #define baud_rate_setting_checksum CHECKSUM("baud_rate")
+#define rx_buffer_size_checksum    CHECKSUM("rx_buffer_size")
+
+// mbed Serial with the transmit FIFO exposed, so the TX interrupt can fill all of it at once
+class FifoSerial : public mbed::Serial {
+    public:
+        FifoSerial(PinName tx, PinName rx) : mbed::Serial(tx, rx) {}
+        void write_fifo(char c) { _serial.uart->THR = c; }
+        static const int fifo_size= 16;
+};
 
 class SerialConsole : public Module, public StreamOutput {
     public:
@@ -26,21 +35,39 @@ class SerialConsole : public Module, public StreamOutput {
 
         void on_module_loaded();
         void on_serial_char_received();
+        void on_serial_tx_empty();
         void on_main_loop(void * argument);
         void on_idle(void * argument);
-        bool has_char(char letter);
+        void print_stats(StreamOutput *stream) const;
 
         int _putc(int c);
         int _getc(void);
         int puts(const char*);
+        int try_puts(const char*);
+
+        FifoSerial* serial;
+
+    private:
+        uint8_t input_source;           // in the InputArbiter
+        bool send(const char *s, size_t n, bool wait);
+        void fill_tx_fifo();
+
+        SpscRing<char, 256> tx_ring;    // sent by the TX interrupt
+        volatile uint32_t tx_dropped;   // broadcasts dropped because the ring was full
 
-        //string receive_buffer;                 // Received chars are stored here until a newline character is received
-        //vector<std::string> received_lines;    // Received lines are stored here until they are requested
-        RingBuffer<char,256> buffer;             // Receive buffer
-        mbed::Serial* serial;
+        char *rx_buffer;                // Receive ring, size is a power of two
+        uint16_t rx_mask;
+        volatile uint16_t rx_head;
+        volatile uint16_t rx_tail;
+        uint16_t rx_line_start;         // where the line currently being received starts, only used by the interrupt
+        volatile uint16_t rx_lines;     // number of complete lines in the ring, counted by the RX interrupt
+        volatile uint32_t overflow_chars; // chars dropped because the ring was full
+        volatile uint32_t overflow_lines; // lines too long to fit in the ring, they are discarded
         struct {
           bool query_flag:1;
           bool halt_flag:1;
+          bool flush_to_nl:1;
+          volatile bool tx_active:1;    // the FIFO is being sent, there will be a TX interrupt when it is empty
         };
 };
 
@@ -0,0 +1,117 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StatusReport.h"
+
+#include "libs/Kernel.h"
+#include "libs/SerialMessage.h"
+#include "libs/StreamOutput.h"
+#include "libs/utils.h"
+#include "us_ticker_api.h"
+
+#include <stdlib.h>
+#include <string>
+
+using std::string;
+
+// fastest rate a stream can ask for
+#define MAX_STATUS_HZ 50
+
+StatusReport *StatusReport::instance= nullptr;
+
+StatusReport::StatusReport()
+{
+    instance= this;
+    sending= false;
+}
+
+void StatusReport::on_module_loaded()
+{
+    this->register_for_event(ON_IDLE);
+    this->set_event_priority(ON_IDLE, PRIORITY_HOUSEKEEPING);
+    this->register_for_event(ON_CONSOLE_LINE_RECEIVED);
+}
+
+// status <hz> sends the report to this stream hz times a second while it changes, status 0 stops it
+void StatusReport::on_console_line_received(void *argument)
+{
+    SerialMessage *msg= static_cast<SerialMessage *>(argument);
+    string possible_command= msg->message;
+    if(possible_command.compare(0, 6, "status") != 0 || (possible_command.size() > 6 && possible_command[6] != ' ')) return;
+
+    shift_parameter(possible_command);
+    string hz= shift_parameter(possible_command);
+    if(hz.empty()) {
+        msg->stream->printf("usage: status <hz>, 0 to stop\r\n");
+        return;
+    }
+
+    int n= strtol(hz.c_str(), nullptr, 10);
+    if(n <= 0) {
+        unsubscribe(msg->stream);
+        msg->stream->printf("status reports stopped\r\n");
+        return;
+    }
+    if(n > MAX_STATUS_HZ) n= MAX_STATUS_HZ;
+    subscribe(msg->stream, 1000000 / n);
+    msg->stream->printf("status reports at %d Hz\r\n", n);
+}
+
+void StatusReport::subscribe(StreamOutput *stream, uint32_t interval_us)
+{
+    for(auto &s : subscribers) {
+        if(s.stream == stream) {
+            s.interval_us= interval_us;
+            return;
+        }
+    }
+    // last_hash of 0 sends the first report straight away
+    subscribers.push_back({stream, interval_us, us_ticker_read() - interval_us, 0});
+}
+
+void StatusReport::unsubscribe(StreamOutput *stream)
+{
+    if(instance == nullptr) return;
+    auto &subs= instance->subscribers;
+    for(auto i= subs.begin(); i != subs.end(); ++i) {
+        if(i->stream == stream) {
+            subs.erase(i);
+            return;
+        }
+    }
+}
+
+void StatusReport::on_idle(void *argument)
+{
+    // a stream with a full output buffer calls on_idle while it waits
+    if(subscribers.empty() || sending) return;
+
+    uint32_t now= us_ticker_read();
+    bool due= false;
+    for(auto &s : subscribers) {
+        if(now - s.last_us >= s.interval_us) {
+            due= true;
+            break;
+        }
+    }
+    if(!due) return;
+
+    sending= true;
+    size_t n= THEKERNEL->format_query(report, sizeof(report));
+    uint32_t h= fnv1a(report, n);
+    if(h == 0) h= 1;
+
+    for(size_t i= 0; i < subscribers.size(); i++) {
+        subscriber_t &s= subscribers[i];
+        if(now - s.last_us < s.interval_us) continue;
+        s.last_us= now;
+        if(s.last_hash == h) continue;
+        // a report the stream has no room for is dropped, the next one is sent even if nothing changed
+        if(s.stream->try_puts(report) > 0) s.last_hash= h;
+    }
+    sending= false;
+}
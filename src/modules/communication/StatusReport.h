@@ -0,0 +1,48 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STATUSREPORT_H
+#define STATUSREPORT_H
+
+#include "libs/Module.h"
+
+#include <stdint.h>
+#include <vector>
+
+class StreamOutput;
+
+// Sends the ? query report to the streams that asked for it with the status command, at the rate they asked for and
+// only when it has changed. The report is formatted once into a fixed buffer and sent to every stream that is due.
+class StatusReport : public Module
+{
+public:
+    StatusReport();
+
+    void on_module_loaded();
+    void on_idle(void *argument);
+    void on_console_line_received(void *argument);
+
+    // a stream that is going away has to be taken off the list
+    static void unsubscribe(StreamOutput *stream);
+
+private:
+    struct subscriber_t {
+        StreamOutput *stream;
+        uint32_t interval_us;
+        uint32_t last_us;
+        uint32_t last_hash;                 // of the last report sent, it is not sent again until it changes
+    };
+
+    void subscribe(StreamOutput *stream, uint32_t interval_us);
+
+    static StatusReport *instance;
+    std::vector<subscriber_t> subscribers;
+    char report[128];
+    bool sending;
+};
+
+#endif
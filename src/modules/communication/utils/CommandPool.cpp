@@ -0,0 +1,98 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CommandPool.h"
+
+#include "platform_memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// plain zero initialized data, so gcodes made before resize() is called just go on the heap
+CommandPool::slab_t *CommandPool::slabs;
+CommandPool::slab_t *CommandPool::free_list;
+unsigned int CommandPool::size;
+unsigned int CommandPool::used;
+unsigned int CommandPool::peak;
+uint32_t CommandPool::fallbacks;
+
+void CommandPool::free_memory()
+{
+    if(slabs == nullptr) return;
+
+    if(_AHB0 != nullptr && AHB0.has(slabs)) AHB0.dealloc(slabs);
+    else ::free(slabs);
+    slabs= nullptr;
+    free_list= nullptr;
+    size= 0;
+}
+
+bool CommandPool::resize(unsigned int n)
+{
+    if(used > 0) return false;
+
+    free_memory();
+    if(n == 0) return true;
+
+    // try to put it in AHB0 first and fall back to the heap, this is only done once at startup
+    size_t bytes= n * sizeof(slab_t);
+    void *mem= (_AHB0 != nullptr) ? AHB0.alloc(bytes) : nullptr;
+    if(mem == nullptr) mem= malloc(bytes);
+    if(mem == nullptr) return false;
+
+    slabs= static_cast<slab_t *>(mem);
+    size= n;
+
+    // chain all the slabs into the free list
+    for (unsigned int i = 0; i < n; ++i) {
+        slabs[i].next= (i+1 < n) ? &slabs[i+1] : nullptr;
+    }
+    free_list= slabs;
+    peak= 0;
+    fallbacks= 0;
+
+    return true;
+}
+
+char *CommandPool::dup(const char *str, size_t len)
+{
+    char *p;
+    if(len < slab_size && free_list != nullptr) {
+        slab_t *s= free_list;
+        free_list= s->next;
+        if(++used > peak) peak= used;
+        p= s->text;
+
+    } else {
+        p= static_cast<char *>(malloc(len + 1));
+        if(p == nullptr) return nullptr;
+        ++fallbacks;
+    }
+
+    memcpy(p, str, len);
+    p[len]= '\0';
+    return p;
+}
+
+char *CommandPool::dup(const char *str)
+{
+    return dup(str, strlen(str));
+}
+
+void CommandPool::free(char *p)
+{
+    if(p == nullptr) return;
+
+    if(owns(p)) {
+        slab_t *s= reinterpret_cast<slab_t *>(p);
+        s->next= free_list;
+        free_list= s;
+        used--;
+    } else {
+        ::free(p);
+    }
+}
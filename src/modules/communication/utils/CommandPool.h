@@ -0,0 +1,54 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COMMANDPOOL_H
+#define COMMANDPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed size slabs allocated once (from AHB0 if it fits) for the command strings of Gcodes, so parsing a line and
+// copying a gcode onto a block do not go through the heap. A command that does not fit in a slab, or one made while
+// all the slabs are in use, is put on the heap instead.
+// NOTE only to be used from the main loop, never from ISR context
+class CommandPool {
+public:
+    static const size_t slab_size= 64;
+
+    // returns false if any slab is in use or there is not enough memory
+    static bool resize(unsigned int n);
+
+    // copy of the first len characters of str, null terminated
+    static char *dup(const char *str, size_t len);
+    static char *dup(const char *str);
+    static void free(char *p);
+
+    static unsigned int get_size() { return size; }
+    static unsigned int get_used() { return used; }
+    static unsigned int get_peak() { return peak; }
+    static uint32_t get_fallbacks() { return fallbacks; }
+
+private:
+    struct slab_t {
+        union {
+            slab_t *next;
+            char text[slab_size];
+        };
+    };
+
+    static bool owns(const void *p) { return p >= slabs && p < slabs + size; }
+    static void free_memory();
+
+    static slab_t *slabs;
+    static slab_t *free_list;
+    static unsigned int size;
+    static unsigned int used;
+    static unsigned int peak;       // most slabs in use at once
+    static uint32_t fallbacks;      // commands that went on the heap
+};
+
+#endif
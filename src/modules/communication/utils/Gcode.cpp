@@ -7,37 +7,64 @@
 
 
 #include "Gcode.h"
+#include "CommandPool.h"
 #include "libs/StreamOutput.h"
 #include "utils.h"
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <algorithm>
 
 // This is a gcode object. It represents a GCode string/command, and caches some important values about that command for the sake of performance.
 // It gets passed around in events, and attached to the queue ( that'll change )
-Gcode::Gcode(const string &command, StreamOutput *stream, bool strip)
+Gcode::Gcode(const string &command, StreamOutput *stream, bool strip) : Gcode(command.data(), command.size(), stream, strip)
 {
-    this->command= strdup(command.c_str());
+}
+
+Gcode::Gcode(const char *text, size_t n, StreamOutput *stream, bool strip)
+{
+    this->command= CommandPool::dup(text, n);
     this->m= 0;
     this->g= 0;
     this->subcode= 0;
     this->add_nl= false;
     this->stream= stream;
     this->millimeters_of_travel = 0.0F;
+    this->packed= false;
     prepare_cached_values(strip);
     this->stripped= strip;
 }
 
+// used by decode_packed()
+Gcode::Gcode()
+{
+    this->command= nullptr;
+    this->m= 0;
+    this->g= 0;
+    this->subcode= 0;
+    this->add_nl= false;
+    this->has_m= false;
+    this->has_g= false;
+    this->stripped= true;
+    this->packed= true;
+    this->stream= nullptr;
+    this->millimeters_of_travel = 0.0F;
+    this->letter_mask= 0;
+    this->value_mask= 0;
+    this->nonint_mask= 0;
+    this->values_overflow= false;
+}
+
 Gcode::~Gcode()
 {
     if(command != nullptr) {
-        // TODO we can reference count this so we share copies, may save more ram than the extra count we need to store
-        free(command);
+        CommandPool::free(command);
     }
 }
 
 Gcode::Gcode(const Gcode &to_copy)
 {
-    this->command               = strdup(to_copy.command); // TODO we can reference count this so we share copies, may save more ram than the extra count we need to store
+    this->command               = CommandPool::dup(to_copy.command);
     this->millimeters_of_travel = to_copy.millimeters_of_travel;
     this->has_m                 = to_copy.has_m;
     this->has_g                 = to_copy.has_g;
@@ -45,14 +72,22 @@ Gcode::Gcode(const Gcode &to_copy)
     this->g                     = to_copy.g;
     this->subcode               = to_copy.subcode;
     this->add_nl                = to_copy.add_nl;
+    this->stripped              = to_copy.stripped;
+    this->packed                = to_copy.packed;
     this->stream                = to_copy.stream;
     this->txt_after_ok.assign( to_copy.txt_after_ok );
+    this->letter_mask           = to_copy.letter_mask;
+    this->value_mask            = to_copy.value_mask;
+    this->nonint_mask           = to_copy.nonint_mask;
+    this->values_overflow       = to_copy.values_overflow;
+    memcpy(this->word_values, to_copy.word_values, sizeof(this->word_values));
 }
 
 Gcode &Gcode::operator= (const Gcode &to_copy)
 {
     if( this != &to_copy ) {
-        this->command               = strdup(to_copy.command); // TODO we can reference count this so we share copies, may save more ram than the extra count we need to store
+        CommandPool::free(this->command);
+        this->command               = CommandPool::dup(to_copy.command);
         this->millimeters_of_travel = to_copy.millimeters_of_travel;
         this->has_m                 = to_copy.has_m;
         this->has_g                 = to_copy.has_g;
@@ -60,8 +95,16 @@ Gcode &Gcode::operator= (const Gcode &to_copy)
         this->g                     = to_copy.g;
         this->subcode               = to_copy.subcode;
         this->add_nl                = to_copy.add_nl;
+        this->stripped              = to_copy.stripped;
+        this->packed                = to_copy.packed;
+    this->packed                = to_copy.packed;
         this->stream                = to_copy.stream;
         this->txt_after_ok.assign( to_copy.txt_after_ok );
+        this->letter_mask           = to_copy.letter_mask;
+        this->value_mask            = to_copy.value_mask;
+        this->nonint_mask           = to_copy.nonint_mask;
+        this->values_overflow       = to_copy.values_overflow;
+        memcpy(this->word_values, to_copy.word_values, sizeof(this->word_values));
     }
     return *this;
 }
@@ -70,16 +113,30 @@ Gcode &Gcode::operator= (const Gcode &to_copy)
 // Whether or not a Gcode has a letter
 bool Gcode::has_letter( char letter ) const
 {
-    for (size_t i = 0; i < strlen(this->command); ++i) {
-        if( command[i] == letter ) {
-            return true;
-        }
+    if(letter >= 'A' && letter <= 'Z') {
+        return (letter_mask & (1UL << (letter - 'A'))) != 0;
     }
-    return false;
+
+    return strchr(this->command, letter) != nullptr;
 }
 
 // Retrieve the value for a given letter
 float Gcode::get_value( char letter, char **ptr ) const
+{
+    if(ptr == nullptr && letter >= 'A' && letter <= 'Z') {
+        uint32_t bit= 1UL << (letter - 'A');
+        if(value_mask & bit) {
+            // index is the number of lower letters that have a value
+            return word_values[__builtin_popcount(value_mask & (bit - 1))];
+        }
+        if(!values_overflow || !(letter_mask & bit)) return 0;
+    }
+
+    return scan_value(letter, ptr);
+}
+
+// look for the value of the letter in the command string
+float Gcode::scan_value( char letter, char **ptr ) const
 {
     const char *cs = command;
     char *cn = NULL;
@@ -98,6 +155,11 @@ float Gcode::get_value( char letter, char **ptr ) const
 
 int Gcode::get_int( char letter, char **ptr ) const
 {
+    // use the decoded value unless it would not give the same result as strtol
+    if(ptr == nullptr && letter >= 'A' && letter <= 'Z' && !(nonint_mask & (1UL << (letter - 'A')))) {
+        return (int)get_value(letter);
+    }
+
     const char *cs = command;
     char *cn = NULL;
     for (; *cs; cs++) {
@@ -115,6 +177,10 @@ int Gcode::get_int( char letter, char **ptr ) const
 
 uint32_t Gcode::get_uint( char letter, char **ptr ) const
 {
+    if(ptr == nullptr && letter >= 'A' && letter <= 'Z' && !(nonint_mask & (1UL << (letter - 'A')))) {
+        return (uint32_t)(int)get_value(letter);
+    }
+
     const char *cs = command;
     char *cn = NULL;
     for (; *cs; cs++) {
@@ -133,7 +199,8 @@ uint32_t Gcode::get_uint( char letter, char **ptr ) const
 int Gcode::get_num_args() const
 {
     int count = 0;
-    for(size_t i = stripped?0:1; i < strlen(command); i++) {
+    size_t len= strlen(command);
+    for(size_t i = stripped?0:1; i < len; i++) {
         if( this->command[i] >= 'A' && this->command[i] <= 'Z' ) {
             if(this->command[i] == 'T') continue;
             count++;
@@ -145,7 +212,8 @@ int Gcode::get_num_args() const
 std::map<char,float> Gcode::get_args() const
 {
     std::map<char,float> m;
-    for(size_t i = stripped?0:1; i < strlen(command); i++) {
+    size_t len= strlen(command);
+    for(size_t i = stripped?0:1; i < len; i++) {
         char c= this->command[i];
         if( c >= 'A' && c <= 'Z' ) {
             if(c == 'T') continue;
@@ -158,7 +226,8 @@ std::map<char,float> Gcode::get_args() const
 std::map<char,int> Gcode::get_args_int() const
 {
     std::map<char,int> m;
-    for(size_t i = stripped?0:1; i < strlen(command); i++) {
+    size_t len= strlen(command);
+    for(size_t i = stripped?0:1; i < len; i++) {
         char c= this->command[i];
         if( c >= 'A' && c <= 'Z' ) {
             if(c == 'T') continue;
@@ -172,7 +241,7 @@ std::map<char,int> Gcode::get_args_int() const
 void Gcode::prepare_cached_values(bool strip)
 {
     char *p= nullptr;
-    if( this->has_letter('G') ) {
+    if( strchr(this->command, 'G') != nullptr ) {
         this->has_g = true;
         this->g = this->get_int('G', &p);
 
@@ -180,7 +249,7 @@ void Gcode::prepare_cached_values(bool strip)
         this->has_g = false;
     }
 
-    if( this->has_letter('M') ) {
+    if( strchr(this->command, 'M') != nullptr ) {
         this->has_m = true;
         this->m = this->get_int('M', &p);
 
@@ -198,20 +267,198 @@ void Gcode::prepare_cached_values(bool strip)
         }
     }
 
-    if(!strip) return;
-
     // remove the Gxxx or Mxxx from string
-    if (p != nullptr) {
-        char *n= strdup(p); // create new string starting at end of the numeric value
-        free(command);
-        command= n;
+    if (strip && p != nullptr) {
+        // move the rest of the string down over it, the string only gets shorter
+        memmove(command, p, strlen(p) + 1);
+    }
+
+    parse_words();
+}
+
+// decode every letter in the command and the value following it, so later lookups are a table access
+// this mimics the string scanning, so a letter counts as present wherever it appears, and its value
+// is the first number that follows an occurrence of the letter
+void Gcode::parse_words()
+{
+    letter_mask= 0;
+    value_mask= 0;
+    nonint_mask= 0;
+    values_overflow= false;
+    int nvalues= 0;
+
+    for (const char *cs = command; *cs; ) {
+        char c= *cs++;
+        if(c < 'A' || c > 'Z') continue;
+
+        uint32_t bit= 1UL << (c - 'A');
+        letter_mask |= bit;
+        if(value_mask & bit) continue; // already have a value for this letter
+
+        char *cn;
+        float v= strtof(cs, &cn);
+        if(cn <= cs) continue; // no number after this one
+
+        if(nvalues >= max_word_values) {
+            values_overflow= true;
+            continue;
+        }
+
+        // get_int() has to give what strtol would, so flag the values where that is not the truncated float
+        long iv= strtol(cs, nullptr, 10);
+        if(fabsf(v) >= 2147483648.0F || iv != (int)v) nonint_mask |= bit;
+
+        insert_word(bit, v, nvalues++);
+    }
+}
+
+// keep the values in letter order, insert at the position of this letter
+void Gcode::insert_word(uint32_t bit, float v, int nvalues)
+{
+    int idx= __builtin_popcount(value_mask & (bit - 1));
+    for (int i = nvalues; i > idx; --i) {
+        word_values[i]= word_values[i-1];
+    }
+    word_values[idx]= v;
+    value_mask |= bit;
+}
+
+// the command text is left as it is, the lookups of the letter go to the table once it has a value there
+bool Gcode::set_value(char letter, float value)
+{
+    if(letter < 'A' || letter > 'Z') return false;
+    uint32_t bit= 1UL << (letter - 'A');
+    if(value_mask & bit) {
+        word_values[__builtin_popcount(value_mask & (bit - 1))]= value;
+    } else {
+        int nvalues= __builtin_popcount(value_mask);
+        if(nvalues >= max_word_values) return false;
+        insert_word(bit, value, nvalues);
+    }
+    letter_mask |= bit;
+    if(fabsf(value) >= 2147483648.0F) nonint_mask |= bit;
+    else nonint_mask &= ~bit;
+    return true;
+}
+
+static int base64_value(char c)
+{
+    if(c >= 'A' && c <= 'Z') return c - 'A';
+    if(c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if(c >= '0' && c <= '9') return c - '0' + 52;
+    if(c == '+') return 62;
+    if(c == '/') return 63;
+    return -1;
+}
+
+// A packed gcode is the marker followed by the base64 (no padding) of:
+//   opcode    uint16, bit 15 set for M else G, bits 12-14 subcode, bits 0-11 the code number
+//   nwords    uint8, at most max_word_values
+//   words     a header byte, bits 0-4 the letter - 'A', bits 5-6 the type of the value that follows:
+//             0 float, 1 int16 in 1/1000, 2 int24 in 1/1000, 3 int16
+//   crc       uint16, CRC-16/CCITT of all the above
+// everything little endian. The words are decoded straight into the word table, the command string only holds
+// the letters, so only gcodes whose arguments are all numbers can be packed. See smoothie-pack.py
+// returns nullptr if the line is corrupt
+Gcode *Gcode::decode_packed(const char *line, StreamOutput *stream)
+{
+    uint8_t buf[2 + 1 + max_word_values * 5 + 2];
+    size_t n= 0;
+    uint32_t acc= 0;
+    int bits= 0;
+    for (const char *p = line + 1; *p && *p != '\n' && *p != '\r'; p++) {
+        int v= base64_value(*p);
+        if(v < 0) return nullptr;
+        acc= ((acc << 6) | v) & 0xFFFF;
+        bits += 6;
+        if(bits >= 8) {
+            if(n >= sizeof(buf)) return nullptr;
+            bits -= 8;
+            buf[n++]= acc >> bits;
+        }
     }
+
+    if(n < 5 || crc16_ccitt(buf, n - 2) != (buf[n - 2] | (buf[n - 1] << 8))) return nullptr;
+    n -= 2;
+
+    static const uint8_t value_size[4]= {4, 2, 3, 2};
+    size_t nwords= buf[2];
+    if(nwords > max_word_values) return nullptr;
+
+    uint32_t mask= 0;
+    char letters[max_word_values];
+    float values[max_word_values];
+    size_t i= 3;
+    for (size_t w = 0; w < nwords; w++) {
+        if(i >= n) return nullptr;
+        uint8_t h= buf[i++];
+        uint8_t l= h & 0x1F;
+        uint8_t type= (h >> 5) & 3;
+        if(l >= 26 || (h & 0x80) || (mask & (1UL << l)) || i + value_size[type] > n) return nullptr;
+
+        const uint8_t *b= &buf[i];
+        switch(type) {
+            case 0: memcpy(&values[w], b, 4); break;
+            case 1: values[w]= (int16_t)(b[0] | (b[1] << 8)) / 1000.0F; break;
+            case 2: values[w]= ((int32_t)(((uint32_t)b[0] << 8) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 24)) >> 8) / 1000.0F; break;
+            case 3: values[w]= (int16_t)(b[0] | (b[1] << 8)); break;
+        }
+        i += value_size[type];
+        letters[w]= l;
+        mask |= 1UL << l;
+    }
+    if(i != n) return nullptr;
+
+    Gcode *gc= new Gcode();
+    uint16_t op= buf[0] | (buf[1] << 8);
+    gc->has_m= (op & 0x8000) != 0;
+    gc->has_g= !gc->has_m;
+    if(gc->has_m) gc->m= op & 0x0FFF;
+    else gc->g= op & 0x0FFF;
+    gc->subcode= (op >> 12) & 7;
+    gc->stream= stream;
+    for (size_t w = 0; w < nwords; w++) {
+        gc->insert_word(1UL << letters[w], values[w], w);
+    }
+    gc->letter_mask= mask;
+    gc->build_packed_command();
+    return gc;
+}
+
+// a packed gcode has no command text, just list the letters so the string based accessors still see them
+void Gcode::build_packed_command()
+{
+    char buf[max_word_values * 2 + 1];
+    char *p= buf;
+    for (int l = 0; l < 26; l++) {
+        if(letter_mask & (1UL << l)) {
+            if(p != buf) *p++= ' ';
+            *p++= 'A' + l;
+        }
+    }
+    *p= '\0';
+    CommandPool::free(command);
+    command= CommandPool::dup(buf);
 }
 
 // strip off X Y Z I J K parameters if G0/1/2/3
 void Gcode::strip_parameters()
 {
-    if(has_g && g < 4){
+    if(has_g && g < 4 && packed) {
+        // just drop the words from the table
+        static const uint32_t xyzijk= (1UL << ('X'-'A')) | (1UL << ('Y'-'A')) | (1UL << ('Z'-'A')) | (1UL << ('I'-'A')) | (1UL << ('J'-'A')) | (1UL << ('K'-'A'));
+        int j= 0;
+        for (int l = 0, i = 0; l < 26; l++) {
+            uint32_t bit= 1UL << l;
+            if(!(value_mask & bit)) continue;
+            if(!(xyzijk & bit)) word_values[j++]= word_values[i];
+            i++;
+        }
+        value_mask &= ~xyzijk;
+        letter_mask &= ~xyzijk;
+        build_packed_command();
+
+    }else if(has_g && g < 4){
         // strip the command of the XYZIJK parameters
         string newcmd;
         char *cn= command;
@@ -235,8 +482,9 @@ void Gcode::strip_parameters()
         //newcmd.erase(std::remove_if(newcmd.begin(), newcmd.end(), ::isspace), newcmd.end());
 
         // release the old one
-        free(command);
+        CommandPool::free(command);
         // copy the new shortened one
-        command= strdup(newcmd.c_str());
+        command= CommandPool::dup(newcmd.data(), newcmd.size());
+        parse_words();
     }
 }
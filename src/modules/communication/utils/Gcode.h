@@ -10,6 +10,7 @@
 #define GCODE_H
 #include <string>
 #include <map>
+#include <stdint.h>
 
 using std::string;
 
@@ -19,6 +20,8 @@ class StreamOutput;
 class Gcode {
     public:
         Gcode(const string&, StreamOutput*, bool strip=true);
+        // the command is the n characters at text, which need not be a string of their own
+        Gcode(const char *text, size_t n, StreamOutput*, bool strip=true);
         Gcode(const Gcode& to_copy);
         Gcode& operator= (const Gcode& to_copy);
         ~Gcode();
@@ -32,6 +35,12 @@ class Gcode {
         std::map<char,float> get_args() const;
         std::map<char,int> get_args_int() const;
         void strip_parameters();
+        // give the letter a value as if the command had it, false when the word table is full
+        bool set_value(char letter, float value);
+
+        // a line starting with packed_marker holds a packed (binary) gcode, see decode_packed()
+        static const char packed_marker= 0x01;
+        static Gcode *decode_packed(const char *line, StreamOutput *stream);
 
         // FIXME these should be private
         unsigned int m;
@@ -43,6 +52,7 @@ class Gcode {
             bool has_m:1;
             bool has_g:1;
             bool stripped:1;
+            bool packed:1;
             uint8_t subcode:3;
         };
 
@@ -50,7 +60,23 @@ class Gcode {
         string txt_after_ok;
 
     private:
+        Gcode();
         void prepare_cached_values(bool strip=true);
+        void parse_words();
+        void insert_word(uint32_t bit, float v, int nvalues);
+        void build_packed_command();
+        float scan_value(char letter, char **ptr) const;
         char *command;
+
+        // the words of the command are decoded once by parse_words() so lookups do not have to scan the string
+        // bit n of letter_mask is set if the letter 'A'+n appears anywhere in the command,
+        // bit n of value_mask is set if it is followed by a number, which is held in word_values (in letter order)
+        // bit n of nonint_mask is set if the integer value differs from the truncated float (eg 1E3 or a >24 bit integer)
+        static const int max_word_values= 8;
+        uint32_t letter_mask;
+        uint32_t value_mask;
+        uint32_t nonint_mask;
+        float word_values[max_word_values];
+        bool values_overflow; // set if there were more numbers than fit in word_values
 };
 #endif
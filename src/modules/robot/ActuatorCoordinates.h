@@ -8,6 +8,7 @@
 #ifndef ACTUATOR_COORDINATES_H
 #define ACTUATOR_COORDINATES_H
 #include <array>
+#include <stddef.h>
 
 #ifndef MAX_ROBOT_ACTUATORS
 #define MAX_ROBOT_ACTUATORS 3
@@ -18,4 +19,7 @@
 const size_t k_max_actuators = MAX_ROBOT_ACTUATORS;
 typedef struct std::array<float, k_max_actuators> ActuatorCoordinates;
 
+// actuators after those of the arm solution are the A, B and C axes, each driven directly in its own units
+const size_t k_max_extra_axes = (k_max_actuators > 3) ? k_max_actuators - 3 : 0;
+
 #endif
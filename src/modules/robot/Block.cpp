@@ -14,8 +14,10 @@
 #include "Planner.h"
 #include "Conveyor.h"
 #include "Gcode.h"
+#include "GcodePool.h"
 #include "libs/StreamOutputPool.h"
 #include "Stepper.h"
+#include "EventTrace.h"
 
 #include "mri.h"
 
@@ -29,17 +31,22 @@ using std::string;
 
 Block::Block()
 {
+    gcodes= nullptr;
     clear();
 }
 
 void Block::clear()
 {
-    //commands.clear();
-    //travel_distances.clear();
-    gcodes.clear();
-    std::vector<Gcode>().swap(gcodes); // this resizes the vector releasing its memory
+    // return the attached gcodes to the pool
+    if(gcodes != nullptr) {
+        THEKERNEL->conveyor->gcode_pool.release(gcodes);
+    }
+    gcodes= nullptr;
+    last_gcode= nullptr;
 
     this->steps.fill(0);
+    this->fx_step_ratio.fill(0);
+    this->microstep_shift.fill(0);
 
     steps_event_count   = 0;
     nominal_rate        = 0;
@@ -47,7 +54,7 @@ void Block::clear()
     millimeters         = 0.0F;
     entry_speed         = 0.0F;
     exit_speed          = 0.0F;
-    rate_delta          = 0.0F;
+    fx_rate_delta       = 0;
     acceleration        = 100.0F; // we don't want to get devide by zeroes if this is not set
     initial_rate        = -1;
     final_rate          = -1;
@@ -57,6 +64,12 @@ void Block::clear()
     recalculate_flag    = false;
     nominal_length_flag = false;
     max_entry_speed     = 0.0F;
+    junction_speed      = 0.0F;
+    max_speed           = 0.0F;
+    dwell_ms            = 0;
+    tag                 = 0;
+    seconds             = 0.0F;
+    jerk_ticks          = 0;
     is_ready            = false;
     times_taken         = 0;
 }
@@ -72,7 +85,7 @@ void Block::debug()
                                this->nominal_rate,
                                this->nominal_speed,
                                this->millimeters,
-                               this->rate_delta,
+                               this->rate_delta(),
                                this->accelerate_until,
                                this->decelerate_after,
                                this->initial_rate,
@@ -107,7 +120,7 @@ void Block::calculate_trapezoid( float entryspeed, float exitspeed )
     this->final_rate   = ceilf(this->nominal_rate * exitspeed  / this->nominal_speed);   // (step/s)
 
     // How many steps to accelerate and decelerate
-    float acceleration_per_second = this->rate_delta * THEKERNEL->acceleration_ticks_per_second; // ( step/s^2)
+    float acceleration_per_second = this->rate_delta() * THEKERNEL->acceleration_ticks_per_second; // ( step/s^2)
     int accelerate_steps = ceilf( this->estimate_acceleration_distance( this->initial_rate, this->nominal_rate, acceleration_per_second ) );
     int decelerate_steps = floorf( this->estimate_acceleration_distance( this->nominal_rate, this->final_rate,  -acceleration_per_second ) );
 
@@ -127,6 +140,59 @@ void Block::calculate_trapezoid( float entryspeed, float exitspeed )
     this->decelerate_after = accelerate_steps + plateau_steps;
 
     this->exit_speed = exitspeed;
+
+    this->seconds = trapezoid_seconds(acceleration_per_second);
+
+    if(this->jerk_ticks > 0) {
+        // the S-curve ramps between the same rates as the trapezoid, in the same time and over the same steps
+        float initial = this->initial_rate;
+        float peak = min((float)nominal_rate, sqrtf(initial * initial + 2.0F * acceleration_per_second * accelerate_until));
+        plan_s_ramp(this->accel_ramp, peak - initial);
+        plan_s_ramp(this->decel_ramp, max(0.0F, peak - this->final_rate));
+    }
+}
+
+// the ramp takes as long as the trapezoid one, so to get there with a limited jerk its acceleration peaks higher
+void Block::plan_s_ramp(s_ramp_t &ramp, float rate_change)
+{
+    ramp.fx_delta = lroundf(rate_change * (1 << fx_rate_shift));
+    ramp.ticks = min(65535L, lroundf(rate_change / this->rate_delta()));
+    ramp.jerk_ticks = min(this->jerk_ticks, (uint16_t)(ramp.ticks / 2));
+    if(ramp.ticks == 0) {
+        ramp.fx_accel = ramp.fx_half_jerk = 0;
+        return;
+    }
+    float accel = (float)ramp.fx_delta / (ramp.ticks - ramp.jerk_ticks);
+    ramp.fx_accel = lroundf(accel);
+    ramp.fx_half_jerk = (ramp.jerk_ticks > 0) ? lroundf(accel * 128.0F / ramp.jerk_ticks) : 0;
+}
+
+// The time the stepper takes for the trapezoid as planned, in steps and step rates so the rounding of the rates
+// and of the acceleration and deceleration points is included
+float Block::trapezoid_seconds(float acceleration_per_second) const
+{
+    if(acceleration_per_second <= 0.0F || nominal_rate == 0) return 0.0F;
+
+    float a = acceleration_per_second;
+    float initial = this->initial_rate, final = this->final_rate;
+    float peak = min((float)nominal_rate, sqrtf(initial * initial + 2.0F * a * accelerate_until));
+    float t = (peak - initial) / a;
+
+    // the rate reached while accelerating is held until decelerate_after, which the rounding of the rates can put a
+    // step past the end when the block runs at one speed throughout
+    float cruise_end = min((float)decelerate_after, (float)steps_event_count);
+    if(peak > 0.0F) t += (cruise_end - accelerate_until) / peak;
+
+    // decelerate to the final rate, and run at that for any steps left
+    float decelerate_steps = steps_event_count - cruise_end;
+    float to_final = (peak * peak - final * final) / (2.0F * a);
+    if(decelerate_steps <= to_final || final <= 0.0F) {
+        float end = sqrtf(max(0.0F, peak * peak - 2.0F * a * decelerate_steps));
+        t += (peak - end) / a;
+    } else {
+        t += (peak - final) / a + (decelerate_steps - to_final) / final;
+    }
+    return t;
 }
 
 // Calculates the distance (not time) it takes to accelerate from initial_rate to target_rate using the
@@ -234,11 +300,17 @@ float Block::max_exit_speed()
 }
 
 // Gcodes are attached to their respective blocks so that on_gcode_execute can be called with it
-void Block::append_gcode(Gcode* gcode)
+// the slot holds a copy of the gcode allocated by the Conveyor
+void Block::append_gcode(GcodeSlot* slot)
 {
-    Gcode new_gcode = *gcode;
-    new_gcode.strip_parameters(); // optimization to save memory we strip off the XYZIJK parameters from the saved command
-    gcodes.push_back(new_gcode);
+    slot->gcode()->strip_parameters(); // optimization to save memory we strip off the XYZIJK parameters from the saved command
+    slot->next= nullptr;
+    if(last_gcode == nullptr) {
+        gcodes= slot;
+    } else {
+        last_gcode->next= slot;
+    }
+    last_gcode= slot;
 }
 
 void Block::begin()
@@ -249,10 +321,11 @@ void Block::begin()
         __debugbreak();
 
     times_taken = -1;
+    EventTrace::record(EventTrace::BLOCK_BEGIN, THEKERNEL->conveyor->queue_depth());
 
     // execute all the gcodes related to this block
-    for(unsigned int index = 0; index < gcodes.size(); index++)
-        THEKERNEL->call_event(ON_GCODE_EXECUTE, &(gcodes[index]));
+    for(GcodeSlot *s = gcodes; s != nullptr; s = s->next)
+        THEKERNEL->call_event(ON_GCODE_EXECUTE, s->gcode());
 
 
     THEKERNEL->call_event(ON_BLOCK_BEGIN, this);
@@ -9,10 +9,11 @@
 #define BLOCK_H
 
 #include <vector>
-#include <bitset>
+#include <stdint.h>
 #include "ActuatorCoordinates.h"
 
 class Gcode;
+struct GcodeSlot;
 
 class Block {
     public:
@@ -26,10 +27,14 @@ class Block {
         float forward_pass(float next_entry_speed);
 
         float max_exit_speed();
+        float trapezoid_seconds(float acceleration_per_second) const;
+        struct s_ramp_t;
+        void plan_s_ramp(s_ramp_t &ramp, float rate_change);
 
         void debug();
 
-        void append_gcode(Gcode* gcode);
+        void append_gcode(GcodeSlot* slot);
+        bool has_gcodes() const { return gcodes != nullptr; }
 
         void take();
         void release();
@@ -40,33 +45,79 @@ class Block {
 
         void begin();
 
-        std::vector<Gcode> gcodes;
+        // gcodes attached to this block, held in slots of the Conveyor's GcodePool
+        GcodeSlot* gcodes;
+        GcodeSlot* last_gcode;
+
+        // an S-curve ramp of the rate, it takes the same ticks and steps as the trapezoid ramp it replaces
+        struct s_ramp_t {
+            uint16_t ticks;           // acceleration ticks the ramp takes
+            uint16_t jerk_ticks;      // ticks at each end over which the acceleration changes
+            uint32_t fx_delta;        // the change in rate, fixed point
+            uint32_t fx_accel;        // the peak change in rate per tick, fixed point
+            uint32_t fx_half_jerk;    // half the change of fx_accel per tick, with 8 more fractional bits
+            uint32_t delta(uint32_t k) const;
+        };
+
+        // step rates in the trapezoid generator are fixed point with this many fractional bits
+        static const uint32_t fx_rate_shift= 12;
+
+        // the rate the stepper adds for each acceleration tick, in steps/sec
+        float rate_delta() const { return (float)fx_rate_delta / (1 << fx_rate_shift); }
+        bool direction(size_t i) const { return (direction_bits >> i) & 1; }
 
+        // the queue is as deep as the RAM it has allows, so these are ordered to pack with no padding.
+        // What the Stepper steps through comes first, in steps and fixed point rates
         std::array<uint32_t, k_max_actuators> steps; // Number of steps for each axis for this block
+        std::array<uint32_t, k_max_actuators> fx_step_ratio; // steps_event_count / steps for each axis, 16.16 fixed point, so the Stepper does not divide when the block begins
+        std::array<uint8_t, k_max_actuators> microstep_shift; // each of the steps of an axis is 1 << this of its steps_per_mm, see StepperMotor::plan_microsteps
         uint32_t steps_event_count;  // Steps for the longest axis
         uint32_t nominal_rate;       // Nominal rate in steps per second
-        float nominal_speed;      // Nominal speed in mm per second
-        float millimeters;        // Distance for this move
-        float entry_speed;
-        float exit_speed;
-        float rate_delta;         // Number of steps to add to the speed for each acceleration tick
-        float acceleration;       // the acceleratoin for this block
         uint32_t initial_rate;       // Initial speed in steps per second
         uint32_t final_rate;         // Final speed in steps per second
         uint32_t accelerate_until;   // Stop accelerating after this number of steps
         uint32_t decelerate_after;   // Start decelerating after this number of steps
-
-        float max_entry_speed;
-
+        uint32_t fx_rate_delta;      // Steps/sec to add to the rate for each acceleration tick, with fx_rate_shift fractional bits
+        uint32_t dwell_ms;           // a block without moves is held for this long, a queued G4
+        uint32_t tag;                // Conveyor::set_block_tag() when it was queued, the Player journal puts its line in it
+        s_ramp_t accel_ramp;         // from the initial rate, the deceleration ramp starts from where it gets to
+        s_ramp_t decel_ramp;
+        uint16_t jerk_ticks;         // ticks the acceleration takes to get to full with an S-curve, 0 for a trapezoid
         int16_t times_taken;    // A block can be "taken" by any number of modules, and the next block is not moved to until all the modules have "released" it. This value serves as a tracker.
-
-        std::bitset<k_max_actuators> direction_bits;     // Direction for each axis in bit form, relative to the direction port's mask
+        uint16_t direction_bits;     // Bit n set if actuator n moves backwards, relative to the direction port's mask
         struct {
             bool recalculate_flag:1;             // Planner flag to recalculate trapezoids on entry junction
             bool nominal_length_flag:1;          // Planner flag for nominal speed always reached
             bool is_ready:1;
         };
+
+        // then what only the Planner uses, in mm and mm/s
+        float nominal_speed;      // Nominal speed in mm per second
+        float millimeters;        // Distance for this move
+        float entry_speed;
+        float exit_speed;
+        float acceleration;       // the acceleratoin for this block
+        float max_entry_speed;
+        float junction_speed;     // the cornering limit on max_entry_speed before the nominal speeds count, 0 if it is held to the minimum planner speed
+        float max_speed;          // the fastest the axis and actuator limits let it go, a speed override can not take it past this
+        float seconds;            // how long the trapezoid takes to step, set by calculate_trapezoid
 };
 
+// the change in rate k ticks into the ramp, the acceleration goes up over jerk_ticks, holds, and comes down over jerk_ticks
+inline uint32_t Block::s_ramp_t::delta(uint32_t k) const
+{
+    if(k >= ticks) return fx_delta;
+    if(k <= jerk_ticks) return ((uint64_t)fx_half_jerk * k * k) >> 8;
+    uint32_t m= ticks - k;
+    if(m <= jerk_ticks) {
+        uint32_t d= ((uint64_t)fx_half_jerk * m * m) >> 8;
+        return d < fx_delta ? fx_delta - d : 0;
+    }
+    uint32_t d= ((uint64_t)fx_accel * (2 * k - jerk_ticks)) >> 1;
+    return d < fx_delta ? d : fx_delta;
+}
+
+
+static_assert(k_max_actuators <= 16, "Block::direction_bits has a bit for each actuator");
 
 #endif
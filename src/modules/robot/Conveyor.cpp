@@ -10,6 +10,7 @@ using namespace std;
 #include "libs/nuts_bolts.h"
 #include "libs/RingBuffer.h"
 #include "../communication/utils/Gcode.h"
+#include "../communication/utils/CommandPool.h"
 #include "libs/Module.h"
 #include "libs/Kernel.h"
 #include "Timer.h" // mbed.h lib
@@ -22,8 +23,19 @@ using namespace std;
 #include "Config.h"
 #include "libs/StreamOutputPool.h"
 #include "ConfigValue.h"
+#include "StreamOutput.h"
+#include "platform_memory.h"
+#include "cmsis.h"
+#include "us_ticker_api.h"
+#include "LatencyStats.h"
+#include "EventTrace.h"
+
+#include <stdint.h>
 
 #define planner_queue_size_checksum CHECKSUM("planner_queue_size")
+#define planner_gcode_slots_checksum CHECKSUM("planner_gcode_slots")
+#define planner_queue_memory_checksum CHECKSUM("planner_queue_memory")
+#define planner_queue_low_watermark_checksum CHECKSUM("planner_queue_low_watermark")
 
 /*
  * The conveyor holds the queue of blocks, takes care of creating them, and starting the executing chain of blocks
@@ -57,12 +69,21 @@ Conveyor::Conveyor(){
     running = false;
     flush = false;
     halted= false;
+    gated= false;
+    low_watermark= 0;
+    block_tag= 0;
+    reset_queue_stats();
 }
 
 void Conveyor::on_module_loaded(){
     register_for_event(ON_IDLE);
     register_for_event(ON_MAIN_LOOP);
     register_for_event(ON_HALT);
+    // queues the blocks
+    set_event_priority(ON_IDLE, PRIORITY_FEED);
+    set_event_priority(ON_MAIN_LOOP, PRIORITY_FEED);
+    // the queue is run from the main loop until it is empty
+    THEKERNEL->add_busy_check([this]() { return !queue.is_empty() || queue.head_ref()->has_gcodes(); });
 
     on_config_reload(this);
 }
@@ -79,17 +100,20 @@ void Conveyor::on_halt(void* argument){
 // Delete blocks here, because they can't be deleted in interrupt context ( see Block.cpp:release )
 // note that blocks get cleaned as they come off the tail, so head ALWAYS points to a cleaned block.
 void Conveyor::on_idle(void* argument){
-    if (queue.tail_i != gc_pending)
-    {
+    free_finished_blocks();
+}
+
+// Cleanly delete all the blocks that have finished since the last pass, not just one, so when the main loop is slow
+// to come round they do not pile up between tail and gc_pending and make the queue look full when it is not
+void Conveyor::free_finished_blocks()
+{
+    while (queue.tail_i != gc_pending) {
         if (queue.is_empty()) {
             __debugbreak();
-        }else{
-            // Cleanly delete block
-            Block* block = queue.tail_ref();
-//             block->debug();
-            block->clear();
-            queue.consume_tail();
+            return;
         }
+        queue.tail_ref()->clear();
+        queue.consume_tail();
     }
 }
 
@@ -118,7 +142,7 @@ void Conveyor::on_main_loop(void*)
 
     if (queue.is_empty())
     {
-        if (queue.head_ref()->gcodes.size())
+        if (queue.head_ref()->has_gcodes())
         {
             queue_head_block();
             ensure_running();
@@ -131,12 +155,36 @@ void Conveyor::on_main_loop(void*)
 
 void Conveyor::on_config_reload(void* argument)
 {
-    queue.resize(THEKERNEL->config->value(planner_queue_size_checksum)->by_default(32)->as_number());
+    unsigned int size= THEKERNEL->config->value(planner_queue_size_checksum)->by_default(32)->as_number();
+    string memory= THEKERNEL->config->value(planner_queue_memory_checksum)->by_default("sram")->as_string();
+
+    // the queue can be put in one of the AHB banks to free up the main heap, if that fails it goes on the heap
+    if(!allocate_queue(size, memory)) {
+        queue.resize(size);
+    }
+
+    low_watermark= THEKERNEL->config->value(planner_queue_low_watermark_checksum)->by_default((int)size / 2)->as_number();
+
+    // we need at least one slot or append_gcode() would wait forever
+    gcode_pool.resize(std::max(1, THEKERNEL->config->value(planner_gcode_slots_checksum)->by_default(32)->as_int()));
+
+    // the command strings of the attached gcodes, and a few more for the lines being handled
+    CommandPool::resize(gcode_pool.get_size() + 8);
 }
 
 void Conveyor::append_gcode(Gcode* gcode)
 {
-    queue.head_ref()->append_gcode(gcode);
+    // wait for a free gcode slot, they are returned as finished blocks are cleaned up in on_idle
+    while (gcode_pool.is_full()) {
+        if (queue.is_empty()) {
+            // all the slots are attached to the head block, so push it so they get executed and released
+            queue_head_block();
+        }
+        ensure_running();
+        THEKERNEL->call_event(ON_IDLE, this);
+    }
+
+    queue.head_ref()->append_gcode(gcode_pool.alloc(*gcode));
 }
 
 // Process a new block in the queue
@@ -152,8 +200,26 @@ void Conveyor::on_block_end(void* block)
         while (gc_pending != queue.head_i) {
             gc_pending = queue.next(gc_pending);
         }
+
+    }else{
+        // record how many blocks were waiting when this one finished, if none the queue ran dry
+        // NOTE the last block of every job also counts as an underrun
+        unsigned int depth= queue_depth();
+        queue_stats.samples++;
+        queue_stats.total += depth;
+        if(depth < queue_stats.min) queue_stats.min= depth;
+        if(depth > queue_stats.max) queue_stats.max= depth;
+        if(depth == 0) {
+            queue_stats.underruns++;
+            // it is only starved if there was more to come, otherwise the job is done
+            if(THEKERNEL->is_input_pending()) {
+                THEKERNEL->latency->starved(THEKERNEL->get_running_event(), THEKERNEL->get_running_module());
+            }
+        }
     }
 
+    EventTrace::record(EventTrace::BLOCK_END, queue_depth());
+
     // Return if queue is empty
     if (gc_pending == queue.head_i)
     {
@@ -164,18 +230,73 @@ void Conveyor::on_block_end(void* block)
     // Get a new block
     Block* next = this->queue.item_ref(gc_pending);
 
-    next->begin();
+    begin_block(next);
+}
+
+// the gate can hold the block back, then it begins from open_gate() and the queue counts as running until then
+void Conveyor::begin_block(Block *block)
+{
+    if(begin_gate && !flush && !begin_gate()) {
+        gated= true;
+        return;
+    }
+    block->begin();
+}
+
+// called at the priority of PendSV or lower as the block begins from here
+void Conveyor::open_gate()
+{
+    __disable_irq();
+    bool was_gated= gated;
+    gated= false;
+    __enable_irq();
+    if(was_gated) queue.item_ref(gc_pending)->begin();
 }
 
-// Wait for the queue to be empty
+// Wait for the queue to be empty. The blocks finish in interrupts, so this sleeps until the next interrupt instead of
+// spinning on ON_IDLE, cleans up the blocks that finished itself, and only calls ON_IDLE every wait_idle_us for the
+// work that has to go on meanwhile, like reading the host streams and feeding the watchdog
 void Conveyor::wait_for_empty_queue()
 {
+    uint32_t idled= us_ticker_read();
     while (!queue.is_empty()) {
         ensure_running();
-        THEKERNEL->call_event(ON_IDLE, this);
+        free_finished_blocks();
+        if (queue.is_empty()) break;
+
+        if (us_ticker_read() - idled >= wait_idle_us) {
+            THEKERNEL->call_event(ON_IDLE, this);
+            idled= us_ticker_read();
+            continue;
+        }
+
+        // with the interrupts off a block that finishes after the check still wakes the WFI, it runs once they are on
+        __disable_irq();
+        if (queue.tail_i == gc_pending) __WFI();
+        __enable_irq();
     }
 }
 
+// returns true if the caller should act on the gcode now, false if it has been attached to the queue and the caller
+// acts on it when it gets on_gcode_execute. Only gcodes that have to happen with the machine stopped should drain the
+// queue as that forces the planner to decelerate to zero
+bool Conveyor::synchronize(Gcode *gcode, sync_t sync)
+{
+    switch(sync) {
+        case SYNC_NONE:
+            return true;
+
+        case SYNC_BLOCK:
+            append_gcode(gcode);
+            return false;
+
+        case SYNC_DRAIN:
+            wait_for_empty_queue();
+            return true;
+    }
+    return true;
+}
+
 /*
  * push the pre-prepared head block onto the queue
  */
@@ -184,6 +305,9 @@ void Conveyor::queue_head_block()
     // upstream caller will block on this until there is room in the queue
     while (queue.is_full()) {
         ensure_running();
+        // the blocks that are done make room at once, without waiting for an idle pass to come round
+        free_finished_blocks();
+        if (!queue.is_full()) break;
         THEKERNEL->call_event(ON_IDLE, this);
     }
 
@@ -194,19 +318,39 @@ void Conveyor::queue_head_block()
 
     }else{
         queue.head_ref()->ready();
+        queue.head_ref()->tag= block_tag;
+        for(auto& h : start_hooks) h();
         queue.produce_head();
+        EventTrace::record(EventTrace::BLOCK_QUEUED, queue_depth());
     }
 }
 
+/*
+ * queue a block that does not move but is held by the Stepper for ms, after the gcodes already attached to the head.
+ * the moves after it are planned while it waits, and the block before it decelerates to a stop as it has no speed.
+ */
+void Conveyor::queue_dwell(uint32_t ms)
+{
+    queue.head_ref()->dwell_ms= ms;
+    queue_head_block();
+    ensure_running();
+}
+
 void Conveyor::ensure_running()
 {
+    if (gated && flush) {
+        // a flush does not wait for the gate, the block begins now and is flushed like the rest
+        open_gate();
+        return;
+    }
+
     if (!running)
     {
         if (gc_pending == queue.head_i)
             return;
 
         running = true;
-        queue.item_ref(gc_pending)->begin();
+        begin_block(queue.item_ref(gc_pending));
     }
 }
 
@@ -227,6 +371,141 @@ void Conveyor::flush_queue()
     flush = false;
 }
 
+// use the given memory pool for the queue, returns false if it is not a pool or it does not fit
+bool Conveyor::allocate_queue(unsigned int size, const string& memory)
+{
+    MemoryPool *pool;
+    if(memory == "ahb0") pool= _AHB0;
+    else if(memory == "ahb1") pool= _AHB1;
+    else return false;
+
+    if(size == 0) return false;
+
+    Block *ring= new(*pool) Block[size];
+    if(ring == nullptr) {
+        THEKERNEL->streams->printf("WARNING: planner queue does not fit in %s, using the heap\n", memory.c_str());
+        return false;
+    }
+
+    if(!queue.provide(ring, size)) {
+        delete [] ring;
+        return false;
+    }
+
+    gc_pending= queue.tail_i;
+    return true;
+}
+
+const char *Conveyor::queue_memory()
+{
+    if(_AHB0->has(queue.ring)) return "ahb0";
+    if(_AHB1->has(queue.ring)) return "ahb1";
+    return "sram";
+}
+
+// Change the size of the queue without a reset, like planner_queue_size and planner_queue_memory do at boot. The
+// queue is run until it is empty first, the old ring is freed before the new one is allocated so it can take the
+// same room, and if the new one does not fit at all the old size is put back. An empty memory keeps the one it is in
+bool Conveyor::resize_queue(unsigned int size, const string& memory, StreamOutput *stream)
+{
+    if(size < 2) {
+        stream->printf("error:the queue needs at least 1 block\n");
+        return false;
+    }
+    if(halted) {
+        stream->printf("error:not while halted\n");
+        return false;
+    }
+
+    if(queue.head_ref()->has_gcodes()) queue_head_block();
+    wait_for_empty_queue();
+
+    unsigned int old_size= queue.length;
+    string old_memory= queue_memory();
+    queue.resize(0);
+    if(!allocate_queue(size, memory.empty() ? old_memory : memory) && !queue.resize(size)) {
+        stream->printf("error:a queue of %u blocks does not fit, keeping %u\n", size - 1, old_size - 1);
+        if(!allocate_queue(old_size, old_memory)) queue.resize(old_size);
+    }
+    gc_pending= queue.tail_i;
+
+    // the config is gone by now, the watermark keeps the same share of the queue as it had
+    low_watermark= low_watermark * queue.length / old_size;
+    reset_queue_stats();
+    stream->printf("queue size: %u (%u bytes in %s)\n", queue.length - 1, queue.length * sizeof(Block), queue_memory());
+    return queue.length == size;
+}
+
+bool Conveyor::get_running_tag(uint32_t &tag)
+{
+    __disable_irq();
+    bool running= gc_pending != queue.head_i;
+    if(running) tag= queue.item_ref(gc_pending)->tag;
+    __enable_irq();
+    return running;
+}
+
+// the block queued to begin after the one that is running, nullptr if there is none yet, can be called from an ISR
+Block *Conveyor::get_next_block()
+{
+    unsigned int pending= gc_pending;
+    unsigned int head= queue.head_i;
+    if(pending == head || queue.next(pending) == head) return nullptr;
+    return queue.item_ref(queue.next(pending));
+}
+
+// number of blocks queued and not yet executed
+unsigned int Conveyor::queue_depth() const
+{
+    unsigned int head= queue.head_i;
+    unsigned int pending= gc_pending;
+    return (head >= pending) ? head - pending : head + queue.length - pending;
+}
+
+// how long the blocks in the queue take to run as they are planned now, the running block is counted in full
+float Conveyor::queued_seconds()
+{
+    float seconds= 0.0F;
+    for (unsigned int i = gc_pending; i != queue.head_i; i = queue.next(i)) {
+        Block *b= queue.item_ref(i);
+        seconds += (b->steps_event_count == 0) ? b->dwell_ms / 1000.0F : b->seconds;
+    }
+    return seconds;
+}
+
+void Conveyor::reset_queue_stats()
+{
+    __disable_irq();
+    queue_stats.samples= 0;
+    queue_stats.total= 0;
+    queue_stats.underruns= 0;
+    queue_stats.short_blocks= 0;
+    queue_stats.min= UINT16_MAX;
+    queue_stats.max= 0;
+    __enable_irq();
+}
+
+void Conveyor::print_queue_stats(StreamOutput *stream)
+{
+    __disable_irq();
+    uint32_t samples= queue_stats.samples;
+    uint32_t total= queue_stats.total;
+    uint32_t underruns= queue_stats.underruns;
+    uint16_t min= queue_stats.min;
+    uint16_t max= queue_stats.max;
+    unsigned int depth= queue_depth();
+    __enable_irq();
+
+    stream->printf("queue size: %u (%u bytes in %s), current: %u, ", queue.length - 1, queue.length * sizeof(Block), queue_memory(), depth);
+    if(samples == 0) {
+        stream->printf("min: -, avg: -, max: -, ");
+    }else{
+        stream->printf("min: %u, avg: %1.2f, max: %u, ", min, (float)total / samples, max);
+    }
+    stream->printf("underruns: %lu, blocks: %lu, gcode slots: %u/%u\n", underruns, samples, gcode_pool.get_used(), gcode_pool.get_size());
+    if(THEKERNEL->planner->get_min_block_seconds() > 0.0F) stream->printf("slowed to the minimum block time: %lu\n", queue_stats.short_blocks);
+}
+
 // Debug function
 void Conveyor::dump_queue()
 {
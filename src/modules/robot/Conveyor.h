@@ -10,13 +10,16 @@
 
 #include "libs/Module.h"
 #include "HeapRing.h"
+#include "GcodePool.h"
 
 using namespace std;
 #include <string>
 #include <vector>
+#include <functional>
 
 class Gcode;
 class Block;
+class StreamOutput;
 
 class Conveyor : public Module
 {
@@ -35,28 +38,80 @@ public:
     void wait_for_empty_queue();
     bool is_queue_empty() { return queue.is_empty(); };
     bool is_queue_full() { return queue.is_full(); };
+    // fewer blocks queued than planner_queue_low_watermark, the main loop then reads lines ahead of housekeeping
+    bool is_queue_low() const { return queue_depth() < low_watermark; }
 
     void ensure_running(void);
 
     void append_gcode(Gcode *);
     void queue_head_block(void);
+    void queue_dwell(uint32_t ms);
+
+    // called in the main loop each time a block is queued, before it can start, so keep them short
+    void add_start_hook(std::function<void(void)> cb) { start_hooks.push_back(cb); }
+
+    // asked before each block begins, while it returns false the block waits for open_gate(), a flush does not wait
+    void set_begin_gate(std::function<bool(void)> cb) { begin_gate= cb; }
+    void open_gate(void);
+    bool is_gated() const { return gated; }
+
+    // the tag the blocks queued from now on get, and the one of the block running, false when there is none
+    void set_block_tag(uint32_t tag) { block_tag= tag; }
+    bool get_running_tag(uint32_t &tag);
+
+    // how a gcode that is not a move has to be ordered with the moves queued before it
+    enum sync_t {
+        SYNC_NONE,      // does not depend on the moves, act on it now
+        SYNC_BLOCK,     // act on it at the next block boundary from on_gcode_execute, the moves carry on at speed
+        SYNC_DRAIN      // needs the machine to be stopped, act on it once the queue is empty
+    };
+    bool synchronize(Gcode *, sync_t);
 
     void dump_queue(void);
     void flush_queue(void);
+    void print_queue_stats(StreamOutput *);
+    bool resize_queue(unsigned int size, const string& memory, StreamOutput *);
+    void reset_queue_stats(void);
     bool is_flushing() const { return flush; }
+    unsigned int queue_depth(void) const;
+    Block *get_next_block(void);
+    float queued_seconds(void);
 
     friend class Planner; // for queue
+    friend class Block; // for gcode_pool
 
 private:
     typedef HeapRing<Block> Queue_t;
 
+    bool allocate_queue(unsigned int size, const string& memory);
+    const char *queue_memory(void);
+    void begin_block(Block *);
+    void free_finished_blocks(void);
+
     Queue_t queue;  // Queue of Blocks
+    GcodePool gcode_pool; // storage for the gcodes attached to the blocks in the queue
+    std::vector<std::function<void(void)>> start_hooks;
+    std::function<bool(void)> begin_gate;
     volatile unsigned int gc_pending;
+    uint32_t block_tag;
+    static const uint32_t wait_idle_us= 1000; // how often ON_IDLE is called while waiting for the queue to empty
+    unsigned int low_watermark;
+
+    // queue occupancy sampled each time a block finishes, in ISR context
+    struct {
+        volatile uint32_t samples;
+        volatile uint32_t total;
+        volatile uint32_t underruns;
+        uint32_t short_blocks;      // slowed by the planner to last planner_min_block_seconds
+        volatile uint16_t min;
+        volatile uint16_t max;
+    } queue_stats;
 
     struct {
         volatile bool running:1;
         volatile bool flush:1;
         volatile bool halted:1;
+        volatile bool gated:1;
     };
 
 };
@@ -0,0 +1,86 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GcodePool.h"
+
+#include "platform_memory.h"
+
+#include <new>
+#include <stdlib.h>
+
+GcodePool::GcodePool()
+{
+    slots= nullptr;
+    free_list= nullptr;
+    size= 0;
+    used= 0;
+}
+
+GcodePool::~GcodePool()
+{
+    free_memory();
+}
+
+void GcodePool::free_memory()
+{
+    if(slots == nullptr) return;
+
+    if(AHB0.has(slots)) AHB0.dealloc(slots);
+    else free(slots);
+    slots= nullptr;
+    free_list= nullptr;
+    size= 0;
+}
+
+bool GcodePool::resize(unsigned int n)
+{
+    if(used > 0) return false;
+
+    free_memory();
+    if(n == 0) return true;
+
+    // try to put it in AHB0 first and fall back to the heap, this is only done once at startup
+    size_t bytes= n * sizeof(GcodeSlot);
+    void *mem= AHB0.alloc(bytes);
+    if(mem == nullptr) mem= malloc(bytes);
+    if(mem == nullptr) return false;
+
+    slots= static_cast<GcodeSlot *>(mem);
+    size= n;
+
+    // chain all the slots into the free list
+    for (unsigned int i = 0; i < n; ++i) {
+        slots[i].next= (i+1 < n) ? &slots[i+1] : nullptr;
+    }
+    free_list= slots;
+
+    return true;
+}
+
+GcodeSlot *GcodePool::alloc(const Gcode &gcode)
+{
+    GcodeSlot *s= free_list;
+    if(s == nullptr) return nullptr;
+
+    free_list= s->next;
+    s->next= nullptr;
+    new(s->storage) Gcode(gcode);
+    used++;
+    return s;
+}
+
+void GcodePool::release(GcodeSlot *chain)
+{
+    while(chain != nullptr) {
+        GcodeSlot *next= chain->next;
+        chain->gcode()->~Gcode();
+        chain->next= free_list;
+        free_list= chain;
+        used--;
+        chain= next;
+    }
+}
@@ -0,0 +1,54 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GCODEPOOL_H
+#define GCODEPOOL_H
+
+#include "Gcode.h"
+
+#include <stdint.h>
+
+// one Gcode attached to a block, the gcodes of a block are chained in the order they were appended
+struct GcodeSlot {
+    GcodeSlot *next;
+    // the Gcode is constructed in here when the slot is allocated and destroyed when it is released
+    alignas(Gcode) uint8_t storage[sizeof(Gcode)];
+
+    Gcode *gcode() { return reinterpret_cast<Gcode *>(storage); }
+};
+
+// A fixed number of Gcode slots allocated once (from AHB0 if it fits), used to hold the gcodes attached to blocks
+// so that attaching and releasing them does not go through the heap.
+// NOTE only to be used from the main loop, never from ISR context
+class GcodePool {
+public:
+    GcodePool();
+    ~GcodePool();
+
+    // returns false if any slot is in use or there is not enough memory
+    bool resize(unsigned int n);
+
+    // copy the given gcode into a free slot, returns nullptr if there are none left
+    GcodeSlot *alloc(const Gcode &gcode);
+
+    // destroy the gcodes in the chain and return all of its slots to the free list
+    void release(GcodeSlot *chain);
+
+    bool is_full() const { return free_list == nullptr; }
+    unsigned int get_size() const { return size; }
+    unsigned int get_used() const { return used; }
+
+private:
+    void free_memory();
+
+    GcodeSlot *slots;
+    GcodeSlot *free_list;
+    unsigned int size;
+    unsigned int used;
+};
+
+#endif
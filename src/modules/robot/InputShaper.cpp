@@ -0,0 +1,177 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "InputShaper.h"
+
+#include "libs/Kernel.h"
+#include "Block.h"
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+// the longest the impulses can be spread over, as the history has to hold that many ticks
+#define MAX_HISTORY 1024
+
+InputShaper::InputShaper()
+{
+    history= nullptr;
+    mask= 0;
+    clear();
+}
+
+InputShaper::~InputShaper()
+{
+    delete [] history;
+}
+
+InputShaper::SHAPER_TYPE InputShaper::type_from_string(const char *name)
+{
+    if(strcasecmp(name, "zv") == 0) return ZV;
+    if(strcasecmp(name, "zvd") == 0) return ZVD;
+    if(strcasecmp(name, "mzv") == 0) return MZV;
+    return NONE;
+}
+
+// back to passing the speed through unchanged
+void InputShaper::clear()
+{
+    impulse_seconds[0]= 0.0F;
+    impulse_amplitudes[0]= 1.0F;
+    n_added= 1;
+    delays[0]= 0;
+    amplitudes[0]= fx_amplitude_one;
+    n_impulses= 1;
+    fx_um_per_step= fx_steps_per_um= fx_steps_per_um_tick= 0;
+    reset();
+}
+
+// convolves the shaper for a resonance at frequency Hz with the damping ratio given with the ones already added,
+// returns false if there would be too many impulses, or they would be spread over too long
+bool InputShaper::add(SHAPER_TYPE type, float frequency, float damping)
+{
+    if(type == NONE || frequency <= 0.0F || damping < 0.0F || damping >= 1.0F) return false;
+
+    float t[3], a[3];
+    int n;
+    float damped_period= 1.0F / (frequency * sqrtf(1.0F - damping * damping));
+    if(type == MZV) {
+        float k= expf(-0.75F * damping * M_PI / sqrtf(1.0F - damping * damping));
+        float a1= 1.0F - 1.0F / sqrtf(2.0F);
+        t[0]= 0.0F;                   a[0]= a1;
+        t[1]= 0.375F * damped_period; a[1]= (sqrtf(2.0F) - 1.0F) * k;
+        t[2]= 0.75F * damped_period;  a[2]= a1 * k * k;
+        n= 3;
+    } else {
+        float k= expf(-damping * M_PI / sqrtf(1.0F - damping * damping));
+        t[0]= 0.0F;                   a[0]= 1.0F;
+        t[1]= 0.5F * damped_period;   a[1]= (type == ZV) ? k : 2.0F * k;
+        t[2]= damped_period;          a[2]= k * k;
+        n= (type == ZV) ? 2 : 3;
+    }
+    float sum= 0.0F;
+    for (int i = 0; i < n; ++i) sum += a[i];
+
+    // every impulse already there is split into one for each new one, those that land on the same tick are merged
+    float ticks_per_second= THEKERNEL->acceleration_ticks_per_second;
+    float new_seconds[max_impulses], new_amplitudes[max_impulses];
+    int n_new= 0;
+    for (int i = 0; i < n_added; ++i) {
+        for (int j = 0; j < n; ++j) {
+            float s= impulse_seconds[i] + t[j];
+            int k= 0;
+            while(k < n_new && lroundf(new_seconds[k] * ticks_per_second) != lroundf(s * ticks_per_second)) ++k;
+            if(k == n_new) {
+                if(n_new == max_impulses) return false;
+                new_seconds[k]= s;
+                new_amplitudes[k]= 0.0F;
+                ++n_new;
+            }
+            new_amplitudes[k] += impulse_amplitudes[i] * a[j] / sum;
+        }
+    }
+    float longest= 0.0F;
+    for (int k = 0; k < n_new; ++k) longest= std::max(longest, new_seconds[k]);
+    uint32_t max_delay= lroundf(longest * ticks_per_second);
+    if(max_delay + 2 > MAX_HISTORY) return false;
+
+    memcpy(impulse_seconds, new_seconds, n_new * sizeof(float));
+    memcpy(impulse_amplitudes, new_amplitudes, n_new * sizeof(float));
+    n_added= n_new;
+
+    // round them to ticks and fixed point, the largest takes up the rounding so they add up to exactly one
+    uint32_t total= 0;
+    int largest= 0;
+    for (int k = 0; k < n_new; ++k) {
+        delays[k]= lroundf(new_seconds[k] * ticks_per_second);
+        amplitudes[k]= lroundf(new_amplitudes[k] * fx_amplitude_one);
+        total += amplitudes[k];
+        if(amplitudes[k] > amplitudes[largest]) largest= k;
+    }
+    amplitudes[largest] += fx_amplitude_one - total;
+    n_impulses= n_new;
+
+    // the history is a power of two long so it can wrap with a mask
+    uint32_t size= 2;
+    while(size < max_delay + 2) size <<= 1;
+    if(size - 1 != mask) {
+        delete [] history;
+        history= new uint32_t[size];
+        mask= size - 1;
+    }
+    reset();
+    return true;
+}
+
+// forget the speeds so far, the moves start from rest
+void InputShaper::reset()
+{
+    if(history != nullptr) memset(history, 0, (mask + 1) * sizeof(uint32_t));
+    head= 0;
+    shaped_um_s= 0;
+}
+
+// the speed along the path is kept in um/s, this sets how it converts to the rate of the main stepper of the block
+void InputShaper::begin_block(const Block *block)
+{
+    float steps_per_um= block->steps_event_count / (block->millimeters * 1000.0F);
+    fx_um_per_step= lroundf((1 << 16) / steps_per_um);
+    fx_steps_per_um= lroundf(steps_per_um * (1 << 24));
+    fx_steps_per_um_tick= llroundf(steps_per_um / THEKERNEL->acceleration_ticks_per_second * 4294967296.0F);
+}
+
+// adds one tick of the unshaped rate of the main stepper to the history, and returns the shaped rate
+uint32_t InputShaper::shape(uint32_t fx_rate)
+{
+    uint32_t um_s= ((uint64_t)fx_rate * fx_um_per_step) >> (16 + Block::fx_rate_shift);
+    uint32_t distance= history[head & mask] + um_s;
+    ++head;
+    history[head & mask]= distance;
+
+    uint64_t s= 0;
+    for (int i = 0; i < n_impulses; ++i) {
+        s += (uint64_t)amplitudes[i] * (at(delays[i]) - at(delays[i] + 1));
+    }
+    shaped_um_s= s >> 16;
+    return get_fx_rate();
+}
+
+// the shaped rate of the main stepper of the current block
+uint32_t InputShaper::get_fx_rate() const
+{
+    return ((uint64_t)shaped_um_s * fx_steps_per_um) >> (24 - Block::fx_rate_shift);
+}
+
+// how many steps of the current block the unshaped move is ahead of the shaped one
+uint32_t InputShaper::lag_steps() const
+{
+    uint64_t d= 0;
+    for (int i = 0; i < n_impulses; ++i) {
+        d += (uint64_t)amplitudes[i] * (at(0) - at(delays[i]));
+    }
+    return ((d >> 16) * fx_steps_per_um_tick) >> 32;
+}
@@ -0,0 +1,67 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INPUTSHAPER_H
+#define INPUTSHAPER_H
+
+#include <stdint.h>
+
+class Block;
+
+// Filters the speed along the path with a ZV, ZVD or MZV shaper so the moves do not excite the resonance of an axis.
+// The shaped speed is the sum of the unshaped speed delayed by each impulse of the shaper, times its amplitude.
+// The Stepper steps all axes from the one rate so the shaper works on the speed along the path: each axis that has one
+// configured adds its impulses by convolution, and the result cancels all of their resonances for every axis.
+// It runs on the acceleration tick, the impulses are rounded to ticks, and is fixed point like the Stepper.
+class InputShaper {
+    public:
+        InputShaper();
+        ~InputShaper();
+
+        enum SHAPER_TYPE { NONE, ZV, ZVD, MZV };
+        static SHAPER_TYPE type_from_string(const char *name);
+
+        void clear();
+        bool add(SHAPER_TYPE type, float frequency, float damping);
+        bool is_enabled() const { return n_impulses > 1; }
+        void reset();
+
+        // called from the acceleration tick and at the start of each block
+        void begin_block(const Block *block);
+        uint32_t shape(uint32_t fx_rate);
+        uint32_t get_fx_rate() const;
+        uint32_t lag_steps() const;
+
+    private:
+        static const int max_impulses= 27;           // a three impulse shaper on each of three axes
+        static const uint32_t fx_amplitude_one= 1 << 16;
+
+        uint32_t at(uint32_t ticks_ago) const { return history[(head - ticks_ago) & mask]; }
+
+        // the impulses of all the shapers added, in seconds, before they are rounded to ticks
+        float impulse_seconds[max_impulses];
+        float impulse_amplitudes[max_impulses];
+        uint8_t n_added;
+
+        // the impulses, delay in acceleration ticks and amplitude in 16 bit fixed point adding up to fx_amplitude_one
+        uint16_t delays[max_impulses];
+        uint32_t amplitudes[max_impulses];
+        uint8_t n_impulses;
+
+        // the unshaped distance along the path at each tick, in um/s * ticks so the difference of two is a speed
+        uint32_t *history;
+        uint32_t mask;
+        uint32_t head;
+        uint32_t shaped_um_s;                   // the last shaped speed
+
+        // conversions for the current block between the main stepper rate and the speed along the path
+        uint32_t fx_um_per_step;                // um per step, 16 fractional bits
+        uint32_t fx_steps_per_um;               // steps per um, 24 fractional bits
+        uint32_t fx_steps_per_um_tick;          // steps per um per acceleration tick, 32 fractional bits
+};
+
+#endif
@@ -31,14 +31,19 @@ using namespace std;
 #define junction_deviation_checksum    CHECKSUM("junction_deviation")
 #define z_junction_deviation_checksum  CHECKSUM("z_junction_deviation")
 #define minimum_planner_speed_checksum CHECKSUM("minimum_planner_speed")
+#define jerk_checksum                  CHECKSUM("jerk")
+#define planner_slowdown_seconds_checksum CHECKSUM("planner_slowdown_seconds")
+#define planner_min_block_seconds_checksum CHECKSUM("planner_min_block_seconds")
 
 // The Planner does the acceleration math for the queue of Blocks ( movements ).
 // It makes sure the speed stays within the configured constraints ( acceleration, junction_deviation, etc )
 // It goes over the list in both direction, every time a block is added, re-doing the math to make sure everything is optimal
+// It only goes back as far as the last block known to be optimal, so the cost does not depend on the queue depth
 
 Planner::Planner()
 {
     clear_vector_float(this->previous_unit_vec);
+    planned_i= 0;
     config_load();
 }
 
@@ -51,11 +56,15 @@ void Planner::config_load()
     this->junction_deviation = THEKERNEL->config->value(junction_deviation_checksum)->by_default(0.05F)->as_number();
     this->z_junction_deviation = THEKERNEL->config->value(z_junction_deviation_checksum)->by_default(-1)->as_number(); // disabled by default
     this->minimum_planner_speed = THEKERNEL->config->value(minimum_planner_speed_checksum)->by_default(0.0f)->as_number();
+    this->jerk = THEKERNEL->config->value(jerk_checksum)->by_default(0.0F)->as_number(); // mm/s^3, 0 is trapezoidal acceleration
+    this->min_block_seconds = THEKERNEL->config->value(planner_min_block_seconds_checksum)->by_default(0.0F)->as_number(); // disabled by default
+    this->slowdown_seconds = THEKERNEL->config->value(planner_slowdown_seconds_checksum)->by_default(0.0F)->as_number(); // disabled by default
 }
 
 
 // Append a block to the queue, compute it's speed factors
-void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s, float distance, float unit_vec[] )
+// max_rate_mm_s is as fast as the speed limits would let it go, a speed override can replan it up to that
+void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s, float distance, float unit_vec[], float max_rate_mm_s )
 {
     float acceleration, junction_deviation;
 
@@ -65,29 +74,55 @@ void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s,
 
     // Direction bits
     for (size_t i = 0; i < THEKERNEL->robot->actuators.size(); i++) {
-        int steps = THEKERNEL->robot->actuators[i]->steps_to_target(actuator_pos[i]);
+        StepperMotor *a = THEKERNEL->robot->actuators[i];
+        int32_t steps = a->steps_to_target(actuator_pos[i]);
+
+        // a motor that switches microsteps is stepped in the microsteps this block needs, and ends where they get to
+        uint8_t shift = a->get_microstep_shift();
+        if(a->has_microstep_switching() && steps != 0 && distance > 0.0F) {
+            shift = a->plan_microsteps(steps, rate_mm_s / distance);
+            // one that could not switch as coarse as it wanted is held to the rate it can be stepped at
+            float step_rate = (labs(steps) >> shift) * rate_mm_s / distance;
+            if(step_rate > THEKERNEL->base_stepping_frequency) rate_mm_s *= THEKERNEL->base_stepping_frequency / step_rate;
+        }
+        block->microstep_shift[i] = shift;
 
-        block->direction_bits[i] = (steps < 0) ? 1 : 0;
+        if(steps < 0) block->direction_bits |= 1 << i;
 
         // Update current position
-        THEKERNEL->robot->actuators[i]->last_milestone_steps += steps;
-        THEKERNEL->robot->actuators[i]->last_milestone_mm = actuator_pos[i];
+        a->last_milestone_steps += steps;
+        a->last_milestone_mm = actuator_pos[i];
 
-        block->steps[i] = labs(steps);
+        block->steps[i] = labs(steps) >> shift;
     }
 
     acceleration = this->acceleration;
     junction_deviation = this->junction_deviation;
 
     // use either regular acceleration or a z only move accleration
-    if(block->steps[ALPHA_STEPPER] == 0 && block->steps[BETA_STEPPER] == 0) {
+    if(block->steps[ALPHA_STEPPER] == 0 && block->steps[BETA_STEPPER] == 0 && block->steps[GAMMA_STEPPER] > 0) {
         // z only move
         if(this->z_acceleration > 0.0F) acceleration = this->z_acceleration;
         if(this->z_junction_deviation >= 0.0F) junction_deviation = this->z_junction_deviation;
     }
 
+    // no actuator may accelerate faster than its own limit, so the move accelerates as fast as its slowest actuator allows
+    if(distance > 0.0F) {
+        for (size_t i = 0; i < THEKERNEL->robot->actuators.size(); i++) {
+            float actuator_acceleration = THEKERNEL->robot->actuators[i]->get_acceleration();
+            if(actuator_acceleration <= 0.0F || block->steps[i] == 0) continue;
+            float actuator_mm = (block->steps[i] << block->microstep_shift[i]) / THEKERNEL->robot->actuators[i]->get_steps_per_mm();
+            if(acceleration * actuator_mm > actuator_acceleration * distance) {
+                acceleration = actuator_acceleration * distance / actuator_mm;
+            }
+        }
+    }
+
     block->acceleration = acceleration; // save in block
 
+    // with a jerk limit the acceleration ramps take this long to get to full acceleration
+    block->jerk_ticks = (this->jerk > 0.0F) ? min(65535L, lroundf(acceleration / this->jerk * THEKERNEL->acceleration_ticks_per_second)) : 0;
+
     // Max number of steps, for all axes
     uint32_t steps_event_count = 0;
     for (size_t s = 0; s < THEKERNEL->robot->actuators.size(); s++) {
@@ -95,8 +130,34 @@ void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s,
     }
     block->steps_event_count = steps_event_count;
 
+    // the Stepper scales the rate of the main stepper to each of the others by these
+    for (size_t s = 0; s < THEKERNEL->robot->actuators.size(); s++) {
+        if(block->steps[s] == 0) continue;
+        uint64_t ratio = ((uint64_t)steps_event_count << 16) / block->steps[s];
+        block->fx_step_ratio[s] = min(ratio, (uint64_t)0xFFFFFFFFULL);
+    }
+
     block->millimeters = distance;
 
+    // a block shorter than the main loop takes to queue the next would run the queue dry however full it is
+    if(distance > 0.0F && distance < rate_mm_s * this->min_block_seconds) {
+        rate_mm_s = distance / this->min_block_seconds;
+        ++THEKERNEL->conveyor->queue_stats.short_blocks;
+    }
+
+    // the moves are coming in slower than they run, so the queue is running dry and would stop at the end of it, as
+    // Marlin's SLOWDOWN each new move is made longer by the time missing shared over the moves queued, and the moves
+    // then run as fast as they come in
+    if(this->slowdown_seconds > 0.0F && distance > 0.0F && THEKERNEL->conveyor->running) {
+        unsigned int depth = THEKERNEL->conveyor->queue_depth();
+        if(depth > 1) {
+            float queued = THEKERNEL->conveyor->queued_seconds();
+            if(queued < this->slowdown_seconds) {
+                rate_mm_s = distance / (distance / rate_mm_s + (this->slowdown_seconds - queued) / depth);
+            }
+        }
+    }
+
     // Calculate speed in mm/sec for each axis. No divide by zero due to previous checks.
     // NOTE: Minimum stepper speed is limited by MINIMUM_STEPS_PER_MINUTE in stepper.c
     if( distance > 0.0F ) {
@@ -106,6 +167,7 @@ void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s,
         block->nominal_speed = 0.0F;
         block->nominal_rate  = 0;
     }
+    block->max_speed = max(block->nominal_speed, max_rate_mm_s);
 
     // Compute the acceleration rate for the trapezoid generator. Depending on the slope of the line
     // average travel per step event changes. For a line along one axis the travel per step event
@@ -114,7 +176,9 @@ void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s,
     // To generate trapezoids with contant acceleration between blocks the rate_delta must be computed
     // specifically for each line to compensate for this phenomenon:
     // Convert universal acceleration for direction-dependent stepper rate change parameter
-    block->rate_delta = (block->steps_event_count * acceleration) / (distance * THEKERNEL->acceleration_ticks_per_second); // (step/min/acceleration_tick)
+    // it is kept in the fixed point the stepper ramps the rate in, so the trapezoid is planned with the same rounding, and always moves
+    float rate_delta = (distance > 0.0F) ? (block->steps_event_count * acceleration) / (distance * THEKERNEL->acceleration_ticks_per_second) : 0.0F; // (step/min/acceleration_tick)
+    block->fx_rate_delta = max(1L, lroundf(rate_delta * (1 << Block::fx_rate_shift)));
 
     // Compute maximum allowable entry speed at junction by centripetal acceleration approximation.
     // Let a circle be tangent to both previous and current path line segments, where the junction
@@ -129,6 +193,25 @@ void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s,
     // NOTE however it does not take into account independent axis, in most cartesian X and Y and Z are totally independent
     // and this allows one to stop with little to no decleration in many cases. This is particualrly bad on leadscrew based systems that will skip steps.
     float vmax_junction = minimum_planner_speed; // Set default max junction speed
+    block->junction_speed = 0.0F;
+
+    // the extra axes are further directions of the move, so a change in how they move is a junction too
+    float move_vec[3 + k_max_extra_axes];
+    size_t n_vec = 3 + THEKERNEL->robot->get_extra_axes();
+    memset(move_vec, 0, sizeof(move_vec));
+    memcpy(move_vec, unit_vec, 3 * sizeof(float));
+    if(n_vec > 3 && distance > 0.0F) {
+        size_t first = THEKERNEL->robot->actuators.size() - (n_vec - 3);
+        for (size_t i = 3; i < n_vec; i++) {
+            StepperMotor *a = THEKERNEL->robot->actuators[first + i - 3];
+            float mm = (block->steps[first + i - 3] << block->microstep_shift[first + i - 3]) / a->get_steps_per_mm();
+            move_vec[i] = (block->direction(first + i - 3) ? -mm : mm) / distance;
+        }
+        float len2 = 0.0F;
+        for (size_t i = 0; i < n_vec; i++) len2 += move_vec[i] * move_vec[i];
+        float len = sqrtf(len2);
+        for (size_t i = 0; i < n_vec; i++) move_vec[i] /= len;
+    }
 
     if (!THEKERNEL->conveyor->is_queue_empty()) {
         float previous_nominal_speed = THEKERNEL->conveyor->queue.item_ref(THEKERNEL->conveyor->queue.prev(THEKERNEL->conveyor->queue.head_i))->nominal_speed;
@@ -136,18 +219,19 @@ void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s,
         if (previous_nominal_speed > 0.0F && junction_deviation > 0.0F) {
             // Compute cosine of angle between previous and current path. (prev_unit_vec is negative)
             // NOTE: Max junction velocity is computed without sin() or acos() by trig half angle identity.
-            float cos_theta = - this->previous_unit_vec[X_AXIS] * unit_vec[X_AXIS]
-                              - this->previous_unit_vec[Y_AXIS] * unit_vec[Y_AXIS]
-                              - this->previous_unit_vec[Z_AXIS] * unit_vec[Z_AXIS] ;
+            float cos_theta = 0.0F;
+            for (size_t i = 0; i < n_vec; i++) cos_theta -= this->previous_unit_vec[i] * move_vec[i];
 
             // Skip and use default max junction speed for 0 degree acute junction.
             if (cos_theta < 0.95F) {
                 vmax_junction = min(previous_nominal_speed, block->nominal_speed);
+                block->junction_speed = INFINITY;
                 // Skip and avoid divide by zero for straight junctions at 180 degrees. Limit to min() of nominal speeds.
                 if (cos_theta > -0.95F) {
                     // Compute maximum junction velocity based on maximum acceleration and junction deviation
                     float sin_theta_d2 = sqrtf(0.5F * (1.0F - cos_theta)); // Trig half angle identity. Always positive.
-                    vmax_junction = min(vmax_junction, sqrtf(acceleration * junction_deviation * sin_theta_d2 / (1.0F - sin_theta_d2)));
+                    block->junction_speed = sqrtf(acceleration * junction_deviation * sin_theta_d2 / (1.0F - sin_theta_d2));
+                    vmax_junction = min(vmax_junction, block->junction_speed);
                 }
             }
         }
@@ -173,7 +257,7 @@ void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s,
     block->recalculate_flag = true;
 
     // Update previous path unit_vector and nominal speed
-    memcpy(this->previous_unit_vec, unit_vec, sizeof(previous_unit_vec)); // previous_unit_vec[] = unit_vec[]
+    memcpy(this->previous_unit_vec, move_vec, sizeof(previous_unit_vec)); // previous_unit_vec[] = unit_vec[]
 
     // Math-heavy re-computing of the whole queue to take the new
     this->recalculate();
@@ -185,6 +269,12 @@ void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s,
 }
 
 void Planner::recalculate()
+{
+    recalculate(THEKERNEL->conveyor->queue.head_i);
+}
+
+// plans the queue up to the block at newest_i, which is the head when a block is being added
+void Planner::recalculate(unsigned int newest_i)
 {
     Conveyor::Queue_t &queue = THEKERNEL->conveyor->queue;
 
@@ -217,8 +307,18 @@ void Planner::recalculate()
      *     then we're accel limited. set recalculate to false, work out max exit speed
      *
      * finally, work out trapezoid for the final (and newest) block.
+     *
+     * as in newer grbl, planned_i marks the newest block that is already optimal: either it is accel limited, so none of
+     * the blocks before it can change, or it enters at its max entry speed which no new block can raise.
+     * the reverse pass stops there instead of walking all the way back to the tail.
      */
 
+    // the planned block may have been consumed since last time, its index is only valid between tail and the new head
+    unsigned int len= queue.length;
+    if ((planned_i + len - queue.tail_i) % len >= (newest_i + len - queue.tail_i) % len) {
+        planned_i= queue.tail_i;
+    }
+
     /*
      * Step 1:
      * For each block, given the exit speed and acceleration, find the maximum entry speed
@@ -226,11 +326,11 @@ void Planner::recalculate()
 
     float entry_speed = minimum_planner_speed;
 
-    block_index = queue.head_i;
+    block_index = newest_i;
     current     = queue.item_ref(block_index);
 
     if (!queue.is_empty()) {
-        while ((block_index != queue.tail_i) && current->recalculate_flag) {
+        while ((block_index != planned_i) && current->recalculate_flag) {
             entry_speed = current->reverse_pass(entry_speed);
 
             block_index = queue.prev(block_index);
@@ -239,7 +339,7 @@ void Planner::recalculate()
 
         /*
          * Step 2:
-         * now current points to either tail or first non-recalculate block
+         * now current points to either the planned block or first non-recalculate block
          * and has not had its reverse_pass called
          * or its calc trap
          * entry_speed is set to the *exit* speed of current.
@@ -248,7 +348,7 @@ void Planner::recalculate()
 
         float exit_speed = current->max_exit_speed();
 
-        while (block_index != queue.head_i) {
+        while (block_index != newest_i) {
             previous    = current;
             block_index = queue.next(block_index);
             current     = queue.item_ref(block_index);
@@ -258,6 +358,11 @@ void Planner::recalculate()
             exit_speed = current->forward_pass(exit_speed);
 
             previous->calculate_trapezoid(previous->entry_speed, current->entry_speed);
+
+            // if this block is accel limited or at its max entry speed, everything up to here is optimal
+            if (!current->recalculate_flag || current->entry_speed == current->max_entry_speed) {
+                planned_i= block_index;
+            }
         }
     }
 
@@ -271,6 +376,62 @@ void Planner::recalculate()
     current->calculate_trapezoid(current->entry_speed, minimum_planner_speed);
 }
 
+// replans the blocks already queued to go factor times as fast, as far as their speed limits let them, for M220.
+// The block being stepped can't be replanned, the Stepper slows it down from the next acceleration tick and says how
+// slow it can end, a speed up starts with the block after it. The blocks that follow may have to keep some of their
+// old speed, as with the acceleration they can only slow down so much so soon.
+void Planner::change_speed(float factor)
+{
+    Conveyor *conveyor = THEKERNEL->conveyor;
+    Conveyor::Queue_t &queue = conveyor->queue;
+
+    unsigned int first = conveyor->gc_pending;
+    if (first == queue.head_i || factor <= 0.0F) return;
+
+    // the fastest the running block may end at, each block after it can be made no slower than it could get down to
+    float exit2 = 0.0F;
+    float previous_nominal_speed = 0.0F;
+    Block *running = queue.item_ref(first);
+    if (running->times_taken != 0) {
+        if (factor < 1.0F) {
+            float end = THEKERNEL->stepper->limit_speed(factor);
+            if (end >= 0.0F && end < running->exit_speed) running->exit_speed = end;
+        }
+        exit2 = running->exit_speed * running->exit_speed;
+        previous_nominal_speed = running->nominal_speed;
+        first = queue.next(first);
+    }
+
+    for (unsigned int i = first; i != queue.head_i; i = queue.next(i)) {
+        Block *b = queue.item_ref(i);
+        float min_speed = sqrtf(exit2);
+        exit2 = max(0.0F, exit2 - 2.0F * b->acceleration * b->millimeters);
+        if (b->nominal_speed <= 0.0F || b->times_taken != 0) {
+            previous_nominal_speed = b->nominal_speed;
+            continue;
+        }
+
+        float speed = max(min(b->nominal_speed * factor, b->max_speed), min(b->nominal_speed, min_speed));
+        b->nominal_speed = speed;
+        b->nominal_rate = ceilf(b->steps_event_count * speed / b->millimeters);
+        b->nominal_length_flag = speed <= max_allowable_speed(-b->acceleration, minimum_planner_speed, b->millimeters);
+        b->recalculate_flag = true;
+
+        // the junction limit goes with the new nominal speeds of the blocks either side
+        if (b->junction_speed > 0.0F) {
+            b->max_entry_speed = min(b->junction_speed, min(previous_nominal_speed, speed));
+        }
+        // a block that starts from rest is not reverse planned, as it is where the planning starts from
+        if (i == conveyor->gc_pending) {
+            b->entry_speed = min(b->entry_speed, b->max_entry_speed);
+        }
+        previous_nominal_speed = speed;
+    }
+
+    planned_i = conveyor->gc_pending;
+    recalculate(queue.prev(queue.head_i));
+}
+
 
 // Calculates the maximum allowable speed at this point when you must be able to reach target_velocity using the
 // acceleration within the allotted distance.
@@ -15,24 +15,34 @@ class Planner
 {
 public:
     Planner();
-    void append_block(ActuatorCoordinates &target, float rate_mm_s, float distance, float unit_vec[] );
+    void append_block(ActuatorCoordinates &target, float rate_mm_s, float distance, float unit_vec[], float max_rate_mm_s= 0.0F );
     float max_allowable_speed( float acceleration, float target_velocity, float distance);
     void recalculate();
+    void change_speed(float factor);
     Block *get_current_block();
     void cleanup_queue();
     float get_acceleration() const { return acceleration; }
     float get_z_acceleration() const { return z_acceleration > 0.0F ? z_acceleration : acceleration; }
+    float get_junction_deviation() const { return junction_deviation; }
+    float get_z_junction_deviation() const { return z_junction_deviation; } // < 0 when the junction deviation is used
+    float get_minimum_planner_speed() const { return minimum_planner_speed; }
+    float get_min_block_seconds() const { return min_block_seconds; }
 
     friend class Robot; // for acceleration, junction deviation, minimum_planner_speed
 
 private:
     void config_load();
-    float previous_unit_vec[3];
+    void recalculate(unsigned int newest_i);
+    float previous_unit_vec[3 + k_max_extra_axes]; // with the extra axes as further directions
+    unsigned int planned_i;      // index of the newest block whose entry speed can no longer improve, the reverse pass stops here
     float acceleration;          // Setting
     float z_acceleration;        // Setting
     float junction_deviation;    // Setting
     float z_junction_deviation;  // Setting
     float minimum_planner_speed; // Setting
+    float jerk;                  // Setting
+    float min_block_seconds;     // Setting, no block is planned to take less, 0 for none
+    float slowdown_seconds;      // Setting, with less than this queued a move is slowed so the queue lasts, 0 never
 };
 
 
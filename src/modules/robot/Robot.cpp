@@ -16,6 +16,7 @@ using std::string;
 
 #include "Planner.h"
 #include "Conveyor.h"
+#include "Stepper.h"
 #include "Robot.h"
 #include "nuts_bolts.h"
 #include "Pin.h"
@@ -34,23 +35,30 @@ using std::string;
 #include "StepTicker.h"
 #include "checksumm.h"
 #include "utils.h"
+#include "FixedFormat.h"
 #include "ConfigValue.h"
 #include "libs/StreamOutput.h"
 #include "StreamOutputPool.h"
 #include "ExtruderPublicAccess.h"
 #include "GcodeDispatch.h"
+#include "SerialMessage.h"
 
 
 #define  default_seek_rate_checksum          CHECKSUM("default_seek_rate")
 #define  default_feed_rate_checksum          CHECKSUM("default_feed_rate")
+#define  jog_queue_depth_checksum            CHECKSUM("jog_queue_depth")
 #define  mm_per_line_segment_checksum        CHECKSUM("mm_per_line_segment")
 #define  delta_segments_per_second_checksum  CHECKSUM("delta_segments_per_second")
 #define  mm_per_arc_segment_checksum         CHECKSUM("mm_per_arc_segment")
 #define  arc_correction_checksum             CHECKSUM("arc_correction")
+#define  mm_max_arc_error_checksum           CHECKSUM("mm_max_arc_error")
 #define  x_axis_max_speed_checksum           CHECKSUM("x_axis_max_speed")
 #define  y_axis_max_speed_checksum           CHECKSUM("y_axis_max_speed")
 #define  z_axis_max_speed_checksum           CHECKSUM("z_axis_max_speed")
 #define  segment_z_moves_checksum            CHECKSUM("segment_z_moves")
+#define  collinear_merge_tolerance_checksum  CHECKSUM("collinear_merge_tolerance")
+#define  collinear_merge_max_length_checksum CHECKSUM("collinear_merge_max_length")
+#define  position_report_rate_checksum       CHECKSUM("position_report_rate")
 
 // arm solutions
 #define  arm_solution_checksum               CHECKSUM("arm_solution")
@@ -89,6 +97,7 @@ using std::string;
 #define MOTION_MODE_CW_ARC 2 // G2
 #define MOTION_MODE_CCW_ARC 3 // G3
 #define MOTION_MODE_CANCEL 4 // G80
+#define MOTION_MODE_BEZIER 5 // G5, G5.1
 
 #define PATH_CONTROL_MODE_EXACT_PATH 0
 #define PATH_CONTROL_MODE_EXACT_STOP 1
@@ -111,34 +120,160 @@ Robot::Robot()
     this->inch_mode = false;
     this->absolute_mode = true;
     this->motion_mode =  MOTION_MODE_SEEK;
+    this->jogging= false;
+    this->jog_cancel= false;
+    this->jog_hold= false;
     this->select_plane(X_AXIS, Y_AXIS, Z_AXIS);
     clear_vector(this->last_milestone);
     clear_vector(this->last_machine_position);
     this->arm_solution = NULL;
     seconds_per_minute = 60.0F;
     this->clearToolOffset();
+    this->zhop= this->zhop_applied= 0.0F;
     this->compensationTransform = nullptr;
     this->wcs_offsets.fill(wcs_t(0.0F, 0.0F, 0.0F));
     this->g92_offset = wcs_t(0.0F, 0.0F, 0.0F);
     this->next_command_is_MCS = false;
     this->disable_segmentation= false;
+    this->merge_pending= false;
+    this->pending_gcode= nullptr;
+    this->n_extra_axes= 0;
+    this->extra_moving= false;
+    this->e_absolute= true;
+    this->extra_letter.fill('A');
+    this->extra_requested.fill(0.0F);
+    this->extra_scale.fill(1.0F);
+    this->extra_milestone.fill(0.0F);
+    this->extra_start.fill(0.0F);
+    this->extra_delta.fill(0.0F);
+    this->extra_move_mm= 0.0F;
+    this->extra_move_done= 0.0F;
 }
 
 //Called when the module has just been loaded
 void Robot::on_module_loaded()
 {
     this->register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_event(ON_IDLE);
+    this->register_for_event(ON_HALT);
+    this->register_for_event(ON_MAIN_LOOP);
+    this->set_event_rate(ON_MAIN_LOOP, 0, true); // only to cancel a jog
 
     // Configuration
     this->load_config();
 }
 
+// a merged move is only held back while the machine is busy with earlier moves
+void Robot::on_idle(void *argument)
+{
+    if(merge_pending && THEKERNEL->conveyor->is_queue_empty()) {
+        flush_pending_move();
+    }
+    if(jogging && !merge_pending && THEKERNEL->conveyor->is_queue_empty()) jogging= false;
+}
+
+// words like G91 G20 only apply to the jog, the move is queued as a G1 once there are fewer than jog_queue_depth blocks
+// ahead of it. waiting for that holds back the host, which is what keeps a jog from running on after it is let go
+bool Robot::jog(const char *line)
+{
+    bool relative= !this->absolute_mode, inches= this->inch_mode, mcs= false, has_f= false, has_axis= false;
+    char words[64]= "";
+    size_t n= 0;
+    for (const char *p= line; *p != '\0';) {
+        char c= toupper(*p++);
+        if(isspace(c)) continue;
+        char *end;
+        float v= strtof(p, &end);
+        if(end == p) return false;
+        p= end;
+        if(c == 'G') {
+            if(v == 90) relative= false;
+            else if(v == 91) relative= true;
+            else if(v == 20) inches= true;
+            else if(v == 21) inches= false;
+            else if(v == 53) mcs= true;
+            else return false;
+            continue;
+        }
+        if(strchr("XYZABCF", c) == nullptr || n >= sizeof(words) - 16) return false;
+        if(c == 'F') has_f= true;
+        else has_axis= true;
+        n += snprintf(words + n, sizeof(words) - n, " %c%1.4f", c, v);
+    }
+    if(!has_f || !has_axis) return false;
+
+    while(THEKERNEL->conveyor->queue_depth() >= this->jog_queue_depth) {
+        // one that came in before a cancel is dropped along with the rest
+        if(this->jog_cancel || THEKERNEL->is_halted()) return true;
+        THEKERNEL->call_event(ON_IDLE, this);
+    }
+    if(this->jog_cancel) return true;
+
+    char cmd[128];
+    snprintf(cmd, sizeof(cmd), "%s%s%sG1%s%s%s", inches != this->inch_mode ? (inches ? "G20 " : "G21 ") : "",
+             relative == this->absolute_mode ? (relative ? "G91 " : "G90 ") : "", mcs ? "G53 " : "", words,
+             relative == this->absolute_mode ? (relative ? " G90" : " G91") : "", inches != this->inch_mode ? (inches ? " G21" : " G20") : "");
+
+    int8_t mode= this->motion_mode;
+    this->jogging= true;
+    struct SerialMessage message;
+    message.message = cmd;
+    message.stream = &(StreamOutput::NullStream);
+    THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
+    this->motion_mode= mode;
+    return true;
+}
+
+// the feed hold starts the motors slowing down from the next acceleration tick, the main loop then drops the jog
+void Robot::cancel_jog()
+{
+    if(!this->jogging || this->jog_cancel) return;
+    this->jog_cancel= true;
+    if(!THEKERNEL->get_feed_hold()) {
+        this->jog_hold= true;
+        THEKERNEL->set_feed_hold(true);
+    }
+    wake_for_event(ON_MAIN_LOOP);
+}
+
+// flushing the queue ramps down what is left of the moving block and drops the rest, we are where the motors stopped
+void Robot::on_main_loop(void *argument)
+{
+    if(!this->jog_cancel) return;
+
+    if(merge_pending) {
+        merge_pending= false;
+        delete pending_gcode;
+        pending_gcode= nullptr;
+    }
+    THEKERNEL->conveyor->flush_queue();
+    if(this->jog_hold) {
+        this->jog_hold= false;
+        THEKERNEL->set_feed_hold(false);
+    }
+    reset_position_from_current_actuator_position();
+    this->jogging= false;
+    this->jog_cancel= false;
+}
+
+void Robot::on_halt(void *argument)
+{
+    if(argument == nullptr && merge_pending) {
+        // drop the held back move, we are only where the last queued move took us
+        merge_pending= false;
+        memcpy(last_milestone, pending_start, sizeof(last_milestone));
+        delete pending_gcode;
+        pending_gcode= nullptr;
+    }
+}
+
 #define ACTUATOR_CHECKSUMS(X) {     \
     CHECKSUM(X "_step_pin"),        \
     CHECKSUM(X "_dir_pin"),         \
     CHECKSUM(X "_en_pin"),          \
     CHECKSUM(X "_steps_per_mm"),    \
-    CHECKSUM(X "_max_rate")         \
+    CHECKSUM(X "_max_rate"),        \
+    CHECKSUM(X "_acceleration")     \
 }
 
 void Robot::load_config()
@@ -176,11 +311,13 @@ void Robot::load_config()
     }
 
     this->feed_rate           = THEKERNEL->config->value(default_feed_rate_checksum   )->by_default(  100.0F)->as_number();
+    this->jog_queue_depth     = std::max(1, THEKERNEL->config->value(jog_queue_depth_checksum)->by_default(4)->as_int());
     this->seek_rate           = THEKERNEL->config->value(default_seek_rate_checksum   )->by_default(  100.0F)->as_number();
     this->mm_per_line_segment = THEKERNEL->config->value(mm_per_line_segment_checksum )->by_default(    0.0F)->as_number();
     this->delta_segments_per_second = THEKERNEL->config->value(delta_segments_per_second_checksum )->by_default(0.0f   )->as_number();
     this->mm_per_arc_segment  = THEKERNEL->config->value(mm_per_arc_segment_checksum  )->by_default(    0.5f)->as_number();
     this->arc_correction      = THEKERNEL->config->value(arc_correction_checksum      )->by_default(    5   )->as_number();
+    this->mm_max_arc_error    = THEKERNEL->config->value(mm_max_arc_error_checksum    )->by_default(    0.0F)->as_number();
 
     this->max_speeds[X_AXIS]  = THEKERNEL->config->value(x_axis_max_speed_checksum    )->by_default(60000.0F)->as_number() / 60.0F;
     this->max_speeds[Y_AXIS]  = THEKERNEL->config->value(y_axis_max_speed_checksum    )->by_default(60000.0F)->as_number() / 60.0F;
@@ -188,8 +325,17 @@ void Robot::load_config()
 
     this->segment_z_moves     = THEKERNEL->config->value(segment_z_moves_checksum     )->by_default(true)->as_bool();
 
+    // merging of collinear G0/G1 moves, disabled if the tolerance is 0
+    this->merge_tolerance     = THEKERNEL->config->value(collinear_merge_tolerance_checksum )->by_default(0.0F)->as_number();
+    this->merge_max_length    = THEKERNEL->config->value(collinear_merge_max_length_checksum)->by_default(5.0F)->as_number();
+
+    // while moving the real time position is worked out at most this often however often it is asked for, 0 for no limit
+    float report_rate         = THEKERNEL->config->value(position_report_rate_checksum)->by_default(50.0F)->as_number();
+    this->fk_cache.interval_us= report_rate > 0 ? 1000000 / report_rate : 0;
+    this->fk_cache.valid      = false;
+
     // Make our 3 StepperMotors
-    uint16_t const checksums[][5] = {
+    uint16_t const checksums[][6] = {
         ACTUATOR_CHECKSUMS("alpha"),
         ACTUATOR_CHECKSUMS("beta"),
         ACTUATOR_CHECKSUMS("gamma"),
@@ -202,16 +348,25 @@ void Robot::load_config()
     constexpr size_t actuator_checksum_count = sizeof(checksums) / sizeof(checksums[0]);
     static_assert(actuator_checksum_count >= k_max_actuators, "Robot checksum array too small for k_max_actuators");
 
+    // the actuators of the arm solution, then an A, B and C axis for each of the next ones that has a step pin
     size_t motor_count = std::min(this->arm_solution->get_actuator_count(), k_max_actuators);
-    for (size_t a = 0; a < motor_count; a++) {
+    actuators.clear();
+    this->n_extra_axes= 0;
+    for (size_t a = 0; a < k_max_actuators; a++) {
         Pin pins[3]; //step, dir, enable
         for (size_t i = 0; i < 3; i++) {
             pins[i].from_string(THEKERNEL->config->value(checksums[a][i])->by_default("nc")->as_string())->as_output();
         }
-        actuators[a] = new StepperMotor(pins[0], pins[1], pins[2]);
+        if(a >= motor_count) {
+            if(!pins[0].connected()) break;
+            this->extra_letter[n_extra_axes]= 'A' + n_extra_axes;
+            this->n_extra_axes++;
+        }
+        actuators.push_back(new StepperMotor(pins[0], pins[1], pins[2]));
 
         actuators[a]->change_steps_per_mm(THEKERNEL->config->value(checksums[a][3])->by_default(a == 2 ? 2560.0F : 80.0F)->as_number());
         actuators[a]->set_max_rate(THEKERNEL->config->value(checksums[a][4])->by_default(30000.0F)->as_number());
+        actuators[a]->set_acceleration(THEKERNEL->config->value(checksums[a][5])->by_default(0.0F)->as_number());
     }
 
     check_max_actuator_speeds(); // check the configs are sane
@@ -220,8 +375,9 @@ void Robot::load_config()
     // so the first move can be correct if homing is not performed
     ActuatorCoordinates actuator_pos;
     arm_solution->cartesian_to_actuator(last_milestone, actuator_pos);
-    for (size_t i = 0; i < actuators.size(); i++)
+    for (size_t i = 0; i < actuators.size() - n_extra_axes; i++)
         actuators[i]->change_last_milestone(actuator_pos[i]);
+    sync_extra_actuators();
 
     //this->clearToolOffset();
 }
@@ -247,6 +403,175 @@ void Robot::pop_state()
     }
 }
 
+// everything compiling a job can change, put back by end_recording()
+struct Robot::recording_state_t {
+    float last_milestone[3];
+    float last_machine_position[3];
+    float actuator_milestones[k_max_actuators];
+    std::array<float, k_max_extra_axes> extra_requested;
+    std::array<float, k_max_extra_axes> extra_milestone;
+    std::array<wcs_t, MAX_WCS> wcs_offsets;
+    wcs_t g92_offset;
+    float feed_rate;
+    float seek_rate;
+    uint8_t current_wcs;
+    bool inch_mode;
+    bool absolute_mode;
+    uint8_t plane_axis[3];
+};
+
+// Gcodes passed to on_gcode_received while recording are segmented as usual, but the segments are handed to the
+// recorder instead of being queued, and the actuators only keep track of the position
+void Robot::begin_recording(segment_recorder_t recorder)
+{
+    flush_pending_move();
+    if(recording_state == nullptr) recording_state= new recording_state_t;
+
+    recording_state_t *rs= recording_state;
+    memcpy(rs->last_milestone, last_milestone, sizeof(last_milestone));
+    memcpy(rs->last_machine_position, last_machine_position, sizeof(last_machine_position));
+    for (size_t i = 0; i < actuators.size(); i++)
+        rs->actuator_milestones[i]= actuators[i]->get_last_milestone();
+    rs->extra_requested= extra_requested;
+    rs->extra_milestone= extra_milestone;
+    rs->wcs_offsets= wcs_offsets;
+    rs->g92_offset= g92_offset;
+    rs->feed_rate= feed_rate;
+    rs->seek_rate= seek_rate;
+    rs->current_wcs= current_wcs;
+    rs->inch_mode= inch_mode;
+    rs->absolute_mode= absolute_mode;
+    rs->plane_axis[0]= plane_axis_0;
+    rs->plane_axis[1]= plane_axis_1;
+    rs->plane_axis[2]= plane_axis_2;
+
+    segment_recorder= recorder;
+}
+
+void Robot::end_recording()
+{
+    segment_recorder= nullptr;
+    if(recording_state == nullptr) return;
+
+    recording_state_t *rs= recording_state;
+    memcpy(last_milestone, rs->last_milestone, sizeof(last_milestone));
+    memcpy(last_machine_position, rs->last_machine_position, sizeof(last_machine_position));
+    for (size_t i = 0; i < actuators.size(); i++)
+        actuators[i]->last_milestone_mm= rs->actuator_milestones[i];
+    extra_requested= rs->extra_requested;
+    extra_milestone= rs->extra_milestone;
+    extra_start= extra_milestone;
+    wcs_offsets= rs->wcs_offsets;
+    g92_offset= rs->g92_offset;
+    feed_rate= rs->feed_rate;
+    seek_rate= rs->seek_rate;
+    current_wcs= rs->current_wcs;
+    inch_mode= rs->inch_mode;
+    absolute_mode= rs->absolute_mode;
+    select_plane(rs->plane_axis[0], rs->plane_axis[1], rs->plane_axis[2]);
+    next_command_is_MCS= false;
+
+    delete recording_state;
+    recording_state= nullptr;
+}
+
+static uint32_t hash_wcs(uint32_t h, const Robot::wcs_t &w)
+{
+    float v[3]{std::get<X_AXIS>(w), std::get<Y_AXIS>(w), std::get<Z_AXIS>(w)};
+    return fnv1a(v, sizeof(v), h);
+}
+
+// changes when anything that is used to turn gcode into segments changes, so a compiled job can tell it is out of date
+// The machine position from where the actuators are now. FK is costly on a delta or SCARA and the hosts poll for it,
+// so while moving the last result is used again while the actuators have not stepped, or while it is less than
+// 1/position_report_rate old, along with the actuator positions it came from. Once the queue is empty it is always
+// worked out, so the kinematics may change and the position after the moves is exact
+void Robot::get_realtime_position(float mpos[3], ActuatorCoordinates *apos)
+{
+    ActuatorCoordinates current_position{
+        actuators[X_AXIS]->get_current_position(),
+        actuators[Y_AXIS]->get_current_position(),
+        actuators[Z_AXIS]->get_current_position()
+    };
+
+    uint32_t now= us_ticker_read();
+    if(fk_cache.valid && !THEKERNEL->conveyor->is_queue_empty()) {
+        bool same= true;
+        for (int i = X_AXIS; i <= Z_AXIS; i++) {
+            if(current_position[i] != fk_cache.apos[i]) same= false;
+        }
+        if(same || now - fk_cache.us < fk_cache.interval_us) {
+            memcpy(mpos, fk_cache.mpos, sizeof(fk_cache.mpos));
+            if(apos != nullptr) *apos= fk_cache.apos;
+            return;
+        }
+    }
+
+    arm_solution->actuator_to_cartesian(current_position, mpos);
+    memcpy(fk_cache.mpos, mpos, sizeof(fk_cache.mpos));
+    fk_cache.apos= current_position;
+    fk_cache.us= now;
+    fk_cache.valid= true;
+    if(apos != nullptr) *apos= current_position;
+}
+
+uint32_t Robot::get_kinematics_hash() const
+{
+    // the arm solution and its geometry, found by converting a few positions
+    static const float test_points[][3]{{0.0F, 0.0F, 0.0F}, {10.5F, 21.25F, 30.125F}, {-40.75F, 15.5F, -5.25F}};
+    size_t n= actuators.size();
+    uint32_t h= fnv1a(&n, sizeof(n));
+    for(auto &p : test_points) {
+        ActuatorCoordinates ac;
+        arm_solution->cartesian_to_actuator(p, ac);
+        h= fnv1a(ac.data(), sizeof(float) * (n - n_extra_axes), h);
+    }
+    BaseSolution::arm_options_t options;
+    if(arm_solution->get_optional(options, true)) {
+        for(auto &i : options) {
+            h= fnv1a(&i.first, sizeof(i.first), h);
+            h= fnv1a(&i.second, sizeof(i.second), h);
+        }
+    }
+
+    // segmentation and speed limits
+    // the feed rates are not included, a compiled job keeps them in sync itself
+    float settings[]{mm_per_line_segment, mm_per_arc_segment, mm_max_arc_error, delta_segments_per_second, (float)arc_correction,
+        max_speeds[X_AXIS], max_speeds[Y_AXIS], max_speeds[Z_AXIS], seconds_per_minute};
+    h= fnv1a(settings, sizeof(settings), h);
+    for (size_t i = 0; i < n; i++) {
+        float r= actuators[i]->get_max_rate();
+        h= fnv1a(&r, sizeof(r), h);
+    }
+    uint8_t flags[]{segment_z_moves, disable_segmentation, compensationTransform != nullptr, inch_mode, absolute_mode,
+        plane_axis_0, plane_axis_1, plane_axis_2, current_wcs};
+    h= fnv1a(flags, sizeof(flags), h);
+
+    // offsets
+    for(auto &w : wcs_offsets) h= hash_wcs(h, w);
+    h= hash_wcs(h, g92_offset);
+    h= hash_wcs(h, tool_offset);
+
+    return h;
+}
+
+void Robot::get_motion_state(motion_state_t &ms) const
+{
+    memcpy(ms.last_milestone, last_milestone, sizeof(last_milestone));
+    memcpy(ms.last_machine_position, last_machine_position, sizeof(last_machine_position));
+    ms.feed_rate= feed_rate;
+    ms.seek_rate= seek_rate;
+}
+
+// the actuators are not touched, they are already where the queued blocks take them
+void Robot::set_motion_state(const motion_state_t &ms)
+{
+    memcpy(last_milestone, ms.last_milestone, sizeof(last_milestone));
+    memcpy(last_machine_position, ms.last_machine_position, sizeof(last_machine_position));
+    feed_rate= ms.feed_rate;
+    seek_rate= ms.seek_rate;
+}
+
 std::vector<Robot::wcs_t> Robot::get_wcs_state() const
 {
     std::vector<wcs_t> v;
@@ -259,50 +584,51 @@ std::vector<Robot::wcs_t> Robot::get_wcs_state() const
     return v;
 }
 
-int Robot::print_position(uint8_t subcode, char *buf, size_t bufsize) const
+int Robot::print_position(uint8_t subcode, char *buf, size_t bufsize)
 {
     // M114.1 is a new way to do this (similar to how GRBL does it).
     // it returns the realtime position based on the current step position of the actuators.
     // this does require a FK to get a machine position from the actuator position
     // and then invert all the transforms to get a workspace position from machine position
     // M114 just does it the old way uses last_milestone and does inversse transforms to get the requested position
-    int n = 0;
+    FixedFormat f(buf, bufsize);
+    float v[3];
     if(subcode == 0) { // M114 print WCS
         wcs_t pos= mcs2wcs(last_milestone);
-        n = snprintf(buf, bufsize, "C: X:%1.4f Y:%1.4f Z:%1.4f", from_millimeters(std::get<X_AXIS>(pos)), from_millimeters(std::get<Y_AXIS>(pos)), from_millimeters(std::get<Z_AXIS>(pos)));
+        v[X_AXIS]= from_millimeters(std::get<X_AXIS>(pos));
+        v[Y_AXIS]= from_millimeters(std::get<Y_AXIS>(pos));
+        v[Z_AXIS]= from_millimeters(std::get<Z_AXIS>(pos));
+        f.str("C: ").axes("XYZ", v, 3);
+        if(n_extra_axes > 0) f.str(" ").axes(extra_letter.data(), extra_requested.data(), n_extra_axes);
 
     } else if(subcode == 4) { // M114.3 print last milestone (which should be the same as machine position if axis are not moving and no level compensation)
-        n = snprintf(buf, bufsize, "LMS: X:%1.4f Y:%1.4f Z:%1.4f", last_milestone[X_AXIS], last_milestone[Y_AXIS], last_milestone[Z_AXIS]);
+        f.str("LMS: ").axes("XYZ", last_milestone, 3);
 
     } else if(subcode == 5) { // M114.4 print last machine position (which should be the same as M114.1 if axis are not moving and no level compensation)
-        n = snprintf(buf, bufsize, "LMP: X:%1.4f Y:%1.4f Z:%1.4f", last_machine_position[X_AXIS], last_machine_position[Y_AXIS], last_machine_position[Z_AXIS]);
+        f.str("LMP: ").axes("XYZ", last_machine_position, 3);
 
     } else {
-        // get real time positions
-        // current actuator position in mm
-        ActuatorCoordinates current_position{
-            actuators[X_AXIS]->get_current_position(),
-            actuators[Y_AXIS]->get_current_position(),
-            actuators[Z_AXIS]->get_current_position()
-        };
-
-        // get machine position from the actuator position using FK
+        // get real time positions, the actuator position in mm and the machine position from it using FK
+        ActuatorCoordinates current_position;
         float mpos[3];
-        arm_solution->actuator_to_cartesian(current_position, mpos);
+        get_realtime_position(mpos, &current_position);
 
         if(subcode == 1) { // M114.1 print realtime WCS
             // FIXME this currently includes the compensation transform which is incorrect so will be slightly off if it is in effect (but by very little)
             wcs_t pos= mcs2wcs(mpos);
-            n = snprintf(buf, bufsize, "C: X:%1.4f Y:%1.4f Z:%1.4f", from_millimeters(std::get<X_AXIS>(pos)), from_millimeters(std::get<Y_AXIS>(pos)), from_millimeters(std::get<Z_AXIS>(pos)));
+            v[X_AXIS]= from_millimeters(std::get<X_AXIS>(pos));
+            v[Y_AXIS]= from_millimeters(std::get<Y_AXIS>(pos));
+            v[Z_AXIS]= from_millimeters(std::get<Z_AXIS>(pos));
+            f.str("C: ").axes("XYZ", v, 3);
 
         } else if(subcode == 2) { // M114.1 print realtime Machine coordinate system
-            n = snprintf(buf, bufsize, "MPOS: X:%1.4f Y:%1.4f Z:%1.4f", mpos[X_AXIS], mpos[Y_AXIS], mpos[Z_AXIS]);
+            f.str("MPOS: ").axes("XYZ", mpos, 3);
 
         } else if(subcode == 3) { // M114.2 print realtime actuator position
-            n = snprintf(buf, bufsize, "APOS: A:%1.4f B:%1.4f C:%1.4f", current_position[X_AXIS], current_position[Y_AXIS], current_position[Z_AXIS]);
+            f.str("APOS: ").axes("ABC", current_position.data(), 3);
         }
     }
-    return n;
+    return f.length();
 }
 
 // converts current last milestone (machine position without compensation transform) to work coordinate system (inverse transform)
@@ -311,18 +637,20 @@ Robot::wcs_t Robot::mcs2wcs(const Robot::wcs_t& pos) const
     return std::make_tuple(
         std::get<X_AXIS>(pos) - std::get<X_AXIS>(wcs_offsets[current_wcs]) + std::get<X_AXIS>(g92_offset) - std::get<X_AXIS>(tool_offset),
         std::get<Y_AXIS>(pos) - std::get<Y_AXIS>(wcs_offsets[current_wcs]) + std::get<Y_AXIS>(g92_offset) - std::get<Y_AXIS>(tool_offset),
-        std::get<Z_AXIS>(pos) - std::get<Z_AXIS>(wcs_offsets[current_wcs]) + std::get<Z_AXIS>(g92_offset) - std::get<Z_AXIS>(tool_offset)
+        std::get<Z_AXIS>(pos) - std::get<Z_AXIS>(wcs_offsets[current_wcs]) + std::get<Z_AXIS>(g92_offset) - std::get<Z_AXIS>(tool_offset) - zhop_applied
     );
 }
 
 // this does a sanity check that actuator speeds do not exceed steps rate capability
 // we will override the actuator max_rate if the combination of max_rate and steps/sec exceeds base_stepping_frequency
+// at the coarsest microsteps the actuator switches to
 void Robot::check_max_actuator_speeds()
 {
     for (size_t i = 0; i < actuators.size(); i++) {
-        float step_freq = actuators[i]->get_max_rate() * actuators[i]->get_steps_per_mm();
+        float steps_per_mm = actuators[i]->get_steps_per_mm() / (1 << actuators[i]->get_max_microstep_shift());
+        float step_freq = actuators[i]->get_max_rate() * steps_per_mm;
         if (step_freq > THEKERNEL->base_stepping_frequency) {
-            actuators[i]->set_max_rate(floorf(THEKERNEL->base_stepping_frequency / actuators[i]->get_steps_per_mm()));
+            actuators[i]->set_max_rate(floorf(THEKERNEL->base_stepping_frequency / steps_per_mm));
             THEKERNEL->streams->printf("WARNING: actuator %c rate exceeds base_stepping_frequency * alpha_steps_per_mm: %f, setting to %f\n", 'A' + i, step_freq, actuators[i]->max_rate);
         }
     }
@@ -334,6 +662,11 @@ void Robot::on_gcode_received(void *argument)
 {
     Gcode *gcode = static_cast<Gcode *>(argument);
 
+    // anything other than another G0/G1 must see the held back move queued first
+    if(merge_pending && !(gcode->has_g && gcode->g <= 1)) {
+        flush_pending_move();
+    }
+
     this->motion_mode = -1;
 
     if( gcode->has_g) {
@@ -342,6 +675,7 @@ void Robot::on_gcode_received(void *argument)
             case 1:  this->motion_mode = MOTION_MODE_LINEAR;  break;
             case 2:  this->motion_mode = MOTION_MODE_CW_ARC;  break;
             case 3:  this->motion_mode = MOTION_MODE_CCW_ARC; break;
+            case 5:  this->motion_mode = MOTION_MODE_BEZIER;  break;
             case 4: { // G4 pause
                 uint32_t delay_ms = 0;
                 if (gcode->has_letter('P')) {
@@ -351,14 +685,8 @@ void Robot::on_gcode_received(void *argument)
                     delay_ms += gcode->get_int('S') * 1000;
                 }
                 if (delay_ms > 0) {
-                    // drain queue
-                    THEKERNEL->conveyor->wait_for_empty_queue();
-                    // wait for specified time
-                    uint32_t start = us_ticker_read(); // mbed call
-                    while ((us_ticker_read() - start) < delay_ms * 1000) {
-                        THEKERNEL->call_event(ON_IDLE, this);
-                        if(THEKERNEL->is_halted()) return;
-                    }
+                    // the Stepper holds the queue for the time, so the moves after it are planned while it waits
+                    THEKERNEL->conveyor->queue_dwell(delay_ms);
                 }
             }
             break;
@@ -413,8 +741,8 @@ void Robot::on_gcode_received(void *argument)
                 }
                 break;
 
-            case 90: this->absolute_mode = true;   break;
-            case 91: this->absolute_mode = false;   break;
+            case 90: this->absolute_mode = this->e_absolute = true;   break;
+            case 91: this->absolute_mode = this->e_absolute = false;   break;
 
             case 92: {
                  if(gcode->subcode == 1 || gcode->subcode == 2 || gcode->get_num_args() == 0) {
@@ -439,6 +767,14 @@ void Robot::on_gcode_received(void *argument)
                         z += to_millimeters(gcode->get_value('Z')) - std::get<Z_AXIS>(pos);
                     }
                     g92_offset = wcs_t(x, y, z);
+
+                    // the extra axes have no offsets, their position is just set
+                    for (size_t j = 0; j < n_extra_axes; j++) {
+                        if(!gcode->has_letter(extra_letter[j])) continue;
+                        extra_requested[j]= gcode->get_value(extra_letter[j]);
+                        extra_milestone[j]= extra_requested[j] * extra_scale[j];
+                    }
+                    sync_extra_actuators();
                 }
 
                 return;
@@ -448,7 +784,11 @@ void Robot::on_gcode_received(void *argument)
     } else if( gcode->has_m) {
         switch( gcode->m ) {
             case 0: // M0 feed hold
-                if(THEKERNEL->is_grbl_mode()) THEKERNEL->set_feed_hold(true);
+                // after the moves before it, the feed hold would otherwise stop them part way
+                if(THEKERNEL->is_grbl_mode()) {
+                    THEKERNEL->conveyor->wait_for_empty_queue();
+                    THEKERNEL->set_feed_hold(true);
+                }
                 break;
 
             case 30: // M30 end of program in grbl mode (otherwise it is delete sdcard file)
@@ -459,6 +799,9 @@ void Robot::on_gcode_received(void *argument)
                 absolute_mode = true;
                 break;
 
+            case 82: this->e_absolute = true; break;
+            case 83: this->e_absolute = false; break;
+
             case 92: // M92 - set steps per mm
                 if (gcode->has_letter('X'))
                     actuators[0]->change_steps_per_mm(this->to_millimeters(gcode->get_value('X')));
@@ -510,7 +853,7 @@ void Robot::on_gcode_received(void *argument)
                 }
                 break;
 
-            case 204: // M204 Snnn - set acceleration to nnn, Znnn sets z acceleration
+            case 204: // M204 Snnn - set acceleration to nnn, Znnn sets z acceleration, ABC set actuator accelerations, 0 for none
                 if (gcode->has_letter('S')) {
                     float acc = gcode->get_value('S'); // mm/s^2
                     // enforce minimum
@@ -525,6 +868,10 @@ void Robot::on_gcode_received(void *argument)
                         acc = 0.0F;
                     THEKERNEL->planner->z_acceleration = acc;
                 }
+                for (size_t i = 0; i < 3 && i < actuators.size(); i++) {
+                    if (gcode->has_letter('A' + i))
+                        actuators[i]->set_acceleration(std::max(0.0F, gcode->get_value('A' + i)));
+                }
                 break;
 
             case 205: // M205 Xnnn - set junction deviation, Z - set Z junction deviation, Snnn - Set minimum planner speed, Ynnn - set minimum step rate
@@ -564,7 +911,10 @@ void Robot::on_gcode_received(void *argument)
                     if (factor > 1000.0F)
                         factor = 1000.0F;
 
+                    // the moves already queued change speed too, not just the ones after this
+                    float old_seconds_per_minute = seconds_per_minute;
                     seconds_per_minute = 6000.0F / factor;
+                    THEKERNEL->planner->change_speed(old_seconds_per_minute / seconds_per_minute);
                 } else {
                     gcode->stream->printf("Speed factor at %6.2f %%\n", 6000.0F / seconds_per_minute);
                 }
@@ -577,7 +927,11 @@ void Robot::on_gcode_received(void *argument)
             case 500: // M500 saves some volatile settings to config override file
             case 503: { // M503 just prints the settings
                 gcode->stream->printf(";Steps per unit:\nM92 X%1.5f Y%1.5f Z%1.5f\n", actuators[0]->steps_per_mm, actuators[1]->steps_per_mm, actuators[2]->steps_per_mm);
-                gcode->stream->printf(";Acceleration mm/sec^2:\nM204 S%1.5f Z%1.5f\n", THEKERNEL->planner->acceleration, THEKERNEL->planner->z_acceleration);
+                gcode->stream->printf(";Acceleration mm/sec^2, ABC actuator:\nM204 S%1.5f Z%1.5f", THEKERNEL->planner->acceleration, THEKERNEL->planner->z_acceleration);
+                for (size_t i = 0; i < 3 && i < actuators.size(); i++) {
+                    gcode->stream->printf(" %c%1.5f", 'A' + i, actuators[i]->get_acceleration());
+                }
+                gcode->stream->printf("\n");
                 gcode->stream->printf(";X- Junction Deviation, Z- Z junction deviation, S - Minimum Planner speed mm/sec:\nM205 X%1.5f Z%1.5f S%1.5f\n", THEKERNEL->planner->junction_deviation, THEKERNEL->planner->z_junction_deviation, THEKERNEL->planner->minimum_planner_speed);
                 gcode->stream->printf(";Max feedrates in mm/sec, XYZ cartesian, ABC actuator:\nM203 X%1.5f Y%1.5f Z%1.5f",
                                       this->max_speeds[X_AXIS], this->max_speeds[Y_AXIS], this->max_speeds[Z_AXIS]);
@@ -714,7 +1068,7 @@ void Robot::process_move(Gcode *gcode)
             }
 
             if(!isnan(param[Z_AXIS])) {
-                target[Z_AXIS]= param[Z_AXIS] + std::get<Z_AXIS>(wcs_offsets[current_wcs]) - std::get<Z_AXIS>(g92_offset) + std::get<Z_AXIS>(tool_offset);
+                target[Z_AXIS]= param[Z_AXIS] + std::get<Z_AXIS>(wcs_offsets[current_wcs]) - std::get<Z_AXIS>(g92_offset) + std::get<Z_AXIS>(tool_offset) + zhop;
             }
 
         }else{
@@ -724,6 +1078,10 @@ void Robot::process_move(Gcode *gcode)
             }
         }
 
+        // a change of the z hop is taken up by this move, together with whatever else it does
+        if(!this->absolute_mode || isnan(param[Z_AXIS])) target[Z_AXIS] += zhop - zhop_applied;
+        zhop_applied= zhop;
+
     }else{
         // already in machine coordinates, we do not add tool offset for that
         for(int i= X_AXIS; i <= Z_AXIS; ++i) {
@@ -738,6 +1096,29 @@ void Robot::process_move(Gcode *gcode)
             this->feed_rate = this->to_millimeters( gcode->get_value('F') );
     }
 
+    // moves are not merged while recording, it depends on the state of the queue
+    if(merge_tolerance > 0.0F && !segment_recorder) {
+        if((motion_mode == MOTION_MODE_SEEK || motion_mode == MOTION_MODE_LINEAR) && !next_command_is_MCS) {
+            float rate_mm_s= (motion_mode == MOTION_MODE_SEEK ? seek_rate : feed_rate) / seconds_per_minute;
+            if(merge_move(gcode, target, rate_mm_s)) return;
+
+        } else if(merge_pending) {
+            flush_pending_move();
+        }
+    }
+
+    // the extra axes are in their own units and have no offsets, they move along with the XYZ move or on their own
+    for (size_t j = 0; j < n_extra_axes; j++) {
+        char letter= extra_letter[j];
+        if(!gcode->has_letter(letter)) continue;
+        float v= gcode->get_value(letter);
+        bool absolute= (letter == 'E') ? this->e_absolute : this->absolute_mode;
+        float d= (absolute || next_command_is_MCS) ? v - extra_requested[j] : v;
+        extra_requested[j] += d;
+        extra_delta[j]= d * extra_scale[j];
+        if(extra_delta[j] != 0.0F) extra_moving= true;
+    }
+
     bool moved= false;
     //Perform any physical actions
     switch(this->motion_mode) {
@@ -753,12 +1134,106 @@ void Robot::process_move(Gcode *gcode)
         case MOTION_MODE_CCW_ARC:
             moved= this->compute_arc(gcode, offset, target );
             break;
+        case MOTION_MODE_BEZIER:
+            moved= this->compute_bezier(gcode, offset, target );
+            break;
     }
 
     if(moved) {
         // set last_milestone to the calculated target
         memcpy(this->last_milestone, target, sizeof(this->last_milestone));
+        for (size_t j = 0; j < n_extra_axes; j++) extra_milestone[j] += extra_delta[j];
+    }
+    if(extra_moving) {
+        extra_moving= false;
+        extra_start= extra_milestone;
+        extra_delta.fill(0.0F);
+    }
+}
+
+// Collinear moves are held back and merged into one line, so the planner does not have to deal with lots of
+// tiny zero angle junctions. A move can be merged if it only has XYZ and F, is the same G code at the same rate, and its end point
+// is within merge_tolerance of the line the merged move started on.
+// returns true if the move was held back, otherwise any held back move has been queued and the move must be done as usual
+bool Robot::merge_move(Gcode *gcode, const float target[], float rate_mm_s)
+{
+    bool can_merge= true;
+    for(char c = 'A'; c <= 'Z'; c++) {
+        if(c == 'G' || c == 'F' || c == 'X' || c == 'Y' || c == 'Z') continue;
+        if(gcode->has_letter(c)) {
+            can_merge= false;
+            break;
+        }
+    }
+
+    if(merge_pending) {
+        // G0 and G1 are not merged with each other as a laser treats them differently
+        if(can_merge && rate_mm_s == pending_rate && gcode->g == pending_gcode->g) {
+            // distance along and from the line the merged move started on
+            float v[3], d[3], along= 0, forward= 0, len2= 0;
+            for (int i = X_AXIS; i <= Z_AXIS; i++) {
+                v[i]= target[i] - pending_start[i];
+                d[i]= target[i] - last_milestone[i];
+                along += v[i] * pending_unit_vec[i];
+                forward += d[i] * pending_unit_vec[i];
+                len2 += v[i] * v[i];
+            }
+
+            if(forward > 0.0F && along <= merge_max_length && len2 - along * along <= merge_tolerance * merge_tolerance) {
+                // replace the held back gcode, it is the last one that gets attached to the block
+                delete pending_gcode;
+                pending_gcode= new Gcode(*gcode);
+                memcpy(last_milestone, target, sizeof(last_milestone));
+                return true;
+            }
+        }
+
+        flush_pending_move();
+    }
+
+    // only start merging if the machine is busy, otherwise there is nothing to gain by holding a move back
+    if(!can_merge || THEKERNEL->conveyor->is_queue_empty()) return false;
+
+    float mm= 0;
+    for (int i = X_AXIS; i <= Z_AXIS; i++) {
+        pending_unit_vec[i]= target[i] - last_milestone[i];
+        mm += pending_unit_vec[i] * pending_unit_vec[i];
+    }
+    mm= sqrtf(mm);
+    if(mm < 0.00001F || mm >= merge_max_length) return false;
+
+    for (int i = X_AXIS; i <= Z_AXIS; i++) {
+        pending_unit_vec[i] /= mm;
+    }
+
+    memcpy(pending_start, last_milestone, sizeof(pending_start));
+    pending_rate= rate_mm_s;
+    pending_gcode= new Gcode(*gcode);
+    merge_pending= true;
+
+    // last_milestone is where we were asked to go, pending_start is where the queued moves take us
+    memcpy(last_milestone, target, sizeof(last_milestone));
+    return true;
+}
+
+// queue the held back merged move
+void Robot::flush_pending_move()
+{
+    if(!merge_pending) return;
+    merge_pending= false;
+
+    float target[3];
+    memcpy(target, last_milestone, sizeof(target));
+    memcpy(last_milestone, pending_start, sizeof(last_milestone));
+
+    bool mcs= next_command_is_MCS; // append_line resets it
+    if(append_line(pending_gcode, target, pending_rate)) {
+        memcpy(last_milestone, target, sizeof(last_milestone));
     }
+    next_command_is_MCS= mcs;
+
+    delete pending_gcode;
+    pending_gcode= nullptr;
 }
 
 // We received a new gcode, and one of the functions
@@ -766,6 +1241,8 @@ void Robot::process_move(Gcode *gcode)
 // and continue
 void Robot::distance_in_gcode_is_known(Gcode * gcode)
 {
+    if(segment_recorder) return; // nothing is queued while recording
+
     //If the queue is empty, execute immediately, otherwise attach to the last added block
     THEKERNEL->conveyor->append_gcode(gcode);
 }
@@ -780,14 +1257,62 @@ void Robot::reset_axis_position(float x, float y, float z)
     last_machine_position[X_AXIS]= last_milestone[X_AXIS] = x;
     last_machine_position[Y_AXIS]= last_milestone[Y_AXIS] = y;
     last_machine_position[Z_AXIS]= last_milestone[Z_AXIS] = z;
+    zhop_applied= 0.0F;
 
     // now set the actuator positions to match
     ActuatorCoordinates actuator_pos;
     arm_solution->cartesian_to_actuator(this->last_machine_position, actuator_pos);
-    for (size_t i = 0; i < actuators.size(); i++)
+    for (size_t i = 0; i < actuators.size() - n_extra_axes; i++)
         actuators[i]->change_last_milestone(actuator_pos[i]);
 }
 
+// the actuators of the extra axes are where the extra axes were last asked to go
+void Robot::sync_extra_actuators()
+{
+    size_t first= actuators.size() - n_extra_axes;
+    for (size_t j = 0; j < n_extra_axes; j++)
+        actuators[first + j]->change_last_milestone(extra_milestone[j]);
+    extra_start= extra_milestone;
+}
+
+// The motor goes after the actuators there are, so Stepper steps it from the blocks and the planner limits its rate and
+// acceleration like the others. Only possible when built with more actuators than the machine has (make AXIS=4)
+int Robot::add_extra_axis(char letter, StepperMotor *motor)
+{
+    if(actuators.size() >= k_max_actuators) return -1;
+
+    int j= n_extra_axes++;
+    extra_letter[j]= letter;
+    extra_requested[j]= extra_milestone[j]= extra_start[j]= 0.0F;
+    extra_scale[j]= 1.0F;
+    actuators.push_back(motor);
+    motor->change_last_milestone(0.0F);
+    THEKERNEL->stepper->add_actuator(motor);
+    check_max_actuator_speeds();
+    return j;
+}
+
+bool Robot::move_extra_axis(int j, float mm, float rate_mm_s)
+{
+    flush_pending_move();
+    extra_delta[j]= mm;
+    extra_moving= true;
+    bool moved= append_line(nullptr, last_milestone, rate_mm_s);
+    if(moved) extra_milestone[j] += mm;
+    extra_moving= false;
+    extra_start= extra_milestone;
+    extra_delta.fill(0.0F);
+    return moved;
+}
+
+// how far the extra axes move in the move being queued, in their own units
+float Robot::extra_move_distance() const
+{
+    float d2= 0.0F;
+    for (size_t j = 0; j < n_extra_axes; j++) d2 += extra_delta[j] * extra_delta[j];
+    return sqrtf(d2);
+}
+
 // Reset the position for an axis (used in homing)
 void Robot::reset_axis_position(float position, int axis)
 {
@@ -799,7 +1324,7 @@ void Robot::reset_axis_position(float position, int axis)
 // then sets the axis positions to match. currently only called from Endstops.cpp
 void Robot::reset_actuator_position(const ActuatorCoordinates &ac)
 {
-    for (size_t i = 0; i < actuators.size(); i++)
+    for (size_t i = 0; i < actuators.size() - n_extra_axes; i++)
         actuators[i]->change_last_milestone(ac[i]);
 
     // now correct axis positions then recorrect actuator to account for rounding
@@ -819,13 +1344,18 @@ void Robot::reset_position_from_current_actuator_position()
     arm_solution->actuator_to_cartesian(actuator_pos, last_machine_position);
     // FIXME problem is this includes any compensation transform, and without an inverse compensation we cannot get a correct last_milestone
     memcpy(last_milestone, last_machine_position, sizeof last_milestone);
+    for (size_t j = 0; j < n_extra_axes; j++) {
+        extra_milestone[j]= actuator_pos[actuators.size() - n_extra_axes + j];
+        extra_requested[j]= extra_milestone[j] / extra_scale[j];
+    }
 
     // now reset actuator::last_milestone, NOTE this may lose a little precision as FK is not always entirely accurate.
     // NOTE This is required to sync the machine position with the actuator position, we do a somewhat redundant cartesian_to_actuator() call
     // to get everything in perfect sync.
     arm_solution->cartesian_to_actuator(last_machine_position, actuator_pos);
-    for (size_t i = 0; i < actuators.size(); i++)
+    for (size_t i = 0; i < actuators.size() - n_extra_axes; i++)
         actuators[i]->change_last_milestone(actuator_pos[i]);
+    sync_extra_actuators();
 }
 
 // Convert target (in machine coordinates) from millimeters to steps, and append this to the planner
@@ -833,7 +1363,6 @@ void Robot::reset_position_from_current_actuator_position()
 // all transforms and is what we actually convert to actuator positions
 bool Robot::append_milestone(Gcode * gcode, const float target[], float rate_mm_s)
 {
-    float deltas[3];
     float unit_vec[3];
     ActuatorCoordinates actuator_pos;
     float transformed_target[3]; // adjust target for bed compensation and WCS offsets
@@ -848,26 +1377,49 @@ bool Robot::append_milestone(Gcode * gcode, const float target[], float rate_mm_
         compensationTransform(transformed_target);
     }
 
-    // find distance moved by each axis, use transformed target from the current machine position
-    for (int axis = X_AXIS; axis <= Z_AXIS; axis++) {
-        deltas[axis] = transformed_target[axis] - last_machine_position[axis];
+    // it is unlikely but we need to protect against divide by zero, so ignore insanely small moves here
+    // as the last milestone won't be updated we do not actually lose any moves as they will be accounted for in the next move
+    if(!segment_vector(transformed_target, unit_vec, millimeters_of_travel)) {
+        // unless the extra axes still have some way to go, that is moved with no XYZ direction
+        float left= (extra_move_mm > extra_move_done) ? (1.0F - extra_move_done / extra_move_mm) * extra_move_distance() : 0.0F;
+        if(!extra_moving || left < 0.00001F) return false;
+        millimeters_of_travel= left;
+        clear_vector_float(unit_vec);
     }
 
-    // Compute how long this move moves, so we can attach it to the block for later use
-    millimeters_of_travel = sqrtf( powf( deltas[X_AXIS], 2 ) +  powf( deltas[Y_AXIS], 2 ) +  powf( deltas[Z_AXIS], 2 ) );
+    // this is the end of the move, where the extra axes get to their targets
+    extra_move_done= extra_move_mm;
 
-    // it is unlikely but we need to protect against divide by zero, so ignore insanely small moves here
-    // as the last milestone won't be updated we do not actually lose any moves as they will be accounted for in the next move
-    if(millimeters_of_travel < 0.00001F) return false;
+    // Do not move faster than the configured cartesian limits
+    rate_mm_s= limit_cartesian_rate(unit_vec, rate_mm_s);
 
-    // this is the machine position
-    memcpy(this->last_machine_position, transformed_target, sizeof(this->last_machine_position));
+    // find actuator position given the machine position, use actual adjusted target
+    arm_solution->cartesian_to_actuator( transformed_target, actuator_pos );
+
+    append_segment(transformed_target, actuator_pos, rate_mm_s, millimeters_of_travel, unit_vec);
+    return true;
+}
+
+// find the unit vector and length of the move from the last machine position to pos, returns false if it is too small to move
+bool Robot::segment_vector(const float pos[], float unit_vec[], float &millimeters) const
+{
+    float deltas[3];
+    for (int axis = X_AXIS; axis <= Z_AXIS; axis++) {
+        deltas[axis] = pos[axis] - last_machine_position[axis];
+    }
+
+    millimeters = sqrtf(deltas[X_AXIS] * deltas[X_AXIS] + deltas[Y_AXIS] * deltas[Y_AXIS] + deltas[Z_AXIS] * deltas[Z_AXIS]);
+    if(millimeters < 0.00001F) return false;
 
-    // find distance unit vector
     for (int i = 0; i < 3; i++)
-        unit_vec[i] = deltas[i] / millimeters_of_travel;
+        unit_vec[i] = deltas[i] / millimeters;
 
-    // Do not move faster than the configured cartesian limits
+    return true;
+}
+
+// reduce the rate so no axis moves faster than its configured max speed
+float Robot::limit_cartesian_rate(const float unit_vec[], float rate_mm_s) const
+{
     for (int axis = X_AXIS; axis <= Z_AXIS; axis++) {
         if ( max_speeds[axis] > 0 ) {
             float axis_speed = fabs(unit_vec[axis] * rate_mm_s);
@@ -876,38 +1428,188 @@ bool Robot::append_milestone(Gcode * gcode, const float target[], float rate_mm_
                 rate_mm_s *= ( max_speeds[axis] / axis_speed );
         }
     }
+    return rate_mm_s;
+}
 
-    // find actuator position given the machine position, use actual adjusted target
-    arm_solution->cartesian_to_actuator( this->last_machine_position, actuator_pos );
+// queue a block to the machine position pos, the cartesian limits have already been applied to the rate
+void Robot::append_segment(const float pos[], ActuatorCoordinates &actuator_pos, float rate_mm_s, float millimeters_of_travel, float unit_vec[])
+{
+    // this is the machine position
+    memcpy(this->last_machine_position, pos, sizeof(this->last_machine_position));
+
+    // the extra axes move in proportion to how far along the move the segment ends
+    if(n_extra_axes > 0) {
+        size_t first= actuators.size() - n_extra_axes;
+        extra_move_done += millimeters_of_travel;
+        float f= (extra_move_done < extra_move_mm) ? extra_move_done / extra_move_mm : 1.0F;
+        for (size_t j = 0; j < n_extra_axes; j++)
+            actuator_pos[first + j]= extra_start[j] + extra_delta[j] * f;
+    }
 
     float isecs = rate_mm_s / millimeters_of_travel;
+    // how fast the limits would let it go, a speed override may replan it to go faster once it is queued
+    float max_rate_mm_s = limit_cartesian_rate(unit_vec, 1e6F);
     // check per-actuator speed limits
     for (size_t actuator = 0; actuator < actuators.size(); actuator++) {
-        float actuator_rate  = fabsf(actuator_pos[actuator] - actuators[actuator]->last_milestone_mm) * isecs;
+        float actuator_mm = fabsf(actuator_pos[actuator] - actuators[actuator]->last_milestone_mm);
+        float actuator_rate  = actuator_mm * isecs;
         if (actuator_rate > actuators[actuator]->get_max_rate()) {
             rate_mm_s *= (actuators[actuator]->get_max_rate() / actuator_rate);
             isecs = rate_mm_s / millimeters_of_travel;
         }
+        if (actuator_mm * max_rate_mm_s > actuators[actuator]->get_max_rate() * millimeters_of_travel) {
+            max_rate_mm_s = actuators[actuator]->get_max_rate() * millimeters_of_travel / actuator_mm;
+        }
+    }
+
+    if(segment_recorder) {
+        // compiling a job, the actuators only track where the segment ends
+        for (size_t actuator = 0; actuator < actuators.size(); actuator++)
+            actuators[actuator]->last_milestone_mm= actuator_pos[actuator];
+        segment_recorder(actuator_pos, rate_mm_s, millimeters_of_travel, unit_vec);
+        return;
     }
 
     // Append the block to the planner
-    THEKERNEL->planner->append_block( actuator_pos, rate_mm_s, millimeters_of_travel, unit_vec );
+    THEKERNEL->planner->append_block( actuator_pos, rate_mm_s, millimeters_of_travel, unit_vec, max_rate_mm_s );
+}
+
+// Append all but the last segment of a segmented line, the segment end points are worked out and converted to
+// actuator positions in batches. Without compensation all segments have the same length and direction, so the
+// unit vector and cartesian speed limit are only worked out once
+bool Robot::append_segments(const float segment_delta[], uint16_t segments, float rate_mm_s)
+{
+    float points[segment_batch_size][3];
+    ActuatorCoordinates actuator_pos[segment_batch_size];
+    const float start[3]{last_milestone[X_AXIS], last_milestone[Y_AXIS], last_milestone[Z_AXIS]};
+
+    float unit_vec[3];
+    float segment_mm= 0;
+    // if the last move was compensated the first segment is not the same as the others
+    bool uniform= !compensationTransform && memcmp(last_machine_position, last_milestone, sizeof(last_milestone)) == 0;
+    if(uniform) {
+        segment_mm= sqrtf(segment_delta[X_AXIS] * segment_delta[X_AXIS] + segment_delta[Y_AXIS] * segment_delta[Y_AXIS] + segment_delta[Z_AXIS] * segment_delta[Z_AXIS]);
+        if(segment_mm < 0.00001F) {
+            uniform= false;
+        }else{
+            for (int i = 0; i < 3; i++)
+                unit_vec[i] = segment_delta[i] / segment_mm;
+            rate_mm_s= limit_cartesian_rate(unit_vec, rate_mm_s);
+        }
+    }
+
+    // a Z move stays over the one point, so an offset of Z that depends on X and Y is the same for every segment
+    bool z_offset_once= compensationTransform && compensation_is_z_offset && segment_delta[X_AXIS] == 0.0F && segment_delta[Y_AXIS] == 0.0F;
+    float z_offset= 0.0F;
+    if(z_offset_once) {
+        float p[3]{start[X_AXIS], start[Y_AXIS], start[Z_AXIS]};
+        compensationTransform(p);
+        z_offset= p[Z_AXIS] - start[Z_AXIS];
+    }
+
+    bool moved= false;
+    // segment 0 is already done - it's the end point of the previous move so we start at segment 1
+    // the final segment is added by the caller so we stop at segments-1
+    for (int i = 1; i < segments; ) {
+        int n= min(segments - i, (int)segment_batch_size);
+
+        for (int j = 0; j < n; j++) {
+            for(int axis = X_AXIS; axis <= Z_AXIS; axis++ )
+                points[j][axis]= start[axis] + segment_delta[axis] * (i + j);
+        }
+
+        if(z_offset_once) {
+            for (int j = 0; j < n; j++) points[j][Z_AXIS] += z_offset;
+        } else if(compensationTransform) {
+            for (int j = 0; j < n; j++) compensationTransform(points[j]);
+        }
+
+        arm_solution->cartesian_to_actuator_batch(points, actuator_pos, n);
+
+        for (int j = 0; j < n; j++) {
+            if(THEKERNEL->is_halted()) return false; // don't queue any more segments
+
+            if(uniform) {
+                append_segment(points[j], actuator_pos[j], rate_mm_s, segment_mm, unit_vec);
+                moved= true;
+
+            }else{
+                float vec[3], mm;
+                if(!segment_vector(points[j], vec, mm)) continue;
+                append_segment(points[j], actuator_pos[j], limit_cartesian_rate(vec, rate_mm_s), mm, vec);
+                moved= true;
+            }
+        }
+
+        i += n;
+    }
+
+    return moved;
+}
+
+// Append segments ending at each of the n points, the points are converted to actuator positions in one batch.
+// segment_mm is the length of every segment when the caller knows it, then only their direction has to be worked out
+bool Robot::append_path_segments(float points[][3], int n, float rate_mm_s, float segment_mm)
+{
+    ActuatorCoordinates actuator_pos[segment_batch_size];
+
+    if(compensationTransform) {
+        for (int j = 0; j < n; j++) compensationTransform(points[j]);
+    }
+
+    arm_solution->cartesian_to_actuator_batch(points, actuator_pos, n);
+
+    bool uniform= !compensationTransform && segment_mm >= 0.00001F;
+    bool moved= false;
+    for (int j = 0; j < n; j++) {
+        if(THEKERNEL->is_halted()) return false; // don't queue any more segments
+
+        float vec[3], mm= segment_mm;
+        if(uniform) {
+            for (int i = 0; i < 3; i++)
+                vec[i]= (points[j][i] - last_machine_position[i]) / mm;
+
+        }else if(!segment_vector(points[j], vec, mm)) {
+            continue;
+        }
+
+        append_segment(points[j], actuator_pos[j], limit_cartesian_rate(vec, rate_mm_s), mm, vec);
+        moved= true;
+    }
 
+    return moved;
+}
+
+// Queue a straight move to target in machine coordinates without a gcode of its own, for modules that work out
+// their own sequence of moves. Any gcodes the blocks need are up to the caller to attach
+bool Robot::append_machine_move(const float target[], float rate_mm_s)
+{
+    flush_pending_move();
+    if(!append_line(nullptr, target, rate_mm_s)) return false;
+
+    memcpy(this->last_milestone, target, sizeof(this->last_milestone));
     return true;
 }
 
-// Append a move to the queue ( cutting it into segments if needed )
+// Append a move to the queue ( cutting it into segments if needed ), gcode is nullptr for a move without one
 bool Robot::append_line(Gcode *gcode, const float target[], float rate_mm_s )
 {
     // Find out the distance for this move in MCS
     // NOTE we need to do sqrt here as this setting of millimeters_of_travel is used by extruder and other modules even if there is no XYZ move
-    gcode->millimeters_of_travel = sqrtf(powf( target[X_AXIS] - last_milestone[X_AXIS], 2 ) +  powf( target[Y_AXIS] - last_milestone[Y_AXIS], 2 ) +  powf( target[Z_AXIS] - last_milestone[Z_AXIS], 2 ));
+    float millimeters_of_travel = sqrtf(powf( target[X_AXIS] - last_milestone[X_AXIS], 2 ) +  powf( target[Y_AXIS] - last_milestone[Y_AXIS], 2 ) +  powf( target[Z_AXIS] - last_milestone[Z_AXIS], 2 ));
+
+    // a move of only the extra axes is as long as they move, and its rate is in their units
+    bool extra_only= extra_moving && millimeters_of_travel < 0.00001F;
+    if(extra_only) millimeters_of_travel= extra_move_distance();
+    extra_move_mm= millimeters_of_travel;
+    extra_move_done= 0.0F;
+    if(gcode != nullptr) gcode->millimeters_of_travel = millimeters_of_travel;
 
     // We ignore non- XYZ moves ( for example, extruder moves are not XYZ moves )
-    if( gcode->millimeters_of_travel < 0.00001F ) return false;
+    if( millimeters_of_travel < 0.00001F ) return false;
 
     // Mark the gcode as having a known distance
-    this->distance_in_gcode_is_known( gcode );
+    if(gcode != nullptr) this->distance_in_gcode_is_known( gcode );
 
     // if we have volumetric limits enabled we calculate the volume for this move and limit the rate if it exceeds the stated limit
     // Note we need to be using volumetric extrusion for this to work as Ennn is in mm³ not mm
@@ -915,10 +1617,11 @@ bool Robot::append_line(Gcode *gcode, const float target[], float rate_mm_s )
     // We ask Extruder to do all the work, but as Extruder won't even see this gcode until after it has been planned
     // we need to ask it now passing in the relevant data.
     // NOTE we need to do this before we segment the line (for deltas)
-    if(gcode->has_letter('E')) {
-        float data[2];
+    if(gcode != nullptr && gcode->has_letter('E')) {
+        float data[3];
         data[0] = gcode->get_value('E'); // E target (may be absolute or relative)
-        data[1] = rate_mm_s / gcode->millimeters_of_travel; // inverted seconds for the move
+        data[1] = rate_mm_s / millimeters_of_travel; // inverted seconds for the move
+        data[2] = millimeters_of_travel;
         if(PublicData::set_value(extruder_checksum, target_checksum, data)) {
             rate_mm_s *= data[1];
             //THEKERNEL->streams->printf("Extruder has changed the rate by %f to %f\n", data[1], rate_mm_s);
@@ -929,8 +1632,14 @@ bool Robot::append_line(Gcode *gcode, const float target[], float rate_mm_s )
     // In delta robots either mm_per_line_segment can be used OR delta_segments_per_second
     // The latter is more efficient and avoids splitting fast long lines into very small segments, like initial z move to 0, it is what Johanns Marlin delta port does
     uint16_t segments;
+    bool xy_move = gcode != nullptr ? (gcode->has_letter('X') || gcode->has_letter('Y')) : (target[X_AXIS] != last_milestone[X_AXIS] || target[Y_AXIS] != last_milestone[Y_AXIS]);
+
+    if(this->disable_segmentation || extra_only || (!segment_z_moves && !xy_move)) {
+        segments= 1;
 
-    if(this->disable_segmentation || (!segment_z_moves && !gcode->has_letter('X') && !gcode->has_letter('Y'))) {
+    } else if(arm_solution->is_linear_move(last_milestone, target) &&
+              (compensationTransform == nullptr || (target[X_AXIS] == last_milestone[X_AXIS] && target[Y_AXIS] == last_milestone[Y_AXIS]))) {
+        // the actuators follow the line without being led along it, the compensation only depends on X and Y
         segments= 1;
 
     } else if(this->delta_segments_per_second > 1.0F) {
@@ -938,39 +1647,26 @@ bool Robot::append_line(Gcode *gcode, const float target[], float rate_mm_s )
         // segment based on current speed and requested segments per second
         // the faster the travel speed the fewer segments needed
         // NOTE rate is mm/sec and we take into account any speed override
-        float seconds = gcode->millimeters_of_travel / rate_mm_s;
+        float seconds = millimeters_of_travel / rate_mm_s;
         segments = max(1.0F, ceilf(this->delta_segments_per_second * seconds));
-        // TODO if we are only moving in Z on a delta we don't really need to segment at all
 
     } else {
         if(this->mm_per_line_segment == 0.0F) {
             segments = 1; // don't split it up
         } else {
-            segments = ceilf( gcode->millimeters_of_travel / this->mm_per_line_segment);
+            segments = ceilf( millimeters_of_travel / this->mm_per_line_segment);
         }
     }
 
     bool moved= false;
     if (segments > 1) {
-        // A vector to keep track of the endpoint of each segment
-        float segment_delta[3];
-        float segment_end[3]{last_milestone[X_AXIS], last_milestone[Y_AXIS], last_milestone[Z_AXIS]};
-
         // How far do we move each segment?
+        float segment_delta[3];
         for (int i = X_AXIS; i <= Z_AXIS; i++)
             segment_delta[i] = (target[i] - last_milestone[i]) / segments;
 
-        // segment 0 is already done - it's the end point of the previous move so we start at segment 1
-        // We always add another point after this loop so we stop at segments-1, ie i < segments
-        for (int i = 1; i < segments; i++) {
-            if(THEKERNEL->is_halted()) return false; // don't queue any more segments
-            for(int axis = X_AXIS; axis <= Z_AXIS; axis++ )
-                segment_end[axis] += segment_delta[axis];
-
-            // Append the end of this segment to the queue
-            bool b= this->append_milestone(gcode, segment_end, rate_mm_s);
-            moved= moved || b;
-        }
+        moved= append_segments(segment_delta, segments, rate_mm_s);
+        if(THEKERNEL->is_halted()) return false;
     }
 
     // Append the end of this full move to the queue
@@ -987,6 +1683,21 @@ bool Robot::append_line(Gcode *gcode, const float target[], float rate_mm_s )
 }
 
 
+// the number of chords an arc is cut into
+uint16_t Robot::get_arc_segments(float millimeters, float radius, float angular_travel) const
+{
+    float n_segments;
+    if(this->mm_max_arc_error > 0.0F) {
+        // the angle of a chord that is mm_max_arc_error off the arc in the middle, so small arcs get few segments and large ones many
+        float segment_angle = M_PI / 2;
+        if(this->mm_max_arc_error < radius) segment_angle = min(segment_angle, 2 * acosf(1 - this->mm_max_arc_error / radius));
+        n_segments = ceilf(fabsf(angular_travel) / segment_angle);
+    } else {
+        n_segments = floorf(millimeters / this->mm_per_arc_segment);
+    }
+    return max(1.0F, min(n_segments, 65535.0F));
+}
+
 // Append an arc to the queue ( cutting it into segments as needed )
 bool Robot::append_arc(Gcode * gcode, const float target[], const float offset[], float radius, bool is_clockwise )
 {
@@ -1011,6 +1722,8 @@ bool Robot::append_arc(Gcode * gcode, const float target[], const float offset[]
 
     // Find the distance for this gcode
     gcode->millimeters_of_travel = hypotf(angular_travel * radius, fabs(linear_travel));
+    extra_move_mm= gcode->millimeters_of_travel;
+    extra_move_done= 0.0F;
 
     // We don't care about non-XYZ moves ( for example the extruder produces some of those )
     if( gcode->millimeters_of_travel < 0.00001F ) {
@@ -1021,7 +1734,7 @@ bool Robot::append_arc(Gcode * gcode, const float target[], const float offset[]
     this->distance_in_gcode_is_known( gcode );
 
     // Figure out how many segments for this gcode
-    uint16_t segments = floorf(gcode->millimeters_of_travel / this->mm_per_arc_segment);
+    uint16_t segments = get_arc_segments(gcode->millimeters_of_travel, radius, angular_travel);
 
     float theta_per_segment = angular_travel / segments;
     float linear_per_segment = linear_travel / segments;
@@ -1038,63 +1751,66 @@ bool Robot::append_arc(Gcode * gcode, const float target[], const float offset[]
     round off issues for CNC applications.) Single precision error can accumulate to be greater than
     tool precision in some cases. Therefore, arc path correction is implemented.
 
-    Small angle approximation may be used to reduce computation overhead further. This approximation
-    holds for everything, but very small circles and large mm_per_arc_segment values. In other words,
-    theta_per_segment would need to be greater than 0.1 rad and N_ARC_CORRECTION would need to be large
-    to cause an appreciable drift error. N_ARC_CORRECTION~=25 is more than small enough to correct for
-    numerical drift error. N_ARC_CORRECTION may be on the order a hundred(s) before error becomes an
-    issue for CNC machines with the single precision Arduino calculations.
-    This approximation also allows mc_arc to immediately insert a line segment into the planner
-    without the initial overhead of computing cos() or sin(). By the time the arc needs to be applied
-    a correction, the planner should have caught up to the lag caused by the initial mc_arc overhead.
-    This is important when there are successive arc motions.
+    The rotation matrix is worked out exactly once per arc, so the segments stay on the arc whatever the angle
+    between them, only the single precision round-off is left to correct every arc_correction segments.
     */
     // Vector rotation matrix values
-    float cos_T = 1 - 0.5F * theta_per_segment * theta_per_segment; // Small angle approximation
-    float sin_T = theta_per_segment;
+    float cos_T = cosf(theta_per_segment);
+    float sin_T = sinf(theta_per_segment);
 
-    float arc_target[3];
     float sin_Ti;
     float cos_Ti;
     float r_axisi;
     uint16_t i;
     int8_t count = 0;
 
-    // Initialize the linear axis
-    arc_target[this->plane_axis_2] = this->last_milestone[this->plane_axis_2];
+    float rate_mm_s = this->feed_rate / seconds_per_minute;
+
+    // Without compensation every segment is a chord of the same length
+    float segment_mm = 0;
+    if(!compensationTransform && memcmp(last_machine_position, last_milestone, sizeof(last_milestone)) == 0) {
+        segment_mm = hypotf(2 * radius * sinf(fabsf(theta_per_segment) / 2), linear_per_segment);
+    }
+
+    // The segments are generated and handed to the arm solution in batches
+    float points[segment_batch_size][3];
+    float linear_axis = this->last_milestone[this->plane_axis_2];
 
     bool moved= false;
-    for (i = 1; i < segments; i++) { // Increment (segments-1)
-        if(THEKERNEL->is_halted()) return false; // don't queue any more segments
+    for (i = 1; i < segments; ) { // Increment (segments-1)
+        int n = min(segments - i, (int)segment_batch_size);
+
+        for (int j = 0; j < n; j++, i++) {
+            if (count < this->arc_correction ) {
+                // Apply vector rotation matrix
+                r_axisi = r_axis0 * sin_T + r_axis1 * cos_T;
+                r_axis0 = r_axis0 * cos_T - r_axis1 * sin_T;
+                r_axis1 = r_axisi;
+                count++;
+            } else {
+                // Arc correction to radius vector. Computed only every N_ARC_CORRECTION increments.
+                // Compute exact location by applying transformation matrix from initial radius vector(=-offset).
+                cos_Ti = cosf(i * theta_per_segment);
+                sin_Ti = sinf(i * theta_per_segment);
+                r_axis0 = -offset[this->plane_axis_0] * cos_Ti + offset[this->plane_axis_1] * sin_Ti;
+                r_axis1 = -offset[this->plane_axis_0] * sin_Ti - offset[this->plane_axis_1] * cos_Ti;
+                count = 0;
+            }
 
-        if (count < this->arc_correction ) {
-            // Apply vector rotation matrix
-            r_axisi = r_axis0 * sin_T + r_axis1 * cos_T;
-            r_axis0 = r_axis0 * cos_T - r_axis1 * sin_T;
-            r_axis1 = r_axisi;
-            count++;
-        } else {
-            // Arc correction to radius vector. Computed only every N_ARC_CORRECTION increments.
-            // Compute exact location by applying transformation matrix from initial radius vector(=-offset).
-            cos_Ti = cosf(i * theta_per_segment);
-            sin_Ti = sinf(i * theta_per_segment);
-            r_axis0 = -offset[this->plane_axis_0] * cos_Ti + offset[this->plane_axis_1] * sin_Ti;
-            r_axis1 = -offset[this->plane_axis_0] * sin_Ti - offset[this->plane_axis_1] * cos_Ti;
-            count = 0;
+            // Update arc_target location
+            linear_axis += linear_per_segment;
+            points[j][this->plane_axis_0] = center_axis0 + r_axis0;
+            points[j][this->plane_axis_1] = center_axis1 + r_axis1;
+            points[j][this->plane_axis_2] = linear_axis;
         }
 
-        // Update arc_target location
-        arc_target[this->plane_axis_0] = center_axis0 + r_axis0;
-        arc_target[this->plane_axis_1] = center_axis1 + r_axis1;
-        arc_target[this->plane_axis_2] += linear_per_segment;
-
-        // Append this segment to the queue
-        bool b= this->append_milestone(gcode, arc_target, this->feed_rate / seconds_per_minute);
-        moved= moved || b;
+        // Append these segments to the queue
+        if(this->append_path_segments(points, n, rate_mm_s, segment_mm)) moved= true;
+        if(THEKERNEL->is_halted()) return false; // don't queue any more segments
     }
 
     // Ensure last segment arrives at target location.
-    if(this->append_milestone(gcode, target, this->feed_rate / seconds_per_minute)) moved= true;
+    if(this->append_milestone(gcode, target, rate_mm_s)) moved= true;
 
     return moved;
 }
@@ -1116,6 +1832,116 @@ bool Robot::compute_arc(Gcode * gcode, const float offset[], const float target[
     return this->append_arc(gcode, target, offset,  radius, is_clockwise );
 }
 
+// Append a cubic (G5) or quadratic (G5.1) Bezier curve in the selected plane to the queue ( cutting it into segments as needed )
+// G5 I J are the first control point from the start and P Q the second from the target, G5.1 I J is the one control point from the start
+// The linear axis moves in proportion to the curve parameter
+bool Robot::compute_bezier(Gcode * gcode, const float offset[], const float target[])
+{
+    const int a0 = this->plane_axis_0, a1 = this->plane_axis_1, a2 = this->plane_axis_2;
+
+    // control points in the plane
+    float p[4][2];
+    p[0][0] = this->last_milestone[a0];
+    p[0][1] = this->last_milestone[a1];
+    p[3][0] = target[a0];
+    p[3][1] = target[a1];
+
+    if(gcode->subcode == 1) {
+        // a quadratic is the cubic with both its control points 2/3 of the way to the quadratic one
+        for (int i = 0; i < 2; i++) {
+            float q = p[0][i] + offset[i == 0 ? a0 : a1];
+            p[1][i] = p[0][i] + (q - p[0][i]) * 2 / 3;
+            p[2][i] = p[3][i] + (q - p[3][i]) * 2 / 3;
+        }
+
+    } else {
+        if(!gcode->has_letter('P') || !gcode->has_letter('Q')) {
+            gcode->stream->printf("error:G5 needs P and Q\n");
+            return false;
+        }
+        p[1][0] = p[0][0] + offset[a0];
+        p[1][1] = p[0][1] + offset[a1];
+        p[2][0] = p[3][0] + this->to_millimeters(gcode->get_value('P'));
+        p[2][1] = p[3][1] + this->to_millimeters(gcode->get_value('Q'));
+    }
+
+    float linear_start = this->last_milestone[a2];
+    float linear_travel = target[a2] - linear_start;
+
+    auto point = [&](float t, float pos[3]) {
+        float mt = 1 - t;
+        float b0 = mt * mt * mt, b1 = 3 * mt * mt * t, b2 = 3 * mt * t * t, b3 = t * t * t;
+        pos[a0] = b0 * p[0][0] + b1 * p[1][0] + b2 * p[2][0] + b3 * p[3][0];
+        pos[a1] = b0 * p[0][1] + b1 * p[1][1] + b2 * p[2][1] + b3 * p[3][1];
+        pos[a2] = linear_start + linear_travel * t;
+    };
+
+    // the curve parameter at the end of the segment starting at t. The segments are mm_per_arc_segment long, or if
+    // mm_max_arc_error is set as long as the local curvature allows, and there are at least 8 so the curvature is looked
+    // at often enough
+    auto next_t = [&](float t) {
+        float mt = 1 - t, d[2], dd[2];
+        for (int i = 0; i < 2; i++) {
+            d[i] = 3 * (mt * mt * (p[1][i] - p[0][i]) + 2 * mt * t * (p[2][i] - p[1][i]) + t * t * (p[3][i] - p[2][i]));
+            dd[i] = 6 * (mt * (p[2][i] - 2 * p[1][i] + p[0][i]) + t * (p[3][i] - 2 * p[2][i] + p[1][i]));
+        }
+        float speed = hypotf(d[0], d[1]);
+
+        float mm = this->mm_per_arc_segment;
+        if(this->mm_max_arc_error > 0.0F) {
+            // the chord that is mm_max_arc_error off a circle with the radius of curvature, which is speed^3 / cross
+            float cross = fabsf(d[0] * dd[1] - d[1] * dd[0]);
+            mm = cross > 0 ? sqrtf(8 * this->mm_max_arc_error * speed * speed * speed / cross) : INFINITY;
+        }
+
+        float dt = speed > 0 ? mm / speed : 1;
+        return min(1.0F, t + max(1.0F / 65535, min(dt, 0.125F)));
+    };
+
+    // Find the distance for this gcode, Extruder needs it before any of it is queued
+    float from[3], to[3];
+    float length = 0;
+    point(0, from);
+    for (float t = 0; t < 1; ) {
+        t = next_t(t);
+        point(t, to);
+        length += sqrtf(powf(to[X_AXIS] - from[X_AXIS], 2) + powf(to[Y_AXIS] - from[Y_AXIS], 2) + powf(to[Z_AXIS] - from[Z_AXIS], 2));
+        memcpy(from, to, sizeof(from));
+    }
+    gcode->millimeters_of_travel = length;
+    extra_move_mm= length;
+    extra_move_done= 0.0F;
+
+    // We don't care about non-XYZ moves ( for example the extruder produces some of those )
+    if( gcode->millimeters_of_travel < 0.00001F ) {
+        return false;
+    }
+
+    // Mark the gcode as having a known distance
+    this->distance_in_gcode_is_known( gcode );
+
+    // The segments are queued the same way as an arc's, but every one is a different length
+    float rate_mm_s = this->feed_rate / seconds_per_minute;
+    float points[segment_batch_size][3];
+    int n = 0;
+    bool moved = false;
+    for (float t = next_t(0); t < 1; t = next_t(t)) {
+        point(t, points[n]);
+        if(++n == segment_batch_size) {
+            if(this->append_path_segments(points, n, rate_mm_s, 0)) moved= true;
+            if(THEKERNEL->is_halted()) return false; // don't queue any more segments
+            n = 0;
+        }
+    }
+    if(n > 0 && this->append_path_segments(points, n, rate_mm_s, 0)) moved= true;
+    if(THEKERNEL->is_halted()) return false;
+
+    // Ensure last segment arrives at target location.
+    if(this->append_milestone(gcode, target, rate_mm_s)) moved= true;
+
+    return moved;
+}
+
 
 float Robot::theta(float x, float y)
 {
@@ -13,11 +13,13 @@ using std::string;
 #include <string.h>
 #include <functional>
 #include <stack>
+#include <vector>
 
 #include "libs/Module.h"
 #include "ActuatorCoordinates.h"
 
 class Gcode;
+class StreamOutput;
 class BaseSolution;
 class StepperMotor;
 
@@ -30,14 +32,25 @@ class Robot : public Module {
         Robot();
         void on_module_loaded();
         void on_gcode_received(void* argument);
+        void on_idle(void* argument);
+        void on_main_loop(void* argument);
+        void on_halt(void* argument);
 
         void reset_axis_position(float position, int axis);
         void reset_axis_position(float x, float y, float z);
         void reset_actuator_position(const ActuatorCoordinates &ac);
         void reset_position_from_current_actuator_position();
+        // a grbl $J= jog, the words of the move after the =, false if they are not a jog
+        bool jog(const char *line);
+        // the grbl jog cancel realtime byte, safe to call from the serial interrupts
+        void cancel_jog();
         float get_seconds_per_minute() const { return seconds_per_minute; }
         float get_z_maxfeedrate() const { return this->max_speeds[2]; }
+        float get_max_speed(int axis) const { return this->max_speeds[axis]; }
+        uint16_t get_arc_segments(float millimeters, float radius, float angular_travel) const;
         void setToolOffset(const float offset[3]);
+        // lifts Z by mm from the next move on, which ramps up to it, 0 has the next move come back down
+        void set_zhop(float mm) { zhop= mm; }
         float get_feed_rate() const;
         void  push_state();
         void  pop_state();
@@ -46,19 +59,48 @@ class Robot : public Module {
         float from_millimeters( float value) const { return this->inch_mode ? value/25.4F : value;  }
         void get_axis_position(float position[]) const { memcpy(position, this->last_milestone, sizeof this->last_milestone); }
         wcs_t get_axis_position() const { return wcs_t(last_milestone[0], last_milestone[1], last_milestone[2]); }
-        int print_position(uint8_t subcode, char *buf, size_t bufsize) const;
+        int print_position(uint8_t subcode, char *buf, size_t bufsize);
+        void get_realtime_position(float mpos[3], ActuatorCoordinates *apos= nullptr);
         uint8_t get_current_wcs() const { return current_wcs; }
         std::vector<wcs_t> get_wcs_state() const;
         std::tuple<float, float, float, uint8_t> get_last_probe_position() const { return last_probe_position; }
         void set_last_probe_position(std::tuple<float, float, float, uint8_t> p) { last_probe_position = p; }
 
+        // used to compile a job (see CompiledJob), while recording the segments are passed to the recorder instead of the planner
+        using segment_recorder_t= std::function<void(const ActuatorCoordinates &actuator_pos, float rate_mm_s, float millimeters_of_travel, const float unit_vec[])>;
+        void begin_recording(segment_recorder_t recorder);
+        void end_recording();
+        uint32_t get_kinematics_hash() const;
+
+        // the position and rates a compiled job needs to keep in sync with the segments it queues
+        struct motion_state_t {
+            float last_milestone[3];
+            float last_machine_position[3];
+            float feed_rate;
+            float seek_rate;
+        };
+        void get_motion_state(motion_state_t &ms) const;
+        void set_motion_state(const motion_state_t &ms);
+        void flush_pending_move();                            // queue any held back merged move
+        bool is_move_held() const { return merge_pending; }
+        bool append_machine_move(const float target[], float rate_mm_s);
+
         BaseSolution* arm_solution;                           // Selected Arm solution ( millimeters to step calculation )
 
-        // gets accessed by Panel, Endstops, ZProbe
-        std::array<StepperMotor*, k_max_actuators> actuators;
+        // gets accessed by Panel, Endstops, ZProbe, only the configured actuators are in it
+        std::vector<StepperMotor*> actuators;
+        size_t get_extra_axes() const { return n_extra_axes; }
+        // an extruder whose motor is planned as an extra axis moved by letter, returns the index of the axis or -1 if there is no room
+        int add_extra_axis(char letter, StepperMotor *motor);
+        // what the words of the axis are multiplied by to get its actuator position, the flow rate and volumetric extrusion
+        void set_extra_axis_scale(int j, float scale) { extra_scale[j]= scale; }
+        float get_extra_requested(int j) const { return extra_requested[j]; }
+        // queues a move of only that axis, by mm of its actuator, for a firmware retract
+        bool move_extra_axis(int j, float mm, float rate_mm_s);
 
         // set by a leveling strategy to transform the target of a move according to the current plan
         std::function<void(float[3])> compensationTransform;
+        bool compensation_is_z_offset{false};   // set when it only adds to Z an offset that depends on X and Y
 
         // Workspace coordinate systems
         wcs_t mcs2wcs(const wcs_t &pos) const;
@@ -70,6 +112,8 @@ class Robot : public Module {
             bool next_command_is_MCS:1;                       // set by G53
             bool disable_segmentation:1;                      // set to disable segmentation
             bool segment_z_moves:1;
+            bool merge_pending:1;                             // a merged move is being held back
+            bool e_absolute:1;                                // an E axis has M82 and M83 as well as G90 and G91
             uint8_t plane_axis_0:2;                           // Current plane ( XY, XZ, YZ )
             uint8_t plane_axis_1:2;
             uint8_t plane_axis_2:2;
@@ -79,9 +123,18 @@ class Robot : public Module {
         void load_config();
         void distance_in_gcode_is_known(Gcode* gcode);
         bool append_milestone( Gcode *gcode, const float target[], float rate_mm_s);
+        bool merge_move(Gcode *gcode, const float target[], float rate_mm_s);
+        bool append_segments(const float segment_delta[], uint16_t segments, float rate_mm_s);
+        bool append_path_segments(float points[][3], int n, float rate_mm_s, float segment_mm);
+        void append_segment(const float pos[], ActuatorCoordinates &actuator_pos, float rate_mm_s, float millimeters_of_travel, float unit_vec[]);
+        bool segment_vector(const float pos[], float unit_vec[], float &millimeters) const;
+        float extra_move_distance() const;
+        void sync_extra_actuators();
+        float limit_cartesian_rate(const float unit_vec[], float rate_mm_s) const;
         bool append_line( Gcode* gcode, const float target[], float rate_mm_s);
         bool append_arc( Gcode* gcode, const float target[], const float offset[], float radius, bool is_clockwise );
         bool compute_arc(Gcode* gcode, const float offset[], const float target[]);
+        bool compute_bezier(Gcode* gcode, const float offset[], const float target[]);
         void process_move(Gcode *gcode);
 
         float theta(float x, float y);
@@ -93,11 +146,15 @@ class Robot : public Module {
         uint8_t current_wcs{0}; // 0 means G54 is enabled this is persistent once saved with M500
         wcs_t g92_offset;
         wcs_t tool_offset; // used for multiple extruders, sets the tool offset for the current extruder applied first
+        float zhop;        // added to Z of the moves, set by a firmware retract
+        float zhop_applied; // the part of it last_milestone has
         std::tuple<float, float, float, uint8_t> last_probe_position{0,0,0,0};
 
         using saved_state_t= std::tuple<float, float, bool, bool, uint8_t>; // save current feedrate and absolute mode, inch mode, current_wcs
         std::stack<saved_state_t> state_stack;               // saves state from M120
 
+        static const int segment_batch_size= 8;          // number of line segments converted to actuator positions at once
+
         float last_milestone[3]; // Last requested position, in millimeters, which is what we were requested to move to in the gcode after offsets applied but before compensation transform
         float last_machine_position[3]; // Last machine position, which is the position before converting to actuator coordinates (includes compensation transform)
         int8_t motion_mode;                                  // Motion mode for the current received Gcode
@@ -105,10 +162,11 @@ class Robot : public Module {
         float feed_rate;                                     // Current rate for feeding moves ( mm/s )
         float mm_per_line_segment;                           // Setting : Used to split lines into segments
         float mm_per_arc_segment;                            // Setting : Used to split arcs into segments
+        float mm_max_arc_error;                              // Setting : If set arcs are split so no chord is further than this off the arc
         float delta_segments_per_second;                     // Setting : Used to split lines into segments for delta based on speed
         float seconds_per_minute;                            // for realtime speed change
 
-        // Number of arc generation iterations by small angle approximation before exact arc trajectory
+        // Number of arc generation iterations by incremental rotation before exact arc trajectory
         // correction. This parameter may be decreased if there are issues with the accuracy of the arc
         // generations. In general, the default value is more than enough for the intended CNC applications
         // of grbl, and should be on the order or greater than the size of the buffer to help with the
@@ -116,6 +174,46 @@ class Robot : public Module {
         int arc_correction;                                   // Setting : how often to rectify arc computation
         float max_speeds[3];                                 // Setting : max allowable speed in mm/m for each axis
 
+        // collinear move merging
+        float merge_tolerance;                               // Setting : max distance in mm end points may be off the merged line, 0 disables
+        float merge_max_length;                              // Setting : longest merged move in mm
+        float pending_start[3];                              // where the held back move starts
+        float pending_unit_vec[3];                           // direction of the first merged move
+        float pending_rate;
+        Gcode *pending_gcode;                                // copy of the last merged gcode, attached to the block when queued
+
+        // the last real time position worked out, see get_realtime_position()
+        struct {
+            ActuatorCoordinates apos;
+            float mpos[3];
+            uint32_t us;
+            uint32_t interval_us;                            // Setting : from position_report_rate
+            bool valid;
+        } fk_cache;
+
+        // jogging, the blocks of a jog are queued no more than jog_queue_depth deep so a cancel has little to throw away
+        uint8_t jog_queue_depth;
+        volatile bool jogging;                               // a jog is queued, until the queue is empty
+        volatile bool jog_cancel;                            // the cancel byte came, the main loop flushes the jog
+        volatile bool jog_hold;                              // and the feed hold that starts it slowing down is ours
+
+        // the A, B and C axes, each drives one of the actuators after those of the arm solution
+        uint8_t n_extra_axes;
+        bool extra_moving;                                   // the move being queued moves them
+        std::array<char, k_max_extra_axes> extra_letter;
+        std::array<float, k_max_extra_axes> extra_requested; // last position the gcode asked for
+        std::array<float, k_max_extra_axes> extra_scale;     // from that to the actuator position, 1 apart from an E axis
+        std::array<float, k_max_extra_axes> extra_milestone; // last requested position of each actuator
+        std::array<float, k_max_extra_axes> extra_start;     // where they are at the start of the move being queued
+        std::array<float, k_max_extra_axes> extra_delta;     // and how far they go in it
+        float extra_move_mm;                                 // length of that move, they move in proportion to the travel along it
+        float extra_move_done;
+
+        // recording a compiled job, restored by end_recording()
+        struct recording_state_t;
+        segment_recorder_t segment_recorder;
+        recording_state_t *recording_state{nullptr};
+
         // Used by Stepper, Planner
         friend class Planner;
         friend class Stepper;
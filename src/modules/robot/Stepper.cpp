@@ -20,6 +20,9 @@
 #include "Gcode.h"
 #include "Block.h"
 #include "StepTicker.h"
+#include "StreamOutputPool.h"
+#include "GcodePool.h"
+#include "FastCode.h"
 
 #include <vector>
 using namespace std;
@@ -28,6 +31,17 @@ using namespace std;
 #include "libs/Hook.h"
 
 #include <mri.h>
+#include <math.h>
+
+#define acceleration_mode_checksum CHECKSUM("acceleration_mode")
+#define step_distribution_checksum CHECKSUM("step_distribution")
+
+// input shaping, the type for each axis is none, zv, zvd or mzv
+static const uint16_t shaper_checksums[3][3] = {
+    {CHECKSUM("x_axis_shaper"), CHECKSUM("x_axis_shaper_frequency"), CHECKSUM("x_axis_shaper_damping")},
+    {CHECKSUM("y_axis_shaper"), CHECKSUM("y_axis_shaper_frequency"), CHECKSUM("y_axis_shaper_damping")},
+    {CHECKSUM("z_axis_shaper"), CHECKSUM("z_axis_shaper_frequency"), CHECKSUM("z_axis_shaper_damping")},
+};
 
 // The stepper reacts to blocks that have XYZ movement to transform them into actual stepper motor moves
 // TODO: This does accel, accel should be in StepperMotor
@@ -35,8 +49,24 @@ using namespace std;
 Stepper::Stepper()
 {
     this->current_block = NULL;
+    this->dwell_block = NULL;
+    this->next_block = NULL;
+    this->handoff_block = NULL;
+    this->dwell_ticks = 0;
+    this->fx_rate_limit = 0;
+    this->fx_hold_rate = 0;
+    this->hold_speed = 0.0F;
     this->force_speed_update = false;
     this->halted= false;
+    this->per_step_acceleration= false;
+    this->shaping= false;
+    this->queue_mode= false;
+    this->bresenham= false;
+    this->main_index= 0;
+    this->runs_stopped= false;
+    this->hold_stopped= false;
+    this->late_runs= 0;
+    this->run_plan.seq= 0;
 }
 
 //Called when the module has just been loaded
@@ -50,9 +80,15 @@ void Stepper::on_module_loaded()
 
     // Get onfiguration
     this->on_config_reload(this);
+    if(this->queue_mode) this->register_for_event(ON_IDLE);
+
+    // the step frequency is set before the modules load
+    this->fx_ticks_numerator= floorf(StepperMotor::fx_increment * THEKERNEL->step_ticker->get_frequency());
+    for (size_t i = 0; i < k_max_actuators; i++) this->max_ticks_min_rate[i]= 0.0F;
 
     // Acceleration ticker
-    THEKERNEL->step_ticker->register_acceleration_tick_handler([this](){trapezoid_generator_tick(); });
+    THEKERNEL->step_ticker->register_acceleration_tick_handler([](void *s){ static_cast<Stepper *>(s)->trapezoid_generator_tick(); }, this, "RIT stepper");
+    THEKERNEL->step_ticker->register_handoff_hook([this](){on_handoff(); });
 
     // Attach to the end_of_move stepper event
     for (auto actuator : THEKERNEL->robot->actuators)
@@ -64,6 +100,40 @@ void Stepper::on_config_reload(void *argument)
 {
     // Steppers start off by default
     this->turn_enable_pins_off();
+
+    // tick (the default) updates the rate acceleration_ticks_per_second times per second,
+    // step updates it after every step of the main stepper while accelerating or decelerating,
+    // queue works out the step intervals of each actuator in the main loop and queues them ahead of the step interrupt
+    string mode= THEKERNEL->config->value(acceleration_mode_checksum)->by_default("tick")->as_string();
+    this->per_step_acceleration= mode == "step";
+    this->queue_mode= mode == "queue";
+    for (auto a : THEKERNEL->robot->actuators)
+        a->enable_runs(this->queue_mode);
+
+    // rates (the default) times each actuator at its share of the rate of the main stepper, bresenham only times the
+    // main stepper and steps the others from integer counters of its steps, so they all end exactly on its last step
+    this->bresenham= THEKERNEL->config->value(step_distribution_checksum)->by_default("rates")->as_string() == "bresenham";
+    if(this->bresenham && this->queue_mode) {
+        THEKERNEL->streams->printf("WARNING: step_distribution bresenham does not work with acceleration_mode queue, it is off\n");
+        this->bresenham= false;
+    }
+
+    // the shapers of each axis are combined into the one that filters the rate of the main stepper
+    this->shaper.clear();
+    for (int a = 0; a < 3; ++a) {
+        InputShaper::SHAPER_TYPE type= InputShaper::type_from_string(THEKERNEL->config->value(shaper_checksums[a][0])->by_default("none")->as_string().c_str());
+        if(type == InputShaper::NONE) continue;
+        float frequency= THEKERNEL->config->value(shaper_checksums[a][1])->by_default(0.0F)->as_number();
+        float damping= THEKERNEL->config->value(shaper_checksums[a][2])->by_default(0.1F)->as_number();
+        if(!this->shaper.add(type, frequency, damping)) {
+            THEKERNEL->streams->printf("WARNING: the %c axis shaper was not added, check its frequency and damping\n", 'X' + a);
+        }
+    }
+    this->shaping= this->shaper.is_enabled();
+    if(this->shaping && (this->per_step_acceleration || this->queue_mode)) {
+        THEKERNEL->streams->printf("WARNING: input shaping needs acceleration_mode tick, it is off\n");
+        this->shaping= false;
+    }
 }
 
 void Stepper::on_halt(void *argument)
@@ -71,11 +141,26 @@ void Stepper::on_halt(void *argument)
     if(argument == nullptr) {
         this->turn_enable_pins_off();
         this->halted= true;
+        this->shaper.reset();
+        // the queue is flushed, whatever was held is dropped
+        THEKERNEL->step_ticker->cancel_handoff();
+        THEKERNEL->step_ticker->set_followers(nullptr, 0);
+        this->next_block= NULL;
+        this->hold_stopped= false;
+        this->fx_hold_rate= 0;
+        this->hold_speed= 0.0F;
+        THEKERNEL->step_ticker->hold_steps(false);
     }else{
         this->halted= false;
     }
 }
 
+// the main loop keeps the runs of the current block queued
+void Stepper::on_idle(void *argument)
+{
+    if(this->queue_mode) this->fill_runs(StepperMotor::max_runs);
+}
+
 void Stepper::on_gcode_received(void *argument)
 {
     Gcode *gcode = static_cast<Gcode *>(argument);
@@ -123,6 +208,10 @@ void Stepper::on_block_begin(void *argument)
 {
     Block *block  = static_cast<Block *>(argument);
 
+    // the motors may already be moving it, from the tick the last block ended in
+    bool handed_off= block == this->handoff_block;
+    this->handoff_block= NULL;
+
     // Mark the new block as of interrest to us, handle blocks that have no axis moves properly (like Extrude blocks etc)
     bool take = false;
     if (block->millimeters > 0.0F) {
@@ -137,6 +226,13 @@ void Stepper::on_block_begin(void *argument)
         for(auto a : THEKERNEL->robot->actuators) {
             a->set_moved_last_block(false);
         }
+
+        // a dwell holds the queue until the acceleration tick has counted it down
+        if(block->dwell_ms > 0 && !this->halted) {
+            block->take();
+            this->dwell_ticks = std::max((uint64_t)1, (uint64_t)block->dwell_ms * THEKERNEL->acceleration_ticks_per_second / 1000);
+            this->dwell_block = block;
+        }
         return;
     }
 
@@ -151,11 +247,17 @@ void Stepper::on_block_begin(void *argument)
     int most_steps_to_move = 0;
     for (size_t i = 0; i < THEKERNEL->robot->actuators.size(); i++) {
         if (block->steps[i] > 0) {
-            THEKERNEL->robot->actuators[i]->move(block->direction_bits[i], block->steps[i])->set_moved_last_block(true);
+            if(!handed_off) {
+                // the driver is switched to the microsteps of the block while the motor is still
+                THEKERNEL->robot->actuators[i]->begin_microsteps(block->microstep_shift[i]);
+                THEKERNEL->robot->actuators[i]->move(block->direction(i), block->steps[i]);
+            }
+            THEKERNEL->robot->actuators[i]->set_moved_last_block(true);
             int steps_to_move = THEKERNEL->robot->actuators[i]->get_steps_to_move();
             if (steps_to_move > most_steps_to_move) {
                 most_steps_to_move = steps_to_move;
                 this->main_stepper = THEKERNEL->robot->actuators[i];
+                this->main_index = i;
             }
         }
         else {
@@ -165,9 +267,37 @@ void Stepper::on_block_begin(void *argument)
 
     this->current_block = block;
 
+    if(this->bresenham) {
+        // the others do not step before the rate of the main stepper is set below
+        uint32_t followers= 0;
+        for (size_t i = 0; i < THEKERNEL->robot->actuators.size(); i++) {
+            StepperMotor *a= THEKERNEL->robot->actuators[i];
+            if(block->steps[i] > 0 && a != this->main_stepper) followers |= 1 << a->index;
+        }
+        THEKERNEL->step_ticker->set_followers(this->main_stepper, followers);
+    }
+
     // Setup acceleration for this block
     this->trapezoid_generator_reset();
 
+    if(this->queue_mode && !this->runs_stopped) {
+        // the first runs are queued now, the main loop queues the rest
+        this->reset_runs();
+        this->fill_runs(4);
+        THEKERNEL->call_event(ON_SPEED_CHANGE, this);
+        return;
+    }
+
+    if(this->shaping) {
+        // the moves carry on at the shaped speed the last block ended with, the tick takes it from there
+        // the acceleration tick is not synchronized to the block as the shaper delays are counted in ticks
+        this->shaper.begin_block(block);
+        this->force_speed_update= false;
+        this->fx_trapezoid_rate= this->shaper.get_fx_rate();
+        this->set_step_events_per_second(this->fx_trapezoid_rate);
+        return;
+    }
+
     // Set the initial speed for this move
     this->trapezoid_generator_tick();
 
@@ -183,7 +313,16 @@ void Stepper::on_block_begin(void *argument)
 // Current block is discarded
 void Stepper::on_block_end(void *argument)
 {
+    Block *block  = static_cast<Block *>(argument);
+    if(block == this->current_block) {
+        // a feed hold is not over with the block, the next one takes it on at the same speed
+        this->hold_speed= (this->fx_hold_rate > 0) ? (float)this->fx_hold_rate / (1 << Block::fx_rate_shift) * block->millimeters / block->steps_event_count : 0.0F;
+        THEKERNEL->step_ticker->cancel_handoff();
+        THEKERNEL->step_ticker->set_followers(nullptr, 0);
+        this->next_block = NULL;
+    }
     this->current_block = NULL; //stfu !
+    this->dwell_block = NULL;
 }
 
 // When a stepper motor has finished it's assigned movement
@@ -204,71 +343,211 @@ uint32_t Stepper::stepper_motor_finished_move(uint32_t dummy)
 }
 
 
+// the moves of a block can start before its gcodes are executed if those are only the moves it is made of
+static bool only_moves(Block *block)
+{
+    for (GcodeSlot *s = block->gcodes; s != nullptr; s = s->next) {
+        const Gcode *g= s->gcode();
+        if(g->has_m || !g->has_g || g->g > 3) return false;
+    }
+    return true;
+}
+
+// with nothing else to do as the next block begins, its moves are set up so the step ISR starts them in the tick the last
+// moves of this one end, instead of after PendSV has ended this block and begun the next. The block has to be held by the
+// Stepper alone so it ends once its moves do, and the next one has to be a move with nothing but moves to execute as it begins
+void Stepper::prepare_handoff()
+{
+    const Block *b= this->current_block;
+    // the followers are set up as the block begins
+    if(this->bresenham) return;
+    if(this->halted || this->fx_hold_rate > 0 || THEKERNEL->get_feed_hold() || b->times_taken != 1) return;
+    Block *next= THEKERNEL->conveyor->get_next_block();
+    if(next == nullptr || !next->is_ready || next->dwell_ms > 0 || next->millimeters <= 0.0F || !only_moves(next)) return;
+    if(next->initial_rate == 0 || next->initial_rate > next->nominal_rate) return;
+    // switching the microsteps of a driver has to wait for the block to begin
+    for (size_t i = 0; i < THEKERNEL->robot->actuators.size(); i++) {
+        if(next->steps[i] > 0 && next->microstep_shift[i] != THEKERNEL->robot->actuators[i]->get_microstep_shift()) return;
+    }
+
+    // each starts at its share of the initial rate, the next block sets the rates as soon as it begins
+    update_max_ticks();
+    uint32_t fx_main_ticks= main_ticks_per_step(next->initial_rate << Block::fx_rate_shift);
+    uint32_t wait= 0, start= 0;
+    for (size_t i = 0; i < THEKERNEL->robot->actuators.size(); i++) {
+        StepperMotor *a= THEKERNEL->robot->actuators[i];
+        if(b->steps[i] > 0) wait |= 1 << a->index;
+        if(next->steps[i] == 0) continue;
+        a->set_next_move(next->direction(i), next->steps[i], actuator_ticks_per_step(next, i, fx_main_ticks));
+        start |= 1 << a->index;
+    }
+    if(start == 0) return;
+    this->next_block= next;
+    THEKERNEL->step_ticker->arm_handoff(wait, start);
+}
+
+// called from PendSV once the step ISR has started the moves of the next block, this block is over
+void Stepper::on_handoff()
+{
+    this->handoff_block= this->next_block;
+    this->next_block= NULL;
+    if(this->current_block != NULL) this->current_block->release();
+}
+
 // This is called ACCELERATION_TICKS_PER_SECOND times per second by the step_event
 // interrupt. It can be assumed that the trapezoid-generator-parameters and the
 // current_block stays untouched by outside handlers for the duration of this function call.
 // NOTE caled at the same priority as PendSV so it may make that longer but it is better that having htis pre empted by pendsv
-void Stepper::trapezoid_generator_tick(void)
+// The rates are fixed point with Block::fx_rate_shift fractional bits so there is no float math here
+FAST_CODE void Stepper::trapezoid_generator_tick(void)
 {
+    // count down a dwell, it finishes early if the queue is flushed
+    if(this->dwell_block != NULL) {
+        if(this->shaping) this->shaper.shape(0);
+        if(--this->dwell_ticks == 0 || THEKERNEL->conveyor->is_flushing() || this->halted) {
+            Block *block = this->dwell_block;
+            this->dwell_block = NULL;
+            block->release();
+        }
+        return;
+    }
+
     // Do not do the accel math for nothing
     if(this->current_block && this->main_stepper->moving ) {
 
+        if(this->hold_stopped) {
+            // stopped part way through the block until the feed hold is over
+            if(THEKERNEL->get_feed_hold() && !THEKERNEL->conveyor->is_flushing()) return;
+            this->hold_stopped= false;
+            THEKERNEL->step_ticker->hold_steps(false);
+        }
+
+        if(this->next_block == NULL && !THEKERNEL->conveyor->is_flushing()) this->prepare_handoff();
+
+        if(this->queue_mode && !this->runs_stopped && !THEKERNEL->conveyor->is_flushing()) {
+            // the runs set the rates, this only tops them up when the main loop has fallen behind
+            if(this->fill_runs(4) > 0) ++this->late_runs;
+            // and keeps the rate up to date for the others that follow it
+            uint32_t fx_rate= (this->fx_ticks_numerator / this->main_stepper->fx_ticks_per_step) << Block::fx_rate_shift;
+            if(fx_rate != this->fx_trapezoid_rate) {
+                this->fx_trapezoid_rate= fx_rate;
+                THEKERNEL->call_event(ON_SPEED_CHANGE, this);
+            }
+            return;
+        }
+
         // Store this here because we use it a lot down there
         uint32_t current_steps_completed = this->main_stepper->stepped;
-        float last_rate= trapezoid_adjusted_rate;
+        uint32_t last_rate= fx_trapezoid_rate;
+        uint32_t last_profile_rate= fx_profile_rate;
+        // the shaped moves lag behind the trapezoid, which is worked out where it would be without shaping
+        if(this->shaping) current_steps_completed += this->shaper.lag_steps();
+        const uint32_t rate_delta= current_block->fx_rate_delta;
 
         if( this->force_speed_update ) {
             // Do not accel, just set the value
             this->force_speed_update = false;
-            last_rate= -1;
+            last_rate= 0; // never a valid rate
 
         } else if(THEKERNEL->conveyor->is_flushing()) {
             // if we are flushing the queue, decelerate to 0 then finish this block
-            if (trapezoid_adjusted_rate > current_block->rate_delta * 1.5F) {
-                trapezoid_adjusted_rate -= current_block->rate_delta;
+            // this is not shaped, it stops from whatever the speed is now
+            main_stepper->accel_every_step= false; // this is done per acceleration tick
+            this->fx_hold_rate= 0;
+            THEKERNEL->step_ticker->cancel_handoff();
+            this->next_block= NULL;
+            if(this->queue_mode) {
+                // the queued runs are dropped, the rate is set here from now on
+                for (auto a : THEKERNEL->robot->actuators) a->stop_runs();
+            }
+            fx_profile_rate= fx_trapezoid_rate;
+            if (fx_profile_rate > rate_delta + rate_delta / 2) {
+                fx_profile_rate -= rate_delta;
 
-            } else if (trapezoid_adjusted_rate == current_block->rate_delta * 0.5F) {
+            } else if (fx_profile_rate == rate_delta / 2) {
                 for (auto i : THEKERNEL->robot->actuators) i->move(i->direction, 0); // stop motors
                 if (current_block) current_block->release();
+                if (this->shaping) this->shaper.reset();
                 THEKERNEL->call_event(ON_SPEED_CHANGE, 0); // tell others we stopped
                 return;
 
             } else {
-                trapezoid_adjusted_rate = current_block->rate_delta * 0.5F;
+                fx_profile_rate = rate_delta / 2;
             }
 
-        } else if(current_steps_completed <= this->current_block->accelerate_until) {
-            // If we are accelerating
-            // Increase speed
-            this->trapezoid_adjusted_rate += this->current_block->rate_delta;
-            if (this->trapezoid_adjusted_rate > this->current_block->nominal_rate ) {
-                this->trapezoid_adjusted_rate = this->current_block->nominal_rate;
-            }
+        } else if(this->per_step_acceleration) {
+            // the rate follows the step count, we get called after each step while it changes
+            fx_profile_rate= per_step_rate(current_steps_completed) << Block::fx_rate_shift;
+            main_stepper->accel_every_step= current_steps_completed <= current_block->accelerate_until || current_steps_completed > current_block->decelerate_after;
+
+        } else if(this->shaping && current_steps_completed >= this->current_block->steps_event_count) {
+            // the trapezoid is already past the end of this block, it holds the speed the next one starts at
+            this->fx_profile_rate = this->current_block->final_rate << Block::fx_rate_shift;
 
-        } else if (current_steps_completed > this->current_block->decelerate_after) {
-            // If we are decelerating
-            // Reduce speed
-            // NOTE: We will only reduce speed if the result will be > 0. This catches small
-            // rounding errors that might leave steps hanging after the last trapezoid tick.
-            if(this->trapezoid_adjusted_rate > this->current_block->rate_delta * 1.5F) {
-                this->trapezoid_adjusted_rate -= this->current_block->rate_delta;
+        } else {
+            this->fx_profile_rate = profile_rate(this->current_block, current_steps_completed, this->fx_profile_rate, this->s_curve);
+        }
+
+        if(!THEKERNEL->conveyor->is_flushing() && (this->fx_hold_rate > 0 || THEKERNEL->get_feed_hold())) {
+            // a feed hold ramps down from the rate now to a stop at the acceleration of the block, and back up after
+            const uint32_t min_rate= rate_delta + rate_delta / 2;
+            bool hold= THEKERNEL->get_feed_hold();
+            if(this->fx_hold_rate == 0) {
+                THEKERNEL->step_ticker->cancel_handoff();
+                this->next_block= NULL;
+                // the runs set the rate in queue mode, otherwise it is the trapezoid before it is shaped
+                this->fx_hold_rate= std::max((this->queue_mode && !this->runs_stopped) ? last_rate : last_profile_rate, min_rate + rate_delta);
+                if(this->queue_mode && !this->runs_stopped) {
+                    // the queued runs are dropped, the rate is set here for the rest of the block
+                    for (auto a : THEKERNEL->robot->actuators) a->stop_runs();
+                    this->runs_stopped= true;
+                }
+            }
+            if(hold) {
+                this->fx_hold_rate= (this->fx_hold_rate > min_rate + rate_delta) ? this->fx_hold_rate - rate_delta : min_rate;
             } else {
-                this->trapezoid_adjusted_rate = this->current_block->rate_delta * 1.5F;
+                this->fx_hold_rate += rate_delta;
             }
-            if(this->trapezoid_adjusted_rate < this->current_block->final_rate ) {
-                this->trapezoid_adjusted_rate = this->current_block->final_rate;
+            if(this->fx_profile_rate > this->fx_hold_rate) {
+                this->fx_profile_rate= this->fx_hold_rate;
+            } else if(!hold) {
+                // back up to the speed it was planned at, the hold is over
+                this->fx_hold_rate= 0;
             }
+            if(this->per_step_acceleration) main_stepper->accel_every_step= false;
+
+            if(hold && this->fx_hold_rate == min_rate && (!this->shaping || this->shaper.get_fx_rate() <= min_rate)) {
+                // stopped, the motors stay part way through their moves and resume from there
+                THEKERNEL->step_ticker->hold_steps(true);
+                this->hold_stopped= true;
+                this->fx_profile_rate= min_rate;
+                this->fx_trapezoid_rate= 0;
+                THEKERNEL->call_event(ON_SPEED_CHANGE, this);
+                return;
+            }
+        }
+
+        if(this->fx_rate_limit > 0 && !THEKERNEL->conveyor->is_flushing()) {
+            // slowing down for a speed override, at the acceleration of the block and once per tick
+            uint32_t fx_limit= (last_profile_rate > this->fx_rate_limit + rate_delta) ? last_profile_rate - rate_delta : this->fx_rate_limit;
+            if(this->fx_profile_rate > fx_limit) this->fx_profile_rate= fx_limit;
+            if(this->per_step_acceleration) main_stepper->accel_every_step= false;
+        }
 
-        } else if (trapezoid_adjusted_rate != current_block->nominal_rate) {
-            // If we are cruising
-            // Make sure we cruise at exactly nominal rate
-            this->trapezoid_adjusted_rate = this->current_block->nominal_rate;
+        if(this->shaping && !THEKERNEL->conveyor->is_flushing()) {
+            this->fx_trapezoid_rate = this->shaper.shape(this->fx_profile_rate);
+        } else {
+            this->fx_trapezoid_rate = this->fx_profile_rate;
         }
 
-        if(last_rate != trapezoid_adjusted_rate) {
+        if(last_rate != fx_trapezoid_rate) {
             // don't call this if speed did not change
-            this->set_step_events_per_second(this->trapezoid_adjusted_rate);
+            this->set_step_events_per_second(this->fx_trapezoid_rate);
         }
+
+    } else if(this->shaping) {
+        // nothing is moving, the shaped speed settles to zero
+        this->shaper.shape(0);
     }
 }
 
@@ -276,19 +555,215 @@ void Stepper::trapezoid_generator_tick(void)
 // block begins.
 inline void Stepper::trapezoid_generator_reset()
 {
-    this->trapezoid_adjusted_rate = this->current_block->initial_rate;
+    this->fx_profile_rate = this->current_block->initial_rate << Block::fx_rate_shift;
+    this->fx_trapezoid_rate = this->fx_profile_rate;
+    this->fx_rate_limit = 0;
     this->force_speed_update = true;
+    this->s_curve = {0, false};
+    this->runs_stopped = this->queue_mode && (this->hold_speed > 0.0F || THEKERNEL->get_feed_hold());
+    if(this->hold_speed > 0.0F) {
+        const Block *b= this->current_block;
+        uint32_t fx_rate= lroundf(this->hold_speed * b->steps_event_count / b->millimeters * (1 << Block::fx_rate_shift));
+        this->fx_hold_rate= std::max(fx_rate, b->fx_rate_delta + b->fx_rate_delta / 2);
+        this->hold_speed= 0.0F;
+    } else {
+        this->fx_hold_rate= 0;
+    }
+
+    if(this->per_step_acceleration) {
+        // v^2 = u^2 + 2as with s in steps of the main stepper
+        const Block *b= this->current_block;
+        this->acceleration_2= 2 * (((uint64_t)b->fx_rate_delta * THEKERNEL->acceleration_ticks_per_second) >> Block::fx_rate_shift);
+        this->initial_rate2= (uint64_t)b->initial_rate * b->initial_rate;
+        this->final_rate2= (uint64_t)b->final_rate * b->final_rate;
+        uint64_t nominal_rate2= (uint64_t)b->nominal_rate * b->nominal_rate;
+        this->peak_rate2= this->initial_rate2 + (uint64_t)this->acceleration_2 * b->accelerate_until;
+        if(this->peak_rate2 > nominal_rate2) this->peak_rate2= nominal_rate2;
+        this->main_stepper->accel_every_step= true;
+    }
+
+    // the Planner has worked out the step ratios, so a rate change is a divide and a multiply per actuator
+    update_max_ticks();
 }
 
-// Update the speed for all steppers
-void Stepper::set_step_events_per_second( float steps_per_second )
+// an actuator added to the robot after the config was loaded, an extruder planned as an extra axis
+void Stepper::add_actuator(StepperMotor *a)
 {
-    float isps= steps_per_second / this->current_block->steps_event_count;
+    a->attach(this, &Stepper::stepper_motor_finished_move );
+    a->enable_runs(this->queue_mode);
+    update_max_ticks();
+}
+
+// the minimum step rates only change with M205 Y, so the ticks per step at them are only worked out again then
+void Stepper::update_max_ticks()
+{
+    for (size_t i = 0; i < THEKERNEL->robot->actuators.size(); i++) {
+        float min_rate= THEKERNEL->robot->actuators[i]->get_min_rate();
+        if(min_rate == this->max_ticks_min_rate[i]) continue;
+        this->max_ticks_min_rate[i]= min_rate;
+        this->fx_max_ticks_per_step[i]= floorf(StepperMotor::fx_increment * THEKERNEL->step_ticker->get_frequency() / min_rate);
+    }
+}
+
+// the rate of the trapezoid an acceleration tick on from fx_rate, steps_completed steps into the block
+FAST_CODE uint32_t Stepper::profile_rate(const Block *block, uint32_t steps_completed, uint32_t fx_rate, s_curve_t &s)
+{
+    const uint32_t rate_delta= block->fx_rate_delta;
+    const uint32_t nominal_rate= block->nominal_rate << Block::fx_rate_shift;
+
+    if(steps_completed <= block->accelerate_until) {
+        // If we are accelerating
+        // Increase speed
+        if(block->jerk_ticks > 0) {
+            // the S-curve gets to the peak rate at about the step the trapezoid would
+            fx_rate = (block->initial_rate << Block::fx_rate_shift) + block->accel_ramp.delta(++s.ticks);
+        } else {
+            fx_rate += rate_delta;
+        }
+        if (fx_rate > nominal_rate ) {
+            fx_rate = nominal_rate;
+        }
+
+    } else if (steps_completed > block->decelerate_after) {
+        // If we are decelerating
+        // Reduce speed
+        // NOTE: We will only reduce speed if the result will be > 0. This catches small
+        // rounding errors that might leave steps hanging after the last trapezoid tick.
+        if(block->jerk_ticks > 0) {
+            if(!s.decelerating) {
+                s.decelerating = true;
+                s.ticks = 0;
+            }
+            // where the acceleration ramp got to
+            uint32_t peak_rate = (block->initial_rate << Block::fx_rate_shift) + block->accel_ramp.fx_delta;
+            uint32_t d = block->decel_ramp.delta(++s.ticks);
+            fx_rate = (peak_rate > d) ? peak_rate - d : 0;
+            if(fx_rate < rate_delta + rate_delta / 2) {
+                fx_rate = rate_delta + rate_delta / 2;
+            }
+        } else if(fx_rate > rate_delta + rate_delta / 2) {
+            fx_rate -= rate_delta;
+        } else {
+            fx_rate = rate_delta + rate_delta / 2;
+        }
+        uint32_t final_rate= block->final_rate << Block::fx_rate_shift;
+        if(fx_rate < final_rate ) {
+            fx_rate = final_rate;
+        }
+
+    } else {
+        // If we are cruising
+        // Make sure we cruise at exactly nominal rate
+        fx_rate = nominal_rate;
+    }
+    return fx_rate;
+}
+
+// integer square root, the rates squared do not fit in 32 bits
+static uint32_t isqrt64(uint64_t v)
+{
+    uint64_t r= 0;
+    uint64_t bit= (uint64_t)1 << 62;
+    while(bit > v) bit >>= 2;
+    while(bit != 0) {
+        if(v >= r + bit) {
+            v -= r + bit;
+            r= (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return r;
+}
+
+// the rate of the main stepper after the given number of steps in this block, in steps/sec
+FAST_CODE uint32_t Stepper::per_step_rate(uint32_t steps_completed) const
+{
+    const Block *b= this->current_block;
+    uint64_t r2;
+    if(steps_completed <= b->accelerate_until) {
+        r2= initial_rate2 + (uint64_t)acceleration_2 * steps_completed;
+        if(r2 > peak_rate2) r2= peak_rate2;
+
+    } else if(steps_completed > b->decelerate_after) {
+        uint64_t d= (uint64_t)acceleration_2 * (steps_completed - b->decelerate_after);
+        r2= (d < peak_rate2) ? peak_rate2 - d : 0;
+        if(r2 < final_rate2) r2= final_rate2;
+
+    } else {
+        return b->nominal_rate;
+    }
+
+    uint32_t r= isqrt64(r2);
+    return r > 0 ? r : 1;
+}
+
+// ticks per step for the main stepper at a fixed point rate
+inline uint32_t Stepper::main_ticks_per_step(uint32_t fx_rate) const
+{
+    uint32_t rate= fx_rate >> Block::fx_rate_shift;
+    if(rate == 0) rate= 1;
+    return this->fx_ticks_numerator / rate;
+}
+
+// the others are scaled by their share of the steps, and go no slower than their minimum rate
+inline uint32_t Stepper::actuator_ticks_per_step(const Block *block, size_t i, uint32_t fx_main_ticks) const
+{
+    uint64_t t= ((uint64_t)fx_main_ticks * block->fx_step_ratio[i]) >> 16;
+    uint32_t max= this->fx_max_ticks_per_step[i];
+    return t > max ? max : (uint32_t)t;
+}
+
+// slows the block being stepped down to factor times the speed it may go at, from the next acceleration tick.
+// returns the speed it can get down to by the time it ends, -1 if it is not slowed down. The queued runs are planned
+// ahead so in queue mode it is not, and the override starts with the next block
+float Stepper::limit_speed(float factor)
+{
+    __disable_irq();
+    const Block *b= this->current_block;
+    if(b == nullptr || this->queue_mode || !this->main_stepper->moving || THEKERNEL->conveyor->is_flushing() || b->nominal_rate == 0) {
+        __enable_irq();
+        return -1.0F;
+    }
+    uint32_t fx_limit= (this->fx_rate_limit > 0) ? this->fx_rate_limit : b->nominal_rate << Block::fx_rate_shift;
+    fx_limit= std::max(b->fx_rate_delta, (uint32_t)(fx_limit * factor));
+    this->fx_rate_limit= fx_limit;
+    float rate= (float)this->fx_trapezoid_rate / (1 << Block::fx_rate_shift);
+    float left= b->steps_event_count - this->main_stepper->stepped;
+    __enable_irq();
+
+    // decelerating from the rate now over the steps left, starting a tick late
+    float ticks_per_second= THEKERNEL->acceleration_ticks_per_second;
+    left= std::max(0.0F, left - rate / ticks_per_second);
+    float end2= rate * rate - 2.0F * b->rate_delta() * ticks_per_second * left;
+    float end= std::max(end2 > 0.0F ? sqrtf(end2) : 0.0F, (float)fx_limit / (1 << Block::fx_rate_shift));
+    return end * b->nominal_speed / b->nominal_rate;
+}
+
+float Stepper::get_trapezoid_adjusted_rate() const
+{
+    return (float)fx_trapezoid_rate / (1 << Block::fx_rate_shift);
+}
+
+// Update the speed for all steppers, the rate is in fixed point steps/sec for the main stepper
+// this does what StepperMotor::set_speed() does without any float math
+FAST_CODE void Stepper::set_step_events_per_second( uint32_t fx_rate )
+{
+    uint32_t fx_main_ticks= main_ticks_per_step(fx_rate);
+
+    if(this->bresenham) {
+        // the others follow it
+        this->main_stepper->fx_ticks_per_step= actuator_ticks_per_step(this->current_block, this->main_index, fx_main_ticks);
+        THEKERNEL->call_event(ON_SPEED_CHANGE, this);
+        return;
+    }
 
     // Instruct the stepper motors
     for (size_t i = 0; i < THEKERNEL->robot->actuators.size(); i++) {
-        if (THEKERNEL->robot->actuators[i]->moving) {
-            THEKERNEL->robot->actuators[i]->set_speed(isps * this->current_block->steps[i]);
+        StepperMotor *a= THEKERNEL->robot->actuators[i];
+        if (a->moving) {
+            a->fx_ticks_per_step= actuator_ticks_per_step(this->current_block, i, fx_main_ticks);
         }
     }
 
@@ -296,4 +771,117 @@ void Stepper::set_step_events_per_second( float steps_per_second )
     THEKERNEL->call_event(ON_SPEED_CHANGE, this);
 }
 
+// start queueing the runs of the block that just began
+void Stepper::reset_runs()
+{
+    this->run_plan.fx_steps= 0;
+    this->run_plan.fx_rate= this->fx_profile_rate;
+    this->run_plan.s_curve= {0, false};
+    for (size_t i = 0; i < THEKERNEL->robot->actuators.size(); i++) {
+        this->run_plan.queued[i]= 0;
+        THEKERNEL->robot->actuators[i]->clear_runs(this->current_block->steps[i] > 0);
+    }
+    this->run_plan.seq++;
+}
 
+// queues the runs of the current block until the main stepper has max_queued of them or all of the block is queued,
+// returns how many acceleration ticks of runs were queued
+// the main loop can be interrupted by the acceleration tick or a new block, so the plan is worked on as a copy that is
+// only kept if nothing else changed it in the meantime
+uint32_t Stepper::fill_runs(uint8_t max_queued)
+{
+    uint32_t fx_interval[k_max_actuators], count[k_max_actuators];
+    int32_t fx_add[k_max_actuators];
+    uint32_t n= 0;
+
+    // a few at a time so a block at a very low rate does not hold up the main loop
+    while(n < StepperMotor::max_runs) {
+        __disable_irq();
+        const Block *block= this->current_block;
+        if(block == nullptr || this->runs_stopped || THEKERNEL->conveyor->is_flushing() || this->main_stepper->queued_runs() >= max_queued) {
+            __enable_irq();
+            break;
+        }
+        run_plan_t plan= this->run_plan;
+        __enable_irq();
+
+        if(!plan_runs(block, plan, fx_interval, fx_add, count)) break;
+
+        __disable_irq();
+        bool keep= plan.seq == this->run_plan.seq && block == this->current_block && !this->runs_stopped;
+        for (size_t i = 0; keep && i < THEKERNEL->robot->actuators.size(); i++) {
+            if(block->steps[i] > 0 && count[i] > 0 && !THEKERNEL->robot->actuators[i]->can_queue_run()) keep= false;
+        }
+        if(keep) {
+            for (size_t i = 0; i < THEKERNEL->robot->actuators.size(); i++) {
+                if(block->steps[i] > 0) THEKERNEL->robot->actuators[i]->queue_run(fx_interval[i], fx_add[i], count[i]);
+            }
+            plan.seq++;
+            this->run_plan= plan;
+        }
+        __enable_irq();
+        if(!keep) break;
+        // a motor whose runs had run dry has its interval again
+        THEKERNEL->step_ticker->reschedule();
+        n++;
+    }
+    return n;
+}
+
+// works out the runs of each moving actuator over the next acceleration tick of the current block, this follows the
+// same trapezoid as the acceleration tick does but the interval changes step by step between the rates at each end
+// returns false once all of the block is queued
+bool Stepper::plan_runs(const Block *block, run_plan_t &plan, uint32_t fx_interval[], int32_t fx_add[], uint32_t count[]) const
+{
+    uint32_t total= block->steps_event_count;
+    uint32_t done= plan.fx_steps >> 16;
+    if(done >= total) return false;
+
+    // a run does not go past the step the trapezoid changes at
+    uint32_t end;
+    if(done <= block->accelerate_until) end= block->accelerate_until + 1;
+    else if(done <= block->decelerate_after) end= block->decelerate_after + 1;
+    else end= total;
+    if(end > total) end= total;
+    uint64_t fx_end= (uint64_t)end << 16;
+
+    uint32_t fx_rate0= plan.fx_rate, fx_rate1;
+    if(done > block->accelerate_until && done <= block->decelerate_after) {
+        // cruising, the rest of it is one run
+        fx_rate0= fx_rate1= block->nominal_rate << Block::fx_rate_shift;
+    } else {
+        fx_rate1= profile_rate(block, done, fx_rate0, plan.s_curve);
+        // the steps over one acceleration tick, at the mean of the rates at each end
+        uint64_t fx_tick_steps= (((uint64_t)fx_rate0 + fx_rate1) << (15 - Block::fx_rate_shift)) / THEKERNEL->acceleration_ticks_per_second;
+        if(fx_tick_steps == 0) fx_tick_steps= 1;
+        if(plan.fx_steps + fx_tick_steps < fx_end) {
+            fx_end= plan.fx_steps + fx_tick_steps;
+        } else {
+            // cut short where the trapezoid changes, the rate there is in proportion
+            fx_rate1= fx_rate0 + ((int64_t)fx_rate1 - fx_rate0) * (int64_t)(fx_end - plan.fx_steps) / (int64_t)fx_tick_steps;
+        }
+    }
+    plan.fx_steps= fx_end;
+    plan.fx_rate= fx_rate1;
+
+    uint32_t fx_main_ticks0= main_ticks_per_step(fx_rate0);
+    uint32_t fx_main_ticks1= main_ticks_per_step(fx_rate1);
+    for (size_t i = 0; i < THEKERNEL->robot->actuators.size(); i++) {
+        uint32_t steps= block->steps[i];
+        if(steps == 0) continue;
+        // each actuator has its share of the steps of the main stepper so they all get to the end together
+        uint32_t queued= (((fx_end >> 8) * steps) / total) >> 8;
+        count[i]= queued - plan.queued[i];
+        plan.queued[i]= queued;
+        uint32_t last= actuator_ticks_per_step(block, i, fx_main_ticks1);
+        if(count[i] == 0) {
+            // an actuator that does not step in this tick just takes up the rate it is at by the end of it
+            fx_interval[i]= last;
+            fx_add[i]= 0;
+        } else {
+            fx_interval[i]= actuator_ticks_per_step(block, i, fx_main_ticks0);
+            fx_add[i]= ((int32_t)last - (int32_t)fx_interval[i]) / (int32_t)count[i];
+        }
+    }
+    return true;
+}
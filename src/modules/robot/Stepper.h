@@ -9,6 +9,8 @@
 #define STEPPER_H
 
 #include "libs/Module.h"
+#include "ActuatorCoordinates.h"
+#include "InputShaper.h"
 #include <stdint.h>
 
 class Block;
@@ -25,27 +27,87 @@ public:
     void on_gcode_received(void *argument);
     void on_gcode_execute(void *argument);
     void on_halt(void *argument);
+    void on_idle(void *argument);
 
     void trapezoid_generator_reset();
-    void set_step_events_per_second(float);
+    void set_step_events_per_second(uint32_t);
     void trapezoid_generator_tick(void);
     uint32_t stepper_motor_finished_move(uint32_t dummy);
+    void add_actuator(StepperMotor *a);
     int config_step_timer( int cycles );
     void turn_enable_pins_on();
     void turn_enable_pins_off();
 
-    float get_trapezoid_adjusted_rate() const { return trapezoid_adjusted_rate; }
+    float get_trapezoid_adjusted_rate() const;
+    uint32_t get_fx_trapezoid_rate() const { return fx_trapezoid_rate; } // with Block::fx_rate_shift fractional bits
     const Block *get_current_block() const { return current_block; }
+    uint32_t get_late_runs() const { return late_runs; }
+    float limit_speed(float factor);
+    void reset_late_runs() { late_runs= 0; }
 
 private:
     Block *current_block;
-    float trapezoid_adjusted_rate;
+    Block *dwell_block;                  // a block without moves held until dwell_ticks acceleration ticks have passed
+    Block *next_block;                   // the motors are set up to start this one in the tick the current one ends
+    Block *handoff_block;                // and have started it, before it began
+    void prepare_handoff();
+    void on_handoff();
+    uint32_t dwell_ticks;
+    uint32_t fx_trapezoid_rate;          // current rate of the main stepper in steps/sec, fixed point
+    uint32_t fx_profile_rate;            // the rate of the trapezoid before it is shaped
+    uint32_t fx_rate_limit;              // a speed override slows the current block down to this rate, 0 when it is not
+    uint32_t fx_hold_rate;               // a feed hold caps the rate, ramping it down to a stop and back up after, 0 when it does not
+    float hold_speed;                    // the cap in mm/s at the end of the last block, the next one carries on from it
+    struct s_curve_t {
+        uint32_t ticks;                  // acceleration ticks into the S-curve ramp of the block
+        bool decelerating;               // the S-curve is on its deceleration ramp
+    };
+    s_curve_t s_curve;
+    static uint32_t profile_rate(const Block *block, uint32_t steps_completed, uint32_t fx_rate, s_curve_t &s);
+    InputShaper shaper;
     StepperMotor *main_stepper;
+    size_t main_index;                   // of the main stepper in the actuators
+
+    // so a rate change is integer math only, with the ratios of the steps the Planner put in the block
+    uint32_t fx_ticks_numerator;                        // StepperMotor fixed point ticks per step at 1 step/sec
+    uint32_t fx_max_ticks_per_step[k_max_actuators];    // ticks per step at the minimum step rate of each actuator
+    float max_ticks_min_rate[k_max_actuators];          // the minimum step rate those were worked out for, M205 Y changes it
+    uint32_t main_ticks_per_step(uint32_t fx_rate) const;
+    uint32_t actuator_ticks_per_step(const Block *block, size_t i, uint32_t fx_main_ticks) const;
+    void update_max_ticks();
+
+    // queue mode, the runs of step intervals of the current block are worked out in the main loop ahead of the steps
+    struct run_plan_t {
+        uint64_t fx_steps;                              // steps of the main stepper queued, 16 fractional bits
+        uint32_t fx_rate;                               // the rate of the main stepper at the end of them
+        uint32_t queued[k_max_actuators];               // steps queued for each actuator
+        s_curve_t s_curve;
+        uint32_t seq;                                   // changed by every update, so one that was interrupted by another is dropped
+    };
+    run_plan_t run_plan;
+    uint32_t late_runs;                             // times the acceleration tick had to queue runs as the main loop was late
+    void reset_runs();
+    uint32_t fill_runs(uint8_t max_queued);
+    bool plan_runs(const Block *block, run_plan_t &plan, uint32_t fx_interval[], int32_t fx_add[], uint32_t count[]) const;
+
+    // per step acceleration, rates squared in (steps/sec)^2
+    uint32_t per_step_rate(uint32_t steps_completed) const;
+    uint64_t initial_rate2;
+    uint64_t peak_rate2;                                // rate reached at the end of acceleration
+    uint64_t final_rate2;
+    uint32_t acceleration_2;                            // twice the acceleration in steps/sec^2
 
     struct {
         bool enable_pins_status:1;
         bool force_speed_update:1;
         bool halted:1;
+        bool per_step_acceleration:1;   // Setting : update the rate after every step instead of on the acceleration tick
+        bool shaping:1;                 // Setting : the rate is filtered by the input shaper
+        bool queue_mode:1;              // Setting : the main loop queues the step intervals ahead of the step interrupt
+        bool bresenham:1;               // Setting : only the main stepper is timed, the others follow it step by step
+        bool run_dry:1;                 // the main stepper is out of runs
+        bool runs_stopped:1;            // in queue mode the rate of this block is set by the acceleration tick, for a feed hold
+        bool hold_stopped:1;            // a feed hold has stopped the motors part way through the block
     };
 
 };
@@ -14,10 +14,41 @@ class BaseSolution {
         virtual ~BaseSolution() {};
         virtual void cartesian_to_actuator(const float[], ActuatorCoordinates &) = 0;
         virtual void actuator_to_cartesian(const ActuatorCoordinates &, float[]) = 0;
+        // used for segmented moves, solutions may override it to share the work between the points
+        virtual void cartesian_to_actuator_batch(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n)
+        {
+            for (size_t i = 0; i < n; i++) cartesian_to_actuator(cartesian_mm[i], actuator_mm[i]);
+        }
         typedef std::map<char, float> arm_options_t;
         virtual bool set_optional(const arm_options_t& options) { return false; };
         virtual bool get_optional(arm_options_t& options, bool force_all= false) { return false; };
         virtual size_t get_actuator_count() const { return 3; }
+        // true if the actuators move in proportion to each other along the straight line between the two points, the
+        // move then needs no segments to follow it
+        virtual bool is_linear_move(const float from[], const float to[]) const { return false; }
+
+        // columns of get_geometry_jacobian(), the effector position is differentiated with respect to each of these. For a
+        // SCARA the arm length is the inner arm and the second one the outer arm
+        enum geometry_param_t {
+            GP_ACTUATOR_1, GP_ACTUATOR_2, GP_ACTUATOR_3,
+            GP_ARM_LENGTH, GP_ARM_RADIUS,
+            GP_TOWER_OFFSET_1, GP_TOWER_OFFSET_2, GP_TOWER_OFFSET_3,
+            GP_TOWER_ANGLE_1, GP_TOWER_ANGLE_2, GP_TOWER_ANGLE_3,
+            GP_ARM_LENGTH_2,
+            GP_COUNT
+        };
+        // used by calibration, false if the solution does not know how its geometry moves the effector, the columns of
+        // parameters it does not have are 0
+        virtual bool get_geometry_jacobian(const ActuatorCoordinates &actuator_mm, const float cartesian_mm[], float jacobian[3][GP_COUNT]) { return false; }
+
+    protected:
+        // a solution's cartesian_to_actuator_batch() can be this, instantiated where its cartesian_to_actuator() is defined,
+        // so the call is not virtual and is inlined into the loop over the points
+        template<class Solution>
+        static void batch_of(Solution *s, const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n)
+        {
+            for (size_t i = 0; i < n; i++) s->Solution::cartesian_to_actuator(cartesian_mm[i], actuator_mm[i]);
+        }
 };
 
 #endif
@@ -8,6 +8,10 @@ void CartesianSolution::cartesian_to_actuator( const float cartesian_mm[], Actua
     actuator_mm[GAMMA_STEPPER] = cartesian_mm[Z_AXIS];
 }
 
+void CartesianSolution::cartesian_to_actuator_batch(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n) {
+    batch_of(this, cartesian_mm, actuator_mm, n);
+}
+
 void CartesianSolution::actuator_to_cartesian( const ActuatorCoordinates &actuator_mm, float cartesian_mm[] ){
     cartesian_mm[ALPHA_STEPPER] = actuator_mm[X_AXIS];
     cartesian_mm[BETA_STEPPER ] = actuator_mm[Y_AXIS];
@@ -12,7 +12,9 @@ class CartesianSolution : public BaseSolution {
         CartesianSolution(){};
         CartesianSolution(Config*){};
         void cartesian_to_actuator( const float millimeters[], ActuatorCoordinates &steps ) override;
+        void cartesian_to_actuator_batch(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n) override;
         void actuator_to_cartesian( const ActuatorCoordinates &steps, float millimeters[] ) override;
+        bool is_linear_move(const float[], const float[]) const override { return true; }
 };
 
 
@@ -18,6 +18,10 @@ void CoreXZSolution::cartesian_to_actuator(const float cartesian_mm[], ActuatorC
     actuator_mm[GAMMA_STEPPER] = cartesian_mm[Y_AXIS];
 }
 
+void CoreXZSolution::cartesian_to_actuator_batch(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n) {
+    batch_of(this, cartesian_mm, actuator_mm, n);
+}
+
 void CoreXZSolution::actuator_to_cartesian(const ActuatorCoordinates &actuator_mm, float cartesian_mm[] ){
     cartesian_mm[X_AXIS] = (0.5F/this->x_reduction) * (actuator_mm[ALPHA_STEPPER] + actuator_mm[BETA_STEPPER]);
     cartesian_mm[Z_AXIS] = (0.5F/this->z_reduction) * (actuator_mm[ALPHA_STEPPER] - actuator_mm[BETA_STEPPER]);
@@ -8,6 +8,10 @@ void HBotSolution::cartesian_to_actuator(const float cartesian_mm[], ActuatorCoo
     actuator_mm[GAMMA_STEPPER] = cartesian_mm[Z_AXIS];
 }
 
+void HBotSolution::cartesian_to_actuator_batch(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n) {
+    batch_of(this, cartesian_mm, actuator_mm, n);
+}
+
 void HBotSolution::actuator_to_cartesian(const ActuatorCoordinates &actuator_mm, float cartesian_mm[] ){
     cartesian_mm[X_AXIS] = 0.5F * (actuator_mm[ALPHA_STEPPER] + actuator_mm[BETA_STEPPER]);
     cartesian_mm[Y_AXIS] = 0.5F * (actuator_mm[ALPHA_STEPPER] - actuator_mm[BETA_STEPPER]);
@@ -12,7 +12,9 @@ class HBotSolution : public BaseSolution {
         HBotSolution();
         HBotSolution(Config*){};
         void cartesian_to_actuator(const float[], ActuatorCoordinates &) override;
+        void cartesian_to_actuator_batch(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n) override;
         void actuator_to_cartesian(const ActuatorCoordinates &, float[]) override;
+        bool is_linear_move(const float[], const float[]) const override { return true; }
 };
 
 
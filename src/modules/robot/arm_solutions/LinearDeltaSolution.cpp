@@ -85,6 +85,24 @@ void LinearDeltaSolution::cartesian_to_actuator(const float cartesian_mm[], Actu
 
 }
 
+// Same as above for a run of points, the tower geometry is loaded once for all of them
+void LinearDeltaSolution::cartesian_to_actuator_batch(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n)
+{
+    const float l2= arm_length_squared;
+    const float t1x= delta_tower1_x, t1y= delta_tower1_y;
+    const float t2x= delta_tower2_x, t2y= delta_tower2_y;
+    const float t3x= delta_tower3_x, t3y= delta_tower3_y;
+
+    for (size_t i = 0; i < n; i++) {
+        const float x= cartesian_mm[i][X_AXIS];
+        const float y= cartesian_mm[i][Y_AXIS];
+        const float z= cartesian_mm[i][Z_AXIS];
+        actuator_mm[i][ALPHA_STEPPER]= sqrtf(l2 - SQ(t1x - x) - SQ(t1y - y)) + z;
+        actuator_mm[i][BETA_STEPPER ]= sqrtf(l2 - SQ(t2x - x) - SQ(t2y - y)) + z;
+        actuator_mm[i][GAMMA_STEPPER]= sqrtf(l2 - SQ(t3x - x) - SQ(t3y - y)) + z;
+    }
+}
+
 // Forward kinematics (translates carriage positions into Cartesian XYZ)
 // At the time of writing, nothing appears to call this method for any reason except ComprehensiveDeltaStrategy (see ZProbe module)
 void LinearDeltaSolution::actuator_to_cartesian(const ActuatorCoordinates &actuator_mm, float cartesian_mm[] )
@@ -159,6 +177,60 @@ void LinearDeltaSolution::actuator_to_cartesian(const ActuatorCoordinates &actua
 
 }
 
+// Derivatives of the effector position from actuator_to_cartesian() with respect to the actuators and the geometry.
+// Each arm gives the constraint |P - T_i|^2 = L^2 with T_i = (tower_i_x, tower_i_y, actuator_i), differentiating them
+// gives M dP = -g where the rows of M are P - T_i and g is half the derivative of the constraints for the parameter
+bool LinearDeltaSolution::get_geometry_jacobian(const ActuatorCoordinates &actuator_mm, const float cartesian_mm[], float jacobian[3][GP_COUNT])
+{
+    const float tx[3]= { delta_tower1_x, delta_tower2_x, delta_tower3_x };
+    const float ty[3]= { delta_tower1_y, delta_tower2_y, delta_tower3_y };
+    const float angle[3]= { 210.0F + tower1_angle, 330.0F + tower2_angle, 90.0F + tower3_angle };
+
+    float m[3][3];
+    for (int i = 0; i < 3; i++) {
+        m[i][X]= cartesian_mm[X] - tx[i];
+        m[i][Y]= cartesian_mm[Y] - ty[i];
+        m[i][Z]= cartesian_mm[Z] - actuator_mm[i];
+    }
+
+    // inverse of M from its cofactors
+    float n[3][3];
+    n[0][0]= m[1][1] * m[2][2] - m[1][2] * m[2][1];
+    n[0][1]= m[0][2] * m[2][1] - m[0][1] * m[2][2];
+    n[0][2]= m[0][1] * m[1][2] - m[0][2] * m[1][1];
+    n[1][0]= m[1][2] * m[2][0] - m[1][0] * m[2][2];
+    n[1][1]= m[0][0] * m[2][2] - m[0][2] * m[2][0];
+    n[1][2]= m[0][2] * m[1][0] - m[0][0] * m[1][2];
+    n[2][0]= m[1][0] * m[2][1] - m[1][1] * m[2][0];
+    n[2][1]= m[0][1] * m[2][0] - m[0][0] * m[2][1];
+    n[2][2]= m[0][0] * m[1][1] - m[0][1] * m[1][0];
+    float det= m[0][0] * n[0][0] + m[0][1] * n[1][0] + m[0][2] * n[2][0];
+    if(fabsf(det) < 1e-6F) return false;
+
+    // g for the parameters that only move one tower, and for the ones that move all of them
+    float g_actuator[3], g_radius[3], g_angle[3], g_arm[3];
+    for (int i = 0; i < 3; i++) {
+        float c= cosf(angle[i] * PIOVER180), s= sinf(angle[i] * PIOVER180);
+        g_actuator[i]= -m[i][Z];
+        g_radius[i]= -(m[i][X] * c + m[i][Y] * s);
+        g_angle[i]= (m[i][X] * ty[i] - m[i][Y] * tx[i]) * PIOVER180;
+        g_arm[i]= -arm_length;
+    }
+
+    for (int a = 0; a < 3; a++) {
+        float inv[3]= { n[a][0] / det, n[a][1] / det, n[a][2] / det };
+        for (int i = 0; i < 3; i++) {
+            jacobian[a][GP_ACTUATOR_1 + i]= -inv[i] * g_actuator[i];
+            jacobian[a][GP_TOWER_OFFSET_1 + i]= -inv[i] * g_radius[i];
+            jacobian[a][GP_TOWER_ANGLE_1 + i]= -inv[i] * g_angle[i];
+        }
+        jacobian[a][GP_ARM_LENGTH]= -(inv[0] * g_arm[0] + inv[1] * g_arm[1] + inv[2] * g_arm[2]);
+        jacobian[a][GP_ARM_RADIUS]= -(inv[0] * g_radius[0] + inv[1] * g_radius[1] + inv[2] * g_radius[2]);
+        jacobian[a][GP_ARM_LENGTH_2]= 0;
+    }
+    return true;
+}
+
 // If the carriage is dist mm away from 0, what are its coordinates, adjusted for tower lean?
 // Disabled because it hasn't been fully implemented yet
 /*
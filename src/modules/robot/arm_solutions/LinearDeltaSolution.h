@@ -20,7 +20,11 @@ class LinearDeltaSolution : public BaseSolution {
 
         // Kinematics
         void cartesian_to_actuator(const float[], ActuatorCoordinates &) override;
+        void cartesian_to_actuator_batch(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n) override;
         void actuator_to_cartesian(const ActuatorCoordinates &, float[] ) override;
+        // the towers are upright, a move straight up or down moves each carriage as far as the effector
+        bool is_linear_move(const float from[], const float to[]) const override { return from[X] == to[X] && from[Y] == to[Y]; }
+        bool get_geometry_jacobian(const ActuatorCoordinates &actuator_mm, const float cartesian_mm[], float jacobian[3][GP_COUNT]) override;
         
         // Tower lean
         void get_tower_xyz_for_dist(uint8_t tower, float xyz[], float dist);
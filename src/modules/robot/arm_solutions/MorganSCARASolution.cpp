@@ -24,8 +24,9 @@
 #define morgan_homing_checksum        CHECKSUM("morgan_homing")
 #define morgan_undefined_min_checksum CHECKSUM("morgan_undefined_min")
 #define morgan_undefined_max_checksum CHECKSUM("morgan_undefined_max")
+#define arm_trig_precision_checksum   CHECKSUM("arm_trig_precision")
 
-#define SQ(x) powf(x, 2)
+#define SQ(x) ((x) * (x))
 #define ROUND(x, y) (roundf(x * 1e ## y) / 1e ## y)
 
 MorganSCARASolution::MorganSCARASolution(Config* config)
@@ -47,6 +48,8 @@ MorganSCARASolution::MorganSCARASolution(Config* config)
     morgan_undefined_min  = config->value(morgan_undefined_min_checksum)->by_default(0.95f)->as_number();
     // max: head on maximum reach
     morgan_undefined_max  = config->value(morgan_undefined_max_checksum)->by_default(0.95f)->as_number();
+    // the kinematics use polynomial trig functions, high is as good as libm, low trades some accuracy for speed, exact is libm
+    trig.set_precision(FastTrig::precision_from_string(config->value(arm_trig_precision_checksum)->by_default("high")->as_string().c_str()));
 
     init();
 }
@@ -77,7 +80,7 @@ void MorganSCARASolution::cartesian_to_actuator(const float cartesian_mm[], Actu
     if (this->arm1_length == this->arm2_length)
         SCARA_C2 = (SQ(SCARA_pos[X_AXIS])+SQ(SCARA_pos[Y_AXIS])-2.0f*SQ(this->arm1_length)) / (2.0f * SQ(this->arm1_length));
     else
-        SCARA_C2 = (SQ(SCARA_pos[X_AXIS])+SQ(SCARA_pos[Y_AXIS])-SQ(this->arm1_length)-SQ(this->arm2_length)) / (2.0f * SQ(this->arm1_length));
+        SCARA_C2 = (SQ(SCARA_pos[X_AXIS])+SQ(SCARA_pos[Y_AXIS])-SQ(this->arm1_length)-SQ(this->arm2_length)) / (2.0f * this->arm1_length * this->arm2_length);
 
     // SCARA position is undefined if abs(SCARA_C2) >=1
     // In reality abs(SCARA_C2) >0.95 can be problematic.
@@ -93,8 +96,8 @@ void MorganSCARASolution::cartesian_to_actuator(const float cartesian_mm[], Actu
     SCARA_K1 = this->arm1_length+this->arm2_length*SCARA_C2;
     SCARA_K2 = this->arm2_length*SCARA_S2;
 
-    SCARA_theta = (atan2f(SCARA_pos[X_AXIS],SCARA_pos[Y_AXIS])-atan2f(SCARA_K1, SCARA_K2))*-1.0f;    // Morgan Thomas turns Theta in oposite direction
-    SCARA_psi   = atan2f(SCARA_S2,SCARA_C2);
+    SCARA_theta = (trig.atan2(SCARA_pos[X_AXIS],SCARA_pos[Y_AXIS])-trig.atan2(SCARA_K1, SCARA_K2))*-1.0f;    // Morgan Thomas turns Theta in oposite direction
+    SCARA_psi   = trig.atan2(SCARA_S2,SCARA_C2);
 
 
     actuator_mm[ALPHA_STEPPER] = to_degrees(SCARA_theta);             // Multiply by 180/Pi  -  theta is support arm angle
@@ -104,6 +107,11 @@ void MorganSCARASolution::cartesian_to_actuator(const float cartesian_mm[], Actu
 
 }
 
+void MorganSCARASolution::cartesian_to_actuator_batch(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n)
+{
+    batch_of(this, cartesian_mm, actuator_mm, n);
+}
+
 void MorganSCARASolution::actuator_to_cartesian(const ActuatorCoordinates &actuator_mm, float cartesian_mm[] ) {
     // Perform forward kinematics, and place results in cartesian_mm[]
 
@@ -113,10 +121,14 @@ void MorganSCARASolution::actuator_to_cartesian(const ActuatorCoordinates &actua
     actuator_rad[X_AXIS] = actuator_mm[X_AXIS]/(180.0F/3.14159265359f);
     actuator_rad[Y_AXIS] = actuator_mm[Y_AXIS]/(180.0F/3.14159265359f);
 
-    y1 = sinf(actuator_rad[X_AXIS])*this->arm1_length;
-    y2 = sinf(actuator_rad[Y_AXIS])*this->arm2_length + y1;
+    float sin1, cos1, sin2, cos2;
+    trig.sincos(actuator_rad[X_AXIS], sin1, cos1);
+    trig.sincos(actuator_rad[Y_AXIS], sin2, cos2);
 
-    cartesian_mm[X_AXIS] = (((cosf(actuator_rad[X_AXIS])*this->arm1_length) + (cosf(actuator_rad[Y_AXIS])*this->arm2_length)) / this->morgan_scaling_x) + this->morgan_offset_x;
+    y1 = sin1*this->arm1_length;
+    y2 = sin2*this->arm2_length + y1;
+
+    cartesian_mm[X_AXIS] = (((cos1*this->arm1_length) + (cos2*this->arm2_length)) / this->morgan_scaling_x) + this->morgan_offset_x;
     cartesian_mm[Y_AXIS] = (y2 + this->morgan_offset_y) / this->morgan_scaling_y;
     cartesian_mm[Z_AXIS] = actuator_mm[Z_AXIS];
 
@@ -125,6 +137,29 @@ void MorganSCARASolution::actuator_to_cartesian(const ActuatorCoordinates &actua
     cartesian_mm[2] = ROUND(cartesian_mm[2], 7);
 }
 
+// from actuator_to_cartesian(), the actuators are the angles of the two arms in degrees and Z
+bool MorganSCARASolution::get_geometry_jacobian(const ActuatorCoordinates &actuator_mm, const float cartesian_mm[], float jacobian[3][GP_COUNT])
+{
+    const float per_degree= 3.14159265359f / 180.0F;
+    float sin1, cos1, sin2, cos2;
+    trig.sincos(actuator_mm[X_AXIS] * per_degree, sin1, cos1);
+    trig.sincos(actuator_mm[Y_AXIS] * per_degree, sin2, cos2);
+
+    for (int a = 0; a < 3; a++) {
+        for (int p = 0; p < GP_COUNT; p++) jacobian[a][p]= 0;
+    }
+    jacobian[X_AXIS][GP_ACTUATOR_1]= -sin1 * this->arm1_length * per_degree / this->morgan_scaling_x;
+    jacobian[X_AXIS][GP_ACTUATOR_2]= -sin2 * this->arm2_length * per_degree / this->morgan_scaling_x;
+    jacobian[Y_AXIS][GP_ACTUATOR_1]= cos1 * this->arm1_length * per_degree / this->morgan_scaling_y;
+    jacobian[Y_AXIS][GP_ACTUATOR_2]= cos2 * this->arm2_length * per_degree / this->morgan_scaling_y;
+    jacobian[Z_AXIS][GP_ACTUATOR_3]= 1;
+    jacobian[X_AXIS][GP_ARM_LENGTH]= cos1 / this->morgan_scaling_x;
+    jacobian[Y_AXIS][GP_ARM_LENGTH]= sin1 / this->morgan_scaling_y;
+    jacobian[X_AXIS][GP_ARM_LENGTH_2]= cos2 / this->morgan_scaling_x;
+    jacobian[Y_AXIS][GP_ARM_LENGTH_2]= sin2 / this->morgan_scaling_y;
+    return true;
+}
+
 bool MorganSCARASolution::set_optional(const arm_options_t& options) {
 
     arm_options_t::const_iterator i;
@@ -2,6 +2,7 @@
 #define MORGANSCARASOLUTION_H
 //#include "libs/Module.h"
 #include "BaseSolution.h"
+#include "FastTrig.h"
 
 class Config;
 
@@ -9,15 +10,19 @@ class MorganSCARASolution : public BaseSolution {
     public:
         MorganSCARASolution(Config*);
         void cartesian_to_actuator(const float[], ActuatorCoordinates &) override;
+        void cartesian_to_actuator_batch(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n) override;
         void actuator_to_cartesian(const ActuatorCoordinates &, float[] ) override;
 
         bool set_optional(const arm_options_t& options) override;
         bool get_optional(arm_options_t& options, bool force_all) override;
+        bool get_geometry_jacobian(const ActuatorCoordinates &actuator_mm, const float cartesian_mm[], float jacobian[3][GP_COUNT]) override;
 
     private:
         void init();
         float to_degrees(float radians);
 
+        FastTrig trig;
+
         float arm1_length;
         float arm2_length;
         float morgan_offset_x;
@@ -20,6 +20,7 @@
 #define tool_offset_checksum            CHECKSUM("delta_tool_offset")
 
 #define delta_mirror_xy_checksum        CHECKSUM("delta_mirror_xy")
+#define arm_trig_precision_checksum     CHECKSUM("arm_trig_precision")
 
 const static float pi     = 3.14159265358979323846;    // PI
 const static float two_pi = 2 * pi;
@@ -56,27 +57,45 @@ RotaryDeltaSolution::RotaryDeltaSolution(Config *config)
     // mirror the XY axis
     mirror_xy= config->value(delta_mirror_xy_checksum)->by_default(true)->as_bool();
 
+    // the kinematics use polynomial trig functions, high is as good as libm, low trades some accuracy for speed, exact is libm
+    trig.set_precision(FastTrig::precision_from_string(config->value(arm_trig_precision_checksum)->by_default("high")->as_string().c_str()));
+
     debug_flag= false;
     init();
 }
 
 // inverse kinematics
 // helper functions, calculates angle theta1 (for YZ-pane)
+RotaryDeltaSolution::angle_consts_t RotaryDeltaSolution::angle_consts() const
+{
+    angle_consts_t c;
+    c.y1 = -0.5F * tan30 * delta_f; // f/2 * tan 30
+    c.y_shift = 0.5F * tan30 * delta_e;
+    c.k = delta_rf * delta_rf - delta_re * delta_re - c.y1 * c.y1;
+    c.rf = delta_rf;
+    return c;
+}
+
 int RotaryDeltaSolution::delta_calcAngleYZ(float x0, float y0, float z0, float &theta)
 {
-    float y1 = -0.5F * tan30 * delta_f; // f/2 * tan 30
-    y0      -=  0.5F * tan30 * delta_e; // shift center to edge
+    return calc_angle_yz(angle_consts(), x0, y0, z0, theta);
+}
+
+int RotaryDeltaSolution::calc_angle_yz(const angle_consts_t& c, float x0, float y0, float z0, float &theta) const
+{
+    float y1 = c.y1;
+    y0      -=  c.y_shift; // shift center to edge
     // z = a + b*y
-    float a = (x0 * x0 + y0 * y0 + z0 * z0 + delta_rf * delta_rf - delta_re * delta_re - y1 * y1) / (2.0F * z0);
+    float a = (x0 * x0 + y0 * y0 + z0 * z0 + c.k) / (2.0F * z0);
     float b = (y1 - y0) / z0;
 
-    float d = -(a + b * y1) * (a + b * y1) + delta_rf * (b * b * delta_rf + delta_rf); // discriminant
+    float d = -(a + b * y1) * (a + b * y1) + c.rf * (b * b * c.rf + c.rf); // discriminant
     if (d < 0.0F) return -1;                                            // non-existing point
 
     float yj = (y1 - a * b - sqrtf(d)) / (b * b + 1.0F);               // choosing outer point
     float zj = a + b * yj;
 
-    theta = 180.0F * atanf(-zj / (y1 - yj)) / pi + ((yj > y1) ? 180.0F : 0.0F);
+    theta = 180.0F * trig.atan(-zj / (y1 - yj)) / pi + ((yj > y1) ? 180.0F : 0.0F);
     return 0;
 }
 
@@ -91,16 +110,21 @@ int RotaryDeltaSolution::delta_calcForward(float theta1, float theta2, float the
     theta2 *= degrees_to_radians;
     theta3 *= degrees_to_radians;
 
-    float y1 = -(t + delta_rf * cosf(theta1));
-    float z1 = -delta_rf * sinf(theta1);
+    float s1, c1, s2, c2, s3, c3;
+    trig.sincos(theta1, s1, c1);
+    trig.sincos(theta2, s2, c2);
+    trig.sincos(theta3, s3, c3);
 
-    float y2 = (t + delta_rf * cosf(theta2)) * sin30;
+    float y1 = -(t + delta_rf * c1);
+    float z1 = -delta_rf * s1;
+
+    float y2 = (t + delta_rf * c2) * sin30;
     float x2 = y2 * tan60;
-    float z2 = -delta_rf * sinf(theta2);
+    float z2 = -delta_rf * s2;
 
-    float y3 = (t + delta_rf * cosf(theta3)) * sin30;
+    float y3 = (t + delta_rf * c3) * sin30;
     float x3 = -y3 * tan60;
-    float z3 = -delta_rf * sinf(theta3);
+    float z3 = -delta_rf * s3;
 
     float dnm = (y2 - y1) * x3 - (y3 - y1) * x2;
 
@@ -196,6 +220,42 @@ void RotaryDeltaSolution::cartesian_to_actuator(const float cartesian_mm[], Actu
 
 }
 
+// Same as cartesian_to_actuator() for a run of points, with the geometry constants worked out once
+void RotaryDeltaSolution::cartesian_to_actuator_batch(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n)
+{
+    if(debug_flag) {
+        // keep the diagnostics
+        BaseSolution::cartesian_to_actuator_batch(cartesian_mm, actuator_mm, n);
+        return;
+    }
+
+    const angle_consts_t c= angle_consts();
+    for (size_t i = 0; i < n; i++) {
+        float x0 = cartesian_mm[i][X_AXIS];
+        float y0 = cartesian_mm[i][Y_AXIS];
+        if(mirror_xy) {
+            x0= -x0;
+            y0= -y0;
+        }
+        float z_with_offset = cartesian_mm[i][Z_AXIS] + z_calc_offset;
+
+        float alpha_theta, beta_theta, gamma_theta;
+        if (calc_angle_yz(c, x0, y0, z_with_offset, alpha_theta) == 0 &&
+            calc_angle_yz(c, x0 * cos120 + y0 * sin120, y0 * cos120 - x0 * sin120, z_with_offset, beta_theta) == 0 &&
+            calc_angle_yz(c, x0 * cos120 - y0 * sin120, y0 * cos120 + x0 * sin120, z_with_offset, gamma_theta) == 0) {
+            actuator_mm[i][ALPHA_STEPPER] = alpha_theta;
+            actuator_mm[i][BETA_STEPPER ] = beta_theta;
+            actuator_mm[i][GAMMA_STEPPER] = gamma_theta;
+
+        } else {
+            // force to actuator FPD home position as we know this is a valid position
+            actuator_mm[i][ALPHA_STEPPER] = 0;
+            actuator_mm[i][BETA_STEPPER ] = 0;
+            actuator_mm[i][GAMMA_STEPPER] = 0;
+        }
+    }
+}
+
 void RotaryDeltaSolution::actuator_to_cartesian(const ActuatorCoordinates &actuator_mm, float cartesian_mm[] )
 {
     float x, y, z;
@@ -212,6 +272,49 @@ void RotaryDeltaSolution::actuator_to_cartesian(const ActuatorCoordinates &actua
     }
 }
 
+// only the actuator columns. The angles at points either side of it along each axis, worked out in one batch, give how
+// the angles move with the effector, and the inverse of that how the effector moves with the angles
+bool RotaryDeltaSolution::get_geometry_jacobian(const ActuatorCoordinates &actuator_mm, const float cartesian_mm[], float jacobian[3][GP_COUNT])
+{
+    const float h= 0.25F;
+    float c[6][3];
+    for (int i = 0; i < 6; i++) {
+        for (int j = 0; j < 3; j++) c[i][j]= cartesian_mm[j];
+        c[i][i / 2] += (i & 1) ? -h : h;
+    }
+    ActuatorCoordinates a[6];
+    cartesian_to_actuator_batch(c, a, 6);
+
+    // m[k][j] is how far actuator k turns for a mm along axis j
+    float m[3][3];
+    for (int i = 0; i < 6; i++) {
+        // all of them 0 is where it could not get to
+        if(a[i][ALPHA_STEPPER] == 0 && a[i][BETA_STEPPER] == 0 && a[i][GAMMA_STEPPER] == 0) return false;
+    }
+    for (int k = 0; k < 3; k++) {
+        for (int j = 0; j < 3; j++) m[k][j]= (a[2 * j][k] - a[2 * j + 1][k]) / (2 * h);
+    }
+
+    float n[3][3];
+    n[0][0]= m[1][1] * m[2][2] - m[1][2] * m[2][1];
+    n[0][1]= m[0][2] * m[2][1] - m[0][1] * m[2][2];
+    n[0][2]= m[0][1] * m[1][2] - m[0][2] * m[1][1];
+    n[1][0]= m[1][2] * m[2][0] - m[1][0] * m[2][2];
+    n[1][1]= m[0][0] * m[2][2] - m[0][2] * m[2][0];
+    n[1][2]= m[0][2] * m[1][0] - m[0][0] * m[1][2];
+    n[2][0]= m[1][0] * m[2][1] - m[1][1] * m[2][0];
+    n[2][1]= m[0][1] * m[2][0] - m[0][0] * m[2][1];
+    n[2][2]= m[0][0] * m[1][1] - m[0][1] * m[1][0];
+    float det= m[0][0] * n[0][0] + m[0][1] * n[1][0] + m[0][2] * n[2][0];
+    if(fabsf(det) < 1e-9F) return false;
+
+    for (int j = 0; j < 3; j++) {
+        for (int p = 0; p < GP_COUNT; p++) jacobian[j][p]= 0;
+        for (int k = 0; k < 3; k++) jacobian[j][GP_ACTUATOR_1 + k]= n[j][k] / det;
+    }
+    return true;
+}
+
 bool RotaryDeltaSolution::set_optional(const arm_options_t &options)
 {
 
@@ -2,6 +2,7 @@
 #define RotaryDeltaSolution_H
 #include "libs/Module.h"
 #include "BaseSolution.h"
+#include "FastTrig.h"
 
 class Config;
 
@@ -9,13 +10,24 @@ class RotaryDeltaSolution : public BaseSolution {
     public:
         RotaryDeltaSolution(Config*);
         void cartesian_to_actuator(const float[], ActuatorCoordinates &) override;
+        void cartesian_to_actuator_batch(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n) override;
         void actuator_to_cartesian(const ActuatorCoordinates &, float[] ) override;
 
         bool set_optional(const arm_options_t& options) override;
         bool get_optional(arm_options_t& options, bool force_all) override;
+        bool get_geometry_jacobian(const ActuatorCoordinates &actuator_mm, const float cartesian_mm[], float jacobian[3][GP_COUNT]) override;
 
     private:
         void init();
+        // the parts of delta_calcAngleYZ() that only depend on the geometry
+        struct angle_consts_t {
+            float y1;       // base joint Y
+            float y_shift;  // effector joint offset
+            float k;        // rf^2 - re^2 - y1^2
+            float rf;
+        };
+        angle_consts_t angle_consts() const;
+        int calc_angle_yz(const angle_consts_t& c, float x0, float y0, float z0, float &theta) const;
         int delta_calcAngleYZ(float x0, float y0, float z0, float &theta);
         int delta_calcForward(float theta1, float theta2, float theta3, float &x0, float &y0, float &z0);
 
@@ -29,6 +41,7 @@ class RotaryDeltaSolution : public BaseSolution {
         float delta_ee_offs;		// Ball joint plane to bottom of end effector surface
         float tool_offset;		// Distance between end effector ball joint plane and tip of tool
         float z_calc_offset;
+        FastTrig trig;
 
         struct {
             bool debug_flag:1;
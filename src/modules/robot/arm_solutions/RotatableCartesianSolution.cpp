@@ -17,6 +17,10 @@ void RotatableCartesianSolution::cartesian_to_actuator(const float cartesian_mm[
     rotate( cartesian_mm, &actuator_mm[0], sin_alpha, cos_alpha );
 }
 
+void RotatableCartesianSolution::cartesian_to_actuator_batch(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n) {
+    batch_of(this, cartesian_mm, actuator_mm, n);
+}
+
 void RotatableCartesianSolution::actuator_to_cartesian(const ActuatorCoordinates &actuator_mm, float cartesian_mm[] ){
     rotate( &actuator_mm[0], cartesian_mm, - sin_alpha, cos_alpha );
 }
@@ -13,7 +13,9 @@ class RotatableCartesianSolution : public BaseSolution {
     public:
         RotatableCartesianSolution(Config*);
         void cartesian_to_actuator(const float[], ActuatorCoordinates &) override;
+        void cartesian_to_actuator_batch(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n) override;
         void actuator_to_cartesian(const ActuatorCoordinates &, float[] ) override;
+        bool is_linear_move(const float[], const float[]) const override { return true; }
 
     private:
         void rotate(const float in[], float out[], float sin, float cos);
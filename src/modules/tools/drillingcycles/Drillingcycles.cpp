@@ -13,7 +13,6 @@
 #include "Gcode.h"
 #include "Robot.h"
 #include "Conveyor.h"
-#include "SlowTicker.h"
 #include "StepperMotor.h"
 #include "StreamOutputPool.h"
 #include <math.h> /* fmod */
@@ -58,7 +57,6 @@ void Drillingcycles::on_module_loaded()
     this->retract_type  = RETRACT_TO_Z;
 
     this->initial_z = 0;
-    this->r_plane   = 0;
 
     this->reset_sticky();
 }
@@ -80,6 +78,9 @@ Implemented     : G80-83, G98, G99
 Absolute mode   : yes
 Relative mode   : no
 Incremental (L) : no
+
+The moves of a hole are queued straight to the planner, and the dwell is queued like a G4,
+so the moves after it are queued while it waits.
 */
 
 /* reset all sticky values, called before each cycle */
@@ -100,93 +101,98 @@ void Drillingcycles::update_sticky(Gcode *gcode)
     if (gcode->has_letter('F')) this->sticky_f = gcode->get_value('F');
     if (gcode->has_letter('Q')) this->sticky_q = gcode->get_value('Q');
     if (gcode->has_letter('P')) this->sticky_p = gcode->get_int('P');
-
-    // set retract plane
-    if (this->retract_type == RETRACT_TO_Z)
-        this->r_plane = this->initial_z;
-    else
-        this->r_plane = this->sticky_r;
 }
 
-/* send a formatted Gcode line */
-int Drillingcycles::send_gcode(const char* format, ...)
+/* queue a move to the machine position, returns false if halted */
+bool Drillingcycles::move_to(float x, float y, float z, float rate_mm_s)
 {
-    // handle variable arguments
-    va_list args;
-    va_start(args, format);
-    // make the formatted string
-    char line[32]; // max length for an gcode line
-    int n = vsnprintf(line, sizeof(line), format, args);
-    va_end(args);
-    // debug, print the gcode sended
-    //THEKERNEL->streams->printf(">>> %s\r\n", line);
-    // make gcode object and send it (right way)
-    Gcode gc(line, &(StreamOutput::NullStream));
-    THEKERNEL->call_event(ON_GCODE_RECEIVED, &gc);
-    // return the gcode srting length
-    return n;
+    float target[3]{x, y, z};
+    THEKERNEL->robot->append_machine_move(target, rate_mm_s);
+    return !THEKERNEL->is_halted();
 }
 
-/* G83: peck drilling */
-void Drillingcycles::peck_hole()
+/* G83: peck drilling, the positions are in machine coordinates */
+bool Drillingcycles::peck_hole(float x, float y, float r, float z, float feed_rate, float seek_rate)
 {
     // start values
-    float depth  = this->sticky_r - this->sticky_z; // travel depth
-    float cycles = depth / this->sticky_q;          // cycles count
-    float rest   = fmod(depth, this->sticky_q);     // final pass
-    float z_pos  = this->sticky_r;                  // current z position
+    float q      = THEKERNEL->robot->to_millimeters(this->sticky_q);
+    float depth  = r - z;                           // travel depth
+    float cycles = depth / q;                       // cycles count
+    float rest   = fmod(depth, q);                  // final pass
+    float z_pos  = r;                               // current z position
 
     // for each cycle
     for (int i = 1; i < cycles; i++) {
         // decrement depth
-        z_pos -= this->sticky_q;
+        z_pos -= q;
         // feed down to depth at feedrate (F and Z)
-        this->send_gcode("G1 F%1.4f Z%1.4f", this->sticky_f, z_pos);
+        if (!this->move_to(x, y, z_pos, feed_rate)) return false;
         // rapids to retract position (R)
-        this->send_gcode("G0 Z%1.4f", this->sticky_r);
+        if (!this->move_to(x, y, r, seek_rate)) return false;
     }
 
     // final depth not reached
     if (rest > 0) {
         // feed down to final depth at feedrate (F and Z)
-        this->send_gcode("G1 F%1.4f Z%1.4f", this->sticky_f, this->sticky_z);
+        if (!this->move_to(x, y, z, feed_rate)) return false;
     }
+    return true;
 }
 
 void Drillingcycles::make_hole(Gcode *gcode)
 {
-    // compile X and Y values
-    char x[16] = "";
-    char y[16] = "";
-    if (gcode->has_letter('X'))
-        snprintf(x, sizeof(x), " X%1.4f", gcode->get_value('X'));
-    if (gcode->has_letter('Y'))
-        snprintf(y, sizeof(y), " Y%1.4f", gcode->get_value('Y'));
+    Robot *robot = THEKERNEL->robot;
+
+    // the F of the cycle is the feedrate from now on, as it would be for a G1
+    Robot::motion_state_t ms;
+    robot->get_motion_state(ms);
+    if (gcode->has_letter('F')) {
+        ms.feed_rate = robot->to_millimeters(this->sticky_f);
+        robot->set_motion_state(ms);
+    }
+    float feed_rate = ms.feed_rate / robot->get_seconds_per_minute();
+    float seek_rate = ms.seek_rate / robot->get_seconds_per_minute();
+
+    // the cycle is given in work coordinates, the moves are queued in machine coordinates
+    float pos[3], offset[3];
+    robot->get_axis_position(pos);
+    Robot::wcs_t wpos = robot->mcs2wcs(pos);
+    offset[X_AXIS] = pos[X_AXIS] - std::get<X_AXIS>(wpos);
+    offset[Y_AXIS] = pos[Y_AXIS] - std::get<Y_AXIS>(wpos);
+    offset[Z_AXIS] = pos[Z_AXIS] - std::get<Z_AXIS>(wpos);
+
+    float x = gcode->has_letter('X') ? robot->to_millimeters(gcode->get_value('X')) + offset[X_AXIS] : pos[X_AXIS];
+    float y = gcode->has_letter('Y') ? robot->to_millimeters(gcode->get_value('Y')) + offset[Y_AXIS] : pos[Y_AXIS];
+    float r = robot->to_millimeters(this->sticky_r) + offset[Z_AXIS];
+    float z = robot->to_millimeters(this->sticky_z) + offset[Z_AXIS];
+
+    // retract plane (Initial-Z or R)
+    float r_plane = (this->retract_type == RETRACT_TO_Z) ? this->initial_z : r;
+
+    // the cycle goes with the first block of the hole, so it is executed like the G0 it starts with would be
+    THEKERNEL->conveyor->append_gcode(gcode);
 
     // rapids to X/Y
-    this->send_gcode("G0%s%s", x, y);
+    if (!this->move_to(x, y, pos[Z_AXIS], seek_rate)) return;
     // rapids to retract position (R)
-    this->send_gcode("G0 Z%1.4f", this->sticky_r);
+    if (!this->move_to(x, y, r, seek_rate)) return;
 
     // if peck drilling
-    if (this->sticky_q > 0)
-        this->peck_hole();
-    else
+    if (this->sticky_q > 0) {
+        if (!this->peck_hole(x, y, r, z, feed_rate, seek_rate)) return;
+    } else {
         // feed down to depth at feedrate (F and Z)
-        this->send_gcode("G1 F%1.4f Z%1.4f", this->sticky_f, this->sticky_z);
+        if (!this->move_to(x, y, z, feed_rate)) return;
+    }
 
     // if dwell, wait for x seconds
     if (this->sticky_p > 0) {
-        // dwell exprimed in seconds
-        if (this->dwell_units == DWELL_UNITS_S)
-            this->send_gcode("G4 S%u", this->sticky_p);
-        // dwell exprimed in milliseconds
-        else
-            this->send_gcode("G4 P%u", this->sticky_p);
+        // dwell exprimed in seconds or milliseconds
+        THEKERNEL->conveyor->queue_dwell((this->dwell_units == DWELL_UNITS_S) ? this->sticky_p * 1000 : this->sticky_p);
     }
 
     // rapids retract at R-Plane (Initial-Z or R)
-    this->send_gcode("G0 Z%1.4f", this->r_plane);
+    this->move_to(x, y, r_plane, seek_rate);
 }
 
 void Drillingcycles::on_gcode_received(void* argument)
@@ -225,7 +231,11 @@ void Drillingcycles::on_gcode_received(void* argument)
         // if retract position is R-Plane
         if (this->retract_type == RETRACT_TO_R) {
             // rapids retract at Initial-Z to avoid futur collisions
-            this->send_gcode("G0 Z%1.4f", this->initial_z);
+            float pos[3];
+            Robot::motion_state_t ms;
+            THEKERNEL->robot->get_axis_position(pos);
+            THEKERNEL->robot->get_motion_state(ms);
+            this->move_to(pos[X_AXIS], pos[Y_AXIS], this->initial_z, ms.seek_rate / THEKERNEL->robot->get_seconds_per_minute());
         }
     }
     // in cycle
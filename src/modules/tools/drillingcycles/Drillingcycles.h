@@ -24,15 +24,14 @@ class Drillingcycles : public Module
         void on_gcode_received(void *argument);
         void reset_sticky();
         void update_sticky(Gcode *gcode);
-        int  send_gcode(const char* format, ...);
+        bool move_to(float x, float y, float z, float rate_mm_s);
         void make_hole(Gcode *gcode);
-        void peck_hole();
+        bool peck_hole(float x, float y, float r, float z, float feed_rate, float seek_rate);
 
         bool cycle_started; // cycle status
         int  retract_type;  // rretract type
 
-        float initial_z;    // Initial-Z
-        float r_plane;      // R-Plane
+        float initial_z;    // Initial-Z, in machine coordinates
 
         float sticky_z;     // final depth
         float sticky_r;     // R-Plane
@@ -25,11 +25,14 @@
 #include "ConfigValue.h"
 #include "libs/StreamOutput.h"
 #include "PublicDataRequest.h"
+#include "PublicData.h"
 #include "EndstopsPublicAccess.h"
+#include "MotorDriverControlPublicAccess.h"
 #include "StreamOutputPool.h"
 #include "StepTicker.h"
 #include "BaseSolution.h"
 #include "SerialMessage.h"
+#include "PinChange.h"
 
 #include <ctype.h>
 
@@ -102,6 +105,12 @@
 #define alpha_limit_enable_checksum      CHECKSUM("alpha_limit_enable")
 #define beta_limit_enable_checksum       CHECKSUM("beta_limit_enable")
 #define gamma_limit_enable_checksum      CHECKSUM("gamma_limit_enable")
+#define limit_interrupt_checksum         CHECKSUM("limit_interrupt")
+
+#define alpha_stallguard_homing_checksum CHECKSUM("alpha_stallguard_homing")
+#define beta_stallguard_homing_checksum  CHECKSUM("beta_stallguard_homing")
+#define gamma_stallguard_homing_checksum CHECKSUM("gamma_stallguard_homing")
+#define stallguard_blank_checksum        CHECKSUM("stallguard_homing_blank_mm")
 
 #define homing_order_checksum            CHECKSUM("homing_order")
 #define move_to_origin_checksum          CHECKSUM("move_to_origin_after_home")
@@ -125,6 +134,7 @@ Endstops::Endstops()
 {
     this->status = NOT_HOMING;
     home_offset[0] = home_offset[1] = home_offset[2] = 0.0F;
+    limit_hit = -1;
 }
 
 void Endstops::on_module_loaded()
@@ -138,13 +148,17 @@ void Endstops::on_module_loaded()
     register_for_event(ON_GCODE_RECEIVED);
     register_for_event(ON_GET_PUBLIC_DATA);
     register_for_event(ON_SET_PUBLIC_DATA);
+    PublicData::register_handler(this, endstops_checksum);
 
-    THEKERNEL->step_ticker->register_acceleration_tick_handler([this]() {acceleration_tick(); });
+    // only called while homing
+    this->acceleration_tick_id = THEKERNEL->step_ticker->register_acceleration_tick_handler([](void *e) { static_cast<Endstops *>(e)->acceleration_tick(); }, this, "RIT endstops", false);
 
     // Settings
     this->load_config();
 }
 
+static const char *endstop_names[] = {"min_x", "min_y", "min_z", "max_x", "max_y", "max_z"};
+
 // Get config
 void Endstops::load_config()
 {
@@ -225,6 +239,12 @@ void Endstops::load_config()
     this->limit_enable[Y_AXIS] = THEKERNEL->config->value(beta_limit_enable_checksum)->by_default(false)->as_bool();
     this->limit_enable[Z_AXIS] = THEKERNEL->config->value(gamma_limit_enable_checksum)->by_default(false)->as_bool();
 
+    // home on the stallguard flag of the TMC2660 with the axis as its designator instead of a switch
+    this->stallguard_homing[X_AXIS] = THEKERNEL->config->value(alpha_stallguard_homing_checksum)->by_default(false)->as_bool();
+    this->stallguard_homing[Y_AXIS] = THEKERNEL->config->value(beta_stallguard_homing_checksum)->by_default(false)->as_bool();
+    this->stallguard_homing[Z_AXIS] = THEKERNEL->config->value(gamma_stallguard_homing_checksum)->by_default(false)->as_bool();
+    this->stallguard_blank_mm = THEKERNEL->config->value(stallguard_blank_checksum)->by_default(1.0F)->as_number();
+
     // set to true by default for deltas duwe to trim, false on cartesians
     this->move_to_origin_after_home = THEKERNEL->config->value(move_to_origin_checksum)->by_default(is_delta)->as_bool();
 
@@ -236,6 +256,20 @@ void Endstops::load_config()
             this->limit_enable[Y_AXIS] = true;
             this->limit_enable[Z_AXIS] = true;
         }
+
+        // the limit switches can halt from their edge, so a main loop busy for a while does not let an axis drive on into its end
+        if(THEKERNEL->config->value(limit_interrupt_checksum)->by_default(false)->as_bool()) {
+            for(int n = 0; n < 6; n++) {
+                if(!this->limit_enable[n % 3] || !this->pins[n].connected()) continue;
+                // a spike shorter than 1ms on the line does not halt
+                this->limit_watched[n] = PinChange::attach(this->pins[n], [this, n](bool on) { if(on) on_limit_change(n); }, 1);
+                if(!this->limit_watched[n]) {
+                    THEKERNEL->streams->printf("WARNING: limit_interrupt needs %s on a port 0 or port 2 pin, it will be polled\n", endstop_names[n]);
+                }
+            }
+            register_for_event(ON_MAIN_LOOP);
+            this->set_event_rate(ON_MAIN_LOOP, 0, true); // only to halt on a limit edge
+        }
     }
 
     //
@@ -262,7 +296,17 @@ bool Endstops::debounced_get(int pin)
     return false;
 }
 
-static const char *endstop_names[] = {"min_x", "min_y", "min_z", "max_x", "max_y", "max_z"};
+// the homing trigger of an axis, its endstop or the stallguard flag of its driver
+bool Endstops::homing_input(int axis)
+{
+    if(!this->stallguard_homing[axis]) return this->pins[axis + (this->home_direction[axis] ? 0 : 3)].get();
+
+    // stallguard is not valid until the motor is up to speed
+    if(STEPPER[axis]->get_stepped() < this->stallguard_blank_mm * STEPS_PER_MM(axis)) return false;
+    bool stalled = false;
+    PublicData::get_value(motor_driver_control_checksum, stallguard_checksum, 'X' + axis, &stalled);
+    return stalled;
+}
 
 void Endstops::on_idle(void *argument)
 {
@@ -299,7 +343,7 @@ void Endstops::on_idle(void *argument)
             // check min and max endstops
             for (int i : minmax) {
                 int n = c + i;
-                if(debounced_get(n)) {
+                if(!this->limit_watched[n] && debounced_get(n)) {
                     // endstop triggered
                     THEKERNEL->streams->printf("Limit switch %s was hit - reset or M999 required\n", endstop_names[n]);
                     this->status = LIMIT_TRIGGERED;
@@ -312,6 +356,27 @@ void Endstops::on_idle(void *argument)
     }
 }
 
+// in an interrupt once a limit switch has settled on, it holds the steps where they are and the main loop then halts
+// as the polling does
+void Endstops::on_limit_change(int n)
+{
+    if(this->status != NOT_HOMING || !STEPPER[n % 3]->is_moving()) return;
+    THEKERNEL->step_ticker->hold_steps(true);
+    this->status = LIMIT_TRIGGERED;
+    this->limit_hit = n;
+    wake_for_event(ON_MAIN_LOOP);
+}
+
+void Endstops::on_main_loop(void *argument)
+{
+    if(this->limit_hit < 0) return;
+    int n = this->limit_hit;
+    this->limit_hit = -1;
+    THEKERNEL->streams->printf("Limit switch %s was hit - reset or M999 required\n", endstop_names[n]);
+    // disables heaters and motors, ignores incoming Gcode and flushes block queue, the steps held are dropped with it
+    THEKERNEL->call_event(ON_HALT, nullptr);
+}
+
 // if limit switches are enabled, then we must move off of the endstop otherwise we won't be able to move
 // checks if triggered and only backs off if triggered
 void Endstops::back_off_home(char axes_to_move)
@@ -379,36 +444,15 @@ void Endstops::move_to_origin(char axes_to_move)
     this->status = NOT_HOMING;
 }
 
-bool Endstops::wait_for_homed(char axes_to_move)
+// true once the homing input of the axis has been seen often enough in a row
+bool Endstops::homing_triggered(int axis, unsigned int &debounce)
 {
-    bool running = true;
-    unsigned int debounce[3] = {0, 0, 0};
-    while (running) {
-        running = false;
-        THEKERNEL->call_event(ON_IDLE);
-
-        // check if on_halt (eg kill)
-        if(THEKERNEL->is_halted()) return false;
-
-        for ( int c = X_AXIS; c <= Z_AXIS; c++ ) {
-            if ( ( axes_to_move >> c ) & 1 ) {
-                if ( this->pins[c + (this->home_direction[c] ? 0 : 3)].get() ) {
-                    if ( debounce[c] < debounce_count ) {
-                        debounce[c]++;
-                        running = true;
-                    } else if ( STEPPER[c]->is_moving() ) {
-                        STEPPER[c]->move(0, 0);
-                        axes_to_move &= ~(1 << c); // no need to check it again
-                    }
-                } else {
-                    // The endstop was not hit yet
-                    running = true;
-                    debounce[c] = 0;
-                }
-            }
-        }
+    if(!homing_input(axis)) {
+        debounce = 0;
+        return false;
     }
-    return true;
+    // each stallguard reading is an SPI transaction so a few in a row will do
+    return ++debounce >= (this->stallguard_homing[axis] ? 3 : debounce_count);
 }
 
 void Endstops::do_homing_cartesian(char axes_to_move)
@@ -417,50 +461,61 @@ void Endstops::do_homing_cartesian(char axes_to_move)
     if(THEKERNEL->is_halted()) return;
 
     // this homing works for cartesian and delta printers
-    // Start moving the axes to the origin
-    this->status = MOVING_TO_ENDSTOP_FAST;
+    // each axis does its fast seek, retract and slow seek on its own and stops on its own endstop, so an axis that
+    // triggers early is not held up by the others and homing takes as long as the slowest axis
+    char phase[3];
+    unsigned int debounce[3] = {0, 0, 0};
     for ( int c = X_AXIS; c <= Z_AXIS; c++ ) {
         if ( ( axes_to_move >> c) & 1 ) {
+            phase[c] = MOVING_TO_ENDSTOP_FAST;
             this->feed_rate[c] = this->fast_rates[c];
             STEPPER[c]->move(this->home_direction[c], 10000000, 0);
         }
     }
+    // acceleration_tick runs while status is any of the homing moves
+    this->status = MOVING_TO_ENDSTOP_FAST;
+    THEKERNEL->step_ticker->enable_acceleration_tick_handler(this->acceleration_tick_id, true);
 
-    // Wait for all axes to have homed
-    if(!this->wait_for_homed(axes_to_move)) return;
+    while (axes_to_move != 0) {
+        THEKERNEL->call_event(ON_IDLE);
 
-    // Move back a small distance
-    this->status = MOVING_BACK;
-    bool inverted_dir;
-    for ( int c = X_AXIS; c <= Z_AXIS; c++ ) {
-        if ( ( axes_to_move >> c ) & 1 ) {
-            inverted_dir = !this->home_direction[c];
-            this->feed_rate[c] = this->slow_rates[c];
-            STEPPER[c]->move(inverted_dir, this->retract_mm[c]*STEPS_PER_MM(c), 0);
-        }
-    }
+        // check if on_halt (eg kill)
+        if(THEKERNEL->is_halted()) return;
 
-    // Wait for moves to be done
-    for ( int c = X_AXIS; c <= Z_AXIS; c++ ) {
-        if (  ( axes_to_move >> c ) & 1 ) {
-            while ( STEPPER[c]->is_moving() ) {
-                THEKERNEL->call_event(ON_IDLE);
-                if(THEKERNEL->is_halted()) return;
-            }
-        }
-    }
+        for ( int c = X_AXIS; c <= Z_AXIS; c++ ) {
+            if ( ( ( axes_to_move >> c ) & 1 ) == 0 ) continue;
 
-    // Start moving the axes to the origin slowly
-    this->status = MOVING_TO_ENDSTOP_SLOW;
-    for ( int c = X_AXIS; c <= Z_AXIS; c++ ) {
-        if ( ( axes_to_move >> c ) & 1 ) {
-            this->feed_rate[c] = this->slow_rates[c];
-            STEPPER[c]->move(this->home_direction[c], 10000000, 0);
+            switch(phase[c]) {
+                case MOVING_TO_ENDSTOP_FAST:
+                    if(!homing_triggered(c, debounce[c])) break;
+                    STEPPER[c]->move(0, 0);
+                    debounce[c] = 0;
+                    if(this->stallguard_homing[c]) {
+                        // stallguard needs the speed so the fast pass is all there is, there is no switch to back off
+                        axes_to_move &= ~(1 << c);
+                        break;
+                    }
+                    // Move back a small distance
+                    phase[c] = MOVING_BACK;
+                    this->feed_rate[c] = this->slow_rates[c];
+                    STEPPER[c]->move(!this->home_direction[c], this->retract_mm[c]*STEPS_PER_MM(c), 0);
+                    break;
+
+                case MOVING_BACK:
+                    if(STEPPER[c]->is_moving()) break;
+                    // then move to the endstop slowly
+                    phase[c] = MOVING_TO_ENDSTOP_SLOW;
+                    STEPPER[c]->move(this->home_direction[c], 10000000, 0);
+                    break;
+
+                case MOVING_TO_ENDSTOP_SLOW:
+                    if(!homing_triggered(c, debounce[c])) break;
+                    STEPPER[c]->move(0, 0);
+                    axes_to_move &= ~(1 << c); // no need to check it again
+                    break;
+            }
         }
     }
-
-    // Wait for all axes to have homed
-    if(!this->wait_for_homed(axes_to_move)) return;
 }
 
 bool Endstops::wait_for_homed_corexy(int axis)
@@ -498,6 +553,7 @@ void Endstops::corexy_home(int home_axis, bool dirx, bool diry, float fast_rate,
     if(THEKERNEL->is_halted()) return;
 
     this->status = MOVING_TO_ENDSTOP_FAST;
+    THEKERNEL->step_ticker->enable_acceleration_tick_handler(this->acceleration_tick_id, true);
     this->feed_rate[X_AXIS] = fast_rate;
     STEPPER[X_AXIS]->move(dirx, 10000000, 0);
     this->feed_rate[Y_AXIS] = fast_rate;
@@ -508,6 +564,7 @@ void Endstops::corexy_home(int home_axis, bool dirx, bool diry, float fast_rate,
 
     // Move back a small distance
     this->status = MOVING_BACK;
+    THEKERNEL->step_ticker->enable_acceleration_tick_handler(this->acceleration_tick_id, true);
     this->feed_rate[X_AXIS] = slow_rate;
     STEPPER[X_AXIS]->move(!dirx, retract_steps, 0);
     this->feed_rate[Y_AXIS] = slow_rate;
@@ -521,6 +578,7 @@ void Endstops::corexy_home(int home_axis, bool dirx, bool diry, float fast_rate,
 
     // Start moving the axes to the origin slowly
     this->status = MOVING_TO_ENDSTOP_SLOW;
+    THEKERNEL->step_ticker->enable_acceleration_tick_handler(this->acceleration_tick_id, true);
     this->feed_rate[X_AXIS] = slow_rate;
     STEPPER[X_AXIS]->move(dirx, 10000000, 0);
     this->feed_rate[Y_AXIS] = slow_rate;
@@ -560,6 +618,7 @@ void Endstops::do_homing_corexy(char axes_to_move)
 
         // then move both X and Y until one hits the endstop
         this->status = MOVING_TO_ENDSTOP_FAST;
+        THEKERNEL->step_ticker->enable_acceleration_tick_handler(this->acceleration_tick_id, true);
         // need to allow for more ground covered when moving diagonally
         this->feed_rate[motor] = this->fast_rates[motor] * 1.4142;
         STEPPER[motor]->move(dir, 10000000, 0);
@@ -931,7 +990,11 @@ void Endstops::on_gcode_received(void *argument)
 // Called periodically to change the speed to match acceleration
 void Endstops::acceleration_tick(void)
 {
-    if(this->status >= NOT_HOMING) return; // nothing to do, only do this when moving for homing sequence
+    if(this->status >= NOT_HOMING) {
+        // nothing to do, only do this when moving for homing sequence
+        THEKERNEL->step_ticker->enable_acceleration_tick_handler(this->acceleration_tick_id, false);
+        return;
+    }
 
     // foreach stepper that is moving
     for ( int c = X_AXIS; c <= Z_AXIS; c++ ) {
@@ -28,7 +28,6 @@ class Endstops : public Module{
         void home(char axes_to_move);
         void do_homing_cartesian(char axes_to_move);
         void do_homing_corexy(char axes_to_move);
-        bool wait_for_homed(char axes_to_move);
         bool wait_for_homed_corexy(int axis);
         void corexy_home(int home_axis, bool dirx, bool diry, float fast_rate, float slow_rate, unsigned int retract_steps);
         void back_off_home(char axes_to_move);
@@ -36,15 +35,21 @@ class Endstops : public Module{
         void on_get_public_data(void* argument);
         void on_set_public_data(void* argument);
         void on_idle(void *argument);
+        void on_main_loop(void *argument);
+        void on_limit_change(int n);
         bool debounced_get(int pin);
+        bool homing_input(int axis);
+        bool homing_triggered(int axis, unsigned int &debounce);
         void process_home_command(Gcode* gcode);
         void set_homing_offset(Gcode* gcode);
 
         float homing_position[3];
         float home_offset[3];
         uint8_t homing_order;
+        uint8_t acceleration_tick_id;
         std::bitset<3> home_direction;
         std::bitset<3> limit_enable;
+        std::bitset<3> stallguard_homing;
         float saved_position[3]{0}; // save G28 (in grbl mode)
 
         unsigned int  debounce_count;
@@ -52,7 +57,10 @@ class Endstops : public Module{
         float  trim_mm[3];
         float  fast_rates[3];
         float  slow_rates[3];
+        float  stallguard_blank_mm;
         Pin    pins[6];
+        std::bitset<6> limit_watched;   // the limit switches that report their changes instead of being polled
+        volatile int8_t limit_hit;      // the switch that was hit, for the main loop to report and halt
         volatile float feed_rate[3];
         struct {
             bool is_corexy:1;
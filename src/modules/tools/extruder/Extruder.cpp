@@ -19,15 +19,18 @@
 #include "Config.h"
 #include "StepperMotor.h"
 #include "Robot.h"
+#include "Planner.h"
 #include "checksumm.h"
 #include "ConfigValue.h"
 #include "Gcode.h"
 #include "libs/StreamOutput.h"
 #include "PublicDataRequest.h"
+#include "PublicData.h"
 #include "StreamOutputPool.h"
 #include "ExtruderPublicAccess.h"
 
 #include <mri.h>
+#include <algorithm>
 
 // OLD config names for backwards compatibility, NOTE new configs will not be added here
 #define extruder_module_enable_checksum      CHECKSUM("extruder_module_enable")
@@ -60,6 +63,9 @@
 #define retract_recover_feedrate_checksum    CHECKSUM("retract_recover_feedrate")
 #define retract_zlift_length_checksum        CHECKSUM("retract_zlift_length")
 #define retract_zlift_feedrate_checksum      CHECKSUM("retract_zlift_feedrate")
+#define retract_zlift_on_travel_checksum     CHECKSUM("retract_zlift_on_travel")
+#define pressure_advance_checksum            CHECKSUM("pressure_advance")
+#define planner_axis_checksum                CHECKSUM("planner_axis")
 
 #define X_AXIS      0
 #define Y_AXIS      1
@@ -82,14 +88,21 @@ Extruder::Extruder( uint16_t config_identifier, bool single )
     this->absolute_mode = true;
     this->milestone_absolute_mode = true;
     this->enabled = false;
+    this->selected = false;
     this->single_config = single;
     this->identifier = config_identifier;
     this->retracted = false;
     this->volumetric_multiplier = 1.0F;
     this->extruder_multiplier = 1.0F;
     this->stepper_motor = nullptr;
+    this->planner_axis = -1;
     this->milestone_last_position = 0;
     this->max_volumetric_rate = 0;
+    this->pressure_advance = 0;
+    this->advance_position = 0;
+    this->last_follow_rate = 0;
+    this->advance_rate = 0;
+    this->follow_ratio = 0;
 
     memset(this->offset, 0, sizeof(this->offset));
 }
@@ -105,6 +118,7 @@ void Extruder::on_halt(void *arg)
         // turn off motor
         this->en_pin.set(1);
     }
+    this->advance_position = 0;
 }
 
 void Extruder::on_module_loaded()
@@ -128,11 +142,14 @@ void Extruder::on_module_loaded()
     this->register_for_event(ON_SPEED_CHANGE);
     this->register_for_event(ON_GET_PUBLIC_DATA);
     this->register_for_event(ON_SET_PUBLIC_DATA);
+    this->register_for_event(ON_CONFIG_CHANGED);
+    PublicData::register_handler(this, extruder_checksum);
 
     // Update speed every *acceleration_ticks_per_second*
-    THEKERNEL->step_ticker->register_acceleration_tick_handler([this]() {
-        acceleration_tick();
-    });
+    // Update speed every *acceleration_ticks_per_second*, only while it moves on its own
+    this->acceleration_tick_id = THEKERNEL->step_ticker->register_acceleration_tick_handler([](void *e) {
+        static_cast<Extruder *>(e)->acceleration_tick();
+    }, this, "RIT extruder", false);
 }
 
 // Get config
@@ -155,6 +172,7 @@ void Extruder::on_config_reload(void *argument)
         }
 
         this->enabled = true;
+        this->selected = true;
 
     } else {
         // If this module was created with the new multi extruder configuration style
@@ -174,13 +192,7 @@ void Extruder::on_config_reload(void *argument)
 
     }
 
-    // these are only supported in the new syntax, no need to be backward compatible as they did not exist before the change
-    this->retract_length           = THEKERNEL->config->value(extruder_checksum, this->identifier, retract_length_checksum)->by_default(3)->as_number();
-    this->retract_feedrate         = THEKERNEL->config->value(extruder_checksum, this->identifier, retract_feedrate_checksum)->by_default(45)->as_number();
-    this->retract_recover_length   = THEKERNEL->config->value(extruder_checksum, this->identifier, retract_recover_length_checksum)->by_default(0)->as_number();
-    this->retract_recover_feedrate = THEKERNEL->config->value(extruder_checksum, this->identifier, retract_recover_feedrate_checksum)->by_default(8)->as_number();
-    this->retract_zlift_length     = THEKERNEL->config->value(extruder_checksum, this->identifier, retract_zlift_length_checksum)->by_default(0)->as_number();
-    this->retract_zlift_feedrate   = THEKERNEL->config->value(extruder_checksum, this->identifier, retract_zlift_feedrate_checksum)->by_default(100 * 60)->as_number(); // mm/min
+    load_tuning();
 
     if(filament_diameter > 0.01F) {
         this->volumetric_multiplier = 1.0F / (powf(this->filament_diameter / 2, 2) * PI);
@@ -188,12 +200,78 @@ void Extruder::on_config_reload(void *argument)
 
     // Stepper motor object for the extruder
     this->stepper_motor = new StepperMotor(step_pin, dir_pin, en_pin);
-    this->stepper_motor->attach(this, &Extruder::stepper_motor_finished_move );
     if( this->single_config ) {
         this->stepper_motor->set_max_rate(THEKERNEL->config->value(extruder_max_speed_checksum)->by_default(1000)->as_number());
     } else {
         this->stepper_motor->set_max_rate(THEKERNEL->config->value(extruder_checksum, this->identifier, max_speed_checksum)->by_default(1000)->as_number());
     }
+
+    // the motor can be an extra axis of the robot instead, then E is planned and stepped with the move it is in
+    if(THEKERNEL->config->value(extruder_checksum, this->identifier, planner_axis_checksum)->by_default(false)->as_bool()) {
+        this->stepper_motor->change_steps_per_mm(this->steps_per_millimeter);
+        this->stepper_motor->set_acceleration(this->acceleration);
+        this->planner_axis = THEKERNEL->robot->add_extra_axis('E', this->stepper_motor);
+        if(this->planner_axis < 0) {
+            THEKERNEL->streams->printf("Error: extruder planner_axis needs a firmware built with more actuators (make AXIS=4)\n");
+        } else {
+            update_axis_scale();
+        }
+    }
+    if(this->planner_axis < 0) {
+        this->stepper_motor->attach(this, &Extruder::stepper_motor_finished_move );
+    }
+}
+
+// these are only supported in the new syntax, no need to be backward compatible as they did not exist before the change
+// they are also read again by on_config_changed
+void Extruder::load_tuning()
+{
+    this->retract_length           = THEKERNEL->config->value(extruder_checksum, this->identifier, retract_length_checksum)->by_default(3)->as_number();
+    this->retract_feedrate         = THEKERNEL->config->value(extruder_checksum, this->identifier, retract_feedrate_checksum)->by_default(45)->as_number();
+    this->retract_recover_length   = THEKERNEL->config->value(extruder_checksum, this->identifier, retract_recover_length_checksum)->by_default(0)->as_number();
+    this->retract_recover_feedrate = THEKERNEL->config->value(extruder_checksum, this->identifier, retract_recover_feedrate_checksum)->by_default(8)->as_number();
+    this->retract_zlift_length     = THEKERNEL->config->value(extruder_checksum, this->identifier, retract_zlift_length_checksum)->by_default(0)->as_number();
+    this->retract_zlift_feedrate   = THEKERNEL->config->value(extruder_checksum, this->identifier, retract_zlift_feedrate_checksum)->by_default(100 * 60)->as_number(); // mm/min
+    this->zlift_on_travel          = THEKERNEL->config->value(extruder_checksum, this->identifier, retract_zlift_on_travel_checksum)->by_default(false)->as_bool();
+    this->pressure_advance         = THEKERNEL->config->value(extruder_checksum, this->identifier, pressure_advance_checksum)->by_default(0)->as_number(); // seconds
+}
+
+void Extruder::on_config_changed(void *argument)
+{
+    ConfigChange *change = static_cast<ConfigChange *>(argument);
+    if(!change->is_for(extruder_checksum, this->identifier)) return;
+
+    static const uint16_t tuning[] = {
+        retract_length_checksum, retract_feedrate_checksum, retract_recover_length_checksum, retract_recover_feedrate_checksum,
+        retract_zlift_length_checksum, retract_zlift_feedrate_checksum, retract_zlift_on_travel_checksum, pressure_advance_checksum
+    };
+    if(std::find(std::begin(tuning), std::end(tuning), change->check_sums[2]) == std::end(tuning)) return;
+
+    load_tuning();
+    change->applied++;
+}
+
+// the E words of the planned axis are multiplied by this to get mm of filament
+void Extruder::update_axis_scale()
+{
+    if(this->planner_axis >= 0) {
+        THEKERNEL->robot->set_extra_axis_scale(this->planner_axis, this->volumetric_multiplier * this->extruder_multiplier);
+    }
+}
+
+// the retract or unretract itself, a block of its own for this extruder, or a move of just E in the planner
+void Extruder::queue_retract(Gcode *gcode)
+{
+    if(this->planner_axis >= 0) {
+        if(gcode->g == 10) {
+            THEKERNEL->robot->move_extra_axis(this->planner_axis, -retract_length, retract_feedrate);
+        } else {
+            THEKERNEL->robot->move_extra_axis(this->planner_axis, retract_length + retract_recover_length, retract_recover_feedrate);
+        }
+        return;
+    }
+    THEKERNEL->conveyor->append_gcode(gcode);
+    THEKERNEL->conveyor->queue_head_block();
 }
 
 void Extruder::on_get_public_data(void *argument)
@@ -202,6 +280,29 @@ void Extruder::on_get_public_data(void *argument)
 
     if(!pdr->starts_with(extruder_checksum)) return;
 
+    if(pdr->second_element_is(flow_rate_checksum)) {
+        // how fast this extruder is pushing filament right now, mm³/sec or mm/sec if the filament diameter is not set
+        if(this->enabled && (this->identifier == 0 || pdr->third_element_is(this->identifier))) {
+            static float rate;
+            rate= this->stepper_motor->is_moving() ? this->stepper_motor->get_steps_per_second() / this->steps_per_millimeter : 0;
+            if(this->filament_diameter > 0.01F) rate *= powf(this->filament_diameter / 2, 2) * PI;
+            pdr->set_data_ptr(&rate);
+            pdr->set_taken();
+        }
+        return;
+    }
+
+    if(pdr->second_element_is(position_checksum)) {
+        if(this->selected) {
+            static pad_extruder_position p;
+            p.position= this->planner_axis >= 0 ? THEKERNEL->robot->get_extra_requested(this->planner_axis) : this->target_position;
+            p.absolute_mode= this->absolute_mode;
+            pdr->set_data_ptr(&p);
+            pdr->set_taken();
+        }
+        return;
+    }
+
     if(this->enabled) {
         // Note this is allowing both step/mm and filament diameter to be exposed via public data
         pdr->set_data_ptr(&this->steps_per_millimeter);
@@ -210,7 +311,8 @@ void Extruder::on_get_public_data(void *argument)
 }
 
 // check against maximum speeds and return the rate modifier
-float Extruder::check_max_speeds(float target, float isecs)
+// with pressure advance the extruder also has to make up K * acceleration * (E / mm) while the move accelerates
+float Extruder::check_max_speeds(float target, float isecs, float millimeters)
 {
     float rm = 1.0F; // default no rate modification
     float delta;
@@ -246,8 +348,13 @@ float Extruder::check_max_speeds(float target, float isecs)
 
         float sm = 1.0F;
         float v = delta * isecs; // the speed in mm/sec
-        if(v > max_speed) {
-            sm *= (max_speed / v);
+        float advance = 0;
+        if(this->pressure_advance > 0 && millimeters > 0.00001F) {
+            advance = this->pressure_advance * THEKERNEL->planner->get_acceleration() * delta * this->extruder_multiplier / millimeters;
+        }
+        if(v + advance > max_speed) {
+            // the advance does not get smaller with the feedrate, leave it 10% of the max speed if it takes more than that
+            sm *= max(max_speed - advance, max_speed * 0.1F) / v;
         }
         //THEKERNEL->streams->printf("requested speed: %f mm/sec, corrected speed: %f  mm/sec\n", v, v * sm);
         rm *= sm;
@@ -263,15 +370,16 @@ void Extruder::on_set_public_data(void *argument)
 
     // handle extrude rates request from robot
     if(pdr->second_element_is(target_checksum)) {
-        // disabled extruders do not reply NOTE only one enabled extruder supported
-        if(!this->enabled) return;
+        // this is asked while planning so it is the selected extruder that replies NOTE only one selected extruder supported
+        if(!this->selected) return;
 
         float *d = static_cast<float *>(pdr->get_data_ptr());
         float target = d[0]; // the E passed in on Gcode is in mm³ (maybe absolute or relative)
         float isecs = d[1]; // inverted secs
+        float millimeters = d[2]; // length of the move
 
         // check against maximum speeds and return rate modifier
-        d[1] = check_max_speeds(target, isecs);
+        d[1] = check_max_speeds(target, isecs, millimeters);
 
         pdr->set_taken();
         return;
@@ -294,24 +402,26 @@ void Extruder::on_gcode_received(void *argument)
 {
     Gcode *gcode = static_cast<Gcode *>(argument);
 
-    // M codes most execute immediately, most only execute if enabled
+    // M codes most execute immediately, most only execute if selected
     if (gcode->has_m) {
-        if (gcode->m == 114 && gcode->subcode == 0 && this->enabled) {
+        if (gcode->m == 114 && gcode->subcode == 0 && this->selected && this->planner_axis < 0) {
+            // when it is planned the robot has E in its position
             char buf[16];
             int n = snprintf(buf, sizeof(buf), " E:%1.3f ", this->current_position);
             gcode->txt_after_ok.append(buf, n);
 
-        } else if (gcode->m == 92 && ( (this->enabled && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier) ) ) {
+        } else if (gcode->m == 92 && ( (this->selected && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier) ) ) {
             float spm = this->steps_per_millimeter;
             if (gcode->has_letter('E')) {
                 spm = gcode->get_value('E');
                 this->steps_per_millimeter = spm;
+                if(this->planner_axis >= 0) this->stepper_motor->change_steps_per_mm(spm);
             }
 
             gcode->stream->printf("E:%g ", spm);
             gcode->add_nl = true;
 
-        } else if (gcode->m == 200 && ( (this->enabled && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier)) ) {
+        } else if (gcode->m == 200 && ( (this->selected && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier)) ) {
             if (gcode->has_letter('D')) {
                 THEKERNEL->conveyor->wait_for_empty_queue(); // only apply after the queue has emptied
                 this->filament_diameter = gcode->get_value('D');
@@ -320,6 +430,7 @@ void Extruder::on_gcode_received(void *argument)
                 } else {
                     this->volumetric_multiplier = 1.0F;
                 }
+                update_axis_scale();
             } else {
                 if(filament_diameter > 0.01F) {
                     gcode->stream->printf("Filament Diameter: %f\n", this->filament_diameter);
@@ -328,7 +439,7 @@ void Extruder::on_gcode_received(void *argument)
                 }
             }
 
-        } else if (gcode->m == 203 && ( (this->enabled && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier)) ) {
+        } else if (gcode->m == 203 && ( (this->selected && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier)) ) {
             // M203 Exxx Vyyy Set maximum feedrates xxx mm/sec and/or yyy mm³/sec
             if(gcode->get_num_args() == 0) {
                 gcode->stream->printf("E:%g V:%g", this->stepper_motor->get_max_rate(), this->max_volumetric_rate);
@@ -344,25 +455,35 @@ void Extruder::on_gcode_received(void *argument)
             }
 
         } else if (gcode->m == 204 && gcode->has_letter('E') &&
-                   ( (this->enabled && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier)) ) {
+                   ( (this->selected && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier)) ) {
             // extruder acceleration M204 Ennn mm/sec^2 (Pnnn sets the specific extruder for M500)
             this->acceleration = gcode->get_value('E');
+            if(this->planner_axis >= 0) this->stepper_motor->set_acceleration(this->acceleration);
 
-        } else if (gcode->m == 207 && ( (this->enabled && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier)) ) {
+        } else if (gcode->m == 207 && ( (this->selected && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier)) ) {
             // M207 - set retract length S[positive mm] F[feedrate mm/min] Z[additional zlift/hop] Q[zlift feedrate mm/min]
             if(gcode->has_letter('S')) retract_length = gcode->get_value('S');
             if(gcode->has_letter('F')) retract_feedrate = gcode->get_value('F') / 60.0F; // specified in mm/min converted to mm/sec
             if(gcode->has_letter('Z')) retract_zlift_length = gcode->get_value('Z');
             if(gcode->has_letter('Q')) retract_zlift_feedrate = gcode->get_value('Q');
 
-        } else if (gcode->m == 208 && ( (this->enabled && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier)) ) {
+        } else if (gcode->m == 208 && ( (this->selected && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier)) ) {
             // M208 - set retract recover length S[positive mm surplus to the M207 S*] F[feedrate mm/min]
             if(gcode->has_letter('S')) retract_recover_length = gcode->get_value('S');
             if(gcode->has_letter('F')) retract_recover_feedrate = gcode->get_value('F') / 60.0F; // specified in mm/min converted to mm/sec
 
-        } else if (gcode->m == 221 && this->enabled) { // M221 S100 change flow rate by percentage
+        } else if (gcode->m == 572 && ( (this->selected && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier)) ) {
+            // M572 Snnn set the pressure advance in seconds, 0 disables it
+            if(gcode->has_letter('S')) {
+                this->pressure_advance = max(gcode->get_value('S'), 0.0F);
+            } else {
+                gcode->stream->printf("Pressure advance: %g s\n", this->pressure_advance);
+            }
+
+        } else if (gcode->m == 221 && this->selected) { // M221 S100 change flow rate by percentage
             if(gcode->has_letter('S')) {
                 this->extruder_multiplier = gcode->get_value('S') / 100.0F;
+                update_axis_scale();
             } else {
                 gcode->stream->printf("Flow rate at %6.2f %%\n", this->extruder_multiplier * 100.0F);
             }
@@ -378,6 +499,7 @@ void Extruder::on_gcode_received(void *argument)
                 if(this->max_volumetric_rate > 0) {
                     gcode->stream->printf(";E max volumetric rate mm³/sec:\nM203 V%1.4f\n", this->max_volumetric_rate);
                 }
+                gcode->stream->printf(";E pressure advance secs:\nM572 S%1.4f\n", this->pressure_advance);
 
             } else {
                 gcode->stream->printf(";E Steps per mm:\nM92 E%1.4f P%d\n", this->steps_per_millimeter, this->identifier);
@@ -389,6 +511,7 @@ void Extruder::on_gcode_received(void *argument)
                 if(this->max_volumetric_rate > 0) {
                     gcode->stream->printf(";E max volumetric rate mm³/sec:\nM203 V%1.4f P%d\n", this->max_volumetric_rate, this->identifier);
                 }
+                gcode->stream->printf(";E pressure advance secs:\nM572 S%1.4f P%d\n", this->pressure_advance, this->identifier);
             }
 
         } else if( gcode->m == 17 || gcode->m == 18 || gcode->m == 82 || gcode->m == 83 || gcode->m == 84 ) {
@@ -398,18 +521,18 @@ void Extruder::on_gcode_received(void *argument)
         }
 
     } else if(gcode->has_g) {
-        // G codes, NOTE some are ignored if not enabled
+        // G codes, NOTE some are ignored if not selected
         if( (gcode->g == 92 && gcode->has_letter('E')) || (gcode->g == 90 || gcode->g == 91) ) {
             // Gcodes to pass along to on_gcode_execute
             THEKERNEL->conveyor->append_gcode(gcode);
 
-        } else if( this->enabled && gcode->g < 4 && gcode->has_letter('E') && fabsf(gcode->millimeters_of_travel) < 0.00001F ) { // With floating numbers, we can have 0 != 0, NOTE needs to be same as in Robot.cpp#745
+        } else if( this->selected && this->planner_axis < 0 && gcode->g < 4 && gcode->has_letter('E') && fabsf(gcode->millimeters_of_travel) < 0.00001F ) { // With floating numbers, we can have 0 != 0, NOTE needs to be same as in Robot.cpp#745
             // NOTE was ... gcode->has_letter('E') && !gcode->has_letter('X') && !gcode->has_letter('Y') && !gcode->has_letter('Z') ) {
             // This is a SOLO move, we add an empty block to the queue to prevent subsequent gcodes being executed at the same time
             THEKERNEL->conveyor->append_gcode(gcode);
             THEKERNEL->conveyor->queue_head_block();
 
-        } else if( this->enabled && (gcode->g == 10 || gcode->g == 11) && !gcode->has_letter('L') ) {
+        } else if( this->selected && (gcode->g == 10 || gcode->g == 11) && !gcode->has_letter('L') ) {
             // firmware retract command (Ignore if has L parameter that is not for us)
             // check we are in the correct state of retract or unretract
             if(gcode->g == 10 && !retracted) {
@@ -422,6 +545,25 @@ void Extruder::on_gcode_received(void *argument)
 
             // now we do a special hack to add zlift if needed, this should go in Robot but if it did the zlift would be executed before retract which is bad
             // this way zlift will happen after retract, (or before for unretract) NOTE we call the robot->on_gcode_receive directly to avoid recursion
+            if(retract_zlift_length > 0 && this->zlift_on_travel) {
+                // the travel after the retract rises as it goes, and any Z it goes to is lifted, the lift ends in a Z move before unretract
+                if(gcode->g == 10) {
+                    queue_retract(gcode);
+                    THEKERNEL->robot->set_zhop(retract_zlift_length);
+                } else {
+                    THEKERNEL->robot->set_zhop(0);
+                    char buf[32];
+                    int n = snprintf(buf, sizeof(buf), "G0 F%1.4f", retract_zlift_feedrate);
+                    string cmd(buf, n);
+                    Gcode gc(cmd, &(StreamOutput::NullStream));
+                    THEKERNEL->robot->push_state();
+                    THEKERNEL->robot->on_gcode_received(&gc); // comes down from wherever the hop is now
+                    THEKERNEL->robot->pop_state();
+                    queue_retract(gcode);
+                }
+                return;
+            }
+
             if(retract_zlift_length > 0 && gcode->g == 11 && !this->cancel_zlift_restore) {
                 // reverse zlift happens before unretract
                 // NOTE we do not do this if cancel_zlift_restore is set to true, which happens if there is an absolute Z move inbetween G10 and G11
@@ -436,8 +578,7 @@ void Extruder::on_gcode_received(void *argument)
             }
 
             // This is a solo move, we add an empty block to the queue to prevent subsequent gcodes being executed at the same time
-            THEKERNEL->conveyor->append_gcode(gcode);
-            THEKERNEL->conveyor->queue_head_block();
+            queue_retract(gcode);
 
             if(retract_zlift_length > 0 && gcode->g == 10) {
                 char buf[32];
@@ -450,7 +591,7 @@ void Extruder::on_gcode_received(void *argument)
                 THEKERNEL->robot->pop_state(); // restore state includes feed rates etc
             }
 
-        } else if( this->enabled && this->retracted && (gcode->g == 0 || gcode->g == 1) && gcode->has_letter('Z')) {
+        } else if( this->selected && this->retracted && (gcode->g == 0 || gcode->g == 1) && gcode->has_letter('Z')) {
             // NOTE we cancel the zlift restore for the following G11 as we have moved to an absolute Z which we need to stay at
             this->cancel_zlift_restore = true;
         }
@@ -469,7 +610,7 @@ void Extruder::on_gcode_received(void *argument)
             case 90: this->milestone_absolute_mode = true; break;
             case 91: this->milestone_absolute_mode = false; break;
             case 92:
-                if(this->enabled) {
+                if(this->selected) {
                     if(gcode->has_letter('E')) {
                         this->milestone_last_position = gcode->get_value('E');
                     } else if(gcode->get_num_args() == 0) {
@@ -515,6 +656,9 @@ void Extruder::on_gcode_execute(void *argument)
         return;
     }
 
+    // the robot moves the planned axis
+    if(this->planner_axis >= 0) return;
+
 
     if( gcode->has_g && this->enabled ) {
         // G92: Reset extruder position
@@ -545,7 +689,7 @@ void Extruder::on_gcode_execute(void *argument)
             this->target_position += this->travel_distance;
             this->en_pin.set(0);
 
-        } else if (gcode->g <= 3) {
+        } else if (gcode->g <= 3 || gcode->g == 5) {
             // Extrusion length from 'G' Gcode
             if( gcode->has_letter('E' )) {
                 // Get relative extrusion distance depending on mode ( in absolute mode we must subtract target_position )
@@ -584,7 +728,7 @@ void Extruder::on_gcode_execute(void *argument)
 // When a new block begins, either follow the robot, or step by ourselves ( or stay back and do nothing )
 void Extruder::on_block_begin(void *argument)
 {
-    if(!this->enabled) return;
+    if(!this->enabled || this->planner_axis >= 0) return;
 
     if( this->mode == OFF ) {
         this->current_block = NULL;
@@ -593,31 +737,38 @@ void Extruder::on_block_begin(void *argument)
     }
 
     Block *block = static_cast<Block *>(argument);
+    float distance;
     if( this->mode == FOLLOW ) {
         // In FOLLOW mode, we just follow the stepper module
         this->travel_distance = block->millimeters * this->travel_ratio;
+        distance = this->travel_distance + follow_advance(block);
+    } else {
+        distance = this->travel_distance;
     }
 
     // common for both FOLLOW and SOLO
     this->current_position += this->travel_distance ;
 
     // round down, we take care of the fractional part next time
-    int steps_to_step = abs((int)floorf(this->steps_per_millimeter * (this->travel_distance + this->unstepped_distance) ));
+    int steps_to_step = abs((int)floorf(this->steps_per_millimeter * (distance + this->unstepped_distance) ));
 
     // accumulate the fractional part
-    if ( this->travel_distance > 0 ) {
-        this->unstepped_distance += this->travel_distance - (steps_to_step / this->steps_per_millimeter);
+    if ( distance > 0 ) {
+        this->unstepped_distance += distance - (steps_to_step / this->steps_per_millimeter);
     } else {
-        this->unstepped_distance += this->travel_distance + (steps_to_step / this->steps_per_millimeter);
+        this->unstepped_distance += distance + (steps_to_step / this->steps_per_millimeter);
     }
 
     if( steps_to_step != 0 ) {
         // We take the block, we have to release it or everything gets stuck
         block->take();
         this->current_block = block;
-        this->stepper_motor->move( (this->travel_distance > 0), steps_to_step);
+        this->stepper_motor->move( (distance > 0), steps_to_step);
 
         if(this->mode == FOLLOW) {
+            // the share of the main stepper rate that is the plain extrusion, the advance comes on top of it
+            this->follow_ratio = fabsf(this->travel_distance) * this->steps_per_millimeter / block->steps_event_count;
+            this->last_follow_rate = THEKERNEL->stepper->get_trapezoid_adjusted_rate();
             on_speed_change(this); // set initial speed
             this->stepper_motor->set_moved_last_block(true);
         } else {
@@ -625,6 +776,7 @@ void Extruder::on_block_begin(void *argument)
             uint32_t target_rate = floorf(this->feed_rate * this->steps_per_millimeter);
             this->stepper_motor->set_speed(min( target_rate, rate_increase() ));  // start at first acceleration step
             this->stepper_motor->set_moved_last_block(false);
+            THEKERNEL->step_ticker->enable_acceleration_tick_handler(this->acceleration_tick_id, true);
         }
 
     } else {
@@ -640,6 +792,25 @@ void Extruder::on_block_end(void *argument)
 {
     if(!this->enabled) return;
     this->current_block = NULL;
+    THEKERNEL->step_ticker->enable_acceleration_tick_handler(this->acceleration_tick_id, false);
+}
+
+// Pressure advance keeps K * (E / mm) * speed of extra filament pushed into the melt zone, so it is ahead of the pressure
+// lag when the move speeds up and is taken back when it slows down. This returns how much of that this block has to add
+// to reach the amount for its exit speed, and sets the rate the extruder steps at while the move accelerates.
+// Retracts and moves that take back more than the block extrudes carry the rest over to the next block.
+float Extruder::follow_advance(const Block *block)
+{
+    this->advance_rate = 0;
+    if(this->pressure_advance <= 0 || this->travel_ratio <= 0) return 0;
+
+    float k = this->pressure_advance * this->travel_ratio;
+    float delta = k * block->exit_speed - this->advance_position;
+    if(this->travel_distance + delta < 0) delta = -this->travel_distance;
+    this->advance_position += delta;
+
+    this->advance_rate = k * block->acceleration * this->steps_per_millimeter;
+    return delta;
 }
 
 uint32_t Extruder::rate_increase() const
@@ -694,7 +865,26 @@ void Extruder::on_speed_change( void *argument )
     * or even : ( stepper steps per second ) * ( extruder steps / current block's steps )
     */
 
-    this->stepper_motor->set_speed(THEKERNEL->stepper->get_trapezoid_adjusted_rate() * (float)this->stepper_motor->get_steps_to_move() / (float)this->current_block->steps_event_count);
+    float rate = THEKERNEL->stepper->get_trapezoid_adjusted_rate();
+    if(this->advance_rate <= 0) {
+        this->stepper_motor->set_speed(rate * (float)this->stepper_motor->get_steps_to_move() / (float)this->current_block->steps_event_count);
+        return;
+    }
+
+    // with pressure advance the extruder runs ahead of the proportional rate while accelerating and behind it while
+    // decelerating, by K * acceleration. Which of the two it is follows from how the main stepper rate changed since the
+    // last tick. The integral of that over the block is the advance follow_advance() added to the steps.
+    float e_rate = rate * this->follow_ratio;
+    if(rate > this->last_follow_rate) {
+        e_rate += this->advance_rate;
+    } else if(rate < this->last_follow_rate) {
+        e_rate -= this->advance_rate;
+    }
+    this->last_follow_rate = rate;
+
+    float max_rate = this->stepper_motor->get_max_rate() * this->steps_per_millimeter;
+    if(max_rate > 0 && e_rate > max_rate) e_rate = max_rate;
+    this->stepper_motor->set_speed(e_rate);
 }
 
 // When the stepper has finished it's move
@@ -15,6 +15,7 @@
 
 class StepperMotor;
 class Block;
+class Gcode;
 
 // NOTE Tool is also a module, no need for multiple inheritance here
 class Extruder : public Tool {
@@ -30,6 +31,7 @@ class Extruder : public Tool {
         void     on_block_end(void* argument);
         void     on_halt(void* argument);
         void     on_speed_change(void* argument);
+        void     on_config_changed(void* argument);
         void     acceleration_tick(void);
         uint32_t stepper_motor_finished_move(uint32_t dummy);
         Block*   append_empty_block();
@@ -38,7 +40,11 @@ class Extruder : public Tool {
         void on_get_public_data(void* argument);
         void on_set_public_data(void* argument);
         uint32_t rate_increase() const;
-        float check_max_speeds(float target, float isecs);
+        float check_max_speeds(float target, float isecs, float millimeters);
+        float follow_advance(const Block *block);
+        void load_tuning();
+        void update_axis_scale();
+        void queue_retract(Gcode *gcode);
 
         StepperMotor*  stepper_motor;
         Pin            step_pin;                     // Step pin for the stepper driver
@@ -47,6 +53,7 @@ class Extruder : public Tool {
         float          target_position;              // End point ( in mm ) for the current move
         float          unstepped_distance;           // overflow buffer for requested moves that are less than 1 step
         Block*         current_block;                // Current block we are stepping, same as Stepper's one
+        uint8_t        acceleration_tick_id;         // enabled while it steps a SOLO move
 
         // kept together so they can be passed as public data
         struct {
@@ -67,6 +74,15 @@ class Extruder : public Tool {
         float travel_ratio;
         float travel_distance;
 
+        // pressure advance
+        float pressure_advance;         // K in seconds, extra filament is K * extrusion speed, 0 is off
+        float advance_position;         // the extra filament pushed so far in mm
+        float advance_rate;             // K * acceleration for the current block in steps/sec, 0 when not advancing
+        float follow_ratio;             // extruder steps per main stepper step for the current block, without the advance
+        float last_follow_rate;         // main stepper rate at the last speed change
+
+        int8_t planner_axis;            // the extra axis of the robot the motor is, -1 when it follows the blocks itself
+
         // for firmware retract
         float retract_feedrate;
         float retract_recover_feedrate;
@@ -81,6 +97,7 @@ class Extruder : public Tool {
             bool single_config:1;
             bool retracted:1;
             bool cancel_zlift_restore:1; // hack to stop a G11 zlift restore from overring an absolute Z setting
+            bool zlift_on_travel:1;     // the zlift is a z hop taken up by the travel after the retract
             bool milestone_absolute_mode:1;
         };
 
@@ -4,3 +4,11 @@
 #define save_state_checksum                  CHECKSUM("save_state")
 #define restore_state_checksum               CHECKSUM("restore_state")
 #define target_checksum                      CHECKSUM("target")
+#define flow_rate_checksum                   CHECKSUM("flow_rate")
+#define position_checksum                    CHECKSUM("position")
+
+// the E the gcode has asked the selected extruder to go to
+struct pad_extruder_position {
+    float position;
+    bool absolute_mode;
+};
@@ -20,6 +20,7 @@
 #include "Gcode.h"
 
 #include "InterruptIn.h" // mbed
+#include "PinChange.h"
 #include "us_ticker_api.h" // mbed
 
 #define extruder_checksum CHECKSUM("extruder")
@@ -28,8 +29,9 @@
 #define enable_checksum             CHECKSUM("enable")
 #define encoder_pin_checksum        CHECKSUM("encoder_pin")
 #define bulge_pin_checksum          CHECKSUM("bulge_pin")
-#define seconds_per_check_checksum  CHECKSUM("seconds_per_check")
+#define check_mm_checksum           CHECKSUM("check_mm")
 #define pulses_per_mm_checksum      CHECKSUM("pulses_per_mm")
+#define min_pulse_ratio_checksum    CHECKSUM("min_pulse_ratio")
 
 FilamentDetector::FilamentDetector()
 {
@@ -37,6 +39,7 @@ FilamentDetector::FilamentDetector()
     filament_out_alarm= false;
     bulge_detected= false;
     active= true;
+    block_done= false;
     e_last_moved= NAN;
 }
 
@@ -60,10 +63,13 @@ void FilamentDetector::on_module_loaded()
     this->encoder_pin= dummy_pin.interrupt_pin();
 
     // optional bulge detector
-    bulge_pin.from_string( THEKERNEL->config->value(filament_detector_checksum, bulge_pin_checksum)->by_default("nc" )->as_string())->as_input();
+    string bulge= THEKERNEL->config->value(filament_detector_checksum, bulge_pin_checksum)->by_default("nc" )->as_string();
+    bulge_pin.from_string(bulge)->as_input();
     if(bulge_pin.connected()) {
-        // input pin polling
-        THEKERNEL->slow_ticker->attach( 100, this, &FilamentDetector::button_tick);
+        if(!PinChange::attach(bulge_pin, [this](bool on) { if(on) on_bulge(); })) {
+            // input pin polling
+            THEKERNEL->slow_ticker->attach( 100, this, &FilamentDetector::button_tick);
+        }
     }
 
     //Valid configurations contain an encoder pin, a bulge pin or both.
@@ -81,19 +87,23 @@ void FilamentDetector::on_module_loaded()
     }
 
 
-    // how many seconds between checks, must be long enough for several pulses to be detected, but not too long
-    seconds_per_check= THEKERNEL->config->value(filament_detector_checksum, seconds_per_check_checksum)->by_default(2)->as_number();
+    // how much filament is extruded between checks, must be long enough for several pulses to be detected, but not too long
+    check_mm= THEKERNEL->config->value(filament_detector_checksum, check_mm_checksum)->by_default(5)->as_number();
 
     // the number of pulses per mm of filament moving through the detector, can be fractional
     pulses_per_mm= THEKERNEL->config->value(filament_detector_checksum, pulses_per_mm_checksum)->by_default(1)->as_number();
 
+    // a jam is also fewer pulses than this fraction of what was extruded needs, 0 only alarms when there are no pulses
+    min_pulse_ratio= THEKERNEL->config->value(filament_detector_checksum, min_pulse_ratio_checksum)->by_default(0)->as_number();
+
     // register event-handlers
     if (this->encoder_pin != nullptr) {
         //This event is only valid if we are using the encodeer.
-        register_for_event(ON_SECOND_TICK);
+        register_for_event(ON_BLOCK_END);
     }
 
     register_for_event(ON_MAIN_LOOP);
+    set_event_rate(ON_MAIN_LOOP, 0, true); // only to report an alarm or check a finished block
     register_for_event(ON_CONSOLE_LINE_RECEIVED);
     this->register_for_event(ON_GCODE_RECEIVED);
 }
@@ -135,15 +145,17 @@ void FilamentDetector::on_gcode_received(void *argument)
 {
     Gcode *gcode = static_cast<Gcode *>(argument);
     if (gcode->has_m) {
-        if (gcode->m == 404) { // set filament detector parameters S seconds per check, P pulses per mm
-            if(gcode->has_letter('S')){
-                seconds_per_check= gcode->get_value('S');
-                seconds_passed= 0;
+        if (gcode->m == 404) { // set filament detector parameters D mm per check, P pulses per mm, R min pulse ratio
+            if(gcode->has_letter('D')){
+                check_mm= gcode->get_value('D');
             }
             if(gcode->has_letter('P')){
                 pulses_per_mm= gcode->get_value('P');
             }
-            gcode->stream->printf("// pulses per mm: %f, seconds per check: %d\n", pulses_per_mm, seconds_per_check);
+            if(gcode->has_letter('R')){
+                min_pulse_ratio= gcode->get_value('R');
+            }
+            gcode->stream->printf("// pulses per mm: %f, mm per check: %f, min pulse ratio: %f\n", pulses_per_mm, check_mm, min_pulse_ratio);
 
         } else if (gcode->m == 405) { // disable filament detector
             active= false;
@@ -170,6 +182,11 @@ void FilamentDetector::on_gcode_received(void *argument)
 
 void FilamentDetector::on_main_loop(void *argument)
 {
+    if (this->block_done) {
+        this->block_done= false;
+        check_encoder();
+    }
+
     if (active && this->filament_out_alarm) {
         this->filament_out_alarm = false;
         if(bulge_detected){
@@ -187,12 +204,12 @@ void FilamentDetector::on_main_loop(void *argument)
     }
 }
 
-void FilamentDetector::on_second_tick(void *argument)
+// called from the step interrupt, the check uses public data so it is done in the main loop
+void FilamentDetector::on_block_end(void *argument)
 {
-    if(++seconds_passed >= seconds_per_check) {
-        seconds_passed= 0;
-        check_encoder();
-    }
+    if(suspended || !active) return;
+    this->block_done= true;
+    wake_for_event(ON_MAIN_LOOP);
 }
 
 // encoder pin interrupt
@@ -206,33 +223,48 @@ void FilamentDetector::check_encoder()
     if(suspended) return; // already suspended
     if(!active) return;  // not enabled
 
-    uint32_t pulse_cnt= this->pulses.exchange(0); // atomic load and reset
-
     // get number of E steps taken and make sure we have seen enough pulses to cover that
     float e_moved= get_emove();
     if(isnan(e_last_moved)) {
+        this->pulses= 0;
         e_last_moved= e_moved;
         return;
     }
 
     float delta= e_moved - e_last_moved;
-    e_last_moved= e_moved;
     if(delta < 0) {
         // we ignore retracts for the purposes of jam detection
+        this->pulses= 0;
+        e_last_moved= e_moved;
         return;
     }
 
+    // wait until enough filament has been extruded for the pulse count to mean something
+    if(delta < check_mm) return;
+    e_last_moved= e_moved;
+    uint32_t pulse_cnt= this->pulses.exchange(0); // atomic load and reset
+
     // figure out how many pulses need to have happened to cover that e move
     uint32_t needed_pulses= floorf(delta*pulses_per_mm);
     // NOTE if needed_pulses is 0 then extruder did not move since last check, or not enough to register
     if(needed_pulses == 0) return;
 
-    if(pulse_cnt == 0) {
-        // we got no pulses and E moved since last time so fire off alarm
+    if(pulse_cnt == 0 || pulse_cnt < needed_pulses * min_pulse_ratio) {
+        // we got no pulses or too few for how far E moved since last time so fire off alarm
         this->filament_out_alarm= true;
+        wake_for_event(ON_MAIN_LOOP);
     }
 }
 
+// called in the bulge pin interrupt
+void FilamentDetector::on_bulge()
+{
+    if(suspended || !active) return;
+    this->filament_out_alarm= true;
+    this->bulge_detected= true;
+    wake_for_event(ON_MAIN_LOOP);
+}
+
 uint32_t FilamentDetector::button_tick(uint32_t dummy)
 {
     if(!bulge_pin.connected() || suspended || !active) return 0;
@@ -241,6 +273,7 @@ uint32_t FilamentDetector::button_tick(uint32_t dummy)
         // we got a trigger from the bulge detector
         this->filament_out_alarm= true;
         this->bulge_detected= true;
+        wake_for_event(ON_MAIN_LOOP);
     }
 
     return 0;
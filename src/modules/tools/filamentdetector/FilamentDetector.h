@@ -20,12 +20,13 @@ public:
     ~FilamentDetector();
     void on_module_loaded();
     void on_main_loop(void* argument);
-    void on_second_tick(void* argument);
+    void on_block_end(void* argument);
     void on_console_line_received( void *argument );
     void on_gcode_received(void *argument);
 
 private:
     void on_pin_rise();
+    void on_bulge();
     void check_encoder();
     void send_command(std::string msg, StreamOutput *stream);
     uint32_t button_tick(uint32_t dummy);
@@ -36,10 +37,11 @@ private:
     float e_last_moved{0};
     std::atomic_uint pulses{0};
     float pulses_per_mm{0};
-    uint8_t seconds_per_check{1};
-    uint8_t seconds_passed{0};
+    float check_mm{5};          // extruded mm between checks of the pulse count
+    float min_pulse_ratio{0};   // fewest pulses as a fraction of pulses_per_mm that is not a jam, 0 for any pulse at all
 
     struct {
+        volatile bool block_done:1;
         bool filament_out_alarm:1;
         bool bulge_detected:1;
         bool suspended:1;
@@ -16,11 +16,22 @@
 #include "Block.h"
 #include "checksumm.h"
 #include "ConfigValue.h"
+#include "Robot.h"
+#include "Conveyor.h"
+#include "StepTicker.h"
+#include "StepperMotor.h"
+#include "StreamOutput.h"
+#include "PublicDataRequest.h"
+#include "PublicData.h"
+#include "LaserPublicAccess.h"
 
 #include "libs/Pin.h"
 #include "Gcode.h"
 #include "PwmOut.h" // mbed.h lib
 
+#include <string>
+#include <math.h>
+
 #define laser_module_enable_checksum          	CHECKSUM("laser_module_enable")
 #define laser_module_pin_checksum          	    CHECKSUM("laser_module_pin")
 #define laser_module_pwm_pin_checksum          	CHECKSUM("laser_module_pwm_pin")
@@ -32,9 +43,25 @@
 #define laser_module_tickle_power_checksum      CHECKSUM("laser_module_tickle_power")
 #define laser_module_max_power_checksum         CHECKSUM("laser_module_max_power")
 #define laser_module_maximum_s_value_checksum   CHECKSUM("laser_module_maximum_s_value")
+#define laser_module_power_gamma_checksum       CHECKSUM("laser_module_power_gamma")
+
+// PwmOut only takes the duty cycle as a float, this gets at its channel so the laser can write the match register itself
+struct PwmOutAccess : mbed::PwmOut {
+    static pwmout_t mbed::PwmOut::*member() { return &PwmOutAccess::_pwm; }
+};
 
 
 Laser::Laser(){
+    raster_head= raster_tail= 0;
+    raster_open= false;
+    raster_armed= false;
+    raster_pixels= nullptr;
+    raster_count= 0;
+    raster_motor= nullptr;
+    raster_pixel= 0;
+    power_block= nullptr;
+    fx_power_per_rate= 0;
+    intensity= 0;
 }
 
 void Laser::on_module_loaded() {
@@ -82,7 +109,10 @@ void Laser::on_module_loaded() {
 
 
     this->pwm_pin->period_us(THEKERNEL->config->value(laser_module_pwm_period_checksum)->by_default(20)->as_number());
-    this->pwm_pin->write(this->pwm_inverting ? 1 : 0);
+    pwmout_t &pwm = this->pwm_pin->*PwmOutAccess::member();
+    this->pwm_mr = pwm.MR;
+    this->pwm_ler_bit = 1 << pwm.pwm;
+    this->write_pwm(0);
     this->laser_maximum_power = THEKERNEL->config->value(laser_module_maximum_power_checksum)->by_default(1.0f)->as_number() ;
 
     // These config variables are deprecated, they have been replaced with laser_module_default_power and laser_module_minimum_power
@@ -96,17 +126,26 @@ void Laser::on_module_loaded() {
     // S value that represents maximum (default 1)
     this->laser_maximum_s_value = THEKERNEL->config->value(laser_module_maximum_s_value_checksum)->by_default(1.0f)->as_number() ;
 
+    // power curve, the output is the requested power to this power (default 1 is linear)
+    this->build_power_table(THEKERNEL->config->value(laser_module_power_gamma_checksum)->by_default(1.0f)->as_number());
+
     //register for events
     this->register_for_event(ON_GCODE_EXECUTE);
     this->register_for_event(ON_SPEED_CHANGE);
     this->register_for_event(ON_BLOCK_BEGIN);
     this->register_for_event(ON_BLOCK_END);
     this->register_for_event(ON_HALT);
+    this->register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_event(ON_SET_PUBLIC_DATA);
+    PublicData::register_handler(this, laser_checksum);
+
+    THEKERNEL->step_ticker->register_step_hook([this]() { raster_step(); });
 }
 
 // Turn laser off laser at the end of a move
 void  Laser::on_block_end(void* argument){
-    this->pwm_pin->write(this->pwm_inverting ? 1 : 0);
+    THEKERNEL->step_ticker->set_step_hook_motor(nullptr);
+    this->write_pwm(0);
 
     if (this->ttl_used) {
     	Block* block = static_cast<Block*>(argument);
@@ -118,6 +157,27 @@ void  Laser::on_block_end(void* argument){
 
 // Set laser power at the beginning of a block
 void Laser::on_block_begin(void* argument){
+    if(this->laser_on && this->raster_pixels != nullptr) {
+        // find where this block starts in the raster line and how fast it goes through the pixels, a G1 may be split into
+        // several blocks, each a straight line along which the main axis steps evenly
+        Block *block = static_cast<Block*>(argument);
+        StepperMotor *main_motor = nullptr;
+        for (size_t i = 0; i < THEKERNEL->robot->actuators.size(); i++) {
+            if(block->steps[i] == block->steps_event_count) {
+                main_motor = THEKERNEL->robot->actuators[i];
+                break;
+            }
+        }
+
+        float pixels_per_mm = this->raster_count / this->raster_length;
+        this->raster_fx_start = this->raster_done * pixels_per_mm * 65536.0F;
+        this->raster_fx_step = block->millimeters / block->steps_event_count * pixels_per_mm * 65536.0F;
+        this->raster_done += block->millimeters;
+        this->raster_pixel = min(this->raster_fx_start >> 16, this->raster_count - 1);
+        this->raster_motor = main_motor;
+        THEKERNEL->step_ticker->set_step_hook_motor(main_motor);
+    }
+
     this->set_proportional_power();
 
 }
@@ -125,13 +185,38 @@ void Laser::on_block_begin(void* argument){
 // Turn laser on/off depending on received GCodes
 void Laser::on_gcode_execute(void* argument){
     Gcode* gcode = static_cast<Gcode*>(argument);
+    if( gcode->has_m && gcode->m == 650 ){
+        // the marker queued in front of the move that engraves the next raster line
+        this->raster_armed = true;
+        return;
+    }
+
     this->laser_on = false;
     if( gcode->has_g){
         int code = gcode->g;
+        if( code <= 3 ){
+            // the next move frees the raster line of the last one
+            if( this->raster_pixels != nullptr ){
+                this->raster_pixels = nullptr;
+                this->raster_tail = (this->raster_tail + 1) % raster_slots;
+            }
+            if( this->raster_armed ){
+                this->raster_armed = false;
+                std::vector<uint8_t> &line = this->raster_lines[this->raster_tail];
+                if( code != 0 && !line.empty() && gcode->millimeters_of_travel > 0.00001F ){
+                    this->raster_pixels = line.data();
+                    this->raster_count = line.size();
+                    this->raster_length = gcode->millimeters_of_travel;
+                    this->raster_done = 0;
+                }else{
+                    this->raster_tail = (this->raster_tail + 1) % raster_slots;
+                }
+            }
+        }
         if( code == 0 ){                    // G0
-            this->pwm_pin->write(this->pwm_inverting ? 1 - this->laser_minimum_power : this->laser_minimum_power);
+            this->write_pwm(this->power_table[0]);
             this->laser_on =  false;
-        }else if( code >= 1 && code <= 3 ){ // G1, G2, G3
+        }else if( (code >= 1 && code <= 3) || code == 5 ){ // G1, G2, G3, G5
             this->laser_on =  true;
         }
     }
@@ -157,20 +242,159 @@ void Laser::on_speed_change(void* argument){
     }
 }
 
+// adjust power to the actual velocity, the speed changes come before or after the block begin depending on the module order
+// so the factor is worked out the first time a block is seen
 void Laser::set_proportional_power(){
-    if( this->laser_on && THEKERNEL->stepper->get_current_block() ){
-        // adjust power to maximum power and actual velocity
-        float proportional_power = (((this->laser_maximum_power-this->laser_minimum_power)*(this->laser_power * THEKERNEL->stepper->get_trapezoid_adjusted_rate() / THEKERNEL->stepper->get_current_block()->nominal_rate))+this->laser_minimum_power);
-        this->pwm_pin->write(this->pwm_inverting ? 1 - proportional_power : proportional_power);
+    const Block *block = THEKERNEL->stepper->get_current_block();
+    if( this->laser_on && block ){
+        if( block != this->power_block ){
+            // intensity = power * rate / nominal_rate * 65536, with the rate in fixed point
+            this->power_block = block;
+            float k = block->nominal_rate > 0 ? this->laser_power * (65536.0F / (1 << Block::fx_rate_shift)) / block->nominal_rate : 0;
+            this->fx_power_per_rate = k * 4294967296.0F;
+        }
+        uint64_t x = ((uint64_t)THEKERNEL->stepper->get_fx_trapezoid_rate() * this->fx_power_per_rate) >> 32;
+        this->intensity = (x > 65536) ? 65536 : x;
+
+        if( this->raster_pixels != nullptr ){
+            // the step ISR sets the pixels, this only follows the velocity
+            this->write_raster_pixel();
+        }else{
+            this->write_intensity(this->intensity);
+        }
     }
 }
 
+// the power curve from minimum to maximum power in match register counts, with the PWM period as set at load
+void Laser::build_power_table(float gamma)
+{
+    float period = LPC_PWM1->MR0;
+    if(gamma <= 0) gamma = 1;
+    for (int i = 0; i <= power_steps; i++) {
+        float p = this->laser_minimum_power + (this->laser_maximum_power - this->laser_minimum_power) * powf((float)i / power_steps, gamma);
+        this->power_table[i] = confine(p, 0.0F, 1.0F) * period;
+    }
+}
+
+// intensity is 0 to 65536, interpolate the power curve
+void Laser::write_intensity(uint32_t x)
+{
+    uint32_t i = x >> 11, f = x & 2047;
+    if(i >= power_steps) {
+        write_pwm(this->power_table[power_steps]);
+        return;
+    }
+    int32_t a = this->power_table[i], b = this->power_table[i + 1];
+    write_pwm(a + (((b - a) * (int32_t)f) >> 11));
+}
+
+// the match register is shadowed, the new value is latched at the start of the next period so a period is never cut short
+void Laser::write_pwm(uint32_t match)
+{
+    uint32_t period = LPC_PWM1->MR0;
+    if(this->pwm_inverting) match = (match < period) ? period - match : 0;
+    // as PwmOut does, never equal to MR0 else there is a one cycle dropout
+    if(match >= period) match = period + 1;
+    *this->pwm_mr = match;
+    LPC_PWM1->LER |= this->pwm_ler_bit;
+}
+
 void Laser::on_halt(void *argument)
 {
     if(argument == nullptr) {
     	// Safety check - turn laser off on halt
     	this->laser_on = false;
+        THEKERNEL->step_ticker->set_step_hook_motor(nullptr);
+        this->write_pwm(0);
+        this->raster_pixels = nullptr;
+        this->raster_armed = false;
+        this->raster_open = false;
+        this->raster_head = this->raster_tail = 0;
     	if (this->ttl_used)
     	        this->ttl_pin->set(this->laser_on);
     }
 }
+
+// the first G0-G3 after M650 is the move that engraves the raster line
+void Laser::on_gcode_received(void *argument)
+{
+    Gcode *gcode = static_cast<Gcode *>(argument);
+    if(this->raster_open && gcode->has_g && gcode->g <= 3) {
+        this->raster_head = (this->raster_head + 1) % raster_slots;
+        this->raster_open = false;
+        // queue the move now so later moves are not merged into it
+        THEKERNEL->robot->flush_pending_move();
+    }
+}
+
+void Laser::on_set_public_data(void *argument)
+{
+    PublicDataRequest *pdr = static_cast<PublicDataRequest *>(argument);
+
+    if(!pdr->starts_with(laser_checksum) || !pdr->second_element_is(raster_data_checksum)) return;
+
+    std::string *data = static_cast<std::string *>(pdr->get_data_ptr());
+    if(add_raster_data(data->c_str())) pdr->set_taken();
+}
+
+static int base64_value(char c)
+{
+    if(c >= 'A' && c <= 'Z') return c - 'A';
+    if(c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if(c >= '0' && c <= '9') return c - '0' + 52;
+    if(c == '+') return 62;
+    if(c == '/') return 63;
+    return -1;
+}
+
+// M650 <base64> adds a byte per pixel to the raster line for the next move, 0 is off and 255 is full power.
+// A long line can be sent with several M650, each is decoded on its own so should be a multiple of 4 characters
+bool Laser::add_raster_data(const char *data)
+{
+    if(!this->raster_open) {
+        // wait for a free line, they are freed as the moves are executed
+        while(((this->raster_head + 1) % raster_slots) == this->raster_tail) {
+            THEKERNEL->conveyor->ensure_running();
+            THEKERNEL->call_event(ON_IDLE, this);
+            if(THEKERNEL->is_halted()) return false;
+        }
+
+        // a held back move would otherwise get the marker and the raster line of the move after it
+        THEKERNEL->robot->flush_pending_move();
+        this->raster_lines[this->raster_head].clear();
+        Gcode marker("M650", &(StreamOutput::NullStream));
+        THEKERNEL->conveyor->append_gcode(&marker);
+        this->raster_open = true;
+    }
+
+    std::vector<uint8_t> &line = this->raster_lines[this->raster_head];
+    uint32_t acc = 0;
+    int bits = 0;
+    for (const char *p = data; *p && *p != '='; p++) {
+        if(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') continue;
+        int v = base64_value(*p);
+        if(v < 0 || line.size() >= max_raster_pixels) return false;
+        acc = ((acc << 6) | v) & 0xFFFF;
+        bits += 6;
+        if(bits >= 8) {
+            bits -= 8;
+            line.push_back(acc >> bits);
+        }
+    }
+    return true;
+}
+
+// called from the step ISR each time the main axis of a raster block steps
+void Laser::raster_step()
+{
+    if(this->raster_pixels == nullptr) return;
+    uint32_t px = (this->raster_fx_start + this->raster_motor->get_stepped() * this->raster_fx_step) >> 16;
+    if(px == this->raster_pixel || px >= this->raster_count) return;
+    this->raster_pixel = px;
+    this->write_raster_pixel();
+}
+
+void Laser::write_raster_pixel()
+{
+    this->write_intensity(this->intensity * this->raster_pixels[this->raster_pixel] / 255);
+}
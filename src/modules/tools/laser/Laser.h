@@ -10,10 +10,15 @@
 
 #include "libs/Module.h"
 
+#include <stdint.h>
+#include <vector>
+
 namespace mbed {
     class PwmOut;
 }
 class Pin;
+class StepperMotor;
+class Block;
 
 class Laser : public Module{
     public:
@@ -25,9 +30,17 @@ class Laser : public Module{
         void on_gcode_execute(void* argument);
         void on_speed_change(void* argument);
         void on_halt(void* argument);
+        void on_gcode_received(void* argument);
+        void on_set_public_data(void* argument);
 
     private:
         void set_proportional_power();
+        void build_power_table(float gamma);
+        void write_intensity(uint32_t x);
+        void write_pwm(uint32_t match);
+        bool add_raster_data(const char *data);
+        void raster_step();
+        void write_raster_pixel();
         mbed::PwmOut *pwm_pin;    // PWM output to regulate the laser power
         Pin *ttl_pin;				// TTL output to fire laser
         struct {
@@ -40,6 +53,36 @@ class Laser : public Module{
         float            laser_minimum_power; // value used to tickle the laser on moves.  Also minimum value for auto-scaling
         float            laser_power;     // current laser power
         float            laser_maximum_s_value; // Value of S code that will represent max power
+
+        // the power is worked out in fixed point, an intensity of 65536 is full power, and written straight to the match
+        // register of the PWM channel which latches it at the start of the next period
+        static const uint8_t power_steps= 32;
+        uint32_t         power_table[power_steps + 1]; // match register values along the power curve from minimum to maximum power
+        volatile uint32_t *pwm_mr;
+        uint32_t         pwm_ler_bit;
+        const Block     *power_block;       // block fx_power_per_rate was worked out for
+        uint64_t         fx_power_per_rate; // intensity per fixed point step rate, 32 fractional bits
+        volatile uint32_t intensity;        // at the current speed, before the raster pixel
+
+        // Raster lines sent with M650, each is engraved by the G1 that follows it, spread evenly along its length.
+        // The main loop fills raster_head, the blocks being executed use raster_tail, it is only freed by the move after it
+        static const uint8_t raster_slots= 8;
+        static const uint16_t max_raster_pixels= 4096;
+        std::vector<uint8_t> raster_lines[raster_slots];
+        volatile uint8_t raster_head;
+        volatile uint8_t raster_tail;
+        bool raster_open;                   // raster_head is being filled, the next G0-G3 closes it
+
+        // the raster line of the move being executed, the pixel is worked out from the steps of the main axis in the step ISR
+        const uint8_t   *raster_pixels;     // nullptr when not rastering
+        uint32_t         raster_count;
+        float            raster_length;     // mm the pixels are spread along
+        float            raster_done;       // mm of the move done by the blocks that have already been executed
+        StepperMotor    *raster_motor;      // main axis of the current block
+        uint32_t         raster_fx_start;   // pixel position at the start of the block, 16.16 fixed point
+        uint32_t         raster_fx_step;    // pixels per step of the main axis, 16.16 fixed point
+        volatile uint32_t raster_pixel;
+        bool             raster_armed;      // the M650 marker of the next move was executed
 };
 
 #endif
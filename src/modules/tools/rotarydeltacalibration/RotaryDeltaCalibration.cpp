@@ -10,9 +10,19 @@
 #include "PublicData.h"
 #include "Gcode.h"
 #include "StepperMotor.h"
+#include "BaseSolution.h"
+#include "SerialMessage.h"
+#include "Conveyor.h"
+
+#include <algorithm>
+#include <math.h>
 
 #define rotarydelta_checksum CHECKSUM("rotary_delta_calibration")
 #define enable_checksum CHECKSUM("enable")
+#define probe_radius_checksum CHECKSUM("probe_radius")
+#define probe_z_checksum CHECKSUM("probe_z")
+#define probe_depth_checksum CHECKSUM("probe_depth")
+#define feedrate_checksum CHECKSUM("feedrate")
 
 void RotaryDeltaCalibration::on_module_loaded()
 {
@@ -23,6 +33,13 @@ void RotaryDeltaCalibration::on_module_loaded()
         return;
     }
 
+    // where M306.1 probes the bed, the points are on a circle of probe_radius and one of half that, each probed from
+    // probe_z down by as much as probe_depth
+    probe_radius = THEKERNEL->config->value( rotarydelta_checksum, probe_radius_checksum )->by_default(50.0F)->as_number();
+    probe_z = THEKERNEL->config->value( rotarydelta_checksum, probe_z_checksum )->by_default(20.0F)->as_number();
+    probe_depth = THEKERNEL->config->value( rotarydelta_checksum, probe_depth_checksum )->by_default(30.0F)->as_number();
+    feedrate = THEKERNEL->config->value( rotarydelta_checksum, feedrate_checksum )->by_default(50.0F)->as_number(); // mm/sec
+
     // register event-handlers
     register_for_event(ON_GCODE_RECEIVED);
 }
@@ -34,6 +51,146 @@ float *RotaryDeltaCalibration::get_homing_offset()
     return ok ? theta_offset : nullptr;
 }
 
+void RotaryDeltaCalibration::move_to(float x, float y, float z)
+{
+    char cmd[64];
+    snprintf(cmd, sizeof(cmd), "G53 G0 X%1.3f Y%1.3f Z%1.3f F%1.1f", x, y, z, feedrate * 60);
+
+    struct SerialMessage message;
+    message.message = cmd;
+    message.stream = &(StreamOutput::NullStream);
+    THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
+    THEKERNEL->conveyor->wait_for_empty_queue();
+}
+
+// probes down with G38.3 from probe_z above x, y, pos is where the effector touched
+bool RotaryDeltaCalibration::probe_bed_at(float x, float y, float pos[3])
+{
+    move_to(x, y, probe_z);
+
+    char cmd[32];
+    snprintf(cmd, sizeof(cmd), "G38.3 Z%1.3f", -probe_depth);
+    THEKERNEL->robot->set_last_probe_position(std::make_tuple(NAN, NAN, NAN, 0));
+    Gcode gc(cmd, &(StreamOutput::NullStream));
+    THEKERNEL->call_event(ON_GCODE_RECEIVED, &gc);
+
+    uint8_t ok;
+    std::tie(pos[0], pos[1], pos[2], ok) = THEKERNEL->robot->get_last_probe_position();
+    move_to(x, y, probe_z);
+    return ok != 0;
+}
+
+// M306.1 probes the bed, which has to be flat, at 13 points and fits the theta offsets that bring them all to one
+// height by least squares, using the actuator columns of the arm solution's geometry jacobian at each of them, then
+// homes and does it again until the spread is within the target
+bool RotaryDeltaCalibration::calibrate_offsets(Gcode *gcode)
+{
+    float *theta_offset= get_homing_offset(); // points to theta offset in Endstop module
+    if (theta_offset == nullptr) {
+        gcode->stream->printf("error:no endstop module found\n");
+        return false;
+    }
+
+    float target = gcode->has_letter('I') ? gcode->get_value('I') : 0.03F;
+    float radius = gcode->has_letter('J') ? gcode->get_value('J') : probe_radius;
+    int passes = gcode->has_letter('P') ? gcode->get_value('P') : 3;
+    if(passes < 1) passes = 1;
+
+    const int n = 13;
+    float pp[n][2], pos[n][3];
+    pp[0][0]= pp[0][1]= 0;
+    for (int i = 0; i < 6; i++) {
+        float a = i * (3.14159265359F / 3.0F);
+        pp[1 + i][0]= radius * cosf(a);
+        pp[1 + i][1]= radius * sinf(a);
+        pp[7 + i][0]= radius * 0.5F * cosf(a + 3.14159265359F / 6.0F);
+        pp[7 + i][1]= radius * 0.5F * sinf(a + 3.14159265359F / 6.0F);
+    }
+    gcode->stream->printf("Calibrating theta offsets: target %fmm, radius %fmm\n", target, radius);
+
+    BaseSolution *arm= THEKERNEL->robot->arm_solution;
+    for (int pass = 1; pass <= passes; ++pass) {
+        Gcode gc("G28", &(StreamOutput::NullStream));
+        THEKERNEL->call_event(ON_GCODE_RECEIVED, &gc);
+
+        for (int i = 0; i < n; i++) {
+            if(!probe_bed_at(pp[i][0], pp[i][1], pos[i])) {
+                gcode->stream->printf("error:probe did not trigger at point %d\n", i);
+                return false;
+            }
+            gcode->stream->printf("P%d-%d X:%1.3f Y:%1.3f Z:%1.4f\n", i, pass, pos[i][0], pos[i][1], pos[i][2]);
+        }
+        float lo = pos[0][2], hi = pos[0][2];
+        for (int i = 1; i < n; i++) {
+            lo = std::min(lo, pos[i][2]);
+            hi = std::max(hi, pos[i][2]);
+        }
+        gcode->stream->printf("pass %d: spread %1.4f\n", pass, hi - lo);
+        THEKERNEL->call_event(ON_IDLE);
+        if(hi - lo <= target) {
+            gcode->stream->printf("Theta Offset: A %8.5f B %8.5f C %8.5f, save with M500\n", theta_offset[0], theta_offset[1], theta_offset[2]);
+            return true;
+        }
+        if(pass == passes) break;
+
+        // the angles at every point in one batch
+        ActuatorCoordinates a[n];
+        arm->cartesian_to_actuator_batch(pos, a, n);
+
+        // the unknowns are the error of each angle and the height of the bed, a point touched above it is to go down
+        // by as much. An error in all three angles mostly moves the effector up and down, much as the bed height
+        // does, so a little damping keeps that share of them small where the points can hardly tell them apart
+        float ata[4][5];
+        for (int r = 0; r < 4; r++) {
+            for (int c = 0; c < 5; c++) ata[r][c]= 0;
+        }
+        float jacobian[3][BaseSolution::GP_COUNT];
+        for (int i = 0; i < n; i++) {
+            if(!arm->get_geometry_jacobian(a[i], pos[i], jacobian)) {
+                gcode->stream->printf("error:the arm solution has no geometry jacobian at point %d\n", i);
+                return false;
+            }
+            float row[4]{jacobian[2][BaseSolution::GP_ACTUATOR_1], jacobian[2][BaseSolution::GP_ACTUATOR_2], jacobian[2][BaseSolution::GP_ACTUATOR_3], -1};
+            for (int r = 0; r < 4; r++) {
+                for (int c = 0; c < 4; c++) ata[r][c] += row[r] * row[c];
+                ata[r][4] -= row[r] * pos[i][2];
+            }
+        }
+        float damping = 1e-4F * (ata[0][0] + ata[1][1] + ata[2][2]);
+        for (int r = 0; r < 3; r++) ata[r][r] += damping;
+
+        // gaussian elimination with partial pivoting
+        for (int c = 0; c < 4; c++) {
+            int p= c;
+            for (int r = c + 1; r < 4; r++) {
+                if(fabsf(ata[r][c]) > fabsf(ata[p][c])) p= r;
+            }
+            if(fabsf(ata[p][c]) < 1e-9F) {
+                gcode->stream->printf("error:the probed points do not give a solution\n");
+                return false;
+            }
+            for (int k = 0; k < 5; k++) std::swap(ata[c][k], ata[p][k]);
+            for (int r = c + 1; r < 4; r++) {
+                float f= ata[r][c] / ata[c][c];
+                for (int k = c; k < 5; k++) ata[r][k] -= f * ata[c][k];
+            }
+        }
+        float x[4];
+        for (int r = 3; r >= 0; r--) {
+            float s= ata[r][4];
+            for (int k = r + 1; k < 4; k++) s -= ata[r][k] * x[k];
+            x[r]= s / ata[r][r];
+        }
+
+        // the angles were short of the real ones by the errors, which the offsets make up at the next home
+        for (int k = 0; k < 3; k++) theta_offset[k] += x[k];
+        gcode->stream->printf("Theta Offset: A %8.5f B %8.5f C %8.5f\n", theta_offset[0], theta_offset[1], theta_offset[2]);
+    }
+
+    gcode->stream->printf("Did not get to the target in %d passes, the last offsets are kept\n", passes);
+    return false;
+}
+
 void RotaryDeltaCalibration::on_gcode_received(void *argument)
 {
     Gcode *gcode = static_cast<Gcode *>(argument);
@@ -58,6 +215,11 @@ void RotaryDeltaCalibration::on_gcode_received(void *argument)
             }
 
             case 306: {
+                if(gcode->subcode == 1) {
+                    calibrate_offsets(gcode);
+                    break;
+                }
+
                 // for a rotary delta M306 calibrates the homing angle
                 // by doing M306 A-56.17 it will calculate the M206 A value (the theta offset for actuator A) based on the difference
                 // between what it thinks is the current angle and what the current angle actually is specified by A (ditto for B and C)
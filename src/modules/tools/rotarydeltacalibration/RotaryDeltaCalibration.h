@@ -15,4 +15,12 @@ public:
 private:
     void on_gcode_received(void *argument);
     float *get_homing_offset();
+    bool calibrate_offsets(Gcode *gcode);
+    bool probe_bed_at(float x, float y, float pos[3]);
+    void move_to(float x, float y, float z);
+
+    float probe_radius;
+    float probe_z;
+    float probe_depth;
+    float feedrate;
 };
@@ -21,13 +21,20 @@
 #include "SerialMessage.h"
 #include "EndstopsPublicAccess.h"
 #include "PublicData.h"
+#include "utils.h"
 #include <algorithm>
 #include <map>
+#include <math.h>
 
 #define scaracal_checksum CHECKSUM("scaracal")
 #define enable_checksum CHECKSUM("enable")
 #define slow_feedrate_checksum CHECKSUM("slow_feedrate")
 #define z_move_checksum CHECKSUM("z_move")
+#define probe_points_checksum CHECKSUM("probe_points")
+#define probe_radius_checksum CHECKSUM("probe_radius")
+#define probe_clearance_checksum CHECKSUM("probe_clearance")
+#define probe_z_checksum CHECKSUM("probe_z")
+#define safe_z_checksum CHECKSUM("safe_z")
 
 #define X_AXIS 0
 #define Y_AXIS 1
@@ -58,6 +65,13 @@ void SCARAcal::on_config_reload(void *argument)
                                                                                                   // positive values increase distance between nozzle and bed.
                                                                                                   // negative will decrease.  Useful when level code active to prevent collision
 
+    // the pins M367 probes around, as x1,y1,x2,y2... and how far from a center the probe touches one
+    this->probe_points = parse_number_list(THEKERNEL->config->value( scaracal_checksum, probe_points_checksum )->by_default("")->as_string().c_str());
+    if(this->probe_points.size() % 2 != 0) this->probe_points.pop_back();
+    this->probe_radius = THEKERNEL->config->value( scaracal_checksum, probe_radius_checksum )->by_default(3.0F)->as_number();
+    this->probe_clearance = THEKERNEL->config->value( scaracal_checksum, probe_clearance_checksum )->by_default(5.0F)->as_number();
+    this->probe_z = THEKERNEL->config->value( scaracal_checksum, probe_z_checksum )->by_default(5.0F)->as_number();      // probes at this height
+    this->safe_z = THEKERNEL->config->value( scaracal_checksum, safe_z_checksum )->by_default(20.0F)->as_number();       // and moves between pins at this one
 }
 
 
@@ -182,6 +196,194 @@ void SCARAcal::SCARA_ang_move(float theta, float psi, float z, float feedrate)
     THEKERNEL->robot->on_gcode_received(&gc); // send to robot directly
 }
 
+void SCARAcal::move_to(float x, float y, float z, float feedrate)
+{
+    char cmd[64];
+    snprintf(cmd, sizeof(cmd), "G53 G0 X%1.3f Y%1.3f Z%1.3f F%1.1f", x, y, z, feedrate * 60); // feedrate is mm/sec
+
+    // send as a command line like the probe does, and wait for it to get there
+    struct SerialMessage message;
+    message.message = cmd;
+    message.stream = &(StreamOutput::NullStream);
+    THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
+    THEKERNEL->conveyor->wait_for_empty_queue();
+}
+
+// G38.3 along X or Y, pos is where it touched
+bool SCARAcal::probe_toward(int axis, float distance, float pos[3])
+{
+    char cmd[32];
+    snprintf(cmd, sizeof(cmd), "G38.3 %c%1.3f", axis == X_AXIS ? 'X' : 'Y', distance);
+    THEKERNEL->robot->set_last_probe_position(std::make_tuple(NAN, NAN, NAN, 0));
+    Gcode gc(cmd, &(StreamOutput::NullStream));
+    THEKERNEL->call_event(ON_GCODE_RECEIVED, &gc);
+
+    uint8_t ok;
+    std::tie(pos[X_AXIS], pos[Y_AXIS], pos[Z_AXIS], ok) = THEKERNEL->robot->get_last_probe_position();
+    return ok != 0;
+}
+
+// M367 touches each pin of scaracal.probe_points from four sides, then fits the trims of the two arms and the radius
+// the probe touches the pins at, and with L1 the lengths of the arms too, that put every point the probe touched
+// that radius from its pin, by least squares over all of them with the arm solution's geometry jacobian. It homes and
+// probes again until the points are within the target of the circles.
+bool SCARAcal::calibrate_from_pins(Gcode *gcode)
+{
+    // four touches a pin, that many kept on the stack
+    const int max_pins = 8;
+    const int pins = std::min<int>(this->probe_points.size() / 2, max_pins);
+    bool lengths = gcode->has_letter('L') && gcode->get_value('L') != 0;
+    float target = gcode->has_letter('I') ? gcode->get_value('I') : 0.02F;
+    int passes = gcode->has_letter('P') ? gcode->get_value('P') : 2;
+    if(passes < 1) passes = 1;
+    // the trims and the radius from one pin, the lengths too need two
+    if(pins < (lengths ? 2 : 1)) {
+        gcode->stream->printf("error:scaracal.probe_points needs at least %d pins\n", lengths ? 2 : 1);
+        return false;
+    }
+
+    BaseSolution *arm = THEKERNEL->robot->arm_solution;
+    BaseSolution::arm_options_t options;
+    arm->get_optional(options);
+    if(options.find('T') == options.end() || options.find('P') == options.end()) {
+        gcode->stream->printf("error:this appears to not be a SCARA arm solution\n");
+        return false;
+    }
+    float arm1 = options['T'], arm2 = options['P'];
+    float radius = this->probe_radius;
+
+    const int n = pins * 4;
+    float pos[max_pins * 4][3];
+    const float dirs[4][2] {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    for (int pass = 1; pass <= passes; ++pass) {
+        float S_trim[3];
+        if(!this->get_trim(S_trim[0], S_trim[1], S_trim[2])) {
+            gcode->stream->printf("error:unable to get trim, is endstops enabled?\n");
+            return false;
+        }
+        this->home();
+        float home_pos[3];
+        THEKERNEL->robot->get_axis_position(home_pos);
+
+        for (int p = 0; p < pins; p++) {
+            float cx = this->probe_points[2 * p], cy = this->probe_points[2 * p + 1];
+            for (int d = 0; d < 4; d++) {
+                // from clear of the pin on this side to its center, the probe moves the arms straight from one angle to
+                // the other so a longer move would bow out more
+                float sx = cx + dirs[d][0] * (this->probe_radius + this->probe_clearance);
+                float sy = cy + dirs[d][1] * (this->probe_radius + this->probe_clearance);
+                move_to(sx, sy, this->safe_z, slow_rate * 3.0F);
+                move_to(sx, sy, this->probe_z, slow_rate);
+                float *at = pos[4 * p + d];
+                bool ok = probe_toward(dirs[d][0] != 0 ? X_AXIS : Y_AXIS, -(dirs[d][0] + dirs[d][1]) * (this->probe_radius + this->probe_clearance), at);
+                move_to(sx, sy, this->probe_z, slow_rate);
+                move_to(sx, sy, this->safe_z, slow_rate * 3.0F);
+                if(!ok) {
+                    gcode->stream->printf("error:probe did not touch pin %d from side %d\n", p, d);
+                    return false;
+                }
+            }
+        }
+
+        // each touch is radius from its pin, the unknowns the pins can tell are the trims of the two arms, the
+        // lengths of the arms with L1, and how much the radius is off
+        const int m = lengths ? 5 : 3;
+        ActuatorCoordinates a[max_pins * 4];
+        arm->cartesian_to_actuator_batch(pos, a, n);
+        float ata[5][6];
+        for (int r = 0; r < m; r++) {
+            for (int c = 0; c <= m; c++) ata[r][c]= 0;
+        }
+        float jacobian[3][BaseSolution::GP_COUNT];
+        float sumsq = 0;
+        for (int i = 0; i < n; i++) {
+            float cx = this->probe_points[2 * (i / 4)], cy = this->probe_points[2 * (i / 4) + 1];
+            float gx = pos[i][X_AXIS] - cx, gy = pos[i][Y_AXIS] - cy;
+            float dist = sqrtf(gx * gx + gy * gy);
+            gx /= dist;
+            gy /= dist;
+            gcode->stream->printf("P%d-%d X:%1.3f Y:%1.3f R:%1.4f\n", i, pass, pos[i][X_AXIS], pos[i][Y_AXIS], dist);
+            if(!arm->get_geometry_jacobian(a[i], pos[i], jacobian)) {
+                gcode->stream->printf("error:the arm solution has no geometry jacobian at point %d\n", i);
+                return false;
+            }
+
+            float row[5];
+            const int cols[4] {BaseSolution::GP_ACTUATOR_1, BaseSolution::GP_ACTUATOR_2, BaseSolution::GP_ARM_LENGTH, BaseSolution::GP_ARM_LENGTH_2};
+            for (int k = 0; k < m - 1; k++) row[k]= gx * jacobian[X_AXIS][cols[k]] + gy * jacobian[Y_AXIS][cols[k]];
+            row[m - 1]= -1;
+            float rhs = radius - dist;
+            sumsq += rhs * rhs;
+            for (int r = 0; r < m; r++) {
+                for (int c = 0; c < m; c++) ata[r][c] += row[r] * row[c];
+                ata[r][m] += row[r] * rhs;
+            }
+        }
+        float rms = sqrtf(sumsq / n);
+        gcode->stream->printf("pass %d: rms %1.4f\n", pass, rms);
+        THEKERNEL->call_event(ON_IDLE);
+        if(rms <= target) {
+            gcode->stream->printf("Calibrated, save with M500\n");
+            return true;
+        }
+        if(pass == passes) break;
+
+        // gaussian elimination with partial pivoting
+        for (int c = 0; c < m; c++) {
+            int p = c;
+            for (int r = c + 1; r < m; r++) {
+                if(fabsf(ata[r][c]) > fabsf(ata[p][c])) p = r;
+            }
+            if(fabsf(ata[p][c]) < 1e-9F) {
+                gcode->stream->printf("error:the pins do not give a solution, try more of them\n");
+                return false;
+            }
+            for (int k = 0; k <= m; k++) std::swap(ata[c][k], ata[p][k]);
+            for (int r = c + 1; r < m; r++) {
+                float f = ata[r][c] / ata[c][c];
+                for (int k = c; k <= m; k++) ata[r][k] -= f * ata[c][k];
+            }
+        }
+        float x[5];
+        for (int r = m - 1; r >= 0; r--) {
+            float s = ata[r][m];
+            for (int k = r + 1; k < m; k++) s -= ata[r][k] * x[k];
+            x[r] = s / ata[r][r];
+        }
+
+        // the angles were short of the real ones by x, homing takes the trim off them
+        float shift[2] {0, 0};
+        if(lengths) {
+            // homing works the angles out from where it homes to, so with other lengths they come out different and
+            // the trims make up for that too
+            ActuatorCoordinates before, after;
+            float homed_to[3];
+            arm->cartesian_to_actuator(home_pos, before);
+            before[X_AXIS] += S_trim[X_AXIS];
+            before[Y_AXIS] += S_trim[Y_AXIS];
+            arm->actuator_to_cartesian(before, homed_to);
+
+            arm1 += x[2];
+            arm2 += x[3];
+            options.clear();
+            options['T'] = arm1;
+            options['P'] = arm2;
+            arm->set_optional(options);
+            gcode->stream->printf("arm lengths set to T:%1.4f P:%1.4f\n", arm1, arm2);
+
+            arm->cartesian_to_actuator(homed_to, after);
+            shift[X_AXIS] = after[X_AXIS] - before[X_AXIS];
+            shift[Y_AXIS] = after[Y_AXIS] - before[Y_AXIS];
+        }
+        this->set_trim(S_trim[X_AXIS] - x[0] + shift[X_AXIS], S_trim[Y_AXIS] - x[1] + shift[Y_AXIS], S_trim[Z_AXIS], gcode->stream);
+        radius += x[m - 1];
+        gcode->stream->printf("probe touches the pins at %1.4f\n", radius);
+    }
+
+    gcode->stream->printf("Did not get to the target in %d passes, the last settings are kept\n", passes);
+    return false;
+}
+
 //A GCode has been received
 //See if the current Gcode line has some orders for us
 void SCARAcal::on_gcode_received(void *argument)
@@ -286,6 +488,10 @@ void SCARAcal::on_gcode_received(void *argument)
                 this->translate_trim(gcode->stream);
                 break;
 
+            case 367:                                       // Calibrate the trims, and with L1 the arm lengths, from the pins
+                this->calibrate_from_pins(gcode);
+                break;
+
         }
     }
 }
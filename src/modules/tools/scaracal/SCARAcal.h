@@ -11,6 +11,8 @@
 #include "Module.h"
 #include "Pin.h"
 
+#include <vector>
+
 class StepperMotor;
 class Gcode;
 class StreamOutput;
@@ -37,8 +39,17 @@ private:
 
     void SCARA_ang_move(float theta, float psi, float z, float feedrate);
 
+    void move_to(float x, float y, float z, float feedrate);
+    bool probe_toward(int axis, float distance, float pos[3]);
+    bool calibrate_from_pins(Gcode *gcode);
+
     float slow_rate;
     float z_move;
+    std::vector<float> probe_points;    // x, y of the centers of the pins M367 probes, the first 8 are used
+    float probe_radius;                 // of a pin plus that of the probe tip
+    float probe_clearance;
+    float probe_z;
+    float safe_z;
 
     struct {
         bool           is_scara:1;
@@ -16,6 +16,7 @@
 #include "StreamOutputPool.h"
 #include "SlowTicker.h"
 #include "Conveyor.h"
+#include "ModbusRTU.h"
 #include "system_LPC17xx.h"
 
 #include "libs/Pin.h"
@@ -24,7 +25,10 @@
 #include "port_api.h"
 #include "us_ticker_api.h"
 
+#include <math.h>
+
 #define spindle_enable_checksum          CHECKSUM("spindle_enable")
+#define spindle_type_checksum            CHECKSUM("spindle_type")
 #define spindle_pwm_pin_checksum         CHECKSUM("spindle_pwm_pin")
 #define spindle_pwm_period_checksum      CHECKSUM("spindle_pwm_period")
 #define spindle_feedback_pin_checksum    CHECKSUM("spindle_feedback_pin")
@@ -34,11 +38,39 @@
 #define spindle_control_I_checksum       CHECKSUM("spindle_control_I")
 #define spindle_control_D_checksum       CHECKSUM("spindle_control_D")
 #define spindle_control_smoothing_checksum CHECKSUM("spindle_control_smoothing")
+#define spindle_vfd_tx_pin_checksum      CHECKSUM("spindle_vfd_tx_pin")
+#define spindle_vfd_rx_pin_checksum      CHECKSUM("spindle_vfd_rx_pin")
+#define spindle_vfd_dir_pin_checksum     CHECKSUM("spindle_vfd_dir_pin")
+#define spindle_vfd_baud_rate_checksum   CHECKSUM("spindle_vfd_baud_rate")
+#define spindle_vfd_address_checksum     CHECKSUM("spindle_vfd_address")
+#define spindle_vfd_reply_timeout_checksum CHECKSUM("spindle_vfd_reply_timeout_ms")
+#define spindle_vfd_control_register_checksum CHECKSUM("spindle_vfd_control_register")
+#define spindle_vfd_run_value_checksum   CHECKSUM("spindle_vfd_run_value")
+#define spindle_vfd_stop_value_checksum  CHECKSUM("spindle_vfd_stop_value")
+#define spindle_vfd_speed_register_checksum CHECKSUM("spindle_vfd_speed_register")
+#define spindle_vfd_units_per_rpm_checksum CHECKSUM("spindle_vfd_units_per_rpm")
+#define spindle_vfd_feedback_register_checksum CHECKSUM("spindle_vfd_feedback_register")
+#define spindle_vfd_poll_checksum        CHECKSUM("spindle_vfd_poll_ms")
+#define spindle_vfd_tolerance_checksum   CHECKSUM("spindle_vfd_at_speed_tolerance")
+#define spindle_vfd_at_speed_timeout_checksum CHECKSUM("spindle_vfd_at_speed_timeout")
 
 #define UPDATE_FREQ 1000
 
+Spindle *Spindle::instance = nullptr;
+
 Spindle::Spindle()
 {
+    capture_channel = -1;
+    capture_first = capture_last = capture_periods = 0;
+    capture_started = false;
+    capture_period = 0;
+    vfd = nullptr;
+}
+
+extern "C" void TIMER3_IRQHandler(void)
+{
+    if (Spindle::instance != nullptr)
+        Spindle::instance->on_capture();
 }
 
 void Spindle::on_module_loaded()
@@ -63,6 +95,13 @@ void Spindle::on_module_loaded()
     control_I_term = THEKERNEL->config->value(spindle_control_I_checksum)->by_default(0.0001f)->as_number();
     control_D_term = THEKERNEL->config->value(spindle_control_D_checksum)->by_default(0.0001f)->as_number();
 
+    if (THEKERNEL->config->value(spindle_type_checksum)->by_default("pwm")->as_string() == "modbus")
+    {
+        if (!load_vfd())
+            delete this;
+        return;
+    }
+
     // Smoothing value is low pass filter time constant in seconds.
     float smoothing_time = THEKERNEL->config->value(spindle_control_smoothing_checksum)->by_default(0.1f)->as_number();
     if (smoothing_time * UPDATE_FREQ < 1.0f)
@@ -95,7 +134,11 @@ void Spindle::on_module_loaded()
         Pin *smoothie_pin = new Pin();
         smoothie_pin->from_string(THEKERNEL->config->value(spindle_feedback_pin_checksum)->by_default("nc")->as_string());
         smoothie_pin->as_input();
-        if (smoothie_pin->port_number == 0 || smoothie_pin->port_number == 2)
+        if (start_capture(smoothie_pin->port_number, smoothie_pin->pin))
+        {
+            // pulses are timed by the capture hardware
+        }
+        else if (smoothie_pin->port_number == 0 || smoothie_pin->port_number == 2)
         {
             PinName pinname = port_pin((PortName)smoothie_pin->port_number, smoothie_pin->pin);
             feedback_pin = new mbed::InterruptIn(pinname);
@@ -104,7 +147,7 @@ void Spindle::on_module_loaded()
         }
         else
         {
-            THEKERNEL->streams->printf("Error: Spindle feedback pin has to be on P0 or P2.\n");
+            THEKERNEL->streams->printf("Error: Spindle feedback pin has to be on P0 or P2, P0.23 and P0.24 use input capture.\n");
             delete this;
             return;
         }
@@ -116,6 +159,198 @@ void Spindle::on_module_loaded()
     register_for_event(ON_GCODE_EXECUTE);
 }
 
+// The defaults are the registers of the Delta VFD-E and VFD-M, with the frequency in 0.01Hz for a 2 pole motor
+bool Spindle::load_vfd()
+{
+    Pin tx, rx, dir;
+    tx.from_string(THEKERNEL->config->value(spindle_vfd_tx_pin_checksum)->by_default("nc")->as_string());
+    rx.from_string(THEKERNEL->config->value(spindle_vfd_rx_pin_checksum)->by_default("nc")->as_string());
+    dir.from_string(THEKERNEL->config->value(spindle_vfd_dir_pin_checksum)->by_default("nc")->as_string());
+    if (!tx.connected() || !rx.connected())
+    {
+        THEKERNEL->streams->printf("Error: Spindle VFD needs the UART tx and rx pins\n");
+        return false;
+    }
+
+    vfd_address = THEKERNEL->config->value(spindle_vfd_address_checksum)->by_default(1)->as_int();
+    vfd_control_register = THEKERNEL->config->value(spindle_vfd_control_register_checksum)->by_default(0x2000)->as_int();
+    vfd_run_value = THEKERNEL->config->value(spindle_vfd_run_value_checksum)->by_default(0x12)->as_int();
+    vfd_stop_value = THEKERNEL->config->value(spindle_vfd_stop_value_checksum)->by_default(0x01)->as_int();
+    vfd_speed_register = THEKERNEL->config->value(spindle_vfd_speed_register_checksum)->by_default(0x2001)->as_int();
+    vfd_units_per_rpm = THEKERNEL->config->value(spindle_vfd_units_per_rpm_checksum)->by_default(100.0f / 60)->as_number();
+    vfd_feedback_register = THEKERNEL->config->value(spindle_vfd_feedback_register_checksum)->by_default(0x2103)->as_int();
+    vfd_poll_us = THEKERNEL->config->value(spindle_vfd_poll_checksum)->by_default(250)->as_number() * 1000;
+    vfd_tolerance = THEKERNEL->config->value(spindle_vfd_tolerance_checksum)->by_default(0.05f)->as_number();
+    vfd_timeout_us = THEKERNEL->config->value(spindle_vfd_at_speed_timeout_checksum)->by_default(20)->as_number() * 1000000;
+    int baud = THEKERNEL->config->value(spindle_vfd_baud_rate_checksum)->by_default(9600)->as_int();
+    uint32_t reply_ms = THEKERNEL->config->value(spindle_vfd_reply_timeout_checksum)->by_default(100)->as_int();
+
+    vfd = new ModbusRTU(tx, rx, dir, baud, reply_ms);
+    vfd_polled_at = us_ticker_read();
+    vfd_sequence = vfd_taken = vfd_read = 0;
+    vfd_polling = vfd_failed = false;
+    spindle_on = false;
+    vfd_command();
+
+    register_for_event(ON_GCODE_RECEIVED);
+    register_for_event(ON_IDLE);
+    register_for_event(ON_HALT);
+    return true;
+}
+
+// the speed, then run or stop
+void Spindle::vfd_command()
+{
+    uint32_t sequence = ++vfd_sequence;
+    vfd_failed = false;
+
+    bool queued = true;
+    if (spindle_on)
+    {
+        float units = confine(target_rpm * vfd_units_per_rpm + 0.5f, 0.0f, 65535.0f);
+        queued = vfd->write_register(vfd_address, vfd_speed_register, units, [this](bool ok, uint16_t) {
+            if (!ok) vfd_failed = true;
+        });
+    }
+    queued = queued && vfd->write_register(vfd_address, vfd_control_register, spindle_on ? vfd_run_value : vfd_stop_value,
+        [this, sequence](bool ok, uint16_t) {
+            if (ok) vfd_taken = sequence;
+            else vfd_failed = true;
+        });
+    if (!queued)
+        vfd_failed = true;
+}
+
+bool Spindle::vfd_at_speed()
+{
+    if (vfd_taken != vfd_sequence)
+        return false;
+    if (vfd_feedback_register < 0)
+        return true;
+    if (vfd_read != vfd_sequence)
+        return false;
+    float target = spindle_on ? target_rpm : 0;
+    return fabsf(current_rpm - target) <= vfd_tolerance * target_rpm;
+}
+
+// M3 and M5 wait like M109 does, the main loop goes on while the VFD takes the command and the spindle gets there
+void Spindle::wait_for_speed()
+{
+    uint32_t since = us_ticker_read();
+    while (!vfd_at_speed())
+    {
+        THEKERNEL->call_event(ON_IDLE, this);
+        if (THEKERNEL->is_halted())
+        {
+            THEKERNEL->streams->printf("Wait on spindle aborted by kill\n");
+            return;
+        }
+
+        const char *why = nullptr;
+        if (vfd_failed)
+            why = "the VFD did not take the command";
+        else if (us_ticker_read() - since > vfd_timeout_us)
+            why = spindle_on ? "the spindle did not get to speed" : "the spindle did not stop";
+        if (why != nullptr)
+        {
+            THEKERNEL->call_event(ON_HALT, nullptr);
+            THEKERNEL->streams->printf("!! spindle: %s - reset or M999 to continue\r\n", why);
+            return;
+        }
+    }
+}
+
+void Spindle::on_idle(void *argument)
+{
+    vfd->dispatch();
+
+    if (vfd_feedback_register < 0 || vfd_polling || us_ticker_read() - vfd_polled_at < vfd_poll_us)
+        return;
+    vfd_polled_at = us_ticker_read();
+    uint32_t sequence = vfd_sequence;
+    vfd_polling = vfd->read_register(vfd_address, vfd_feedback_register, [this, sequence](bool ok, uint16_t value) {
+        vfd_polling = false;
+        if (!ok)
+            return;
+        current_rpm = value / vfd_units_per_rpm;
+        vfd_read = sequence;
+    });
+}
+
+void Spindle::on_halt(void *argument)
+{
+    if (argument == nullptr)
+    {
+        spindle_on = false;
+        vfd_command();
+    }
+}
+
+// P0.23 and P0.24 are CAP3.0 and CAP3.1, capture the rising edges with TIMER3
+bool Spindle::start_capture(int port, int pin)
+{
+    if (port != 0 || (pin != 23 && pin != 24))
+        return false;
+
+    us_ticker_read(); // make sure the us_ticker has started TIMER3
+
+    capture_channel = pin - 23;
+    instance = this;
+
+    // select the CAP3.x function for the pin
+    LPC_PINCON->PINSEL1 |= 3 << ((pin - 16) * 2);
+
+    // rising edge with interrupt
+    LPC_TIM3->CCR = (LPC_TIM3->CCR & ~(7 << (capture_channel * 3))) | (5 << (capture_channel * 3));
+    NVIC_SetPriority(TIMER3_IRQn, 16);
+    NVIC_EnableIRQ(TIMER3_IRQn);
+    return true;
+}
+
+void Spindle::on_capture()
+{
+    uint32_t flag = 1 << (4 + capture_channel);
+    if ((LPC_TIM3->IR & flag) == 0)
+        return;
+    LPC_TIM3->IR = flag;
+
+    uint32_t t = capture_channel == 0 ? LPC_TIM3->CR0 : LPC_TIM3->CR1;
+    if (!capture_started) {
+        capture_started = true;
+        capture_first = t;
+    } else if (++capture_periods >= max_capture_periods) {
+        // enough for this window, the next update turns it back on
+        LPC_TIM3->CCR &= ~(4 << (capture_channel * 3));
+    }
+    capture_last = t;
+}
+
+// the average period since the last update in us, 0 if there was no new edge
+// a fast spindle is averaged over max_capture_periods, a slow one over the time between edges however long that is
+float Spindle::read_capture()
+{
+    uint32_t interrupt = 4 << (capture_channel * 3);
+
+    __disable_irq();
+    uint32_t first = capture_first, last = capture_last, periods = capture_periods;
+    bool missed = (LPC_TIM3->CCR & interrupt) == 0;
+    if (periods > 0) {
+        // the next window starts at the last edge unless edges were missed while the interrupt was off
+        capture_first = last;
+        capture_periods = 0;
+        if (missed) {
+            capture_started = false;
+            LPC_TIM3->CCR |= interrupt;
+        }
+    }
+    __enable_irq();
+
+    if (periods == 0)
+        return 0;
+    irq_count += periods; // for the timeout
+    return (float)(last - first) / periods;
+}
+
 void Spindle::on_pin_rise()
 {
     uint32_t timestamp = us_ticker_read();
@@ -126,6 +361,12 @@ void Spindle::on_pin_rise()
 
 uint32_t Spindle::on_update_speed(uint32_t dummy)
 {
+    if (capture_channel >= 0) {
+        float period = read_capture();
+        if (period > 0)
+            capture_period = period;
+    }
+
     // If we don't get any interrupts for 1 second, set current RPM to 0
     uint32_t new_irq = irq_count;
     if (last_irq != new_irq)
@@ -134,11 +375,14 @@ uint32_t Spindle::on_update_speed(uint32_t dummy)
         time_since_update++;
     last_irq = new_irq;
 
-    if (time_since_update > UPDATE_FREQ)
+    if (time_since_update > UPDATE_FREQ) {
         last_time = 0;
+        capture_period = 0;
+        capture_started = false; // so the time it was stopped is not taken as a period
+    }
 
     // Calculate current RPM
-    uint32_t t = last_time;
+    float t = capture_channel >= 0 ? capture_period : last_time;
     if (t == 0)
     {
         current_rpm = 0;
@@ -189,8 +433,12 @@ void Spindle::on_gcode_received(void* argument)
         if (gcode->m == 957)
         {
             // M957: report spindle speed
-            THEKERNEL->streams->printf("Current RPM: %5.0f  Target RPM: %5.0f  PWM value: %5.3f\n",
-                                       current_rpm, target_rpm, current_pwm_value);
+            if (vfd != nullptr)
+                THEKERNEL->streams->printf("Current RPM: %5.0f  Target RPM: %5.0f  %s  VFD errors: %lu\n",
+                                           current_rpm, target_rpm, spindle_on ? "on" : "off", (unsigned long)vfd->get_errors());
+            else
+                THEKERNEL->streams->printf("Current RPM: %5.0f  Target RPM: %5.0f  PWM value: %5.3f\n",
+                                           current_rpm, target_rpm, current_pwm_value);
         }
         else if (gcode->m == 958)
         {
@@ -207,7 +455,21 @@ void Spindle::on_gcode_received(void* argument)
         else if (gcode->m == 3 || gcode->m == 5)
         {
             // M3: Spindle on, M5: Spindle off
-            THEKERNEL->conveyor->append_gcode(gcode);
+            if (vfd == nullptr)
+            {
+                THEKERNEL->conveyor->append_gcode(gcode);
+                return;
+            }
+
+            // the VFD is told once the moves before are done, and the ones after wait for the spindle
+            THEKERNEL->conveyor->wait_for_empty_queue();
+            if (THEKERNEL->is_halted())
+                return;
+            spindle_on = gcode->m == 3;
+            if (spindle_on && gcode->has_letter('S'))
+                target_rpm = gcode->get_value('S');
+            vfd_command();
+            wait_for_speed();
         }
     }
 }
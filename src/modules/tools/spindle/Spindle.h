@@ -15,20 +15,32 @@ namespace mbed {
     class PwmOut;
     class InterruptIn;
 }
+class ModbusRTU;
 
-// This module implements closed loop PID control for spindle RPM.
+// This module implements closed loop PID control for spindle RPM, or drives a VFD over Modbus RTU.
 class Spindle: public Module {
     public:
         Spindle();
         virtual ~Spindle() {};
         void on_module_loaded();
+        void on_capture();
         
+        static Spindle *instance; // for the TIMER3 capture interrupt
         
     private:
         void on_pin_rise();
+        bool start_capture(int port, int pin);
+        float read_capture();
         void on_gcode_received(void *argument);
         void on_gcode_execute(void *argument);
         uint32_t on_update_speed(uint32_t dummy);
+
+        bool load_vfd();
+        void vfd_command();
+        bool vfd_at_speed();
+        void wait_for_speed();
+        void on_idle(void *argument);
+        void on_halt(void *argument);
         
         mbed::PwmOut *spindle_pin; // PWM output for spindle speed control
         mbed::InterruptIn *feedback_pin; // Interrupt pin for measuring speed
@@ -55,6 +67,36 @@ class Spindle: public Module {
         uint32_t last_edge; // Timestamp of last edge
         volatile uint32_t last_time; // Time delay between last two edges
         volatile uint32_t irq_count;
+        
+        // Input capture on TIMER3, which is the 1MHz mbed us_ticker. The edges are timed by the hardware, the interrupt
+        // only sums them up and turns itself off once a window has enough periods, so the load does not grow with the RPM
+        static const uint32_t max_capture_periods = 8;
+        int capture_channel; // CAP3.0 or CAP3.1, -1 when the pin interrupt is used
+        volatile uint32_t capture_first; // timestamp of the first edge of the window
+        volatile uint32_t capture_last;  // timestamp of the last edge
+        volatile uint32_t capture_periods; // edges since the first
+        volatile bool capture_started;
+        float capture_period; // average period in us of the last window with edges
+
+        // The VFD takes the commands from the main loop and its speed is read every vfd_poll_us. The commands are
+        // numbered, a speed only says the spindle is there once it was read after the last command was taken
+        ModbusRTU *vfd;
+        uint32_t vfd_poll_us;
+        uint32_t vfd_polled_at;
+        uint32_t vfd_timeout_us;
+        uint32_t vfd_sequence;          // of the last command
+        uint32_t vfd_taken;             // the last command the VFD has taken
+        uint32_t vfd_read;              // the last command before the speed was read
+        float vfd_units_per_rpm;
+        float vfd_tolerance;
+        int vfd_feedback_register;      // -1 when the speed is not read back
+        uint16_t vfd_control_register;
+        uint16_t vfd_speed_register;
+        uint16_t vfd_run_value;
+        uint16_t vfd_stop_value;
+        uint8_t vfd_address;
+        bool vfd_polling;
+        bool vfd_failed;
 };
 
 #endif
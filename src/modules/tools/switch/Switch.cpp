@@ -13,8 +13,9 @@
 #include "libs/Pin.h"
 #include "modules/robot/Conveyor.h"
 #include "PublicDataRequest.h"
+#include "PublicData.h"
 #include "SwitchPublicAccess.h"
-#include "SlowTicker.h"
+#include "SwitchPool.h"
 #include "Config.h"
 #include "Gcode.h"
 #include "checksumm.h"
@@ -43,6 +44,7 @@
 #define    pwm_period_ms_checksum       CHECKSUM("pwm_period_ms")
 #define    failsafe_checksum            CHECKSUM("failsafe_set_to")
 #define    ignore_onhalt_checksum       CHECKSUM("ignore_on_halt")
+#define    sync_checksum                CHECKSUM("sync")
 
 Switch::Switch() {}
 
@@ -74,9 +76,12 @@ void Switch::on_module_loaded()
     this->switch_changed = false;
 
     this->register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_event(ON_GCODE_EXECUTE);
     this->register_for_event(ON_MAIN_LOOP);
+    this->set_event_rate(ON_MAIN_LOOP, 0, true); // only when the switch changed
     this->register_for_event(ON_GET_PUBLIC_DATA);
     this->register_for_event(ON_SET_PUBLIC_DATA);
+    PublicData::register_handler(this, switch_checksum, this->name_checksum);
     this->register_for_event(ON_HALT);
 
     // Settings
@@ -98,6 +103,11 @@ void Switch::on_config_reload(void *argument)
     this->failsafe= THEKERNEL->config->value(switch_checksum, this->name_checksum, failsafe_checksum )->by_default(0)->as_number();
     this->ignore_on_halt= THEKERNEL->config->value(switch_checksum, this->name_checksum, ignore_onhalt_checksum )->by_default(false)->as_bool();
 
+    // block changes the switch between the moves it is between without stopping, drain waits for the moves before it
+    // to finish, none changes it as soon as the gcode is received
+    string sync = THEKERNEL->config->value(switch_checksum, this->name_checksum, sync_checksum )->by_default("block")->as_string();
+    this->sync= (sync == "drain") ? Conveyor::SYNC_DRAIN : (sync == "none") ? Conveyor::SYNC_NONE : Conveyor::SYNC_BLOCK;
+
     if(type == "pwm"){
         this->output_type= SIGMADELTA;
         this->sigmadelta_pin= new Pwm();
@@ -205,12 +215,12 @@ void Switch::on_config_reload(void *argument)
         // set to initial state
         this->input_pin_state = this->input_pin.get();
         // input pin polling
-        THEKERNEL->slow_ticker->attach( 100, this, &Switch::pinpoll_tick);
+        SwitchPool::add_input(this, &this->input_pin);
     }
 
     if(this->output_type == SIGMADELTA) {
         // SIGMADELTA
-        THEKERNEL->slow_ticker->attach(1000, this->sigmadelta_pin, &Pwm::on_tick);
+        this->sigmadelta_pin->start(1000);
     }
 }
 
@@ -237,30 +247,36 @@ void Switch::on_gcode_received(void *argument)
         return;
     }
 
-    // we need to sync this with the queue, so we need to wait for queue to empty, however due to certain slicers
-    // issuing redundant swicth on calls regularly we need to optimize by making sure the value is actually changing
-    // hence we need to do the wait for queue in each case rather than just once at the start
+    // by default the switch changes at the block boundary where the gcode is so the moves around it do not stop
+    if(THEKERNEL->conveyor->synchronize(gcode, this->sync)) {
+        apply_gcode(gcode);
+    }
+}
+
+// called in the step interrupt when the gcode was attached to the queue
+void Switch::on_gcode_execute(void *argument)
+{
+    Gcode *gcode = static_cast<Gcode *>(argument);
+    if (match_input_on_gcode(gcode) || match_input_off_gcode(gcode)) {
+        apply_gcode(gcode);
+    }
+}
+
+void Switch::apply_gcode(const Gcode *gcode)
+{
     if(match_input_on_gcode(gcode)) {
         if (this->output_type == SIGMADELTA) {
             // SIGMADELTA output pin turn on (or off if S0)
             if(gcode->has_letter('S')) {
                 int v = (gcode->get_int('S') * sigmadelta_pin->max_pwm()) / 255; // scale by max_pwm so input of 255 and max_pwm of 128 would set value to 128
-                if(v != this->sigmadelta_pin->get_pwm()){ // optimize... ignore if already set to the same pwm
-                    // drain queue
-                    THEKERNEL->conveyor->wait_for_empty_queue();
-                    this->sigmadelta_pin->pwm(v);
-                    this->switch_state= (v > 0);
-                }
+                this->sigmadelta_pin->pwm(v);
+                this->switch_state= (v > 0);
             } else {
-                // drain queue
-                THEKERNEL->conveyor->wait_for_empty_queue();
                 this->sigmadelta_pin->pwm(this->switch_value);
                 this->switch_state= (this->switch_value > 0);
             }
 
         } else if (this->output_type == HWPWM) {
-            // drain queue
-            THEKERNEL->conveyor->wait_for_empty_queue();
             // PWM output pin set duty cycle 0 - 100
             if(gcode->has_letter('S')) {
                 float v = gcode->get_value('S');
@@ -274,16 +290,12 @@ void Switch::on_gcode_received(void *argument)
             }
 
         } else if (this->output_type == DIGITAL) {
-            // drain queue
-            THEKERNEL->conveyor->wait_for_empty_queue();
             // logic pin turn on
             this->digital_pin->set(true);
             this->switch_state = true;
         }
 
     } else if(match_input_off_gcode(gcode)) {
-        // drain queue
-        THEKERNEL->conveyor->wait_for_empty_queue();
         this->switch_state = false;
         if (this->output_type == SIGMADELTA) {
             // SIGMADELTA output pin
@@ -330,11 +342,13 @@ void Switch::on_set_public_data(void *argument)
         this->switch_state = t;
         pdr->set_taken();
         this->switch_changed= true;
+        this->wake_for_event(ON_MAIN_LOOP);
 
     } else if(pdr->third_element_is(value_checksum)) {
         float t = *static_cast<float *>(pdr->get_data_ptr());
         this->switch_value = t;
         this->switch_changed= true;
+        this->wake_for_event(ON_MAIN_LOOP);
         pdr->set_taken();
     }
 }
@@ -373,14 +387,9 @@ void Switch::on_main_loop(void *argument)
     }
 }
 
-// TODO Make this use InterruptIn
-// Check the state of the button and act accordingly
-uint32_t Switch::pinpoll_tick(uint32_t dummy)
+// Called from the SwitchPool scan when the input pin has changed, act accordingly
+void Switch::input_changed(bool current_state)
 {
-    if(!input_pin.connected()) return 0;
-
-    // If pin changed
-    bool current_state = this->input_pin.get();
     if(this->input_pin_state != current_state) {
         this->input_pin_state = current_state;
         // If pin high
@@ -400,13 +409,13 @@ uint32_t Switch::pinpoll_tick(uint32_t dummy)
             }
         }
     }
-    return 0;
 }
 
 void Switch::flip()
 {
     this->switch_state = !this->switch_state;
     this->switch_changed = true;
+    this->wake_for_event(ON_MAIN_LOOP);
 }
 
 void Switch::send_gcode(std::string msg, StreamOutput *stream)
@@ -10,6 +10,7 @@
 
 #include "Pin.h"
 #include "Pwm.h"
+#include "Conveyor.h"
 #include <math.h>
 
 #include <string>
@@ -31,16 +32,18 @@ class Switch : public Module {
         void on_main_loop(void *argument);
         void on_config_reload(void* argument);
         void on_gcode_received(void* argument);
+        void on_gcode_execute(void* argument);
         void on_get_public_data(void* argument);
         void on_set_public_data(void* argument);
         void on_halt(void *arg);
 
-        uint32_t pinpoll_tick(uint32_t dummy);
+        void input_changed(bool current_state);
         enum OUTPUT_TYPE {NONE, SIGMADELTA, DIGITAL, HWPWM};
 
     private:
         void flip();
         void send_gcode(string msg, StreamOutput* stream);
+        void apply_gcode(const Gcode* gcode);
         bool match_input_on_gcode(const Gcode* gcode) const;
         bool match_input_off_gcode(const Gcode* gcode) const;
 
@@ -60,6 +63,7 @@ class Switch : public Module {
         uint16_t  input_off_command_code;
         char      input_on_command_letter;
         char      input_off_command_letter;
+        Conveyor::sync_t sync;
         struct {
             uint8_t   subcode:4;
             bool      switch_changed:1;
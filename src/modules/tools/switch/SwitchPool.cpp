@@ -15,6 +15,9 @@ using namespace std;
 #include "Config.h"
 #include "checksumm.h"
 #include "ConfigValue.h"
+#include "SlowTicker.h"
+#include "PinChange.h"
+#include "libs/Pin.h"
 
 #define switch_checksum CHECKSUM("switch")
 #define enable_checksum CHECKSUM("enable")
@@ -28,12 +31,59 @@ void SwitchPool::load_tools()
         // If module is enabled
         if( THEKERNEL->config->value(switch_checksum, modules[i], enable_checksum )->as_bool() == true ) {
             Switch *controller = new Switch(modules[i]);
-            THEKERNEL->add_module(controller);
+            THEKERNEL->add_module(controller, "switch");
         }
     }
 
 }
 
+SwitchPool *SwitchPool::scanner= nullptr;
+
+void SwitchPool::add_input(Switch *sw, Pin *pin)
+{
+    // debounced to the period of the scan
+    if(PinChange::attach(*pin, [sw](bool on) { sw->input_changed(on); }, 10)) return;
+
+    if(scanner == nullptr) {
+        // the pool used to load the switches is deleted, the scanner is a separate one that stays
+        scanner= new SwitchPool();
+        for(auto &p : scanner->ports) {
+            p.mask= 0;
+            p.last= 0;
+        }
+        THEKERNEL->slow_ticker->attach( 100, scanner, &SwitchPool::scan_tick);
+    }
+
+    // the scan may already be running
+    __disable_irq();
+    port_t &p= scanner->ports[(int)pin->port_number];
+    uint32_t bit= 1 << pin->pin;
+    p.mask |= bit;
+    p.last= (p.last & ~bit) | (pin->port->FIOPIN & bit);
+    p.inputs.push_back({sw, pin});
+    __enable_irq();
+}
+
+uint32_t SwitchPool::scan_tick(uint32_t dummy)
+{
+    for(auto &p : ports) {
+        if(p.mask == 0) continue;
+
+        // one read for all the inputs on the port
+        uint32_t now= p.inputs[0].pin->port->FIOPIN & p.mask;
+        uint32_t changed= now ^ p.last;
+        if(changed == 0) continue;
+        p.last= now;
+
+        for(auto &i : p.inputs) {
+            if(changed & (1 << i.pin->pin)) {
+                i.sw->input_changed(i.pin->is_inverting() ^ ((now >> i.pin->pin) & 1));
+            }
+        }
+    }
+    return 0;
+}
+
 
 
 
@@ -8,9 +8,35 @@
 #ifndef SWITCHPOOL_H
 #define SWITCHPOOL_H
 
+#include <stdint.h>
+#include <vector>
+
+class Switch;
+class Pin;
+
 class SwitchPool{
     public:
         void load_tools();
+
+        // the input pins of all the switches are read by one SlowTicker hook, a whole port at a time, and only the
+        // switches whose pin changed since the last scan are told about it, the pins on port 0 or 2 tell PinChange instead
+        static void add_input(Switch *sw, Pin *pin);
+
+    private:
+        uint32_t scan_tick(uint32_t dummy);
+
+        struct input_t {
+            Switch *sw;
+            Pin *pin;
+        };
+        struct port_t {
+            uint32_t mask;              // bits of the port that are switch inputs
+            uint32_t last;              // what they read on the last scan
+            std::vector<input_t> inputs;
+        };
+
+        static SwitchPool *scanner;
+        port_t ports[5];
 };
 
 #endif // SWITCHPOOL_H
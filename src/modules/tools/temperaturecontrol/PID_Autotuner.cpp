@@ -16,12 +16,8 @@
 
 PID_Autotuner::PID_Autotuner()
 {
-    temp_control = NULL;
-    lastInputs = NULL;
-    peaks = NULL;
     tick = false;
     tickCnt = 0;
-    nLookBack = 10 * 20; // 10 seconds of lookback (fixed 20ms tick period)
 }
 
 void PID_Autotuner::on_module_loaded()
@@ -32,51 +28,45 @@ void PID_Autotuner::on_module_loaded()
     register_for_event(ON_GCODE_RECEIVED);
 }
 
-void PID_Autotuner::begin(float target, int ncycles)
+void PID_Autotuner::begin(Tuning *t)
 {
-    noiseBand = 0.5;
-    oStep = temp_control->heater_pin.max_pwm(); // use max pwm to cycle temp
-    lookBackCnt = 0;
-    tickCnt = 0;
-
-    if (lastInputs != NULL) delete[] lastInputs;
-    lastInputs = new float[nLookBack + 1];
-
-    temp_control->heater_pin.set(0);
-    temp_control->target_temperature = 0.0;
-
-    target_temperature = target;
-    requested_cycles = ncycles;
-
-    if (peaks != NULL) delete[] peaks;
-    peaks = new float[ncycles];
-
-    for (int i = 0; i < ncycles; i++) {
-        peaks[i] = 0.0;
-    }
-
-    peakType = 0;
-    peakCount = 0;
-    justchanged = false;
-    firstPeak= false;
-    output= 0;
+    t->oStep = t->temp_control->heater_pin.max_pwm(); // use max pwm to cycle temp
+    t->lookBackCnt = 0;
+    t->lastInputs = new float[t->nLookBack + 1];
+
+    t->temp_control->heater_pin.set(0);
+    t->temp_control->target_temperature = 0.0;
+
+    t->peakType = 0;
+    t->peakCount = 0;
+    t->peak1 = t->peak2 = 0;
+    t->amplitude = t->period = 0;
+    t->converged = 0;
+    t->justchanged = false;
+    t->firstPeak = false;
+    t->output = 0;
 }
 
-void PID_Autotuner::abort()
+// turn the heater off and forget the tuning
+void PID_Autotuner::release(Tuning *t)
 {
-    if (temp_control == NULL)
-        return;
-
-    temp_control->target_temperature = 0;
-    temp_control->heater_pin.set(0);
-    temp_control = NULL;
+    t->temp_control->target_temperature = 0;
+    t->temp_control->heater_pin.set(0);
+    delete[] t->lastInputs;
+    delete t;
+}
 
-    if (peaks != NULL)
-        delete[] peaks;
-    peaks = NULL;
-    if (lastInputs != NULL)
-        delete[] lastInputs;
-    lastInputs = NULL;
+// abort the tuning of the heater with this pool index, or of all heaters when it is -1
+void PID_Autotuner::abort(int pool_index)
+{
+    for (auto i = tunings.begin(); i != tunings.end(); ) {
+        if (pool_index < 0 || (*i)->temp_control->pool_index == pool_index) {
+            release(*i);
+            i = tunings.erase(i);
+        } else {
+            ++i;
+        }
+    }
 }
 
 void PID_Autotuner::on_gcode_received(void *argument)
@@ -85,7 +75,8 @@ void PID_Autotuner::on_gcode_received(void *argument)
 
     if(gcode->has_m) {
         if(gcode->m == 304) {
-            abort();
+            int pool_index = gcode->has_letter('E') ? gcode->get_value('E') : -1;
+            abort(pool_index);
             gcode->stream->printf("PID Autotune Aborted\n");
 
         } else if (gcode->m == 303 && gcode->has_letter('E')) {
@@ -95,59 +86,69 @@ void PID_Autotuner::on_gcode_received(void *argument)
             void *returned_data;
             bool ok = PublicData::get_value( temperature_control_checksum, pool_index_checksum, pool_index, &returned_data );
 
-            if (ok) {
-                this->temp_control =  *static_cast<TemperatureControl **>(returned_data);
-
-            } else {
+            if (!ok) {
                 gcode->stream->printf("No temperature control with index %d found\r\n", pool_index);
                 return;
             }
 
+            // tuning a heater again restarts it, the other heaters carry on
+            abort(pool_index);
+
+            Tuning *t = new Tuning;
+            t->temp_control = *static_cast<TemperatureControl **>(returned_data);
+
             // set target
-            float target = 150.0;
+            t->target_temperature = 150.0;
             if (gcode->has_letter('S')) {
-                target = gcode->get_value('S');
-                gcode->stream->printf("Target: %5.1f\n", target);
+                t->target_temperature = gcode->get_value('S');
+                gcode->stream->printf("Target: %5.1f\n", t->target_temperature);
             }
 
-            // set the cycles, really not needed for this new version
-            int ncycles = 8;
+            // set the maximum number of cycles, it normally stops as soon as the estimates settle
+            t->requested_cycles = 8;
             if (gcode->has_letter('C')) {
-                ncycles = gcode->get_value('C');
-                if(ncycles < 8) ncycles= 8;
+                t->requested_cycles = gcode->get_value('C');
+                if(t->requested_cycles < 8) t->requested_cycles = 8;
             }
 
             // optionally set the noise band, default is 0.5
+            t->noiseBand = 0.5;
             if (gcode->has_letter('B')) {
-                noiseBand = gcode->get_value('B');
+                t->noiseBand = gcode->get_value('B');
             }
 
             // optionally set the look back in seconds default is 10 seconds
+            t->nLookBack = 10 * 20; // fixed 20ms tick period
             if (gcode->has_letter('L')) {
-                nLookBack = gcode->get_value('L');
+                t->nLookBack = gcode->get_value('L') * 20;
+                if(t->nLookBack < 20) t->nLookBack = 20;
+            }
+
+            // optionally set the tolerance in percent the amplitude and period must settle within, default is 5%
+            t->tolerance = 0.05F;
+            if (gcode->has_letter('R')) {
+                t->tolerance = gcode->get_value('R') / 100.0F;
             }
 
-            gcode->stream->printf("Start PID tune for index E%d, designator: %s\n", pool_index, this->temp_control->designator.c_str());
+            gcode->stream->printf("Start PID tune for index E%d, designator: %s\n", pool_index, t->temp_control->designator.c_str());
 
-            this->begin(target, ncycles);
+            begin(t);
+            tunings.push_back(t);
 
-            gcode->stream->printf("%s: Starting PID Autotune, %d max cycles, M304 aborts\n", temp_control->designator.c_str(), ncycles);
+            gcode->stream->printf("%s: Starting PID Autotune, %d max cycles, M304 aborts\n", t->temp_control->designator.c_str(), t->requested_cycles);
         }
     }
 }
 
 uint32_t PID_Autotuner::on_tick(uint32_t dummy)
 {
-    if (temp_control != NULL)
+    if (!tunings.empty())
         tick = true;
 
     tickCnt += (1000 / 20); // millisecond tick count
     return 0;
 }
 
-/**
- * this autopid is based on https://github.com/br3ttb/Arduino-PID-AutoTune-Library/blob/master/PID_AutoTune_v0/PID_AutoTune_v0.cpp
- */
 void PID_Autotuner::on_idle(void *)
 {
     if (!tick)
@@ -155,46 +156,60 @@ void PID_Autotuner::on_idle(void *)
 
     tick = false;
 
-    if (temp_control == NULL)
-        return;
+    for (auto i = tunings.begin(); i != tunings.end(); ) {
+        Tuning *t = *i;
+        if (step(t, t->temp_control->get_temperature())) {
+            ++i;
+        } else {
+            release(t);
+            i = tunings.erase(i);
+        }
+    }
+}
+
+/**
+ * this autopid is based on https://github.com/br3ttb/Arduino-PID-AutoTune-Library/blob/master/PID_AutoTune_v0/PID_AutoTune_v0.cpp
+ * advances the relay of one heater by a tick, returns false once it is done
+ */
+bool PID_Autotuner::step(Tuning *t, float refVal)
+{
+    const char *designator = t->temp_control->designator.c_str();
 
-    if(peakCount >= requested_cycles) {
+    if(t->peakCount >= t->requested_cycles) {
         // NOTE we output to kernel::streams becuase it is out-of-band data and original stream may be closed
-        THEKERNEL->streams->printf("// WARNING: Autopid did not resolve within %d cycles, these results are probably innacurate\n", requested_cycles);
-        finishUp();
-        return;
+        THEKERNEL->streams->printf("// WARNING: %s: Autopid did not resolve within %d cycles, these results are probably innacurate\n", designator, t->requested_cycles);
+        finishUp(t);
+        return false;
     }
 
-    float refVal = temp_control->get_temperature();
-
     // oscillate the output base on the input's relation to the setpoint
-    if (refVal > target_temperature + noiseBand) {
-        output = 0;
-        //temp_control->heater_pin.pwm(output);
-        temp_control->heater_pin.set(0);
-        if(!firstPeak) {
-            firstPeak= true;
-            absMax= refVal;
-            absMin= refVal;
+    if (refVal > t->target_temperature + t->noiseBand) {
+        t->output = 0;
+        t->temp_control->heater_pin.set(0);
+        if(!t->firstPeak) {
+            t->firstPeak = true;
+            t->cycleMax = refVal;
+            t->cycleMin = refVal;
         }
 
-    } else if (refVal < target_temperature - noiseBand) {
-        output = oStep;
-        temp_control->heater_pin.pwm(output);
+    } else if (refVal < t->target_temperature - t->noiseBand) {
+        t->output = t->oStep;
+        t->temp_control->heater_pin.pwm(t->output);
     }
 
     if ((tickCnt % 1000) == 0) {
-        THEKERNEL->streams->printf("// Autopid Status - %5.1f/%5.1f @%d %d/%d\n",  refVal, target_temperature, output, peakCount, requested_cycles);
+        THEKERNEL->streams->printf("// Autopid Status - %s: %5.1f/%5.1f @%d %d/%d\n", designator, refVal, t->target_temperature, t->output, t->peakCount, t->requested_cycles);
     }
 
-    if(!firstPeak){
+    if(!t->firstPeak){
         // we wait until we hit the first peak befire we do anything else,we need to ignore the itial warmup temperatures
-        return;
+        return true;
     }
 
     // find the peaks high and low
     bool isMax = true, isMin = true;
-    for (int i = nLookBack - 1; i >= 0; i--) {
+    float *lastInputs = t->lastInputs;
+    for (int i = t->nLookBack - 1; i >= 0; i--) {
         float val = lastInputs[i];
         if (isMax) isMax = refVal > val;
         if (isMin) isMin = refVal < val;
@@ -204,60 +219,80 @@ void PID_Autotuner::on_idle(void *)
     lastInputs[0] = refVal;
 
     //we don't want to trust the maxes or mins until the inputs array has been filled
-    if (lookBackCnt < nLookBack) {
-        lookBackCnt++; // count number of times we have filled lastInputs
-        return;
+    if (t->lookBackCnt < t->nLookBack) {
+        t->lookBackCnt++; // count number of times we have filled lastInputs
+        return true;
     }
 
+    float lastMin = t->cycleMin;
+    t->justchanged = false;
     if (isMax) {
-        if(refVal > absMax) absMax= refVal;
-
-        if (peakType == 0) peakType = 1;
-        if (peakType == -1) {
-            peakType = 1;
-            justchanged = true;
-            peak2 = peak1;
+        if (t->peakType == -1) {
+            t->peakType = 1;
+            t->peak2 = t->peak1;
+            t->cycleMax = refVal;
         }
-        peak1 = tickCnt;
-        peaks[peakCount] = refVal;
+        if (t->peakType == 0) t->peakType = 1;
+        if (refVal > t->cycleMax) t->cycleMax = refVal;
+        t->peak1 = tickCnt;
 
     } else if (isMin) {
-        if(refVal < absMin) absMin= refVal;
-        if (peakType == 0) peakType = -1;
-        if (peakType == 1) {
-            peakType = -1;
-            peakCount++;
-            justchanged = true;
+        if (t->peakType == 1) {
+            // a maximum followed by a minimum completes a cycle
+            t->peakType = -1;
+            t->peakCount++;
+            t->justchanged = true;
+            t->cycleMin = refVal;
         }
-
-        if (peakCount < requested_cycles) peaks[peakCount] = refVal;
+        if (t->peakType == 0) t->peakType = -1;
+        if (refVal < t->cycleMin) t->cycleMin = refVal;
     }
 
-    if (justchanged && peakCount >= 4) {
-        // we've transitioned. check if we can autotune based on the last peaks
-        float avgSeparation = (fabsf(peaks[peakCount - 1] - peaks[peakCount - 2]) + fabsf(peaks[peakCount - 2] - peaks[peakCount - 3])) / 2;
-        THEKERNEL->streams->printf("// Cycle %d: max: %g, min: %g, avg separation: %g\n", peakCount, absMax, absMin, avgSeparation);
-        if (peakCount > 3 && avgSeparation < (0.05 * (absMax - absMin))) {
+    if (t->justchanged && t->peak2 != 0) {
+        // estimate from the cycle that just ended, from the minimum before its maximum
+        float amplitude = (t->cycleMax - lastMin) / 2;
+        float period = (float)(t->peak1 - t->peak2) / 1000;
+        float damp = t->amplitude > 0 ? fabsf(amplitude - t->amplitude) / amplitude : 1;
+        float dperiod = t->period > 0 ? fabsf(period - t->period) / period : 1;
+        t->amplitude = amplitude;
+        t->period = period;
+
+        if (damp < t->tolerance && dperiod < t->tolerance) {
+            t->converged++;
+        } else {
+            t->converged = 0;
+        }
+
+        THEKERNEL->streams->printf("// %s: Cycle %d: amplitude: %g (%+1.1f%%), period: %gs (%+1.1f%%)\n", designator, t->peakCount, amplitude, damp * 100, period, dperiod * 100);
+
+        // two cycles in a row that agree with the one before are enough
+        if (t->converged >= 2) {
             DEBUG_PRINTF("Stabilized\n");
-            finishUp();
-            return;
+            finishUp(t);
+            return false;
         }
     }
 
     if ((tickCnt % 1000) == 0) {
-        DEBUG_PRINTF("lookBackCnt= %d, peakCount= %d, absmax= %g, absmin= %g, peak1= %lu, peak2= %lu\n", lookBackCnt, peakCount, absMax, absMin, peak1, peak2);
+        DEBUG_PRINTF("lookBackCnt= %d, peakCount= %d, max= %g, min= %g, peak1= %lu, peak2= %lu\n", t->lookBackCnt, t->peakCount, t->cycleMax, t->cycleMin, t->peak1, t->peak2);
     }
 
-    justchanged = false;
+    return true;
 }
 
 
-void PID_Autotuner::finishUp()
+void PID_Autotuner::finishUp(Tuning *t)
 {
+    const char *designator = t->temp_control->designator.c_str();
+    if (t->amplitude <= 0 || t->period <= 0) {
+        THEKERNEL->streams->printf("%s: PID Autotune failed, no oscillation was measured\n", designator);
+        return;
+    }
+
     //we can generate tuning parameters!
-    float Ku = 4 * (2 * oStep) / ((absMax - absMin) * 3.14159);
-    float Pu = (float)(peak1 - peak2) / 1000;
-    THEKERNEL->streams->printf("\tKu: %g, Pu: %g\n", Ku, Pu);
+    float Ku = 4 * t->oStep / (t->amplitude * 3.14159F);
+    float Pu = t->period;
+    THEKERNEL->streams->printf("\t%s: Ku: %g, Pu: %g\n", designator, Ku, Pu);
 
     float kp = 0.6 * Ku;
     float ki = 1.2 * Ku / Pu;
@@ -265,23 +300,9 @@ void PID_Autotuner::finishUp()
 
     THEKERNEL->streams->printf("\tTrying:\n\tKp: %5.1f\n\tKi: %5.3f\n\tKd: %5.0f\n", kp, ki, kd);
 
-    temp_control->setPIDp(kp);
-    temp_control->setPIDi(ki);
-    temp_control->setPIDd(kd);
-
-    THEKERNEL->streams->printf("PID Autotune Complete! The settings above have been loaded into memory, but not written to your config file.\n");
-
-
-    // and clean up
-    temp_control->target_temperature = 0;
-    temp_control->heater_pin.set(0);
-    temp_control = NULL;
-
-    if (peaks != NULL)
-        delete[] peaks;
-    peaks = NULL;
+    t->temp_control->setPIDp(kp);
+    t->temp_control->setPIDi(ki);
+    t->temp_control->setPIDd(kd);
 
-    if (lastInputs != NULL)
-        delete[] lastInputs;
-    lastInputs = NULL;
+    THEKERNEL->streams->printf("%s: PID Autotune Complete! The settings above have been loaded into memory, but not written to your config file.\n", designator);
 }
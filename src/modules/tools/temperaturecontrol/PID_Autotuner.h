@@ -6,6 +6,7 @@
 #define _PID_AUTOTUNE_H
 
 #include <stdint.h>
+#include <vector>
 
 #include "Module.h"
 
@@ -22,32 +23,39 @@ public:
     void on_gcode_received(void *);
 
 private:
-    void begin(float, int );
-    void abort();
-    void finishUp();
-
-    TemperatureControl *temp_control;
-    float target_temperature;
-
-    float *peaks;
-    int requested_cycles;
-    float noiseBand;
-    unsigned long peak1, peak2;
-    int sampleTime;
-    int nLookBack;
-    int lookBackCnt;
-    int peakType;
-    float *lastInputs;
-    int peakCount;
-    float absMax, absMin;
-    float oStep;
-    int output;
-    volatile unsigned long tickCnt;
-    struct {
-        bool justchanged:1;
-        volatile bool tick:1;
-        bool firstPeak:1;
+    // the relay state of one heater being tuned, any number of heaters can be tuned at the same time
+    struct Tuning {
+        TemperatureControl *temp_control;
+        float target_temperature;
+        float noiseBand;
+        float tolerance;                // stop once amplitude and period change less than this fraction between cycles
+        int requested_cycles;
+        int nLookBack;
+        int lookBackCnt;
+        int peakType;
+        int peakCount;
+        float *lastInputs;
+        float oStep;
+        int output;
+        unsigned long peak1, peak2;     // tick count of the last two maximums
+        float cycleMax, cycleMin;       // extremes of the current half cycles
+        float amplitude, period;        // estimates from the last complete cycle
+        int converged;                  // number of cycles in a row the estimates have been within tolerance
+        struct {
+            bool justchanged:1;
+            bool firstPeak:1;
+        };
     };
+
+    void begin(Tuning *t);
+    bool step(Tuning *t, float refVal);
+    void finishUp(Tuning *t);
+    void release(Tuning *t);
+    void abort(int pool_index);
+
+    std::vector<Tuning*> tunings;
+    volatile unsigned long tickCnt;
+    volatile bool tick;
 };
 
 #endif /* _PID_AUTOTUNE_H */
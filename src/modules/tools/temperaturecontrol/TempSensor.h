@@ -22,6 +22,9 @@ public:
     // Return temperature in degrees Celsius.
     virtual float get_temperature() { return -1.0F; }
 
+    // called from the main loop at the reading rate, for a sensor that reads its bus there so get_temperature does not have to
+    virtual void poll() {}
+
     typedef std::map<char, float> sensor_options_t;
     virtual bool set_optional(const sensor_options_t& options) { return false; }
     virtual bool get_optional(sensor_options_t& options) { return false; }
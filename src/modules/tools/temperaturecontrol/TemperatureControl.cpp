@@ -34,6 +34,13 @@
 #include "AD8495.h"
 
 #include "MRI_Hooks.h"
+#include "SwitchPublicAccess.h"
+#include "ExtruderPublicAccess.h"
+#include "us_ticker_api.h" // mbed
+#include "cmsis.h"
+
+#include <algorithm>
+#include <string.h>
 
 #define UNDEFINED -1
 
@@ -42,6 +49,7 @@
 #define readings_per_second_checksum       CHECKSUM("readings_per_second")
 #define max_pwm_checksum                   CHECKSUM("max_pwm")
 #define pwm_frequency_checksum             CHECKSUM("pwm_frequency")
+#define hardware_pwm_checksum              CHECKSUM("hardware_pwm")
 #define bang_bang_checksum                 CHECKSUM("bang_bang")
 #define hysteresis_checksum                CHECKSUM("hysteresis")
 #define heater_pin_checksum                CHECKSUM("heater_pin")
@@ -51,6 +59,7 @@
 #define get_m_code_checksum                CHECKSUM("get_m_code")
 #define set_m_code_checksum                CHECKSUM("set_m_code")
 #define set_and_wait_m_code_checksum       CHECKSUM("set_and_wait_m_code")
+#define coalesce_heater_waits_checksum     CHECKSUM("coalesce_heater_waits")
 
 #define designator_checksum                CHECKSUM("designator")
 
@@ -61,8 +70,18 @@
 #define i_max_checksum                     CHECKSUM("i_max")
 #define windup_checksum                    CHECKSUM("windup")
 
+#define feedforward_fan_checksum           CHECKSUM("feedforward_fan")
+#define feedforward_fan_factor_checksum    CHECKSUM("feedforward_fan_factor")
+#define feedforward_extruder_checksum      CHECKSUM("feedforward_extruder")
+#define feedforward_extruder_factor_checksum CHECKSUM("feedforward_extruder_factor")
+
 #define preset1_checksum                   CHECKSUM("preset1")
 #define preset2_checksum                   CHECKSUM("preset2")
+#define heat_rate_checksum                 CHECKSUM("heat_rate")
+
+std::vector<uint16_t> TemperatureControl::set_m_codes;
+pad_temperature_row TemperatureControl::rows[TemperatureControl::max_rows];
+pad_temperature_snapshot TemperatureControl::snapshot{TemperatureControl::rows, 0};
 
 TemperatureControl::TemperatureControl(uint16_t name, int index)
 {
@@ -72,6 +91,11 @@ TemperatureControl::TemperatureControl(uint16_t name, int index)
     temp_violated= false;
     sensor= nullptr;
     readonly= false;
+    reports_rows= false;
+    row= -1;
+    ff_fan_factor= 0;
+    ff_extruder_factor= 0;
+    feedforward= 0;
 }
 
 TemperatureControl::~TemperatureControl()
@@ -91,11 +115,21 @@ void TemperatureControl::on_module_loaded()
 
     // Register for events
     this->register_for_event(ON_GCODE_RECEIVED);
+    // a wait put off has to be done before the moves after it are queued
+    if(this->coalesce_waits) this->set_event_priority(ON_GCODE_RECEIVED, PRIORITY_FEED);
     this->register_for_event(ON_GET_PUBLIC_DATA);
+    this->register_for_event(ON_CONFIG_CHANGED);
+    PublicData::register_handler(this, temperature_control_checksum);
+
+    // sensors that read a bus do it here at the reading rate
+    this->register_for_event(ON_IDLE);
+    this->set_event_rate(ON_IDLE, std::max(1, (int)(1000 / this->readings_per_second)));
+
+    this->register_for_event(ON_MAIN_LOOP);
+    this->set_event_rate(ON_MAIN_LOOP, 0, true); // only to report a temperature violation or a watched threshold crossed
 
     if(!this->readonly) {
         this->register_for_event(ON_SECOND_TICK);
-        this->register_for_event(ON_MAIN_LOOP);
         this->register_for_event(ON_SET_PUBLIC_DATA);
         this->register_for_event(ON_HALT);
     }
@@ -108,9 +142,16 @@ void TemperatureControl::on_halt(void *arg)
         this->o = 0;
         this->heater_pin.set(0);
         this->target_temperature = UNDEFINED;
+        this->wait_deferred = false;
+        update_row();
     }
 }
 
+void TemperatureControl::on_idle(void *argument)
+{
+    this->sensor->poll();
+}
+
 void TemperatureControl::on_main_loop(void *argument)
 {
     if (this->temp_violated) {
@@ -119,6 +160,38 @@ void TemperatureControl::on_main_loop(void *argument)
         THEKERNEL->streams->printf("HALT asserted - reset or M999 required\n");
         THEKERNEL->call_event(ON_HALT, nullptr);
     }
+
+    for(auto &w : this->watches) {
+        if(!w.pending) continue;
+        w.pending= false;
+        w.crossed();
+    }
+
+    if(this->ff_fan_factor != 0 || this->ff_extruder_factor != 0) update_feedforward();
+}
+
+// the fan and extruder are looked up from here as public data can not be used from the read tick
+void TemperatureControl::update_feedforward()
+{
+    uint32_t now= us_ticker_read(); // mbed call
+    if(now - this->ff_last_us < 50000) return;
+    this->ff_last_us= now;
+
+    float ff= 0;
+    if(this->ff_fan_factor != 0) {
+        struct pad_switch s;
+        if(PublicData::get_value(switch_checksum, this->ff_fan, 0, &s) && s.state) {
+            // a sigma delta fan has its value, an on/off fan is full on
+            ff += this->ff_fan_factor * (s.value > 0 ? std::min(s.value / 255.0F, 1.0F) : 1.0F);
+        }
+    }
+    if(this->ff_extruder_factor != 0) {
+        float *rate;
+        if(PublicData::get_value(extruder_checksum, flow_rate_checksum, this->ff_extruder, &rate)) {
+            ff += this->ff_extruder_factor * *rate;
+        }
+    }
+    this->feedforward= ff;
 }
 
 // Get configuration from the config file
@@ -129,13 +202,16 @@ void TemperatureControl::load_config()
     this->set_m_code          = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, set_m_code_checksum)->by_default(104)->as_number();
     this->set_and_wait_m_code = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, set_and_wait_m_code_checksum)->by_default(109)->as_number();
     this->get_m_code          = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, get_m_code_checksum)->by_default(105)->as_number();
+    set_m_codes.push_back(this->set_m_code);
+    set_m_codes.push_back(this->set_and_wait_m_code);
+    // the waits of the start gcode, bed then hotend, are put off until all the targets are set so they heat up together
+    this->coalesce_waits      = THEKERNEL->config->value(coalesce_heater_waits_checksum)->by_default(false)->as_bool();
+    this->wait_deferred       = false;
     this->readings_per_second = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, readings_per_second_checksum)->by_default(20)->as_number();
 
     this->designator          = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, designator_checksum)->by_default(string("T"))->as_string();
-
-    // Max and min temperatures we are not allowed to get over (Safety)
-    this->max_temp = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, max_temp_checksum)->by_default(300)->as_number();
-    this->min_temp = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, min_temp_checksum)->by_default(0)->as_number();
+    // until a wait has measured it, how fast a preheat is taken to heat up
+    this->heat_rate           = std::max(0.1F, THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, heat_rate_checksum)->by_default(1.0F)->as_number());
 
     // Heater pin
     this->heater_pin.from_string( THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, heater_pin_checksum)->by_default("nc")->as_string());
@@ -164,23 +240,21 @@ void TemperatureControl::load_config()
     }
     sensor->UpdateConfig(temperature_control_checksum, this->name_checksum);
 
-    this->preset1 = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, preset1_checksum)->by_default(0)->as_number();
-    this->preset2 = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, preset2_checksum)->by_default(0)->as_number();
-
-
     // sigma-delta output modulation
     this->o = 0;
 
     if(!this->readonly) {
-        // used to enable bang bang control of heater
-        this->use_bangbang = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, bang_bang_checksum)->by_default(false)->as_bool();
-        this->hysteresis = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, hysteresis_checksum)->by_default(2)->as_number();
-        this->windup = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, windup_checksum)->by_default(false)->as_bool();
+        // optional feed forward from a fan and an extruder
+        this->ff_fan = get_checksum(THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, feedforward_fan_checksum)->by_default("fan")->as_string());
+        this->ff_extruder = get_checksum(THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, feedforward_extruder_checksum)->by_default("")->as_string());
+        this->feedforward = 0;
+        this->ff_last_us = 0;
         this->heater_pin.max_pwm( THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, max_pwm_checksum)->by_default(255)->as_number() );
         this->heater_pin.set(0);
         set_low_on_debug(heater_pin.port_number, heater_pin.pin);
-        // activate SD-DAC timer
-        THEKERNEL->slow_ticker->attach( THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, pwm_frequency_checksum)->by_default(2000)->as_number(), &heater_pin, &Pwm::on_tick);
+        // activate SD-DAC timer, or the pin's PWM channel when there is one and it is asked for
+        this->heater_pin.start( THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, pwm_frequency_checksum)->by_default(2000)->as_number(),
+                                THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, hardware_pwm_checksum)->by_default(false)->as_bool() );
     }
 
 
@@ -188,6 +262,48 @@ void TemperatureControl::load_config()
     THEKERNEL->slow_ticker->attach( this->readings_per_second, this, &TemperatureControl::thermistor_read_tick );
     this->PIDdt = 1.0 / this->readings_per_second;
 
+    load_tuning();
+
+    this->iTerm = 0.0;
+    this->lastInput = -1.0;
+    this->last_reading = 0.0;
+
+    if(this->row < 0 && snapshot.count < max_rows) {
+        pad_temperature_row &r= rows[snapshot.count];
+        r.id= this->name_checksum;
+        r.get_m_code= this->get_m_code;
+        strncpy(r.designator, this->designator.c_str(), sizeof(r.designator) - 1);
+        r.designator[sizeof(r.designator) - 1]= '\0';
+        this->reports_rows= true;
+        for(int i= 0; i < snapshot.count; ++i) {
+            if(rows[i].get_m_code == this->get_m_code) this->reports_rows= false;
+        }
+        this->row= snapshot.count++;
+        update_row();
+    }
+}
+
+// the settings that can change while heating, also read again by on_config_changed
+void TemperatureControl::load_tuning()
+{
+    // Max and min temperatures we are not allowed to get over (Safety)
+    this->max_temp = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, max_temp_checksum)->by_default(300)->as_number();
+    this->min_temp = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, min_temp_checksum)->by_default(0)->as_number();
+
+    this->preset1 = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, preset1_checksum)->by_default(0)->as_number();
+    this->preset2 = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, preset2_checksum)->by_default(0)->as_number();
+
+    if(!this->readonly) {
+        // used to enable bang bang control of heater
+        this->use_bangbang = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, bang_bang_checksum)->by_default(false)->as_bool();
+        this->hysteresis = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, hysteresis_checksum)->by_default(2)->as_number();
+        this->windup = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, windup_checksum)->by_default(false)->as_bool();
+
+        // the feed forward factors are in pwm counts at full fan and per mm³/sec
+        this->ff_fan_factor = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, feedforward_fan_factor_checksum)->by_default(0)->as_number();
+        this->ff_extruder_factor = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, feedforward_extruder_factor_checksum)->by_default(0)->as_number();
+    }
+
     // PID
     setPIDp( THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, p_factor_checksum)->by_default(10 )->as_number() );
     setPIDi( THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, i_factor_checksum)->by_default(0.3f)->as_number() );
@@ -197,21 +313,50 @@ void TemperatureControl::load_config()
         // set to the same as max_pwm by default
         this->i_max = THEKERNEL->config->value(temperature_control_checksum, this->name_checksum, i_max_checksum   )->by_default(this->heater_pin.max_pwm())->as_number();
     }
+}
 
-    this->iTerm = 0.0;
-    this->lastInput = -1.0;
-    this->last_reading = 0.0;
+void TemperatureControl::on_config_changed(void *argument)
+{
+    ConfigChange *change = static_cast<ConfigChange *>(argument);
+    if(!change->is_for(temperature_control_checksum, this->name_checksum)) return;
+
+    // the pins, the sensor and the reading rate are set up once
+    static const uint16_t tuning[] = {
+        max_temp_checksum, min_temp_checksum, preset1_checksum, preset2_checksum, bang_bang_checksum, hysteresis_checksum,
+        windup_checksum, feedforward_fan_factor_checksum, feedforward_extruder_factor_checksum, p_factor_checksum,
+        i_factor_checksum, d_factor_checksum, i_max_checksum
+    };
+    if(std::find(std::begin(tuning), std::end(tuning), change->check_sums[2]) == std::end(tuning)) return;
+
+    load_tuning();
+    change->applied++;
 }
 
 void TemperatureControl::on_gcode_received(void *argument)
 {
     Gcode *gcode = static_cast<Gcode *>(argument);
+    if (this->wait_deferred && !(gcode->has_m && is_temperature_m_code(gcode->m))) {
+        this->wait_deferred = false;
+        wait_for_target();
+    }
+
     if (gcode->has_m) {
 
         if( gcode->m == this->get_m_code ) {
             char buf[32]; // should be big enough for any status
-            int n = snprintf(buf, sizeof(buf), "%s:%3.1f /%3.1f @%d ", this->designator.c_str(), this->get_temperature(), ((target_temperature <= 0) ? 0.0 : target_temperature), this->o);
-            gcode->txt_after_ok.append(buf, n);
+            if(this->row < 0) {
+                int n = snprintf(buf, sizeof(buf), "%s:%3.1f /%3.1f @%d ", this->designator.c_str(), this->get_temperature(), ((target_temperature <= 0) ? 0.0 : target_temperature), this->o);
+                gcode->txt_after_ok.append(buf, n);
+
+            } else if(this->reports_rows) {
+                // the others with the same get_m_code have nothing to add
+                for(int i= 0; i < snapshot.count; ++i) {
+                    const pad_temperature_row &r= rows[i];
+                    if(r.get_m_code != this->get_m_code) continue;
+                    int n = snprintf(buf, sizeof(buf), "%s:%3.1f /%3.1f @%d ", r.designator, r.current_temperature, r.target_temperature, r.pwm);
+                    gcode->txt_after_ok.append(buf, n);
+                }
+            }
             return;
         }
 
@@ -274,13 +419,19 @@ void TemperatureControl::on_gcode_received(void *argument)
                     this->i_max = gcode->get_value('X');
                 if (gcode->has_letter('Y'))
                     this->heater_pin.max_pwm(gcode->get_value('Y'));
+                if (gcode->has_letter('F'))
+                    this->ff_fan_factor = gcode->get_value('F');
+                if (gcode->has_letter('E'))
+                    this->ff_extruder_factor = gcode->get_value('E');
+                if (this->ff_fan_factor == 0 && this->ff_extruder_factor == 0)
+                    this->feedforward = 0;
 
             }else if(!gcode->has_letter('S')) {
-                gcode->stream->printf("%s(S%d): Pf:%g If:%g Df:%g X(I_max):%g max pwm: %d O:%d\n", this->designator.c_str(), this->pool_index, this->p_factor, this->i_factor / this->PIDdt, this->d_factor * this->PIDdt, this->i_max, this->heater_pin.max_pwm(), o);
+                gcode->stream->printf("%s(S%d): Pf:%g If:%g Df:%g X(I_max):%g max pwm: %d O:%d F(fan):%g E(flow):%g FF:%g\n", this->designator.c_str(), this->pool_index, this->p_factor, this->i_factor / this->PIDdt, this->d_factor * this->PIDdt, this->i_max, this->heater_pin.max_pwm(), o, this->ff_fan_factor, this->ff_extruder_factor, this->feedforward);
             }
 
         } else if (gcode->m == 500 || gcode->m == 503) { // M500 saves some volatile settings to config override file, M503 just prints the settings
-            gcode->stream->printf(";PID settings:\nM301 S%d P%1.4f I%1.4f D%1.4f X%1.4f Y%d\n", this->pool_index, this->p_factor, this->i_factor / this->PIDdt, this->d_factor * this->PIDdt, this->i_max, this->heater_pin.max_pwm());
+            gcode->stream->printf(";PID settings:\nM301 S%d P%1.4f I%1.4f D%1.4f X%1.4f Y%d F%1.4f E%1.4f\n", this->pool_index, this->p_factor, this->i_factor / this->PIDdt, this->d_factor * this->PIDdt, this->i_max, this->heater_pin.max_pwm(), this->ff_fan_factor, this->ff_extruder_factor);
 
             gcode->stream->printf(";Max temperature setting:\nM143 S%d P%1.4f\n", this->pool_index, this->max_temp);
 
@@ -328,23 +479,47 @@ void TemperatureControl::on_gcode_received(void *argument)
                             return;
                         }
 
-                        this->waiting = true; // on_second_tick will announce temps
-                        while ( get_temperature() < target_temperature ) {
-                            THEKERNEL->call_event(ON_IDLE, this);
-                            // check if ON_HALT was called (usually by kill button)
-                            if(THEKERNEL->is_halted() || this->target_temperature == UNDEFINED) {
-                                THEKERNEL->streams->printf("Wait on temperature aborted by kill\n");
-                                break;
-                            }
-                        }
-                        this->waiting = false;
+                        if(this->coalesce_waits) this->wait_deferred = true;
+                        else wait_for_target();
                     }
                 }
             }
+
+        } else if (gcode->m == 116) { // wait for all the heaters, they heat up together so this waits as long as the slowest
+            this->wait_deferred = false;
+            if(!this->readonly && this->target_temperature != UNDEFINED) wait_for_target();
         }
     }
 }
 
+// the temperatures of the heaters, and the waits for them, are not gcodes that end a run of waits put off
+bool TemperatureControl::is_temperature_m_code(uint16_t m)
+{
+    if(m == 105 || m == 116) return true;
+    return std::find(set_m_codes.begin(), set_m_codes.end(), m) != set_m_codes.end();
+}
+
+// no more gcodes will be fetched until the target is reached
+void TemperatureControl::wait_for_target()
+{
+    this->waiting = true; // on_second_tick will announce temps
+    float from = get_temperature();
+    uint32_t since = us_ticker_read();
+    while ( get_temperature() < target_temperature ) {
+        THEKERNEL->call_event(ON_IDLE, this);
+        // check if ON_HALT was called (usually by kill button)
+        if(THEKERNEL->is_halted() || this->target_temperature == UNDEFINED) {
+            THEKERNEL->streams->printf("Wait on temperature aborted by kill\n");
+            break;
+        }
+    }
+    this->waiting = false;
+    // a short wait says too little about the heater
+    float rise = get_temperature() - from;
+    float secs = (us_ticker_read() - since) / 1e6F;
+    if(rise > 20 && secs > 2) this->heat_rate = rise / secs;
+}
+
 void TemperatureControl::on_get_public_data(void *argument)
 {
     PublicDataRequest *pdr = static_cast<PublicDataRequest *>(argument);
@@ -360,6 +535,10 @@ void TemperatureControl::on_get_public_data(void *argument)
             pdr->set_taken();
         }
 
+    }else if(pdr->second_element_is(temperature_snapshot_checksum)) {
+        pdr->set_data_ptr(&snapshot);
+        pdr->set_taken();
+
     }else if(pdr->second_element_is(poll_controls_checksum)) {
         // polling for all temperature controls
         // add our data to the list which is passed in via the data_ptr
@@ -398,7 +577,43 @@ void TemperatureControl::on_set_public_data(void *argument)
 
     if(!pdr->starts_with(temperature_control_checksum)) return;
 
-    if(!pdr->second_element_is(this->name_checksum)) return;
+    if(pdr->second_element_is(watch_temperature_checksum)) {
+        pad_temperature_watch *w= static_cast<pad_temperature_watch *>(pdr->get_data_ptr());
+        if(w->designator != this->designator[0]) return;
+        // the read tick goes through the watches
+        __disable_irq();
+        this->watches.push_back({w->threshold, w->crossed, 0, false});
+        __enable_irq();
+        pdr->set_taken();
+        return;
+    }
+
+    if(pdr->second_element_is(preheat_checksum)) {
+        pad_preheat *p= static_cast<pad_preheat *>(pdr->get_data_ptr());
+        if(this->readonly || (p->m_code != this->set_m_code && p->m_code != this->set_and_wait_m_code)) return;
+        if(p->tool_name != 0 && p->tool_name != this->name_checksum) {
+            // it is for another tool if the tool manager has this one
+            void *returned_data;
+            if(PublicData::get_value( tool_manager_checksum, is_active_tool_checksum, this->name_checksum, &returned_data )) return;
+        }
+        pdr->set_taken();
+
+        // only ever heats up early, a lower target is left for the job to set when it gets to it
+        float target = (this->target_temperature <= 0) ? 0 : this->target_temperature;
+        if(p->target <= target || p->target > this->max_temp) {
+            p->done = true;
+            return;
+        }
+        // with some to spare as the time left is planned
+        float needed = (p->target - get_temperature()) / this->heat_rate * 1.2F + 5;
+        if(p->seconds <= needed) {
+            this->set_desired_temperature(p->target);
+            p->done = true;
+        }
+        return;
+    }
+
+    if(this->readonly || !pdr->second_element_is(this->name_checksum)) return;
 
     // ok this is targeted at us, so set the temp
     // NOTE unlike the M code this will set the temp now not when the queue is empty
@@ -433,6 +648,7 @@ void TemperatureControl::set_desired_temperature(float desired_temperature)
         if (this->iTerm > this->i_max) this->iTerm = this->i_max;
         else if (this->iTerm < 0.0) this->iTerm = 0.0;
     }
+    update_row();
 }
 
 float TemperatureControl::get_temperature()
@@ -446,6 +662,7 @@ uint32_t TemperatureControl::thermistor_read_tick(uint32_t dummy)
     if(!this->readonly && target_temperature > 2) {
         if (isinf(temperature) || temperature < min_temp || temperature > max_temp) {
             this->temp_violated = true;
+            this->wake_for_event(ON_MAIN_LOOP);
             target_temperature = UNDEFINED;
             heater_pin.set((this->o = 0));
         } else {
@@ -454,6 +671,15 @@ uint32_t TemperatureControl::thermistor_read_tick(uint32_t dummy)
     }
 
     last_reading = temperature;
+    update_row();
+
+    for(auto &w : this->watches) {
+        uint8_t side= temperature >= w.threshold ? 2 : 1;
+        if(side == w.side) continue;
+        w.side= side;
+        w.pending= true;
+        this->wake_for_event(ON_MAIN_LOOP);
+    }
     return 0;
 }
 
@@ -495,7 +721,7 @@ void TemperatureControl::pid_process(float temperature)
 
     // calculate the PID output
     // TODO does this need to be scaled by max_pwm/256? I think not as p_factor already does that
-    this->o = (this->p_factor * error) + new_I - (this->d_factor * d);
+    this->o = (this->p_factor * error) + new_I - (this->d_factor * d) + this->feedforward;
 
     if (this->o >= heater_pin.max_pwm())
         this->o = heater_pin.max_pwm();
@@ -508,6 +734,16 @@ void TemperatureControl::pid_process(float temperature)
     this->lastInput = temperature;
 }
 
+// also called from the reading tick, a row read between the writes is off by the one reading at most
+void TemperatureControl::update_row()
+{
+    if(this->row < 0) return;
+    pad_temperature_row &r= rows[this->row];
+    r.current_temperature= last_reading;
+    r.target_temperature= (target_temperature <= 0) ? 0 : target_temperature;
+    r.pwm= this->o;
+}
+
 void TemperatureControl::on_second_tick(void *argument)
 {
     if (waiting)
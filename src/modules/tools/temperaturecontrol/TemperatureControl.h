@@ -13,6 +13,8 @@
 #include "TempSensor.h"
 #include "TemperatureControlPublicAccess.h"
 
+#include <vector>
+
 class TemperatureControl : public Module {
 
     public:
@@ -21,11 +23,13 @@ class TemperatureControl : public Module {
 
         void on_module_loaded();
         void on_main_loop(void* argument);
+        void on_idle(void* argument);
         void on_gcode_received(void* argument);
         void on_second_tick(void* argument);
         void on_get_public_data(void* argument);
         void on_set_public_data(void* argument);
         void on_halt(void* argument);
+        void on_config_changed(void* argument);
 
         void set_desired_temperature(float desired_temperature);
 
@@ -35,8 +39,13 @@ class TemperatureControl : public Module {
 
     private:
         void load_config();
+        void load_tuning();
         uint32_t thermistor_read_tick(uint32_t dummy);
         void pid_process(float);
+        void wait_for_target();
+        static bool is_temperature_m_code(uint16_t m);
+        void update_feedforward();
+        void update_row();
 
         int pool_index;
 
@@ -64,14 +73,22 @@ class TemperatureControl : public Module {
         uint16_t set_m_code;
         uint16_t set_and_wait_m_code;
         uint16_t get_m_code;
+        static std::vector<uint16_t> set_m_codes;  // of all the heaters, they do not end a run of waits put off
 
         std::string designator;
 
+        // the rows returned for temperature_snapshot, row is the one of this control, or -1 when there were too many
+        static const uint8_t max_rows= 8;
+        static pad_temperature_row rows[max_rows];
+        static pad_temperature_snapshot snapshot;
+        int8_t row;
+
         void setPIDp(float p);
         void setPIDi(float i);
         void setPIDd(float d);
 
         float hysteresis;
+        float heat_rate;            // °C/s, as measured on the last wait that heated up far enough to tell
         float iTerm;
         float lastInput;
         // PID settings
@@ -80,6 +97,23 @@ class TemperatureControl : public Module {
         float d_factor;
         float PIDdt;
 
+        // feed forward, added to the PID output so the heater reacts to the fan or extrusion before the temperature drops
+        uint16_t ff_fan;                // switch whose duty cycle adds up to ff_fan_factor
+        uint16_t ff_extruder;           // extruder whose flow adds ff_extruder_factor per mm³/sec
+        float ff_fan_factor;
+        float ff_extruder_factor;
+        volatile float feedforward;
+        uint32_t ff_last_us;
+
+        // told when the reading crosses their threshold, side is 0 until the first reading then 1 below and 2 at or over it
+        struct watch_t {
+            float threshold;
+            std::function<void(void)> crossed;
+            volatile uint8_t side;
+            volatile bool pending;
+        };
+        std::vector<watch_t> watches;
+
         struct {
             bool use_bangbang:1;
             bool waiting:1;
@@ -89,6 +123,9 @@ class TemperatureControl : public Module {
             bool readonly:1;
             bool windup:1;
             bool sensor_settings:1;
+            bool coalesce_waits:1;
+            bool wait_deferred:1;       // the target was set with a wait that is put off until the next other gcode
+            bool reports_rows:1;        // the first with its get_m_code, it answers it from the rows of all that have it
         };
 };
 
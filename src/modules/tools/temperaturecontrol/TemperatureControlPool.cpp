@@ -29,13 +29,13 @@ void TemperatureControlPool::load_tools()
         // If module is enabled
         if( THEKERNEL->config->value(temperature_control_checksum, cs, enable_checksum )->as_bool() ) {
             TemperatureControl *controller = new TemperatureControl(cs, cnt++);
-            THEKERNEL->add_module(controller);
+            THEKERNEL->add_module(controller, "temperaturecontrol");
         }
     }
 
     // no need to create one of these if no heaters defined
     if(cnt > 0) {
         PID_Autotuner *pidtuner = new PID_Autotuner();
-        THEKERNEL->add_module( pidtuner );
+        THEKERNEL->add_module( pidtuner, "pidautotuner" );
     }
 }
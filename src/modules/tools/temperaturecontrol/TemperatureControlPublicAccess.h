@@ -4,6 +4,7 @@
 #include "checksumm.h"
 
 #include <string>
+#include <functional>
 
 // addresses used for public data access
 #define temperature_control_checksum      CHECKSUM("temperature_control")
@@ -14,6 +15,9 @@
 #define temperature_pwm_checksum          CHECKSUM("temperature_pwm")
 #define pool_index_checksum               CHECKSUM("pool_index")
 #define poll_controls_checksum            CHECKSUM("poll_controllers")
+#define watch_temperature_checksum        CHECKSUM("watch_temperature")
+#define preheat_checksum                  CHECKSUM("preheat")
+#define temperature_snapshot_checksum     CHECKSUM("temperature_snapshot")
 
 struct pad_temperature {
     float current_temperature;
@@ -22,4 +26,41 @@ struct pad_temperature {
     uint16_t id;
     std::string designator;
 };
+
+// one control as of its last reading, each control keeps its own row up to date from its reading tick and when its
+// target is set, so it can be read without asking it
+struct pad_temperature_row {
+    float current_temperature;
+    float target_temperature;
+    int16_t pwm;
+    uint16_t id;
+    uint16_t get_m_code;
+    char designator[8];
+};
+
+// returned for temperature_snapshot, the rows of all the controls in the order they were loaded, in one request that
+// costs the same however many there are. The rows stay where they are, so the pointer can be kept
+struct pad_temperature_snapshot {
+    const pad_temperature_row *rows;
+    uint8_t count;
+};
+
+// set on the controls to have crossed called from the main loop after a reading of a control with the designator goes over
+// or under the threshold, and after its first reading
+struct pad_temperature_watch {
+    char designator;
+    float threshold;
+    std::function<void(void)> crossed;
+};
+
+// set on the controls to heat up ahead for a temperature that a job sets with the M code in seconds time, with the tool
+// that is active then, or 0 if it has no tools. The control it is for raises its target once the time left is what it
+// takes to heat up at the rate it last heated at, and sets done when there is nothing more to do for it
+struct pad_preheat {
+    uint16_t m_code;
+    uint16_t tool_name;
+    float target;
+    float seconds;
+    bool done;
+};
 #endif
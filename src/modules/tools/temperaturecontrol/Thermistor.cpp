@@ -37,6 +37,9 @@
 #define rt_curve_checksum                  CHECKSUM("rt_curve")
 #define coefficients_checksum              CHECKSUM("coefficients")
 #define use_beta_table_checksum            CHECKSUM("use_beta_table")
+#define max_temp_checksum                  CHECKSUM("max_temp")
+#define min_temp_checksum                  CHECKSUM("min_temp")
+#define oversample_checksum                CHECKSUM("oversample")
 
 
 Thermistor::Thermistor()
@@ -47,10 +50,15 @@ Thermistor::Thermistor()
     min_temp= 999;
     max_temp= 0;
     this->thermistor_number= 0; // not a predefined thermistor
+    this->lut= nullptr;
+    this->lut_points= 0;
+    this->table_min= 0;
+    this->table_max= 300;
 }
 
 Thermistor::~Thermistor()
 {
+    delete[] lut;
 }
 
 // Get configuration from the config file
@@ -122,9 +130,15 @@ void Thermistor::UpdateConfig(uint16_t module_checksum, uint16_t name_checksum)
     this->r1 = THEKERNEL->config->value(module_checksum, name_checksum, r1_checksum  )->by_default(this->r1  )->as_number();
     this->r2 = THEKERNEL->config->value(module_checksum, name_checksum, r2_checksum  )->by_default(this->r2  )->as_number();
 
+    // the lookup table only needs to cover the temperatures the heater is allowed to be at
+    this->table_min = THEKERNEL->config->value(module_checksum, name_checksum, min_temp_checksum)->by_default(0)->as_number();
+    this->table_max = THEKERNEL->config->value(module_checksum, name_checksum, max_temp_checksum)->by_default(300)->as_number();
+
     // Thermistor pin for ADC readings
     this->thermistor_pin.from_string(THEKERNEL->config->value(module_checksum, name_checksum, thermistor_pin_checksum )->required()->as_string());
-    THEKERNEL->adc->enable_pin(&thermistor_pin);
+    // more readings in each sample give finer steps where the curve is flat, at the hot end
+    int oversample= THEKERNEL->config->value(module_checksum, name_checksum, oversample_checksum)->by_default(Adc::default_oversample)->as_int();
+    THEKERNEL->adc->enable_pin(&thermistor_pin, oversample);
 
     // specify the three Steinhart-Hart coefficients
     // specified as three comma separated floats, no spaces
@@ -180,6 +194,72 @@ void Thermistor::UpdateConfig(uint16_t module_checksum, uint16_t name_checksum)
         return;
     }
 
+    build_table();
+}
+
+// tabulate the conversion from table_max to table_min, so a reading does not need logf
+void Thermistor::build_table()
+{
+    delete[] lut;
+    lut= nullptr;
+    lut_points= 0;
+    if(bad_config || isnan(table_min) || isnan(table_max) || table_max <= table_min) return;
+
+    lut= new lut_point_t[LUT_POINTS];
+    const uint32_t max_adc_value= THEKERNEL->adc->get_max_value();
+    for (int i = 0; i < LUT_POINTS; i++) {
+        // the temperature falls as the adc value rises, find the first value at or below this one by bisection
+        float want= table_max - (table_max - table_min) * i / (LUT_POINTS - 1);
+        uint32_t lo= 1, hi= max_adc_value - 1;
+        while(lo < hi) {
+            uint32_t mid= (lo + hi) / 2;
+            if(calculate_temperature(mid) > want) lo= mid + 1;
+            else hi= mid;
+        }
+        float t= calculate_temperature(lo);
+        if(isinf(t)) break; // off the end of what the thermistor can read
+        if(lut_points > 0 && lo <= lut[lut_points - 1].adc) continue; // too close to the last one to resolve
+        lut[lut_points].adc= lo;
+        lut[lut_points].temperature= t;
+        lut_points++;
+    }
+    if(lut_points < 2) {
+        delete[] lut;
+        lut= nullptr;
+        lut_points= 0;
+    }
+}
+
+// the worst difference between the table and the calculated temperature, and the adc value it is at
+float Thermistor::table_error(uint32_t *at)
+{
+    float worst= 0;
+    *at= 0;
+    if(lut == nullptr) return NAN;
+    for (uint32_t a = lut[0].adc; a < lut[lut_points - 1].adc; a++) {
+        float e= fabsf(adc_value_to_temperature(a) - calculate_temperature(a));
+        if(e > worst) {
+            worst= e;
+            *at= a;
+        }
+    }
+    return worst;
+}
+
+// how far out the table would be for a thermistor with these Steinhart-Hart coefficients on the default 4.7k pullup
+float Thermistor::lookup_table_error(float c1, float c2, float c3)
+{
+    Thermistor t;
+    t.r0= 100000;
+    t.r1= 0;
+    t.r2= 4700;
+    t.c1= c1;
+    t.c2= c2;
+    t.c3= c3;
+    t.use_steinhart_hart= true;
+    t.build_table();
+    uint32_t at;
+    return t.table_error(&at);
 }
 
 // print out predefined thermistors
@@ -276,11 +356,33 @@ void Thermistor::get_raw()
         THEKERNEL->streams->printf("Using predefined thermistor %d in %s table: %s\n", thermistor_number&0x7F, (thermistor_number&0x80)?"Beta":"S/H", name.c_str());
     }
 
+    if(lut != nullptr) {
+        uint32_t at;
+        float e= table_error(&at);
+        THEKERNEL->streams->printf("lookup table %d points %1.1f to %1.1f, max error= %f at adc %lu\n", lut_points, lut[lut_points - 1].temperature, lut[0].temperature, e, at);
+    }
+
     // reset the min/max
     min_temp= max_temp= t;
 }
 
 float Thermistor::adc_value_to_temperature(uint32_t adc_value)
+{
+    // one interpolation in the table when the reading is in the range it covers
+    if(lut != nullptr && adc_value >= lut[0].adc && adc_value < lut[lut_points - 1].adc) {
+        int lo= 0, hi= lut_points - 1;
+        while(hi - lo > 1) {
+            int mid= (lo + hi) / 2;
+            if(adc_value < lut[mid].adc) hi= mid;
+            else lo= mid;
+        }
+        const lut_point_t &a= lut[lo], &b= lut[hi];
+        return a.temperature + (b.temperature - a.temperature) * (adc_value - a.adc) / (b.adc - a.adc);
+    }
+    return calculate_temperature(adc_value);
+}
+
+float Thermistor::calculate_temperature(uint32_t adc_value)
 {
     const uint32_t max_adc_value= THEKERNEL->adc->get_max_value();
     if ((adc_value >= max_adc_value) || (adc_value == 0))
@@ -352,6 +454,7 @@ bool Thermistor::set_optional(const sensor_options_t& options) {
             calc_jk();
             thermistor_number= predefined;
             this->bad_config= false;
+            build_table();
             return true;
 
         }else {
@@ -370,6 +473,7 @@ bool Thermistor::set_optional(const sensor_options_t& options) {
             use_steinhart_hart= true;
             thermistor_number= predefined;
             this->bad_config= false;
+            build_table();
             return true;
         }
     }
@@ -397,6 +501,7 @@ bool Thermistor::set_optional(const sensor_options_t& options) {
 
     if(this->bad_config) this->bad_config= false;
 
+    build_table();
     return true;
 }
 
@@ -16,6 +16,9 @@
 
 #define QUEUE_LEN 32
 
+// points in the temperature lookup table
+#define LUT_POINTS 64
+
 class StreamOutput;
 
 class Thermistor : public TempSensor
@@ -32,11 +35,18 @@ class Thermistor : public TempSensor
         void get_raw();
         static std::tuple<float,float,float> calculate_steinhart_hart_coefficients(float t1, float r1, float t2, float r2, float t3, float r3);
         static void print_predefined_thermistors(StreamOutput*);
+        static float lookup_table_error(float c1, float c2, float c3);
+
+        // times the conversion, see src/testframework/bench
+        friend class ThermistorBench;
 
     private:
         int new_thermistor_reading();
         float adc_value_to_temperature(uint32_t adc_value);
+        float calculate_temperature(uint32_t adc_value);
         void calc_jk();
+        void build_table();
+        float table_error(uint32_t *at);
 
         // Thermistor computation settings using beta, not used if using Steinhart-Hart
         float r0;
@@ -62,6 +72,16 @@ class Thermistor : public TempSensor
 
         Pin  thermistor_pin;
 
+        // piecewise linear conversion between adc values whose temperatures are evenly spaced from table_max down to
+        // table_min as the curve is much steeper at the hot end
+        struct lut_point_t {
+            uint16_t adc;
+            float temperature;
+        };
+        lut_point_t *lut;
+        uint8_t lut_points;
+        float table_min, table_max;
+
         float min_temp, max_temp;
         struct {
             bool bad_config:1;
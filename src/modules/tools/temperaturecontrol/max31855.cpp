@@ -15,13 +15,19 @@
 #include "max31855.h"
 
 #include "MRI_Hooks.h"
+#include "us_ticker_api.h" // mbed
 
 #define chip_select_checksum CHECKSUM("chip_select_pin")
 #define spi_channel_checksum CHECKSUM("spi_channel")
 
+// with no good reading for this long the temperature is an error, so a stuck main loop or a dead thermocouple turns the heater off
+#define max_reading_age_us 2000000
+
 Max31855::Max31855() :
     spi(nullptr)
 {
+    average = infinityf();
+    last_read_us = us_ticker_read();
 }
 
 Max31855::~Max31855()
@@ -57,7 +63,16 @@ void Max31855::UpdateConfig(uint16_t module_checksum, uint16_t name_checksum)
     spi->format(16);
 }
 
+// called by TemperatureControl in the slow ticker, and for M105, the bus is read in poll so this only returns the result
 float Max31855::get_temperature()
+{
+    if(us_ticker_read() - last_read_us > max_reading_age_us) return infinityf();
+    return average;
+}
+
+// The thermocouples are read from the main loop, where a few of them on the bus, or on the bus of the sd card, take turns
+// with everything else that uses it instead of holding up the timer interrupt
+void Max31855::poll()
 {
 	// Return an average of the last readings
     if (readings.size() >= readings.capacity()) {
@@ -70,15 +85,16 @@ float Max31855::get_temperature()
 	if(!isinf(temp))
 	{
 		readings.push_back(temp);
+		last_read_us = us_ticker_read();
 	}
 
-	if(readings.size()==0) return infinityf();
+	if(readings.size()==0) return;
 
 	float sum = 0;
     for (int i=0; i<readings.size(); i++)
         sum += *readings.get_ref(i);
 
-	return sum / readings.size();
+	average = sum / readings.size();
 }
 
 float Max31855::read_temp()
@@ -21,12 +21,15 @@ public:
     ~Max31855();
     void UpdateConfig(uint16_t module_checksum, uint16_t name_checksum);
     float get_temperature();
+    void poll();
 
 private:
 	float read_temp();
     Pin spi_cs_pin;
     mbed::SPI *spi;
     RingBuffer<float,16> readings;
+    volatile float average;             // of the readings, what get_temperature returns
+    volatile uint32_t last_read_us;     // when poll last got a good reading
 };
 
 #endif
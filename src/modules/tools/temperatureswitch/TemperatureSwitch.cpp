@@ -121,7 +121,7 @@ TemperatureSwitch* TemperatureSwitch::load_config(uint16_t modcs)
 
     ts->temperatureswitch_threshold_temp = THEKERNEL->config->value(temperatureswitch_checksum, modcs, temperatureswitch_threshold_temp_checksum)->by_default(50.0f)->as_number();
 
-    // these are to tune the heatup and cooldown polling frequencies
+    // these are to tune the heatup and cooldown polling frequencies, only used if no control can be watched
     ts->temperatureswitch_heatup_poll = THEKERNEL->config->value(temperatureswitch_checksum, modcs, temperatureswitch_heatup_poll_checksum)->by_default(15)->as_number();
     ts->temperatureswitch_cooldown_poll = THEKERNEL->config->value(temperatureswitch_checksum, modcs, temperatureswitch_cooldown_poll_checksum)->by_default(60)->as_number();
     ts->current_delay = ts->temperatureswitch_heatup_poll;
@@ -132,8 +132,11 @@ TemperatureSwitch* TemperatureSwitch::load_config(uint16_t modcs)
     // if not defined then always armed, otherwise start out disarmed
     ts->armed= (ts->arm_mcode == 0);
 
-    // Register for events
-    ts->register_for_event(ON_SECOND_TICK);
+    // the controls say when the temperature crosses the threshold, it is polled if none of them has the designator
+    pad_temperature_watch watch{designator, ts->temperatureswitch_threshold_temp, [ts]() { ts->check_temperature(); }};
+    if(!PublicData::set_value(temperature_control_checksum, watch_temperature_checksum, &watch)) {
+        ts->register_for_event(ON_SECOND_TICK);
+    }
 
     if(ts->arm_mcode != 0) {
         ts->register_for_event(ON_GCODE_RECEIVED);
@@ -157,6 +160,11 @@ void TemperatureSwitch::on_second_tick(void *argument)
     if (second_counter < current_delay) return;
 
     second_counter = 0;
+    check_temperature();
+}
+
+void TemperatureSwitch::check_temperature()
+{
     float current_temp = this->get_highest_temperature();
 
     if (current_temp >= this->temperatureswitch_threshold_temp) {
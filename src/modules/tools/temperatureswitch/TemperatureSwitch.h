@@ -44,6 +44,9 @@ class TemperatureSwitch : public Module
         // turn the switch on or off
         void set_switch(bool cooler_state);
 
+        // compare the highest temperature with the threshold
+        void check_temperature();
+
         // temperature has changed state
         void set_state(STATE state);
 
@@ -18,13 +18,18 @@ public:
     Tool(){};
     virtual ~Tool() {};
 
+    // enabled is the tool the moves being executed use, selected the one the gcodes being planned use.
+    // They only differ while a tool change is waiting in the queue
     virtual void enable(){ enabled= true; }
     virtual void disable(){ enabled= false; }
+    virtual void select(){ selected= true; }
+    virtual void deselect(){ selected= false; }
     virtual const float *get_offset() const { return offset; }
     virtual uint16_t get_name() const { return identifier; }
 
 protected:
     bool enabled;
+    bool selected;
     float offset[3];
     uint16_t identifier;
 };
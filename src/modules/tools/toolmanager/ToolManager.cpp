@@ -26,9 +26,12 @@ using namespace std;
 #include "libs/StreamOutput.h"
 #include "FileStream.h"
 
+#define coalesce_heater_waits_checksum CHECKSUM("coalesce_heater_waits")
+
 ToolManager::ToolManager()
 {
     active_tool = 0;
+    enabled_tool = 0;
     current_tool_name = CHECKSUM("hotend");
 }
 
@@ -36,8 +39,15 @@ void ToolManager::on_module_loaded()
 {
 
     this->register_for_event(ON_GCODE_RECEIVED);
+    // TemperatureControl goes first to wait before the moves, a T on an M104 still has to pick the tool before it
+    if(THEKERNEL->config->value(coalesce_heater_waits_checksum)->by_default(false)->as_bool()) {
+        this->set_event_priority(ON_GCODE_RECEIVED, PRIORITY_FEED);
+    }
+    this->register_for_event(ON_GCODE_EXECUTE);
+    this->register_for_event(ON_HALT);
     this->register_for_event(ON_GET_PUBLIC_DATA);
     this->register_for_event(ON_SET_PUBLIC_DATA);
+    PublicData::register_handler(this, tool_manager_checksum);
 }
 
 void ToolManager::on_gcode_received(void *argument)
@@ -54,21 +64,49 @@ void ToolManager::on_gcode_received(void *argument)
 
         } else {
             if(new_tool != this->active_tool) {
-                // We must wait for an empty queue before we can disable the current extruder
-                THEKERNEL->conveyor->wait_for_empty_queue();
-                this->tools[active_tool]->disable();
+                // the gcodes after this are planned for the new tool straight away, the moves already queued still
+                // need the current extruder so it is swapped when the tool change gets to the head of the queue
+                this->tools[active_tool]->deselect();
                 this->active_tool = new_tool;
                 this->current_tool_name = this->tools[active_tool]->get_name();
-                this->tools[active_tool]->enable();
+                this->tools[active_tool]->select();
 
-                //send new_tool_offsets to robot
+                //send new_tool_offsets to robot, they apply to the moves planned from now on
                 const float *new_tool_offset = tools[new_tool]->get_offset();
                 THEKERNEL->robot->setToolOffset(new_tool_offset);
+
+                char buf[8];
+                snprintf(buf, sizeof(buf), "T%d", new_tool);
+                Gcode gc(buf, &(StreamOutput::NullStream));
+                THEKERNEL->conveyor->append_gcode(&gc);
             }
         }
     }
 }
 
+// the queue has got to the tool change, swap the extruder the moves use
+void ToolManager::on_gcode_execute(void *argument)
+{
+    Gcode *gcode = static_cast<Gcode*>(argument);
+    if(gcode->has_g || gcode->has_m || !gcode->has_letter('T')) return;
+
+    int new_tool = gcode->get_value('T');
+    if(new_tool == this->enabled_tool || new_tool < 0 || new_tool >= (int)this->tools.size()) return;
+    this->tools[enabled_tool]->disable();
+    this->enabled_tool = new_tool;
+    this->tools[enabled_tool]->enable();
+}
+
+void ToolManager::on_halt(void *argument)
+{
+    // the queue is flushed so any tool change still in it will not be executed
+    if(argument == nullptr && this->enabled_tool != this->active_tool && !this->tools.empty()) {
+        this->tools[enabled_tool]->disable();
+        this->enabled_tool = this->active_tool;
+        this->tools[enabled_tool]->enable();
+    }
+}
+
 void ToolManager::on_get_public_data(void* argument)
 {
     PublicDataRequest* pdr = static_cast<PublicDataRequest*>(argument);
@@ -96,6 +134,18 @@ void ToolManager::on_get_public_data(void* argument)
     }else if(pdr->second_element_is(get_active_tool_checksum)) {
         pdr->set_data_ptr(&this->active_tool);
         pdr->set_taken();
+
+    }else if(pdr->second_element_is(get_tool_name_checksum)) {
+        // the name of the tool a T command selects, the number is the third element
+        for(size_t i = 0; i < tools.size(); i++) {
+            if(pdr->third_element_is(i)) {
+                static uint16_t name;
+                name = tools[i]->get_name();
+                pdr->set_data_ptr(&name);
+                pdr->set_taken();
+                break;
+            }
+        }
     }
 }
 
@@ -115,12 +165,14 @@ void ToolManager::on_set_public_data(void* argument)
 void ToolManager::add_tool(Tool* tool_to_add)
 {
     if(this->tools.size() == 0) {
+        tool_to_add->select();
         tool_to_add->enable();
         this->current_tool_name = tool_to_add->get_name();
         //send new_tool_offsets to robot
         const float *new_tool_offset = tool_to_add->get_offset();
         THEKERNEL->robot->setToolOffset(new_tool_offset);
     } else {
+        tool_to_add->deselect();
         tool_to_add->disable();
     }
     this->tools.push_back( tool_to_add );
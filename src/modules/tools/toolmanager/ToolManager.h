@@ -20,6 +20,8 @@ public:
 
     void on_module_loaded();
     void on_gcode_received(void *);
+    void on_gcode_execute(void *);
+    void on_halt(void *argument);
     void on_get_public_data(void *argument);
     void on_set_public_data(void *argument);
     void add_tool(Tool *tool_to_add);
@@ -28,7 +30,8 @@ public:
 private:
     vector<Tool *> tools;
 
-    int active_tool;
+    int active_tool;                    // the tool the gcodes being planned use
+    int enabled_tool;                   // the tool the moves being executed use
     uint16_t current_tool_name;
 };
 
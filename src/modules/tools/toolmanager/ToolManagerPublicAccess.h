@@ -6,6 +6,7 @@
 #define current_tool_name_checksum        CHECKSUM("current_tool_name")
 #define is_active_tool_checksum           CHECKSUM("is_active_tool")
 #define get_active_tool_checksum          CHECKSUM("get_active_tool")
+#define get_tool_name_checksum            CHECKSUM("get_tool_name")
 
 #endif // __TOOLMANAGERPUBLICACCESS_H
 
@@ -30,6 +30,8 @@
                 G31	Heuristic Calibration (parallel simulated annealing)
                 G32	Iterative Calibration (only calibrates endstops & delta radius)
                 M667	Virtual shimming and depth correction params/enable/disable
+                M668	Print the last depth map and the kinematics for calibrating on a host
+                M669	Set all kinematics at once (what a host calibration sends back)
 
     Files:	/sd/dm_surface_transform (contains depth map for use with depth map Z correction)
 
@@ -673,6 +675,13 @@ bool ComprehensiveDeltaStrategy::handleGcode(Gcode *gcode) {
                 handle_shimming_and_depth_correction(gcode);
                 break;
 
+            // Calibration data for solving on a host, and the solved kinematics coming back
+            case 668:
+                return handle_export_calibration_data(gcode);
+
+            case 669:
+                return handle_import_kinematics(gcode);
+
             // Save depth map (CSV)
             case 500:
             case 503:
@@ -871,6 +880,16 @@ if(gcode->has_letter('S')) {
             set_geom_after_each_caltype = false;
         }
 
+        // Solver
+        _cds_solver_t solver = SOLVER_ANNEALING;
+        if(gcode->has_letter('B')) {
+            switch((int)gcode->get_value('B')) {
+                case 0: solver = SOLVER_ANNEALING; break;
+                case 1: solver = SOLVER_LEAST_SQUARES; break;
+                default: __printf("B's arg has to be 0 or 1, so ignoring.\n");
+            }
+        }
+
         push_prefix("HC");
         if(gcode->get_num_args() > 0) {
 
@@ -889,7 +908,7 @@ if(gcode->has_letter('S')) {
             }
 
             // OK! Run the simulated annealing algorithm.
-            heuristic_calibration(annealing_tries, max_temp, binsearch_width, simulate_only, keep_settings, zero_all_offsets, overrun_divisor, set_geom_after_each_caltype);
+            heuristic_calibration(annealing_tries, max_temp, binsearch_width, simulate_only, keep_settings, zero_all_offsets, overrun_divisor, set_geom_after_each_caltype, solver);
         
         } else {
 
@@ -1034,6 +1053,7 @@ void __attribute__ ((noinline)) ComprehensiveDeltaStrategy::print_g31_help() {
     _printf(" W: Annealing: Overrun divisor (2)\n");
     _printf(" X: Annealing: Eval metric (1=mean, 2=RMS, default 1)\n");
     _printf(" Y: Zero all individual radius, angle, and arm length offsets\n");
+    _printf(" B: Solver (0=simulated annealing, 1=least squares, default 0)\n");
     flush();
 
 }
@@ -1166,10 +1186,105 @@ bool ComprehensiveDeltaStrategy::handle_shimming_and_depth_correction(Gcode *gco
 
 }
 
+// M668
+// Prints the depths of the last depth map (G31 Z) with the kinematics they were probed with, so the calibration can be
+// solved on a host while the printer gets on with something else. The kinematics line is the M669 to put them back.
+// ;CDS1 N<active points> S<virtual shimming enabled>
+// M669 L<arm length> R<delta radius> X Y Z<trim> A B C<radius offsets> D E F<angle offsets> I J K<virtual shimming>
+// ;P<point> X<x> Y<y> Z<depth relative to center> A<absolute depth>   (for each active point)
+// ;CDS1 end
+bool ComprehensiveDeltaStrategy::handle_export_calibration_data(Gcode *gcode) {
+
+    if(geom_dirty) {
+        __printf("[CX] No depth map for the current kinematics - do G31 Z first.\n");
+        return true;
+    }
+
+    KinematicSettings settings;
+    get_kinematics(&settings);
+
+    int n = 0;
+    for(int i = 0; i < DM_GRID_ELEMENTS; i++) {
+        if(active_point[i] == TP_ACTIVE) n++;
+    }
+
+    gcode->stream->printf(";CDS1 N%d S%d\n", n, (int)surface_transform->plane_enabled);
+    gcode->stream->printf("M669 L%1.5f R%1.5f X%1.5f Y%1.5f Z%1.5f A%1.5f B%1.5f C%1.5f D%1.5f E%1.5f F%1.5f I%1.5f J%1.5f K%1.5f\n",
+        settings.arm_length, settings.delta_radius,
+        settings.trim[X], settings.trim[Y], settings.trim[Z],
+        settings.tower_radius[X], settings.tower_radius[Y], settings.tower_radius[Z],
+        settings.tower_angle[X], settings.tower_angle[Y], settings.tower_angle[Z],
+        settings.virtual_shimming[X], settings.virtual_shimming[Y], settings.virtual_shimming[Z]);
+
+    for(int i = 0; i < DM_GRID_ELEMENTS; i++) {
+        if(active_point[i] == TP_ACTIVE) {
+            gcode->stream->printf(";P%d X%1.4f Y%1.4f Z%1.5f A%1.5f\n", i, test_point[i][X], test_point[i][Y], depth_map[i].rel, depth_map[i].abs);
+        }
+    }
+    gcode->stream->printf(";CDS1 end\n");
+
+    return true;
+
+}
+
+// M669
+// Sets the kinematics in one go, letters as printed by M668 and any that are left out keep their current value.
+// Nothing is changed unless all of it can be, so a bad solution never leaves the printer with half of it.
+bool ComprehensiveDeltaStrategy::handle_import_kinematics(Gcode *gcode) {
+
+    KinematicSettings old_set, new_set;
+    get_kinematics(&old_set);
+    old_set.copy_to(&new_set);
+
+    const char letters[] = "XYZABCDEFIJK";
+    float *values[] = {
+        &new_set.trim[X], &new_set.trim[Y], &new_set.trim[Z],
+        &new_set.tower_radius[X], &new_set.tower_radius[Y], &new_set.tower_radius[Z],
+        &new_set.tower_angle[X], &new_set.tower_angle[Y], &new_set.tower_angle[Z],
+        &new_set.virtual_shimming[X], &new_set.virtual_shimming[Y], &new_set.virtual_shimming[Z]
+    };
+
+    if(gcode->has_letter('L')) new_set.arm_length = gcode->get_value('L');
+    if(gcode->has_letter('R')) new_set.delta_radius = gcode->get_value('R');
+    for(int i = 0; i < 12; i++) {
+        if(gcode->has_letter(letters[i])) *values[i] = gcode->get_value(letters[i]);
+    }
+
+    // Check everything before touching anything
+    bool valid = !isnan(new_set.arm_length) && !isinf(new_set.arm_length) && !isnan(new_set.delta_radius) && new_set.delta_radius > 0 && new_set.arm_length > new_set.delta_radius;
+    for(int i = 0; i < 12; i++) {
+        if(isnan(*values[i]) || isinf(*values[i])) valid = false;
+    }
+    if(!valid) {
+        __printf("[CI] Kinematics not changed - the values don't make a delta printer.\n");
+        return true;
+    }
+
+    // Moves already queued were planned with the old kinematics
+    THEKERNEL->conveyor->wait_for_empty_queue();
+
+    bool ok =
+        set_delta_radius(new_set.delta_radius, false) &&
+        set_arm_length(new_set.arm_length, false) &&
+        set_trim(new_set.trim[X], new_set.trim[Y], new_set.trim[Z]) &&
+        set_tower_radius_offsets(new_set.tower_radius[X], new_set.tower_radius[Y], new_set.tower_radius[Z], false) &&
+        set_tower_angle_offsets(new_set.tower_angle[X], new_set.tower_angle[Y], new_set.tower_angle[Z], false) &&
+        set_virtual_shimming(new_set.virtual_shimming[X], new_set.virtual_shimming[Y], new_set.virtual_shimming[Z], false);
+
+    if(!ok) {
+        __printf("[CI] Kinematics not changed - the arm solution or endstops refused them.\n");
+        set_kinematics(&old_set, false);
+    }
+    post_adjust_kinematics();
+
+    return true;
+
+}
+
 
 // Main heuristic calibration routine
 // This expects caltype.*.active to be set true/false beforehand
-bool ComprehensiveDeltaStrategy::heuristic_calibration(int annealing_tries, float max_temp, float binsearch_width, bool simulate_only, bool keep_settings, bool zero_all_offsets, float overrun_divisor, bool set_geom_after_each_caltype) {
+bool ComprehensiveDeltaStrategy::heuristic_calibration(int annealing_tries, float max_temp, float binsearch_width, bool simulate_only, bool keep_settings, bool zero_all_offsets, float overrun_divisor, bool set_geom_after_each_caltype, _cds_solver_t solver) {
 
 
     /*
@@ -1275,6 +1390,7 @@ print_kinematics(cur_set);
     _printf("      Overrun divisor (W): %1.3f\n", overrun_divisor);
     _printf("          Eval metric (X): %s\n", (eval_metric_type == EVAL_METRIC_MEAN) ? "Mean" : "RMS");
     _printf("     Zero all offsets (Y): %s\n", zero_all_offsets ? _STR_TRUE_ : _STR_FALSE_);
+    _printf("               Solver (B): %s\n", (solver == SOLVER_LEAST_SQUARES) ? "Least squares" : "Simulated annealing");
     newline();
 
 
@@ -1496,11 +1612,25 @@ print_kinematics(cur_set);
         }
         
 
+        // The least squares solver takes the place of the annealing loop and leaves its result in best_set
+        if(solver == SOLVER_LEAST_SQUARES) {
+            if(!least_squares_calibration(annealing_tries, global_target)) {
+                if(THEKERNEL->is_halted()) {
+                    _printf("Aborting calibration because printer has been halted.\n");
+                    pop_prefix();
+                    return false;
+                }
+                _printf("Least squares solver unavailable, falling back to simulated annealing.\n");
+                solver = SOLVER_ANNEALING;
+            }
+        }
+
+
         // ************************************
         // * Simulated Annealing - Inner Loop *
         // ************************************
 
-        for(annealing_try=0; annealing_try<annealing_tries; annealing_try++) {
+        for(annealing_try=0; solver == SOLVER_ANNEALING && annealing_try<annealing_tries; annealing_try++) {
 
             // Let the kernel handle idle tasks, and let us check for e-stop
             THEKERNEL->call_event(ON_IDLE);
@@ -1861,6 +1991,265 @@ print_kinematics(cur_set);
 }
 
 
+// Solve the linear system in the augmented n x n+1 matrix a by Gaussian elimination with partial pivoting
+static bool solve_linear_system(float a[][LS_N_PARAMS + 1], int n, float x[]) {
+
+    for(int c = 0; c < n; c++) {
+        int pivot = c;
+        for(int r = c + 1; r < n; r++) {
+            if(fabsf(a[r][c]) > fabsf(a[pivot][c])) pivot = r;
+        }
+        if(fabsf(a[pivot][c]) < 1e-12F) return false;
+        if(pivot != c) {
+            for(int k = c; k <= n; k++) std::swap(a[c][k], a[pivot][k]);
+        }
+        for(int r = c + 1; r < n; r++) {
+            float f = a[r][c] / a[c][c];
+            for(int k = c; k <= n; k++) a[r][k] -= f * a[c][k];
+        }
+    }
+
+    for(int r = n - 1; r >= 0; r--) {
+        float sum = a[r][n];
+        for(int k = r + 1; k < n; k++) sum -= a[r][k] * x[k];
+        x[r] = sum / a[r][r];
+    }
+    return true;
+
+}
+
+
+// Fit the active caltypes to the simulated carriage positions in test_axis[] with Levenberg-Marquardt.
+// It minimizes the same depths simulate_FK_and_get_energy() looks at, using the derivatives the arm solution works
+// out for its geometry, so it only needs a handful of iterations where the annealing needs hundreds.
+// Returns false if it could not run, the result is left in best_set and cur_set otherwise.
+bool ComprehensiveDeltaStrategy::least_squares_calibration(int max_iterations, float target) {
+
+    // Fit the same settings the active caltypes would anneal
+    int params[LS_N_PARAMS];
+    int n = 0;
+    for(int k=0; k<3; k++) {
+        if(caltype.endstop.active) params[n++] = LS_TRIM + k;
+    }
+    if(caltype.delta_radius.active) {
+        params[n++] = LS_DELTA_RADIUS;
+        for(int k=0; k<3; k++) params[n++] = LS_TOWER_RADIUS + k;
+    }
+    if(caltype.arm_length.active) {
+        params[n++] = LS_ARM_LENGTH;
+    }
+    for(int k=0; k<3; k++) {
+        if(caltype.tower_angle.active) params[n++] = LS_TOWER_ANGLE + k;
+    }
+    if(caltype.virtual_shimming.active) {
+        _printf("Virtual shimming is not fitted by the least squares solver, keeping it as it is.\n");
+    }
+    if(n == 0) {
+        return false;
+    }
+
+    float JtJ[LS_N_PARAMS][LS_N_PARAMS];
+    float Jtr[LS_N_PARAMS];
+    float a[LS_N_PARAMS][LS_N_PARAMS + 1];
+    float delta[LS_N_PARAMS];
+
+    float sse = least_squares_normal_equations(cur_set, params, n, JtJ, Jtr);
+    if(isnan(sse)) {
+        set_test_geometry(cur_set);
+        return false;
+    }
+
+    KinematicSettings *trial = new KinematicSettings();
+    float lambda = 0.001;
+    int iteration;
+
+    for(iteration = 0; iteration < max_iterations; iteration++) {
+
+        THEKERNEL->call_event(ON_IDLE);
+        if(THEKERNEL->is_halted()) {
+            set_test_geometry(cur_set);
+            delete trial;
+            return false;
+        }
+        blink_LED(1);
+
+        // Raise the damping until the step lowers the sum of the squared depths
+        bool improved = false;
+        float trial_sse = sse;
+        for(int tries = 0; tries < 10 && !improved; tries++) {
+            for(int i = 0; i < n; i++) {
+                for(int k = 0; k < n; k++) {
+                    a[i][k] = JtJ[i][k];
+                }
+                a[i][i] += lambda * (JtJ[i][i] + 1e-6F);
+                a[i][n] = -Jtr[i];
+            }
+            if(solve_linear_system(a, n, delta)) {
+                cur_set->copy_to(trial);
+                for(int i = 0; i < n; i++) {
+                    least_squares_value(trial, params[i]) += delta[i];
+                }
+                trial_sse = least_squares_normal_equations(trial, params, n, nullptr, nullptr);
+                improved = trial_sse < sse;
+            }
+            if(!improved) {
+                lambda *= 10;
+            }
+        }
+
+        // No step makes it any better, so we are there
+        if(!improved) {
+            break;
+        }
+
+        lambda = std::max(lambda / 10, 1e-7F);
+        trial->copy_to(cur_set);
+        float gain = sse - trial_sse;
+        sse = least_squares_normal_equations(cur_set, params, n, JtJ, Jtr);
+
+        float energy = simulate_FK_and_get_energy(test_axis, cur_set->trim, cur_cartesian);
+        _printf("Iteration %d of %d, energy=%1.3f (want <= %1.3f)\n", iteration + 1, max_iterations, energy, target);
+        flush();
+
+        if(energy <= target || gain < 1e-8F) {
+            break;
+        }
+
+    }
+    delete trial;
+
+    // Only the sum of the delta radius and each tower's offset matters, keep the offsets centered on zero
+    if(caltype.delta_radius.active) {
+        float mean = (cur_set->tower_radius[X] + cur_set->tower_radius[Y] + cur_set->tower_radius[Z]) / 3;
+        for(int k=0; k<3; k++) {
+            cur_set->tower_radius[k] -= mean;
+        }
+        cur_set->delta_radius += mean;
+    }
+
+    set_test_geometry(cur_set);
+    best_set_energy = simulate_FK_and_get_energy(test_axis, cur_set->trim, cur_cartesian);
+    cur_set->copy_to(best_set);
+    _printf("Least squares solver finished after %d iterations.\n", std::min(iteration + 1, max_iterations));
+
+    return true;
+
+}
+
+
+// Sum of the squared depths the settings give for the simulated carriage positions, and the normal equations of the
+// least squares problem for the given parameters if JtJ isn't nullptr. Returns NaN if there are no derivatives.
+float ComprehensiveDeltaStrategy::least_squares_normal_equations(KinematicSettings *settings, const int params[], int n, float JtJ[][LS_N_PARAMS], float Jtr[]) {
+
+    // The column of the arm solution's jacobian for each parameter
+    static const uint8_t column[LS_N_PARAMS] = {
+        BaseSolution::GP_ACTUATOR_1, BaseSolution::GP_ACTUATOR_2, BaseSolution::GP_ACTUATOR_3,
+        BaseSolution::GP_ARM_RADIUS,
+        BaseSolution::GP_TOWER_OFFSET_1, BaseSolution::GP_TOWER_OFFSET_2, BaseSolution::GP_TOWER_OFFSET_3,
+        BaseSolution::GP_ARM_LENGTH,
+        BaseSolution::GP_TOWER_ANGLE_1, BaseSolution::GP_TOWER_ANGLE_2, BaseSolution::GP_TOWER_ANGLE_3
+    };
+
+    set_test_geometry(settings);
+
+    if(JtJ != nullptr) {
+        for(int i = 0; i < n; i++) {
+            Jtr[i] = 0;
+            for(int k = 0; k < n; k++) {
+                JtJ[i][k] = 0;
+            }
+        }
+    }
+
+    float sse = 0;
+    float jacobian[3][BaseSolution::GP_COUNT];
+    float row[LS_N_PARAMS];
+
+    for(int j = 0; j < DM_GRID_ELEMENTS; j++) {
+
+        if(active_point[j] != TP_ACTIVE) continue;
+
+        ActuatorCoordinates coords = { test_axis[j][X] - settings->trim[X], test_axis[j][Y] - settings->trim[Y], test_axis[j][Z] - settings->trim[Z] };
+        float pos[3];
+        THEKERNEL->robot->arm_solution->actuator_to_cartesian(coords, pos);
+
+        // Same depth as simulate_FK_and_get_energy(), the shimming plane tilt adds the X and Y movement into it
+        float r = pos[Z];
+        float slope_x = 0, slope_y = 0;
+        if(surface_transform->plane_enabled) {
+            r -= ((-surface_transform->normal[X] * pos[X]) - (surface_transform->normal[Y] * pos[Y]) - surface_transform->d) / surface_transform->normal[Z];
+            slope_x = surface_transform->normal[X] / surface_transform->normal[Z];
+            slope_y = surface_transform->normal[Y] / surface_transform->normal[Z];
+        }
+        sse += r * r;
+
+        if(JtJ == nullptr) continue;
+
+        if(!THEKERNEL->robot->arm_solution->get_geometry_jacobian(coords, pos, jacobian)) {
+            return NAN;
+        }
+
+        for(int i = 0; i < n; i++) {
+            int c = column[params[i]];
+            row[i] = jacobian[Z][c] + (slope_x * jacobian[X][c]) + (slope_y * jacobian[Y][c]);
+            // Trim is taken off the carriage position
+            if(params[i] < LS_DELTA_RADIUS) {
+                row[i] = -row[i];
+            }
+        }
+
+        for(int i = 0; i < n; i++) {
+            Jtr[i] += row[i] * r;
+            for(int k = 0; k <= i; k++) {
+                JtJ[i][k] += row[i] * row[k];
+            }
+        }
+
+    }
+
+    if(JtJ != nullptr) {
+        for(int i = 0; i < n; i++) {
+            for(int k = i + 1; k < n; k++) {
+                JtJ[i][k] = JtJ[k][i];
+            }
+        }
+    }
+
+    return sse;
+
+}
+
+
+// The setting each least squares parameter stands for
+float &ComprehensiveDeltaStrategy::least_squares_value(KinematicSettings *settings, int param) {
+
+    if(param < LS_DELTA_RADIUS) return settings->trim[param - LS_TRIM];
+    if(param == LS_DELTA_RADIUS) return settings->delta_radius;
+    if(param < LS_ARM_LENGTH) return settings->tower_radius[param - LS_TOWER_RADIUS];
+    if(param == LS_ARM_LENGTH) return settings->arm_length;
+    return settings->tower_angle[param - LS_TOWER_ANGLE];
+
+}
+
+
+// Give the arm solution all of the geometry in settings at once, trim and shimming are left to the caller
+void ComprehensiveDeltaStrategy::set_test_geometry(KinematicSettings *settings) {
+
+    geom_dirty = true;
+
+    options['L'] = settings->arm_length;
+    options['R'] = settings->delta_radius;
+    options['A'] = settings->tower_radius[X];
+    options['B'] = settings->tower_radius[Y];
+    options['C'] = settings->tower_radius[Z];
+    options['D'] = settings->tower_angle[X];
+    options['E'] = settings->tower_angle[Y];
+    options['F'] = settings->tower_angle[Z];
+    THEKERNEL->robot->arm_solution->set_optional(options);
+
+}
+
+
 // Find the most optimal configuration for a test function (e.g. set_delta_radius())
 // (float version)
 float ComprehensiveDeltaStrategy::find_optimal_config(bool (ComprehensiveDeltaStrategy::*test_function)(float, bool), float value, float temp, float min, float max, float binsearch_width, float **cartesian, float target) {
@@ -1876,16 +2265,27 @@ float ComprehensiveDeltaStrategy::find_optimal_config(bool (ComprehensiveDeltaSt
 
 //_printf("find_optimal_config after clipping: min=%1.3f, max=%1.3f\n", min, max);
 
+    // Only the end that moved is simulated again, and only until it is clearly worse than the other end
+    bool min_valid = false, max_valid = false, at_max = false;
+
     // Find the direction of the most optimal configuration using a binary search
     for(j=0; j<250; j++) {
 
         // Test energy at min & max
 
-        ((this)->*test_function)(min, true);
-        energy_min = simulate_FK_and_get_energy(test_axis, cur_set->trim, cartesian);
+        if(!min_valid) {
+            ((this)->*test_function)(min, true);
+            energy_min = simulate_FK_and_get_energy(test_axis, cur_set->trim, cartesian, max_valid ? energy_max : INFINITY);
+            min_valid = true;
+            at_max = false;
+        }
 
-        ((this)->*test_function)(max, true);
-        energy_max = simulate_FK_and_get_energy(test_axis, cur_set->trim, cartesian);
+        if(!max_valid) {
+            ((this)->*test_function)(max, true);
+            energy_max = simulate_FK_and_get_energy(test_axis, cur_set->trim, cartesian, energy_min);
+            max_valid = true;
+            at_max = true;
+        }
 
         // Who won?
 //_printf("Check: val=%1.3f temp=%1.3f min=%1.3f max=%1.3f\n", value, temp, min, max);
@@ -1896,14 +2296,24 @@ float ComprehensiveDeltaStrategy::find_optimal_config(bool (ComprehensiveDeltaSt
         if(energy_min < energy_max) {
 //            max -= ((max - min) * binsearch_width);
             max -= binsearch_width;
+            max_valid = false;
         }
         if(energy_min > energy_max) {
 //            min += ((max - min) * binsearch_width);
             min += binsearch_width;
+            min_valid = false;
         }
+
+        // A tie never moves either end
+        if(min_valid && max_valid) break;
     
     }
 
+    // Leave the test value at max like a full search would
+    if(!at_max) {
+        ((this)->*test_function)(max, true);
+    }
+
 //_printf("Iterations: %d\n", j);
     return (min + max) / 2.0f;
 
@@ -1922,17 +2332,28 @@ float ComprehensiveDeltaStrategy::find_optimal_config(bool (ComprehensiveDeltaSt
     if(min < save_val - temp) min = save_val - temp;
     if(max > save_val + temp) max = save_val + temp;
 
+    // Only the end that moved is simulated again, and only until it is clearly worse than the other end
+    bool min_valid = false, max_valid = false, at_max = false;
+
     // Find the direction of the most optimal configuration using a binary search
     for(j=0; j<250; j++) {
 
         // Test energy at min & max
-        values[value_idx] = min;
-        ((this)->*test_function)(values[X], values[Y], values[Z], true);
-        energy_min = simulate_FK_and_get_energy(test_axis, cur_set->trim, cartesian);
+        if(!min_valid) {
+            values[value_idx] = min;
+            ((this)->*test_function)(values[X], values[Y], values[Z], true);
+            energy_min = simulate_FK_and_get_energy(test_axis, cur_set->trim, cartesian, max_valid ? energy_max : INFINITY);
+            min_valid = true;
+            at_max = false;
+        }
 
-        values[value_idx] = max;
-        ((this)->*test_function)(values[X], values[Y], values[Z], true);
-        energy_max = simulate_FK_and_get_energy(test_axis, cur_set->trim, cartesian);
+        if(!max_valid) {
+            values[value_idx] = max;
+            ((this)->*test_function)(values[X], values[Y], values[Z], true);
+            energy_max = simulate_FK_and_get_energy(test_axis, cur_set->trim, cartesian, energy_min);
+            max_valid = true;
+            at_max = true;
+        }
 
         // Who won?
 //_printf("Check: val=%1.3f temp=%1.3f min=%1.3f max=%1.3f\n", values[value_idx], temp, min, max);
@@ -1943,14 +2364,25 @@ float ComprehensiveDeltaStrategy::find_optimal_config(bool (ComprehensiveDeltaSt
         if(energy_min < energy_max) {
 //            max -= ((max - min) * binsearch_width);
             max -= binsearch_width;
+            max_valid = false;
         }
         if(energy_min > energy_max) {
 //            min += ((max - min) * binsearch_width);
             min += binsearch_width;
+            min_valid = false;
         }
+
+        // A tie never moves either end
+        if(min_valid && max_valid) break;
     
     }
 
+    // Leave the test value at max like a full search would
+    if(!at_max) {
+        values[value_idx] = max;
+        ((this)->*test_function)(values[X], values[Y], values[Z], true);
+    }
+
 //_printf("Iterations: %d\n", j);
     values[value_idx] = save_val;
     return (min + max) / 2.0f;
@@ -2002,7 +2434,12 @@ void ComprehensiveDeltaStrategy::move_randomly_towards(float &value, float best,
 // test_axis[] (class member) will contain the generated axis positions
 void ComprehensiveDeltaStrategy::simulate_IK(float **cartesian, float trim[3]) {
 
-    float pos[3];
+    // active points are sent to the arm solution in small batches
+    const int batch_size = 8;
+    float pos[batch_size][3];
+    ActuatorCoordinates coords[batch_size];
+    int index[batch_size];
+    int n = 0;
 
     for(int j = 0; j < DM_GRID_ELEMENTS; j++) {
     
@@ -2014,27 +2451,16 @@ void ComprehensiveDeltaStrategy::simulate_IK(float **cartesian, float trim[3]) {
             // Current cartesian coordinates of the depth map
             cartesian[j][Z] = depth_map[j].rel;
         
-            pos[X] = cartesian[j][X];
-            pos[Y] = cartesian[j][Y];
-            pos[Z] = cartesian[j][Z];
+            pos[n][X] = cartesian[j][X];
+            pos[n][Y] = cartesian[j][Y];
+            pos[n][Z] = cartesian[j][Z];
             
             // Adjust Cartesian positions for surface transform plane (virtual shimming)
             if(surface_transform->plane_enabled) {
-                pos[Z] += ((-surface_transform->normal[X] * pos[X]) - (surface_transform->normal[Y] * pos[Y]) - surface_transform->d) / surface_transform->normal[Z];
+                pos[n][Z] += ((-surface_transform->normal[X] * pos[n][X]) - (surface_transform->normal[Y] * pos[n][Y]) - surface_transform->d) / surface_transform->normal[Z];
             }
-            
-            // Query the robot: Where do the axes have to be for the effector to be at these coordinates?
-            //THEKERNEL->robot->arm_solution->cartesian_to_actuator(pos, test_axis[j]);
-            ActuatorCoordinates coords = { test_axis[j][X], test_axis[j][Y], test_axis[j][Z] };
-            THEKERNEL->robot->arm_solution->cartesian_to_actuator(pos, coords);
-            test_axis[j][X] = coords[X];
-            test_axis[j][Y] = coords[Y];
-            test_axis[j][Z] = coords[Z];
-        
-            // Adjust axis positions to simulate the effects of trim
-            test_axis[j][X] += trim[X];
-            test_axis[j][Y] += trim[Y];
-            test_axis[j][Z] += trim[Z];
+
+            index[n++] = j;
         
         } else {
         
@@ -2044,6 +2470,21 @@ void ComprehensiveDeltaStrategy::simulate_IK(float **cartesian, float trim[3]) {
             test_axis[j][Z] = 0;
         
         }
+
+        if(n == batch_size || (n > 0 && j == DM_GRID_ELEMENTS - 1)) {
+
+            // Query the robot: Where do the axes have to be for the effector to be at these coordinates?
+            THEKERNEL->robot->arm_solution->cartesian_to_actuator_batch(pos, coords, n);
+
+            for(int i = 0; i < n; i++) {
+                // Adjust axis positions to simulate the effects of trim
+                test_axis[index[i]][X] = coords[i][X] + trim[X];
+                test_axis[index[i]][Y] = coords[i][Y] + trim[Y];
+                test_axis[index[i]][Z] = coords[i][Z] + trim[Z];
+            }
+            n = 0;
+
+        }
         
     } // for j
 
@@ -2052,11 +2493,23 @@ void ComprehensiveDeltaStrategy::simulate_IK(float **cartesian, float trim[3]) {
 
 // Simulate forward (actuator->cartesian) kinematics (returns the "energy" of the end result)
 // The resulting cartesian coordinates are stored in cartesian[][]
+// If the energy is going to be over bound it stops early and returns something over bound, cartesian[][] is then incomplete
 //float ComprehensiveDeltaStrategy::simulate_FK_and_get_energy(float axis_position[DM_GRID_ELEMENTS][3], float trim[3], float cartesian[DM_GRID_ELEMENTS][3]) {
-float ComprehensiveDeltaStrategy::simulate_FK_and_get_energy(float **axis_position, float trim[3], float **cartesian) {
+float ComprehensiveDeltaStrategy::simulate_FK_and_get_energy(float **axis_position, float trim[3], float **cartesian, float bound) {
 
     float trimmed[3];
 
+    // calc_energy() ends up with the RMS whichever metric is set, so once the squares of the points done so far add up
+    // to more than the bound's the rest can only make it worse (the margin keeps rounding from deciding it)
+    int n_active = 0;
+    float sum_squared = 0, limit = INFINITY;
+    if(!isinf(bound)) {
+        for(int j = 0; j < DM_GRID_ELEMENTS; j++) {
+            if(active_point[j] == TP_ACTIVE) n_active++;
+        }
+        limit = bound * bound * n_active * 1.0001F;
+    }
+
     for(int j = 0; j < DM_GRID_ELEMENTS; j++) {
 
         if(active_point[j] == TP_ACTIVE) {
@@ -2074,6 +2527,11 @@ float ComprehensiveDeltaStrategy::simulate_FK_and_get_energy(float **axis_positi
                 cartesian[j][Z] -= ((-surface_transform->normal[X] * cartesian[j][X]) - (surface_transform->normal[Y] * cartesian[j][Y]) - surface_transform->d) / surface_transform->normal[Z];
             }
 
+            sum_squared += cartesian[j][Z] * cartesian[j][Z];
+            if(sum_squared > limit) {
+                return sqrtf(sum_squared / n_active);
+            }
+
         }
     }
 
@@ -2291,6 +2749,7 @@ void ComprehensiveDeltaStrategy::set_adjust_function(bool on) {
     } else {
         THEKERNEL->robot->compensationTransform = nullptr;
     }
+    THEKERNEL->robot->compensation_is_z_offset = on;
 
 }
 
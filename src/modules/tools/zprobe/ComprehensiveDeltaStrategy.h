@@ -55,6 +55,22 @@ enum _cds_caltype_t {
     CT_TOWER_LEAN
 };
 
+// Solvers for the heuristic calibration (G31 B)
+enum _cds_solver_t {
+    SOLVER_ANNEALING,
+    SOLVER_LEAST_SQUARES
+};
+
+// Parameters the least squares solver can fit, the per-tower ones take three slots
+enum _cds_ls_param_t {
+    LS_TRIM = 0,
+    LS_DELTA_RADIUS = 3,
+    LS_TOWER_RADIUS = 4,
+    LS_ARM_LENGTH = 7,
+    LS_TOWER_ANGLE = 8,
+    LS_N_PARAMS = 11
+};
+
 // Evaluation metrics
 enum _cds_eval_metrics_t {
     EVAL_METRIC_MEAN,
@@ -422,18 +438,20 @@ class ComprehensiveDeltaStrategy : public LevelingStrategy {
     bool handle_depth_mapping_calibration(Gcode *gcode);        // G31 null|OPQRS|Z
     bool handle_z_correction();					// G31 A
     bool handle_shimming_and_depth_correction(Gcode *gcode);    // M667
+    bool handle_export_calibration_data(Gcode *gcode);          // M668
+    bool handle_import_kinematics(Gcode *gcode);                // M669
     void print_g31_help();
 
     // Inverse and forward kinematics simulation
     void simulate_IK(float **cartesian, float trim[3]);
-    float simulate_FK_and_get_energy(float **axis_position, float trim[3], float **cartesian);
+    float simulate_FK_and_get_energy(float **axis_position, float trim[3], float **cartesian, float bound = INFINITY);
 
     // For test points used by parallel simulated annealing and depth correction
     int find_nearest_test_point(float pos[2]);
     void init_test_points();
 
     // Parallel simulated annealing methods
-    bool heuristic_calibration(int annealing_tries, float max_temp, float binsearch_width, bool simulate_only, bool keep_settings, bool zero_all_offsets, float overrun_divisor, bool set_geom_after_each_caltype);
+    bool heuristic_calibration(int annealing_tries, float max_temp, float binsearch_width, bool simulate_only, bool keep_settings, bool zero_all_offsets, float overrun_divisor, bool set_geom_after_each_caltype, _cds_solver_t solver);
     float find_optimal_config(bool (ComprehensiveDeltaStrategy::*test_function)(float, bool), float value, float temp, float min, float max, float binsearch_width, float **cartesian, float target);
     float find_optimal_config(bool (ComprehensiveDeltaStrategy::*test_function)(float, float, float, bool), float values[3], int value_idx, float temp, float min, float max, float binsearch_width, float **cartesian, float target);
     bool set_test_trim(float x, float y, float z, bool dummy);
@@ -442,6 +460,12 @@ class ComprehensiveDeltaStrategy : public LevelingStrategy {
     float calc_energy(cds_depths_t *points);
     float calc_energy(float **cartesian);
 
+    // Least squares (Levenberg-Marquardt) solver, an alternative to the annealing that uses the same simulated carriage positions
+    bool least_squares_calibration(int max_iterations, float target);
+    float least_squares_normal_equations(KinematicSettings *settings, const int params[], int n, float JtJ[][LS_N_PARAMS], float Jtr[]);
+    float &least_squares_value(KinematicSettings *settings, int param);
+    void set_test_geometry(KinematicSettings *settings);
+
     // For depth map-based Z-correction
     void set_adjust_function(bool on);
     float get_adjust_z(float targetX, float targetY);
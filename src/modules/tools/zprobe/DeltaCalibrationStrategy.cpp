@@ -50,6 +50,16 @@ bool DeltaCalibrationStrategy::handleGcode(Gcode *gcode)
             // turn off any compensation transform as it will be invalidated anyway by this
             THEKERNEL->robot->compensationTransform= nullptr;
 
+            if(gcode->subcode == 1) {
+                // the trims and radius estimated together from one pass, then a pass to confirm them
+                if(!calibrate_delta_jointly(gcode)) {
+                    gcode->stream->printf("Calibration failed to complete\n");
+                    return true;
+                }
+                gcode->stream->printf("Calibration complete, save settings with M500\n");
+                return true;
+            }
+
             if(!gcode->has_letter('R')) {
                 if(!calibrate_delta_endstops(gcode)) {
                     gcode->stream->printf("Calibration failed to complete\n");
@@ -398,6 +408,189 @@ bool DeltaCalibrationStrategy::calibrate_delta_radius(Gcode *gcode)
     return true;
 }
 
+/*
+    probe the 7 points once, then solve for the changes to the trims and delta radius that make them all the same
+    height, from the arm solution's derivatives of the effector height at each of them. Apply them and probe again
+    to confirm, a pass that is still out solves again from there, P passes at most. R leaves the trims, E the radius
+*/
+
+// The changes to the trims and the radius, as many of them as the columns, that best level the points by least squares.
+// A trim moves the carriage, so the effector, up with it, and a larger radius in the firmware for the same commanded point
+// moves it as the radius of the real machine being smaller would. Without the trims a column for the height of them
+// all takes their place, as raising all three carriages together raises every point the same
+static bool solve_corrections(const float xy[][2], const float z[], int n, float start_z, bool trims, bool radius, float correction[4])
+{
+    BaseSolution *arm= THEKERNEL->robot->arm_solution;
+    const int m= (trims ? 3 : 1) + (radius ? 1 : 0);
+    float ata[4][5];
+    for(int r = 0; r < m; r++) {
+        for(int c = 0; c <= m; c++) ata[r][c]= 0;
+    }
+
+    float mean= 0;
+    for(int i = 0; i < n; i++) mean += z[i];
+    mean /= n;
+
+    float jacobian[3][BaseSolution::GP_COUNT];
+    for(int i = 0; i < n; i++) {
+        // where the probe touched, as the firmware has it
+        float pos[3] {xy[i][0], xy[i][1], start_z - z[i]};
+        ActuatorCoordinates a;
+        arm->cartesian_to_actuator(pos, a);
+        if(!arm->get_geometry_jacobian(a, pos, jacobian)) return false;
+
+        float row[4];
+        int k= 0;
+        if(trims) {
+            for(int t = 0; t < 3; t++) row[k++]= jacobian[2][BaseSolution::GP_ACTUATOR_1 + t];
+        } else {
+            row[k++]= 1;
+        }
+        if(radius) row[k++]= -jacobian[2][BaseSolution::GP_ARM_RADIUS];
+
+        // a point the probe went further down to is to be raised by as much
+        float rhs= mean - z[i];
+        for(int r = 0; r < m; r++) {
+            for(int c = 0; c < m; c++) ata[r][c] += row[r] * row[c];
+            ata[r][m] += row[r] * rhs;
+        }
+    }
+
+    // gaussian elimination with partial pivoting
+    for(int c = 0; c < m; c++) {
+        int p= c;
+        for(int r = c + 1; r < m; r++) {
+            if(fabsf(ata[r][c]) > fabsf(ata[p][c])) p= r;
+        }
+        if(fabsf(ata[p][c]) < 1e-6F) return false;
+        for(int k = 0; k <= m; k++) std::swap(ata[c][k], ata[p][k]);
+        for(int r = c + 1; r < m; r++) {
+            float f= ata[r][c] / ata[c][c];
+            for(int k = c; k <= m; k++) ata[r][k] -= f * ata[c][k];
+        }
+    }
+    float x[4];
+    for(int r = m - 1; r >= 0; r--) {
+        float s= ata[r][m];
+        for(int k = r + 1; k < m; k++) s -= ata[r][k] * x[k];
+        x[r]= s / ata[r][r];
+    }
+
+    int k= 0;
+    for(int t = 0; t < 3; t++) correction[t]= trims ? x[k++] : 0;
+    if(!trims) k++;
+    correction[3]= radius ? x[k] : 0;
+    return true;
+}
+
+bool DeltaCalibrationStrategy::calibrate_delta_jointly(Gcode *gcode)
+{
+    float target = 0.03F;
+    if(gcode->has_letter('I')) target = gcode->get_value('I'); // override default target
+    if(gcode->has_letter('J')) this->probe_radius = gcode->get_value('J'); // override default probe radius
+    int passes = gcode->has_letter('P') ? gcode->get_value('P') : 3;
+    if(passes < 2) passes = 2;
+    bool trims = !gcode->has_letter('R');
+    bool radius = !gcode->has_letter('E');
+
+    gcode->stream->printf("Calibrating %s%s%s: target %fmm, radius %fmm\n", trims ? "endstops" : "", trims && radius ? " and " : "",
+                          radius ? "delta radius" : "", target, this->probe_radius);
+
+    float trim[3];
+    if(!get_trim(trim[0], trim[1], trim[2])) {
+        gcode->stream->printf("Could not get current trim, are endstops enabled?\n");
+        return false;
+    }
+    float delta_radius = 0.0F;
+    BaseSolution::arm_options_t options;
+    if(THEKERNEL->robot->arm_solution->get_optional(options)) {
+        delta_radius = options['R'];
+    }
+    if(delta_radius == 0.0F) {
+        gcode->stream->printf("This appears to not be a delta arm solution\n");
+        return false;
+    }
+    options.clear();
+
+    float bedht= findBed();
+    if(isnan(bedht)) return false;
+    gcode->stream->printf("initial Bed ht is %f mm\n", bedht);
+
+    // check probe ht
+    int s;
+    if(!zprobe->doProbeAt(s, 0, 0)) return false;
+    float dz = zprobe->getProbeHeight() - zprobe->zsteps_to_mm(s);
+    gcode->stream->printf("center probe: %1.4f\n", dz);
+    if(fabsf(dz) > target) {
+         gcode->stream->printf("Probe was not repeatable to %f mm, (%f)\n", target, dz);
+         return false;
+    }
+
+    float t1x, t1y, t2x, t2y, t3x, t3y;
+    std::tie(t1x, t1y, t2x, t2y, t3x, t3y) = getCoordinates(this->probe_radius);
+    const float pp[][2] {{t1x, t1y}, {t2x, t2y}, {t3x, t3y}, {0, 0}, {-t1x, -t1y}, {-t2x, -t2y}, {-t3x, -t3y}};
+    const int n = sizeof(pp) / sizeof(pp[0]);
+
+    bool good= false;
+    for (int pass = 1; pass <= passes; ++pass) {
+        float start_z;
+        std::tie(std::ignore, std::ignore, start_z)= THEKERNEL->robot->get_axis_position();
+
+        float z[n];
+        for(int i = 0; i < n; i++) {
+            if(!zprobe->doProbeAt(s, pp[i][0], pp[i][1])) return false;
+            z[i] = zprobe->zsteps_to_mm(s);
+            gcode->stream->printf("P%d-%d X:%1.3f Y:%1.3f Z:%1.4f C:%d\n", i, pass, pp[i][0], pp[i][1], z[i], s);
+        }
+        auto mm = std::minmax_element(z, z + n);
+        float spread = *mm.second - *mm.first;
+        gcode->stream->printf("pass %d: delta %1.4f\n", pass, spread);
+        if(spread <= target) {
+            good= true;
+            break;
+        }
+        if(pass == passes) break;
+
+        float c[4];
+        if(!solve_corrections(pp, z, n, start_z, trims, radius, c)) {
+            gcode->stream->printf("The probed points do not give a solution\n");
+            return false;
+        }
+
+        float shift = 0;
+        if(trims) {
+            // kept negative, as the carriages can only stop short of the endstops
+            float most = std::max({trim[0] + c[0], trim[1] + c[1], trim[2] + c[2]});
+            for(int t = 0; t < 3; t++) {
+                float was = trim[t];
+                trim[t] += c[t] - most;
+                shift += (trim[t] - was) / 3;
+            }
+            if(!set_trim(trim[0], trim[1], trim[2], gcode->stream)) return false;
+        }
+        if(radius) {
+            delta_radius += c[3];
+            options['R'] = delta_radius;
+            THEKERNEL->robot->arm_solution->set_optional(options);
+            gcode->stream->printf("Setting delta radius to: %1.4f\n", delta_radius);
+        }
+
+        // lower trims leave the effector lower after homing, so it stops as far above the bed as before
+        bedht += shift;
+        zprobe->home();
+        zprobe->coordinated_move(NAN, NAN, -bedht, zprobe->getFastFeedrate(), true);
+
+        // flush the output
+        THEKERNEL->call_event(ON_IDLE);
+    }
+
+    if(!good) {
+        gcode->stream->printf("WARNING: calibration did not resolve to within required parameters: %f\n", target);
+    }
+
+    return true;
+}
+
 bool DeltaCalibrationStrategy::set_trim(float x, float y, float z, StreamOutput *stream)
 {
     float t[3] {x, y, z};
@@ -20,6 +20,7 @@ private:
     bool get_trim(float& x, float& y, float& z);
     bool calibrate_delta_endstops(Gcode *gcode);
     bool calibrate_delta_radius(Gcode *gcode);
+    bool calibrate_delta_jointly(Gcode *gcode);
     bool probe_delta_points(Gcode *gcode);
     float findBed();
 
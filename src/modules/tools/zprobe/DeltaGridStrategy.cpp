@@ -40,6 +40,10 @@
     Optionally an initial_height can be set that tell the intial probe where to stop the fast decent before it probes, this should be around 5-10mm above the bed
       leveling-strategy.delta-grid.initial_height  10
 
+    The adaptive probe with G31 A1 probes the points around a cell centre that is further than this many mm from where its
+    corners put it
+      leveling-strategy.delta-grid.tolerance  0.03
+
 
     Usage
     -----
@@ -48,12 +52,17 @@
 
     G31 probes the grid and turns the compensation on, this will remain in effect until reset or M561/M370
         optional parameters {{Jn}} sets the radius for this probe, which gets saved with M375
+        {{S1}} sweeps each row with the analog probe on zprobe.scan_pin instead of probing each point, only 0,0 is touched
+        {{A1}} probes every other point and the centres between them, and only the rest of the points around a centre that is
+        more than leveling-strategy.delta-grid.tolerance off the mean of its corners, the others are interpolated
 
     M370 clears the grid and turns off compensation
     M374 Save grid to /sd/delta.grid
     M374.1 delete /sd/delta.grid
+    M374.2 export the grid as text to /sd/delta.grid.txt to look at
     M375 Load the grid from /sd/delta.grid and enable compensation
     M375.1 display the current grid
+    M375.2 time the compensation, reports how many segments can be compensated a second
     M561 clears the grid and turns off compensation
     M565 defines the probe offsets from the nozzle or tool head
 
@@ -78,6 +87,8 @@
 #include "nuts_bolts.h"
 #include "utils.h"
 #include "platform_memory.h"
+#include "us_ticker_api.h" // mbed
+#include "GridFile.h"
 
 #include <string>
 #include <algorithm>
@@ -92,15 +103,18 @@
 #define initial_height_checksum      CHECKSUM("initial_height")
 
 #define GRIDFILE "/sd/delta.grid"
+#define GRIDTEXTFILE "/sd/delta.grid.txt"
 
 DeltaGridStrategy::DeltaGridStrategy(ZProbe *zprobe) : LevelingStrategy(zprobe)
 {
     grid= nullptr;
+    cells= nullptr;
 }
 
 DeltaGridStrategy::~DeltaGridStrategy()
 {
     if(grid != nullptr) AHB0.dealloc(grid);
+    if(cells != nullptr) AHB0.dealloc(cells);
 }
 
 bool DeltaGridStrategy::handleConfig()
@@ -125,6 +139,7 @@ bool DeltaGridStrategy::handleConfig()
 
     // allocate in AHB0
     grid= (float *)AHB0.alloc(grid_size * grid_size * sizeof(float));
+    cells= (float *)AHB0.alloc((grid_size - 1) * (grid_size - 1) * 4 * sizeof(float));
 
     reset_bed_level();
 
@@ -138,35 +153,40 @@ void DeltaGridStrategy::save_grid(StreamOutput *stream)
         return;
     }
 
-    FILE *fp = fopen(GRIDFILE, "w");
-    if(fp == NULL) {
-        stream->printf("error:Failed to open grid file %s\n", GRIDFILE);
+    GridFile::header_t h;
+    h.magic= GridFile::delta_magic;
+    h.rows= h.cols= grid_size;
+    h.size_x= h.size_y= grid_radius;
+    h.z_offset= 0;
+    const char *error= GridFile::write(GRIDFILE, h, grid);
+    if(error != nullptr) {
+        stream->printf("error:%s %s\n", error, GRIDFILE);
         return;
     }
+    stream->printf("grid saved to %s\n", GRIDFILE);
+}
 
-    if(fwrite(&grid_size, sizeof(uint8_t), 1, fp) != 1) {
-        stream->printf("error:Failed to write grid size\n");
-        fclose(fp);
+// the grid as text to look at, it is not loaded from
+void DeltaGridStrategy::export_grid(StreamOutput *stream)
+{
+    if(isnan(grid[0])) {
+        stream->printf("error:No grid to export\n");
         return;
     }
 
-    if(fwrite(&grid_radius, sizeof(float), 1, fp) != 1) {
-        stream->printf("error:Failed to write grid radius\n");
-        fclose(fp);
+    FILE *fp = fopen(GRIDTEXTFILE, "w");
+    if(fp == NULL) {
+        stream->printf("error:Failed to open grid file %s\n", GRIDTEXTFILE);
         return;
     }
-
+    fprintf(fp, "size %d radius %1.4f\n", grid_size, grid_radius);
     for (int y = 0; y < grid_size; y++) {
         for (int x = 0; x < grid_size; x++) {
-            if(fwrite(&grid[x + (grid_size*y)], sizeof(float), 1, fp) != 1) {
-                stream->printf("error:Failed to write grid\n");
-                fclose(fp);
-                return;
-            }
+            fprintf(fp, "%1.4f%c", grid[x + (grid_size*y)], x == grid_size - 1 ? '\n' : ' ');
         }
     }
-    stream->printf("grid saved to %s\n", GRIDFILE);
     fclose(fp);
+    stream->printf("grid exported to %s\n", GRIDTEXTFILE);
 }
 
 bool DeltaGridStrategy::load_grid(StreamOutput *stream)
@@ -179,41 +199,47 @@ bool DeltaGridStrategy::load_grid(StreamOutput *stream)
 
     uint8_t size;
     float radius;
+    GridFile::header_t h;
+    bool binary= GridFile::read_header(fp, GridFile::delta_magic, h);
+    if(binary) {
+        size= h.rows;
+        radius= h.size_x;
 
-    if(fread(&size, sizeof(uint8_t), 1, fp) != 1) {
-        stream->printf("error:Failed to read grid size\n");
-        fclose(fp);
-        return false;
+    } else {
+        // the older file was the size, the radius and then the grid
+        if(fread(&size, sizeof(uint8_t), 1, fp) != 1 || fread(&radius, sizeof(float), 1, fp) != 1) {
+            if(stream != nullptr) stream->printf("error:Failed to read grid size and radius\n");
+            fclose(fp);
+            return false;
+        }
     }
 
-    if(size != grid_size) {
-        stream->printf("error:grid size is different read %d - config %d\n", size, grid_size);
+    if(size != grid_size || (binary && h.cols != grid_size)) {
+        if(stream != nullptr) stream->printf("error:grid size is different read %d - config %d\n", size, grid_size);
         fclose(fp);
         return false;
     }
 
-    if(fwrite(&radius, sizeof(float), 1, fp) != 1) {
-        stream->printf("error:Failed to read grid radius\n");
-        fclose(fp);
+    const char *error= nullptr;
+    if(binary) {
+        error= GridFile::read_grid(fp, h, grid);
+    } else if(fread(grid, sizeof(float), grid_size * grid_size, fp) != (size_t)(grid_size * grid_size)) {
+        error= "Failed to read grid";
+    }
+    fclose(fp);
+    if(error != nullptr) {
+        // what was read in is not a grid to use
+        reset_bed_level();
+        if(stream != nullptr) stream->printf("error:%s %s\n", error, GRIDFILE);
         return false;
     }
 
     if(radius != grid_radius) {
-        stream->printf("warning:grid radius is different read %f - config %f, overriding config\n", radius, grid_radius);
+        if(stream != nullptr) stream->printf("warning:grid radius is different read %f - config %f, overriding config\n", radius, grid_radius);
         grid_radius= radius;
     }
 
-    for (int y = 0; y < grid_size; y++) {
-        for (int x = 0; x < grid_size; x++) {
-            if(fread(&grid[x + (grid_size*y)], sizeof(float), 1, fp) != 1) {
-                if(stream != nullptr) stream->printf("error:Failed to read grid\n");
-                fclose(fp);
-                return false;
-            }
-        }
-    }
     if(stream != nullptr) stream->printf("grid loaded from %s with radius %f and size %d\n", GRIDFILE, grid_radius, grid_size);
-    fclose(fp);
     return true;
 }
 
@@ -228,24 +254,39 @@ bool DeltaGridStrategy::probe_grid(int n, float radius, StreamOutput *stream)
     if(isnan(initial_z)) return false;
 
     float d= ((radius*2) / (n - 1));
+    uint32_t t= us_ticker_read(); // mbed call
+    std::vector<float> row(n);
+    bool ok= true;
 
-    for (int c = 0; c < n; ++c) {
+    zprobe->beginProbeHops();
+    for (int c = 0; ok && c < n; ++c) {
         float y = -radius + d*c;
-        for (int r = 0; r < n; ++r) {
+        // alternate rows are probed in reverse so the probe does not travel back across the bed
+        for (int i = 0; i < n; ++i) {
+            int r= (c & 1) ? n - 1 - i : i;
             float x = -radius + d*r;
             // Avoid probing the corners (outside the round or hexagon print surface) on a delta printer.
             float distance_from_center = sqrtf(x*x + y*y);
-            float z= 0.0F;
+            row[r]= 0.0F;
             if (distance_from_center <= radius) {
                 int s;
-                if(!zprobe->doProbeAt(s, x, y)) return false;
-                z = zprobe->getProbeHeight() - zprobe->zsteps_to_mm(s);
+                if(!zprobe->doProbeAt(s, x, y)) {
+                    ok= false;
+                    break;
+                }
+                row[r] = zprobe->getProbeHeight() - zprobe->zsteps_to_mm(s);
             }
-            stream->printf("%8.4f ", z);
+        }
+        if(!ok) break;
+        for (int r = 0; r < n; ++r) {
+            stream->printf("%8.4f ", row[r]);
         }
         stream->printf("\n");
     }
-    return true;
+    zprobe->endProbeHops();
+
+    if(ok) stream->printf("probe cycle took %lu ms\n", (us_ticker_read() - t) / 1000);
+    return ok;
 }
 
 // taken from Oskars PR #713
@@ -259,7 +300,9 @@ bool DeltaGridStrategy::probe_spiral(int n, float radius, StreamOutput *stream)
 
     auto theta = [a](float length) {return sqrtf(2*length/a); };
 
+    uint32_t t= us_ticker_read(); // mbed call
     float maxz= NAN, minz= NAN;
+    zprobe->beginProbeHops();
     for (int i = 0; i < n; i++) {
         float angle = theta(i * step_length);
         float r = angle * a;
@@ -268,14 +311,19 @@ bool DeltaGridStrategy::probe_spiral(int n, float radius, StreamOutput *stream)
         float y = r * sinf(angle);
 
         int steps;
-        if (!zprobe->doProbeAt(steps, x, y)) return false;
+        if (!zprobe->doProbeAt(steps, x, y)) {
+            zprobe->endProbeHops();
+            return false;
+        }
         float z = zprobe->getProbeHeight() - zprobe->zsteps_to_mm(steps);
         stream->printf("PROBE: X%1.4f, Y%1.4f, Z%1.4f\n", x, y, z);
         if(isnan(maxz) || z > maxz) maxz= z;
         if(isnan(minz) || z < minz) minz= z;
     }
+    zprobe->endProbeHops();
 
     stream->printf("max: %1.4f, min: %1.4f, delta: %1.4f\n", maxz, minz, maxz-minz);
+    stream->printf("probe cycle took %lu ms\n", (us_ticker_read() - t) / 1000);
     return true;
 }
 
@@ -323,6 +371,8 @@ bool DeltaGridStrategy::handleGcode(Gcode *gcode)
             if(gcode->subcode == 1) {
                 remove(GRIDFILE);
                 gcode->stream->printf("%s deleted\n", GRIDFILE);
+            } else if(gcode->subcode == 2) {
+                export_grid(gcode->stream);
             } else {
                 save_grid(gcode->stream);
             }
@@ -332,6 +382,8 @@ bool DeltaGridStrategy::handleGcode(Gcode *gcode)
         } else if(gcode->m == 375) { // M375: load grid, M375.1 display grid
             if(gcode->subcode == 1) {
                 print_bed_level(gcode->stream);
+            } else if(gcode->subcode == 2) {
+                benchmark_compensation(gcode->stream);
             } else {
                 if(load_grid(gcode->stream)) setAdjustFunction(true);
             }
@@ -377,12 +429,14 @@ bool DeltaGridStrategy::handleGcode(Gcode *gcode)
 void DeltaGridStrategy::setAdjustFunction(bool on)
 {
     if(on) {
+        build_cells();
         // set the compensationTransform in robot
         THEKERNEL->robot->compensationTransform = [this](float target[3]) { doCompensation(target); };
     } else {
         // clear it
         THEKERNEL->robot->compensationTransform = nullptr;
     }
+    THEKERNEL->robot->compensation_is_z_offset = on;
 }
 
 float DeltaGridStrategy::findBed()
@@ -428,16 +482,66 @@ bool DeltaGridStrategy::doProbe(Gcode *gc)
     }
 
     gc->stream->printf("Probe start ht is %f mm, probe radius is %f mm\n", initial_z, radius);
+    uint32_t t= us_ticker_read(); // mbed call
+
+    // with S the rows are swept by the scan probe at this height, so there are no hops
+    bool scan= gc->has_letter('S') && gc->get_value('S') != 0;
+    bool adaptive= gc->has_letter('A') && gc->get_value('A') != 0;
+    if(scan && !zprobe->canScan()) {
+        gc->stream->printf("No zprobe.scan_pin to scan with, probing each point\n");
+        scan= false;
+    }
 
     // do first probe for 0,0
     int s;
-    if(!zprobe->doProbeAt(s, -X_PROBE_OFFSET_FROM_EXTRUDER, -Y_PROBE_OFFSET_FROM_EXTRUDER)) return false;
+    if(!scan) zprobe->beginProbeHops();
+    if(!zprobe->doProbeAt(s, -X_PROBE_OFFSET_FROM_EXTRUDER, -Y_PROBE_OFFSET_FROM_EXTRUDER)) {
+        zprobe->endProbeHops();
+        return false;
+    }
     float z_reference = zprobe->getProbeHeight() - zprobe->zsteps_to_mm(s); // this should be zero
     gc->stream->printf("probe at 0,0 is %f mm\n", z_reference);
 
     // probe all the points in the grid within the given radius
     for (int yCount = 0; yCount < grid_size; yCount++) {
         float yProbe = FRONT_PROBE_BED_POSITION + AUTO_BED_LEVELING_GRID_Y * yCount;
+
+        if(scan) {
+            // sweep the part of the row within the radius, alternate rows the other way
+            int xa= grid_size, xb= -1;
+            for (int xCount = 0; xCount < grid_size; xCount++) {
+                float xProbe = LEFT_PROBE_BED_POSITION + AUTO_BED_LEVELING_GRID_X * xCount;
+                if(sqrtf(xProbe * xProbe + yProbe * yProbe) > radius) continue;
+                xa= std::min(xa, xCount);
+                xb= std::max(xb, xCount);
+            }
+            if(xb < xa) continue;
+
+            int n= xb - xa + 1;
+            float x0= LEFT_PROBE_BED_POSITION + AUTO_BED_LEVELING_GRID_X * xa - X_PROBE_OFFSET_FROM_EXTRUDER;
+            float x1= LEFT_PROBE_BED_POSITION + AUTO_BED_LEVELING_GRID_X * xb - X_PROBE_OFFSET_FROM_EXTRUDER;
+            float y= yProbe - Y_PROBE_OFFSET_FROM_EXTRUDER;
+            bool reverse= (yCount % 2) == 0;
+            std::vector<float> dist(n);
+            if(!zprobe->scanLine(reverse ? x1 : x0, y, reverse ? x0 : x1, y, n, dist.data())) return false;
+            for (int i = 0; i < n; i++) {
+                int xCount= reverse ? xb - i : xa + i;
+                if(isnan(dist[i])) {
+                    gc->stream->printf("No scan samples near X%1.4f Y%1.4f, lower zprobe.scan_feedrate\n", LEFT_PROBE_BED_POSITION + AUTO_BED_LEVELING_GRID_X * xCount, yProbe);
+                    return false;
+                }
+                float measured_z = zprobe->getProbeHeight() - dist[i] - z_reference;
+                gc->stream->printf("DEBUG: X%1.4f, Y%1.4f, Z%1.4f\n", LEFT_PROBE_BED_POSITION + AUTO_BED_LEVELING_GRID_X * xCount, yProbe, measured_z);
+                grid[xCount + (grid_size * yCount)] = measured_z;
+            }
+            continue;
+        }
+
+        if(adaptive && yCount == 0 && !probe_adaptive(radius, z_reference, gc->stream)) {
+            zprobe->endProbeHops();
+            return false;
+        }
+
         int xStart, xStop, xInc;
         if (yCount % 2) {
             xStart = 0;
@@ -450,19 +554,16 @@ bool DeltaGridStrategy::doProbe(Gcode *gc)
         }
 
         for (int xCount = xStart; xCount != xStop; xCount += xInc) {
-            float xProbe = LEFT_PROBE_BED_POSITION + AUTO_BED_LEVELING_GRID_X * xCount;
-
-            // Avoid probing the corners (outside the round or hexagon print surface) on a delta printer.
-            float distance_from_center = sqrtf(xProbe * xProbe + yProbe * yProbe);
-            if (distance_from_center > radius) continue;
-
-            if(!zprobe->doProbeAt(s, xProbe - X_PROBE_OFFSET_FROM_EXTRUDER, yProbe - Y_PROBE_OFFSET_FROM_EXTRUDER)) return false;
-            float measured_z = zprobe->getProbeHeight() - zprobe->zsteps_to_mm(s) - z_reference; // this is the delta z from bed at 0,0
-            gc->stream->printf("DEBUG: X%1.4f, Y%1.4f, Z%1.4f\n", xProbe, yProbe, measured_z);
-            grid[xCount + (grid_size * yCount)] = measured_z;
+            if(!probe_point(xCount, yCount, radius, z_reference, gc->stream)) {
+                zprobe->endProbeHops();
+                return false;
+            }
         }
     }
 
+    zprobe->endProbeHops();
+    gc->stream->printf("probe cycle took %lu ms\n", (us_ticker_read() - t) / 1000);
+
     extrapolate_unprobed_bed_level();
     print_bed_level(gc->stream);
 
@@ -471,6 +572,83 @@ bool DeltaGridStrategy::doProbe(Gcode *gc)
     return true;
 }
 
+bool DeltaGridStrategy::in_radius(int x, int y, float radius)
+{
+    float xProbe = LEFT_PROBE_BED_POSITION + AUTO_BED_LEVELING_GRID_X * x;
+    float yProbe = FRONT_PROBE_BED_POSITION + AUTO_BED_LEVELING_GRID_Y * y;
+    return sqrtf(xProbe * xProbe + yProbe * yProbe) <= radius;
+}
+
+// probe one point of the grid unless it is known already
+bool DeltaGridStrategy::probe_point(int x, int y, float radius, float z_reference, StreamOutput *stream)
+{
+    // Avoid probing the corners (outside the round or hexagon print surface) on a delta printer.
+    if(!isnan(grid[x + (grid_size * y)]) || !in_radius(x, y, radius)) return true;
+
+    float xProbe = LEFT_PROBE_BED_POSITION + AUTO_BED_LEVELING_GRID_X * x;
+    float yProbe = FRONT_PROBE_BED_POSITION + AUTO_BED_LEVELING_GRID_Y * y;
+    int s;
+    if(!zprobe->doProbeAt(s, xProbe - X_PROBE_OFFSET_FROM_EXTRUDER, yProbe - Y_PROBE_OFFSET_FROM_EXTRUDER)) return false;
+
+    float measured_z = zprobe->getProbeHeight() - zprobe->zsteps_to_mm(s) - z_reference; // this is the delta z from bed at 0,0
+    stream->printf("DEBUG: X%1.4f, Y%1.4f, Z%1.4f\n", xProbe, yProbe, measured_z);
+    grid[x + (grid_size * y)] = measured_z;
+    return true;
+}
+
+// the even points make cells of four, the centre of each is probed and the other points around it only if the centre is
+// off the mean of the corners by more than the tolerance, otherwise they are halfway along the edges. whatever is not
+// known after this, around the edge of the radius, is probed by the normal pass
+bool DeltaGridStrategy::probe_adaptive(float radius, float z_reference, StreamOutput *stream)
+{
+    auto z= [this](int x, int y) -> float& { return grid[x + (grid_size * y)]; };
+    int m= grid_size / 2;
+
+    // back and forth along the rows so each point is next to the last
+    for (int y = 0; y < grid_size; y += 2) {
+        for (int i = 0; i < grid_size; i += 2) {
+            int x= (y / 2) % 2 ? grid_size - 1 - i : i;
+            if(!probe_point(x, y, radius, z_reference, stream)) return false;
+        }
+    }
+
+    std::vector<bool> rough(m * m);
+    int refined= 0;
+    for (int cy = 0; cy < m; cy++) {
+        for (int i = 0; i < m; i++) {
+            int cx= cy % 2 ? m - 1 - i : i;
+            int x= cx * 2, y= cy * 2;
+            if(!probe_point(x + 1, y + 1, radius, z_reference, stream)) return false;
+            float mean= (z(x, y) + z(x + 2, y) + z(x, y + 2) + z(x + 2, y + 2)) / 4;
+            rough[cx + m * cy]= fabsf(z(x + 1, y + 1) - mean) > tolerance;
+            if(rough[cx + m * cy]) ++refined;
+        }
+    }
+
+    for (int cy = 0; cy < m; cy++) {
+        for (int i = 0; i < m; i++) {
+            int cx= cy % 2 ? m - 1 - i : i;
+            if(!rough[cx + m * cy]) continue;
+            int x= cx * 2, y= cy * 2;
+            if(!probe_point(x + 1, y, radius, z_reference, stream) || !probe_point(x + 2, y + 1, radius, z_reference, stream) ||
+               !probe_point(x + 1, y + 2, radius, z_reference, stream) || !probe_point(x, y + 1, radius, z_reference, stream)) {
+                return false;
+            }
+        }
+    }
+
+    // the edge points not probed are halfway between their ends, NAN if an end is outside the radius
+    for (int y = 0; y < grid_size; y++) {
+        for (int x = (y + 1) % 2; x < grid_size; x += 2) {
+            if(!isnan(z(x, y)) || !in_radius(x, y, radius)) continue;
+            z(x, y)= y % 2 ? (z(x, y - 1) + z(x, y + 1)) / 2 : (z(x - 1, y) + z(x + 1, y)) / 2;
+        }
+    }
+
+    stream->printf("%d of %d cells refined\n", refined, m * m);
+    return true;
+}
+
 void DeltaGridStrategy::extrapolate_one_point(int x, int y, int xdir, int ydir)
 {
     if (!isnan(grid[x + (grid_size*y)])) {
@@ -506,43 +684,60 @@ void DeltaGridStrategy::extrapolate_unprobed_bed_level()
     }
 }
 
+// the bilinear interpolation of each cell of the grid as a polynomial, so doCompensation does not have to index the
+// four corners and blend them for every segment. must be called whenever the grid changes before compensation is on
+void DeltaGridStrategy::build_cells()
+{
+    cell_scale_x = 1.0F / AUTO_BED_LEVELING_GRID_X;
+    cell_scale_y = 1.0F / AUTO_BED_LEVELING_GRID_Y;
+
+    int n = grid_size - 1;
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            float z1 = grid[x + (y * grid_size)];
+            float z2 = grid[x + ((y + 1) * grid_size)];
+            float z3 = grid[(x + 1) + (y * grid_size)];
+            float z4 = grid[(x + 1) + ((y + 1) * grid_size)];
+            float *c = &cells[(x + (y * n)) * 4];
+            c[0] = z1;
+            c[1] = z3 - z1;
+            c[2] = z2 - z1;
+            c[3] = z1 - z2 - z3 + z4;
+        }
+    }
+}
+
 void DeltaGridStrategy::doCompensation(float target[3])
 {
     // Adjust print surface height by linear interpolation over the bed_level array.
     int half = (grid_size - 1) / 2;
-    float grid_x = std::max(0.001F - half, std::min(half - 0.001F, target[X_AXIS] / AUTO_BED_LEVELING_GRID_X));
-    float grid_y = std::max(0.001F - half, std::min(half - 0.001F, target[Y_AXIS] / AUTO_BED_LEVELING_GRID_Y));
+    float grid_x = std::max(0.001F - half, std::min(half - 0.001F, target[X_AXIS] * cell_scale_x));
+    float grid_y = std::max(0.001F - half, std::min(half - 0.001F, target[Y_AXIS] * cell_scale_y));
     int floor_x = floorf(grid_x);
     int floor_y = floorf(grid_y);
     float ratio_x = grid_x - floor_x;
     float ratio_y = grid_y - floor_y;
-    float z1 = grid[(floor_x + half) + ((floor_y + half) * grid_size)];
-    float z2 = grid[(floor_x + half) + ((floor_y + half + 1) * grid_size)];
-    float z3 = grid[(floor_x + half + 1) + ((floor_y + half) * grid_size)];
-    float z4 = grid[(floor_x + half + 1) + ((floor_y + half + 1) * grid_size)];
-    float left = (1 - ratio_y) * z1 + ratio_y * z2;
-    float right = (1 - ratio_y) * z3 + ratio_y * z4;
-    float offset = (1 - ratio_x) * left + ratio_x * right;
-
-    target[Z_AXIS] += offset;
-
-
-    /*
-        THEKERNEL->streams->printf("//DEBUG: TARGET: %f, %f, %f\n", target[0], target[1], target[2]);
-        THEKERNEL->streams->printf("//DEBUG: grid_x= %f\n", grid_x);
-        THEKERNEL->streams->printf("//DEBUG: grid_y= %f\n", grid_y);
-        THEKERNEL->streams->printf("//DEBUG: floor_x= %d\n", floor_x);
-        THEKERNEL->streams->printf("//DEBUG: floor_y= %d\n", floor_y);
-        THEKERNEL->streams->printf("//DEBUG: ratio_x= %f\n", ratio_x);
-        THEKERNEL->streams->printf("//DEBUG: ratio_y= %f\n", ratio_y);
-        THEKERNEL->streams->printf("//DEBUG: z1= %f\n", z1);
-        THEKERNEL->streams->printf("//DEBUG: z2= %f\n", z2);
-        THEKERNEL->streams->printf("//DEBUG: z3= %f\n", z3);
-        THEKERNEL->streams->printf("//DEBUG: z4= %f\n", z4);
-        THEKERNEL->streams->printf("//DEBUG: left= %f\n", left);
-        THEKERNEL->streams->printf("//DEBUG: right= %f\n", right);
-        THEKERNEL->streams->printf("//DEBUG: offset= %f\n", offset);
-    */
+    const float *c = &cells[((floor_x + half) + ((floor_y + half) * (grid_size - 1))) * 4];
+
+    target[Z_AXIS] += c[0] + c[1] * ratio_x + (c[2] + c[3] * ratio_x) * ratio_y;
+}
+
+// compensate a sweep across the grid, this runs for every segment so it limits the segments per second on a delta
+void DeltaGridStrategy::benchmark_compensation(StreamOutput *stream)
+{
+    if(THEKERNEL->robot->compensationTransform == nullptr) build_cells();
+
+    const int n = 10000;
+    float sum = 0;
+    uint32_t t = us_ticker_read(); // mbed call
+    for (int i = 0; i < n; i++) {
+        float target[3]{grid_radius * ((i % 100) / 50.0F - 1), grid_radius * ((i / 100) / 50.0F - 1), 0};
+        doCompensation(target);
+        sum += target[Z_AXIS];
+    }
+    t = us_ticker_read() - t;
+
+    stream->printf("%d compensations took %lu us, %lu per second (%1.3f)\n", n, t, t > 0 ? (uint32_t)(n * 1000000ULL / t) : 0, sum / n);
 }
 
 
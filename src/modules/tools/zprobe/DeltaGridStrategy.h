@@ -23,12 +23,18 @@ private:
     void extrapolate_one_point(int x, int y, int xdir, int ydir);
     void extrapolate_unprobed_bed_level();
     bool doProbe(Gcode *gc);
+    bool in_radius(int x, int y, float radius);
+    bool probe_point(int x, int y, float radius, float z_reference, StreamOutput *stream);
+    bool probe_adaptive(float radius, float z_reference, StreamOutput *stream);
     float findBed();
     void setAdjustFunction(bool on);
     void print_bed_level(StreamOutput *stream);
     void doCompensation(float target[3]);
+    void build_cells();
+    void benchmark_compensation(StreamOutput *stream);
     void reset_bed_level();
     void save_grid(StreamOutput *stream);
+    void export_grid(StreamOutput *stream);
     bool load_grid(StreamOutput *stream);
     bool probe_spiral(int n, float radius, StreamOutput *stream);
     bool probe_grid(int n, float radius, StreamOutput *stream);
@@ -37,6 +43,8 @@ private:
     float tolerance;
 
     float *grid;
+    float *cells;                           // z= a + b*x + c*y + d*x*y for each grid cell, x and y 0-1 across the cell
+    float cell_scale_x, cell_scale_y;       // target to grid units
     float grid_radius;
     std::tuple<float, float, float> probe_offsets;
     uint8_t grid_size;
@@ -0,0 +1,32 @@
+#include "GridFile.h"
+
+#include "crc32.h"
+
+const char *GridFile::write(const char *fn, header_t &h, const float *grid)
+{
+    FILE *fp= fopen(fn, "w");
+    if(fp == NULL) return "failed to open grid file";
+
+    size_t n= h.rows * h.cols;
+    h.version= 1;
+    h.reserved= 0;
+    h.crc= crc32_update(0, grid, n * sizeof(float));
+    bool ok= fwrite(&h, sizeof(h), 1, fp) == 1 && fwrite(grid, sizeof(float), n, fp) == n;
+    if(fclose(fp) != 0) ok= false;
+    return ok ? nullptr : "failed to write grid file";
+}
+
+bool GridFile::read_header(FILE *fp, uint32_t magic, header_t &h)
+{
+    if(fread(&h, sizeof(h), 1, fp) == 1 && h.magic == magic && h.version == 1) return true;
+    rewind(fp);
+    return false;
+}
+
+const char *GridFile::read_grid(FILE *fp, const header_t &h, float *grid)
+{
+    size_t n= h.rows * h.cols;
+    if(fread(grid, sizeof(float), n, fp) != n) return "grid file is short";
+    if(crc32_update(0, grid, n * sizeof(float)) != h.crc) return "grid file checksum is bad";
+    return nullptr;
+}
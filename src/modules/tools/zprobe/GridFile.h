@@ -0,0 +1,34 @@
+#ifndef __GRIDFILE_H
+#define __GRIDFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// A compensation grid as one header and the floats of the grid as they are in memory, so a load is one read
+// straight into the grid. The CRC covers the floats, the header says what they are.
+namespace GridFile
+{
+    struct header_t {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t rows;
+        uint16_t cols;
+        uint16_t reserved;
+        float size_x;           // the radius of a delta grid, the bed size of a ZGrid
+        float size_y;
+        float z_offset;
+        uint32_t crc;           // of the grid
+    };
+
+    static const uint32_t delta_magic= 0x44524744;    // DGRD
+    static const uint32_t zgrid_magic= 0x4452475A;    // ZGRD
+
+    // nullptr when written, else what went wrong
+    const char *write(const char *fn, header_t &h, const float *grid);
+    // true with the header read when the file is one of these with the magic, the file is left after the header
+    bool read_header(FILE *fp, uint32_t magic, header_t &h);
+    // nullptr when n floats were read into grid and they are the ones that were written
+    const char *read_grid(FILE *fp, const header_t &h, float *grid);
+}
+
+#endif
@@ -12,6 +12,7 @@ Plane3D::Plane3D(const Vector3 &v1, const Vector3 &v2, const Vector3 &v3)
     // ax+by+cz+d=0
     // solve for d
     d = -normal.dot(v1);
+    set_coefficients();
 }
 
 typedef union { float f; uint32_t u; } conv_t;
@@ -22,6 +23,7 @@ Plane3D::Plane3D(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
     ca.u= a; cb.u= b; cc.u= c; cd.u= d;
     this->normal = Vector3(ca.f, cb.f, cc.f);
     this->d= cd.f;
+    set_coefficients();
 }
 
 void Plane3D::encode(uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
@@ -34,11 +36,13 @@ void Plane3D::encode(uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
     a= ca.u; b= cb.u; c= cc.u; d= cd.u;
 }
 
-// solve for z given x and y
+// solve ax+by+cz+d=0 for z given x and y
 // z= (-ax - by - d)/c
-float Plane3D::getz(float x, float y)
+void Plane3D::set_coefficients()
 {
-    return ((-normal[0] * x) - (normal[1] * y) - d) / normal[2];
+    zx= -normal[0] / normal[2];
+    zy= -normal[1] / normal[2];
+    z0= -d / normal[2];
 }
 
 Vector3 Plane3D::getNormal() const
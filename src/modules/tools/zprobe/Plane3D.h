@@ -11,11 +11,14 @@ class Plane3D
 private:
     Vector3 normal;
     float d;
+    // z= zx*x + zy*y + z0, worked out once as getz is called for every segment
+    float zx, zy, z0;
+    void set_coefficients();
 
 public:
     Plane3D(const Vector3 &v1, const Vector3 &v2, const Vector3 &v3);
     Plane3D(uint32_t a, uint32_t b, uint32_t c, uint32_t d);
-    float getz(float x, float y);
+    float getz(float x, float y) const { return zx * x + zy * y + z0; }
     Vector3 getNormal() const;
     void encode(uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d);
 };
@@ -362,6 +362,7 @@ void ThreePointStrategy::setAdjustFunction(bool on)
         // clear it
         THEKERNEL->robot->compensationTransform= nullptr;
     }
+    THEKERNEL->robot->compensation_is_z_offset= on;
 }
 
 // find the Z offset for the point on the plane at x, y
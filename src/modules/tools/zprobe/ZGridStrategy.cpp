@@ -64,6 +64,7 @@
     Usage
     -----
     G32                  : probes the probe points and defines the bed ZGrid, this will remain in effect until reset or M370
+    G32 S1               : as G32 but sweeps each row with the analog probe on zprobe.scan_pin instead of probing each point
     G31                  : reports the status - Display probe data points
 
     M370                 : clears the ZGrid and the bed levelling is disabled until G32 is run again
@@ -75,6 +76,7 @@
 
     M374                 : Save the grid to "Zgrid" on SD card
     M374 S###            : Save custom grid to "Zgrid.###" on SD card
+    M374.2 [S###]        : Export the grid as text to "Zgrid.[###].txt" on SD card, which M375 can also load
 
     M375                 : Loads grid file "Zgrid" from SD
     M375 S###            : Load custom grid file "Zgrid.###"
@@ -99,10 +101,12 @@
 #include "Conveyor.h"
 #include "ZProbe.h"
 #include "libs/FileStream.h"
+#include "GridFile.h"
 #include "nuts_bolts.h"
 #include "platform_memory.h"
 #include "MemoryPool.h"
 #include "libs/utils.h"
+#include "us_ticker_api.h" // mbed
 
 #include <string>
 #include <algorithm>
@@ -241,7 +245,7 @@ bool ZGridStrategy::handleGcode(Gcode *gcode)
             THEKERNEL->conveyor->wait_for_empty_queue();
 
             this->setAdjustFunction(false); // Disable leveling code
-            if(!doProbing(gcode->stream)) {
+            if(!doProbing(gcode->stream, gcode->has_letter('S') && gcode->get_value('S') != 0)) {
                 gcode->stream->printf("Probe failed to complete, probe not triggered or other error\n");
             } else {
                 this->setAdjustFunction(true); // Enable leveling code
@@ -316,7 +320,7 @@ bool ZGridStrategy::handleGcode(Gcode *gcode)
             }
             return true;
 
-            // M374: Save grid
+            // M374: Save grid, M374.2: export it as text
             case 374:{
                 char gridname[5];
 
@@ -325,7 +329,12 @@ bool ZGridStrategy::handleGcode(Gcode *gcode)
                 else
                     gridname[0] = '\0';
 
-                if(this->saveGrid(gridname)) {
+                if(gcode->subcode == 2) {
+                    if(this->exportGrid(gridname)) {
+                        gcode->stream->printf("Grid exported: Filename: /sd/Zgrid.%s.txt\n",gridname);
+                    }
+                }
+                else if(this->saveGrid(gridname)) {
                     gcode->stream->printf("Grid saved: Filename: /sd/Zgrid.%s\n",gridname);
                 }
                 else {
@@ -398,6 +407,21 @@ bool ZGridStrategy::handleGcode(Gcode *gcode)
 bool ZGridStrategy::saveGrid(std::string args)
 {
     args = "/sd/Zgrid." + args;
+
+    GridFile::header_t h;
+    h.magic= GridFile::zgrid_magic;
+    h.rows= this->numRows;
+    h.cols= this->numCols;
+    h.size_x= this->bed_x;
+    h.size_y= this->bed_y;
+    h.z_offset= getZhomeoffset();
+    return GridFile::write(args.c_str(), h, this->pData) == nullptr;
+}
+
+// the grid as text, which is what the grid files used to be and can still be loaded
+bool ZGridStrategy::exportGrid(std::string args)
+{
+    args = "/sd/Zgrid." + args + ".txt";
     StreamOutput *ZMap_file = new FileStream(args.c_str());
 
     ZMap_file->printf("P%i %i %i %1.3f\n", probe_points, this->numRows, this->numCols, getZhomeoffset());    // Store probe points to prevent loading undefined grid files
@@ -420,43 +444,60 @@ bool ZGridStrategy::loadGrid(std::string args)
 
     args = "/sd/Zgrid." + args;
     FILE *fd = fopen(args.c_str(), "r");
-    if(fd != NULL) {
-        fscanf(fd, "%s\n", flag);
-
-        if (flag[0] == 'P'){
-
-            sscanf(flag, "P%i\n", &fpoints);                        // read number of points, and Grid X and Y
-            fscanf(fd, "%i %i %f\n", &GridX, &GridY, &GridZ);       // read number of points, and Grid X and Y and ZHoming offset
-            fscanf(fd, "%f\n", &val);                               // read first value from file
+    if(fd == NULL) return false;
 
-        } else {  // original 25point file -- Backwards compatibility
-            fpoints = 25;
-            sscanf(flag, "%f\n", &val);                             // read first value from string
+    GridFile::header_t h;
+    if(GridFile::read_header(fd, GridFile::zgrid_magic, h)) {
+        if (h.rows != this->numRows || h.cols != this->numCols){
+            this->numRows = h.rows;                                 // Change Rows and Columns to match the saved data
+            this->numCols = h.cols;
+            this->calcConfig();                                     // Reallocate memory for the grid according to the grid loaded
         }
 
-        if (GridX != this->numRows || GridY != this->numCols){
-            this->numRows = GridX;                                  // Change Rows and Columns to match the saved data
-            this->numCols = GridY;
-            this->calcConfig();                                     // Reallocate memory for the grid according to the grid loaded
+        const char *error= GridFile::read_grid(fd, h, this->pData);
+        fclose(fd);
+        if(error != nullptr) {
+            for (int i=0; i<probe_points; i++){
+                this->pData[i] = 0.0F;                              // what was read in is not a grid to use
+            }
+            return false;
         }
+        this->setZoffset(h.z_offset);
+        return true;
+    }
 
-        this->pData[0] = val;    // Place the first read value in grid
+    // a text grid file, as they were before
+    fscanf(fd, "%s\n", flag);
 
-        for (int pos = 1; pos < probe_points; pos++){
-            fscanf(fd, "%f\n", &val);
-            this->pData[pos] = val;
-        }
+    if (flag[0] == 'P'){
 
-        fclose(fd);
+        sscanf(flag, "P%i\n", &fpoints);                        // read number of points, and Grid X and Y
+        fscanf(fd, "%i %i %f\n", &GridX, &GridY, &GridZ);       // read number of points, and Grid X and Y and ZHoming offset
+        fscanf(fd, "%f\n", &val);                               // read first value from file
 
-        this->setZoffset(GridZ);
+    } else {  // original 25point file -- Backwards compatibility
+        fpoints = 25;
+        sscanf(flag, "%f\n", &val);                             // read first value from string
+    }
 
-        return true;
+    if (GridX != this->numRows || GridY != this->numCols){
+        this->numRows = GridX;                                  // Change Rows and Columns to match the saved data
+        this->numCols = GridY;
+        this->calcConfig();                                     // Reallocate memory for the grid according to the grid loaded
+    }
 
-    } else {
-        return false;
+    this->pData[0] = val;    // Place the first read value in grid
+
+    for (int pos = 1; pos < probe_points; pos++){
+        fscanf(fd, "%f\n", &val);
+        this->pData[pos] = val;
     }
 
+    fclose(fd);
+
+    this->setZoffset(GridZ);
+
+    return true;
 }
 
 float ZGridStrategy::getZhomeoffset()
@@ -484,7 +525,7 @@ void ZGridStrategy::setZoffset(float zval)
 
 }
 
-bool ZGridStrategy::doProbing(StreamOutput *stream)  // probed calibration
+bool ZGridStrategy::doProbing(StreamOutput *stream, bool scan)  // probed calibration
 {
     // home first using selected mode: NOHOME, HOMEXY, HOMEXYZ
     this->homexyz();
@@ -518,7 +559,37 @@ bool ZGridStrategy::doProbing(StreamOutput *stream)  // probed calibration
 
     this->move(this->cal, slow_rate);            // Move to probe start point
 
-    for (int probes = 0; probes < probe_points; probes++){
+    uint32_t t= us_ticker_read(); // mbed call
+    if(scan && !zprobe->canScan()) {
+        stream->printf("No zprobe.scan_pin to scan with, probing each point\n");
+        scan= false;
+    }
+    if(scan) {
+        // sweep each row along Y at the start height, alternate rows the other way
+        std::vector<float> dist(this->numCols);
+        float y0= this->cal_offset_y - std::get<Y_AXIS>(this->probe_offsets);
+        float y1= y0 + this->bed_y;
+        for (int r = 0; r < this->numRows; r++) {
+            float x= r * this->bed_div_x + this->cal_offset_x - std::get<X_AXIS>(this->probe_offsets);
+            bool reverse= (r & 1) != 0;
+            if(!zprobe->scanLine(x, reverse ? y1 : y0, x, reverse ? y0 : y1, this->numCols, dist.data())) {
+                this->in_cal = false;
+                return false;
+            }
+            for (int c = 0; c < this->numCols; c++) {
+                int col= reverse ? this->numCols - 1 - c : c;
+                if(isnan(dist[c])) {
+                    stream->printf("No scan samples near row %d column %d, lower zprobe.scan_feedrate\n", r, col);
+                    this->in_cal = false;
+                    return false;
+                }
+                this->pData[r * this->numCols + col] = getZhomeoffset() - dist[c];
+            }
+        }
+    }
+
+    zprobe->beginProbeHops();                    // next_cal goes back and forth so each point is next to the last
+    for (int probes = 0; !scan && probes < probe_points; probes++){
         int pindex = 0;
 
         // z = z home offset - probed distance
@@ -531,8 +602,9 @@ bool ZGridStrategy::doProbing(StreamOutput *stream)  // probed calibration
 
         this->pData[pindex] = z ;                                // save the offset
     }
+    zprobe->endProbeHops();
 
-    stream->printf("\nCalibration done.\n");
+    stream->printf("\nCalibration done, probe cycle took %lu ms\n", (us_ticker_read() - t) / 1000);
     if (this->wait_for_probe) {                                  // Only do this it the config calls for probe removal position
         this->cal[X_AXIS] = this->bed_x/2.0f;
         this->cal[Y_AXIS] = this->bed_y/2.0f;
@@ -651,6 +723,7 @@ void ZGridStrategy::setAdjustFunction(bool on)
         // clear it
         THEKERNEL->robot->compensationTransform= nullptr;
     }
+    THEKERNEL->robot->compensation_is_z_offset= on;
 }
 
 
@@ -29,11 +29,12 @@ private:
     void setZoffset(float zval);
 
     void setAdjustFunction(bool);
-    bool doProbing(StreamOutput *stream);
+    bool doProbing(StreamOutput *stream, bool scan= false);
     void normalize_grid_2home();
 
     bool loadGrid(std::string args);
     bool saveGrid(std::string args);
+    bool exportGrid(std::string args);
     void calcConfig();
 
     std::tuple<float, float, float> probe_offsets;
@@ -26,7 +26,12 @@
 #include "PublicData.h"
 #include "LevelingStrategy.h"
 #include "StepTicker.h"
+#include "Adc.h"
 #include "utils.h"
+#include "InterruptIn.h" // mbed
+
+#include <math.h>
+#include <algorithm>
 
 // strategies we know about
 #include "DeltaCalibrationStrategy.h"
@@ -44,6 +49,17 @@
 #define probe_height_checksum    CHECKSUM("probe_height")
 #define gamma_max_checksum       CHECKSUM("gamma_max")
 #define reverse_z_direction_checksum CHECKSUM("reverse_z")
+#define edge_interrupt_checksum  CHECKSUM("edge_interrupt")
+#define probe_hop_checksum       CHECKSUM("probe_hop")
+#define probe_hop_distance_checksum CHECKSUM("probe_hop_distance")
+#define tap_count_checksum       CHECKSUM("tap_count")
+#define tap_retract_checksum     CHECKSUM("tap_retract")
+#define tap_feedrate_checksum    CHECKSUM("tap_feedrate")
+#define tap_tolerance_checksum   CHECKSUM("tap_tolerance")
+#define scan_pin_checksum        CHECKSUM("scan_pin")
+#define scan_near_checksum       CHECKSUM("scan_near")
+#define scan_far_checksum        CHECKSUM("scan_far")
+#define scan_feedrate_checksum   CHECKSUM("scan_feedrate")
 
 // this allows the probe to decelerate after triggering, avoiding an issue where Z creeps down a step every few probes
 // however, if the probe has no remaining travel when it triggers, it should be set to false
@@ -83,7 +99,8 @@ void ZProbe::on_module_loaded()
     // register event-handlers
     register_for_event(ON_GCODE_RECEIVED);
 
-    THEKERNEL->step_ticker->register_acceleration_tick_handler([this](){acceleration_tick(); });
+    // only called while running a probe move
+    acceleration_tick_id= THEKERNEL->step_ticker->register_acceleration_tick_handler([](void *z){ static_cast<ZProbe *>(z)->acceleration_tick(); }, this, "RIT zprobe", false);
 
     // we read the probe in this timer, currently only for G38 probes.
     probing= false;
@@ -92,13 +109,39 @@ void ZProbe::on_module_loaded()
 
 void ZProbe::on_config_reload(void *argument)
 {
-    this->pin.from_string( THEKERNEL->config->value(zprobe_checksum, probe_pin_checksum)->by_default("nc" )->as_string())->as_input();
+    string probe_pin= THEKERNEL->config->value(zprobe_checksum, probe_pin_checksum)->by_default("nc" )->as_string();
+    this->pin.from_string(probe_pin)->as_input();
+
+    // the probe can stop the actuators from a pin interrupt on the step it triggers, rather than when it is next polled
+    if(THEKERNEL->config->value(zprobe_checksum, edge_interrupt_checksum)->by_default(false)->as_bool() && this->probe_irq == nullptr) {
+        this->probe_irq= this->pin.interrupt_pin();
+        // creating the InterruptIn sets a pull down, put the pin back as configured
+        this->pin.from_string(probe_pin)->as_input();
+        if(this->probe_irq == nullptr) {
+            THEKERNEL->streams->printf("WARNING: zprobe.edge_interrupt needs the probe on a port 0 or port 2 pin, it will be polled\n");
+        } else if(this->pin.is_inverting()) {
+            this->probe_irq->fall(this, &ZProbe::on_probe_edge);
+        } else {
+            this->probe_irq->rise(this, &ZProbe::on_probe_edge);
+        }
+    }
+
     this->debounce_count = THEKERNEL->config->value(zprobe_checksum, debounce_count_checksum)->by_default(0)->as_number();
     this->decelerate_runout = THEKERNEL->config->value(zprobe_checksum, decelerate_runout_checksum)->by_default(-1)->as_number();
 
     // this won't let you turn on decel unless decelerate_runout is set
     setDecelerateOnTrigger(THEKERNEL->config->value(zprobe_checksum, decelerate_on_trigger_checksum)->by_default(false)->as_bool());
 
+    // an analog probe that reads the distance to the bed, sampled while sweeping over it at a constant height
+    this->scan_pin.from_string(THEKERNEL->config->value(zprobe_checksum, scan_pin_checksum)->by_default("nc")->as_string());
+    if(this->scan_pin.connected() && this->scan_ring == nullptr) {
+        THEKERNEL->adc->enable_pin(&this->scan_pin);
+        this->scan_ring= new scan_sample_t[scan_ring_size];
+    }
+    this->scan_near = THEKERNEL->config->value(zprobe_checksum, scan_near_checksum)->by_default(0)->as_number(); // mm at the lowest reading
+    this->scan_far  = THEKERNEL->config->value(zprobe_checksum, scan_far_checksum)->by_default(10)->as_number(); // mm at the highest reading
+    this->scan_feedrate = THEKERNEL->config->value(zprobe_checksum, scan_feedrate_checksum)->by_default(20)->as_number(); // mm/sec
+
     // get strategies to load
     vector<uint16_t> modules;
     THEKERNEL->config->get_module_list( &modules, leveling_strategy_checksum);
@@ -157,6 +200,12 @@ void ZProbe::on_config_reload(void *argument)
     this->return_feedrate = THEKERNEL->config->value(zprobe_checksum, return_feedrate_checksum)->by_default(0)->as_number(); // feedrate in mm/sec
     this->reverse_z     = THEKERNEL->config->value(zprobe_checksum, reverse_z_direction_checksum)->by_default(false)->as_bool(); // Z probe moves in reverse direction
     this->max_z         = THEKERNEL->config->value(gamma_max_checksum)->by_default(500)->as_number(); // maximum zprobe distance
+    this->probe_hop     = THEKERNEL->config->value(zprobe_checksum, probe_hop_checksum)->by_default(0)->as_number(); // mm above the last point to travel at in a grid
+    this->probe_hop_distance = THEKERNEL->config->value(zprobe_checksum, probe_hop_distance_checksum)->by_default(20)->as_number(); // mm
+    this->tap_count     = std::max(1, THEKERNEL->config->value(zprobe_checksum, tap_count_checksum)->by_default(1)->as_int()); // slow taps after a fast contact at each point, 1 for one slow dive
+    this->tap_retract   = THEKERNEL->config->value(zprobe_checksum, tap_retract_checksum)->by_default(1)->as_number(); // mm above the last trigger each tap starts from
+    this->tap_feedrate  = THEKERNEL->config->value(zprobe_checksum, tap_feedrate_checksum)->by_default(std::min(this->slow_feedrate*4, this->fast_feedrate))->as_number(); // mm/sec of the first contact
+    this->tap_tolerance = THEKERNEL->config->value(zprobe_checksum, tap_tolerance_checksum)->by_default(0.02F)->as_number(); // mm from the median a tap is averaged within, 0 for the median
 }
 
 void ZProbe::setDecelerateOnTrigger(bool t) {
@@ -168,6 +217,33 @@ void ZProbe::setDecelerateOnTrigger(bool t) {
     }
 }
 
+// the probe pin edge, at the same priority as the step ticker so the actuators stop on the step the probe triggered
+void ZProbe::on_probe_edge()
+{
+    if(probe_detected || !(probing || running) || !this->pin.get()) return;
+
+    trigger_stepped= STEPPER[Z_AXIS]->get_stepped();
+    probe_detected= true;
+    if(probing || !decelerate_on_trigger) {
+        for(auto &a : THEKERNEL->robot->actuators) {
+            if(a->is_moving()) a->force_finish_move();
+        }
+    }
+}
+
+// raise the pin interrupts to the step ticker priority while probing, they are shared with other modules that keep them low
+void ZProbe::arm_probe_edge(bool on)
+{
+    if(probe_irq == nullptr) return;
+    if(on) {
+        probe_detected= false;
+        saved_irq_priority= NVIC_GetPriority(EINT3_IRQn);
+        NVIC_SetPriority(EINT3_IRQn, NVIC_GetPriority(TIMER0_IRQn));
+    } else {
+        NVIC_SetPriority(EINT3_IRQn, saved_irq_priority);
+    }
+}
+
 bool ZProbe::wait_for_probe(int& steps)
 {
     unsigned int debounce = 0;
@@ -181,6 +257,32 @@ bool ZProbe::wait_for_probe(int& steps)
 
         bool delta= is_delta || is_rdelta;
 
+        if(probe_irq != nullptr) {
+            // the edge interrupt has already stopped the actuators, unless they are decelerating
+            if(!probe_detected) {
+                if( !STEPPER[Z_AXIS]->is_moving() && (!delta || (!STEPPER[Y_AXIS]->is_moving() && !STEPPER[Z_AXIS]->is_moving())) ) {
+                    return false;
+                }
+                continue;
+            }
+            steps = trigger_stepped;
+            if(!decelerate_on_trigger) return true;
+
+            accelerating = false;
+            runout_steps = (uint32_t)((uint32_t)steps + (decelerate_runout * Z_STEPS_PER_MM));
+            while(STEPPER[Z_AXIS]->is_moving() || (is_delta && (STEPPER[X_AXIS]->is_moving() || STEPPER[Y_AXIS]->is_moving())) ) {
+                THEKERNEL->call_event(ON_IDLE);
+            }
+            running = false;
+            accelerating = true;
+            if(has_exceeded_runout) {
+                THEKERNEL->streams->printf("[!!] Runout protection was triggered!\n");
+                THEKERNEL->streams->printf("[!!] Check zprobe.decelerate_runout in config and/or try higher accel/lower speed.\n");
+                return false;
+            }
+            return true;
+        }
+
         // if no stepper is moving, moves are finished and there was no touch
         if( !STEPPER[Z_AXIS]->is_moving() && (!delta || (!STEPPER[Y_AXIS]->is_moving() && !STEPPER[Z_AXIS]->is_moving())) ) {
             return false;
@@ -287,12 +389,15 @@ bool ZProbe::run_probe(int& steps, float feedrate, float max_dist, bool reverse)
     }
 
     // Start acceleration processing
+    arm_probe_edge(true);
     this->running = true;
+    THEKERNEL->step_ticker->enable_acceleration_tick_handler(acceleration_tick_id, true);
 
     // Wait for probe to trigger
     bool r = wait_for_probe(steps);
 
     this->running = false;
+    arm_probe_edge(false);
 
     return r;
 }
@@ -335,6 +440,7 @@ bool ZProbe::return_probe(int steps, bool reverse)
     }
 
     this->running = true;
+    THEKERNEL->step_ticker->enable_acceleration_tick_handler(acceleration_tick_id, true);
     while(STEPPER[Z_AXIS]->is_moving() || (delta && (STEPPER[X_AXIS]->is_moving() || STEPPER[Y_AXIS]->is_moving())) ) {
         // wait for it to complete
         THEKERNEL->call_event(ON_IDLE);
@@ -357,22 +463,155 @@ bool ZProbe::doProbeAt(int &steps, float x, float y)
 {
     int s;
 
+    if(hopping) {
+        // the probe is only hop mm above the last point, go back up before a long move
+        if(hop_depth > 0 && hypotf(x - last_x, y - last_y) > probe_hop_distance) {
+            coordinated_move(NAN, NAN, zsteps_to_mm(hop_depth), getFastFeedrate(), true, false);
+            hop_depth= 0;
+        }
+        last_x= x;
+        last_y= y;
+    }
+
     // move to xy
     coordinated_move(x, y, NAN, getFastFeedrate());
-    if(!run_probe(s)) return false;
+    int below;
+    if(!tap_probe(s, below)) return false;
+
+    if(hopping) {
+        // report the distance from the start height, then lift hop mm above the point without waiting, so the
+        // lift runs into the move to the next point. the lift is from where the probe stopped
+        steps= hop_depth + s;
+        int lift= below - s + (int)(probe_hop * Z_STEPS_PER_MM);
+        if(lift > hop_depth + below) lift= hop_depth + below;
+        hop_depth += below - lift;
+
+        this->running = false;
+        STEPPER[X_AXIS]->move(0, 0);
+        STEPPER[Y_AXIS]->move(0, 0);
+        STEPPER[Z_AXIS]->move(0, 0);
+        float fr= std::min(this->slow_feedrate*2, this->fast_feedrate);
+        coordinated_move(NAN, NAN, zsteps_to_mm(lift), fr, true, false);
+        return true;
+    }
 
     // return to original Z
-    bool success = true;
-    if(decelerate_on_trigger) {
-        success = return_probe(steps_at_decel_end);
-    } else {
-        success = return_probe(s);
-    }
+    bool success = return_probe(below);
     steps = s;
 
     return success;
 }
 
+// probe down from here, s is the steps to where it triggered and below the steps to where it stopped, further when it
+// decelerates. With tap_count over 1 the first contact is at tap_feedrate and only finds the surface, then each tap lifts
+// to tap_retract above the last trigger and comes down at the slow rate from there, so the slow part of the dive is short
+bool ZProbe::tap_probe(int &s, int &below)
+{
+    if(tap_count <= 1) {
+        if(!run_probe(s)) return false;
+        below= decelerate_on_trigger ? (int)steps_at_decel_end : s;
+        return true;
+    }
+
+    if(!run_probe(s, tap_feedrate)) return false;
+    below= decelerate_on_trigger ? (int)steps_at_decel_end : s;
+
+    int retract= tap_retract * Z_STEPS_PER_MM;
+    float fr= return_feedrate > 0 ? return_feedrate : std::min(this->slow_feedrate*2, this->fast_feedrate);
+    std::vector<int> taps(tap_count);
+    for (int i = 0; i < tap_count; ++i) {
+        int start= std::max(0, s - retract);
+        this->running = false;
+        STEPPER[X_AXIS]->move(0, 0);
+        STEPPER[Y_AXIS]->move(0, 0);
+        STEPPER[Z_AXIS]->move(0, 0);
+        coordinated_move(NAN, NAN, zsteps_to_mm(below - start), fr, true);
+
+        // a tap that does not trigger within twice the retract has lost the surface
+        int t;
+        if(!run_probe(t, slow_feedrate, tap_retract*2)) return false;
+        s= start + t;
+        below= start + (decelerate_on_trigger ? (int)steps_at_decel_end : t);
+        taps[i]= s;
+    }
+
+    // the median, or the mean of the taps close to it so one bad tap does not move the result
+    std::sort(taps.begin(), taps.end());
+    int median= taps[tap_count/2];
+    int tolerance= tap_tolerance * Z_STEPS_PER_MM;
+    if(tolerance > 0) {
+        int sum= 0, n= 0;
+        for (int i = 0; i < tap_count; ++i) {
+            int d= taps[i] - median;
+            if(d > tolerance || -d > tolerance) continue;
+            sum += taps[i];
+            ++n;
+        }
+        s= roundf((float)sum / n);
+    } else {
+        s= median;
+    }
+    return true;
+}
+
+// sweep from x0,y0 to x1,y1 at the current height and set dist to the distance down to the bed at n points evenly along
+// the line, from the mean of the scan probe samples nearest each, or NAN where there were none. the samples are latched
+// with the actuator positions in read_probe and binned here against where the effector really was
+bool ZProbe::scanLine(float x0, float y0, float x1, float y1, int n, float *dist)
+{
+    if(scan_ring == nullptr || n < 1) return false;
+
+    coordinated_move(x0, y0, NAN, getFastFeedrate());
+
+    auto cartesian= [](const float *position, float *pos) {
+        ActuatorCoordinates a{position[X_AXIS], position[Y_AXIS], position[Z_AXIS]};
+        THEKERNEL->robot->arm_solution->actuator_to_cartesian(a, pos);
+    };
+    float here[3], start[3];
+    for (int i = X_AXIS; i <= Z_AXIS; ++i) here[i]= STEPPER[i]->get_current_position();
+    cartesian(here, start);
+
+    float dx= x1 - x0, dy= y1 - y0;
+    float len= hypotf(dx, dy);
+    float spacing= n > 1 ? len / (n - 1) : 0;
+    float mm_per_count= (scan_far - scan_near) / THEKERNEL->adc->get_max_value();
+    std::vector<float> sum(n, 0.0F);
+    std::vector<uint16_t> count(n, 0);
+    auto bin= [&](const scan_sample_t &s) {
+        float pos[3];
+        cartesian(s.position, pos);
+        int i= 0;
+        if(spacing > 0) {
+            float along= ((pos[X_AXIS] - start[X_AXIS]) * dx + (pos[Y_AXIS] - start[Y_AXIS]) * dy) / len;
+            i= roundf(along / spacing);
+            if(i < 0 || i >= n) return;
+        }
+        // from the sweep height, if Z was not quite there
+        sum[i] += scan_near + s.reading * mm_per_count - (pos[Z_AXIS] - start[Z_AXIS]);
+        ++count[i];
+    };
+
+    scan_tail= scan_head;
+    scanning= true;
+    coordinated_move(x1, y1, NAN, scan_feedrate, false, false);
+    while(true) {
+        bool done= THEKERNEL->conveyor->is_queue_empty();
+        for (; scan_tail != scan_head; scan_tail= (scan_tail + 1) & (scan_ring_size - 1)) {
+            bin(scan_ring[scan_tail]);
+        }
+        if(done || THEKERNEL->is_halted()) break;
+        THEKERNEL->conveyor->ensure_running();
+        THEKERNEL->call_event(ON_IDLE);
+    }
+    scanning= false;
+    if(THEKERNEL->is_halted()) return false;
+
+    for (int i = 0; i < n; ++i) {
+        dist[i]= count[i] > 0 ? sum[i] / count[i] : NAN;
+    }
+    return true;
+}
+
 float ZProbe::probeDistance(float x, float y)
 {
     int s;
@@ -380,6 +619,25 @@ float ZProbe::probeDistance(float x, float y)
     return zsteps_to_mm(s);
 }
 
+// between here and endProbeHops doProbeAt only lifts zprobe.probe_hop above each point before moving to the next,
+// the distances it returns are still from the current height
+void ZProbe::beginProbeHops()
+{
+    if(probe_hop <= 0) return;
+    hopping= true;
+    hop_depth= 0;
+    last_x= last_y= NAN;
+}
+
+// back to the height the hops started from
+void ZProbe::endProbeHops()
+{
+    if(!hopping) return;
+    hopping= false;
+    if(hop_depth > 0) coordinated_move(NAN, NAN, zsteps_to_mm(hop_depth), getFastFeedrate(), true);
+    THEKERNEL->conveyor->wait_for_empty_queue();
+}
+
 void ZProbe::on_gcode_received(void *argument)
 {
     Gcode *gcode = static_cast<Gcode *>(argument);
@@ -573,6 +831,17 @@ void ZProbe::on_gcode_received(void *argument)
 
 uint32_t ZProbe::read_probe(uint32_t dummy)
 {
+    if(scanning) {
+        // a full ring drops the sample, the main loop bins them as they come
+        uint8_t next= (scan_head + 1) & (scan_ring_size - 1);
+        if(next != scan_tail) {
+            scan_sample_t &s= scan_ring[scan_head];
+            for (int i = X_AXIS; i <= Z_AXIS; ++i) s.position[i]= STEPPER[i]->get_current_position();
+            s.reading= THEKERNEL->adc->read(&scan_pin);
+            scan_head= next;
+        }
+    }
+
     if(!probing || probe_detected) return 0;
 
     // TODO add debounce/noise filter
@@ -588,6 +857,7 @@ uint32_t ZProbe::read_probe(uint32_t dummy)
 void ZProbe::probe_XYZ(Gcode *gcode, int axis)
 {
     // enable the probe checking in the timer
+    arm_probe_edge(true);
     probing= true;
     probe_detected= false;
     THEKERNEL->robot->disable_segmentation= true; // we must disable segmentation as this won't work with it enabled (beware on deltas probing in X or Y)
@@ -606,6 +876,7 @@ void ZProbe::probe_XYZ(Gcode *gcode, int axis)
 
     // disable probe checking
     probing= false;
+    arm_probe_edge(false);
     THEKERNEL->robot->disable_segmentation= false;
 
     float pos[3];
@@ -641,7 +912,11 @@ void ZProbe::probe_XYZ(Gcode *gcode, int axis)
 // Called periodically to change the speed to match acceleration
 void ZProbe::acceleration_tick(void)
 {
-    if(!this->running) return; // nothing to do
+    if(!this->running) {
+        // nothing to do until the next probe move
+        THEKERNEL->step_ticker->enable_acceleration_tick_handler(acceleration_tick_id, false);
+        return;
+    }
     if(STEPPER[Z_AXIS]->is_moving()) {
         if(accelerating) {
             accelerate(Z_AXIS);
@@ -737,7 +1012,7 @@ void ZProbe::decelerate(int c)
 // issue a coordinated move directly to robot, and return when done
 // Only move the coordinates that are passed in as not nan
 // NOTE must use G53 to force move in machine coordiantes and ignore any WCS offsetts
-void ZProbe::coordinated_move(float x, float y, float z, float feedrate, bool relative)
+void ZProbe::coordinated_move(float x, float y, float z, float feedrate, bool relative, bool wait)
 {
     char buf[32];
     char cmd[64];
@@ -770,7 +1045,7 @@ void ZProbe::coordinated_move(float x, float y, float z, float feedrate, bool re
     message.message = cmd;
     message.stream = &(StreamOutput::NullStream);
     THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
-    THEKERNEL->conveyor->wait_for_empty_queue();
+    if(wait) THEKERNEL->conveyor->wait_for_empty_queue();
 }
 
 // issue home command
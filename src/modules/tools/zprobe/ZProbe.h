@@ -17,6 +17,10 @@
 #define zprobe_checksum            CHECKSUM("zprobe")
 #define leveling_strategy_checksum CHECKSUM("leveling-strategy")
 
+namespace mbed {
+    class InterruptIn;
+}
+
 class StepperMotor;
 class Gcode;
 class StreamOutput;
@@ -26,7 +30,7 @@ class ZProbe: public Module
 {
 
 public:
-    ZProbe() : running(false), invert_override(false) {};
+    ZProbe() : probe_irq(nullptr), scan_ring(nullptr), running(false), invert_override(false), hopping(false), scanning(false) {};
     virtual ~ZProbe() {};
 
     void on_module_loaded();
@@ -39,8 +43,12 @@ public:
     bool return_probe(int steps, bool reverse= false);
     bool doProbeAt(int &steps, float x, float y);
     float probeDistance(float x, float y);
+    bool scanLine(float x0, float y0, float x1, float y1, int n, float *dist);
+    bool canScan() const { return scan_ring != nullptr; }
+    void beginProbeHops();
+    void endProbeHops();
 
-    void coordinated_move(float x, float y, float z, float feedrate, bool relative=false);
+    void coordinated_move(float x, float y, float z, float feedrate, bool relative=false, bool wait=true);
     void home();
 
     bool getProbeStatus() { return this->pin.get(); }
@@ -72,21 +80,50 @@ private:
     unsigned int steps_at_decel_end;	// Holds # of steps at the moment decelerate() stops the motors
 
     void probe_XYZ(Gcode *gc, int axis);
+    bool tap_probe(int &s, int &below);
     uint32_t read_probe(uint32_t dummy);
+    void on_probe_edge();
+    void arm_probe_edge(bool on);
     volatile float current_feedrate;
     float slow_feedrate;
     float fast_feedrate;
     float return_feedrate;
     float probe_height;
     float max_z;
+    float probe_hop;                        // mm the probe lifts above the last point between close points, 0 to always return
+    float probe_hop_distance;               // points further apart than this go back to the start height first
+    int hop_depth;                          // Z steps below the height the hops started from
+    int tap_count;                          // slow taps after the first contact at each point, 1 is a single slow dive
+    float tap_retract;
+    float tap_feedrate;
+    float tap_tolerance;
+    float last_x, last_y;
     bool decelerate_on_trigger;
     float decelerate_runout;
     uint32_t runout_steps;
     bool has_exceeded_runout;
 
     Pin pin;
+    mbed::InterruptIn *probe_irq;           // when set the probe stops the actuators from its edge interrupt
+    volatile uint32_t trigger_stepped;      // Z steps moved when the edge interrupt saw the probe trigger
+    uint32_t saved_irq_priority;
+
+    // samples of the analog scan probe taken in read_probe while sweeping, with where the actuators were
+    struct scan_sample_t {
+        float position[3];
+        uint32_t reading;
+    };
+    static const uint8_t scan_ring_size= 64;
+    Pin scan_pin;
+    scan_sample_t *scan_ring;
+    volatile uint8_t scan_head;
+    volatile uint8_t scan_tail;
+    float scan_near;                        // mm to the bed at the lowest reading
+    float scan_far;                         // and at the highest
+    float scan_feedrate;
     std::vector<LevelingStrategy*> strategies;
     uint8_t debounce_count;
+    uint8_t acceleration_tick_id;
 
     volatile struct {
         volatile bool running:1;
@@ -96,6 +133,8 @@ private:
         bool reverse_z:1;
         bool invert_override:1;
         volatile bool probe_detected:1;
+        bool hopping:1;
+        volatile bool scanning:1;
     };
 };
 
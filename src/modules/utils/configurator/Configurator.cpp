@@ -36,6 +36,24 @@ void Configurator::config_get_command( string parameters, StreamOutput *stream )
         source = "";
         uint16_t setting_checksums[3];
         get_checksums(setting_checksums, setting );
+        // each source goes straight to the line of the setting, the last one to have it wins as in the cache. An
+        // include can only be followed by loading the whole cache
+        bool includes = false;
+        for(auto s : THEKERNEL->config->config_sources) includes |= s->has_includes();
+        if(!includes) {
+            string value;
+            for(auto s : THEKERNEL->config->config_sources) {
+                string v = s->read(setting_checksums);
+                if(!v.empty()) value = v;
+            }
+            if(!value.empty()) {
+                stream->printf( "cached: %s is set to %s\r\n", setting.c_str(), value.c_str() );
+            } else {
+                stream->printf( "cached: %s is not in config\r\n", setting.c_str());
+            }
+            return;
+        }
+
         THEKERNEL->config->config_cache_load(); // need to load config cache first as it is unloaded after booting
         ConfigValue *cv = THEKERNEL->config->value(setting_checksums);
         if(cv != NULL && cv->found) {
@@ -80,8 +98,9 @@ void Configurator::config_set_command( string parameters, StreamOutput *stream )
         if( THEKERNEL->config->config_sources[i]->is_named(source_checksum) ) {
             if(THEKERNEL->config->config_sources[i]->write(setting, value)) {
                 stream->printf( "%s: %s has been set to %s\r\n", source.c_str(), setting.c_str(), value.c_str() );
+                apply_setting(setting, stream);
             } else {
-                stream->printf( "%s: %s not enough space to overwrite existing key/value\r\n", source.c_str(), setting.c_str() );
+                stream->printf( "%s: %s could not be written\r\n", source.c_str(), setting.c_str() );
             }
             return;
         }
@@ -119,6 +138,15 @@ void Configurator::config_load_command( string parameters, StreamOutput *stream
         THEKERNEL->config->config_cache->dump(stream);
         THEKERNEL->config->config_cache_clear();
 
+    } else if(source == "reload") {
+        // after the config has been edited
+        string setting = shift_parameter(parameters);
+        if(setting.empty()) {
+            stream->printf( "Usage: config-load reload setting\r\n" );
+            return;
+        }
+        apply_setting(setting, stream);
+
     } else if(source == "checksum") {
         string key = shift_parameter(parameters);
         uint16_t cs[3];
@@ -126,7 +154,29 @@ void Configurator::config_load_command( string parameters, StreamOutput *stream
         stream->printf( "checksum of %s = %02X %02X %02X\n", key.c_str(), cs[0], cs[1], cs[2]);
 
     } else {
-        stream->printf( "unsupported option: must be one of load|unload|dump|checksum\n" );
+        stream->printf( "unsupported option: must be one of load|unload|dump|checksum|reload\n" );
+    }
+}
+
+// The module a changed setting is for reads it again, from a cache of just the settings of its family, so tuning
+// changes apply without a reset. Only some settings of some modules can be, the rest still need a reset
+void Configurator::apply_setting( const string &setting, StreamOutput *stream )
+{
+    ConfigChange change;
+    get_checksums(change.check_sums, setting);
+    change.applied = 0;
+
+    // a plain setting could be read along with any other, only the module.name.setting ones are reloaded
+    if(change.check_sums[1] != 0) {
+        THEKERNEL->config->config_cache_load_family(change.check_sums[0]);
+        THEKERNEL->call_event(ON_CONFIG_CHANGED, &change);
+        THEKERNEL->config->config_cache_clear();
+    }
+
+    if(change.applied > 0) {
+        stream->printf( "%s applied\r\n", setting.c_str() );
+    } else {
+        stream->printf( "%s applies after a reset\r\n", setting.c_str() );
     }
 }
 
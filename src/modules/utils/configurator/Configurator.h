@@ -22,6 +22,9 @@ public:
     void config_get_command( string parameters, StreamOutput *stream );
     void config_set_command( string parameters, StreamOutput *stream );
     void config_load_command(string parameters, StreamOutput *stream );
+
+private:
+    void apply_setting( const string &setting, StreamOutput *stream );
 };
 
 
@@ -9,6 +9,8 @@
 #include "Config.h"
 #include "checksumm.h"
 #include "DigipotBase.h"
+#include "Conveyor.h"
+#include "us_ticker_api.h"
 
 // add new digipot chips here
 #include "mcp4451.h"
@@ -29,6 +31,8 @@ using namespace std;
 #define digipotchip_checksum                    CHECKSUM("digipotchip")
 #define digipot_max_current                     CHECKSUM("digipot_max_current")
 #define digipot_factor                          CHECKSUM("digipot_factor")
+#define currentcontrol_idle_factor_checksum     CHECKSUM("currentcontrol_idle_factor")
+#define currentcontrol_idle_timeout_checksum    CHECKSUM("currentcontrol_idle_timeout")
 
 #define mcp4451_checksum                        CHECKSUM("mcp4451")
 #define ad5206_checksum                         CHECKSUM("ad5206")
@@ -36,6 +40,8 @@ using namespace std;
 CurrentControl::CurrentControl()
 {
     digipot = NULL;
+    idle= false;
+    enabled= false;
 }
 
 void CurrentControl::on_module_loaded()
@@ -63,17 +69,57 @@ void CurrentControl::on_module_loaded()
     digipot->set_factor( THEKERNEL->config->value(digipot_factor )->by_default(113.33f)->as_number());
 
     // Get configuration
-    this->digipot->set_current(0, THEKERNEL->config->value(alpha_current_checksum  )->by_default(0.8f)->as_number());
-    this->digipot->set_current(1, THEKERNEL->config->value(beta_current_checksum   )->by_default(0.8f)->as_number());
-    this->digipot->set_current(2, THEKERNEL->config->value(gamma_current_checksum  )->by_default(0.8f)->as_number());
-    this->digipot->set_current(3, THEKERNEL->config->value(delta_current_checksum  )->by_default(0.8f)->as_number());
-    this->digipot->set_current(4, THEKERNEL->config->value(epsilon_current_checksum)->by_default(-1)->as_number());
-    this->digipot->set_current(5, THEKERNEL->config->value(zeta_current_checksum   )->by_default(-1)->as_number());
-    this->digipot->set_current(6, THEKERNEL->config->value(eta_current_checksum    )->by_default(-1)->as_number());
-    this->digipot->set_current(7, THEKERNEL->config->value(theta_current_checksum  )->by_default(-1)->as_number());
-
+    currents[0]= THEKERNEL->config->value(alpha_current_checksum  )->by_default(0.8f)->as_number();
+    currents[1]= THEKERNEL->config->value(beta_current_checksum   )->by_default(0.8f)->as_number();
+    currents[2]= THEKERNEL->config->value(gamma_current_checksum  )->by_default(0.8f)->as_number();
+    currents[3]= THEKERNEL->config->value(delta_current_checksum  )->by_default(0.8f)->as_number();
+    currents[4]= THEKERNEL->config->value(epsilon_current_checksum)->by_default(-1)->as_number();
+    currents[5]= THEKERNEL->config->value(zeta_current_checksum   )->by_default(-1)->as_number();
+    currents[6]= THEKERNEL->config->value(eta_current_checksum    )->by_default(-1)->as_number();
+    currents[7]= THEKERNEL->config->value(theta_current_checksum  )->by_default(-1)->as_number();
+    this->digipot->set_currents(currents, 0xFF);
+
+    // the currents can be lowered once the steppers have been enabled without moving for idle_timeout seconds
+    idle_factor= THEKERNEL->config->value(currentcontrol_idle_factor_checksum)->by_default(1.0F)->as_number();
+    idle_timeout_us= THEKERNEL->config->value(currentcontrol_idle_timeout_checksum)->by_default(5.0F)->as_number() * 1000000;
+    idle_since_us= us_ticker_read();
 
     this->register_for_event(ON_GCODE_RECEIVED);
+    if(idle_factor < 1.0F) {
+        this->register_for_event(ON_IDLE);
+        this->register_for_event(ON_ENABLE);
+        this->set_event_rate(ON_IDLE, 100);
+        this->set_event_priority(ON_IDLE, PRIORITY_HOUSEKEEPING);
+    }
+}
+
+// writes the currents, or the idle currents, of only the channels that change
+void CurrentControl::set_currents(const float c[], bool to_idle)
+{
+    float set[8];
+    uint32_t mask= 0;
+    for (int i = 0; i < 8; i++) {
+        set[i]= (to_idle && c[i] > 0) ? c[i] * idle_factor : c[i];
+        if(set[i] != this->digipot->get_current(i)) mask |= (1 << i);
+    }
+    idle= to_idle;
+    if(mask != 0) this->digipot->set_currents(set, mask);
+}
+
+// can be called in an interrupt, so only notes the state
+void CurrentControl::on_enable(void *argument)
+{
+    enabled= (argument != nullptr);
+}
+
+void CurrentControl::on_idle(void *argument)
+{
+    if(idle) return;
+    if(!enabled || !THEKERNEL->conveyor->is_queue_empty()) {
+        idle_since_us= us_ticker_read();
+        return;
+    }
+    if(us_ticker_read() - idle_since_us >= idle_timeout_us) set_currents(currents, true);
 }
 
 
@@ -81,20 +127,25 @@ void CurrentControl::on_gcode_received(void *argument)
 {
     Gcode *gcode = static_cast<Gcode*>(argument);
     char alpha[8] = { 'X', 'Y', 'Z', 'E', 'A', 'B', 'C', 'D' };
+    if (idle && gcode->has_g) {
+        // the full currents are back before anything can move, the block it queues is only started after this
+        set_currents(currents, false);
+        idle_since_us= us_ticker_read();
+    }
+
     if (gcode->has_m) {
         if (gcode->m == 907) {
             for (int i = 0; i < 8; i++) {
                 if (gcode->has_letter(alpha[i])) {
-                    float c = gcode->get_value(alpha[i]);
-                    this->digipot->set_current(i, c);
+                    currents[i] = gcode->get_value(alpha[i]);
                 }
             }
+            // all the channels given are written together
+            set_currents(currents, idle);
 
         } else if(gcode->m == 500 || gcode->m == 503) {
-            float currents[8];
             bool has_setting= false;
             for (int i = 0; i < 8; i++) {
-                currents[i]= this->digipot->get_current(i);
                 if(currents[i] >= 0) has_setting= true;
             }
             if(!has_setting) return; // don't oupuit anything if none are set using this current control
@@ -12,9 +12,19 @@ class CurrentControl : public Module {
 
         void on_module_loaded();
         void on_gcode_received(void *);
+        void on_idle(void *);
+        void on_enable(void *);
 
     private:
+        void set_currents(const float c[], bool idle);
+
         DigipotBase* digipot;
+        float currents[8];              // as set by the config or M907, the ones written are less while idle
+        float idle_factor;              // Setting : the currents are multiplied by this once the steppers have been idle
+        uint32_t idle_timeout_us;
+        uint32_t idle_since_us;
+        bool idle;                      // the idle currents are set
+        volatile bool enabled;          // the stepper enable pins are on, set from ON_ENABLE which may be in an interrupt
 
 };
 
@@ -1,12 +1,21 @@
 #ifndef DIGIPOTBASE_H
 #define DIGIPOTBASE_H
 
+#include <stdint.h>
+
 class DigipotBase {
     public:
         DigipotBase(){}
         virtual ~DigipotBase(){}
 
         virtual void set_current( int channel, float current )= 0;
+        // sets the channels in mask to their current in c, a chip that can write several in one transaction overrides this
+        virtual void set_currents( const float c[], uint32_t mask )
+        {
+            for (int i = 0; i < 8; i++) {
+                if(mask & (1 << i)) set_current(i, c[i]);
+            }
+        }
         virtual float get_current(int channel)= 0;
         void set_max_current(float c) { max_current= c; }
         void set_factor(float f) { factor= f; }
@@ -44,6 +44,31 @@ class MCP4451 : public DigipotBase {
             this->i2c_send( addr, addresses[channel], this->current_to_wiper(current) );
         }
 
+        // all the wipers of a chip are written in one transaction, with continuous write commands
+        void set_currents( const float c[], uint32_t mask )
+        {
+            const char addresses[4] = { 0x00, 0x10, 0x60, 0x70 };
+            for (int chip = 0; chip < 2; chip++) {
+                char buf[12];
+                int n= 0;
+                // Initial setup
+                buf[n++]= 0x40; buf[n++]= 0xff;
+                buf[n++]= 0xA0; buf[n++]= 0xff;
+                for (int i = 0; i < 4; i++) {
+                    int channel= chip * 4 + i;
+                    if(!(mask & (1 << channel))) continue;
+                    if(c[channel] < 0) {
+                        currents[channel]= -1;
+                        continue;
+                    }
+                    currents[channel]= min( (float) max( c[channel], 0.0f ), this->max_current );
+                    buf[n++]= addresses[i];
+                    buf[n++]= this->current_to_wiper(currents[channel]);
+                }
+                if(n > 4) this->i2c->write(0x58 + chip * 2, buf, n);
+            }
+        }
+
         float get_current(int channel)
         {
             return currents[channel];
@@ -0,0 +1,228 @@
+#include "EncoderFeedback.h"
+
+#include "libs/Kernel.h"
+#include "Robot.h"
+#include "StepperMotor.h"
+#include "Gcode.h"
+#include "Config.h"
+#include "ConfigValue.h"
+#include "checksumm.h"
+#include "StreamOutputPool.h"
+#include "InterruptIn.h" // mbed
+#include "cmsis.h"
+
+#include <math.h>
+
+#define encoder_feedback_checksum   CHECKSUM("encoder_feedback")
+#define enable_checksum             CHECKSUM("enable")
+#define a_pin_checksum              CHECKSUM("a_pin")
+#define b_pin_checksum              CHECKSUM("b_pin")
+#define qei_checksum                CHECKSUM("qei")
+#define counts_per_mm_checksum      CHECKSUM("counts_per_mm")
+#define correct_error_checksum      CHECKSUM("correct_error")
+#define halt_error_checksum         CHECKSUM("halt_error")
+
+// the sections are named for the actuator they check
+static const uint16_t actuator_names[]= {
+    CHECKSUM("alpha"), CHECKSUM("beta"), CHECKSUM("gamma"), CHECKSUM("delta"), CHECKSUM("epsilon"), CHECKSUM("zeta")
+};
+static const char *actuator_labels[]= { "alpha", "beta", "gamma", "delta", "epsilon", "zeta" };
+
+// the counts to add for the change of the A and B pins from the old state to the new one, indexed by old << 2 | new
+static const int8_t quadrature[16]= { 0, 1, -1, 0, -1, 0, 0, 1, 1, 0, 0, -1, 0, -1, 1, 0 };
+
+EncoderFeedback::Encoder::Encoder()
+{
+    motor= nullptr;
+    a_irq= nullptr;
+    b_irq= nullptr;
+    max_error= 0;
+    count_ref= 0;
+    steps_ref= 0;
+    corrections= 0;
+    count= 0;
+    resets= 0;
+    state= 0;
+    qei= false;
+}
+
+EncoderFeedback::Encoder::~Encoder()
+{
+    delete a_irq;
+    delete b_irq;
+}
+
+int32_t EncoderFeedback::Encoder::read() const
+{
+    // the QEI counts down past 0 to its maximum position, which is -1 as a signed count
+    if(qei) return (int32_t)LPC_QEI->QEIPOS;
+    return count;
+}
+
+// on both edges of both pins
+void EncoderFeedback::Encoder::on_edge()
+{
+    uint8_t now= (a_pin.get() ? 2 : 0) | (b_pin.get() ? 1 : 0);
+    count += quadrature[(state << 2) | now];
+    state= now;
+}
+
+// from here on the encoder and the steps are taken to agree
+void EncoderFeedback::Encoder::start_again()
+{
+    __disable_irq();
+    count_ref= read();
+    steps_ref= motor->get_current_position_steps();
+    __enable_irq();
+    resets= motor->get_position_resets();
+}
+
+// in mm, how far the motor is ahead of where its steps put it
+float EncoderFeedback::Encoder::following_error() const
+{
+    __disable_irq();
+    int32_t counts= read() - count_ref;
+    int32_t steps= motor->get_current_position_steps() - steps_ref;
+    __enable_irq();
+    return counts / counts_per_mm - steps / motor->get_steps_per_mm();
+}
+
+EncoderFeedback::EncoderFeedback()
+{
+}
+
+void EncoderFeedback::on_module_loaded()
+{
+    std::vector<uint16_t> names;
+    THEKERNEL->config->get_module_list(&names, encoder_feedback_checksum);
+
+    for(auto name : names) {
+        if(!THEKERNEL->config->value(encoder_feedback_checksum, name, enable_checksum)->by_default(false)->as_bool()) continue;
+        uint8_t actuator= 0;
+        while(actuator < sizeof(actuator_names) / sizeof(actuator_names[0]) && actuator_names[actuator] != name) ++actuator;
+        if(actuator >= THEKERNEL->robot->actuators.size()) {
+            THEKERNEL->streams->printf("ERROR: encoder_feedback sections are named alpha to zeta for the actuators there are\n");
+            continue;
+        }
+        add_encoder(name, actuator);
+    }
+
+    if(encoders.empty()) {
+        delete this;
+        return;
+    }
+
+    register_for_event(ON_IDLE);
+    register_for_event(ON_HALT);
+    register_for_event(ON_GCODE_RECEIVED);
+}
+
+void EncoderFeedback::add_encoder(uint16_t name, uint8_t actuator)
+{
+    Encoder *e= new Encoder;
+    e->actuator= actuator;
+    e->motor= THEKERNEL->robot->actuators[actuator];
+    // negative when it counts the other way to the motor
+    e->counts_per_mm= THEKERNEL->config->value(encoder_feedback_checksum, name, counts_per_mm_checksum)->by_default(0)->as_number();
+    e->correct_error= THEKERNEL->config->value(encoder_feedback_checksum, name, correct_error_checksum)->by_default(0.05F)->as_number();
+    e->halt_error= THEKERNEL->config->value(encoder_feedback_checksum, name, halt_error_checksum)->by_default(1.0F)->as_number();
+    e->qei= THEKERNEL->config->value(encoder_feedback_checksum, name, qei_checksum)->by_default(false)->as_bool();
+
+    const char *error= nullptr;
+    if(e->counts_per_mm == 0) {
+        error= "needs counts_per_mm";
+
+    } else if(e->qei) {
+        // there is the one QEI, on 1.20 and 1.23
+        for(auto o : encoders) {
+            if(o->qei) error= "can only use the QEI for one actuator";
+        }
+        if(error == nullptr) start_qei();
+
+    } else {
+        e->a_pin.from_string(THEKERNEL->config->value(encoder_feedback_checksum, name, a_pin_checksum)->by_default("nc")->as_string());
+        e->b_pin.from_string(THEKERNEL->config->value(encoder_feedback_checksum, name, b_pin_checksum)->by_default("nc")->as_string());
+        e->a_irq= e->a_pin.interrupt_pin();
+        e->b_irq= e->b_pin.interrupt_pin();
+        if(e->a_irq == nullptr || e->b_irq == nullptr) {
+            error= "needs the a_pin and b_pin on port 0 or 2, or the qei";
+        } else {
+            e->state= (e->a_pin.get() ? 2 : 0) | (e->b_pin.get() ? 1 : 0);
+            e->a_irq->rise(e, &Encoder::on_edge);
+            e->a_irq->fall(e, &Encoder::on_edge);
+            e->b_irq->rise(e, &Encoder::on_edge);
+            e->b_irq->fall(e, &Encoder::on_edge);
+        }
+    }
+
+    if(error != nullptr) {
+        THEKERNEL->streams->printf("ERROR: encoder_feedback.%s %s\n", actuator_labels[actuator], error);
+        delete e;
+        return;
+    }
+
+    e->start_again();
+    encoders.push_back(e);
+}
+
+void EncoderFeedback::start_qei()
+{
+    LPC_SC->PCONP |= 1 << 18;                   // PCQEI
+    // P1.20 MCI0 and P1.23 MCI1
+    LPC_PINCON->PINSEL3= (LPC_PINCON->PINSEL3 & ~((3 << 8) | (3 << 14))) | (1 << 8) | (1 << 14);
+    LPC_QEI->QEICONF= 1 << 2;                   // CAPMODE, count the edges of both A and B
+    LPC_QEI->QEIMAXPOS= 0xFFFFFFFF;
+    LPC_QEI->QEICON= 1;                         // reset the position
+}
+
+void EncoderFeedback::on_idle(void *argument)
+{
+    if(THEKERNEL->is_halted()) return;
+
+    for(auto e : encoders) {
+        // homed or its steps per mm changed, the steps are not to be compared with what was counted before, and a motor
+        // that is off may be turned by hand
+        if(e->resets != e->motor->get_position_resets() || !e->motor->is_enabled()) {
+            e->start_again();
+            continue;
+        }
+
+        float error= e->following_error();
+        if(fabsf(error) > e->max_error) e->max_error= fabsf(error);
+
+        if(e->halt_error > 0 && fabsf(error) >= e->halt_error) {
+            THEKERNEL->call_event(ON_HALT, nullptr);
+            THEKERNEL->streams->printf("!! encoder_feedback: %s is %1.3fmm from where it was stepped to - home and M999 to continue\r\n", actuator_labels[e->actuator], error);
+            return;
+        }
+
+        // between moves the motor is not lagging behind the steps, so what is left is steps that were lost
+        if(e->correct_error > 0 && fabsf(error) >= e->correct_error && !e->motor->is_moving()) {
+            int32_t steps= lroundf(error * e->motor->get_steps_per_mm());
+            if(steps != 0) {
+                e->motor->correct_position(steps);
+                ++e->corrections;
+            }
+        }
+    }
+}
+
+// the position held is the one to go on from when the halt is cleared
+void EncoderFeedback::on_halt(void *argument)
+{
+    if(argument == nullptr) return;
+    for(auto e : encoders) e->start_again();
+}
+
+// M122 reports the following errors, the largest since the last report and the corrections made
+void EncoderFeedback::on_gcode_received(void *argument)
+{
+    Gcode *gcode= static_cast<Gcode *>(argument);
+    if(!gcode->has_m || gcode->m != 122) return;
+
+    for(auto e : encoders) {
+        gcode->stream->printf("encoder %s: error %1.4fmm max %1.4fmm corrections %lu\n", actuator_labels[e->actuator],
+                              e->following_error(), e->max_error, (unsigned long)e->corrections);
+        e->max_error= 0;
+    }
+}
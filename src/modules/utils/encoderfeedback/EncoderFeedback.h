@@ -0,0 +1,63 @@
+#ifndef _ENCODERFEEDBACK_H
+#define _ENCODERFEEDBACK_H
+
+#include "libs/Module.h"
+#include "libs/Pin.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace mbed {
+    class InterruptIn;
+}
+class StepperMotor;
+
+// Checks the actuators against encoders on their motors or axes. Each encoder is counted from its A and B pins on
+// interrupts, or by the QEI, and compared with the steps the motor was given. A following error of more than
+// halt_error halts, one of more than correct_error, found while the motor is between moves, is taken to be where the
+// motor really is and the next move planned makes the difference up.
+class EncoderFeedback : public Module {
+    public:
+        EncoderFeedback();
+
+        void on_module_loaded();
+        void on_idle(void *argument);
+        void on_halt(void *argument);
+        void on_gcode_received(void *argument);
+
+    private:
+        class Encoder {
+            public:
+                Encoder();
+                ~Encoder();
+                int32_t read() const;
+                void on_edge();
+                void start_again();
+                float following_error() const;
+
+                StepperMotor *motor;
+                Pin a_pin;
+                Pin b_pin;
+                mbed::InterruptIn *a_irq;
+                mbed::InterruptIn *b_irq;
+                float counts_per_mm;
+                float correct_error;        // Setting : mm
+                float halt_error;           // Setting : mm
+                float max_error;            // seen since it was last reported
+                int32_t count_ref;          // the count and the steps when they were known to agree
+                int32_t steps_ref;
+                uint32_t corrections;
+                volatile int32_t count;
+                uint8_t resets;             // the position resets of the motor when they were taken
+                uint8_t state;              // of the A and B pins
+                uint8_t actuator;
+                bool qei;
+        };
+
+        void add_encoder(uint16_t name, uint8_t actuator);
+        void start_qei();
+
+        std::vector<Encoder *> encoders;
+};
+
+#endif
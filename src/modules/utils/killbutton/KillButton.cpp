@@ -9,6 +9,7 @@
 #include "checksumm.h"
 #include "ConfigValue.h"
 #include "StreamOutputPool.h"
+#include "PinChange.h"
 
 using namespace std;
 
@@ -47,11 +48,14 @@ void KillButton::on_module_loaded()
         return;
     }
 
-    this->register_for_event(ON_IDLE);
+    this->register_for_event(ON_MAIN_LOOP);
+    this->set_event_rate(ON_MAIN_LOOP, 0, true); // woken when the button kills or unkills
     THEKERNEL->slow_ticker->attach( 5, this, &KillButton::button_tick );
+    // a press on port 0 or 2 kills as soon as it settles rather than on the next tick
+    PinChange::attach(this->kill_button, [this](bool up) { button_changed(up); }, 10);
 }
 
-void KillButton::on_idle(void *argument)
+void KillButton::on_main_loop(void *argument)
 {
     if(state == KILL_BUTTON_DOWN) {
         if(!THEKERNEL->is_halted()) {
@@ -75,7 +79,10 @@ uint32_t KillButton::button_tick(uint32_t dummy)
 
     switch(state) {
             case IDLE:
-                if(!this->kill_button.get()) state= KILL_BUTTON_DOWN;
+                if(!this->kill_button.get()) {
+                    state= KILL_BUTTON_DOWN;
+                    wake_for_event(ON_MAIN_LOOP);
+                }
                 else if(unkill_enable && killed) state= KILLED_BUTTON_UP; // allow kill button to unkill if kill was created fromsome other source
                 break;
             case KILL_BUTTON_DOWN:
@@ -93,7 +100,10 @@ uint32_t KillButton::button_tick(uint32_t dummy)
                 state= UNKILL_TIMING_BUTTON_DOWN;
                 break;
             case UNKILL_TIMING_BUTTON_DOWN:
-                if(++unkill_timer > 5*2) state= UNKILL_FIRE;
+                if(++unkill_timer > 5*2) {
+                    state= UNKILL_FIRE;
+                    wake_for_event(ON_MAIN_LOOP);
+                }
                 else if(this->kill_button.get()) unkill_timer= 0;
                 if(!killed) state= IDLE;
                 break;
@@ -107,3 +117,12 @@ uint32_t KillButton::button_tick(uint32_t dummy)
 
     return 0;
 }
+
+// in the pin interrupt, the rest of the FSM goes on in button_tick
+void KillButton::button_changed(bool up)
+{
+    if(!up && state == IDLE && !THEKERNEL->is_halted()) {
+        state= KILL_BUTTON_DOWN;
+        wake_for_event(ON_MAIN_LOOP);
+    }
+}
@@ -7,8 +7,9 @@ class KillButton : public Module {
         KillButton();
 
         void on_module_loaded();
-        void on_idle(void *argument);
+        void on_main_loop(void *argument);
         uint32_t button_tick(uint32_t dummy);
+        void button_changed(bool up);
 
     private:
         Pin kill_button;
@@ -0,0 +1,214 @@
+#include "MotionSync.h"
+
+#include "libs/Kernel.h"
+#include "Conveyor.h"
+#include "Gcode.h"
+#include "Config.h"
+#include "ConfigValue.h"
+#include "checksumm.h"
+#include "StreamOutputPool.h"
+#include "InterruptIn.h" // mbed
+#include "Serial.h" // mbed
+#include "port_api.h" // mbed
+#include "us_ticker_api.h"
+#include "cmsis.h"
+
+#include <string.h>
+#include <algorithm>
+
+using namespace std;
+
+#define motion_sync_checksum    CHECKSUM("motion_sync")
+#define enable_checksum         CHECKSUM("enable")
+#define role_checksum           CHECKSUM("role")
+#define sync_pin_checksum       CHECKSUM("sync_pin")
+#define ready_pin_checksum      CHECKSUM("ready_pin")
+#define tx_pin_checksum         CHECKSUM("tx_pin")
+#define rx_pin_checksum         CHECKSUM("rx_pin")
+#define baud_rate_checksum      CHECKSUM("baud_rate")
+#define max_unanswered_checksum CHECKSUM("max_unanswered")
+#define timeout_checksum        CHECKSUM("timeout_ms")
+
+MotionSync::MotionSync()
+{
+    edge_irq= nullptr;
+    uart= nullptr;
+    gated_at_us= 0;
+    pending_edges= 0;
+    unanswered= 0;
+    rx_column= 0;
+    rx_first= 0;
+    follower_error= false;
+    sync_level= false;
+}
+
+void MotionSync::on_module_loaded()
+{
+    if(!THEKERNEL->config->value(motion_sync_checksum, enable_checksum)->by_default(false)->as_bool()) {
+        delete this;
+        return;
+    }
+
+    master= THEKERNEL->config->value(motion_sync_checksum, role_checksum)->by_default("master")->as_string() != "follower";
+    timeout_us= THEKERNEL->config->value(motion_sync_checksum, timeout_checksum)->by_default(2000)->as_number() * 1000;
+
+    // the master waits for the ready line and drives the sync line, the followers the other way round
+    string sync= THEKERNEL->config->value(motion_sync_checksum, sync_pin_checksum)->by_default("nc")->as_string();
+    string ready= THEKERNEL->config->value(motion_sync_checksum, ready_pin_checksum)->by_default("nc")->as_string();
+    Pin edge_pin;
+    edge_pin.from_string(master ? ready : sync);
+    edge_irq= edge_pin.interrupt_pin();
+    if(edge_irq == nullptr) {
+        THEKERNEL->streams->printf("ERROR: motion_sync needs the %s pin on port 0 or 2\n", master ? "ready" : "sync");
+        delete this;
+        return;
+    }
+
+    if(master) {
+        // InterruptIn pulls the pin down, the ready line must have the pull up the config gives it
+        ready_pin.from_string(ready)->as_input();
+        sync_pin.from_string(sync)->as_output();
+        sync_pin.set(false);
+        edge_irq->rise(this, &MotionSync::on_ready_rise);
+
+        Pin tx, rx;
+        tx.from_string(THEKERNEL->config->value(motion_sync_checksum, tx_pin_checksum)->by_default("0.15")->as_string());
+        rx.from_string(THEKERNEL->config->value(motion_sync_checksum, rx_pin_checksum)->by_default("0.16")->as_string());
+        uart= new mbed::Serial(port_pin((PortName)tx.port_number, tx.pin), port_pin((PortName)rx.port_number, rx.pin));
+        uart->baud(THEKERNEL->config->value(motion_sync_checksum, baud_rate_checksum)->by_default(115200)->as_number());
+        uart->attach(this, &MotionSync::on_uart_rx, mbed::Serial::RxIrq);
+        max_unanswered= std::max(1, THEKERNEL->config->value(motion_sync_checksum, max_unanswered_checksum)->by_default(2)->as_int());
+
+        THEKERNEL->conveyor->set_begin_gate([this]() { return master_gate(); });
+        register_for_event(ON_GCODE_RECEIVED);
+        // sent on before this board plans it, so the followers are never behind by more than the lines in flight
+        set_event_priority(ON_GCODE_RECEIVED, PRIORITY_FEED);
+
+    } else {
+        // the ready line is open drain so it is only high once every follower lets go of it
+        ready_pin.from_string(ready)->as_open_drain();
+        ready_pin.set(false);
+        edge_irq->rise(this, &MotionSync::on_sync_edge);
+        edge_irq->fall(this, &MotionSync::on_sync_edge);
+        THEKERNEL->conveyor->set_begin_gate([this]() { return follower_gate(); });
+    }
+
+    // the edge begins the block, so it has to be at the priority of PendSV where blocks otherwise begin
+    NVIC_SetPriority(EINT3_IRQn, NVIC_GetPriority(PendSV_IRQn));
+
+    register_for_event(ON_IDLE);
+    register_for_event(ON_HALT);
+}
+
+// a block begins now if the followers have theirs waiting, they start it on the sync edge
+bool MotionSync::master_gate()
+{
+    __disable_irq();
+    bool ready= ready_pin.get();
+    if(ready) {
+        sync_level= !sync_level;
+        sync_pin.set(sync_level);
+    }
+    __enable_irq();
+    if(!ready) gated_at_us= us_ticker_read();
+    return ready;
+}
+
+void MotionSync::on_ready_rise()
+{
+    if(!THEKERNEL->conveyor->is_gated()) return;
+    sync_level= !sync_level;
+    sync_pin.set(sync_level);
+    THEKERNEL->conveyor->open_gate();
+}
+
+// the block waits for the master unless the edge for it has come already
+bool MotionSync::follower_gate()
+{
+    __disable_irq();
+    bool go= pending_edges > 0;
+    if(go) --pending_edges;
+    else ready_pin.set(true);
+    __enable_irq();
+    return go;
+}
+
+void MotionSync::on_sync_edge()
+{
+    if(THEKERNEL->conveyor->is_gated()) {
+        ready_pin.set(false);
+        THEKERNEL->conveyor->open_gate();
+    } else if(pending_edges < 255) {
+        ++pending_edges;
+    }
+}
+
+// counts the lines from the follower that start with ok, one error stops the master too
+void MotionSync::on_uart_rx()
+{
+    while(uart->readable()) {
+        char c= uart->getc();
+        if(c == '\n') {
+            rx_column= 0;
+            continue;
+        }
+        if(rx_column == 0) rx_first= c;
+        else if(rx_column == 1) {
+            if(rx_first == 'o' && c == 'k' && unanswered > 0) --unanswered;
+            else if(rx_first == '!' && c == '!') follower_error= true;
+        }
+        if(rx_column < 255) ++rx_column;
+    }
+}
+
+void MotionSync::send(const char *line)
+{
+    for(const char *p= line; *p != '\0'; ++p) uart->putc(*p);
+    uart->putc('\n');
+}
+
+void MotionSync::on_gcode_received(void *argument)
+{
+    Gcode *gcode= static_cast<Gcode *>(argument);
+    if(THEKERNEL->is_halted()) return;
+
+    uint32_t start= us_ticker_read();
+    while(unanswered >= max_unanswered) {
+        if(us_ticker_read() - start > timeout_us) {
+            THEKERNEL->call_event(ON_HALT, nullptr);
+            THEKERNEL->streams->printf("!! motion_sync: a follower did not answer - reset or M999 to continue\r\n");
+            return;
+        }
+        THEKERNEL->call_event(ON_IDLE, this);
+    }
+    __disable_irq();
+    ++unanswered;
+    __enable_irq();
+    send(gcode->get_command());
+}
+
+void MotionSync::on_idle(void *argument)
+{
+    if(!master || THEKERNEL->is_halted()) return;
+
+    const char *why= nullptr;
+    if(follower_error) why= "a follower is halted";
+    else if(THEKERNEL->conveyor->is_gated() && us_ticker_read() - gated_at_us > timeout_us) why= "the followers are not ready";
+    if(why != nullptr) {
+        THEKERNEL->call_event(ON_HALT, nullptr);
+        THEKERNEL->streams->printf("!! motion_sync: %s - reset or M999 to continue\r\n", why);
+    }
+}
+
+// the followers halt and carry on with the master
+void MotionSync::on_halt(void *argument)
+{
+    if(master) {
+        follower_error= false;
+        unanswered= 0;
+        send(argument == nullptr ? "M112" : "M999");
+    } else {
+        pending_edges= 0;
+        ready_pin.set(false);
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef _MOTIONSYNC_H
+#define _MOTIONSYNC_H
+
+#include "libs/Module.h"
+#include "libs/Pin.h"
+
+#include <stdint.h>
+
+namespace mbed {
+    class InterruptIn;
+    class Serial;
+}
+
+// Several boards move as one machine, each driving its own motors. The master sends every gcode it gets to the followers
+// over a UART wired to their serial console, so they all plan the same blocks, and the blocks start on all boards together:
+// the followers let go of the shared ready line once their next block is waiting, and the master starts its own when the
+// line is high and toggles the sync line, which starts theirs. The followers have the same config apart from their pins.
+class MotionSync : public Module {
+    public:
+        MotionSync();
+
+        void on_module_loaded();
+        void on_gcode_received(void *argument);
+        void on_idle(void *argument);
+        void on_halt(void *argument);
+
+    private:
+        bool master_gate();
+        bool follower_gate();
+        void on_ready_rise();
+        void on_sync_edge();
+        void on_uart_rx();
+        void send(const char *line);
+
+        Pin sync_pin;
+        Pin ready_pin;
+        mbed::InterruptIn *edge_irq;
+        mbed::Serial *uart;
+
+        uint32_t gated_at_us;
+        uint32_t timeout_us;
+        volatile uint8_t pending_edges;     // sync edges seen before the block they start was waiting
+        volatile uint8_t unanswered;        // lines sent that the follower has not said ok to
+        uint8_t max_unanswered;
+        uint8_t rx_column;                  // of the character read from the follower, 0 is the start of a line
+        char rx_first;
+
+        struct {
+            bool master:1;
+            volatile bool follower_error:1;
+            bool sync_level:1;
+        };
+};
+
+#endif
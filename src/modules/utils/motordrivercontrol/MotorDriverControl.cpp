@@ -6,21 +6,24 @@
 #include "libs/StreamOutput.h"
 #include "libs/StreamOutputPool.h"
 #include "Robot.h"
+#include "Conveyor.h"
+#include "StepTicker.h"
 #include "StepperMotor.h"
 #include "PublicDataRequest.h"
+#include "PublicData.h"
+#include "MotorDriverControlPublicAccess.h"
 
 #include "Gcode.h"
 #include "Config.h"
 #include "checksumm.h"
 
-#include "mbed.h" // for SPI
+#include "mbed.h" // for SPI and us_ticker_read()
 
 #include "drivers/TMC26X/TMC26X.h"
 #include "drivers/DRV8711/drv8711.h"
 
 #include <string>
 
-#define motor_driver_control_checksum  CHECKSUM("motor_driver_control")
 #define enable_checksum                CHECKSUM("enable")
 #define chip_checksum                  CHECKSUM("chip")
 #define designator_checksum            CHECKSUM("designator")
@@ -29,8 +32,17 @@
 
 #define current_checksum               CHECKSUM("current")
 #define max_current_checksum           CHECKSUM("max_current")
+#define hold_current_checksum          CHECKSUM("hold_current")
+#define hold_delay_checksum            CHECKSUM("hold_delay")
+#define load_current_min_checksum      CHECKSUM("load_current_min")
+#define load_sg_low_checksum           CHECKSUM("load_sg_low")
+#define load_sg_high_checksum          CHECKSUM("load_sg_high")
+#define load_min_rate_checksum         CHECKSUM("load_min_rate")
+#define load_interval_checksum         CHECKSUM("load_interval")
 
 #define microsteps_checksum            CHECKSUM("microsteps")
+#define auto_microsteps_checksum       CHECKSUM("auto_microsteps")
+#define auto_microsteps_rate_checksum  CHECKSUM("auto_microsteps_rate")
 #define decay_mode_checksum            CHECKSUM("decay_mode")
 
 #define raw_register_checksum          CHECKSUM("reg")
@@ -39,9 +51,41 @@
 #define spi_cs_pin_checksum            CHECKSUM("spi_cs_pin")
 #define spi_frequency_checksum         CHECKSUM("spi_frequency")
 
+// the max rates of the actuators, as Robot reads them
+static const uint16_t max_rate_checksums[]= {
+    CHECKSUM("alpha_max_rate"), CHECKSUM("beta_max_rate"), CHECKSUM("gamma_max_rate"),
+    CHECKSUM("delta_max_rate"), CHECKSUM("epsilon_max_rate"), CHECKSUM("zeta_max_rate")
+};
+
+// the CMSIS header the firmware is built with has no BASEPRI functions for GCC
+static inline uint32_t get_basepri()
+{
+    uint32_t r;
+    __asm volatile ("mrs %0, basepri" : "=r" (r));
+    return r;
+}
+
+static inline void set_basepri(uint32_t v)
+{
+    __asm volatile ("msr basepri, %0" : : "r" (v) : "memory");
+}
+
+// fastest rate the stallguard telemetry can be asked for
+#define MAX_TELEMETRY_HZ 200
+
+std::vector<MotorDriverControl*> MotorDriverControl::instances;
+StreamOutput *MotorDriverControl::telemetry_stream= nullptr;
+uint32_t MotorDriverControl::telemetry_interval_us= 0;
+uint32_t MotorDriverControl::last_sweep_us= 0;
+bool MotorDriverControl::sweeping= false;
+uint32_t MotorDriverControl::last_active_us= 0;
+uint32_t MotorDriverControl::load_interval_us= 0;
+uint32_t MotorDriverControl::last_load_us= 0;
+
 MotorDriverControl::MotorDriverControl(uint8_t id) : id(id)
 {
     enable_event= false;
+    holding= false;
     current_override= false;
     microstep_override= false;
 }
@@ -137,11 +181,34 @@ bool MotorDriverControl::config_module(uint16_t cs)
 
     current= THEKERNEL->config->value(motor_driver_control_checksum, cs, current_checksum )->by_default(1000)->as_number(); // in mA
     microsteps= THEKERNEL->config->value(motor_driver_control_checksum, cs, microsteps_checksum )->by_default(16)->as_number(); // 1/n
+    hold_current= THEKERNEL->config->value(motor_driver_control_checksum, cs, hold_current_checksum )->by_default(0)->as_number(); // in mA
+    hold_delay_us= THEKERNEL->config->value(motor_driver_control_checksum, cs, hold_delay_checksum )->by_default(1000)->as_number() * 1000; // in ms
+
+    // the current follows the load the stallguard readings show, from current down to load_current_min
+    load_current_min= THEKERNEL->config->value(motor_driver_control_checksum, cs, load_current_min_checksum )->by_default(0)->as_number(); // in mA
+    load_sg_low= THEKERNEL->config->value(motor_driver_control_checksum, cs, load_sg_low_checksum )->by_default(100)->as_number();
+    load_sg_high= THEKERNEL->config->value(motor_driver_control_checksum, cs, load_sg_high_checksum )->by_default(300)->as_number();
+    load_min_rate= THEKERNEL->config->value(motor_driver_control_checksum, cs, load_min_rate_checksum )->by_default(1000)->as_number(); // steps/sec
+    load_current= current;
+    if(load_current_min > 0) {
+        int a= designator - 'A';
+        if(chip != TMC2660 || a < 0 || a >= (int)THEKERNEL->robot->actuators.size()) {
+            THEKERNEL->streams->printf("MotorDriverControl ERROR: load_current_min needs a TMC2660 with the designator of an actuator\n");
+            load_current_min= 0;
+        } else {
+            load_interval_us= THEKERNEL->config->value(motor_driver_control_checksum, cs, load_interval_checksum )->by_default(20)->as_number() * 1000; // in ms
+        }
+    }
     //decay_mode= THEKERNEL->config->value(motor_driver_control_checksum, cs, decay_mode_checksum )->by_default(1)->as_number();
 
     // setup the chip via SPI
     initialize_chip();
 
+    // the blocks that would step faster than auto_microsteps_rate are stepped coarser, down to auto_microsteps
+    auto_microsteps= THEKERNEL->config->value(motor_driver_control_checksum, cs, auto_microsteps_checksum )->by_default(0)->as_number(); // 1/n
+    auto_microsteps_rate= THEKERNEL->config->value(motor_driver_control_checksum, cs, auto_microsteps_rate_checksum )->by_default(THEKERNEL->base_stepping_frequency / 4.0F)->as_number(); // steps/sec
+    if(auto_microsteps > 0 && auto_microsteps < microsteps) start_auto_microsteps();
+
     // if raw registers are defined set them 1,2,3 etc in hex
     str= THEKERNEL->config->value( motor_driver_control_checksum, cs, raw_register_checksum)->by_default("")->as_string();
     if(!str.empty()) {
@@ -162,6 +229,7 @@ bool MotorDriverControl::config_module(uint16_t cs)
     this->register_for_event(ON_HALT);
     this->register_for_event(ON_ENABLE);
     this->register_for_event(ON_IDLE);
+    this->set_event_priority(ON_IDLE, PRIORITY_HOUSEKEEPING);
 
     if( THEKERNEL->config->value(motor_driver_control_checksum, cs, alarm_checksum )->by_default(false)->as_bool() ) {
         halt_on_alarm= THEKERNEL->config->value(motor_driver_control_checksum, cs, halt_on_alarm_checksum )->by_default(false)->as_bool();
@@ -169,6 +237,20 @@ bool MotorDriverControl::config_module(uint16_t cs)
         this->register_for_event(ON_SECOND_TICK);
     }
 
+    if(chip == TMC2660) {
+        // Endstops reads the stallguard flag to home without switches
+        PublicData::register_handler(this, motor_driver_control_checksum);
+    }
+
+    if(hold_current > 0) {
+        bool hooked= false;
+        for(auto d : instances) hooked |= (d->hold_current > 0);
+        // one hook puts all the drivers back to their current before the next block can start
+        if(!hooked) THEKERNEL->conveyor->add_start_hook(&MotorDriverControl::restore_currents);
+    }
+
+    instances.push_back(this);
+
     THEKERNEL->streams->printf("MotorDriverControl INFO: configured motor %c (%d): as %s, cs: %04X\n", designator, id, chip==TMC2660?"TMC2660":chip==DRV8711?"DRV8711":"UNKNOWN", (spi_cs_pin.port_number<<8)|spi_cs_pin.pin);
 
     return true;
@@ -188,6 +270,115 @@ void MotorDriverControl::on_idle(void *argument)
         enable_event= false;
         enable(enable_flg);
     }
+
+    // a stream with a full output buffer calls on_idle while it waits
+    if(telemetry_stream != nullptr && !sweeping && this == instances[0] && us_ticker_read() - last_sweep_us >= telemetry_interval_us) {
+        last_sweep_us= us_ticker_read();
+        sweeping= true;
+        sweep();
+        sweeping= false;
+    }
+
+    if(load_interval_us > 0 && !sweeping && this == instances[0] && us_ticker_read() - last_load_us >= load_interval_us) {
+        last_load_us= us_ticker_read();
+        sweeping= true;
+        adapt_currents();
+        sweeping= false;
+    }
+
+    if(this == instances[0] && (!THEKERNEL->conveyor->is_queue_empty() || THEKERNEL->step_ticker->has_active_motors())) {
+        last_active_us= us_ticker_read();
+    }
+
+    // drop to the hold current once the motors have been still for a while, SPI has to be done here not in an ISR
+    if(hold_current > 0 && !holding && us_ticker_read() - last_active_us >= hold_delay_us) {
+        holding= true;
+        set_current(std::min(hold_current, current));
+    }
+}
+
+// called by the Conveyor as a block is queued, the run current is back before the block can start
+void MotorDriverControl::restore_currents()
+{
+    last_active_us= us_ticker_read();
+    for(auto d : instances) {
+        if(d->holding) {
+            d->holding= false;
+            d->load_current= d->current;
+            d->set_current(d->current);
+        }
+    }
+}
+
+void MotorDriverControl::adapt_currents()
+{
+    for(auto d : instances) {
+        if(d->load_current_min > 0 && !d->holding) d->adapt_current();
+    }
+}
+
+// one stallguard reading, the current goes up fast under a heavy load so the motor does not stall, and comes down slowly
+// under a light one. Too slow for the reading to mean anything it goes back to the run current, ready for the next move
+void MotorDriverControl::adapt_current()
+{
+    // the chip's own coolstep is left to do it
+    if(tmc26x->isCoolStepEnabled()) return;
+
+    uint32_t c= load_current;
+    StepperMotor *motor= THEKERNEL->robot->actuators[designator - 'A'];
+    if(current <= load_current_min || !motor->is_moving() || motor->get_steps_per_second() * (1 << motor->get_microstep_shift()) < load_min_rate) {
+        c= current;
+
+    } else {
+        int sg= tmc26x->pollStallGuard();
+        uint32_t range= current - load_current_min;
+        if(sg >= 0 && sg < load_sg_low) {
+            c= std::min(current, c + std::max<uint32_t>(range / 4, 1));
+        } else if(sg > load_sg_high) {
+            uint32_t down= std::max<uint32_t>(range / 32, 1);
+            c= (c > load_current_min + down) ? c - down : load_current_min;
+        }
+    }
+
+    if(c != load_current) {
+        load_current= c;
+        set_current(c);
+    }
+}
+
+// read every driver back to back and send one line of the results, a TMC2660 returns its stallguard value and status
+// bits in the same datagram once the readout is set to stallguard, so that is one transaction per driver.
+// ! marks a driver that has reached its stallguard threshold
+void MotorDriverControl::sweep()
+{
+    char buf[96];
+    size_t n= snprintf(buf, sizeof(buf), "sg");
+    for(auto d : instances) {
+        if(d->chip != TMC2660 || n >= sizeof(buf)) continue;
+        int sg= d->tmc26x->pollStallGuard();
+        n += snprintf(&buf[n], sizeof(buf) - n, " %c:%d%s", d->designator, sg, d->tmc26x->isStallGuardReached() ? "!" : "");
+    }
+    telemetry_stream->printf("%s\n", buf);
+}
+
+void MotorDriverControl::on_get_public_data(void *argument)
+{
+    PublicDataRequest *pdr = static_cast<PublicDataRequest *>(argument);
+
+    if(!pdr->starts_with(motor_driver_control_checksum)) return;
+
+    if(pdr->second_element_is(stallguard_checksum) && pdr->third_element_is(designator)) {
+        // one datagram, the readout stays on stallguard while homing polls it
+        bool *stalled = static_cast<bool *>(pdr->get_data_ptr());
+        tmc26x->pollStallGuard();
+        *stalled = tmc26x->isStallGuardReached();
+        pdr->set_taken();
+    }
+}
+
+void MotorDriverControl::stop_telemetry(StreamOutput *stream)
+{
+    if(telemetry_stream == stream) telemetry_stream= nullptr;
 }
 
 void MotorDriverControl::on_halt(void *argument)
@@ -231,11 +422,16 @@ void MotorDriverControl::on_gcode_received(void *argument)
                 current= gcode->get_value(designator);
                 current= std::min(current, max_current);
                 set_current(current);
+                load_current= current;
+                holding= false;
                 current_override= true;
             }
 
         } else if(gcode->m == 909) { // M909 Annn set microstepping, M909.1 also change steps/mm
-            if (gcode->has_letter(designator)) {
+            if (gcode->has_letter(designator) && auto_microsteps > 0) {
+                gcode->stream->printf("error:the microsteps of %c are switched as it moves, set them in config\n", designator);
+
+            } else if (gcode->has_letter(designator)) {
                 uint32_t current_microsteps= microsteps;
                 microsteps= gcode->get_value(designator);
                 microsteps= set_microstep(microsteps); // driver may change the steps it sets to
@@ -273,8 +469,24 @@ void MotorDriverControl::on_gcode_received(void *argument)
             // M911.3 S3 Zn setDoubleEdge Z=on|off Z1 is on Z0 is off
             // M911.3 S4 Zn setStepInterpolation Z=on|off Z1 is on Z0 is off
             // M911.3 S5 Zn setCoolStepEnabled Z=on|off Z1 is on Z0 is off
+            // M911.4 Snnn stream the stallguard readings at nnn Hz, S0 stops
+
+            // M911.4 Snnn streams the stallguard readings of all the TMC2660 drivers to this stream at nnn Hz, S0 stops it
+            if(gcode->subcode == 4) {
+                if(this != instances[0]) return;
+                int hz= gcode->has_letter('S') ? gcode->get_value('S') : 0;
+                if(hz <= 0) {
+                    stop_telemetry(gcode->stream);
+                    gcode->stream->printf("stallguard telemetry stopped\n");
+                    return;
+                }
+                if(hz > MAX_TELEMETRY_HZ) hz= MAX_TELEMETRY_HZ;
+                telemetry_stream= gcode->stream;
+                telemetry_interval_us= 1000000 / hz;
+                last_sweep_us= us_ticker_read() - telemetry_interval_us;
+                gcode->stream->printf("stallguard telemetry at %d Hz\n", hz);
 
-            if(gcode->subcode == 0 && gcode->get_num_args() == 0) {
+            }else if(gcode->subcode == 0 && gcode->get_num_args() == 0) {
                 // M911 no args dump status for all drivers, M911.1 P0|A0 dump for specific driver
                 gcode->stream->printf("Motor %d (%c)...\n", id, designator);
                 dump_status(gcode->stream, true);
@@ -353,6 +565,27 @@ uint32_t MotorDriverControl::set_microstep( uint32_t n )
     return m;
 }
 
+// the actuator of the designator is stepped in the microsteps each block needs, from microsteps down to auto_microsteps.
+// They are switched from PendSV as a block begins, before it steps the motor
+void MotorDriverControl::start_auto_microsteps()
+{
+    int a= designator - 'A';
+    if(a < 0 || a >= (int)THEKERNEL->robot->actuators.size()) {
+        THEKERNEL->streams->printf("MotorDriverControl ERROR: auto_microsteps needs the designator of an actuator\n");
+        auto_microsteps= 0;
+        return;
+    }
+
+    uint8_t shift= 0;
+    while(shift < 8 && (microsteps >> (shift + 1)) >= auto_microsteps) ++shift;
+    StepperMotor *motor= THEKERNEL->robot->actuators[a];
+    motor->set_microstep_switching(shift, auto_microsteps_rate, [this](uint8_t s) { set_microstep(microsteps >> s); });
+
+    // Robot held the max rate to what the StepTicker can step at the microsteps set, it can go faster now
+    motor->set_max_rate(THEKERNEL->config->value(max_rate_checksums[a])->by_default(30000.0F)->as_number());
+    THEKERNEL->robot->check_max_actuator_speeds();
+}
+
 // TODO how to handle this? SO many options
 void MotorDriverControl::set_decay_mode( uint8_t dm )
 {
@@ -384,6 +617,7 @@ void MotorDriverControl::dump_status(StreamOutput *stream, bool b)
 
         case TMC2660:
             tmc26x->dumpStatus(stream, b);
+            if(b && load_current_min > 0) stream->printf("load current: %lu mA of %lu mA\n", load_current, current);
             break;
     }
 }
@@ -433,11 +667,15 @@ void MotorDriverControl::set_options(Gcode *gcode)
 // Called by the drivers codes to send and receive SPI data to/from the chip
 int MotorDriverControl::sendSPI(uint8_t *b, int cnt, uint8_t *r)
 {
+    // the microsteps are switched from PendSV, which is kept out while the main loop has the bus. The step ISR is above it
+    uint32_t basepri= get_basepri();
+    set_basepri(NVIC_GetPriority(PendSV_IRQn) << (8 - __NVIC_PRIO_BITS));
     spi_cs_pin.set(0);
     for (int i = 0; i < cnt; ++i) {
         r[i]= spi->write(b[i]);
     }
     spi_cs_pin.set(1);
+    set_basepri(basepri);
     return cnt;
 }
 
@@ -4,6 +4,7 @@
 #include "Pin.h"
 
 #include <stdint.h>
+#include <vector>
 
 namespace mbed {
     class SPI;
@@ -25,12 +26,22 @@ class MotorDriverControl : public Module {
         void on_enable(void *argument);
         void on_idle(void *argument);
         void on_second_tick(void *argument);
+        void on_get_public_data(void *argument);
+
+        // a stream that is going away has to stop its stallguard telemetry
+        static void stop_telemetry(StreamOutput *stream);
 
     private:
+        static void sweep();
+        static void adapt_currents();
+        static void restore_currents();
+        void adapt_current();
+
         bool config_module(uint16_t cs);
         void initialize_chip();
         void set_current( uint32_t current );
         uint32_t set_microstep( uint32_t ms );
+        void start_auto_microsteps();
         void set_decay_mode( uint8_t dm );
         void dump_status(StreamOutput*, bool);
         void set_raw_register(StreamOutput *stream, uint32_t reg, uint32_t val);
@@ -42,6 +53,16 @@ class MotorDriverControl : public Module {
         Pin spi_cs_pin;
         mbed::SPI *spi;
 
+        // all the configured drivers, the first one runs the telemetry sweep for all of them
+        static std::vector<MotorDriverControl*> instances;
+        static StreamOutput *telemetry_stream;
+        static uint32_t telemetry_interval_us;
+        static uint32_t last_sweep_us;
+        static bool sweeping;
+        static uint32_t last_active_us; // last time a block was queued or a motor was moving
+        static uint32_t load_interval_us; // between the stallguard readings the currents follow the load from, 0 if none do
+        static uint32_t last_load_us;
+
         enum CHIP_TYPE {
             DRV8711,
             TMC2660
@@ -57,9 +78,19 @@ class MotorDriverControl : public Module {
         //float current_factor;
         uint32_t max_current; // in milliamps
         uint32_t current; // in milliamps
+        uint32_t hold_current; // in milliamps when the motors have been still for hold_delay_us, 0 is off
+        uint32_t hold_delay_us;
+        uint32_t load_current; // in milliamps while the current follows the load, between load_current_min and current
+        uint32_t load_current_min; // 0 is off
+        uint16_t load_sg_low; // a stallguard reading under this is a heavy load, the current goes up
+        uint16_t load_sg_high; // and over this a light one, the current comes down
+        float load_min_rate; // steps/sec the motor has to go at for the stallguard reading to mean anything
         uint32_t microsteps;
+        uint32_t auto_microsteps; // the coarsest the blocks that go fast are stepped at, 0 is off
+        float auto_microsteps_rate; // steps/sec at microsteps above which a block is stepped coarser
 
         char designator;
+        bool holding; // set to hold_current, kept out of the bitfield as enable_event is set in an ISR
 
         struct{
             uint8_t id:4;
@@ -0,0 +1,8 @@
+#pragma once
+
+// addresses used for public data access
+#define motor_driver_control_checksum  CHECKSUM("motor_driver_control")
+#define stallguard_checksum            CHECKSUM("stallguard")
+
+// get_value(motor_driver_control_checksum, stallguard_checksum, designator, &bool) reads the stallguard flag of the
+// TMC2660 with that designator into the bool, it is not taken if there is no such driver
@@ -963,8 +963,14 @@ void TMC26X::dumpStatus(StreamOutput *stream, bool readable)
 // check error bits and report, only report once
 bool TMC26X::check_error_status_bits(StreamOutput *stream)
 {
-    bool error= false;
     readStatus(TMC26X_READOUT_POSITION); // get the status bits
+    return report_error_status_bits(stream);
+}
+
+// report the status bits of the last datagram, they are sent back whatever the readout is set to
+bool TMC26X::report_error_status_bits(StreamOutput *stream)
+{
+    bool error= false;
 
     if (this->getOverTemperature()&TMC26X_OVERTEMPERATURE_PREWARING) {
         if(!error_reported.test(0)) stream->printf("WARNING: Overtemperature Prewarning!\n");
@@ -1020,9 +1026,20 @@ bool TMC26X::check_error_status_bits(StreamOutput *stream)
     return error;
 }
 
+// keep the readout as it is so polling the stallguard value does not have to switch it back each time
 bool TMC26X::checkAlarm()
 {
-    return check_error_status_bits(THEKERNEL->streams);
+    send262(driver_configuration_register_value);
+    return report_error_status_bits(THEKERNEL->streams);
+}
+
+int TMC26X::pollStallGuard()
+{
+    if (!started) {
+        return -1;
+    }
+    readStatus(TMC26X_READOUT_STALLGUARD);
+    return getReadoutValue();
 }
 
 // sets a raw register to the value specified, for advanced settings
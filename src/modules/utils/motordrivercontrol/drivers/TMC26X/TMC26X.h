@@ -411,6 +411,12 @@ public:
     bool setRawRegister(StreamOutput *stream, uint32_t reg, uint32_t val);
     bool checkAlarm();
 
+    /*!
+     * \brief reads the StallGuard value and the status bits in one datagram once the readout is set to StallGuard,
+     * returns -1 if the driver has not been started
+     */
+    int pollStallGuard();
+
     using options_t= std::map<char,int>;
 
     bool set_options(const options_t& options);
@@ -419,6 +425,7 @@ private:
     //helper routione to get the top 10 bit of the readout
     inline int getReadoutValue();
     bool check_error_status_bits(StreamOutput *stream);
+    bool report_error_status_bits(StreamOutput *stream);
 
     // SPI sender
     inline void send262(unsigned long datagram);
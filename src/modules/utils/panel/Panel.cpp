@@ -20,6 +20,7 @@
 #include "screens/MainMenuScreen.h"
 #include "SlowTicker.h"
 #include "Gcode.h"
+#include "Conveyor.h"
 #include "TemperatureControlPublicAccess.h"
 #include "ModifyValuesScreen.h"
 #include "PublicDataRequest.h"
@@ -39,6 +40,7 @@
 
 // for parse_pins in mbed
 #include "pinmap.h"
+#include "us_ticker_api.h"
 
 #define panel_checksum             CHECKSUM("panel")
 #define enable_checksum            CHECKSUM("enable")
@@ -51,10 +53,13 @@
 
 #define menu_offset_checksum        CHECKSUM("menu_offset")
 #define encoder_resolution_checksum CHECKSUM("encoder_resolution")
+#define encoder_a_pin_checksum      CHECKSUM("encoder_a_pin")
+#define encoder_b_pin_checksum      CHECKSUM("encoder_b_pin")
 #define jog_x_feedrate_checksum     CHECKSUM("alpha_jog_feedrate")
 #define jog_y_feedrate_checksum     CHECKSUM("beta_jog_feedrate")
 #define jog_z_feedrate_checksum     CHECKSUM("gamma_jog_feedrate")
 #define	longpress_delay_checksum	CHECKSUM("longpress_delay")
+#define refresh_budget_checksum     CHECKSUM("refresh_budget_us")
 
 #define ext_sd_checksum            CHECKSUM("external_sd")
 #define sdcd_pin_checksum          CHECKSUM("sdcd_pin")
@@ -77,7 +82,11 @@ Panel::Panel()
     this->lcd = NULL;
     this->do_buttons = false;
     this->do_encoder = false;
+    this->render_pending = false;
+    this->encoder_a_irq = nullptr;
+    this->encoder_b_irq = nullptr;
     this->idle_time = 0;
+    this->last_render_us = 0;
     this->start_up = true;
     this->current_screen = NULL;
     this->sd= nullptr;
@@ -146,6 +155,7 @@ void Panel::on_module_loaded()
     // some encoders may need more clicks to move menu, this is a divisor and is in config as it is
     // an end user usability issue
     this->menu_offset = THEKERNEL->config->value( panel_checksum, menu_offset_checksum )->by_default(0)->as_number();
+    this->refresh_budget_us = THEKERNEL->config->value( panel_checksum, refresh_budget_checksum )->by_default(2000)->as_int();
 
     // override default encoder resolution if needed
     this->encoder_click_resolution = THEKERNEL->config->value( panel_checksum, encoder_resolution_checksum )->by_default(this->lcd->getEncoderResolution())->as_number();
@@ -179,7 +189,7 @@ void Panel::on_module_loaded()
     if(lcd->encoderReturnsDelta()) {
         // panel handles encoder pins and returns a delta
         THEKERNEL->slow_ticker->attach( 10, this, &Panel::encoder_tick );
-    }else{
+    }else if(!attach_encoder_interrupts()) {
         // read encoder pins
         THEKERNEL->slow_ticker->attach( 1000, this, &Panel::encoder_check );
     }
@@ -187,12 +197,40 @@ void Panel::on_module_loaded()
     // Register for events
     this->register_for_event(ON_IDLE);
     this->register_for_event(ON_MAIN_LOOP);
+    // the screen can wait while the planner is being fed
+    this->set_event_priority(ON_IDLE, PRIORITY_HOUSEKEEPING);
+    this->set_event_priority(ON_MAIN_LOOP, PRIORITY_HOUSEKEEPING);
     this->register_for_event(ON_SET_PUBLIC_DATA);
+    PublicData::register_handler(this, panel_checksum);
 
     // Refresh timer
     THEKERNEL->slow_ticker->attach( 20, this, &Panel::refresh_tick );
 }
 
+// Decode the encoder on every edge of its pins instead of polling them, only ports 0 and 2 can interrupt.
+// the lcd still reads the pins and keeps the quadrature state, it is just called as soon as one changes
+bool Panel::attach_encoder_interrupts()
+{
+    Pin a, b;
+    string as = THEKERNEL->config->value(panel_checksum, encoder_a_pin_checksum)->by_default("nc")->as_string();
+    string bs = THEKERNEL->config->value(panel_checksum, encoder_b_pin_checksum)->by_default("nc")->as_string();
+    a.from_string(as);
+    b.from_string(bs);
+    if(!a.connected() || !b.connected()) return false;
+    if((a.port_number != 0 && a.port_number != 2) || (b.port_number != 0 && b.port_number != 2)) return false;
+
+    this->encoder_a_irq = new mbed::InterruptIn(port_pin((PortName)a.port_number, a.pin));
+    this->encoder_b_irq = new mbed::InterruptIn(port_pin((PortName)b.port_number, b.pin));
+    this->encoder_a_irq->rise(this, &Panel::encoder_pin_changed);
+    this->encoder_a_irq->fall(this, &Panel::encoder_pin_changed);
+    this->encoder_b_irq->rise(this, &Panel::encoder_pin_changed);
+    this->encoder_b_irq->fall(this, &Panel::encoder_pin_changed);
+    // InterruptIn sets the pins to pull down, put back the pull ups the lcd set from the config
+    a.from_string(as);
+    b.from_string(bs);
+    return true;
+}
+
 // Enter a screen, we only care about it now
 void Panel::enter_screen(PanelScreen *screen)
 {
@@ -383,7 +421,10 @@ void Panel::on_idle(void *argument)
     }
 
     // If we must refresh
-    if ( this->refresh_flag ) {
+    if (this->refresh_budget_us != 0) {
+        render_slice();
+
+    } else if ( this->refresh_flag ) {
         this->refresh_flag = false;
         if (this->current_screen != NULL) {
             this->current_screen->on_refresh();
@@ -392,6 +433,29 @@ void Panel::on_idle(void *argument)
     }
 }
 
+// Redraw the screen and send it to the lcd a slice at a time, so it never takes more than refresh_budget_us of a pass.
+// While the queue is being fed the redraw waits as the main loop has to keep up with the moves, unless the display
+// has not changed for a second. Once the queue is full we are called from the wait for room and can take our time.
+void Panel::render_slice()
+{
+    if (this->current_screen == NULL) return;
+
+    uint32_t now = us_ticker_read();
+    bool feeding = !THEKERNEL->conveyor->is_queue_empty() && !THEKERNEL->conveyor->is_queue_full();
+    if (feeding && now - this->last_render_us < 1000000) return;
+
+    if (this->refresh_flag && !this->render_pending) {
+        this->refresh_flag = false;
+        this->current_screen->on_refresh();
+        this->render_pending = true;
+    }
+
+    if (this->render_pending) {
+        this->render_pending = !this->lcd->on_refresh_until(now + this->refresh_budget_us);
+        if (!this->render_pending) this->last_render_us = us_ticker_read();
+    }
+}
+
 // Hooks for button clicks
 uint32_t Panel::on_up(uint32_t dummy)
 {
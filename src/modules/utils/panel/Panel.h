@@ -48,6 +48,7 @@ class Panel : public Module {
         uint32_t on_select(uint32_t dummy);
         uint32_t refresh_tick(uint32_t dummy);
         uint32_t encoder_check(uint32_t dummy);
+        void encoder_pin_changed() { encoder_check(0); }
         bool counter_change();
         bool click();
         int get_encoder_resolution() const { return encoder_click_resolution; }
@@ -91,6 +92,8 @@ class Panel : public Module {
         friend class PanelScreen;
 
     private:
+        void render_slice();
+        bool attach_encoder_interrupts();
 
         // external SD card
         bool mount_external_sd(bool on);
@@ -99,6 +102,10 @@ class Panel : public Module {
         SDCard *sd;
         SDFAT *extmounter;
 
+        // encoder pins that interrupt on each edge, NULL while they are polled
+        mbed::InterruptIn *encoder_a_irq;
+        mbed::InterruptIn *encoder_b_irq;
+
         // Menu
         int menu_selected_line;
         int menu_start_line;
@@ -118,6 +125,8 @@ class Panel : public Module {
         int* counter;
 
         int idle_time;
+        uint32_t refresh_budget_us;     // most time a pass of the main loop spends on sending a redraw, 0 sends it all at once
+        uint32_t last_render_us;
 
         PanelScreen* top_screen;
         PanelScreen* current_screen;
@@ -143,6 +152,7 @@ class Panel : public Module {
             volatile bool refresh_flag:1;
             volatile bool do_buttons:1;
             volatile bool do_encoder:1;
+            bool render_pending:1;
             char mode:2;
             char menu_offset:3;
             int encoder_click_resolution:3;
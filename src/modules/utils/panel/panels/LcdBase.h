@@ -63,6 +63,9 @@ class LcdBase {
         virtual void bltGlyph(int x, int y, int w, int h, const uint8_t *glyph, int span= 0, int x_offset=0, int y_offset=0){}
         // only used on certain panels
         virtual void on_refresh(bool now= false){};
+        // like on_refresh but stops sending once us_ticker_read() passes deadline, returns false if there is more to
+        // send and the next call carries on from there
+        virtual bool on_refresh_until(uint32_t deadline) { on_refresh(); return true; }
         virtual void on_main_loop(){};
         // override this if the panel can handle more or less screen lines
         virtual uint16_t get_screen_lines() { return 4; }
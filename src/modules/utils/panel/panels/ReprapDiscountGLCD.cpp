@@ -40,6 +40,8 @@ ReprapDiscountGLCD::ReprapDiscountGLCD() {
 
     int spi_frequency = THEKERNEL->config->value(panel_checksum, spi_frequency_checksum)->by_default(1000000)->as_number();
     this->glcd->setFrequency(spi_frequency);
+    this->refresh_counts= 0;
+    this->sending= false;
 }
 
 ReprapDiscountGLCD::~ReprapDiscountGLCD() {
@@ -132,8 +134,17 @@ void ReprapDiscountGLCD::bltGlyph(int x, int y, int w, int h, const uint8_t *gly
 }
 
 void ReprapDiscountGLCD::on_refresh(bool now){
-    static int refresh_counts = 0;
     refresh_counts++;
     // 10Hz refresh rate
     if(now || refresh_counts % 2 == 0 ) this->glcd->refresh();
 }
+
+bool ReprapDiscountGLCD::on_refresh_until(uint32_t deadline){
+    // 10Hz refresh rate, a refresh that does not fit carries on with the next call
+    if(!sending) {
+        if(++refresh_counts % 2 != 0) return true;
+        sending= true;
+    }
+    sending= !this->glcd->refresh(deadline);
+    return !sending;
+}
@@ -35,11 +35,14 @@ class ReprapDiscountGLCD : public LcdBase {
         // The glyph bytes will be 8 bits of X pixels, msbit->lsbit from top left to bottom right
         void bltGlyph(int x, int y, int w, int h, const uint8_t *glyph, int span= 0, int x_offset=0, int y_offset=0);
         void on_refresh(bool now=false);
+        bool on_refresh_until(uint32_t deadline);
 
     private:
         RrdGlcd* glcd;
         uint8_t col;
         uint8_t row;
+        uint8_t refresh_counts;
+        bool sending;
 
         Pin spi_cs_pin;
         Pin encoder_a_pin;
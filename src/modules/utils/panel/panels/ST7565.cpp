@@ -148,6 +148,12 @@ ST7565::ST7565(uint8_t variant)
     if(framebuffer == NULL) {
         THEKERNEL->streams->printf("Not enough memory available for frame buffer");
     }
+    // without it every page that was drawn into is sent again
+    shown = (uint8_t *)AHB0.alloc(FB_SIZE);
+    shown_valid = false;
+    dirty_pages = 0xFF;
+    refresh_counts = 0;
+    sending = false;
 
 }
 
@@ -155,6 +161,7 @@ ST7565::~ST7565()
 {
     delete this->spi;
     AHB0.dealloc(framebuffer);
+    if(shown != NULL) AHB0.dealloc(shown);
 }
 
 //send commands to lcd
@@ -184,6 +191,7 @@ void ST7565::send_data(const unsigned char *buf, size_t size)
 void ST7565::clear()
 {
     memset(framebuffer, 0, FB_SIZE);
+    dirty_pages = 0xFF;
     this->tx = 0;
     this->ty = 0;
 }
@@ -194,6 +202,41 @@ void ST7565::send_pic(const unsigned char *data)
         set_xy(0, i);
         send_data(data + i * LCDWIDTH, LCDWIDTH);
     }
+    if(shown != NULL) {
+        if(shown != data) memcpy(shown, data, FB_SIZE);
+        shown_valid = true;
+    }
+}
+
+// only send the columns of the dirty pages that differ from what is on the display, the screens redraw
+// everything each time so most of it comes out the same
+bool ST7565::send_changes(uint32_t deadline)
+{
+    if(shown == NULL || !shown_valid) {
+        send_pic(framebuffer);
+        dirty_pages = 0;
+        return true;
+    }
+
+    bool sent = false;
+    for (int i = 0; i < LCDPAGES; i++) {
+        if((dirty_pages & (1 << i)) == 0) continue;
+        if(sent && deadline != 0 && (int32_t)(us_ticker_read() - deadline) >= 0) break;
+        dirty_pages &= ~(1 << i);
+        const unsigned char *fb = framebuffer + i * LCDWIDTH;
+        unsigned char *old = shown + i * LCDWIDTH;
+        int first = 0, last = LCDWIDTH - 1;
+        while(first <= last && fb[first] == old[first]) first++;
+        if(first > last) continue;
+        while(fb[last] == old[last]) last--;
+
+        // the column address auto increments as the data is written
+        set_xy(first, i);
+        send_data(fb + first, last - first + 1);
+        memcpy(old + first, fb + first, last - first + 1);
+        sent = true;
+    }
+    return dirty_pages == 0;
 }
 
 // set column and page number
@@ -247,6 +290,8 @@ void ST7565::init()
     if(this->rst.connected()) rst.set(1);
     send_commands(init_seq, sizeof(init_seq));
     clear();
+    // display ram is undefined after a reset
+    shown_valid = false;
 }
 
 void ST7565::setContrast(uint8_t c)
@@ -270,6 +315,8 @@ int ST7565::drawChar(int x, int y, unsigned char c, int color)
     if(c == '\r') {
         retVal = -tx;
     } else {
+        dirty_pages |= 1 << (y / 8);
+        if(y + 8 < 63) dirty_pages |= 1 << ((y + 8) / 8);
         for (uint8_t i = 0; i < 5; i++ ) {
             if(color == 0) {
                 framebuffer[x + (y / 8 * 128) ] = ~(glcd_font[(c * 5) + i] << y % 8);
@@ -308,12 +355,22 @@ void ST7565::write(const char *line, int len)
 //refreshing screen
 void ST7565::on_refresh(bool now)
 {
-    static int refresh_counts = 0;
     refresh_counts++;
     // 10Hz refresh rate
-    if(now || refresh_counts % 2 == 0 ) {
-        send_pic(framebuffer);
+    if((now || refresh_counts % 2 == 0) && dirty_pages != 0) {
+        send_changes();
+    }
+}
+
+bool ST7565::on_refresh_until(uint32_t deadline)
+{
+    // 10Hz refresh rate, a refresh that does not fit carries on with the next call
+    if(!sending) {
+        if(++refresh_counts % 2 != 0 || dirty_pages == 0) return true;
+        sending = true;
     }
+    sending = !send_changes(deadline);
+    return !sending;
 }
 
 //reading button state
@@ -390,6 +447,7 @@ void ST7565::pixel(int x, int y, int colour)
     int page = y / 8;
     unsigned char mask = 1 << (y % 8);
     unsigned char *byte = &framebuffer[page * LCDWIDTH + x];
+    dirty_pages |= 1 << page;
     if ( colour == 0 )
         *byte &= ~mask; // clear pixel
     else
@@ -25,6 +25,7 @@ public:
 	void write(const char* line, int len);
 
 	void on_refresh(bool now=false);
+	bool on_refresh_until(uint32_t deadline);
 	//encoder which dosent exist :/
 	uint8_t readButtons();
 	int readEncoderDelta();
@@ -39,6 +40,8 @@ public:
 	void set_xy(int x, int y);
 	//send pic to whole screen
 	void send_pic(const unsigned char* data);
+	//send the parts of the framebuffer that changed, stopping once deadline passes if it is not 0
+	bool send_changes(uint32_t deadline= 0);
 	//drawing char
 	int drawChar(int x, int y, unsigned char c, int color);
     // blit a glyph of w pixels wide and h pixels high to x, y. offset pixel position in glyph by x_offset, y_offset.
@@ -58,6 +61,9 @@ private:
 
     //buffer
 	unsigned char *framebuffer;
+	unsigned char *shown; // what is on the display, NULL if there was no memory for it
+	uint8_t dirty_pages;  // one bit per page drawn into since the last refresh
+	bool shown_valid;     // false until the whole framebuffer has been sent after init
 	mbed::SPI* spi;
 	Pin cs;
 	Pin rst;
@@ -74,6 +80,7 @@ private:
 
 	// text cursor position
 	uint8_t tx, ty;
+    uint8_t refresh_counts;
     uint8_t contrast;
     struct {
         bool reversed:1;
@@ -81,6 +88,7 @@ private:
         bool is_mini_viki2:1;
         bool use_pause:1;
         bool use_back:1;
+        bool sending:1;
     };
 };
 
@@ -166,13 +166,20 @@ RrdGlcd::RrdGlcd(int spi_channel, Pin cs) {
     if(fb == NULL) {
         THEKERNEL->streams->printf("Not enough memory available for frame buffer");
     }
+    // without it every row that was drawn into is sent again
+    shown= (uint8_t *)AHB0.alloc(FB_SIZE);
     inited= false;
-    dirty= false;
+    dirty_rows= 0;
+    memset(text, 0, sizeof(text));
+    memset(drawn, 0, sizeof(drawn));
+    clear_pending= false;
+    has_graphics= true; // so the first clear clears it all
 }
 
 RrdGlcd::~RrdGlcd() {
     delete this->spi;
     AHB0.dealloc(fb);
+    if(shown != NULL) AHB0.dealloc(shown);
 }
 
 void RrdGlcd::setFrequency(int freq) {
@@ -200,62 +207,116 @@ void RrdGlcd::initDisplay() {
     }
     ST7920_WRITE_BYTE(0x0C); //display on, cursor+blink off
     ST7920_NCS();
+    if(shown != NULL) memset(shown, 0, FB_SIZE);
     inited= true;
 }
 
+// The screens clear and draw the same text again on every refresh, so when only text has been drawn the clear is
+// left until the next refresh or glyph: the cells that have been drawn again by then are left as they are and only
+// those that have not are blanked. Anything a glyph has drawn is not known, so then it is all cleared at once
 void RrdGlcd::clearScreen() {
     if(fb == NULL) return;
+    if(!has_graphics) {
+        clear_pending= true;
+        memset(drawn, 0, sizeof(drawn));
+        return;
+    }
     memset(this->fb, 0, FB_SIZE);
-    dirty= true;
+    memset(text, 0, sizeof(text));
+    markDirty(0, HEIGHT);
+    clear_pending= false;
+    has_graphics= false;
 }
 
-// render into local screenbuffer
-void RrdGlcd::displayString(int row, int col, const char *ptr, int length) {
-    for (int i = 0; i < length; ++i) {
-        displayChar(row, col, ptr[i]);
-        col+=1;
+// blank the cells that were not drawn again since the clear
+void RrdGlcd::finishClear() {
+    if(!clear_pending) return;
+    clear_pending= false;
+    static const char blanks[TEXT_COLS]= {' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' '};
+    for (int row = 0; row < TEXT_ROWS; ++row) {
+        for (int col = 0; col < TEXT_COLS; ) {
+            if(text[row][col] == 0 || (drawn[row] & (1UL << col))) {
+                ++col;
+                continue;
+            }
+            int n= 0;
+            while(col + n < TEXT_COLS && text[row][col + n] != 0 && !(drawn[row] & (1UL << (col + n)))) {
+                text[row][col + n]= 0;
+                ++n;
+            }
+            renderText(blanks, n, col*6, row*8);
+            col += n;
+        }
     }
-    dirty= true;
 }
 
-void RrdGlcd::renderChar(uint8_t *fb, char c, int ox, int oy) {
-    if(fb == NULL) return;
-    // using the specific font data where x is in one byte and y is in consecutive bytes
-    // the x bits are left aligned and right padded
-    int i= c*8; // character offset in font array
-    int o= ox%8; // where in fb byte does it go
-    int a= oy*16 + ox/8; // start address in frame buffer
-    int mask= ~0xF8 >> o; // mask off top bits
-    int mask2= ~0xF8 << (8-o); // mask off bottom bits
-    for(int y=0;y<8;y++) {
-        int b= font5x8[i+y]; // get font byte
-        fb[a] &= mask; // clear top bits for font
-        fb[a] |= (b>>o); // or in the fonts 1 bits
-        if(o >= 4) { // it spans two fb bytes
-            fb[a+1] &= mask2; // clear bottom bits for font
-            fb[a+1] |= (b<<(8-o)); // or in the fonts 1 bits
-        }
-        a+=16; // next line
-    }
+// note rows y to y+n-1 of the frame buffer need to be checked on the next refresh
+void RrdGlcd::markDirty(int y, int n) {
+    if(y < 0) { n += y; y= 0; }
+    if(y + n > HEIGHT) n= HEIGHT - y;
+    if(n <= 0) return;
+    uint64_t bits= (n >= 64) ? ~0ULL : (1ULL << n) - 1;
+    dirty_rows |= bits << y;
 }
 
-void RrdGlcd::displayChar(int row, int col, char c) {
-    int x= col*6;
-    // if this wraps the line ignore it
-    if(x+6 > WIDTH) return;
+// render into local screenbuffer, only the characters that differ from what is already there are rendered
+void RrdGlcd::displayString(int row, int col, const char *ptr, int length) {
+    if(fb == NULL || row < 0 || row >= TEXT_ROWS || col < 0) return;
+    // characters that would wrap the line are ignored
+    if(length > TEXT_COLS - col) length= TEXT_COLS - col;
+    if(length <= 0) return;
+
+    char *t= &text[row][col];
+    uint32_t bits= (length >= 32) ? ~0UL : (1UL << length) - 1;
+    drawn[row] |= bits << col;
+    int first= 0, last= length - 1;
+    while(first < length && t[first] == ptr[first]) ++first;
+    if(first == length) return;
+    while(t[last] == ptr[last]) --last;
 
-    // convert row/column into y and x pixel positions based on font size
-    renderChar(this->fb, c, x, row*8);
+    memcpy(&t[first], &ptr[first], last - first + 1);
+    renderText(&ptr[first], last - first + 1, (col + first)*6, row*8);
+}
+
+// Each character is 6 pixels wide, the 5 of the font and a blank column, so the characters of a line are shifted
+// into a word a row at a time and it is written out a whole byte at a time, only the bytes at the two ends of the
+// run are read to keep the pixels either side of it
+void RrdGlcd::renderText(const char *s, int n, int ox, int oy) {
+    markDirty(oy, 8);
+    int o= ox%8; // bits of the first fb byte to the left of the text
+    for(int y=0;y<8;y++) {
+        uint8_t *d= &fb[(oy+y)*16 + ox/8];
+        uint32_t acc= *d >> (8-o);
+        int nb= o;
+        for(int i=0;i<n;i++) {
+            // using the specific font data where x is in one byte and y is in consecutive bytes, left aligned
+            acc= (acc << 6) | (font5x8[(uint8_t)s[i]*8 + y] >> 2);
+            nb += 6;
+            if(nb >= 8) {
+                nb -= 8;
+                *d++= acc >> nb;
+                acc &= (1UL << nb) - 1;
+            }
+        }
+        if(nb > 0) *d= (acc << (8-nb)) | (*d & (0xFF >> nb));
+    }
 }
 
 void RrdGlcd::renderGlyph(int xp, int yp, const uint8_t *g, int pixelWidth, int pixelHeight) {
     if(fb == NULL) return;
+    finishClear();
+    has_graphics= true;
+    // the text under it is not known any more, so it is drawn again next time
+    for(int row= max(yp/8, 0); row <= (yp+pixelHeight-1)/8 && row < TEXT_ROWS; ++row) {
+        for(int col= max(xp/6, 0); col <= (xp+pixelWidth-1)/6 && col < TEXT_COLS; ++col) text[row][col]= -1;
+    }
     // NOTE the source is expected to be byte aligned and the exact number of pixels
     // TODO need to optimize by copying bytes instead of pixels...
     int xf= xp%8;
     int rf= pixelWidth%8;
     int a= yp*16 + xp/8; // start address in frame buffer
     const uint8_t *src= g;
+    markDirty(yp, pixelHeight);
     if(xf == 0) {
         // If xp is on a byte boundary simply memcpy each line from source to dest
         uint8_t *dest= &fb[a];
@@ -299,6 +360,7 @@ void RrdGlcd::renderGlyph(int xp, int yp, const uint8_t *g, int pixelWidth, int
 
 // copy frame buffer to graphic buffer on display
 void RrdGlcd::fillGDRAM(const uint8_t *bitmap) {
+    if(shown != NULL && shown != bitmap) memcpy(shown, bitmap, FB_SIZE);
     unsigned char i, y;
     for ( i = 0 ; i < 2 ; i++ ) {
         ST7920_CS();
@@ -317,8 +379,37 @@ void RrdGlcd::fillGDRAM(const uint8_t *bitmap) {
     }
 }
 
-void RrdGlcd::refresh() {
-    if(!inited || !dirty) return;
-    fillGDRAM(this->fb);
-    dirty= false;
+// GDRAM is two 32 row halves side by side, fb rows 32-63 are the right half
+void RrdGlcd::sendRow(int y, const uint8_t *row) {
+    ST7920_SET_CMD();
+    ST7920_WRITE_BYTE(0x80 | (y % PAGE_HEIGHT));
+    ST7920_WRITE_BYTE(y < PAGE_HEIGHT ? 0x80 : 0x80 | 0x08);
+    ST7920_SET_DAT();
+    ST7920_WRITE_BYTES(row, WIDTH/8); // row gets incremented in this macro
+}
+
+// only send the rows that were drawn into and differ from what is already on the display,
+// the screens redraw everything each time so most rows come out the same
+bool RrdGlcd::refresh(uint32_t deadline) {
+    finishClear();
+    if(!inited || dirty_rows == 0) return true;
+    bool selected= false;
+    for (int y = 0; y < HEIGHT; ++y) {
+        if((dirty_rows & (1ULL << y)) == 0) continue;
+        if(selected && deadline != 0 && (int32_t)(us_ticker_read() - deadline) >= 0) break;
+        dirty_rows &= ~(1ULL << y);
+        const uint8_t *row= &fb[y * WIDTH/8];
+        if(shown != NULL) {
+            uint8_t *old= &shown[y * WIDTH/8];
+            if(memcmp(old, row, WIDTH/8) == 0) continue;
+            memcpy(old, row, WIDTH/8);
+        }
+        if(!selected) {
+            ST7920_CS();
+            selected= true;
+        }
+        sendRow(y, row);
+    }
+    if(selected) ST7920_NCS();
+    return dirty_rows == 0;
 }
@@ -37,7 +37,8 @@ public:
     void initDisplay(void);
     void clearScreen(void);
     void displayString(int row, int column, const char *ptr, int length);
-    void refresh();
+    // deadline is a us_ticker_read() time to stop at, 0 for no limit. returns false if some rows are still to be sent
+    bool refresh(uint32_t deadline= 0);
 
      /**
     *@brief Fills the screen with the graphics described in a 1024-byte array
@@ -54,12 +55,22 @@ public:
 private:
     Pin cs;
     mbed::SPI* spi;
-    void renderChar(uint8_t *fb, char c, int ox, int oy);
-    void displayChar(int row, int column,char inpChr);
+    void renderText(const char *s, int n, int ox, int oy);
+    void finishClear();
+    void markDirty(int y, int n);
+    void sendRow(int y, const uint8_t *row);
 
     uint8_t *fb;
+    uint8_t *shown;     // copy of what is on the display, NULL if there was no memory for it
+    uint64_t dirty_rows; // one bit per frame buffer row changed since the last refresh
+
+    static const int TEXT_ROWS= 8;
+    static const int TEXT_COLS= 21;
+    char text[TEXT_ROWS][TEXT_COLS];    // the characters in the frame buffer, 0 for a blank cell, -1 where a glyph went
+    uint32_t drawn[TEXT_ROWS];          // bit per cell drawn since the clear that is pending
+    bool clear_pending;
+    bool has_graphics;                  // a glyph has been drawn since the frame buffer was last cleared
     bool inited;
-    bool dirty;
 };
 #endif
 
@@ -13,6 +13,7 @@
 #include "ControlScreen.h"
 #include "libs/nuts_bolts.h"
 #include "libs/utils.h"
+#include "libs/FixedFormat.h"
 #include <string>
 #include "Robot.h"
 #include "PublicData.h"
@@ -92,7 +93,10 @@ void ControlScreen::display_menu_line(uint16_t line)
 
 void ControlScreen::display_axis_line(char axis)
 {
-    THEPANEL->lcd->printf("Move %c    %8.3f", axis, this->pos[axis - 'X']);
+    char buf[24];
+    FixedFormat f(buf, sizeof(buf));
+    f.str("Move ").chr(axis).str("    ").fixed(this->pos[axis - 'X'], 3, 8);
+    THEPANEL->lcd->printf("%s", f.c_str());
 }
 
 
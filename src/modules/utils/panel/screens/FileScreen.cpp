@@ -17,6 +17,7 @@
 #include "libs/SerialMessage.h"
 #include "StreamOutput.h"
 #include "DirHandle.h"
+#include "DirIndex.h"
 #include "mri.h"
 
 using std::string;
@@ -24,6 +25,7 @@ using std::string;
 FileScreen::FileScreen()
 {
     this->start_play = false;
+    this->shown_write_count = 0;
 }
 
 // When entering this screen
@@ -39,6 +41,7 @@ void FileScreen::on_exit()
 {
     // reset to root directory, I think this is less confusing
     THEKERNEL->current_path= "/";
+    std::vector<uint16_t>().swap(this->shown);
 }
 
 // For every ( potential ) refresh of the screen
@@ -126,9 +129,32 @@ bool FileScreen::filter_file(const char *f)
               (fn.find(".nc") != string::npos));
 }
 
+// the entries of the index that match the filter, worked out again if the index is not the one they are from
+void FileScreen::list_index(const DirIndex *index)
+{
+    if(!this->shown.empty() && this->shown_write_count == index->get_write_count()) return;
+    this->shown.clear();
+    for (size_t i = 0; i < index->size(); i++) {
+        if(shown_entry(index->name(i), index->is_dir(i))) this->shown.push_back(i);
+    }
+    this->shown_write_count= index->get_write_count();
+}
+
 // Find the "line"th file in the current folder
 string FileScreen::file_at(uint16_t line, bool& isdir)
 {
+    const DirIndex *index= DirIndex::get(THEKERNEL->current_path);
+    if(index != nullptr) {
+        list_index(index);
+        if(line < this->shown.size()) {
+            isdir= index->is_dir(this->shown[line]);
+            return index->name(this->shown[line]);
+        }
+        isdir= false;
+        return "";
+    }
+
+    // too big to index, read through it to the line
     DIR *d;
     struct dirent *p;
     uint16_t count = 0;
@@ -136,7 +162,7 @@ string FileScreen::file_at(uint16_t line, bool& isdir)
     if (d != NULL) {
         while ((p = readdir(d)) != NULL) {
             // only filter files that have a .g in them and directories not starting with a .
-          if(((p->d_isdir && p->d_name[0] != '.') || filter_file(p->d_name)) && count++ == line ) {
+          if(shown_entry(p->d_name, p->d_isdir) && count++ == line ) {
                 isdir= p->d_isdir;
                 string fn= p->d_name;
                 closedir(d);
@@ -153,13 +179,20 @@ string FileScreen::file_at(uint16_t line, bool& isdir)
 // Count how many files there are in the current folder that have a .g in them and does not start with a .
 uint16_t FileScreen::count_folder_content()
 {
+    const DirIndex *index= DirIndex::get(THEKERNEL->current_path);
+    if(index != nullptr) {
+        this->shown.clear();
+        list_index(index);
+        return this->shown.size();
+    }
+
     DIR *d;
     struct dirent *p;
     uint16_t count = 0;
     d = opendir(THEKERNEL->current_path.c_str());
     if (d != NULL) {
         while ((p = readdir(d)) != NULL) {
-            if((p->d_isdir && p->d_name[0] != '.') || filter_file(p->d_name)) count++;
+            if(shown_entry(p->d_name, p->d_isdir)) count++;
         }
         closedir(d);
         return count;
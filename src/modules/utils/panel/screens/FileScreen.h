@@ -11,6 +11,9 @@
 #include "PanelScreen.h"
 
 #include <string>
+#include <vector>
+
+class DirIndex;
 
 class FileScreen : public PanelScreen {
     public:
@@ -27,9 +30,13 @@ class FileScreen : public PanelScreen {
         uint16_t count_folder_content();
         std::string file_at(uint16_t line, bool& isdir);
         bool filter_file(const char *f);
+        bool shown_entry(const char *name, bool isdir) { return (isdir && name[0] != '.') || filter_file(name); }
+        void list_index(const DirIndex *index);
         void play(const char *path);
 
         std::string play_path;
+        std::vector<uint16_t> shown;    // the entries of the folder's DirIndex that are listed
+        uint32_t shown_write_count;     // and the DirIndex they are from
         bool start_play;
 };
 
@@ -13,6 +13,7 @@
 #include "WatchScreen.h"
 #include "libs/nuts_bolts.h"
 #include "libs/utils.h"
+#include "libs/FixedFormat.h"
 #include "modules/tools/temperaturecontrol/TemperatureControlPublicAccess.h"
 #include "Robot.h"
 #include "modules/robot/Conveyor.h"
@@ -51,6 +52,7 @@ WatchScreen::WatchScreen()
     issue_change_speed = false;
     ipstr = nullptr;
     update_counts= 0;
+    temps = nullptr;
 }
 
 WatchScreen::~WatchScreen()
@@ -70,24 +72,13 @@ void WatchScreen::on_enter()
     THEPANEL->enter_control_mode(1, 0.5);
     THEPANEL->set_control_value(this->current_speed);
 
-    // enumerate temperature controls
-    temp_controllers.clear();
-    std::vector<struct pad_temperature> controllers;
-    bool ok = PublicData::get_value(temperature_control_checksum, poll_controls_checksum, &controllers);
-    if (ok) {
-        for (auto &c : controllers) {
-            temp_controllers.push_back(c.id);
-        }
+    // the rows of all the temperature controls, which they keep up to date
+    void *returned_data;
+    if (PublicData::get_value(temperature_control_checksum, temperature_snapshot_checksum, &returned_data)) {
+        this->temps = static_cast<const pad_temperature_snapshot *>(returned_data);
     }
 }
 
-static struct pad_temperature getTemperatures(uint16_t heater_cs)
-{
-    struct pad_temperature temp;
-    PublicData::get_value( temperature_control_checksum, current_temperature_checksum, heater_cs, &temp );
-    return temp;
-}
-
 void WatchScreen::on_refresh()
 {
     // Exit if the button is clicked
@@ -132,11 +123,11 @@ void WatchScreen::on_refresh()
         // for LCDs with leds set them according to heater status
         bool bed_on= false, hotend_on= false, is_hot= false;
         uint8_t heon=0, hemsk= 0x01; // bit set for which hotend is on bit0: hotend1, bit1: hotend2 etc
-        for(auto id : temp_controllers) {
-            struct pad_temperature c= getTemperatures(id);
+        for(int i= 0; this->temps != nullptr && i < this->temps->count; ++i) {
+            const pad_temperature_row &c= this->temps->rows[i];
             if(c.current_temperature > 50) is_hot= true; // anything is hot
-            if(c.designator.front() == 'B' && c.target_temperature > 0) bed_on= true;   // bed on/off
-            if(c.designator.front() == 'T') { // a hotend by convention
+            if(c.designator[0] == 'B' && c.target_temperature > 0) bed_on= true;   // bed on/off
+            if(c.designator[0] == 'T') { // a hotend by convention
                 if(c.target_temperature > 0){
                     hotend_on= true;// hotend on/off (anyone)
                     heon |= hemsk;
@@ -227,26 +218,26 @@ void WatchScreen::display_menu_line(uint16_t line)
     switch ( line ) {
         case 0:
         {
-            auto& tm= this->temp_controllers;
-            if(tm.size() > 0) {
+            size_t count= this->temps != nullptr ? this->temps->count : 0;
+            if(count > 0) {
                 // only if we detected heaters in config
                 int n= 0;
-                if(tm.size() > 2) {
+                if(count > 2) {
                     // more than two temps we need to cycle between them
                     n= update_counts/100; // increments every 5 seconds
-                    int ntemps= (tm.size()+1)/2;
+                    int ntemps= (count+1)/2;
                     n= n%ntemps; // which of the pairs of temps to display
                 }
 
                 int off= 0;
                 for (size_t i = 0; i < 2; ++i) {
                     size_t o= i+(n*2);
-                    if(o>tm.size()-1) break;
-                    struct pad_temperature temp= getTemperatures(tm[o]);
+                    if(o>count-1) break;
+                    const pad_temperature_row &temp= this->temps->rows[o];
                     int t= std::min(999, (int)roundf(temp.current_temperature));
                     int tt= roundf(temp.target_temperature);
                     THEPANEL->lcd->setCursor(off, 0); // col, row
-                    off += THEPANEL->lcd->printf("%s:%03d/%03d ", temp.designator.substr(0, 2).c_str(), t, tt);
+                    off += THEPANEL->lcd->printf("%.2s:%03d/%03d ", temp.designator, t, tt);
                 }
 
             }else{
@@ -254,7 +245,14 @@ void WatchScreen::display_menu_line(uint16_t line)
             }
             break;
         }
-        case 1: THEPANEL->lcd->printf("X%4d Y%4d Z%7.2f", (int)round(this->pos[0]), (int)round(this->pos[1]), this->pos[2]); break;
+        case 1: {
+            // X%4d Y%4d Z%7.2f
+            char buf[24];
+            FixedFormat f(buf, sizeof(buf));
+            f.chr('X').integer(lroundf(this->pos[0]), 4).str(" Y").integer(lroundf(this->pos[1]), 4).str(" Z").fixed(this->pos[2], 2, 7);
+            THEPANEL->lcd->printf("%s", f.c_str());
+            break;
+        }
         case 2: THEPANEL->lcd->printf("%3d%% %2lu:%02lu %3u%% sd", this->current_speed, this->elapsed_time / 60, this->elapsed_time % 60, this->sd_pcnt_played); break;
         case 3: THEPANEL->lcd->printf("%19s", this->get_status()); break;
     }
@@ -12,6 +12,8 @@
 
 #include <tuple>
 
+struct pad_temperature_snapshot;
+
 class WatchScreen : public PanelScreen
 {
 public:
@@ -31,7 +33,7 @@ private:
     const char *get_status();
     const char *get_network();
 
-    std::vector<uint16_t> temp_controllers;
+    const pad_temperature_snapshot *temps;   // of all the controls, updated by them
 
     uint32_t update_counts;
     int current_speed;
@@ -0,0 +1,332 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CompiledJob.h"
+#include "LineReader.h"
+
+#include "libs/Kernel.h"
+#include "Robot.h"
+#include "Planner.h"
+#include "Conveyor.h"
+#include "Gcode.h"
+#include "StepperMotor.h"
+#include "libs/nuts_bolts.h"
+#include "libs/SerialMessage.h"
+#include "libs/StreamOutput.h"
+
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+const char CompiledJob::magic[4]{'S', 'J', 'C', '1'};
+
+// returns why the gcode can not be in a compiled job, the position or kinematics after it are not known when compiling
+static const char *not_compilable(const Gcode &gcode)
+{
+    if(gcode.has_g) {
+        if((gcode.g >= 28 && gcode.g <= 32) || gcode.g == 38) return "homing and probing are not supported";
+        if(gcode.g == 53) return "G53 is not supported";
+        if((gcode.g == 10 && !gcode.has_letter('L')) || gcode.g == 11) return "firmware retract is not supported";
+
+    } else if(gcode.has_m) {
+        switch(gcode.m) {
+            case 23: case 24: case 32: return "playing files is not supported";
+            case 120: case 121: return "saving state is not supported";
+            case 203: case 220: case 665: case 666: return "changing the kinematics is not supported";
+            case 600: case 601: return "suspend is not supported";
+        }
+    }
+    return nullptr;
+}
+
+// runs the file through Robot, the segments of plain G0-G3 lines are written to the job followed by the Robot state
+// at the end of the line, all other lines are written as text. Robot is put back as it was when done.
+bool CompiledJob::compile(const string &src, const string &dst, StreamOutput *stream)
+{
+    FILE *in = fopen(src.c_str(), "r");
+    if(in == nullptr) {
+        stream->printf("File not found: %s\r\n", src.c_str());
+        return false;
+    }
+    FILE *out = fopen(dst.c_str(), "w");
+    if(out == nullptr) {
+        fclose(in);
+        stream->printf("Could not create %s\r\n", dst.c_str());
+        return false;
+    }
+
+    bool ok= true;
+    auto put= [&ok, out](const void *data, size_t n) {
+        if(fwrite(data, 1, n, out) != n) ok= false;
+    };
+    auto put_type= [&put](char type) { put(&type, 1); };
+
+    // the gcode being compiled, its G record goes in front of its first segment
+    Gcode *current= nullptr;
+    bool attached= false;
+
+    Robot *robot= THEKERNEL->robot;
+    robot->begin_recording([&](const ActuatorCoordinates &actuator_pos, float rate_mm_s, float millimeters_of_travel, const float unit_vec[]) {
+        if(current == nullptr) return; // a line kept as text, it is segmented again when played
+
+        if(!attached) {
+            uint8_t g= current->g;
+            put_type(RECORD_GCODE);
+            put(&g, sizeof(g));
+            put(&current->millimeters_of_travel, sizeof(float));
+            attached= true;
+        }
+        put_type(RECORD_SEGMENT);
+        put(actuator_pos.data(), robot->actuators.size() * sizeof(float));
+        put(&rate_mm_s, sizeof(float));
+        put(&millimeters_of_travel, sizeof(float));
+        put(unit_vec, 3 * sizeof(float));
+    });
+
+    header_t header;
+    memcpy(header.magic, magic, sizeof(header.magic));
+    header.hash= robot->get_kinematics_hash();
+    header.actuators= robot->actuators.size();
+    robot->get_axis_position(header.start);
+    put(&header, sizeof(header));
+
+    LineReader reader;
+    reader.start(in);
+    const char *line;
+    size_t len;
+    bool discarded;
+    unsigned int line_no= 0, compiled= 0, kept= 0;
+    unsigned int modal= 0; // last G0-G3, same as GcodeDispatch starts with
+    const char *error= nullptr;
+    std::vector<Gcode> gcodes;
+
+    while(ok && error == nullptr && reader.next_line(line, len, discarded)) {
+        ++line_no;
+        if(discarded) {
+            stream->printf("Warning: Discarded long line before line %u\r\n", line_no);
+        }
+
+        string text(line, len);
+        while(!text.empty() && strchr("\r\n \t", text.back()) != nullptr) text.pop_back();
+        if(text.empty() || text[0] == ';' || text[0] == '(') continue;
+
+        // an axis word on its own uses the last G0-G3, make that explicit so the text lines do not depend on the compiled ones
+        if(strchr("XYZIJKF", text[0]) != nullptr) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "G%u ", modal);
+            text.insert(0, buf);
+        }
+
+        if(text[0] == 'T' || text[0] == 'N') {
+            error= text[0] == 'T' ? "tool changes are not supported" : "line numbers are not supported";
+            break;
+        }
+
+        // split the commands on the line the way GcodeDispatch does
+        string cmds= text.substr(0, text.find_first_of(";("));
+        bool plain_move= cmds[0] == 'G' && cmds.find_first_not_of("GXYZIJKF0123456789.-+ \t") == string::npos;
+        gcodes.clear();
+        while(!cmds.empty()) {
+            size_t next= cmds.find_first_of("GM", 2);
+            gcodes.emplace_back(cmds.substr(0, next), &(StreamOutput::NullStream));
+            cmds= (next == string::npos) ? "" : cmds.substr(next);
+            error= not_compilable(gcodes.back());
+            if(error != nullptr) break;
+        }
+        if(error != nullptr) break;
+
+        Gcode &first= gcodes[0];
+        if(plain_move && gcodes.size() == 1 && first.has_g && first.g <= 3 && first.subcode == 0) {
+            current= &first;
+            attached= false;
+            robot->on_gcode_received(&first);
+            current= nullptr;
+
+            Robot::motion_state_t ms;
+            robot->get_motion_state(ms);
+            put_type(RECORD_END);
+            put(&ms, sizeof(ms));
+            modal= first.g;
+            ++compiled;
+
+        } else {
+            uint8_t n= text.size();
+            put_type(RECORD_TEXT);
+            put(&n, sizeof(n));
+            put(text.data(), n);
+
+            // Robot still has to follow the line so the compiled lines after it start in the right place
+            for(auto &g : gcodes) {
+                if(!g.has_g || g.g == 4) continue;
+                robot->on_gcode_received(&g);
+                if(g.g <= 3) modal= g.g;
+            }
+            ++kept;
+        }
+
+        if((line_no % 32) == 0) {
+            THEKERNEL->call_event(ON_IDLE);
+            if(THEKERNEL->is_halted()) error= "halted";
+        }
+    }
+
+    robot->end_recording();
+    reader.stop();
+    fclose(in);
+    if(fclose(out) != 0) ok= false;
+
+    if(error != nullptr || !ok) {
+        if(error != nullptr) {
+            stream->printf("Line %u can not be compiled, %s\r\n", line_no, error);
+        } else {
+            stream->printf("Error writing %s\r\n", dst.c_str());
+        }
+        remove(dst.c_str());
+        return false;
+    }
+
+    stream->printf("Compiled %s to %s, %u lines compiled, %u lines kept as text\r\n", src.c_str(), dst.c_str(), compiled, kept);
+    return true;
+}
+
+bool CompiledJob::is_job(const string &filename)
+{
+    size_t n= filename.size();
+    return n > 4 && filename.compare(n - 4, 4, ".job") == 0;
+}
+
+// the compiled job of a gcode file has its extension replaced by .job
+string CompiledJob::job_name(const string &filename)
+{
+    size_t dot= filename.find_last_of('.');
+    size_t slash= filename.find_last_of('/');
+    if(dot == string::npos || (slash != string::npos && dot < slash)) return filename + ".job";
+    return filename.substr(0, dot) + ".job";
+}
+
+// check the job was compiled for the current setup and starts where we are, then play it from fp
+bool CompiledJob::start(FILE *fp, StreamOutput *stream)
+{
+    header_t header;
+    if(fread(&header, 1, sizeof(header), fp) != sizeof(header) || memcmp(header.magic, magic, sizeof(magic)) != 0) {
+        stream->printf("Not a compiled job\r\n");
+        return false;
+    }
+
+    Robot *robot= THEKERNEL->robot;
+    robot->flush_pending_move();
+    if(header.actuators != robot->actuators.size() || header.hash != robot->get_kinematics_hash()) {
+        stream->printf("Compiled job is out of date, the configuration or offsets have changed since it was compiled\r\n");
+        return false;
+    }
+
+    float pos[3];
+    robot->get_axis_position(pos);
+    for (int i = X_AXIS; i <= Z_AXIS; i++) {
+        if(fabsf(pos[i] - header.start[i]) > 0.001F) {
+            stream->printf("Compiled job starts at machine position X%1.4f Y%1.4f Z%1.4f, move there first\r\n", header.start[X_AXIS], header.start[Y_AXIS], header.start[Z_AXIS]);
+            return false;
+        }
+    }
+
+    this->fp= fp;
+    this->n_actuators= header.actuators;
+    return true;
+}
+
+// queue the blocks of the next compiled line or play the next text line, returns false at the end of the job
+bool CompiledJob::play_next(StreamOutput *stream, unsigned long &played)
+{
+    Robot *robot= THEKERNEL->robot;
+    bool done= false;
+    bool more= true;
+    int c;
+
+    while(!done && fp != nullptr && (c = fgetc(fp)) != EOF) {
+        bool truncated= false;
+        switch(c) {
+            case RECORD_GCODE: {
+                uint8_t g;
+                float mm;
+                if(fread(&g, 1, sizeof(g), fp) != sizeof(g) || fread(&mm, 1, sizeof(mm), fp) != sizeof(mm)) {
+                    truncated= true;
+                    break;
+                }
+                // a move Robot is holding back from a text line must go first
+                robot->flush_pending_move();
+
+                // attach the move to its first block as Robot would, Extruder and Laser need to see it executed
+                char buf[8];
+                snprintf(buf, sizeof(buf), "G%u", g);
+                Gcode gcode(buf, &(StreamOutput::NullStream));
+                gcode.millimeters_of_travel= mm;
+                THEKERNEL->conveyor->append_gcode(&gcode);
+                break;
+            }
+
+            case RECORD_SEGMENT: {
+                float v[k_max_actuators + 5];
+                size_t n= (n_actuators + 5) * sizeof(float);
+                if(fread(v, 1, n, fp) != n) {
+                    truncated= true;
+                    break;
+                }
+                ActuatorCoordinates actuator_pos;
+                for (size_t i = 0; i < n_actuators; i++) actuator_pos[i]= v[i];
+                THEKERNEL->planner->append_block(actuator_pos, v[n_actuators], v[n_actuators + 1], &v[n_actuators + 2]);
+                if(THEKERNEL->is_halted()) done= true; // Player aborts the job
+                break;
+            }
+
+            case RECORD_END: {
+                Robot::motion_state_t ms;
+                if(fread(&ms, 1, sizeof(ms), fp) != sizeof(ms)) {
+                    truncated= true;
+                    break;
+                }
+                robot->set_motion_state(ms);
+                THEKERNEL->conveyor->ensure_running();
+                done= true;
+                break;
+            }
+
+            case RECORD_TEXT: {
+                uint8_t n;
+                struct SerialMessage message;
+                if(fread(&n, 1, sizeof(n), fp) != sizeof(n)) {
+                    truncated= true;
+                    break;
+                }
+                message.message.resize(n);
+                if(fread(&message.message[0], 1, n, fp) != n) {
+                    truncated= true;
+                    break;
+                }
+                message.message.append("\n");
+                message.stream= stream;
+                stream->printf("%s", message.message.c_str());
+                THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message);
+                done= true;
+                break;
+            }
+
+            default:
+                truncated= true;
+                break;
+        }
+
+        if(truncated) {
+            stream->printf("Compiled job is corrupt\r\n");
+            more= false;
+            break;
+        }
+    }
+
+    if(fp == nullptr) return false;
+    played= ftell(fp);
+    return more && done;
+}
@@ -0,0 +1,54 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COMPILEDJOB_H
+#define COMPILEDJOB_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+using std::string;
+
+class StreamOutput;
+
+// A gcode file compiled into the segments Robot would queue for it, so playing it again does not have to parse,
+// segment and do the arm solution for every move. Only plain G0-G3 lines are compiled, everything else is kept as
+// text and played as usual. The job is only valid for the kinematics, offsets and start position it was compiled with.
+class CompiledJob {
+    public:
+        CompiledJob() : fp(nullptr), n_actuators(0) {}
+
+        static bool compile(const string &src, const string &dst, StreamOutput *stream);
+        static bool is_job(const string &filename);
+        static string job_name(const string &filename);
+
+        bool start(FILE *fp, StreamOutput *stream);
+        void stop() { fp= nullptr; }
+        bool is_started() const { return fp != nullptr; }
+        bool play_next(StreamOutput *stream, unsigned long &played);
+
+    private:
+        // file header, followed by records each starting with one of the record types
+        struct header_t {
+            char magic[4];
+            uint32_t hash;                                  // Robot::get_kinematics_hash() when compiled
+            uint32_t actuators;
+            float start[3];                                 // position the job starts from
+        };
+        enum RECORD_TYPE {
+            RECORD_GCODE= 'G',                              // uint8 G number, float millimeters of travel: attach a G0-G3 to the next block
+            RECORD_SEGMENT= 'S',                            // float actuator positions, rate, millimeters, unit vector: append a block
+            RECORD_END= 'E',                                // Robot::motion_state_t at the end of a compiled line
+            RECORD_TEXT= 'T'                                // uint8 length, then that many characters: play the line
+        };
+        static const char magic[4];
+
+        FILE *fp;
+        uint8_t n_actuators;
+};
+
+#endif
@@ -0,0 +1,512 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "JobEstimate.h"
+
+#include "libs/Kernel.h"
+#include "Robot.h"
+#include "Planner.h"
+#include "StepperMotor.h"
+#include "arm_solutions/BaseSolution.h"
+#include "Gcode.h"
+#include "libs/nuts_bolts.h"
+#include "libs/StreamOutput.h"
+
+#include "us_ticker_api.h"
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#define ARC_ANGULAR_TRAVEL_EPSILON 5E-7F // same as Robot
+
+JobEstimate::JobEstimate()
+{
+    fp= nullptr;
+    done= false;
+    heats_kept= false;
+    scanned= 0;
+    total_seconds= 0.0F;
+}
+
+JobEstimate::~JobEstimate()
+{
+    stop();
+}
+
+// reads the file from the start with a handle of its own, the robot has to be where the file starts from
+bool JobEstimate::start(const string &filename, unsigned long file_size)
+{
+    stop();
+    fp= fopen(filename.c_str(), "r");
+    if(fp == nullptr) return false;
+    reader.start(fp);
+
+    scanned= 0;
+    checkpoint_spacing= std::max(file_size / max_checkpoints, 1UL);
+    checkpoints.clear();
+    checkpoints.reserve(max_checkpoints + 2);
+    total_seconds= 0.0F;
+    oldest= count= 0;
+    clear_vector_float(previous_unit_vec);
+    heats.clear();
+    last_targets.clear();
+    tool= -1;
+
+    Robot *robot= THEKERNEL->robot;
+    Robot::motion_state_t ms;
+    robot->get_motion_state(ms);
+    Robot::wcs_t pos= robot->mcs2wcs(ms.last_milestone);
+    position[X_AXIS]= std::get<X_AXIS>(pos);
+    position[Y_AXIS]= std::get<Y_AXIS>(pos);
+    position[Z_AXIS]= std::get<Z_AXIS>(pos);
+    e_position= 0.0F;
+    feed_rate= ms.feed_rate;
+    seek_rate= ms.seek_rate;
+    e_feed_rate= ms.feed_rate;
+    start_seconds_per_minute= robot->get_seconds_per_minute();
+    absolute_mode= robot->absolute_mode;
+    e_absolute_mode= true;
+    inch_mode= robot->inch_mode;
+    motion_mode= 0; // same as GcodeDispatch starts with
+
+    Planner *planner= THEKERNEL->planner;
+    acceleration= planner->get_acceleration();
+    z_acceleration= (planner->get_z_acceleration() != acceleration) ? planner->get_z_acceleration() : 0.0F;
+    junction_deviation= planner->get_junction_deviation();
+    z_junction_deviation= planner->get_z_junction_deviation();
+    minimum_planner_speed= planner->get_minimum_planner_speed();
+    min_block_seconds= planner->get_min_block_seconds();
+
+    done= false;
+    return true;
+}
+
+// forget the file, and any estimate made for it
+void JobEstimate::stop()
+{
+    if(fp != nullptr) {
+        reader.stop();
+        fclose(fp);
+        fp= nullptr;
+    }
+    done= false;
+    checkpoints.clear();
+    checkpoints.shrink_to_fit();
+    heats.clear();
+    last_targets.clear();
+}
+
+// plans the lines of the file for upto max_us, called on idle until the whole file has been read
+void JobEstimate::scan(uint32_t max_us)
+{
+    if(fp == nullptr) return;
+
+    uint32_t start= us_ticker_read();
+    do {
+        if(heats_kept && heats.size() >= max_heats) return;
+
+        const char *line;
+        size_t len;
+        bool discarded;
+        if(!reader.next_line(line, len, discarded)) {
+            // the moves still in the window end the file stopped
+            while(count > 0) retire();
+            checkpoints.emplace_back(scanned, total_seconds);
+            reader.stop();
+            fclose(fp);
+            fp= nullptr;
+            done= true;
+            return;
+        }
+
+        // counted the way Player counts what it has played, which leaves out the empty lines
+        if(len == 1 && line[0] == '\n') continue;
+        scanned += len;
+
+        string text(line, len);
+        while(!text.empty() && strchr("\r\n \t", text.back()) != nullptr) text.pop_back();
+        text= text.substr(0, text.find_first_of(";("));
+        if(text.empty()) continue;
+
+        // an axis word on its own uses the last G0-G3
+        if(strchr("XYZIJKEF", text[0]) != nullptr) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "G%u ", motion_mode);
+            text.insert(0, buf);
+        }
+
+        // split the commands on the line the way GcodeDispatch does
+        while(!text.empty()) {
+            size_t next= text.find_first_of("GM", 2);
+            Gcode gcode(text.substr(0, next), &(StreamOutput::NullStream));
+            scan_line(gcode);
+            text= (next == string::npos) ? "" : text.substr(next);
+        }
+    } while(us_ticker_read() - start < max_us);
+}
+
+// follows the state Robot, Planner and Extruder keep for the gcodes that change how long the moves take
+void JobEstimate::scan_line(const Gcode &gcode)
+{
+    if(!gcode.has_g && !gcode.has_m) {
+        // a tool change, as ToolManager takes it
+        if(gcode.has_letter('T')) tool= gcode.get_value('T');
+        return;
+    }
+
+    if(gcode.has_m) {
+        switch(gcode.m) {
+            case 104: case 109: case 140: case 190:
+                // TemperatureControl waits for the queue to empty to set the temperature in order with the moves
+                if(gcode.has_letter('S')) add_heat(gcode);
+                break;
+            case 82: e_absolute_mode= true; break;
+            case 83: e_absolute_mode= false; break;
+            case 204:
+                if(gcode.has_letter('S')) acceleration= std::max(gcode.get_value('S'), 1.0F);
+                if(gcode.has_letter('Z')) z_acceleration= std::max(gcode.get_value('Z'), 0.0F);
+                break;
+            case 205:
+                if(gcode.has_letter('X')) junction_deviation= std::max(gcode.get_value('X'), 0.0F);
+                if(gcode.has_letter('Z')) z_junction_deviation= std::max(gcode.get_value('Z'), -1.0F);
+                if(gcode.has_letter('S')) minimum_planner_speed= std::max(gcode.get_value('S'), 0.0F);
+                break;
+        }
+        return;
+    }
+    if(!gcode.has_g) return;
+
+    switch(gcode.g) {
+        case 0: case 1: case 2: case 3: break;
+        case 4: {
+            float ms= 0.0F;
+            if(gcode.has_letter('P')) ms += gcode.get_int('P');
+            if(gcode.has_letter('S')) ms += gcode.get_int('S') * 1000;
+            if(ms > 0.0F) append_fixed(ms / 1000.0F);
+            return;
+        }
+        case 20: inch_mode= true; return;
+        case 21: inch_mode= false; return;
+        case 28:
+            // homing takes as long as it takes, it ends at 0 in the axes homed
+            for(int i= X_AXIS; i <= Z_AXIS; ++i) {
+                if(gcode.get_num_args() == 0 || gcode.has_letter('X' + i)) position[i]= 0.0F;
+            }
+            return;
+        case 90: absolute_mode= e_absolute_mode= true; return;
+        case 91: absolute_mode= e_absolute_mode= false; return;
+        case 92:
+            for(int i= X_AXIS; i <= Z_AXIS; ++i) {
+                if(gcode.has_letter('X' + i)) position[i]= to_millimeters(gcode.get_value('X' + i));
+            }
+            if(gcode.has_letter('E')) e_position= gcode.get_value('E');
+            return;
+        default: return;
+    }
+
+    motion_mode= gcode.g;
+    float target[3];
+    memcpy(target, position, sizeof(target));
+    for(int i= X_AXIS; i <= Z_AXIS; ++i) {
+        if(!gcode.has_letter('X' + i)) continue;
+        float v= to_millimeters(gcode.get_value('X' + i));
+        target[i]= absolute_mode ? v : position[i] + v;
+    }
+
+    if(gcode.has_letter('F')) {
+        float f= to_millimeters(gcode.get_value('F'));
+        if(gcode.g == 0) seek_rate= f;
+        else feed_rate= f;
+        e_feed_rate= gcode.get_value('F'); // Extruder takes the F of any move for its own moves, in mm/min
+    }
+
+    float e_distance= 0.0F;
+    if(gcode.has_letter('E')) {
+        float e= gcode.get_value('E');
+        e_distance= e_absolute_mode ? e - e_position : e;
+        e_position= e_absolute_mode ? e : e_position + e;
+    }
+
+    if(gcode.g <= 1) {
+        float d[3]{target[X_AXIS] - position[X_AXIS], target[Y_AXIS] - position[Y_AXIS], target[Z_AXIS] - position[Z_AXIS]};
+        if(sqrtf(d[X_AXIS] * d[X_AXIS] + d[Y_AXIS] * d[Y_AXIS] + d[Z_AXIS] * d[Z_AXIS]) < 0.00001F) {
+            // an extruder only move holds the queue while the extruder accelerates to its speed and back, as if it were
+            // a block of its own, it is taken to accelerate like the axes
+            float rate= e_feed_rate / start_seconds_per_minute;
+            if(e_distance != 0.0F && rate > 0.0F) {
+                move_t m{fabsf(e_distance), rate, 0.0F, 0.0F, acceleration, 0.0F, 0, false};
+                append_fixed(trapezoid_seconds(m, 0.0F));
+            }
+        } else {
+            append_segment(position, d, (gcode.g == 0 ? seek_rate : feed_rate) / start_seconds_per_minute);
+        }
+    } else {
+        append_arc(gcode, target, gcode.g == 2);
+    }
+    memcpy(position, target, sizeof(position));
+}
+
+// an empty stop in the moves, the time to it is known once the moves before it are retired
+void JobEstimate::add_heat(const Gcode &gcode)
+{
+    append_fixed(0.0F);
+
+    // only a change of target is kept, slicers often set the same one again
+    float target= gcode.get_value('S');
+    bool bed= gcode.m == 140 || gcode.m == 190;
+    auto last= last_targets.find(bed ? -2 : tool);
+    if(last != last_targets.end() && last->second == target) return;
+    last_targets[bed ? -2 : tool]= target;
+
+    if(!heats_kept) return;
+    moves[(oldest + count - 1) % window].heat= true;
+    heat_t h;
+    h.end= scanned;
+    h.seconds= 0.0F;
+    h.target= target;
+    h.m_code= gcode.m;
+    h.tool= bed ? -1 : tool;
+    h.known= false;
+    h.handled= false;
+    heats.push_back(h);
+}
+
+// the heats upto the offset have been played, one still to be planned is kept until it is
+void JobEstimate::drop_heats(unsigned long offset)
+{
+    auto i= heats.begin();
+    while(i != heats.end() && i->known && i->end <= offset) ++i;
+    heats.erase(heats.begin(), i);
+}
+
+// an arc, always in the XY plane, cut into as many chords as Robot cuts it into
+void JobEstimate::append_arc(const Gcode &gcode, const float target[], bool clockwise)
+{
+    float offset[2]{to_millimeters(gcode.get_value('I')), to_millimeters(gcode.get_value('J'))};
+    float radius= hypotf(offset[0], offset[1]);
+    float center[2]{position[X_AXIS] + offset[0], position[Y_AXIS] + offset[1]};
+    float r0= -offset[0], r1= -offset[1];
+    float rt0= target[X_AXIS] - center[0], rt1= target[Y_AXIS] - center[1];
+    float linear_travel= target[Z_AXIS] - position[Z_AXIS];
+
+    float angular_travel= atan2f(r0 * rt1 - r1 * rt0, r0 * rt0 + r1 * rt1);
+    if(clockwise) {
+        if(angular_travel >= -ARC_ANGULAR_TRAVEL_EPSILON) angular_travel -= 2 * M_PI;
+    } else {
+        if(angular_travel <= ARC_ANGULAR_TRAVEL_EPSILON) angular_travel += 2 * M_PI;
+    }
+    float millimeters= hypotf(angular_travel * radius, fabsf(linear_travel));
+    if(millimeters < 0.00001F) return;
+
+    uint16_t segments= THEKERNEL->robot->get_arc_segments(millimeters, radius, angular_travel);
+    float theta= angular_travel / segments;
+    // the chords are all the same length and turn by the same angle, only their direction changes
+    float start_angle= atan2f(-offset[1], -offset[0]);
+    float last[2]{position[X_AXIS], position[Y_AXIS]};
+    float rate= feed_rate / start_seconds_per_minute;
+    for(uint16_t i= 1; i <= segments; ++i) {
+        float p[2];
+        if(i == segments) {
+            p[0]= target[X_AXIS];
+            p[1]= target[Y_AXIS];
+        } else {
+            p[0]= center[0] + radius * cosf(start_angle + theta * i);
+            p[1]= center[1] + radius * sinf(start_angle + theta * i);
+        }
+        float from[3]{last[0], last[1], position[Z_AXIS] + linear_travel * (i - 1) / segments};
+        float d[3]{p[0] - last[0], p[1] - last[1], linear_travel / segments};
+        append_segment(from, d, rate);
+        last[0]= p[0];
+        last[1]= p[1];
+    }
+}
+
+// a straight move, as Planner::append_block plans it
+void JobEstimate::append_segment(const float from[], const float delta[], float rate_mm_s)
+{
+    float millimeters= sqrtf(delta[X_AXIS] * delta[X_AXIS] + delta[Y_AXIS] * delta[Y_AXIS] + delta[Z_AXIS] * delta[Z_AXIS]);
+    if(millimeters < 0.00001F) return;
+    float unit_vec[3]{delta[X_AXIS] / millimeters, delta[Y_AXIS] / millimeters, delta[Z_AXIS] / millimeters};
+
+    // the same as Robot::limit_cartesian_rate
+    Robot *robot= THEKERNEL->robot;
+    for(int axis= X_AXIS; axis <= Z_AXIS; ++axis) {
+        float max_speed= robot->get_max_speed(axis);
+        if(max_speed <= 0.0F) continue;
+        float axis_speed= fabsf(unit_vec[axis] * rate_mm_s);
+        if(axis_speed > max_speed) rate_mm_s *= max_speed / axis_speed;
+    }
+
+    if(millimeters < rate_mm_s * min_block_seconds) rate_mm_s= millimeters / min_block_seconds;
+
+    float a= acceleration, jd= junction_deviation;
+    if(delta[X_AXIS] == 0.0F && delta[Y_AXIS] == 0.0F) {
+        if(z_acceleration > 0.0F) a= z_acceleration;
+        if(z_junction_deviation >= 0.0F) jd= z_junction_deviation;
+    }
+
+    // the actuator acceleration limits, from how far each actuator moves between the ends of the segment
+    bool limited= false;
+    for(auto actuator : robot->actuators) limited= limited || actuator->get_acceleration() > 0.0F;
+    if(limited) {
+        float to[3]{from[X_AXIS] + delta[X_AXIS], from[Y_AXIS] + delta[Y_AXIS], from[Z_AXIS] + delta[Z_AXIS]};
+        ActuatorCoordinates start_pos, end_pos;
+        robot->arm_solution->cartesian_to_actuator(from, start_pos);
+        robot->arm_solution->cartesian_to_actuator(to, end_pos);
+        for(size_t i= 0; i < robot->actuators.size(); ++i) {
+            float actuator_acceleration= robot->actuators[i]->get_acceleration();
+            float actuator_mm= fabsf(end_pos[i] - start_pos[i]);
+            if(actuator_acceleration > 0.0F && a * actuator_mm > actuator_acceleration * millimeters) {
+                a= actuator_acceleration * millimeters / actuator_mm;
+            }
+        }
+    }
+
+    float vmax_junction= minimum_planner_speed;
+    if(count > 0) {
+        const move_t &previous= moves[(oldest + count - 1) % window];
+        if(previous.nominal_speed > 0.0F && jd > 0.0F) {
+            float cos_theta= - previous_unit_vec[X_AXIS] * unit_vec[X_AXIS]
+                             - previous_unit_vec[Y_AXIS] * unit_vec[Y_AXIS]
+                             - previous_unit_vec[Z_AXIS] * unit_vec[Z_AXIS];
+            if(cos_theta < 0.95F) {
+                vmax_junction= std::min(previous.nominal_speed, rate_mm_s);
+                if(cos_theta > -0.95F) {
+                    float sin_theta_d2= sqrtf(0.5F * (1.0F - cos_theta));
+                    vmax_junction= std::min(vmax_junction, sqrtf(a * jd * sin_theta_d2 / (1.0F - sin_theta_d2)));
+                }
+            }
+        }
+    }
+    memcpy(previous_unit_vec, unit_vec, sizeof(previous_unit_vec));
+
+    float v_allowable= sqrtf(minimum_planner_speed * minimum_planner_speed + 2.0F * a * millimeters);
+    move_t &m= append_move();
+    m.millimeters= millimeters;
+    m.nominal_speed= rate_mm_s;
+    m.max_entry_speed= vmax_junction;
+    m.entry_speed= std::min(vmax_junction, v_allowable);
+    m.acceleration= a;
+    m.nominal_length= rate_mm_s <= v_allowable;
+    recalculate();
+}
+
+// a dwell, or anything else the queue is held for without moving the axes, they stop for it
+void JobEstimate::append_fixed(float seconds)
+{
+    move_t &m= append_move();
+    m= move_t{0.0F, 0.0F, minimum_planner_speed, minimum_planner_speed, acceleration, seconds, 0, true};
+    recalculate();
+}
+
+// makes room at the end of the window, the oldest move is done with once the window is full
+JobEstimate::move_t &JobEstimate::append_move()
+{
+    if(count == window) retire();
+    move_t &m= moves[(oldest + count++) % window];
+    m.seconds= 0.0F;
+    m.end= scanned;
+    m.heat= false;
+    return m;
+}
+
+// the same speeds the reverse and forward passes of the Planner end up with, worked out over the whole window
+void JobEstimate::recalculate()
+{
+    // the newest move has to be able to stop
+    float exit_speed= minimum_planner_speed;
+    for(unsigned int i= count; i-- > 0; ) {
+        move_t &m= moves[(oldest + i) % window];
+        float v= m.nominal_length ? m.max_entry_speed : sqrtf(exit_speed * exit_speed + 2.0F * m.acceleration * m.millimeters);
+        m.entry_speed= std::min(m.max_entry_speed, v);
+        exit_speed= m.entry_speed;
+    }
+
+    for(unsigned int i= 1; i < count; ++i) {
+        const move_t &previous= moves[(oldest + i - 1) % window];
+        move_t &m= moves[(oldest + i) % window];
+        float v= sqrtf(previous.entry_speed * previous.entry_speed + 2.0F * previous.acceleration * previous.millimeters);
+        if(v < m.entry_speed) m.entry_speed= v;
+    }
+}
+
+// the oldest move is run at the speeds it has now, its time is added to the total
+void JobEstimate::retire()
+{
+    move_t &m= moves[oldest];
+    float exit_speed= minimum_planner_speed;
+    oldest= (oldest + 1) % window;
+    --count;
+    if(count > 0) {
+        // the next one can not enter any faster than this one left
+        move_t &next= moves[oldest];
+        exit_speed= next.entry_speed;
+        next.max_entry_speed= next.entry_speed;
+    }
+
+    total_seconds += (m.millimeters == 0.0F) ? m.seconds : trapezoid_seconds(m, exit_speed);
+
+    if(m.heat) {
+        // the heats are in the order of their moves, this is the first one not yet known
+        for(auto &h : heats) {
+            if(h.known) continue;
+            h.seconds= total_seconds;
+            h.known= true;
+            break;
+        }
+    }
+
+    unsigned long last= checkpoints.empty() ? 0 : checkpoints.back().first;
+    if(m.end >= last + checkpoint_spacing) checkpoints.emplace_back(m.end, total_seconds);
+}
+
+// accelerate from the entry speed, cruise at the nominal speed and decelerate to the exit speed
+float JobEstimate::trapezoid_seconds(const move_t &m, float exit_speed)
+{
+    float a= m.acceleration, v0= m.entry_speed, v1= exit_speed, vn= m.nominal_speed;
+    if(a <= 0.0F || vn <= 0.0F) return 0.0F;
+
+    float accelerate= (vn * vn - v0 * v0) / (2.0F * a);
+    float decelerate= (vn * vn - v1 * v1) / (2.0F * a);
+    if(accelerate + decelerate <= m.millimeters) {
+        return (vn - v0) / a + (vn - v1) / a + (m.millimeters - accelerate - decelerate) / vn;
+    }
+
+    // it does not reach the nominal speed
+    float peak= sqrtf(std::max(0.0F, (2.0F * a * m.millimeters + v0 * v0 + v1 * v1) / 2.0F));
+    return (std::max(peak - v0, 0.0F) + std::max(peak - v1, 0.0F)) / a;
+}
+
+// the time to run the file upto the offset at the speed override it was planned with, from the nearest points kept
+float JobEstimate::seconds_at(unsigned long offset) const
+{
+    unsigned long o0= 0;
+    float t0= 0.0F;
+    for(auto &c : checkpoints) {
+        if(c.first >= offset) {
+            if(c.first == o0) return c.second;
+            return t0 + (c.second - t0) * (offset - o0) / (c.first - o0);
+        }
+        o0= c.first;
+        t0= c.second;
+    }
+    return total_seconds;
+}
+
+// the time from the offset to a point planned to be that far into the file, at the current speed override
+float JobEstimate::seconds_between(unsigned long offset, float seconds) const
+{
+    float left= std::max(0.0F, seconds - seconds_at(offset));
+    return left * THEKERNEL->robot->get_seconds_per_minute() / start_seconds_per_minute;
+}
+
+// the time left after the offset, at the current speed override
+float JobEstimate::remaining_seconds(unsigned long offset) const
+{
+    return seconds_between(offset, total_seconds);
+}
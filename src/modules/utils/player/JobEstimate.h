@@ -0,0 +1,121 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JOBESTIMATE_H
+#define JOBESTIMATE_H
+
+#include "LineReader.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+using std::string;
+
+class Gcode;
+
+// Works out how long a gcode file takes by reading it ahead of the player and planning its moves the way the Planner
+// does, with the same acceleration, junction deviation and axis speed limits and a queue as long as the Conveyor's.
+// The time is kept at a few points through the file, so the time left can be found from how far it has been played.
+// Heater waits, homing and probing take as long as they take and are not counted.
+class JobEstimate {
+    public:
+        // a temperature the file sets, and when it is planned to, so the heater can be started on it ahead of time
+        struct heat_t {
+            unsigned long end;                              // file offset of the end of the line it is on
+            float seconds;                                  // the time to get there, once the moves before it are planned
+            float target;
+            uint16_t m_code;
+            int8_t tool;                                    // the last T before it, -1 if there was none
+            bool known:1;
+            bool handled:1;
+        };
+
+        JobEstimate();
+        ~JobEstimate();
+
+        bool start(const string &filename, unsigned long file_size);
+        void stop();
+        void scan(uint32_t max_us);
+        bool is_scanning() const { return fp != nullptr; }
+        bool is_done() const { return done; }
+        unsigned long get_scanned() const { return scanned; }
+        float get_total_seconds() const { return total_seconds; }
+        float seconds_at(unsigned long offset) const;
+        float remaining_seconds(unsigned long offset) const;
+        float seconds_between(unsigned long offset, float seconds) const;
+
+        // with the heats kept the scan waits while max_heats of them are ahead of the player
+        void keep_heats(bool on) { heats_kept= on; }
+        unsigned int heat_count() const { return heats.size(); }
+        heat_t &heat(unsigned int i) { return heats[i]; }
+        void drop_heats(unsigned long offset);
+
+    private:
+        struct move_t {
+            float millimeters;
+            float nominal_speed;
+            float max_entry_speed;
+            float entry_speed;
+            float acceleration;
+            float seconds;                                  // the time of a dwell or an extruder only move, which have no millimeters
+            unsigned long end;                              // file offset of the end of the line it is from
+            bool nominal_length;
+            bool heat;                                      // the queue is held here for a temperature change
+        };
+        // the Conveyor queue is this long by default, the speeds of a block do not change once it is this far back
+        static const unsigned int window= 32;
+        static const unsigned int max_checkpoints= 64;
+        static const unsigned int max_heats= 16;
+
+        void scan_line(const Gcode &gcode);
+        void add_heat(const Gcode &gcode);
+        void append_arc(const Gcode &gcode, const float target[], bool clockwise);
+        void append_segment(const float from[], const float delta[], float rate_mm_s);
+        void append_fixed(float seconds);
+        move_t &append_move();
+        void recalculate();
+        void retire();
+        static float trapezoid_seconds(const move_t &m, float exit_speed);
+        float to_millimeters(float value) const { return inch_mode ? value * 25.4F : value; }
+
+        FILE *fp;
+        LineReader reader;
+        unsigned long scanned;                              // bytes of the file read so far
+        unsigned long checkpoint_spacing;
+        std::vector<std::pair<unsigned long, float>> checkpoints;  // file offset and the time to get there
+        float total_seconds;
+        float start_seconds_per_minute;                     // the speed override the file was planned with
+
+        move_t moves[window];
+        unsigned int oldest, count;
+        float previous_unit_vec[3];
+
+        std::vector<heat_t> heats;                          // in file order
+        std::map<int, float> last_targets;                  // for each heater, the bed is -2, a hotend the tool
+        int8_t tool;
+
+        // parser state, as Robot keeps it
+        float position[3];
+        float e_position;
+        float feed_rate, seek_rate, e_feed_rate;            // mm/min
+        float acceleration, z_acceleration;                 // as in Planner, set by M204
+        float junction_deviation, z_junction_deviation;     // set by M205
+        float minimum_planner_speed;
+        float min_block_seconds;
+        uint8_t motion_mode;
+        struct {
+            bool done:1;
+            bool absolute_mode:1;
+            bool e_absolute_mode:1;
+            bool inch_mode:1;
+            bool heats_kept:1;
+        };
+};
+
+#endif
@@ -0,0 +1,182 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Journal.h"
+
+#include "libs/Kernel.h"
+#include "Robot.h"
+#include "Conveyor.h"
+#include "checksumm.h"
+#include "PublicData.h"
+#include "ExtruderPublicAccess.h"
+#include "TemperatureControlPublicAccess.h"
+#include "crc32.h"
+
+#include <string.h>
+#include <stddef.h>
+
+static_assert(sizeof(Journal::record_t) <= 512, "a journal record is written as one sector");
+
+Journal::Journal()
+{
+    fp= nullptr;
+    lines= nullptr;
+    file_size= 0;
+    seq= 0;
+    written= 0;
+    interval= 0;
+    secs= 0;
+    queued= false;
+}
+
+Journal::~Journal()
+{
+    stop(false);
+}
+
+// starts the journal afresh two sectors long, and starts noting the lines of the file
+bool Journal::start(const string &path, const string &filename, long file_size, uint16_t interval)
+{
+    stop(false);
+
+    fp= fopen(path.c_str(), "w+");
+    if(fp == nullptr) return false;
+    // each write goes straight to its sector
+    setvbuf(fp, nullptr, _IONBF, 0);
+    // allocated here, so the writes while playing only overwrite what is there
+    clear();
+    written= 0;
+
+    if(lines == nullptr) lines= new line_t[max_lines];
+    memset(lines, 0, sizeof(line_t) * max_lines);
+    this->filename= filename;
+    this->file_size= file_size;
+    this->interval= interval;
+    seq= 1;
+    secs= 0;
+    queued= false;
+    return true;
+}
+
+// a finished file leaves nothing to recover
+void Journal::stop(bool finished)
+{
+    if(fp == nullptr) return;
+    if(finished) clear();
+    fclose(fp);
+    fp= nullptr;
+    delete [] lines;
+    lines= nullptr;
+}
+
+void Journal::clear()
+{
+    uint32_t zero[sector_size / 4];
+    memset(zero, 0, sizeof(zero));
+    fseek(fp, 0, SEEK_SET);
+    fwrite(zero, 1, sizeof(zero), fp);
+    fwrite(zero, 1, sizeof(zero), fp);
+    fflush(fp);
+}
+
+// called before each line is played, with the offset of the line in the file
+void Journal::line(unsigned long offset)
+{
+    // a held back move is queued with the line it started on, which is where it has to be played again from
+    if(THEKERNEL->robot->is_move_held()) return;
+
+    // a line that queued nothing leaves its place to this one
+    if(queued) {
+        ++seq;
+        queued= false;
+    }
+
+    line_t &l= lines[seq % max_lines];
+    l.seq= seq;
+    l.offset= offset;
+    THEKERNEL->robot->get_axis_position(l.position);
+    void *returned_data;
+    if(PublicData::get_value(extruder_checksum, position_checksum, &returned_data)) {
+        const pad_extruder_position *e= static_cast<const pad_extruder_position *>(returned_data);
+        l.e= e->position;
+        l.e_absolute_mode= e->absolute_mode;
+    } else {
+        l.e= 0;
+        l.e_absolute_mode= true;
+    }
+    THEKERNEL->conveyor->set_block_tag(seq);
+}
+
+void Journal::second_tick()
+{
+    if(fp == nullptr || ++secs < interval) return;
+    // when the line of the running block has already been forgotten this tries again next second
+    if(write()) secs= 0;
+}
+
+// writes where the block that is running came from, the whole line is played again as it can not be split
+bool Journal::write()
+{
+    uint32_t tag;
+    if(!THEKERNEL->conveyor->get_running_tag(tag)) tag= seq;
+    const line_t &l= lines[tag % max_lines];
+    if(l.seq != tag) return false;
+
+    uint32_t sector[sector_size / 4];
+    memset(sector, 0, sizeof(sector));
+    record_t *r= reinterpret_cast<record_t *>(sector);
+    r->magic= magic;
+    r->sequence= ++written;
+    r->offset= l.offset;
+    r->file_size= file_size;
+    memcpy(r->position, l.position, sizeof(r->position));
+    r->e= l.e;
+    r->e_absolute_mode= l.e_absolute_mode;
+    Robot::motion_state_t ms;
+    THEKERNEL->robot->get_motion_state(ms);
+    r->feed_rate= ms.feed_rate;
+    r->absolute_mode= THEKERNEL->robot->absolute_mode;
+
+    void *returned_data;
+    if(PublicData::get_value(temperature_control_checksum, temperature_snapshot_checksum, &returned_data)) {
+        const pad_temperature_snapshot *s= static_cast<const pad_temperature_snapshot *>(returned_data);
+        for(int i= 0; i < s->count && r->n_temperatures < 8; ++i) {
+            if(s->rows[i].target_temperature <= 0) continue;
+            r->temperature_id[r->n_temperatures]= s->rows[i].id;
+            r->temperature[r->n_temperatures]= s->rows[i].target_temperature;
+            ++r->n_temperatures;
+        }
+    }
+    strncpy(r->filename, filename.c_str(), sizeof(r->filename) - 1);
+    r->crc= crc32_update(0, r, offsetof(record_t, crc));
+
+    fseek(fp, (written & 1) * sector_size, SEEK_SET);
+    fwrite(sector, 1, sizeof(sector), fp);
+    fflush(fp);
+    return true;
+}
+
+// the newer of the good records, false when there is none
+bool Journal::read(const string &path, record_t &r)
+{
+    FILE *f= fopen(path.c_str(), "r");
+    if(f == nullptr) return false;
+
+    bool found= false;
+    uint32_t sector[sector_size / 4];
+    for(int i= 0; i < 2; ++i) {
+        if(fread(sector, 1, sizeof(sector), f) != sizeof(sector)) break;
+        const record_t *s= reinterpret_cast<const record_t *>(sector);
+        if(s->magic != magic || s->crc != crc32_update(0, s, offsetof(record_t, crc))) continue;
+        if(found && s->sequence < r.sequence) continue;
+        memcpy(&r, s, sizeof(r));
+        found= true;
+    }
+    fclose(f);
+    r.filename[sizeof(r.filename) - 1]= '\0';
+    return found;
+}
@@ -0,0 +1,78 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+using std::string;
+
+// Where a file being played has got to, so it can be played on from there after a power loss. Each line played
+// notes its offset and the position it starts from, the blocks it queues are tagged with it, and every interval the
+// line of the block that is running is written with the temperatures to one of two sectors of a file that was
+// allocated when it started, taking turns so a write cut short leaves the other one good. Nothing is allocated on the
+// sdcard after that, a write only overwrites a sector.
+class Journal {
+    public:
+        Journal();
+        ~Journal();
+
+        struct record_t {
+            uint32_t magic;
+            uint32_t sequence;              // of the writes, the newer of the two sectors is the one used
+            uint32_t offset;                // of the line to play on from
+            uint32_t file_size;             // of the file when it was played, a changed file is not recovered
+            float position[3];              // the machine was at before that line, as Robot::get_axis_position has it
+            float e;
+            float feed_rate;                // mm/sec
+            uint8_t absolute_mode;
+            uint8_t e_absolute_mode;
+            uint8_t n_temperatures;
+            uint16_t temperature_id[8];
+            float temperature[8];
+            char filename[128];
+            uint32_t crc;
+        };
+
+        bool start(const string &path, const string &filename, long file_size, uint16_t interval);
+        void stop(bool finished);
+        bool is_started() const { return fp != nullptr; }
+        void line(unsigned long offset);
+        void block_queued() { queued= true; }
+        void second_tick();
+
+        static bool read(const string &path, record_t &r);
+
+    private:
+        bool write();
+        void clear();
+
+        struct line_t {
+            uint32_t seq;
+            uint32_t offset;
+            float position[3];
+            float e;
+            bool e_absolute_mode;
+        };
+        static const uint32_t magic= 0x4C4E524A;   // JRNL
+        static const size_t sector_size= 512;
+        static const size_t max_lines= 32;          // lines that can be in the queue at once to be found again
+
+        FILE *fp;
+        line_t *lines;
+        string filename;
+        uint32_t file_size;
+        uint32_t seq;                               // of the line being played
+        uint32_t written;
+        uint16_t interval;                          // seconds between writes
+        uint16_t secs;
+        bool queued;                                // the line being played has queued a block
+};
+
+#endif
@@ -0,0 +1,124 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LineReader.h"
+
+#include <string.h>
+
+LineReader::LineReader()
+{
+    fp= nullptr;
+    buf= nullptr;
+    rd= wr= 0;
+    eof= false;
+    discarding= false;
+}
+
+LineReader::~LineReader()
+{
+    stop();
+}
+
+// start reading the file from its current position, the file must not be read by anything else until stop()
+void LineReader::start(FILE *fp)
+{
+    stop();
+    if(buf == nullptr) buf= new char[buffer_size];
+    // unbuffered so stdio reads the sectors straight into our buffer, which lets FatFs do multi block reads
+    setvbuf(fp, nullptr, _IONBF, 0);
+    this->fp= fp;
+}
+
+// forget the file, it is not closed
+void LineReader::stop()
+{
+    fp= nullptr;
+    rd= wr= 0;
+    eof= false;
+    discarding= false;
+    delete [] buf;
+    buf= nullptr;
+}
+
+// read ahead whole sectors while there is room, this is called on idle so the reads happen while the queue is full
+void LineReader::fill()
+{
+    if(fp == nullptr || eof) return;
+
+    if(rd == wr) {
+        rd= wr= 0;
+
+    } else if(rd >= buffer_size / 2 || buffer_size - wr < sector_size) {
+        // move what is left to the front, which is less than a couple of lines most of the time
+        memmove(buf, &buf[rd], wr - rd);
+        wr -= rd;
+        rd= 0;
+    }
+
+    // read at most half the buffer at a time to limit how long we hold up the caller
+    size_t n= (buffer_size - wr) & ~(sector_size - 1);
+    if(n > buffer_size / 2) n= buffer_size / 2;
+    if(n == 0) return;
+
+    size_t got= fread(&buf[wr], 1, n, fp);
+    wr += got;
+    if(got < n) eof= true;
+}
+
+// returns the next line including its newline, it is valid until the next call to fill() or next_line()
+// lines longer than max_line_length are skipped and discarded is set, returns false at the end of the file
+bool LineReader::next_line(const char *&line, size_t &len, bool &discarded)
+{
+    discarded= false;
+    while(fp != nullptr) {
+        const char *b= &buf[rd];
+        size_t avail= wr - rd;
+        const char *nl= (const char *)memchr(b, '\n', avail);
+
+        if(nl == nullptr) {
+            if(discarding || avail > max_line_length) {
+                // too long, drop it and keep dropping up to its newline
+                rd= wr;
+                discarding= true;
+                discarded= true;
+                if(eof) return false;
+                fill();
+
+            } else if(!eof) {
+                // need more of the file to find the end of this line
+                fill();
+
+            } else if(avail == 0) {
+                return false;
+
+            } else {
+                // last line of the file has no newline
+                line= b;
+                len= avail;
+                rd= wr;
+                return true;
+            }
+            continue;
+        }
+
+        size_t n= nl - b + 1;
+        rd += n;
+        if(discarding) {
+            discarding= false;
+            continue;
+        }
+        if(n > max_line_length + 1) {
+            discarded= true;
+            continue;
+        }
+
+        line= b;
+        len= n;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,44 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LINEREADER_H
+#define LINEREADER_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Reads a file ahead in whole sectors, and hands out the lines straight from its buffer
+class LineReader {
+    public:
+        LineReader();
+        ~LineReader();
+
+        void start(FILE *fp);
+        void stop();
+        bool is_started() const { return fp != nullptr; }
+        // all of the file has been read, the last of its lines may still be to come
+        bool is_eof() const { return eof; }
+        void fill();
+        bool next_line(const char *&line, size_t &len, bool &discarded);
+
+        static const size_t max_line_length= 128;
+
+    private:
+        static const size_t buffer_size= 4096;
+        static const size_t sector_size= 512;
+
+        FILE *fp;
+        char *buf;
+        size_t rd;  // start of the unread data
+        size_t wr;  // end of the data read from the file
+        struct {
+            bool eof:1;
+            bool discarding:1;
+        };
+};
+
+#endif
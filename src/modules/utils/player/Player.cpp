@@ -8,6 +8,7 @@
 #include "Player.h"
 
 #include "libs/Kernel.h"
+#include "libs/InputArbiter.h"
 #include "Robot.h"
 #include "libs/nuts_bolts.h"
 #include "libs/utils.h"
@@ -28,7 +29,9 @@
 #include "PlayerPublicAccess.h"
 #include "TemperatureControlPublicAccess.h"
 #include "TemperatureControlPool.h"
+#include "ToolManagerPublicAccess.h"
 #include "ExtruderPublicAccess.h"
+#include "us_ticker_api.h"
 
 #include <cstddef>
 #include <cmath>
@@ -41,6 +44,11 @@
 #define after_suspend_gcode_checksum      CHECKSUM("after_suspend_gcode")
 #define before_resume_gcode_checksum      CHECKSUM("before_resume_gcode")
 #define leave_heaters_on_suspend_checksum CHECKSUM("leave_heaters_on_suspend")
+#define compile_on_upload_checksum        CHECKSUM("compile_on_upload")
+#define preheat_lookahead_checksum        CHECKSUM("preheat_lookahead")
+#define journal_interval_checksum         CHECKSUM("journal_interval")
+#define journal_file_checksum             CHECKSUM("journal_file")
+#define journal_recover_gcode_checksum    CHECKSUM("journal_recover_gcode")
 
 extern SDFAT mounter;
 
@@ -48,6 +56,8 @@ Player::Player()
 {
     this->playing_file = false;
     this->current_file_handler = nullptr;
+    this->next_file_handler = nullptr;
+    this->jobs_played = 0;
     this->booted = false;
     this->elapsed_secs = 0;
     this->reply_stream = nullptr;
@@ -59,10 +69,17 @@ void Player::on_module_loaded()
 {
     this->register_for_event(ON_CONSOLE_LINE_RECEIVED);
     this->register_for_event(ON_MAIN_LOOP);
+    this->register_for_event(ON_IDLE);
+    // reads the lines that keep the planner fed
+    this->set_event_priority(ON_MAIN_LOOP, PRIORITY_FEED);
+    this->set_event_priority(ON_IDLE, PRIORITY_FEED);
     this->register_for_event(ON_SECOND_TICK);
     this->register_for_event(ON_GET_PUBLIC_DATA);
     this->register_for_event(ON_SET_PUBLIC_DATA);
+    PublicData::register_handler(this, player_checksum);
     this->register_for_event(ON_GCODE_RECEIVED);
+    THEKERNEL->add_input_check([this]() { return playing_file && !suspended; });
+    input_source= THEKERNEL->input_arbiter->add_source("player", [this]() { return playing_file && !suspended; });
 
     this->on_boot_gcode = THEKERNEL->config->value(on_boot_gcode_checksum)->by_default("/sd/on_boot.gcode")->as_string();
     this->on_boot_gcode_enable = THEKERNEL->config->value(on_boot_gcode_enable_checksum)->by_default(true)->as_bool();
@@ -72,11 +89,26 @@ void Player::on_module_loaded()
     std::replace( this->after_suspend_gcode.begin(), this->after_suspend_gcode.end(), '_', ' '); // replace _ with space
     std::replace( this->before_resume_gcode.begin(), this->before_resume_gcode.end(), '_', ' '); // replace _ with space
     this->leave_heaters_on = THEKERNEL->config->value(leave_heaters_on_suspend_checksum)->by_default(false)->as_bool();
+    this->compile_on_upload = THEKERNEL->config->value(compile_on_upload_checksum)->by_default(false)->as_bool();
+    this->preheat_lookahead = THEKERNEL->config->value(preheat_lookahead_checksum)->by_default(false)->as_bool();
+    this->estimate.keep_heats(this->preheat_lookahead);
+
+    this->journal_interval = THEKERNEL->config->value(journal_interval_checksum)->by_default(0)->as_int();
+    this->journal_file = THEKERNEL->config->value(journal_file_checksum)->by_default("/sd/journal.bin")->as_string();
+    this->journal_recover_gcode = THEKERNEL->config->value(journal_recover_gcode_checksum)->by_default("G28_X0_Y0")->as_string();
+    std::replace( this->journal_recover_gcode.begin(), this->journal_recover_gcode.end(), '_', ' '); // replace _ with space
+    if(this->journal_interval > 0) {
+        THEKERNEL->conveyor->add_start_hook([this]() { this->journal.block_queued(); });
+    }
 }
 
 void Player::on_second_tick(void *)
 {
-    if(this->playing_file) this->elapsed_secs++;
+    if(this->playing_file) {
+        this->elapsed_secs++;
+        if(this->preheat_lookahead && !this->suspended) preheat();
+        if(!this->suspended) this->journal.second_tick();
+    }
 }
 
 // extract any options found on line, terminates args at the space before the first option (-v)
@@ -109,6 +141,10 @@ void Player::on_gcode_received(void *argument)
 
             if(this->current_file_handler != NULL) {
                 this->playing_file = false;
+                this->reader.stop();
+                this->job.stop();
+                this->estimate.stop();
+                this->journal.stop(false);
                 fclose(this->current_file_handler);
             }
             this->current_file_handler = fopen( this->filename.c_str(), "r");
@@ -180,6 +216,10 @@ void Player::on_gcode_received(void *argument)
 
             if(this->current_file_handler != NULL) {
                 this->playing_file = false;
+                this->reader.stop();
+                this->job.stop();
+                this->estimate.stop();
+                this->journal.stop(false);
                 fclose(this->current_file_handler);
             }
 
@@ -250,6 +290,10 @@ void Player::on_console_line_received( void *argument )
         this->suspend_command( possible_command, new_message.stream );
     }else if (cmd == "resume") {
         this->resume_command( possible_command, new_message.stream );
+    }else if (cmd == "compile") {
+        this->compile_command( possible_command, new_message.stream );
+    }else if (cmd == "recover") {
+        this->recover_command( possible_command, new_message.stream );
     }
 }
 
@@ -259,14 +303,29 @@ void Player::play_command( string parameters, StreamOutput *stream )
     // extract any options from the line and terminate the line there
     string options= extract_options(parameters);
     // Get filename which is the entire parameter line upto any options found or entire line
-    this->filename = absolute_from_relative(parameters);
+    string name = absolute_from_relative(parameters);
 
     if(this->playing_file || this->suspended) {
-        stream->printf("Currently printing, abort print first\r\n");
+        // -q queues it to start as soon as the one playing ends
+        if(options.find_first_of("Qq") == string::npos) {
+            stream->printf("Currently printing, abort print first\r\n");
+            return;
+        }
+        if(!file_exists(name)) {
+            stream->printf("File not found: %s\r\n", name.c_str());
+            return;
+        }
+        this->play_list.push_back(name);
+        stream->printf("Queued %s, %u to play after this one\r\n", name.c_str(), (unsigned)this->play_list.size());
         return;
     }
+    this->filename = name;
 
     if(this->current_file_handler != NULL) { // must have been a paused print
+        this->reader.stop();
+        this->job.stop();
+        this->estimate.stop();
+        this->journal.stop(false);
         fclose(this->current_file_handler);
     }
 
@@ -300,6 +359,159 @@ void Player::play_command( string parameters, StreamOutput *stream )
     }
     this->played_cnt = 0;
     this->elapsed_secs = 0;
+    this->jobs_played = 0;
+}
+
+// starts the next file of the play list from where the last one ended, false when there are no more
+bool Player::play_next_job()
+{
+    while(!this->play_list.empty()) {
+        this->filename = this->play_list.front();
+        this->play_list.erase(this->play_list.begin());
+        FILE *fp = this->next_file_handler;
+        this->next_file_handler = NULL;
+        if(fp == NULL) fp = fopen(this->filename.c_str(), "r");
+        if(fp == NULL) {
+            THEKERNEL->streams->printf("File not found: %s, skipped\r\n", this->filename.c_str());
+            continue;
+        }
+
+        this->current_file_handler = fp;
+        if(fseek(fp, 0, SEEK_END) != 0) {
+            file_size = 0;
+        } else {
+            file_size = ftell(fp);
+            fseek(fp, 0, SEEK_SET);
+        }
+        this->played_cnt = 0;
+        this->elapsed_secs = 0;
+        ++this->jobs_played;
+        this->current_stream->printf("Playing %s\r\n", this->filename.c_str());
+        return true;
+    }
+    return false;
+}
+
+void Player::clear_play_list()
+{
+    this->play_list.clear();
+    if(this->next_file_handler != NULL) {
+        fclose(this->next_file_handler);
+        this->next_file_handler = NULL;
+    }
+    this->jobs_played = 0;
+}
+
+// compile a gcode file into a job that is played without parsing or segmenting its moves again
+void Player::compile_command( string parameters, StreamOutput *stream )
+{
+    string filename= absolute_from_relative(shift_parameter(parameters));
+    if(filename.empty()) {
+        stream->printf("Usage: compile file [job file]\r\n");
+        return;
+    }
+
+    if(this->playing_file || this->suspended) {
+        stream->printf("Currently printing, abort print first\r\n");
+        return;
+    }
+
+    string jobname= parameters.empty() ? CompiledJob::job_name(filename) : absolute_from_relative(parameters);
+    if(jobname == filename) {
+        stream->printf("Can not compile %s to itself\r\n", filename.c_str());
+        return;
+    }
+
+    stream->printf("Compiling %s...\r\n", filename.c_str());
+    CompiledJob::compile(filename, jobname, stream);
+}
+
+// play on from where the journal says the file got to. Z is taken to be where it was, the recover gcode homes the
+// rest, then it goes on as resume does after a suspend: the heaters are brought back up, it goes back to the position
+// the line started from and the file is played from that line
+void Player::recover_command( string parameters, StreamOutput *stream )
+{
+    if(this->playing_file || this->suspended) {
+        stream->printf("Currently printing, abort print first\r\n");
+        return;
+    }
+
+    Journal::record_t r;
+    if(!Journal::read(this->journal_file, r)) {
+        stream->printf("Nothing to recover in %s\r\n", this->journal_file.c_str());
+        return;
+    }
+
+    FILE *fp = fopen(r.filename, "r");
+    if(fp == NULL) {
+        stream->printf("File not found: %s\r\n", r.filename);
+        return;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    if(size != (long)r.file_size || fseek(fp, r.offset, SEEK_SET) != 0) {
+        stream->printf("%s has changed since it was played, can not recover\r\n", r.filename);
+        fclose(fp);
+        return;
+    }
+
+    stream->printf("Recovering %s from byte %lu/%ld at X%1.3f Y%1.3f Z%1.3f E%1.3f\r\n", r.filename, (unsigned long)r.offset, size,
+                   r.position[0], r.position[1], r.position[2], r.e);
+
+    if(this->current_file_handler != NULL) { // must have been a paused print
+        this->reader.stop();
+        this->job.stop();
+        this->estimate.stop();
+        fclose(this->current_file_handler);
+    }
+
+    THEKERNEL->robot->reset_axis_position(r.position[Z_AXIS], Z_AXIS);
+    if(!this->journal_recover_gcode.empty()) {
+        struct SerialMessage message;
+        message.message = this->journal_recover_gcode;
+        message.stream = &(StreamOutput::NullStream);
+        THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
+        THEKERNEL->conveyor->wait_for_empty_queue();
+    }
+    if(THEKERNEL->is_halted()) {
+        fclose(fp);
+        return;
+    }
+
+    // the modes the file had set, then E, saved as the state resume restores
+    {
+        char buf[32];
+        int n = snprintf(buf, sizeof(buf), "%s", r.e_absolute_mode ? "M82" : "M83");
+        Gcode m(string(buf, n), &(StreamOutput::NullStream));
+        THEKERNEL->call_event(ON_GCODE_RECEIVED, &m );
+        n = snprintf(buf, sizeof(buf), "G92 E%f", r.e);
+        Gcode g(string(buf, n), &(StreamOutput::NullStream));
+        THEKERNEL->call_event(ON_GCODE_RECEIVED, &g );
+    }
+    Robot::motion_state_t ms;
+    THEKERNEL->robot->get_motion_state(ms);
+    ms.feed_rate = r.feed_rate;
+    THEKERNEL->robot->set_motion_state(ms);
+    THEKERNEL->robot->absolute_mode = r.absolute_mode;
+    THEKERNEL->robot->push_state();
+    PublicData::set_value( extruder_checksum, save_state_checksum, nullptr );
+
+    memcpy(this->saved_position, r.position, sizeof(this->saved_position));
+    this->saved_temperatures.clear();
+    for(int i = 0; i < r.n_temperatures && i < 8; ++i) {
+        this->saved_temperatures[r.temperature_id[i]] = r.temperature[i];
+    }
+
+    this->current_file_handler = fp;
+    this->filename = r.filename;
+    this->file_size = size;
+    this->played_cnt = r.offset;
+    this->elapsed_secs = 0;
+    this->jobs_played = 0;
+    this->current_stream = &(StreamOutput::NullStream);
+    this->suspended = true;
+    this->was_playing_file = true;
+    resume_command("", stream);
 }
 
 void Player::progress_command( string parameters, StreamOutput *stream )
@@ -322,8 +534,9 @@ void Player::progress_command( string parameters, StreamOutput *stream )
     }
 
     if(file_size > 0) {
-        unsigned long est = 0;
-        if(this->elapsed_secs > 10) {
+        // from the planned time when the file has been scanned, otherwise from how fast it has been played so far
+        unsigned long est = remaining_seconds();
+        if(est == 0 && this->elapsed_secs > 10) {
             unsigned long bytespersec = played_cnt / this->elapsed_secs;
             if(bytespersec > 0)
                 est = (file_size - played_cnt) / bytespersec;
@@ -336,6 +549,10 @@ void Player::progress_command( string parameters, StreamOutput *stream )
             if(est > 0) {
                 stream->printf(", est time: %lu s",  est);
             }
+            if(!this->play_list.empty() || this->jobs_played > 0) {
+                stream->printf(", job %u of %u", this->jobs_played + 1, this->jobs_played + 1 + (unsigned)this->play_list.size());
+                if(!this->play_list.empty()) stream->printf(", next: %s", this->play_list.front().c_str());
+            }
             stream->printf("\r\n");
         } else {
             stream->printf("SD printing byte %lu/%lu\r\n", played_cnt, file_size);
@@ -358,8 +575,14 @@ void Player::abort_command( string parameters, StreamOutput *stream )
     file_size = 0;
     this->filename = "";
     this->current_stream = NULL;
+    this->reader.stop();
+    this->job.stop();
+    this->estimate.stop();
+    // a halt leaves the journal to recover from
+    this->journal.stop(parameters.empty());
     fclose(current_file_handler);
     current_file_handler = NULL;
+    clear_play_list();
     if(parameters.empty()) {
         // clear out the block queue, will wait until queue is empty
         // MUST be called in on_main_loop to make sure there are no blocked main loops waiting to put something on the queue
@@ -395,43 +618,72 @@ void Player::on_main_loop(void *argument)
             abort_command("1", &(StreamOutput::NullStream));
             return;
         }
+        if(!THEKERNEL->input_arbiter->may_take(input_source)) return;
+
+        if(!this->reader.is_started() && !this->job.is_started()) {
+            if(!CompiledJob::is_job(this->filename)) {
+                this->reader.start(this->current_file_handler);
+                this->estimate.start(this->filename, this->file_size);
+                if(this->journal_interval > 0 && !this->journal.start(this->journal_file, this->filename, this->file_size, this->journal_interval)) {
+                    THEKERNEL->streams->printf("WARNING: could not open the journal %s\r\n", this->journal_file.c_str());
+                }
 
-        char buf[130]; // lines upto 128 characters are allowed, anything longer is discarded
-        bool discard = false;
+            } else if(!this->job.start(this->current_file_handler, THEKERNEL->streams)) {
+                abort_command("1", &(StreamOutput::NullStream));
+                return;
+            }
+        }
 
-        while(fgets(buf, sizeof(buf), this->current_file_handler) != NULL) {
-            int len = strlen(buf);
-            if(len == 0) continue; // empty line? should not be possible
-            if(buf[len - 1] == '\n' || feof(this->current_file_handler)) {
-                if(discard) { // we are discarding a long line
-                    discard = false;
-                    continue;
+        if(this->job.is_started()) {
+            // queues the blocks of one compiled line, or plays one text line
+            if(this->job.play_next(this->current_stream, this->played_cnt)) {
+                THEKERNEL->input_arbiter->took(input_source, 0);
+                return;
+            }
+
+        } else {
+            // lines upto 128 characters are allowed, anything longer is discarded
+            const char *line;
+            size_t len;
+            bool discarded;
+            bool more;
+            do {
+                more= this->reader.next_line(line, len, discarded);
+                if(discarded) {
+                    this->current_stream->printf("Warning: Discarded long line\n");
                 }
-                if(len == 1) continue; // empty line
+            } while(more && len == 1 && line[0] == '\n'); // skip empty lines
 
-                this->current_stream->printf("%s", buf);
+            if(more) {
                 struct SerialMessage message;
-                message.message = buf;
+                message.message.assign(line, len);
                 message.stream = this->current_stream;
+                this->current_stream->printf("%s", message.message.c_str());
+                if(this->journal.is_started()) this->journal.line(this->played_cnt);
+                THEKERNEL->input_arbiter->took(input_source, len);
 
                 // waits for the queue to have enough room
                 THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message);
                 played_cnt += len;
                 return; // we feed one line per main loop
-
-            } else {
-                // discard long line
-                this->current_stream->printf("Warning: Discarded long line\n");
-                discard = true;
             }
         }
 
+        this->reader.stop();
+        this->job.stop();
+        this->estimate.stop();
+        this->journal.stop(true);
+        fclose(this->current_file_handler);
+        current_file_handler = NULL;
+
+        // the next one starts on the next pass, the queue still has the end of this one to run meanwhile
+        if(play_next_job()) return;
+
         this->playing_file = false;
         this->filename = "";
         played_cnt = 0;
         file_size = 0;
-        fclose(this->current_file_handler);
-        current_file_handler = NULL;
+        this->jobs_played = 0;
         this->current_stream = NULL;
 
         if(this->reply_stream != NULL) {
@@ -442,6 +694,47 @@ void Player::on_main_loop(void *argument)
     }
 }
 
+// read ahead while waiting for room in the queue, and plan the file to see how long it takes
+// the estimate only uses the time the main loop would be waiting anyway, so it is not made while the queue has room
+void Player::on_idle(void *argument)
+{
+    if(!this->playing_file) return;
+    this->reader.fill();
+    // opening a file takes a while on the sdcard, so the next one is opened once this one has all been read rather
+    // than when its last line has gone
+    if(!this->play_list.empty() && this->next_file_handler == NULL && this->reader.is_eof()) {
+        this->next_file_handler = fopen(this->play_list.front().c_str(), "r");
+    }
+    if(this->estimate.is_scanning() && THEKERNEL->conveyor->is_queue_full()) this->estimate.scan(1000);
+}
+
+// the time the rest of the file takes as planned, and the time of what is in the queue now, 0 until it is known
+unsigned long Player::remaining_seconds()
+{
+    if(!this->estimate.is_done()) return 0;
+    return lroundf(this->estimate.remaining_seconds(this->played_cnt) + THEKERNEL->conveyor->queued_seconds());
+}
+
+// offers the temperatures the file sets further on to the heaters, each starts on one once it is no more time away
+// than it takes to heat up to it
+void Player::preheat()
+{
+    this->estimate.drop_heats(this->played_cnt);
+    float queued= THEKERNEL->conveyor->queued_seconds();
+    for(unsigned int i= 0; i < this->estimate.heat_count(); ++i) {
+        JobEstimate::heat_t &h= this->estimate.heat(i);
+        if(h.handled) continue;
+        if(!h.known) break;
+
+        pad_preheat p{h.m_code, 0, h.target, this->estimate.seconds_between(this->played_cnt, h.seconds) + queued, false};
+        void *returned_data;
+        if(h.tool >= 0 && PublicData::get_value(tool_manager_checksum, get_tool_name_checksum, h.tool, &returned_data)) {
+            p.tool_name= *static_cast<uint16_t *>(returned_data);
+        }
+        if(!PublicData::set_value(temperature_control_checksum, preheat_checksum, &p) || p.done) h.handled= true;
+    }
+}
+
 void Player::on_get_public_data(void *argument)
 {
     PublicDataRequest *pdr = static_cast<PublicDataRequest *>(argument);
@@ -458,6 +751,7 @@ void Player::on_get_public_data(void *argument)
         static struct pad_progress p;
         if(file_size > 0 && playing_file) {
             p.elapsed_secs = this->elapsed_secs;
+            p.remaining_secs = remaining_seconds();
             p.percent_complete = (this->file_size - (this->file_size - this->played_cnt)) * 100 / this->file_size;
             p.filename = this->filename;
             pdr->set_data_ptr(&p);
@@ -475,6 +769,14 @@ void Player::on_set_public_data(void *argument)
     if(pdr->second_element_is(abort_play_checksum)) {
         abort_command("", &(StreamOutput::NullStream));
         pdr->set_taken();
+
+    } else if(pdr->second_element_is(compile_job_checksum)) {
+        // a file has been uploaded
+        if(this->compile_on_upload) {
+            struct pad_compile *c = static_cast<struct pad_compile *>(pdr->get_data_ptr());
+            if(!CompiledJob::is_job(c->filename)) compile_command(c->filename, c->stream);
+        }
+        pdr->set_taken();
     }
 }
 
@@ -10,6 +10,10 @@
 #define PLAYER_H
 
 #include "Module.h"
+#include "LineReader.h"
+#include "CompiledJob.h"
+#include "JobEstimate.h"
+#include "Journal.h"
 
 #include <stdio.h>
 #include <string>
@@ -26,6 +30,7 @@ class Player : public Module {
         void on_module_loaded();
         void on_console_line_received( void* argument );
         void on_main_loop( void* argument );
+        void on_idle( void* argument );
         void on_second_tick(void* argument);
         void on_get_public_data(void* argument);
         void on_set_public_data(void* argument);
@@ -37,20 +42,37 @@ class Player : public Module {
         void abort_command( string parameters, StreamOutput* stream );
         void suspend_command( string parameters, StreamOutput* stream );
         void resume_command( string parameters, StreamOutput* stream );
+        void compile_command( string parameters, StreamOutput* stream );
+        void recover_command( string parameters, StreamOutput* stream );
         string extract_options(string& args);
         void suspend_part2();
+        bool play_next_job();
+        void clear_play_list();
+        unsigned long remaining_seconds();
+        void preheat();
 
         string filename;
         string after_suspend_gcode;
         string before_resume_gcode;
         string on_boot_gcode;
+        string journal_file;
+        string journal_recover_gcode;
         StreamOutput* current_stream;
         StreamOutput* reply_stream;
 
         FILE* current_file_handler;
+        std::vector<string> play_list;  // played after this file with no gap, each with its own start and end gcode
+        FILE* next_file_handler;        // the first of them, opened while the last lines of this one are read
+        unsigned int jobs_played;       // of the play list before this one
+        LineReader reader;
+        CompiledJob job;
+        JobEstimate estimate;
+        Journal journal;
         long file_size;
         unsigned long played_cnt;
         unsigned long elapsed_secs;
+        uint16_t journal_interval;      // seconds between the journal writes while playing, 0 for none
+        uint8_t input_source;           // in the InputArbiter
         float saved_position[3];
         std::map<uint16_t, float> saved_temperatures;
         struct {
@@ -61,6 +83,8 @@ class Player : public Module {
             bool was_playing_file:1;
             bool leave_heaters_on:1;
             bool override_leave_heaters_on:1;
+            bool compile_on_upload:1;
+            bool preheat_lookahead:1;
             uint8_t suspend_loops:4;
         };
 };
@@ -6,10 +6,19 @@
 #define is_suspended_checksum     CHECKSUM("is_suspended")
 #define abort_play_checksum       CHECKSUM("abort_play")
 #define get_progress_checksum     CHECKSUM("progress")
+#define compile_job_checksum      CHECKSUM("compile_job")
+
+class StreamOutput;
 
 struct pad_progress {
     unsigned int percent_complete;
     unsigned long elapsed_secs;
+    unsigned long remaining_secs; // 0 until the file has been planned
+    string filename;
+};
+
+struct pad_compile {
     string filename;
+    StreamOutput *stream;
 };
 #endif
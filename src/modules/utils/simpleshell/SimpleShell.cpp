@@ -12,21 +12,28 @@
 #include "libs/utils.h"
 #include "libs/SerialMessage.h"
 #include "libs/StreamOutput.h"
+#include "libs/Config.h"
 #include "modules/robot/Conveyor.h"
 #include "DirHandle.h"
+#include "DirIndex.h"
 #include "mri.h"
 #include "version.h"
 #include "PublicDataRequest.h"
-#include "AppendFileStream.h"
-#include "FileStream.h"
+#include "AtomicFileStream.h"
+#include "FlashUpdate.h"
+#include "InputArbiter.h"
 #include "checksumm.h"
 #include "PublicData.h"
 #include "Gcode.h"
+#include "CommandPool.h"
 #include "Robot.h"
 #include "ToolManagerPublicAccess.h"
 #include "GcodeDispatch.h"
+#include "SerialConsole.h"
 #include "BaseSolution.h"
 #include "StepperMotor.h"
+#include "StepTicker.h"
+#include "Stepper.h"
 #include "Configurator.h"
 
 #include "TemperatureControlPublicAccess.h"
@@ -37,7 +44,15 @@
 #include "SDFAT.h"
 #include "Thermistor.h"
 #include "md5.h"
+#include "crc32.h"
+#include "UploadFile.h"
 #include "utils.h"
+#include "CycleProfile.h"
+#include "LatencyStats.h"
+#include "EventTrace.h"
+#ifdef BENCHMARKS
+#include "Bench.h"
+#endif
 
 #include "system_LPC17xx.h"
 #include "LPC17xx.h"
@@ -45,10 +60,13 @@
 #include "mbed.h" // for wait_ms()
 
 extern unsigned int g_maximumHeapAddress;
+extern unsigned int g_heapAllocated;
+extern unsigned int g_heapAllocatedPeak;
 
 #include <malloc.h>
 #include <mri.h>
 #include <stdio.h>
+#include <math.h>
 #include <stdint.h>
 
 extern "C" uint32_t  __end__;
@@ -66,6 +84,7 @@ const SimpleShell::ptentry_t SimpleShell::commands_table[] = {
     {"upload",   SimpleShell::upload_command},
     {"reset",    SimpleShell::reset_command},
     {"dfu",      SimpleShell::dfu_command},
+    {"flash",    SimpleShell::flash_command},
     {"break",    SimpleShell::break_command},
     {"help",     SimpleShell::help_command},
     {"?",        SimpleShell::help_command},
@@ -73,6 +92,7 @@ const SimpleShell::ptentry_t SimpleShell::commands_table[] = {
     {"mem",      SimpleShell::mem_command},
     {"get",      SimpleShell::get_command},
     {"set_temp", SimpleShell::set_temp_command},
+    {"set_queue", SimpleShell::set_queue_command},
     {"switch",   SimpleShell::switch_command},
     {"net",      SimpleShell::net_command},
     {"load",     SimpleShell::load_command},
@@ -81,6 +101,7 @@ const SimpleShell::ptentry_t SimpleShell::commands_table[] = {
     {"calc_thermistor", SimpleShell::calc_thermistor_command},
     {"thermistors", SimpleShell::print_thermistors_command},
     {"md5sum",   SimpleShell::md5sum_command},
+    {"crc32",    SimpleShell::crc32_command},
 
     // unknown command
     {NULL, NULL}
@@ -88,8 +109,43 @@ const SimpleShell::ptentry_t SimpleShell::commands_table[] = {
 
 int SimpleShell::reset_delay_secs = 0;
 
+// what heapWalk() found, sizes include the chunk headers
+struct heap_stats_t {
+    uint32_t used;
+    uint32_t free;          // in free chunks, not counting the unused heap above the last chunk
+    uint32_t largest_free;
+};
+
+#ifdef HEAP_TAGS
+// the chunks in use added up by the return address the malloc wraps in build/mbed_custom.cpp tagged them with,
+// the address can be looked up with addr2line. Sites that do not fit are added up in the last entry with tag 0
+struct heap_site_t {
+    uint32_t tag;
+    uint32_t chunks;
+    uint32_t bytes;
+};
+static const int max_heap_sites = 16;
+
+static void add_heap_site(heap_site_t *sites, int &n, uint32_t tag, uint32_t size)
+{
+    int i;
+    for (i = 0; i < n && sites[i].tag != tag; i++) ;
+    if (i == n) {
+        if (n == max_heap_sites) {
+            i = n - 1;
+            sites[i].tag = 0;
+        } else {
+            sites[n++] = {tag, 0, 0};
+        }
+    }
+    sites[i].chunks++;
+    sites[i].bytes += size;
+}
+#endif
+
 // Adam Greens heap walk from http://mbed.org/forum/mbed/topic/2701/?page=4#comment-22556
-static uint32_t heapWalk(StreamOutput *stream, bool verbose)
+// stream can be nullptr to just get the totals
+static void heapWalk(StreamOutput *stream, bool verbose, bool tags, heap_stats_t &stats)
 {
     uint32_t chunkNumber = 1;
     // The __end__ linker symbol points to the beginning of the heap.
@@ -98,11 +154,13 @@ static uint32_t heapWalk(StreamOutput *stream, bool verbose)
     uint32_t freeCurr = __malloc_free_list;
     // Calling _sbrk() with 0 reserves no more memory but it returns the current top of heap.
     uint32_t heapEnd = _sbrk(0);
-    // accumulate totals
-    uint32_t freeSize = 0;
-    uint32_t usedSize = 0;
 
-    stream->printf("Used Heap Size: %lu\n", heapEnd - chunkCurr);
+#ifdef HEAP_TAGS
+    heap_site_t sites[max_heap_sites];
+    int nsites = 0;
+#endif
+
+    stats = {0, 0, 0};
 
     // Walk through the chunks until we hit the end of the heap.
     while (chunkCurr < heapEnd) {
@@ -123,6 +181,19 @@ static uint32_t heapWalk(StreamOutput *stream, bool verbose)
             freeCurr = *(uint32_t *)(freeCurr + 4);
         }
 
+        if (isChunkFree) {
+            stats.free += chunkSize;
+            if (chunkSize > stats.largest_free) stats.largest_free = chunkSize;
+        } else {
+            stats.used += chunkSize;
+        }
+
+#ifdef HEAP_TAGS
+        // the tag is the last word of a chunk in use
+        uint32_t tag = isChunkFree ? 0 : *(uint32_t *)(chunkNext - 4);
+        if (!isChunkFree && tags) add_heap_site(sites, nsites, tag, chunkSize);
+#endif
+
         // Skip past the 32-bit size field in the chunk header.
         chunkCurr += 4;
         // 8-byte align the data pointer.
@@ -130,17 +201,50 @@ static uint32_t heapWalk(StreamOutput *stream, bool verbose)
         // newlib-nano over allocates by 8 bytes, 4 bytes for the 32-bit chunk size and another 4 bytes to allow for 8
         // byte-alignment of the returned pointer.
         chunkSize -= 8;
-        if (verbose)
+        if (verbose && stream != nullptr) {
+#ifdef HEAP_TAGS
+            if (!isChunkFree) {
+                stream->printf("  Chunk: %lu  Address: 0x%08lX  Size: %lu  Tag: 0x%08lX\n", chunkNumber, chunkCurr, chunkSize, tag);
+            } else
+#endif
             stream->printf("  Chunk: %lu  Address: 0x%08lX  Size: %lu  %s\n", chunkNumber, chunkCurr, chunkSize, isChunkFree ? "CHUNK FREE" : "");
-
-        if (isChunkFree) freeSize += chunkSize;
-        else usedSize += chunkSize;
+        }
 
         chunkCurr = chunkNext;
         chunkNumber++;
     }
-    stream->printf("Allocated: %lu, Free: %lu\r\n", usedSize, freeSize);
-    return freeSize;
+
+#ifdef HEAP_TAGS
+    if (tags && stream != nullptr) {
+        // biggest users first
+        for (int i = 0; i < nsites; i++) {
+            for (int j = i + 1; j < nsites; j++) {
+                if (sites[j].bytes > sites[i].bytes) std::swap(sites[i], sites[j]);
+            }
+            stream->printf("  Site: 0x%08lX  %lu bytes in %lu chunks\n", sites[i].tag, sites[i].bytes, sites[i].chunks);
+        }
+    }
+#else
+    if (tags && stream != nullptr) {
+        stream->printf("Allocation sites need a build with HEAP_TAGS=1\r\n");
+    }
+#endif
+}
+
+// the least room there has been between the top of the heap and the stack, _start fills it with 0xdeadbeef
+// so this is up to the first word above the heap the stack has written over
+static uint32_t stackHeadroomLow(uint32_t heapEnd)
+{
+    uint32_t *p = (uint32_t *)((heapEnd + 7) & ~7);
+    uint32_t *sp = (uint32_t *)__get_MSP();
+    while (p < sp && *p == 0xdeadbeef) p++;
+    return (uint32_t)p - heapEnd;
+}
+
+// percentage of the free memory that is not in the largest free block
+static unsigned int fragmentation(uint32_t free, uint32_t largest)
+{
+    return free == 0 ? 0 : 100 - (unsigned int)((uint64_t)largest * 100 / free);
 }
 
 
@@ -166,36 +270,37 @@ void SimpleShell::on_second_tick(void *)
 void SimpleShell::on_gcode_received(void *argument)
 {
     Gcode *gcode = static_cast<Gcode *>(argument);
+    if (!gcode->has_m || (gcode->m != 20 && gcode->m != 30 && gcode->m != 501 && gcode->m != 504)) return;
+
+    // only copied out for the few M codes that take a file name, not for every line
     string args = get_arguments(gcode->get_command());
 
-    if (gcode->has_m) {
-        if (gcode->m == 20) { // list sd card
-            gcode->stream->printf("Begin file list\r\n");
-            ls_command("/sd", gcode->stream);
-            gcode->stream->printf("End file list\r\n");
+    if (gcode->m == 20) { // list sd card
+        gcode->stream->printf("Begin file list\r\n");
+        ls_command("/sd", gcode->stream);
+        gcode->stream->printf("End file list\r\n");
 
-        } else if (gcode->m == 30) { // remove file
-            if(!args.empty() && !THEKERNEL->is_grbl_mode())
-                rm_command("/sd/" + args, gcode->stream);
+    } else if (gcode->m == 30) { // remove file
+        if(!args.empty() && !THEKERNEL->is_grbl_mode())
+            rm_command(("/sd/" + args).c_str(), gcode->stream);
 
-        } else if(gcode->m == 501) { // load config override
-            if(args.empty()) {
-                load_command("/sd/config-override", gcode->stream);
-            } else {
-                load_command("/sd/config-override." + args, gcode->stream);
-            }
+    } else if(gcode->m == 501) { // load config override
+        if(args.empty()) {
+            load_command("/sd/config-override", gcode->stream);
+        } else {
+            load_command(("/sd/config-override." + args).c_str(), gcode->stream);
+        }
 
-        } else if(gcode->m == 504) { // save to specific config override file
-            if(args.empty()) {
-                save_command("/sd/config-override", gcode->stream);
-            } else {
-                save_command("/sd/config-override." + args, gcode->stream);
-            }
+    } else if(gcode->m == 504) { // save to specific config override file
+        if(args.empty()) {
+            save_command("/sd/config-override", gcode->stream);
+        } else {
+            save_command(("/sd/config-override." + args).c_str(), gcode->stream);
         }
     }
 }
 
-bool SimpleShell::parse_command(const char *cmd, string args, StreamOutput *stream)
+bool SimpleShell::parse_command(const char *cmd, const char *args, StreamOutput *stream)
 {
     for (const ptentry_t *p = commands_table; p->command != NULL; ++p) {
         if (strncasecmp(cmd, p->command, strlen(p->command)) == 0) {
@@ -210,8 +315,9 @@ bool SimpleShell::parse_command(const char *cmd, string args, StreamOutput *stre
 // When a new line is received, check if it is a command, and if it is, act upon it
 void SimpleShell::on_console_line_received( void *argument )
 {
-    SerialMessage new_message = *static_cast<SerialMessage *>(argument);
-    string possible_command = new_message.message;
+    // every line comes through here, so the command is parsed in place without copying the line
+    SerialMessage &new_message = *static_cast<SerialMessage *>(argument);
+    const string &possible_command = new_message.message;
 
     // ignore anything that is not lowercase or a $ as it is not a command
     if(possible_command.size() == 0 || (!islower(possible_command[0]) && possible_command[0] != '$')) {
@@ -237,6 +343,33 @@ void SimpleShell::on_console_line_received( void *argument )
                 new_message.stream->printf("ok\n");
                 break;
 
+            case 'Q':
+                // planner queue occupancy
+                get_command("queue", new_message.stream);
+                new_message.stream->printf("ok\n");
+                break;
+
+            case 'P':
+                // time spent in each event handler
+                get_command("profile", new_message.stream);
+                new_message.stream->printf("ok\n");
+                break;
+
+            case 'L':
+                // main loop latency and queue starvation
+                get_command("latency", new_message.stream);
+                new_message.stream->printf("ok\n");
+                break;
+
+            case 'J':
+                // jog, $J= then the words of the move, 0x85 cancels it
+                if(possible_command.size() > 2 && possible_command[2] == '=' && THEKERNEL->robot->jog(possible_command.c_str() + 3)) {
+                    new_message.stream->printf("ok\n");
+                }else{
+                    new_message.stream->printf("error:Invalid jog command\n");
+                }
+                break;
+
             case 'H':
                 if(THEKERNEL->is_grbl_mode()) {
                     THEKERNEL->call_event(ON_HALT, (void *)1); // clears on_halt
@@ -248,6 +381,22 @@ void SimpleShell::on_console_line_received( void *argument )
                 }
                 break;
 
+#ifdef BENCHMARKS
+            case 'B': {
+                // $bench [match], the main loop is held up while they run so not while moving
+                if(!THEKERNEL->conveyor->is_queue_empty()) {
+                    new_message.stream->printf("error:not while moving\n");
+                    break;
+                }
+                const char *args= possible_command.c_str();
+                shift_parameter(args);
+                ParameterView match= shift_parameter(args);
+                Bench::run(match.str().c_str(), new_message.stream);
+                new_message.stream->printf("ok\n");
+                break;
+            }
+#endif
+
             default:
                 new_message.stream->printf("error:Invalid statement\n");
                 break;
@@ -256,51 +405,67 @@ void SimpleShell::on_console_line_received( void *argument )
     }else{
 
         //new_message.stream->printf("Received %s\r\n", possible_command.c_str());
-        string cmd = shift_parameter(possible_command);
+        const char *args = possible_command.c_str();
+        ParameterView cmd = shift_parameter(args);
 
         // Configurator commands
         if (cmd == "config-get"){
-            THEKERNEL->configurator->config_get_command(  possible_command, new_message.stream );
+            THEKERNEL->configurator->config_get_command(  args, new_message.stream );
 
         } else if (cmd == "config-set"){
-            THEKERNEL->configurator->config_set_command(  possible_command, new_message.stream );
+            THEKERNEL->configurator->config_set_command(  args, new_message.stream );
 
         } else if (cmd == "config-load"){
-            THEKERNEL->configurator->config_load_command(  possible_command, new_message.stream );
+            THEKERNEL->configurator->config_load_command(  args, new_message.stream );
 
-        } else if (cmd == "play" || cmd == "progress" || cmd == "abort" || cmd == "suspend" || cmd == "resume") {
+        } else if (cmd == "play" || cmd == "progress" || cmd == "abort" || cmd == "suspend" || cmd == "resume" || cmd == "compile") {
             // these are handled by Player module
 
+        } else if (cmd == "telemetry") {
+            // handled by the Telemetry module when it is enabled
+
         } else if (cmd == "ok") {
             // probably an echo so reply ok
             new_message.stream->printf("ok\n");
 
-        }else if(!parse_command(cmd.c_str(), possible_command, new_message.stream)) {
-            new_message.stream->printf("error:Unsupported command - %s\n", cmd.c_str());
+        }else if(!parse_command(cmd.data, args, new_message.stream)) {
+            new_message.stream->printf("error:Unsupported command - %.*s\n", (int)cmd.size, cmd.data);
         }
     }
 }
 
 // Act upon an ls command
 // Convert the first parameter into an absolute path, then list the files in that path
-void SimpleShell::ls_command( string parameters, StreamOutput *stream )
+void SimpleShell::ls_command(const char *parameters, StreamOutput *stream)
 {
     string path, opts;
-    while(!parameters.empty()) {
-        string s = shift_parameter( parameters );
-        if(s.front() == '-') {
-            opts.append(s);
+    while(*parameters != '\0') {
+        ParameterView s = shift_parameter( parameters );
+        if(s.data[0] == '-') {
+            opts.append(s.data, s.size);
         } else {
-            path = s;
-            if(!parameters.empty()) {
-                path.append(" ");
-                path.append(parameters);
-            }
+            // the rest of the line, a name can have spaces in it
+            path = s.data;
             break;
         }
     }
 
     path = absolute_from_relative(path);
+    bool sizes = opts.find("-s", 0, 2) != string::npos;
+
+    const DirIndex *index = DirIndex::get(path);
+    if(index != nullptr) {
+        for (size_t i = 0; i < index->size(); i++) {
+            stream->printf("%s", lc(string(index->name(i))).c_str());
+            if(index->is_dir(i)) {
+                stream->printf("/");
+            } else if(sizes) {
+                stream->printf(" %lu", index->file_size(i));
+            }
+            stream->printf("\r\n");
+        }
+        return;
+    }
 
     DIR *d;
     struct dirent *p;
@@ -310,7 +475,7 @@ void SimpleShell::ls_command( string parameters, StreamOutput *stream )
             stream->printf("%s", lc(string(p->d_name)).c_str());
             if(p->d_isdir) {
                 stream->printf("/");
-            } else if(opts.find("-s", 0, 2) != string::npos) {
+            } else if(sizes) {
                 stream->printf(" %d", p->d_fsize);
             }
             stream->printf("\r\n");
@@ -323,32 +488,32 @@ void SimpleShell::ls_command( string parameters, StreamOutput *stream )
 
 extern SDFAT mounter;
 
-void SimpleShell::remount_command( string parameters, StreamOutput *stream )
+void SimpleShell::remount_command(const char *parameters, StreamOutput *stream)
 {
     mounter.remount();
     stream->printf("remounted\r\n");
 }
 
 // Delete a file
-void SimpleShell::rm_command( string parameters, StreamOutput *stream )
+void SimpleShell::rm_command(const char *parameters, StreamOutput *stream)
 {
-    const char *fn = absolute_from_relative(shift_parameter( parameters )).c_str();
-    int s = remove(fn);
-    if (s != 0) stream->printf("Could not delete %s \r\n", fn);
+    string fn = absolute_from_relative(shift_parameter( parameters ).str());
+    int s = remove(fn.c_str());
+    if (s != 0) stream->printf("Could not delete %s \r\n", fn.c_str());
 }
 
 // Rename a file
-void SimpleShell::mv_command( string parameters, StreamOutput *stream )
+void SimpleShell::mv_command(const char *parameters, StreamOutput *stream)
 {
-    string from = absolute_from_relative(shift_parameter( parameters ));
-    string to = absolute_from_relative(shift_parameter(parameters));
+    string from = absolute_from_relative(shift_parameter( parameters ).str());
+    string to = absolute_from_relative(shift_parameter(parameters).str());
     int s = rename(from.c_str(), to.c_str());
     if (s != 0) stream->printf("Could not rename %s to %s\r\n", from.c_str(), to.c_str());
     else stream->printf("renamed %s to %s\r\n", from.c_str(), to.c_str());
 }
 
 // Change current absolute path to provided path
-void SimpleShell::cd_command( string parameters, StreamOutput *stream )
+void SimpleShell::cd_command(const char *parameters, StreamOutput *stream)
 {
     string folder = absolute_from_relative( parameters );
 
@@ -363,35 +528,35 @@ void SimpleShell::cd_command( string parameters, StreamOutput *stream )
 }
 
 // Responds with the present working directory
-void SimpleShell::pwd_command( string parameters, StreamOutput *stream )
+void SimpleShell::pwd_command(const char *parameters, StreamOutput *stream)
 {
     stream->printf("%s\r\n", THEKERNEL->current_path.c_str());
 }
 
 // Output the contents of a file, first parameter is the filename, second is the limit ( in number of lines to output )
-void SimpleShell::cat_command( string parameters, StreamOutput *stream )
+void SimpleShell::cat_command(const char *parameters, StreamOutput *stream)
 {
     // Get parameters ( filename and line limit )
-    string filename          = absolute_from_relative(shift_parameter( parameters ));
-    string limit_parameter   = shift_parameter( parameters );
+    string filename          = absolute_from_relative(shift_parameter( parameters ).str());
+    ParameterView limit_parameter = shift_parameter( parameters );
     int limit = -1;
     int delay= 0;
     bool send_eof= false;
     if ( limit_parameter == "-d" ) {
-        string d= shift_parameter( parameters );
+        ParameterView d= shift_parameter( parameters );
         char *e = NULL;
-        delay = strtol(d.c_str(), &e, 10);
-        if (e <= d.c_str()) {
+        delay = strtol(d.data, &e, 10);
+        if (e <= d.data) {
             delay = 0;
 
         } else {
             send_eof= true; // we need to terminate file send with an eof
         }
 
-    }else if ( limit_parameter != "" ) {
+    }else if ( !limit_parameter.empty() ) {
         char *e = NULL;
-        limit = strtol(limit_parameter.c_str(), &e, 10);
-        if (e <= limit_parameter.c_str())
+        limit = strtol(limit_parameter.data, &e, 10);
+        if (e <= limit_parameter.data)
             limit = -1;
     }
 
@@ -432,7 +597,72 @@ void SimpleShell::cat_command( string parameters, StreamOutput *stream )
     }
 }
 
-void SimpleShell::upload_command( string parameters, StreamOutput *stream )
+// waits for the next character of an upload, -1 if none comes within timeout_ms
+static int upload_getc(StreamOutput *stream, uint32_t timeout_ms)
+{
+    uint32_t start= us_ticker_read();
+    while(!stream->ready()) {
+        // we need to kick things or they die
+        THEKERNEL->call_event(ON_IDLE);
+        if(timeout_ms > 0 && us_ticker_read() - start >= timeout_ms * 1000UL) return -1;
+    }
+    return stream->_getc() & 0xFF;
+}
+
+// upload -b: the file comes in frames of a 16 bit length, up to max_upload_frame bytes and the CRC-32 of those bytes,
+// both little endian. Each frame is answered with ok once it is saved, or rs if it got garbled or stopped halfway and
+// has to be sent again. A frame of length 0 ends the upload.
+static const size_t max_upload_frame= 1024;
+
+static void upload_frames(UploadFile &file, StreamOutput *stream)
+{
+    uint8_t *frame= (uint8_t *)malloc(max_upload_frame);
+    if(frame == nullptr) {
+        stream->printf("error:not enough memory\r\n");
+        return;
+    }
+
+    bool failed= false;
+    while(true) {
+        int lo= upload_getc(stream, 0);
+        int hi= upload_getc(stream, 1000);
+        // a frame that does not all arrive within a second of the last byte is sent again
+        uint8_t crc_bytes[4];
+        size_t n= (hi < 0) ? 0 : (lo | (hi << 8)), got= 0;
+        bool ok= hi >= 0 && n <= max_upload_frame;
+        for (; ok && got < n + 4; got++) {
+            int c= upload_getc(stream, 1000);
+            if(c < 0) ok= false;
+            else if(got < n) frame[got]= c;
+            else crc_bytes[got - n]= c;
+        }
+        if(ok) {
+            uint32_t crc= crc_bytes[0] | (crc_bytes[1] << 8) | (crc_bytes[2] << 16) | ((uint32_t)crc_bytes[3] << 24);
+            ok= crc32_update(0, frame, n) == crc;
+        }
+        if(!ok) {
+            stream->printf("rs\r\n");
+            continue;
+        }
+        if(n == 0) break;
+        if(!failed && !file.write(frame, n)) {
+            // keep the frames coming until the host ends the upload
+            stream->printf("error writing to file\r\n");
+            failed= true;
+        }
+        stream->printf("ok\r\n");
+    }
+    free(frame);
+
+    size_t size= file.size();
+    if(file.close() && !failed) {
+        stream->printf("uploaded %u bytes\r\n", size);
+    } else {
+        stream->printf("error writing to file\r\n");
+    }
+}
+
+void SimpleShell::upload_command(const char *parameters, StreamOutput *stream)
 {
     // this needs to be a hack. it needs to read direct from serial and not allow on_main_loop run until done
     // NOTE this will block all operation until the upload is complete, so do not do while printing
@@ -441,68 +671,52 @@ void SimpleShell::upload_command( string parameters, StreamOutput *stream )
         return;
     }
 
+    bool binary= strncmp(parameters, "-b ", 3) == 0;
+    if(binary) shift_parameter(parameters);
+
     // open file to upload to
     string upload_filename = absolute_from_relative( parameters );
-    FILE *fd = fopen(upload_filename.c_str(), "w");
-    if(fd != NULL) {
-        stream->printf("uploading to file: %s, send control-D or control-Z to finish\r\n", upload_filename.c_str());
-    } else {
+    UploadFile file;
+    if(!file.open(upload_filename)) {
         stream->printf("failed to open file: %s.\r\n", upload_filename.c_str());
         return;
     }
 
-    int cnt = 0;
-    bool uploading = true;
-    while(uploading) {
-        if(!stream->ready()) {
-            // we need to kick things or they die
-            THEKERNEL->call_event(ON_IDLE);
-            continue;
-        }
+    if(binary) {
+        stream->printf("uploading to file: %s, send frames of up to %u bytes\r\n", upload_filename.c_str(), max_upload_frame);
+        upload_frames(file, stream);
+        return;
+    }
 
-        char c = stream->_getc();
+    stream->printf("uploading to file: %s, send control-D or control-Z to finish\r\n", upload_filename.c_str());
+    while(true) {
+        char c = upload_getc(stream, 0);
         if( c == 4 || c == 26) { // ctrl-D or ctrl-Z
-            uploading = false;
-            // close file
-            fclose(fd);
-            stream->printf("uploaded %d bytes\n", cnt);
+            break;
+        }
+        // held and written a buffer at a time
+        if(!file.putc(c)) {
+            // error writing to file
+            stream->printf("error writing to file. ignoring all characters until EOF\r\n");
+            file.close();
+            // we got an error so ignore everything until EOF
+            do {
+                c = upload_getc(stream, 0);
+            } while(c != 4 && c != 26);
             return;
-
-        } else {
-            // write character to file
-            cnt++;
-            if(fputc(c, fd) != c) {
-                // error writing to file
-                stream->printf("error writing to file. ignoring all characters until EOF\r\n");
-                fclose(fd);
-                fd = NULL;
-                uploading= false;
-
-            } else {
-                if ((cnt%400) == 0) {
-                    // HACK ALERT to get around fwrite corruption close and re open for append
-                    fclose(fd);
-                    fd = fopen(upload_filename.c_str(), "a");
-                    // we need to kick things or they die
-                    THEKERNEL->call_event(ON_IDLE);
-                }
-            }
         }
     }
-    // we got an error so ignore everything until EOF
-    char c;
-    do {
-        if(stream->ready()) {
-            c= stream->_getc();
-        }else{
-            THEKERNEL->call_event(ON_IDLE);
-            c= 0;
-        }
-    } while(c != 4 && c != 26);
+
+    size_t cnt = file.size();
+    if(file.close()) {
+        stream->printf("uploaded %u bytes\n", cnt);
+    } else {
+        stream->printf("error writing to file\r\n");
+    }
 }
 
 // loads the specified config-override file
-void SimpleShell::load_command( string parameters, StreamOutput *stream )
+void SimpleShell::load_command(const char *parameters, StreamOutput *stream)
 {
     // Get parameters ( filename )
     string filename = absolute_from_relative(parameters);
@@ -529,7 +743,7 @@ void SimpleShell::load_command( string parameters, StreamOutput *stream )
 }
 
 // saves the specified config-override file
-void SimpleShell::save_command( string parameters, StreamOutput *stream )
+void SimpleShell::save_command(const char *parameters, StreamOutput *stream)
 {
     // Get parameters ( filename )
     string filename = absolute_from_relative(parameters);
@@ -539,43 +753,69 @@ void SimpleShell::save_command( string parameters, StreamOutput *stream )
 
     THEKERNEL->conveyor->wait_for_empty_queue(); //just to be safe as it can take a while to run
 
-    //remove(filename.c_str()); // seems to cause a hang every now and then
-    {
-        FileStream fs(filename.c_str());
-        fs.printf("; DO NOT EDIT THIS FILE\n");
-        // this also will truncate the existing file instead of deleting it
-    }
-
-    // stream that appends to file
-    AppendFileStream *gs = new AppendFileStream(filename.c_str());
-    // if(!gs->is_open()) {
-    //     stream->printf("Unable to open File %s for write\n", filename.c_str());
-    //     return;
-    // }
+    // stream that holds the file in RAM until it is complete
+    AtomicFileStream *gs = new AtomicFileStream(filename.c_str());
+    gs->printf("; DO NOT EDIT THIS FILE\n");
 
     __disable_irq();
     // issue a M500 which will store values in the file stream
     Gcode *gcode = new Gcode("M500", gs);
     THEKERNEL->call_event(ON_GCODE_RECEIVED, gcode );
-    delete gs;
     delete gcode;
+    bool ok= gs->commit();
+    delete gs;
     __enable_irq();
 
-    stream->printf("Settings Stored to %s\r\n", filename.c_str());
+    if(ok) {
+        stream->printf("Settings Stored to %s\r\n", filename.c_str());
+    }else{
+        stream->printf("Error: unable to store settings to %s\r\n", filename.c_str());
+    }
 }
 
 // show free memory
-void SimpleShell::mem_command( string parameters, StreamOutput *stream)
+void SimpleShell::mem_command(const char *parameters, StreamOutput *stream)
 {
-    bool verbose = shift_parameter( parameters ).find_first_of("Vv") != string::npos;
+    ParameterView flags = shift_parameter( parameters );
+    bool verbose = flags.has_any_of("Vv");
+    bool tags = flags.has_any_of("Tt");
     unsigned long heap = (unsigned long)_sbrk(0);
     unsigned long m = g_maximumHeapAddress - heap;
+    heap_stats_t hs;
+
+    if (flags.has_any_of("Ss")) {
+        // just one line, so it can be polled while a job runs
+        heapWalk(nullptr, false, false, hs);
+        uint32_t largest = std::max((uint32_t)m, hs.largest_free);
+        stream->printf("heap used:%u peak:%u free:%lu largest:%lu frag:%u%% ahb0 used:%lu peak:%lu largest:%lu ahb1 used:%lu peak:%lu largest:%lu stack:%lu\r\n",
+            g_heapAllocated, g_heapAllocatedPeak, m + hs.free, largest, fragmentation(m + hs.free, largest),
+            AHB0.get_used(), AHB0.get_peak(), AHB0.largest_free(), AHB1.get_used(), AHB1.get_peak(), AHB1.largest_free(),
+            stackHeadroomLow(heap));
+        return;
+    }
+
     stream->printf("Unused Heap: %lu bytes\r\n", m);
+    stream->printf("Used Heap Size: %lu\n", heap - (unsigned long)&__end__);
+
+    heapWalk(stream, verbose, tags, hs);
+    stream->printf("Allocated: %lu, Free: %lu\r\n", hs.used, hs.free);
+    stream->printf("Total Free RAM: %lu bytes\r\n", m + hs.free);
 
-    uint32_t f = heapWalk(stream, verbose);
-    stream->printf("Total Free RAM: %lu bytes\r\n", m + f);
+    // the unused heap above the last chunk can be handed out in one piece too
+    uint32_t largest = std::max((uint32_t)m, hs.largest_free);
+    stream->printf("Largest free block: %lu bytes, fragmentation: %u%%\r\n", largest, fragmentation(m + hs.free, largest));
+    stream->printf("Heap high water: %u bytes allocated, %u now\r\n", g_heapAllocatedPeak, g_heapAllocated);
+    stream->printf("Stack headroom: %lu bytes now, %lu at the deepest\r\n", __get_MSP() - heap, stackHeadroomLow(heap));
 
     stream->printf("Free AHB0: %lu, AHB1: %lu\r\n", AHB0.free(), AHB1.free());
+    stream->printf("AHB0: largest free %lu, high water %lu of %u bytes\r\n", AHB0.largest_free(), AHB0.get_peak(), AHB0.get_size());
+    stream->printf("AHB1: largest free %lu, high water %lu of %u bytes\r\n", AHB1.largest_free(), AHB1.get_peak(), AHB1.get_size());
+    stream->printf("Config values: %d bytes of heap saved while loaded\r\n", THEKERNEL->config->get_saved_bytes());
+    uint32_t hits, misses;
+    mounter.get_cache_stats(hits, misses);
+    stream->printf("SD sector cache: %lu hits, %lu misses\r\n", hits, misses);
+    stream->printf("Gcode commands: %u of %u slabs used, peak %u, %lu on the heap\r\n",
+        CommandPool::get_used(), CommandPool::get_size(), CommandPool::get_peak(), (unsigned long)CommandPool::get_fallbacks());
     if (verbose) {
         AHB0.debug(stream);
         AHB1.debug(stream);
@@ -601,7 +841,7 @@ static uint32_t getDeviceType()
 }
 
 // get network config
-void SimpleShell::net_command( string parameters, StreamOutput *stream)
+void SimpleShell::net_command(const char *parameters, StreamOutput *stream)
 {
     void *returned_data;
     bool ok = PublicData::get_value( network_checksum, get_ipconfig_checksum, &returned_data );
@@ -616,7 +856,7 @@ void SimpleShell::net_command( string parameters, StreamOutput *stream)
 }
 
 // print out build version
-void SimpleShell::version_command( string parameters, StreamOutput *stream)
+void SimpleShell::version_command(const char *parameters, StreamOutput *stream)
 {
     Version vers;
     uint32_t dev = getDeviceType();
@@ -625,21 +865,86 @@ void SimpleShell::version_command( string parameters, StreamOutput *stream)
 }
 
 // Reset the system
-void SimpleShell::reset_command( string parameters, StreamOutput *stream)
+void SimpleShell::reset_command(const char *parameters, StreamOutput *stream)
 {
     stream->printf("Smoothie out. Peace. Rebooting in 5 seconds...\r\n");
     reset_delay_secs = 5; // reboot in 5 seconds
 }
 
 // go into dfu boot mode
-void SimpleShell::dfu_command( string parameters, StreamOutput *stream)
+void SimpleShell::dfu_command(const char *parameters, StreamOutput *stream)
 {
     stream->printf("Entering boot mode...\r\n");
     system_reset(true);
 }
 
+// the bootloader would program all of firmware.bin again at the next reset, it renames it to this once it has
+static void retire_firmware(const string &filename)
+{
+    if(strcasecmp(filename.c_str(), "/sd/firmware.bin") != 0) return;
+    remove("/sd/FIRMWARE.CUR");
+    rename(filename.c_str(), "/sd/FIRMWARE.CUR");
+}
+
+// program a firmware image without the bootloader, only the sectors that differ from the running one are erased
+void SimpleShell::flash_command(const char *parameters, StreamOutput *stream)
+{
+    bool dry_run = false, has_crc = false;
+    uint32_t crc = 0;
+    string filename;
+    while(*parameters != '\0') {
+        ParameterView s = shift_parameter(parameters);
+        if(s == "-n") {
+            dry_run = true;
+        } else if(s == "-c") {
+            ParameterView c = shift_parameter(parameters);
+            char *e = NULL;
+            crc = strtoul(c.data, &e, 16);
+            has_crc = e > c.data;
+        } else {
+            filename = s.str();
+        }
+    }
+    filename = absolute_from_relative(filename.empty() ? "/sd/firmware.bin" : filename);
+
+    if(!dry_run && !THEKERNEL->conveyor->is_queue_empty()) {
+        stream->printf("flash not allowed while printing or busy\r\n");
+        return;
+    }
+
+    FlashUpdate update;
+    const char *error = update.check(filename.c_str(), has_crc, crc);
+    if(error != nullptr) {
+        stream->printf("error:%s %s\r\n", filename.c_str(), error);
+        return;
+    }
+    stream->printf("%s: %lu bytes crc32 %08lx, %d sectors (%luK) differ from the flash\r\n", filename.c_str(),
+                   update.get_size(), update.get_crc(), update.get_changed_sectors(), update.get_changed_bytes() / 1024);
+    if(dry_run) return;
+
+    if(update.get_changed_sectors() == 0) {
+        retire_firmware(filename);
+        stream->printf("the flash is up to date\r\n");
+        return;
+    }
+
+    stream->printf("programming %d sectors, it resets when they are done\r\n", update.get_changed_sectors());
+    // let that go out before the heap is taken for the sectors
+    safe_delay(100);
+    error = update.stage(filename.c_str());
+    if(error != nullptr) {
+        stream->printf("error:%s %s, copy it to /sd/firmware.bin and reset for the bootloader to program all of it\r\n", filename.c_str(), error);
+        return;
+    }
+
+    retire_firmware(filename);
+    // heaters and motors off, nothing else runs until the reset
+    THEKERNEL->call_event(ON_HALT, nullptr);
+    update.program();
+}
+
 // Break out into the MRI debugging system
-void SimpleShell::break_command( string parameters, StreamOutput *stream)
+void SimpleShell::break_command(const char *parameters, StreamOutput *stream)
 {
     stream->printf("Entering MRI debug mode...\r\n");
     __debugbreak();
@@ -657,7 +962,7 @@ static int get_active_tool()
     }
 }
 
-void SimpleShell::grblDP_command( string parameters, StreamOutput *stream)
+void SimpleShell::grblDP_command(const char *parameters, StreamOutput *stream)
 {
     /*
     [G54:95.000,40.000,-23.600]
@@ -673,7 +978,7 @@ void SimpleShell::grblDP_command( string parameters, StreamOutput *stream)
     [PRB:0.000,0.000,0.000:0]
     */
 
-    bool verbose = shift_parameter( parameters ).find_first_of("Vv") != string::npos;
+    bool verbose = shift_parameter( parameters ).has_any_of("Vv");
 
     std::vector<Robot::wcs_t> v= THEKERNEL->robot->get_wcs_state();
     if(verbose) {
@@ -705,20 +1010,22 @@ void SimpleShell::grblDP_command( string parameters, StreamOutput *stream)
     stream->printf("[PRB:%1.4f,%1.4f,%1.4f:%d]\n", px, py, pz, ps);
 }
 
-void SimpleShell::get_command( string parameters, StreamOutput *stream)
+void SimpleShell::get_command(const char *parameters, StreamOutput *stream)
 {
-    string what = shift_parameter( parameters );
+    ParameterView what = shift_parameter( parameters );
 
     if (what == "temp") {
         struct pad_temperature temp;
-        string type = shift_parameter( parameters );
+        ParameterView type = shift_parameter( parameters );
         if(type.empty()) {
-            // scan all temperature controls
-            std::vector<struct pad_temperature> controllers;
-            bool ok = PublicData::get_value(temperature_control_checksum, poll_controls_checksum, &controllers);
-            if (ok) {
-                for (auto &c : controllers) {
-                   stream->printf("%s (%d) temp: %f/%f @%d\r\n", c.designator.c_str(), c.id, c.current_temperature, c.target_temperature, c.pwm);
+            // all the temperature controls
+            void *returned_data;
+            bool ok = PublicData::get_value(temperature_control_checksum, temperature_snapshot_checksum, &returned_data);
+            const pad_temperature_snapshot *s = static_cast<const pad_temperature_snapshot *>(returned_data);
+            if (ok && s->count > 0) {
+                for (int i = 0; i < s->count; ++i) {
+                   const pad_temperature_row &c = s->rows[i];
+                   stream->printf("%s (%d) temp: %f/%f @%d\r\n", c.designator, c.id, c.current_temperature, c.target_temperature, c.pwm);
                 }
 
             } else {
@@ -726,24 +1033,24 @@ void SimpleShell::get_command( string parameters, StreamOutput *stream)
             }
 
         }else{
-            bool ok = PublicData::get_value( temperature_control_checksum, current_temperature_checksum, get_checksum(type), &temp );
+            bool ok = PublicData::get_value( temperature_control_checksum, current_temperature_checksum, type.checksum(), &temp );
 
             if (ok) {
-                stream->printf("%s temp: %f/%f @%d\r\n", type.c_str(), temp.current_temperature, temp.target_temperature, temp.pwm);
+                stream->printf("%.*s temp: %f/%f @%d\r\n", (int)type.size, type.data, temp.current_temperature, temp.target_temperature, temp.pwm);
             } else {
-                stream->printf("%s is not a known temperature device\r\n", type.c_str());
+                stream->printf("%.*s is not a known temperature device\r\n", (int)type.size, type.data);
             }
         }
 
     } else if (what == "fk" || what == "ik") {
-        string p= shift_parameter( parameters );
+        ParameterView p= shift_parameter( parameters );
         bool move= false;
         if(p == "-m") {
             move= true;
             p= shift_parameter( parameters );
         }
 
-        std::vector<float> v= parse_number_list(p.c_str());
+        std::vector<float> v= parse_number_list(p.str().c_str());
         if(p.empty() || v.size() < 1) {
             stream->printf("error:usage: get [fk|ik] [-m] x[,y,z]\n");
             return;
@@ -786,6 +1093,40 @@ void SimpleShell::get_command( string parameters, StreamOutput *stream)
             THEKERNEL->conveyor->wait_for_empty_queue();
         }
 
+    } else if (what == "kinematics") {
+        // inverse kinematics calls per second of the arm solution, one point at a time and in batches as segmented moves do,
+        // for points on a 1mm circle around the current position
+        ParameterView p= shift_parameter( parameters );
+        long n= p.empty() ? 1000 : strtol(p.data, nullptr, 10);
+        if(n < 8 || n > 100000) {
+            stream->printf("error:usage: get kinematics [8-100000]\n");
+            return;
+        }
+
+        const int batch= 8;
+        float points[batch][3];
+        float pos[3];
+        THEKERNEL->robot->get_axis_position(pos);
+        for (int i = 0; i < batch; i++) {
+            points[i][X_AXIS]= pos[X_AXIS] + cosf(i * 2 * (float)M_PI / batch);
+            points[i][Y_AXIS]= pos[Y_AXIS] + sinf(i * 2 * (float)M_PI / batch);
+            points[i][Z_AXIS]= pos[Z_AXIS];
+        }
+        BaseSolution *solution= THEKERNEL->robot->arm_solution;
+        ActuatorCoordinates apos[batch];
+
+        uint32_t t= us_ticker_read();
+        for (long i = 0; i < n; i++) solution->cartesian_to_actuator(points[i % batch], apos[0]);
+        uint32_t single_us= us_ticker_read() - t + 1;
+
+        t= us_ticker_read();
+        for (long i = 0; i < n; i += batch) solution->cartesian_to_actuator_batch(points, apos, batch);
+        uint32_t batch_us= us_ticker_read() - t + 1;
+        long nb= (n + batch - 1) / batch * batch;
+
+        stream->printf("%ld points: %lu calls/s one at a time, %lu calls/s in batches of %d\n", n,
+            (uint32_t)(n * 1000000ULL / single_us), (uint32_t)(nb * 1000000ULL / batch_us), batch);
+
    } else if (what == "pos") {
         // convenience to call all the various M114 variants
         char buf[64];
@@ -800,6 +1141,88 @@ void SimpleShell::get_command( string parameters, StreamOutput *stream)
         // print the wcs state
         grblDP_command("-v", stream);
 
+    } else if (what == "steptick") {
+#ifdef STEPTICKER_PROFILE
+        THEKERNEL->step_ticker->print_profile(stream);
+#else
+        stream->printf("error:StepTicker profiling is not enabled, build with STEPTICKER_PROFILE=1\n");
+#endif
+
+    } else if (what == "queue") {
+        // also $Q, get queue reset clears the statistics
+        if(shift_parameter(parameters) == "reset") {
+            THEKERNEL->conveyor->reset_queue_stats();
+        }
+        THEKERNEL->conveyor->print_queue_stats(stream);
+
+    } else if (what == "serial") {
+        // receive buffer usage and overflows of the hardware serial port
+        THEKERNEL->serial->print_stats(stream);
+
+    } else if (what == "input") {
+        // the lines taken from each source and how often the job stream held it up
+        THEKERNEL->input_arbiter->print_stats(stream);
+
+    } else if (what == "boot") {
+        // time taken loading the config and each module at boot, and when each step of it was done
+        stream->printf("config: %lu us\n", THEKERNEL->get_config_load_time());
+        uint32_t total= 0;
+        for(auto &b : THEKERNEL->get_boot_times()) {
+            stream->printf("%*s%s%s: %lu us\n", b.depth * 2, "", b.name ? b.name : "unknown", b.deferred ? " (deferred)" : "", b.us);
+            if(b.depth == 0 && !b.deferred) total += b.us;
+        }
+        stream->printf("modules: %lu us\n", total);
+        for(auto &m : THEKERNEL->get_boot_marks()) {
+            stream->printf("%10lu us %s\n", m.us, m.what);
+        }
+
+    } else if (what == "profile") {
+        // also $P, time spent in each event handler since boot or the last get profile reset
+        if(shift_parameter(parameters) == "reset") {
+            THEKERNEL->reset_event_profile();
+        }
+        for(auto &p : THEKERNEL->get_event_profile()) {
+            stream->printf("%s %s: %lu us in %lu calls\n", kernel_event_names[p.event], p.name ? p.name : "unknown", p.us, p.calls);
+        }
+
+    } else if (what == "latency") {
+        // also $L, how long the main loop and on_idle took and when the queue ran dry with input waiting
+        if(shift_parameter(parameters) == "reset") {
+            THEKERNEL->latency->reset();
+            THEKERNEL->stepper->reset_late_runs();
+        }
+        THEKERNEL->latency->print(stream);
+        stream->printf("step runs queued late: %lu times\n", THEKERNEL->stepper->get_late_runs());
+        stream->printf("main loop slept: %lu times\n", (unsigned long)THEKERNEL->get_sleeps());
+
+    } else if (what == "cycles") {
+        // core cycles taken by the interrupts and each event, get cycles on starts recording and clears what there was
+        ParameterView cmd= shift_parameter(parameters);
+        if(cmd == "on") {
+            CycleProfile::reset();
+            CycleProfile::enable(true);
+        } else if(cmd == "off") {
+            CycleProfile::enable(false);
+        } else if(cmd == "reset") {
+            CycleProfile::reset();
+        }
+        CycleProfile::print(stream);
+
+    } else if (what == "trace") {
+        // the event trace ring, get trace dump file writes it for smoothie-trace.py
+        ParameterView cmd= shift_parameter(parameters);
+        if(cmd == "dump") {
+            string fn= absolute_from_relative(shift_parameter(parameters).str());
+            if(!EventTrace::dump(fn.c_str())) {
+                stream->printf("error:could not write the trace to %s\n", fn.c_str());
+                return;
+            }
+            stream->printf("trace written to %s\n", fn.c_str());
+        } else if(cmd == "reset") {
+            EventTrace::reset();
+        }
+        EventTrace::print(stream);
+
     } else if (what == "state") {
         // also $G
         // [G0 G54 G17 G21 G90 G94 M0 M5 M9 T0 F0.]
@@ -815,48 +1238,64 @@ void SimpleShell::get_command( string parameters, StreamOutput *stream)
             THEKERNEL->robot->get_feed_rate());
 
     } else {
-        stream->printf("error:unknown option %s\n", what.c_str());
+        stream->printf("error:unknown option %.*s\n", (int)what.size, what.data);
     }
 }
 
 // used to test out the get public data events
-void SimpleShell::set_temp_command( string parameters, StreamOutput *stream)
+void SimpleShell::set_temp_command(const char *parameters, StreamOutput *stream)
 {
-    string type = shift_parameter( parameters );
-    string temp = shift_parameter( parameters );
-    float t = temp.empty() ? 0.0 : strtof(temp.c_str(), NULL);
-    bool ok = PublicData::set_value( temperature_control_checksum, get_checksum(type), &t );
+    ParameterView type = shift_parameter( parameters );
+    ParameterView temp = shift_parameter( parameters );
+    float t = temp.empty() ? 0.0 : strtof(temp.data, NULL);
+    bool ok = PublicData::set_value( temperature_control_checksum, type.checksum(), &t );
 
     if (ok) {
-        stream->printf("%s temp set to: %3.1f\r\n", type.c_str(), t);
+        stream->printf("%.*s temp set to: %3.1f\r\n", (int)type.size, type.data, t);
     } else {
-        stream->printf("%s is not a known temperature device\r\n", type.c_str());
+        stream->printf("%.*s is not a known temperature device\r\n", (int)type.size, type.data);
+    }
+}
+
+// set_queue 64 [sram|ahb0|ahb1], it stays in the memory it is in unless one is given, waits for the queue to empty
+void SimpleShell::set_queue_command(const char *parameters, StreamOutput *stream)
+{
+    ParameterView size = shift_parameter( parameters );
+    ParameterView memory = shift_parameter( parameters );
+    if (size.empty()) {
+        THEKERNEL->conveyor->print_queue_stats(stream);
+        return;
     }
+
+    // the sizes given are blocks that can be queued, the ring has one more
+    unsigned int n = strtoul(size.str().c_str(), nullptr, 10) + 1;
+    THEKERNEL->conveyor->resize_queue(n, memory.str(), stream);
 }
 
-void SimpleShell::print_thermistors_command( string parameters, StreamOutput *stream)
+void SimpleShell::print_thermistors_command(const char *parameters, StreamOutput *stream)
 {
     Thermistor::print_predefined_thermistors(stream);
 }
 
-void SimpleShell::calc_thermistor_command( string parameters, StreamOutput *stream)
+void SimpleShell::calc_thermistor_command(const char *parameters, StreamOutput *stream)
 {
-    string s = shift_parameter( parameters );
+    const char *list = parameters;
+    ParameterView s = shift_parameter( parameters );
     int saveto= -1;
     // see if we have -sn as first argument
-    if(s.find("-s", 0, 2) != string::npos) {
+    if(s.size >= 2 && strncmp(s.data, "-s", 2) == 0) {
         // save the results to thermistor n
-        saveto= strtol(s.substr(2).c_str(), nullptr, 10);
-    }else{
-        parameters= s;
+        saveto= strtol(s.data + 2, nullptr, 10);
+        list= parameters;
     }
 
-    std::vector<float> trl= parse_number_list(parameters.c_str());
+    std::vector<float> trl= parse_number_list(list);
     if(trl.size() == 6) {
         // calculate the coefficients
         float c1, c2, c3;
         std::tie(c1, c2, c3) = Thermistor::calculate_steinhart_hart_coefficients(trl[0], trl[1], trl[2], trl[3], trl[4], trl[5]);
         stream->printf("Steinhart Hart coefficients:  I%1.18f J%1.18f K%1.18f\n", c1, c2, c3);
+        stream->printf("  lookup table error from 0 to 300 with a 4.7k pullup:  %f\n", Thermistor::lookup_table_error(c1, c2, c3));
         if(saveto == -1) {
             stream->printf("  Paste the above in the M305 S0 command, then save with M500\n");
         }else{
@@ -875,54 +1314,86 @@ void SimpleShell::calc_thermistor_command( string parameters, StreamOutput *stre
 }
 
 // used to test out the get public data events for switch
-void SimpleShell::switch_command( string parameters, StreamOutput *stream)
+void SimpleShell::switch_command(const char *parameters, StreamOutput *stream)
 {
-    string type = shift_parameter( parameters );
-    string value = shift_parameter( parameters );
+    ParameterView type = shift_parameter( parameters );
+    ParameterView value = shift_parameter( parameters );
     bool ok = false;
     if(value == "on" || value == "off") {
         bool b = value == "on";
-        ok = PublicData::set_value( switch_checksum, get_checksum(type), state_checksum, &b );
+        ok = PublicData::set_value( switch_checksum, type.checksum(), state_checksum, &b );
     } else {
-        float v = strtof(value.c_str(), NULL);
-        ok = PublicData::set_value( switch_checksum, get_checksum(type), value_checksum, &v );
+        float v = strtof(value.data, NULL);
+        ok = PublicData::set_value( switch_checksum, type.checksum(), value_checksum, &v );
     }
     if (ok) {
-        stream->printf("switch %s set to: %s\r\n", type.c_str(), value.c_str());
+        stream->printf("switch %.*s set to: %.*s\r\n", (int)type.size, type.data, (int)value.size, value.data);
     } else {
-        stream->printf("%s is not a known switch device\r\n", type.c_str());
+        stream->printf("%.*s is not a known switch device\r\n", (int)type.size, type.data);
     }
 }
 
-void SimpleShell::md5sum_command( string parameters, StreamOutput *stream )
+// reads the file a whole number of sectors at a time and passes each chunk to hash, returns false if it can't be read
+static bool hash_file(const string &filename, StreamOutput *stream, std::function<void(const uint8_t *, size_t)> hash)
 {
-    string filename = absolute_from_relative(parameters);
-
-    // Open file
     FILE *lp = fopen(filename.c_str(), "r");
     if (lp == NULL) {
         stream->printf("File not found: %s\r\n", filename.c_str());
-        return;
+        return false;
     }
-    MD5 md5;
-    uint8_t buf[64];
-    do {
-        size_t n= fread(buf, 1, sizeof buf, lp);
-        if(n > 0) md5.update(buf, n);
+
+    // unbuffered so FatFs reads multiple sectors straight into the buffer
+    const size_t size = 4096;
+    uint8_t *buf = (uint8_t *)AHB0.alloc(size);
+    bool ahb = (buf != nullptr);
+    if (!ahb) buf = (uint8_t *)malloc(size);
+    if (buf == nullptr) {
+        stream->printf("Not enough memory\r\n");
+        fclose(lp);
+        return false;
+    }
+    setvbuf(lp, nullptr, _IONBF, 0);
+
+    size_t n;
+    while ((n = fread(buf, 1, size, lp)) > 0) {
+        hash(buf, n);
         THEKERNEL->call_event(ON_IDLE);
-    } while(!feof(lp));
+    }
 
-    stream->printf("%s %s\n", md5.finalize().hexdigest().c_str(), filename.c_str());
+    bool ok = !ferror(lp);
+    if (!ok) stream->printf("Error reading: %s\r\n", filename.c_str());
+    if (ahb) AHB0.dealloc(buf);
+    else free(buf);
     fclose(lp);
+    return ok;
+}
+
+void SimpleShell::md5sum_command(const char *parameters, StreamOutput *stream)
+{
+    string filename = absolute_from_relative(parameters);
+    MD5 md5;
+    if (hash_file(filename, stream, [&md5](const uint8_t *buf, size_t n) { md5.update(buf, n); })) {
+        stream->printf("%s %s\n", md5.finalize().hexdigest().c_str(), filename.c_str());
+    }
+}
+
+// a lot quicker than md5sum for checking an upload
+void SimpleShell::crc32_command(const char *parameters, StreamOutput *stream)
+{
+    string filename = absolute_from_relative(parameters);
+    uint32_t crc = 0;
+    if (hash_file(filename, stream, [&crc](const uint8_t *buf, size_t n) { crc = crc32_update(crc, buf, n); })) {
+        stream->printf("%08lx %s\n", crc, filename.c_str());
+    }
 }
 
 
 
-void SimpleShell::help_command( string parameters, StreamOutput *stream )
+void SimpleShell::help_command(const char *parameters, StreamOutput *stream)
 {
     stream->printf("Commands:\r\n");
     stream->printf("version\r\n");
-    stream->printf("mem [-v]\r\n");
+    stream->printf("mem [-v] [-t] [-s] - v lists the chunks, t the allocation sites (HEAP_TAGS=1 builds), s one line\r\n");
     stream->printf("ls [-s] [folder]\r\n");
     stream->printf("cd folder\r\n");
     stream->printf("pwd\r\n");
@@ -930,23 +1401,32 @@ void SimpleShell::help_command( string parameters, StreamOutput *stream )
     stream->printf("rm file\r\n");
     stream->printf("mv file newfile\r\n");
     stream->printf("remount\r\n");
-    stream->printf("play file [-v]\r\n");
+    stream->printf("play file [-v] [-q] - -q queues it to play straight after the one that is playing\r\n");
     stream->printf("progress - shows progress of current play\r\n");
     stream->printf("abort - abort currently playing file\r\n");
+    stream->printf("recover - play on from where the journal says the file that was playing got to\r\n");
+    stream->printf("compile file [job] - compile file to a .job that plays without parsing its moves\r\n");
     stream->printf("reset - reset smoothie\r\n");
     stream->printf("dfu - enter dfu boot loader\r\n");
+    stream->printf("flash [-n] [-c crc32] [file] - program firmware.bin or file, only the flash sectors it changes, -n only checks\r\n");
     stream->printf("break - break into debugger\r\n");
     stream->printf("config-get [<configuration_source>] <configuration_setting>\r\n");
     stream->printf("config-set [<configuration_source>] <configuration_setting> <value>\r\n");
-    stream->printf("get [pos|wcs|state|fk|ik]\r\n");
+    stream->printf("config-load reload <configuration_setting> - apply an edited setting to the module it is for where that needs no reset\r\n");
+    stream->printf("get [pos|wcs|state|fk|ik|kinematics [count]|steptick|queue [reset]|serial|input|boot|profile [reset]|latency [reset]|cycles [on|off|reset]|trace [dump file|reset]]\r\n");
     stream->printf("get temp [bed|hotend]\r\n");
     stream->printf("set_temp bed|hotend 185\r\n");
+    stream->printf("set_queue [blocks [sram|ahb0|ahb1]] - resize the planner queue once it is empty\r\n");
     stream->printf("net\r\n");
+    stream->printf("status hz - send the ? report to this stream hz times a second when it changes, 0 to stop\r\n");
+    stream->printf("ticks - list the slow ticker hooks with their period and how late they have run\r\n");
+    stream->printf("telemetry [flush] - samples logged to the telemetry file, flush writes the ones still in RAM\r\n");
     stream->printf("load [file] - loads a configuration override file from soecified name or config-override\r\n");
     stream->printf("save [file] - saves a configuration override file as specified filename or as config-override\r\n");
-    stream->printf("upload filename - saves a stream of text to the named file\r\n");
+    stream->printf("upload [-b] filename - saves a stream of text to the named file, -b for CRC checked binary frames\r\n");
     stream->printf("calc_thermistor [-s0] T1,R1,T2,R2,T3,R3 - calculate the Steinhart Hart coefficients for a thermistor\r\n");
     stream->printf("thermistors - print out the predefined thermistors\r\n");
     stream->printf("md5sum file - prints md5 sum of the given file\r\n");
+    stream->printf("crc32 file - prints the zlib crc32 of the given file\r\n");
 }
 
@@ -26,42 +26,45 @@ public:
     void on_console_line_received( void *argument );
     void on_gcode_received(void *argument);
     void on_second_tick(void *);
-    static bool parse_command(const char *cmd, string args, StreamOutput *stream);
+    static bool parse_command(const char *cmd, const char *args, StreamOutput *stream);
     static void print_mem(StreamOutput *stream) { mem_command("", stream); }
 
 private:
-    static void ls_command(string parameters, StreamOutput *stream );
-    static void cd_command(string parameters, StreamOutput *stream );
-    static void delete_file_command(string parameters, StreamOutput *stream );
-    static void pwd_command(string parameters, StreamOutput *stream );
-    static void cat_command(string parameters, StreamOutput *stream );
-    static void rm_command(string parameters, StreamOutput *stream );
-    static void mv_command(string parameters, StreamOutput *stream );
-    static void upload_command(string parameters, StreamOutput *stream );
-    static void break_command(string parameters, StreamOutput *stream );
-    static void reset_command(string parameters, StreamOutput *stream );
-    static void dfu_command(string parameters, StreamOutput *stream );
-    static void help_command(string parameters, StreamOutput *stream );
-    static void version_command(string parameters, StreamOutput *stream );
-    static void get_command(string parameters, StreamOutput *stream );
-    static void set_temp_command(string parameters, StreamOutput *stream );
-    static void calc_thermistor_command( string parameters, StreamOutput *stream);
-    static void print_thermistors_command( string parameters, StreamOutput *stream);
-    static void md5sum_command( string parameters, StreamOutput *stream);
-    static void grblDP_command( string parameters, StreamOutput *stream);
-
-    static void switch_command(string parameters, StreamOutput *stream );
-    static void mem_command(string parameters, StreamOutput *stream );
-
-    static void net_command( string parameters, StreamOutput *stream);
-
-    static void load_command( string parameters, StreamOutput *stream);
-    static void save_command( string parameters, StreamOutput *stream);
-
-    static void remount_command( string parameters, StreamOutput *stream);
-
-
-    typedef void (*PFUNC)(string parameters, StreamOutput *stream);
+    static void ls_command(const char *parameters, StreamOutput *stream);
+    static void cd_command(const char *parameters, StreamOutput *stream);
+    static void delete_file_command(const char *parameters, StreamOutput *stream);
+    static void pwd_command(const char *parameters, StreamOutput *stream);
+    static void cat_command(const char *parameters, StreamOutput *stream);
+    static void rm_command(const char *parameters, StreamOutput *stream);
+    static void mv_command(const char *parameters, StreamOutput *stream);
+    static void upload_command(const char *parameters, StreamOutput *stream);
+    static void break_command(const char *parameters, StreamOutput *stream);
+    static void reset_command(const char *parameters, StreamOutput *stream);
+    static void dfu_command(const char *parameters, StreamOutput *stream);
+    static void flash_command(const char *parameters, StreamOutput *stream);
+    static void help_command(const char *parameters, StreamOutput *stream);
+    static void version_command(const char *parameters, StreamOutput *stream);
+    static void get_command(const char *parameters, StreamOutput *stream);
+    static void set_temp_command(const char *parameters, StreamOutput *stream);
+    static void set_queue_command(const char *parameters, StreamOutput *stream);
+    static void calc_thermistor_command(const char *parameters, StreamOutput *stream);
+    static void print_thermistors_command(const char *parameters, StreamOutput *stream);
+    static void md5sum_command(const char *parameters, StreamOutput *stream);
+    static void crc32_command(const char *parameters, StreamOutput *stream);
+    static void grblDP_command(const char *parameters, StreamOutput *stream);
+
+    static void switch_command(const char *parameters, StreamOutput *stream);
+    static void mem_command(const char *parameters, StreamOutput *stream);
+
+    static void net_command(const char *parameters, StreamOutput *stream);
+
+    static void load_command(const char *parameters, StreamOutput *stream);
+    static void save_command(const char *parameters, StreamOutput *stream);
+
+    static void remount_command(const char *parameters, StreamOutput *stream);
+
+
+    typedef void (*PFUNC)(const char *parameters, StreamOutput *stream);
     typedef struct {
         const char *command;
         const PFUNC func;
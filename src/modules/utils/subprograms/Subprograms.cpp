@@ -0,0 +1,241 @@
+#include "Subprograms.h"
+
+#include "libs/Kernel.h"
+#include "Gcode.h"
+#include "Config.h"
+#include "ConfigValue.h"
+#include "checksumm.h"
+#include "StreamOutput.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#define subprograms_checksum    CHECKSUM("subprograms")
+#define enable_checksum         CHECKSUM("enable")
+#define path_checksum           CHECKSUM("path")
+#define cache_lines_checksum    CHECKSUM("cache_lines")
+
+Subprograms::Subprograms()
+{
+    cached_lines= 0;
+    calls= 0;
+    depth= 0;
+}
+
+void Subprograms::on_module_loaded()
+{
+    if(!THEKERNEL->config->value(subprograms_checksum, enable_checksum)->by_default(false)->as_bool()) {
+        delete this;
+        return;
+    }
+
+    path= THEKERNEL->config->value(subprograms_checksum, path_checksum)->by_default("/sd/sub/")->as_string();
+    if(path.empty() || path.back() != '/') path.append("/");
+    cache_lines= THEKERNEL->config->value(subprograms_checksum, cache_lines_checksum)->by_default(64)->as_int();
+
+    register_for_event(ON_GCODE_RECEIVED);
+}
+
+void Subprograms::on_gcode_received(void *argument)
+{
+    Gcode *gcode= static_cast<Gcode *>(argument);
+    if(!gcode->has_m || gcode->m != 98) return;
+
+    if(gcode->subcode == 1) {
+        if(depth == 0) forget();
+        return;
+    }
+
+    if(!gcode->has_letter('P')) {
+        gcode->stream->printf("error:M98 needs the P number of the subprogram\r\n");
+        return;
+    }
+    call(gcode);
+}
+
+void Subprograms::call(Gcode *gcode)
+{
+    if(depth >= max_depth) {
+        gcode->stream->printf("error:subprograms nested more than %d deep\r\n", max_depth);
+        return;
+    }
+
+    uint32_t number= gcode->get_uint('P');
+    Program *program= load(number, gcode->stream);
+    if(program == nullptr) return;
+
+    // every parameter it takes has to be given, a word left without its value would be taken as 0
+    for(auto &l : program->lines) {
+        for(size_t i= 1; i < l.params.size(); i+= 2) {
+            if(!gcode->has_letter(l.params[i])) {
+                gcode->stream->printf("error:subprogram %lu needs %c\r\n", (unsigned long)number, l.params[i]);
+                return;
+            }
+        }
+    }
+
+    int repeats= gcode->has_letter('L') ? gcode->get_int('L') : 1;
+    program->used= ++calls;
+    ++program->running;
+    ++depth;
+    for(int r= 0; r < repeats && !THEKERNEL->is_halted(); ++r) {
+        for(auto &l : program->lines) {
+            // the modules may change the gcode they are given, so they get a copy, which is not parsed again
+            Gcode *g= new Gcode(*l.gcode);
+            g->stream= gcode->stream;
+            for(size_t i= 0; i + 1 < l.params.size(); i+= 2) {
+                g->set_value(l.params[i], gcode->get_value(l.params[i + 1]));
+            }
+
+            THEKERNEL->call_event(ON_GCODE_RECEIVED, g);
+            if(g->add_nl) gcode->stream->printf("\r\n");
+            if(!g->txt_after_ok.empty()) gcode->stream->printf("%s\r\n", g->txt_after_ok.c_str());
+            delete g;
+            if(THEKERNEL->is_halted()) break;
+        }
+    }
+    --depth;
+    --program->running;
+}
+
+// the cached one unless the file has changed since
+Subprograms::Program *Subprograms::load(uint32_t number, StreamOutput *stream)
+{
+    char fn[64];
+    snprintf(fn, sizeof(fn), "%s%lu.g", path.c_str(), (unsigned long)number);
+    FILE *fp= fopen(fn, "r");
+    if(fp == nullptr) {
+        stream->printf("error:subprogram %s not found\r\n", fn);
+        return nullptr;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size= ftell(fp);
+
+    Program *program= nullptr;
+    for(auto p : cache) {
+        if(p->number == number) program= p;
+    }
+    // one that is running is kept as it is, it has to go on the way it started
+    if(program != nullptr && (program->size == size || program->running > 0)) {
+        fclose(fp);
+        return program;
+    }
+    if(program != nullptr) drop(program);
+
+    rewind(fp);
+    program= new Program;
+    program->number= number;
+    program->size= size;
+    program->used= 0;
+    program->running= 0;
+
+    char buf[132];
+    int n= 0;
+    bool end= false;
+    const char *error= nullptr;
+    while(!end && error == nullptr && fgets(buf, sizeof(buf), fp) != nullptr) {
+        ++n;
+        if(strchr(buf, '\n') == nullptr && !feof(fp)) error= "is too long";
+        else error= parse_line(buf, program, end);
+    }
+    fclose(fp);
+
+    if(error == nullptr && !make_room(program->lines.size())) error= "does not fit in the cache, see subprograms.cache_lines";
+    if(error != nullptr) {
+        stream->printf("error:subprogram %s line %d %s\r\n", fn, n, error);
+        drop(program);
+        return nullptr;
+    }
+
+    cached_lines+= program->lines.size();
+    cache.push_back(program);
+    return program;
+}
+
+// split the line the way GcodeDispatch does, nullptr if it is fine
+const char *Subprograms::parse_line(char *line, Program *program, bool &end)
+{
+    char *p= line + strcspn(line, ";(\r\n");
+    *p= '\0';
+    while(isspace(*line)) ++line;
+    if(*line == 'N') {
+        ++line;
+        while(isdigit(*line) || isspace(*line)) ++line;
+    }
+    // blank lines, and the % and O number lines of a program
+    if(*line == '\0' || *line == '%' || *line == 'O') return nullptr;
+    if(strncmp(line, "M99", 3) == 0 && !isdigit(line[3])) {
+        end= true;
+        return nullptr;
+    }
+    if(*line != 'G' && *line != 'M' && *line != 'T') return "is not a gcode";
+
+    std::string rest(line);
+    while(!rest.empty()) {
+        size_t next= rest.find_first_of("GM", 2);
+        std::string single= rest.substr(0, next);
+        rest= next == std::string::npos ? "" : rest.substr(next);
+
+        // take out the #<letter> values, noting the word they belong to
+        Line l;
+        for(size_t i= single.find('#'); i != std::string::npos; i= single.find('#', i)) {
+            size_t w= single.find_last_not_of(' ', i == 0 ? 0 : i - 1);
+            char word= i == 0 || w == std::string::npos ? 0 : single[w];
+            char param= i + 1 < single.size() ? single[i + 1] : 0;
+            if(word < 'A' || word > 'Z' || param < 'A' || param > 'Z' || param == 'P' || param == 'L') return "has a bad #parameter";
+            l.params.push_back(word);
+            l.params.push_back(param);
+            single.erase(i, 2);
+        }
+
+        l.gcode= new Gcode(single, nullptr);
+        const Gcode *g= l.gcode;
+        bool allowed= !(g->has_g && g->g == 53);
+        if(g->has_m) {
+            switch(g->m) {
+                case 2: case 28: case 29: case 30: case 112: case 117: case 500: case 502: case 503: case 1000:
+                    allowed= false;
+                    break;
+            }
+        }
+        if(!allowed) {
+            delete l.gcode;
+            return "can not be in a subprogram";
+        }
+        program->lines.push_back(l);
+    }
+    return nullptr;
+}
+
+// drops the least recently used ones that are not running until there is room
+bool Subprograms::make_room(size_t lines)
+{
+    while(cached_lines + lines > cache_lines) {
+        Program *oldest= nullptr;
+        for(auto p : cache) {
+            if(p->running == 0 && (oldest == nullptr || p->used < oldest->used)) oldest= p;
+        }
+        if(oldest == nullptr) return false;
+        drop(oldest);
+    }
+    return true;
+}
+
+void Subprograms::drop(Program *program)
+{
+    for(auto i= cache.begin(); i != cache.end(); ++i) {
+        if(*i == program) {
+            cache.erase(i);
+            cached_lines-= program->lines.size();
+            break;
+        }
+    }
+    for(auto &l : program->lines) delete l.gcode;
+    delete program;
+}
+
+void Subprograms::forget()
+{
+    while(!cache.empty()) drop(cache.back());
+}
@@ -0,0 +1,53 @@
+#ifndef _SUBPROGRAMS_H
+#define _SUBPROGRAMS_H
+
+#include "libs/Module.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class Gcode;
+class StreamOutput;
+
+// M98 P<n> [L<repeats>] calls the subprogram in <path><n>.g, which ends at M99 or the end of the file. The file is
+// parsed once into Gcodes that are kept, so a call, however often it repeats, replays copies of them through
+// ON_GCODE_RECEIVED without reading the sdcard or parsing a line. A word whose value is #<letter> takes the value
+// of that letter of the call, so M98 P10 A5 runs G1 X#A as G1 X5. M98.1 forgets the cached subprograms.
+class Subprograms : public Module {
+    public:
+        Subprograms();
+
+        void on_module_loaded();
+        void on_gcode_received(void *argument);
+
+    private:
+        struct Line {
+            Gcode *gcode;
+            std::string params;     // pairs of the letter of the word and the letter of the call it takes
+        };
+        struct Program {
+            uint32_t number;
+            long size;              // of the file, when it has changed the file is parsed again
+            uint32_t used;          // when it was last called, the least recently used goes first
+            uint8_t running;        // calls of it in progress, it is not dropped while there are any
+            std::vector<Line> lines;
+        };
+
+        void call(Gcode *gcode);
+        Program *load(uint32_t number, StreamOutput *stream);
+        const char *parse_line(char *line, Program *program, bool &end);
+        bool make_room(size_t lines);
+        void drop(Program *program);
+        void forget();
+
+        std::string path;
+        std::vector<Program *> cache;
+        size_t cache_lines;         // the most Gcodes held for all of them
+        size_t cached_lines;
+        uint32_t calls;
+        uint8_t depth;              // of the calls in progress
+        static const uint8_t max_depth= 4;
+};
+
+#endif
@@ -0,0 +1,369 @@
+#include "Telemetry.h"
+
+#include "libs/Kernel.h"
+#include "libs/SlowTicker.h"
+#include "Robot.h"
+#include "Conveyor.h"
+#include "StepperMotor.h"
+#include "Config.h"
+#include "ConfigValue.h"
+#include "checksumm.h"
+#include "utils.h"
+#include "nuts_bolts.h"
+#include "PublicData.h"
+#include "TemperatureControlPublicAccess.h"
+#include "SerialMessage.h"
+#include "StreamOutput.h"
+#include "StreamOutputPool.h"
+#include "platform_memory.h"
+#include "cmsis.h"
+
+#include <math.h>
+#include <string.h>
+
+#define telemetry_checksum          CHECKSUM("telemetry")
+#define enable_checksum             CHECKSUM("enable")
+#define file_checksum               CHECKSUM("file")
+#define rate_checksum               CHECKSUM("rate")
+#define sectors_checksum            CHECKSUM("sectors")
+#define buffer_sectors_checksum     CHECKSUM("buffer_sectors")
+#define channels_checksum           CHECKSUM("channels")
+#define while_idle_checksum         CHECKSUM("while_idle")
+#define flush_interval_checksum     CHECKSUM("flush_interval")
+
+static_assert(sizeof(Telemetry::header_t) == 24 && sizeof(Telemetry::channel_t) == 20 && sizeof(Telemetry::sector_t) == 16,
+              "the layout of the file is read by smoothie-telemetry.py");
+
+static const char *actuator_labels[]= { "alpha", "beta", "gamma", "delta", "epsilon", "zeta" };
+
+// sectors of the file made each pass of the main loop the first time, so it does not hold up the boot
+static const uint32_t allocate_per_loop= 16;
+
+Telemetry::Telemetry()
+{
+    fp= nullptr;
+    rows= nullptr;
+    buffers= nullptr;
+    session= 1;
+    allocated= 0;
+    sequence= 0;
+    written= 0;
+    samples= 0;
+    kept= 0;
+    dropped= 0;
+    record_size= sizeof(uint32_t);
+    secs= 0;
+    n_rows= 0;
+    filling= 0;
+    ready= 0;
+    writing= 0;
+    running= false;
+    flush_pending= false;
+}
+
+void Telemetry::on_module_loaded()
+{
+    if(!THEKERNEL->config->value(telemetry_checksum, enable_checksum)->by_default(false)->as_bool()) {
+        delete this;
+        return;
+    }
+
+    filename= THEKERNEL->config->value(telemetry_checksum, file_checksum)->by_default("/sd/telemetry.bin")->as_string();
+    int r= THEKERNEL->config->value(telemetry_checksum, rate_checksum)->by_default(10)->as_int();
+    rate= confine(r, 1, 1000);
+    file_sectors= std::max(1, THEKERNEL->config->value(telemetry_checksum, sectors_checksum)->by_default(2048)->as_int());
+    int b= THEKERNEL->config->value(telemetry_checksum, buffer_sectors_checksum)->by_default(4)->as_int();
+    n_buffers= confine(b, 2, 32);
+    while_idle= THEKERNEL->config->value(telemetry_checksum, while_idle_checksum)->by_default(false)->as_bool();
+    flush_interval= THEKERNEL->config->value(telemetry_checksum, flush_interval_checksum)->by_default(10)->as_int();
+
+    // the controls keep their rows up to date where they are, so they can be read from the ticker
+    void *returned_data;
+    if(PublicData::get_value(temperature_control_checksum, temperature_snapshot_checksum, &returned_data)) {
+        const pad_temperature_snapshot *s= static_cast<const pad_temperature_snapshot *>(returned_data);
+        rows= s->rows;
+        n_rows= s->count;
+    }
+
+    std::string list= THEKERNEL->config->value(telemetry_checksum, channels_checksum)->by_default("actuators,queue,temperatures,targets,pwm")->as_string();
+    char name[sizeof(channel_t::name)];
+    for(auto &c : split(list.c_str(), ',')) {
+        if(c == "actuators") {
+            for(size_t i= 0; i < THEKERNEL->robot->actuators.size() && i < sizeof(actuator_labels) / sizeof(actuator_labels[0]); i++) {
+                add_channel(actuator_labels[i], 'i', 0.001F, ACTUATOR, i);
+            }
+        } else if(c == "queue") {
+            add_channel("queue", 'h', 1, QUEUE, 0);
+        } else if(c == "temperatures" || c == "targets" || c == "pwm") {
+            for(uint8_t i= 0; i < n_rows; i++) {
+                if(c == "temperatures") {
+                    snprintf(name, sizeof(name), "%s", rows[i].designator);
+                    add_channel(name, 'h', 0.1F, TEMPERATURE, i);
+                } else if(c == "targets") {
+                    snprintf(name, sizeof(name), "%s_target", rows[i].designator);
+                    add_channel(name, 'h', 0.1F, TARGET, i);
+                } else {
+                    snprintf(name, sizeof(name), "%s_pwm", rows[i].designator);
+                    add_channel(name, 'h', 1, PWM, i);
+                }
+            }
+        } else {
+            THEKERNEL->streams->printf("WARNING: telemetry channel %s is not one of actuators, queue, temperatures, targets or pwm\n", c.c_str());
+        }
+    }
+    records_per_sector= (sector_size - sizeof(sector_t)) / record_size;
+
+    buffers= new uint8_t*[n_buffers];
+    for(uint8_t i= 0; i < n_buffers; i++) {
+        void *p= AHB0.alloc(sector_size);
+        if(p == nullptr) p= AHB1.alloc(sector_size);
+        if(p == nullptr) {
+            THEKERNEL->streams->printf("WARNING: the telemetry buffers of %d sectors do not fit in AHB RAM\n", n_buffers);
+            n_buffers= i;
+            delete this;
+            return;
+        }
+        buffers[i]= (uint8_t *)p;
+        memset(p, 0, sector_size);
+    }
+
+    if(!open_file()) {
+        THEKERNEL->streams->printf("WARNING: could not open the telemetry file %s\n", filename.c_str());
+        delete this;
+        return;
+    }
+
+    register_for_event(ON_MAIN_LOOP);
+    register_for_event(ON_SECOND_TICK);
+    register_for_event(ON_CONSOLE_LINE_RECEIVED);
+    // only to write a buffer that filled, or make the file, and that can wait while the queue is being fed
+    set_event_rate(ON_MAIN_LOOP, 0, true);
+    set_event_priority(ON_MAIN_LOOP, PRIORITY_HOUSEKEEPING);
+
+    THEKERNEL->slow_ticker->attach(rate, this, &Telemetry::sample_tick);
+
+    if(allocated > file_sectors) {
+        write_header();
+        running= true;
+    } else {
+        wake_for_event(ON_MAIN_LOOP);
+    }
+}
+
+Telemetry::~Telemetry()
+{
+    if(fp != nullptr) fclose(fp);
+    for(uint8_t i= 0; buffers != nullptr && i < n_buffers; i++) {
+        if(AHB0.has(buffers[i])) AHB0.dealloc(buffers[i]);
+        else AHB1.dealloc(buffers[i]);
+    }
+    delete [] buffers;
+}
+
+void Telemetry::add_channel(const char *name, char type, float scale, uint8_t source, uint8_t index)
+{
+    if(channels.size() >= max_channels) {
+        THEKERNEL->streams->printf("WARNING: telemetry has %u channels at most, %s is left out\n", (unsigned)max_channels, name);
+        return;
+    }
+    channel_t c;
+    memset(&c, 0, sizeof(c));
+    strncpy(c.name, name, sizeof(c.name) - 1);
+    c.type= type;
+    c.scale= scale;
+    channels.push_back(c);
+    sources.push_back({source, index, (uint8_t)record_size});
+    record_size += type == 'i' ? 4 : 2;
+}
+
+// a file of the size it should be is used again, records of earlier boots are left in it until they are overwritten
+bool Telemetry::open_file()
+{
+    uint32_t size= 0;
+    header_t h;
+    fp= fopen(filename.c_str(), "r+");
+    if(fp != nullptr) {
+        // each write goes straight to its sector
+        setvbuf(fp, nullptr, _IONBF, 0);
+        if(fread(&h, 1, sizeof(h), fp) == sizeof(h) && memcmp(h.magic, "SMTL", 4) == 0) session= h.session + 1;
+        fseek(fp, 0, SEEK_END);
+        size= ftell(fp);
+        if(size != (file_sectors + 1) * sector_size) {
+            fclose(fp);
+            fp= nullptr;
+        }
+    }
+    if(fp == nullptr) {
+        fp= fopen(filename.c_str(), "w+");
+        if(fp == nullptr) return false;
+        setvbuf(fp, nullptr, _IONBF, 0);
+        size= 0;
+    }
+    allocated= size / sector_size;
+    return true;
+}
+
+void Telemetry::write_header()
+{
+    uint8_t sector[sector_size];
+    memset(sector, 0, sizeof(sector));
+    header_t *h= reinterpret_cast<header_t *>(sector);
+    memcpy(h->magic, "SMTL", 4);
+    h->version= 1;
+    h->record_size= record_size;
+    h->session= session;
+    h->sectors= file_sectors;
+    h->rate= rate;
+    h->channels= channels.size();
+    memcpy(sector + sizeof(header_t), channels.data(), channels.size() * sizeof(channel_t));
+    fseek(fp, 0, SEEK_SET);
+    fwrite(sector, 1, sizeof(sector), fp);
+    fflush(fp);
+}
+
+void Telemetry::write_sector(const uint8_t *buffer)
+{
+    const sector_t *s= reinterpret_cast<const sector_t *>(buffer);
+    fseek(fp, (1 + (s->sequence - 1) % file_sectors) * sector_size, SEEK_SET);
+    fwrite(buffer, 1, sector_size, fp);
+    fflush(fp);
+    ++written;
+}
+
+void Telemetry::on_main_loop(void *argument)
+{
+    if(allocated <= file_sectors) {
+        // once, the writes after this only overwrite sectors that are there
+        uint8_t zero[sector_size];
+        memset(zero, 0, sizeof(zero));
+        fseek(fp, allocated * sector_size, SEEK_SET);
+        for(uint32_t i= 0; i < allocate_per_loop && allocated <= file_sectors; i++, allocated++) {
+            if(fwrite(zero, 1, sizeof(zero), fp) != sizeof(zero)) {
+                THEKERNEL->streams->printf("WARNING: the telemetry file %s could not be made, the sdcard may be full\n", filename.c_str());
+                // it is not woken again, as nothing is sampled
+                fclose(fp);
+                fp= nullptr;
+                return;
+            }
+        }
+        if(allocated <= file_sectors) {
+            wake_for_event(ON_MAIN_LOOP);
+            return;
+        }
+        fflush(fp);
+        write_header();
+        running= true;
+        return;
+    }
+
+    while(ready > 0) {
+        write_sector(buffers[writing]);
+        writing= (writing + 1) % n_buffers;
+        __sync_fetch_and_sub(&ready, 1);
+    }
+
+    if(flush_pending) {
+        flush_pending= false;
+        // a copy, the ticker goes on adding to it
+        uint8_t copy[sector_size];
+        __disable_irq();
+        memcpy(copy, buffers[filling], sector_size);
+        __enable_irq();
+        if(reinterpret_cast<sector_t *>(copy)->records > 0) write_sector(copy);
+    }
+}
+
+void Telemetry::on_second_tick(void *argument)
+{
+    if(!running || flush_interval == 0 || ++secs < flush_interval) return;
+    secs= 0;
+    flush_pending= true;
+    wake_for_event(ON_MAIN_LOOP);
+}
+
+void Telemetry::on_console_line_received(void *argument)
+{
+    SerialMessage new_message = *static_cast<SerialMessage *>(argument);
+    std::string possible_command = new_message.message;
+    if(shift_parameter(possible_command) != "telemetry") return;
+
+    StreamOutput *stream= new_message.stream;
+    if(fp == nullptr) {
+        stream->printf("telemetry: the file %s could not be made\n", filename.c_str());
+        return;
+    }
+    if(!running) {
+        stream->printf("telemetry: making %s, %lu of %lu sectors\n", filename.c_str(), allocated, file_sectors + 1);
+        return;
+    }
+    // telemetry flush writes what there is so far, before the card is taken out
+    if(shift_parameter(possible_command) == "flush") {
+        flush_pending= true;
+        on_main_loop(nullptr);
+    }
+    stream->printf("telemetry: %s session %lu, %u channels of %u byte records at %u Hz\n", filename.c_str(), session,
+                   (unsigned)channels.size(), record_size, rate);
+    stream->printf("%lu of %lu samples kept, %lu dropped, %lu sectors written\n", kept, samples, dropped, written);
+}
+
+void Telemetry::next_buffer()
+{
+    ++ready;
+    filling= (filling + 1) % n_buffers;
+    reinterpret_cast<sector_t *>(buffers[filling])->records= 0;
+    wake_for_event(ON_MAIN_LOOP);
+}
+
+// in the slow ticker interrupt
+uint32_t Telemetry::sample_tick(uint32_t)
+{
+    uint32_t n= samples++;
+    if(!running) return 0;
+
+    if(!while_idle && THEKERNEL->conveyor->is_queue_empty()) {
+        bool heating= false;
+        for(uint8_t i= 0; i < n_rows && !heating; i++) heating= rows[i].target_temperature > 0;
+        if(!heating) return 0;
+    }
+
+    sector_t *s= reinterpret_cast<sector_t *>(buffers[filling]);
+    if(s->records >= records_per_sector) {
+        // it could not be handed over when it filled, as all the others were still to be written
+        if(ready >= n_buffers - 1) {
+            ++dropped;
+            return 0;
+        }
+        next_buffer();
+        s= reinterpret_cast<sector_t *>(buffers[filling]);
+    }
+    if(s->records == 0) {
+        s->session= session;
+        s->sequence= ++sequence;
+        s->first_sample= n;
+        s->record_size= record_size;
+    }
+
+    uint8_t *r= buffers[filling] + sizeof(sector_t) + s->records * record_size;
+    memcpy(r, &n, sizeof(n));
+    for(auto &src : sources) {
+        int32_t v;
+        switch(src.source) {
+            case ACTUATOR: v= lroundf(THEKERNEL->robot->actuators[src.index]->get_current_position() * 1000); break;
+            case QUEUE: v= THEKERNEL->conveyor->queue_depth(); break;
+            // -32768 for a control with no good reading
+            case TEMPERATURE: v= isfinite(rows[src.index].current_temperature) ? lroundf(rows[src.index].current_temperature * 10) : -32768; break;
+            case TARGET: v= lroundf(rows[src.index].target_temperature * 10); break;
+            default: v= rows[src.index].pwm; break;
+        }
+        if(src.source == ACTUATOR) {
+            memcpy(r + src.offset, &v, 4);
+        } else {
+            int16_t h= confine(v, -32768L, 32767L);
+            memcpy(r + src.offset, &h, 2);
+        }
+    }
+    ++kept;
+
+    if(++s->records == records_per_sector && ready < n_buffers - 1) next_buffer();
+    return 0;
+}
@@ -0,0 +1,104 @@
+#ifndef _TELEMETRY_H
+#define _TELEMETRY_H
+
+#include "libs/Module.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct pad_temperature_row;
+
+// Logs the positions of the actuators, the depth of the planner queue and the temperatures, targets and PWM of the
+// temperature controls to the sdcard as fixed size binary records, for a history of every job. The channels are
+// sampled from the slow ticker at telemetry.rate into sector sized buffers in AHB RAM, and a buffer that is full wakes
+// the main loop to write it as one sector of a file that was allocated when it was first made, which is used as a
+// ring so the newest telemetry.sectors are kept. A sample costs a few microseconds and the sdcard is written about
+// once every couple of seconds. With telemetry.while_idle false, samples are only kept while there are moves queued or
+// a heater has a target. smoothie-telemetry.py decodes the file.
+class Telemetry : public Module {
+    public:
+        Telemetry();
+        ~Telemetry();
+
+        void on_module_loaded();
+        void on_main_loop(void *argument);
+        void on_second_tick(void *argument);
+        void on_console_line_received(void *argument);
+
+        // the layout of the file, keep smoothie-telemetry.py in step with it. The first sector is the header, with
+        // the channels, the sectors after it hold the records
+        struct header_t {
+            char magic[4];                  // SMTL
+            uint16_t version;
+            uint16_t record_size;
+            uint32_t session;               // one more each boot, sectors from an earlier one are left over
+            uint32_t sectors;               // of records, after the header
+            float rate;                     // samples a second
+            uint16_t channels;
+            uint16_t reserved;
+        };
+        struct channel_t {
+            char name[14];
+            char type;                      // as the struct module has it, h for int16 and i for int32
+            uint8_t reserved;
+            float scale;                    // the value times this is in its units
+        };
+        struct sector_t {
+            uint32_t session;
+            uint32_t sequence;              // of the sectors in the session, from 1, the slot is that modulo the sectors
+            uint32_t first_sample;          // the number of the sample of the first record, a record starts with its own
+            uint16_t records;
+            uint16_t record_size;
+        };
+
+    private:
+        enum SOURCE { ACTUATOR, QUEUE, TEMPERATURE, TARGET, PWM };
+        struct source_t {
+            uint8_t source;
+            uint8_t index;                  // of the actuator or the temperature control
+            uint8_t offset;                 // in the record
+        };
+        static const size_t sector_size= 512;
+        static const size_t max_channels= (sector_size - sizeof(header_t)) / sizeof(channel_t);
+
+        void add_channel(const char *name, char type, float scale, uint8_t source, uint8_t index);
+        bool open_file();
+        void write_header();
+        void write_sector(const uint8_t *buffer);
+        uint32_t sample_tick(uint32_t);
+        void next_buffer();
+
+        std::vector<channel_t> channels;
+        std::vector<source_t> sources;
+        std::string filename;
+        FILE *fp;
+        const pad_temperature_row *rows;
+        uint8_t **buffers;                  // sector sized
+        uint32_t session;
+        uint32_t file_sectors;
+        uint32_t allocated;                 // sectors made in the file so far, it is usable once all of them are
+        uint32_t sequence;                  // of the last sector started
+        uint32_t written;
+        volatile uint32_t samples;          // ticks since boot, kept or not
+        volatile uint32_t kept;
+        volatile uint32_t dropped;          // samples lost while all the buffers were waiting to be written
+        uint16_t rate;
+        uint16_t record_size;
+        uint16_t records_per_sector;
+        uint16_t flush_interval;            // seconds between writes of the buffer being filled, 0 to only write full ones
+        uint16_t secs;
+        uint8_t n_buffers;
+        uint8_t n_rows;
+        volatile uint8_t filling;           // the buffer the ticker adds records to
+        volatile uint8_t ready;             // full buffers waiting to be written, the oldest is writing
+        uint8_t writing;
+        struct {
+            bool running:1;
+            bool while_idle:1;
+            volatile bool flush_pending:1;
+        };
+};
+
+#endif
@@ -22,6 +22,7 @@ This is aprt of the Smoothie test framework, it generates a Mockable Kernl so ke
 
 #include "libs/StepTicker.h"
 #include "libs/PublicData.h"
+#include "libs/LatencyStats.h"
 #include "modules/communication/SerialConsole.h"
 #include "modules/communication/GcodeDispatch.h"
 #include "modules/robot/Planner.h"
@@ -42,6 +43,9 @@ Kernel* Kernel::instance;
 // The kernel is the central point in Smoothie : it stores modules, and handles event calls
 Kernel::Kernel(){
     instance= this; // setup the Singleton instance of the kernel
+    running_module= nullptr;
+    running_event= 0;
+    latency= new LatencyStats();
 
     // serial first at fixed baud rate (DEFAULT_SERIAL_BAUD_RATE) so config can report errors to serial
     // Set to UART0, this will be changed to use the same UART as MRI if it's enabled
@@ -68,21 +72,21 @@ Kernel::Kernel(){
 }
 
 // Add a module to Kernel. We don't actually hold a list of modules we just call its on_module_loaded
-void Kernel::add_module(Module* module){
+void Kernel::add_module(Module* module, const char *name){
     module->on_module_loaded();
 }
 
 // Adds a hook for a given module and event
 void Kernel::register_for_event(_EVENT_ENUM id_event, Module *mod){
-    this->hooks[id_event].push_back(mod);
+    this->hooks[id_event].push_back({mod, 0, 0, 0, 0, false, false, PRIORITY_NORMAL});
 }
 
 static std::map<_EVENT_ENUM, std::function<void(void*)> > event_callbacks;
 
 // Call a specific event with an argument
 void Kernel::call_event(_EVENT_ENUM id_event, void * argument){
-    for (auto m : hooks[id_event]) {
-        (m->*kernel_callback_functions[id_event])(argument);
+    for (auto &h : hooks[id_event]) {
+        (h.module->*kernel_callback_functions[id_event])(argument);
     }
     if(event_callbacks.find(id_event) != event_callbacks.end()){
         event_callbacks[id_event](argument);
@@ -94,8 +98,8 @@ void Kernel::call_event(_EVENT_ENUM id_event, void * argument){
 // These are used by tests to test for various things. basically mocks
 bool Kernel::kernel_has_event(_EVENT_ENUM id_event, Module *mod)
 {
-    for (auto m : hooks[id_event]) {
-        if(m == mod) return true;
+    for (auto &h : hooks[id_event]) {
+        if(h.module == mod) return true;
     }
     return false;
 }
@@ -103,13 +107,49 @@ bool Kernel::kernel_has_event(_EVENT_ENUM id_event, Module *mod)
 void Kernel::unregister_for_event(_EVENT_ENUM id_event, Module *mod)
 {
     for (auto i = hooks[id_event].begin(); i != hooks[id_event].end(); ++i) {
-        if(*i == mod) {
+        if(i->module == mod) {
             hooks[id_event].erase(i);
             return;
         }
     }
 }
 
+// tests call the handlers every time
+void Kernel::set_event_rate(_EVENT_ENUM id_event, Module *mod, uint16_t interval_ms, bool wake_only)
+{
+}
+
+void Kernel::wake_for_event(_EVENT_ENUM id_event, Module *mod)
+{
+}
+
+void Kernel::set_event_priority(_EVENT_ENUM id_event, Module *mod, EVENT_PRIORITY priority)
+{
+}
+
+std::vector<Kernel::event_profile_t> Kernel::get_event_profile() const
+{
+    return std::vector<event_profile_t>();
+}
+
+void Kernel::reset_event_profile()
+{
+}
+
+bool Kernel::is_input_pending() const
+{
+    for (auto &c : input_checks) {
+        if(c()) return true;
+    }
+    return false;
+}
+
+// modules are not named in the tests
+const char *Kernel::get_module_name(const Module *module) const
+{
+    return nullptr;
+}
+
 void test_kernel_setup_config(const char* start, const char* end)
 {
     THEKERNEL->config= new Config(new FirmConfigSource("rom", start, end) );
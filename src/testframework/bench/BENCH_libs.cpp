@@ -0,0 +1,76 @@
+#include "Bench.h"
+
+#include "RingBuffer.h"
+#include "HeapRing.h"
+#include "Median.h"
+#include "Gcode.h"
+#include "StreamOutput.h"
+
+#include <string.h>
+
+// HeapRing is a template kept in a .cpp, Conveyor makes the one for Block the same way
+#include "HeapRing.cpp"
+template class HeapRing<uint32_t>;
+
+BENCH(ringbuffer_push_pop, 10000)
+{
+    static RingBuffer<uint32_t, 32> ring;
+    uint32_t v, sum= 0;
+    for (uint32_t i = 0; i < ops; i++) {
+        ring.push_back(i);
+        ring.pop_front(v);
+        sum += v;
+    }
+    bench_sink(sum);
+}
+
+BENCH(heapring_produce_consume, 10000)
+{
+    static HeapRing<uint32_t> ring(32);
+    uint32_t sum= 0;
+    for (uint32_t i = 0; i < ops; i++) {
+        *ring.head_ref()= i;
+        ring.produce_head();
+        sum += *ring.tail_ref();
+        ring.consume_tail();
+    }
+    bench_sink(sum);
+}
+
+// the readings the Adc takes the median of, with a spike in them
+BENCH(median_quick_median_8, 10000)
+{
+    static const uint16_t readings[8]= { 2051, 2047, 2049, 4095, 2050, 2046, 2048, 2052 };
+    uint16_t data[8];
+    uint32_t sum= 0;
+    for (uint32_t i = 0; i < ops; i++) {
+        memcpy(data, readings, sizeof(data));
+        sum += data[quick_median(data, 8)];
+    }
+    bench_sink(sum);
+}
+
+// a typical line of a sliced file, and one with only a couple of words
+BENCH(gcode_parse_g1, 2000)
+{
+    static const char line[]= "G1 X112.345 Y-87.25 Z0.3 E1.23456 F3000";
+    NullStreamOutput null;
+    float sum= 0;
+    for (uint32_t i = 0; i < ops; i++) {
+        Gcode g(line, sizeof(line) - 1, &null);
+        sum += g.get_value('X') + g.get_value('E');
+    }
+    bench_sink(sum);
+}
+
+BENCH(gcode_parse_short, 2000)
+{
+    static const char line[]= "G0 Z5";
+    NullStreamOutput null;
+    float sum= 0;
+    for (uint32_t i = 0; i < ops; i++) {
+        Gcode g(line, sizeof(line) - 1, &null);
+        sum += g.get_value('Z');
+    }
+    bench_sink(sum);
+}
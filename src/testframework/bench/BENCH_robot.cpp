@@ -0,0 +1,97 @@
+#include "Bench.h"
+
+#include "libs/Kernel.h"
+#include "Config.h"
+#include "ActuatorCoordinates.h"
+#include "arm_solutions/CartesianSolution.h"
+#include "arm_solutions/LinearDeltaSolution.h"
+#include "arm_solutions/RotaryDeltaSolution.h"
+#include "arm_solutions/MorganSCARASolution.h"
+
+#ifdef SIMULATION
+#include "Robot.h"
+#include "Planner.h"
+#include "Conveyor.h"
+#include "StepperMotor.h"
+#endif
+
+// a point each of them can reach with the geometry they default to
+static const float point[3]= { 60.0F, 40.0F, 20.0F };
+
+// made once, with the arm settings of the config, which is only loaded on the board while they are made
+static BaseSolution *solution(int which)
+{
+    static BaseSolution *solutions[4];
+    if(solutions[which] == nullptr) {
+        bool loaded= THEKERNEL->config->is_config_cache_loaded();
+        if(!loaded) THEKERNEL->config->config_cache_load();
+        switch(which) {
+            case 0: solutions[which]= new CartesianSolution(THEKERNEL->config); break;
+            case 1: solutions[which]= new LinearDeltaSolution(THEKERNEL->config); break;
+            case 2: solutions[which]= new RotaryDeltaSolution(THEKERNEL->config); break;
+            case 3: solutions[which]= new MorganSCARASolution(THEKERNEL->config); break;
+        }
+        if(!loaded) THEKERNEL->config->config_cache_clear();
+    }
+    return solutions[which];
+}
+
+static void ik(int which, uint32_t ops)
+{
+    BaseSolution *s= solution(which);
+    ActuatorCoordinates ac;
+    float p[3]= { point[0], point[1], point[2] };
+    float sum= 0;
+    for (uint32_t i = 0; i < ops; i++) {
+        // moved a little each time so nothing is worked out once for all of them
+        p[0]= point[0] + (i & 15) * 0.01F;
+        s->cartesian_to_actuator(p, ac);
+        sum += ac[0];
+    }
+    bench_sink(sum);
+}
+
+static void fk(int which, uint32_t ops)
+{
+    BaseSolution *s= solution(which);
+    ActuatorCoordinates ac;
+    s->cartesian_to_actuator(point, ac);
+    float p[3];
+    float sum= 0;
+    for (uint32_t i = 0; i < ops; i++) {
+        s->actuator_to_cartesian(ac, p);
+        sum += p[0];
+    }
+    bench_sink(sum);
+}
+
+BENCH(arm_cartesian_ik, 2000) { ik(0, ops); }
+BENCH(arm_cartesian_fk, 2000) { fk(0, ops); }
+BENCH(arm_linear_delta_ik, 2000) { ik(1, ops); }
+BENCH(arm_linear_delta_fk, 2000) { fk(1, ops); }
+BENCH(arm_rotary_delta_ik, 2000) { ik(2, ops); }
+BENCH(arm_rotary_delta_fk, 2000) { fk(2, ops); }
+BENCH(arm_morgan_scara_ik, 2000) { ik(3, ops); }
+BENCH(arm_morgan_scara_fk, 2000) { fk(3, ops); }
+
+#ifdef SIMULATION
+// on the board the blocks would be stepped, so this is only timed on the host where the queue can be thrown away
+static void planner_reset(uint32_t ops)
+{
+    THEKERNEL->conveyor->flush_queue();
+}
+
+// a zigzag of short moves, so each one has a junction to plan and replans the ones before it
+BENCH_RESET(planner_append_block, 16, planner_reset)
+{
+    Robot *robot= THEKERNEL->robot;
+    ActuatorCoordinates target;
+    for (size_t a = 0; a < robot->actuators.size(); a++) target[a]= robot->actuators[a]->get_last_milestone();
+    for (uint32_t i = 0; i < ops; i++) {
+        float unit_vec[3]= { 0.8F, (i & 1) ? 0.6F : -0.6F, 0 };
+        target[0] += 0.8F;
+        target[1] += unit_vec[1];
+        THEKERNEL->planner->append_block(target, 100.0F, 1.0F, unit_vec);
+    }
+}
+#endif
@@ -0,0 +1,40 @@
+#include "Bench.h"
+
+// the conversion needs the Adc, so it is only timed on the board
+#ifndef SIMULATION
+
+#include "Thermistor.h"
+#include "libs/Kernel.h"
+#include "Adc.h"
+
+class ThermistorBench {
+    public:
+        // the EPCOS 100K with its table, as most hotends have
+        static Thermistor *thermistor()
+        {
+            static Thermistor *t= nullptr;
+            if(t == nullptr) {
+                t= new Thermistor();
+                t->set_optional({{'P', 1}});
+            }
+            return t;
+        }
+
+        // readings spread over most of the range of the Adc
+        static float convert(uint32_t ops, bool table)
+        {
+            Thermistor *t= thermistor();
+            uint32_t max= THEKERNEL->adc->get_max_value();
+            float sum= 0;
+            for (uint32_t i = 0; i < ops; i++) {
+                uint32_t adc= max / 64 + (i * 97) % (max * 15 / 16);
+                sum += table ? t->adc_value_to_temperature(adc) : t->calculate_temperature(adc);
+            }
+            return sum;
+        }
+};
+
+BENCH(thermistor_table, 2000) { bench_sink(ThermistorBench::convert(ops, true)); }
+BENCH(thermistor_calculate, 2000) { bench_sink(ThermistorBench::convert(ops, false)); }
+
+#endif
@@ -0,0 +1,80 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Bench.h"
+
+#include "StreamOutput.h"
+
+#ifdef SIMULATION
+#include "../sim/Sim.h"
+#else
+#include "LPC17xx.h"
+#endif
+
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+// constant initialised so benchmarks can be made by static constructors in any order
+Bench *Bench::first= nullptr;
+
+static volatile float float_sink;
+static volatile uint32_t uint_sink;
+void bench_sink(float v) { float_sink= v; }
+void bench_sink(uint32_t v) { uint_sink= v; }
+
+Bench::Bench(const char *name, func_t func, uint32_t ops, func_t reset) : name(name), func(func), reset(reset), ops(ops)
+{
+    next= first;
+    first= this;
+}
+
+// cycles or ns for all the ops, the best of the runs after one to warm the caches and fill the queues
+uint32_t Bench::time()
+{
+    if(reset != nullptr) reset(ops);
+    func(ops);
+    uint32_t best= UINT32_MAX;
+    for (int r = 0; r < runs; r++) {
+        if(reset != nullptr) reset(ops);
+#ifdef SIMULATION
+        uint64_t start= sim_now_ns();
+        func(ops);
+        uint32_t t= sim_now_ns() - start;
+#else
+        // taken with the interrupts on, so the best run is the one they missed
+        uint32_t start= DWT->CYCCNT;
+        func(ops);
+        uint32_t t= DWT->CYCCNT - start;
+#endif
+        if(t < best) best= t;
+    }
+    return best;
+}
+
+void Bench::run(const char *match, StreamOutput *stream)
+{
+#ifndef SIMULATION
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    const char *unit= "cycles/op";
+#else
+    const char *unit= "ns/op";
+#endif
+
+    std::vector<Bench*> all;
+    for(Bench *b= first; b != nullptr; b= b->next) {
+        if(strncmp(b->name, match, strlen(match)) == 0) all.push_back(b);
+    }
+    std::sort(all.begin(), all.end(), [](const Bench *a, const Bench *b) { return strcmp(a->name, b->name) < 0; });
+
+    stream->printf("%-32s %8s %12s\n", "benchmark", "ops", unit);
+    for(auto b : all) {
+        uint32_t t= b->time();
+        stream->printf("%-32s %8lu %12.1f\n", b->name, (unsigned long)b->ops, (float)t / b->ops);
+    }
+}
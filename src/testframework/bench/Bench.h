@@ -0,0 +1,51 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+class StreamOutput;
+
+// A benchmark runs an operation ops times, the table has the time of one operation from the fastest of a few runs, in
+// core cycles counted by the DWT on the board and in nanoseconds on the host. Each is made by a static constructor:
+//     BENCH(ringbuffer_push_pop, 1000) { for(uint32_t i= 0; i < ops; i++) ... }
+// A result that the compiler could see is unused should go to bench_sink() so the work is not optimised away.
+// BENCH_RESET(name, n, reset) calls reset(ops) before each run, untimed, to put back what a run used up.
+class Bench {
+    public:
+        typedef void (*func_t)(uint32_t ops);
+        Bench(const char *name, func_t func, uint32_t ops, func_t reset= nullptr);
+
+        // runs the ones whose name starts with match, all of them when it is empty, in the order of their names
+        static void run(const char *match, StreamOutput *stream);
+
+    private:
+        uint32_t time();
+
+        const char *name;
+        func_t func;
+        func_t reset;
+        uint32_t ops;
+        Bench *next;
+
+        static Bench *first;
+        static const int runs= 5;
+};
+
+void bench_sink(float v);
+void bench_sink(uint32_t v);
+
+#define BENCH_RESET(name, n, reset) \
+    static void bench_##name(uint32_t ops); \
+    static Bench bench_##name##_instance(#name, bench_##name, n, reset); \
+    static void bench_##name(uint32_t ops)
+
+#define BENCH(name, n) BENCH_RESET(name, n, nullptr)
+
+#endif
@@ -0,0 +1,44 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+Runs the benchmarks on the host with the kernel and motion modules of the simulator, made from the config file.
+    smoothiebench config [match]
+*/
+
+#include "Bench.h"
+#include "../sim/Sim.h"
+
+#include "libs/Kernel.h"
+#include "libs/StreamOutput.h"
+#include "libs/StreamOutputPool.h"
+
+#include <stdio.h>
+
+class StdoutStream : public StreamOutput {
+    public:
+        int puts(const char *str) { return fputs(str, stdout); }
+};
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: smoothiebench config [match]\n");
+        return 1;
+    }
+
+    StdoutStream out;
+    Kernel *kernel= new Kernel();
+    kernel->streams->append_stream(&out);
+    if(!sim_kernel_load(argv[1])) {
+        fprintf(stderr, "Config file not found: %s\n", argv[1]);
+        return 1;
+    }
+
+    Bench::run(argc == 3 ? argv[2] : "", &out);
+    return 0;
+}
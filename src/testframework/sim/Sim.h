@@ -0,0 +1,59 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// The host simulation runs the real motion code with a virtual StepTicker. Time only passes in the simulation when the
+// step interrupts are run, which happens while the firmware waits for the queue and for a set time after each line.
+
+// the virtual clock, in base stepping ticks since the simulation started
+uint64_t sim_get_ticks();
+
+// run the step, end of block and acceleration interrupts for n base stepping ticks
+void sim_run_ticks(uint32_t n);
+
+// writes the motors stepped and their directions at each tick any step, to compare with smoothie-steps.py
+bool sim_record_steps(const char *fn);
+void sim_record_step(uint8_t stepped, uint8_t dirs);
+void sim_stop_recording_steps();
+
+// host time spent running the interrupts, so it can be left out of the planning time
+uint64_t sim_get_interrupt_ns();
+
+// host time in nanoseconds
+uint64_t sim_now_ns();
+
+// host time spent in one part of the firmware, not counting the time in the parts it called that are timed as well
+struct sim_timing_t {
+    const char *group;                  // "event", "isr" or "function"
+    std::string name;
+    const void *fn;                     // the function when the name is looked up at the end
+    uint64_t ns;
+    uint64_t calls;
+    uint64_t max_ns;                    // 0 when calls are not timed one by one
+};
+
+sim_timing_t *sim_timing(const char *group, const std::string &name);
+void sim_timing_begin(sim_timing_t *t);
+void sim_timing_end();
+std::vector<sim_timing_t*> sim_get_timings();
+
+class SimScope {
+    public:
+        SimScope(sim_timing_t *t) { sim_timing_begin(t); }
+        ~SimScope() { sim_timing_end(); }
+};
+
+// set up the kernel and the motion modules from the config file
+bool sim_kernel_load(const char *config_file);
+
+#endif
@@ -0,0 +1,66 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+The parts of the mbed library and the LPC17xx the motion code uses, done on the host
+*/
+
+#include "Sim.h"
+#include "libs/Kernel.h"
+#include "LPC17xx.h"
+#include "us_ticker_api.h"
+#include "wait_api.h"
+#include "MRI_Hooks.h"
+#include "platform_memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+uint32_t SystemCoreClock= 100000000;
+
+LPC_GPIO_TypeDef sim_gpio[5];
+LPC_WDT_TypeDef sim_wdt;
+
+// the same size as the AHB banks on the LPC1768, so a config that fits here fits on the board
+static uint8_t ahb0_bank[16384] __attribute__ ((aligned (8)));
+static uint8_t ahb1_bank[16384] __attribute__ ((aligned (8)));
+static MemoryPool ahb0_pool(ahb0_bank, sizeof(ahb0_bank));
+static MemoryPool ahb1_pool(ahb1_bank, sizeof(ahb1_bank));
+MemoryPool *_AHB0= &ahb0_pool;
+MemoryPool *_AHB1= &ahb1_pool;
+
+uint64_t sim_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+extern "C" uint32_t us_ticker_read()
+{
+    return sim_now_ns() / 1000;
+}
+
+// the board sleeps until the next interrupt, here the interrupts of an acceleration tick are run
+extern "C" void __WFI(void)
+{
+    sim_run_ticks(THEKERNEL->base_stepping_frequency / THEKERNEL->acceleration_ticks_per_second);
+}
+
+extern "C" void wait(float s) {}
+extern "C" void wait_ms(int ms) {}
+extern "C" void wait_us(int us) {}
+
+extern "C" void NVIC_SystemReset()
+{
+    printf("System reset requested, ending the simulation\n");
+    exit(1);
+}
+
+extern "C" void set_high_on_debug(int port, int pin) {}
+extern "C" void set_low_on_debug(int port, int pin) {}
@@ -0,0 +1,194 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+The Kernel of the host simulation, it replaces libs/Kernel.cpp. Only the motion modules are loaded, and every event
+handler is timed. ON_IDLE is where the firmware waits for the queue, the interrupts run for an acceleration tick first.
+*/
+
+#include "Sim.h"
+
+#include "libs/Kernel.h"
+#include "libs/Module.h"
+#include "libs/Config.h"
+#include "libs/StreamOutputPool.h"
+#include "libs/StepTicker.h"
+#include "libs/ConfigSources/FileConfigSource.h"
+#include "libs/LatencyStats.h"
+#include "checksumm.h"
+#include "ConfigValue.h"
+#include "utils.h"
+
+#include "modules/communication/GcodeDispatch.h"
+#include "modules/robot/Planner.h"
+#include "modules/robot/Robot.h"
+#include "modules/robot/Stepper.h"
+#include "modules/robot/Conveyor.h"
+#include "SimpleShell.h"
+
+#include <string>
+
+#define base_stepping_frequency_checksum            CHECKSUM("base_stepping_frequency")
+#define acceleration_ticks_per_second_checksum      CHECKSUM("acceleration_ticks_per_second")
+#define scheduled_stepping_checksum                 CHECKSUM("scheduled_stepping")
+#define grbl_mode_checksum                          CHECKSUM("grbl_mode")
+#define ok_per_line_checksum                        CHECKSUM("ok_per_line")
+
+Kernel* Kernel::instance;
+
+// the timing of each handler, in the same order as the hooks
+static std::array<std::vector<sim_timing_t*>, NUMBER_OF_DEFINED_EVENTS> hook_timings;
+
+Kernel::Kernel(){
+    halted= false;
+    feed_hold= false;
+    use_leds= false;
+    grbl_mode= false;
+    ok_per_line= true;
+    instance= this;
+
+    this->serial= nullptr;
+    this->config= nullptr;
+    this->gcode_dispatch= nullptr;
+    this->robot= nullptr;
+    this->stepper= nullptr;
+    this->planner= nullptr;
+    this->conveyor= nullptr;
+    this->configurator= nullptr;
+    this->simpleshell= nullptr;
+    this->slow_ticker= nullptr;
+    this->adc= nullptr;
+    this->debug= 0;
+    this->config_load_us= 0;
+    this->boot_depth= 0;
+    this->running_module= nullptr;
+    this->running_event= 0;
+    this->latency= new LatencyStats();
+    this->input_arbiter= nullptr;
+
+    this->streams = new StreamOutputPool();
+    this->current_path= "/";
+    this->step_ticker = new StepTicker();
+}
+
+// load the motion modules the same way Kernel() does
+bool sim_kernel_load(const char *config_file)
+{
+    Kernel *k= THEKERNEL;
+    if(!file_exists(config_file)) return false;
+
+    k->config= new Config(new FileConfigSource(config_file, "sim"));
+    k->config->config_cache_load();
+
+    k->base_stepping_frequency = k->config->value(base_stepping_frequency_checksum)->by_default(100000)->as_number();
+    k->acceleration_ticks_per_second = k->config->value(acceleration_ticks_per_second_checksum)->by_default(1000)->as_number();
+    k->step_ticker->set_frequency( k->base_stepping_frequency );
+    k->step_ticker->set_acceleration_ticks_per_second(k->acceleration_ticks_per_second);
+    k->step_ticker->set_scheduled(k->config->value(scheduled_stepping_checksum)->by_default(false)->as_bool());
+
+    k->add_module( k->gcode_dispatch = new GcodeDispatch(), "gcodedispatch" );
+    k->add_module( k->robot          = new Robot(),         "robot" );
+    k->add_module( k->stepper        = new Stepper(),       "stepper" );
+    k->add_module( k->conveyor       = new Conveyor(),      "conveyor" );
+    k->planner = new Planner();
+
+    k->config->config_cache_clear();
+    k->step_ticker->start();
+    return true;
+}
+
+void Kernel::add_module(Module* module, const char *name){
+    boot_times.push_back({module, name, 0, 0});
+    module->on_module_loaded();
+}
+
+void Kernel::register_for_event(_EVENT_ENUM id_event, Module *mod){
+    const char *name= get_module_name(mod);
+    if(name == nullptr) name= "?";
+    this->hooks[id_event].push_back({mod, 0, 0, 0, 0, false, false, PRIORITY_NORMAL});
+    hook_timings[id_event].push_back(sim_timing("event", std::string(kernel_event_names[id_event]) + " " + name));
+}
+
+void Kernel::call_event(_EVENT_ENUM id_event, void * argument){
+    if(id_event == ON_HALT) {
+        this->halted= (argument == nullptr);
+    }
+    if(id_event == ON_IDLE) {
+        sim_run_ticks(THEKERNEL->base_stepping_frequency / THEKERNEL->acceleration_ticks_per_second);
+    }
+    for (size_t i = 0; i < hooks[id_event].size(); ++i) {
+        SimScope s(hook_timings[id_event][i]);
+        (hooks[id_event][i].module->*kernel_callback_functions[id_event])(argument);
+        ++hooks[id_event][i].calls;
+    }
+}
+
+bool Kernel::kernel_has_event(_EVENT_ENUM id_event, Module *mod)
+{
+    for (auto &h : hooks[id_event]) {
+        if(h.module == mod) return true;
+    }
+    return false;
+}
+
+void Kernel::unregister_for_event(_EVENT_ENUM id_event, Module *mod)
+{
+    for (size_t i = 0; i < hooks[id_event].size(); ++i) {
+        if(hooks[id_event][i].module == mod) {
+            hooks[id_event].erase(hooks[id_event].begin() + i);
+            hook_timings[id_event].erase(hook_timings[id_event].begin() + i);
+            return;
+        }
+    }
+}
+
+// nothing adds an input check, the simulation reports the queue depth itself
+bool Kernel::is_input_pending() const
+{
+    for (auto &c : input_checks) {
+        if(c()) return true;
+    }
+    return false;
+}
+
+const char *Kernel::get_module_name(const Module *module) const
+{
+    for (auto &b : boot_times) {
+        if(b.module == module) return b.name;
+    }
+    return nullptr;
+}
+
+// there is no host time to rate limit by, the handlers are called every time
+void Kernel::set_event_rate(_EVENT_ENUM id_event, Module *mod, uint16_t interval_ms, bool wake_only)
+{
+}
+
+void Kernel::wake_for_event(_EVENT_ENUM id_event, Module *mod)
+{
+}
+
+// the handler timings are kept in the same order as the hooks, so they are left as they registered
+void Kernel::set_event_priority(_EVENT_ENUM id_event, Module *mod, EVENT_PRIORITY priority)
+{
+}
+
+// the timings are in the simulation report instead
+std::vector<Kernel::event_profile_t> Kernel::get_event_profile() const
+{
+    return std::vector<event_profile_t>();
+}
+
+void Kernel::reset_event_profile()
+{
+}
+
+// GcodeDispatch hands M1000 lines to the shell, which is not part of the simulation
+bool SimpleShell::parse_command(const char *cmd, const char *args, StreamOutput *stream)
+{
+    return false;
+}
@@ -0,0 +1,222 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+Replays a gcode file through GcodeDispatch, Robot, Planner, Conveyor and Stepper on the host, then reports the planning
+throughput, the time the job would take, how full the queue was and where the host time went.
+    smoothiesim [-v] [-c us] [-q queue.csv] [-s file.steps] [-n rows] config file.gcode
+*/
+
+#include "Sim.h"
+
+#include "libs/Kernel.h"
+#include "libs/Module.h"
+#include "libs/SerialMessage.h"
+#include "libs/StreamOutput.h"
+#include "libs/StreamOutputPool.h"
+#include "modules/robot/Robot.h"
+#include "modules/robot/Conveyor.h"
+#include "modules/robot/Block.h"
+#include "LineReader.h"
+#include "JobEstimate.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+
+class StdoutStream : public StreamOutput {
+    public:
+        int puts(const char *str) { return fputs(str, stdout); }
+};
+
+// counts the blocks and samples the queue depth as each one finishes
+class SimMonitor : public Module {
+    public:
+        SimMonitor(FILE *csv) : csv(csv), blocks(0), moves(0), planned_seconds(0) {}
+
+        void on_module_loaded()
+        {
+            register_for_event(ON_BLOCK_BEGIN);
+            register_for_event(ON_BLOCK_END);
+            if(csv != nullptr) fprintf(csv, "seconds,depth\n");
+        }
+
+        void on_block_begin(void *argument)
+        {
+            Block *block= static_cast<Block*>(argument);
+            ++blocks;
+            if(block->steps_event_count > 0) ++moves;
+            planned_seconds += (block->steps_event_count == 0) ? block->dwell_ms / 1000.0 : block->seconds;
+        }
+
+        void on_block_end(void *argument)
+        {
+            unsigned int depth= THEKERNEL->conveyor->queue_depth();
+            if(depth >= depths.size()) depths.resize(depth + 1);
+            ++depths[depth];
+            if(csv != nullptr) fprintf(csv, "%1.4f,%u\n", (double)sim_get_ticks() / THEKERNEL->base_stepping_frequency, depth);
+        }
+
+        FILE *csv;
+        uint32_t blocks;
+        uint32_t moves;
+        double planned_seconds;             // the sum of Block::seconds as each block started
+        std::vector<uint32_t> depths;       // how many blocks finished with each queue depth
+};
+
+static void usage()
+{
+    fprintf(stderr, "usage: smoothiesim [-v] [-c us] [-q queue.csv] [-s file.steps] [-n rows] config file.gcode\n"
+            " -v    echo the replies to each line\n"
+            " -c    simulated time taken by the firmware for each line in us, default 0 plans infinitely fast\n"
+            " -q    write the queue depth at the end of each block to a csv file\n"
+            " -s    record the ticks each motor steps at, to compare with smoothie-steps.py\n"
+            " -n    number of rows in the timing report, default 30\n");
+    exit(1);
+}
+
+static void print_timings(unsigned int rows, uint64_t total_ns)
+{
+    std::vector<sim_timing_t*> timings= sim_get_timings();
+    std::sort(timings.begin(), timings.end(), [](sim_timing_t *a, sim_timing_t *b) { return a->ns > b->ns; });
+
+    printf("\nHost time by part, not counting the timed parts it calls:\n");
+    printf("  %10s %6s %12s %10s %10s  %s\n", "ms", "%", "calls", "avg ns", "max ns", "part");
+    for (size_t i = 0; i < timings.size() && i < rows; ++i) {
+        sim_timing_t *t= timings[i];
+        if(t->calls == 0) continue;
+        char max[24]= "-";
+        if(t->max_ns != 0) snprintf(max, sizeof(max), "%llu", (unsigned long long)t->max_ns);
+        printf("  %10.3f %6.2f %12llu %10.1f %10s  %s %s\n", t->ns / 1e6, 100.0 * t->ns / total_ns, (unsigned long long)t->calls,
+               (double)t->ns / t->calls, max, t->group, t->name.c_str());
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bool verbose= false;
+    uint32_t us_per_line= 0;
+    unsigned int rows= 30;
+    FILE *csv= nullptr;
+    const char *steps_file= nullptr;
+    int c;
+
+    while((c= getopt(argc, argv, "vc:q:n:s:")) != -1) {
+        switch(c) {
+            case 's': steps_file= optarg; break;
+            case 'v': verbose= true; break;
+            case 'c': us_per_line= strtoul(optarg, nullptr, 10); break;
+            case 'n': rows= strtoul(optarg, nullptr, 10); break;
+            case 'q':
+                csv= fopen(optarg, "w");
+                if(csv == nullptr) {
+                    fprintf(stderr, "Could not create %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default: usage();
+        }
+    }
+    if(argc - optind != 2) usage();
+    const char *config_file= argv[optind];
+    const char *gcode_file= argv[optind + 1];
+
+    StdoutStream out;
+    Kernel *kernel= new Kernel();
+    kernel->streams->append_stream(&out);
+    if(!sim_kernel_load(config_file)) {
+        fprintf(stderr, "Config file not found: %s\n", config_file);
+        return 1;
+    }
+    if(steps_file != nullptr && !sim_record_steps(steps_file)) {
+        fprintf(stderr, "Could not create %s\n", steps_file);
+        return 1;
+    }
+    SimMonitor *monitor= new SimMonitor(csv);
+    kernel->add_module(monitor, "sim");
+
+    FILE *fp= fopen(gcode_file, "r");
+    if(fp == nullptr) {
+        fprintf(stderr, "File not found: %s\n", gcode_file);
+        return 1;
+    }
+
+    // the estimate Player makes by scanning the file, from the same start
+    JobEstimate estimate;
+    estimate.start(gcode_file, 0);
+    uint64_t estimate_start= sim_now_ns();
+    while(estimate.is_scanning()) estimate.scan(UINT32_MAX);
+    uint64_t estimate_ns= sim_now_ns() - estimate_start;
+
+    // the same loop as Player streaming the file, one line per main loop
+    StreamOutput *replies= verbose ? static_cast<StreamOutput*>(&out) : &(StreamOutput::NullStream);
+    uint32_t ticks_per_line= (uint64_t)us_per_line * kernel->base_stepping_frequency / 1000000;
+    LineReader reader;
+    reader.start(fp);
+    const char *line;
+    size_t len;
+    bool discarded;
+    unsigned int lines= 0;
+
+    uint64_t start= sim_now_ns();
+    while(reader.next_line(line, len, discarded)) {
+        if(discarded) printf("Warning: Discarded long line\n");
+        if(len == 1 && line[0] == '\n') continue;
+
+        struct SerialMessage message;
+        message.message.assign(line, len);
+        message.stream= replies;
+        if(verbose) printf("%s", message.message.c_str());
+        kernel->call_event(ON_CONSOLE_LINE_RECEIVED, &message);
+        kernel->call_event(ON_MAIN_LOOP);
+        if(ticks_per_line > 0) sim_run_ticks(ticks_per_line);
+        ++lines;
+        if(kernel->is_halted()) {
+            printf("Halted at line %u\n", lines);
+            break;
+        }
+    }
+    reader.stop();
+    fclose(fp);
+
+    // push whatever is held back and run the queue dry
+    kernel->robot->flush_pending_move();
+    kernel->call_event(ON_MAIN_LOOP);
+    kernel->conveyor->wait_for_empty_queue();
+    uint64_t total_ns= sim_now_ns() - start;
+    if(csv != nullptr) fclose(csv);
+    sim_stop_recording_steps();
+
+    uint64_t planning_ns= total_ns - sim_get_interrupt_ns();
+    double seconds= (double)sim_get_ticks() / kernel->base_stepping_frequency;
+    printf("\nReplayed %s: %u lines, %u blocks, %u of them moves\n", gcode_file, lines, monitor->blocks, monitor->moves);
+    printf("Planning: %1.3f ms of host time, %1.0f blocks/s, %1.0f lines/s\n", planning_ns / 1e6,
+           monitor->blocks * 1e9 / planning_ns, lines * 1e9 / planning_ns);
+    printf("Stepping: %1.3f ms of host time to run the interrupts\n", sim_get_interrupt_ns() / 1e6);
+    printf("Predicted print time: %d:%02d:%06.3f (%1.3f s)\n", (int)(seconds / 3600), ((int)seconds / 60) % 60,
+           seconds - 60 * (int)(seconds / 60), seconds);
+    printf("Planned block times: %1.3f s (%+1.2f%%)\n", monitor->planned_seconds, 100.0 * (monitor->planned_seconds - seconds) / seconds);
+    printf("File scan estimate: %1.3f s (%+1.2f%%), %1.3f ms of host time\n", estimate.get_total_seconds(),
+           100.0 * (estimate.get_total_seconds() - seconds) / seconds, estimate_ns / 1e6);
+
+    printf("\nQueue ");
+    kernel->conveyor->print_queue_stats(&out);
+    uint32_t total= 0;
+    for(auto n : monitor->depths) total += n;
+    if(total > 0) {
+        printf("Queue depth as each block finished:\n");
+        for (size_t i = 0; i < monitor->depths.size(); ++i) {
+            if(monitor->depths[i] == 0) continue;
+            printf("  %3u: %6.2f%% %s\n", (unsigned int)i, 100.0 * monitor->depths[i] / total,
+                   std::string((size_t)(50.0 * monitor->depths[i] / total + 0.5), '#').c_str());
+        }
+    }
+
+    print_timings(rows, total_ns);
+    return 0;
+}
@@ -0,0 +1,66 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+Pins for the host simulation, it replaces libs/Pin.cpp. The ports are plain memory so stepping a pin costs about what
+it does on the board, the pin modes have no effect and there is no pwm or pin interrupt.
+*/
+
+#include "Pin.h"
+
+#include <stdlib.h>
+
+Pin::Pin(){
+    this->inverting= false;
+    this->valid= false;
+    this->pin= 32;
+    this->port= nullptr;
+}
+
+// same syntax as on the board, only the inverting modifier does anything
+Pin* Pin::from_string(std::string value){
+    LPC_GPIO_TypeDef* gpios[5] ={LPC_GPIO0,LPC_GPIO1,LPC_GPIO2,LPC_GPIO3,LPC_GPIO4};
+    const char* cs = value.c_str();
+    char* cn = NULL;
+
+    this->valid= false;
+    this->inverting= false;
+    this->port_number = strtol(cs, &cn, 10);
+    if (value != "nc" && cn > cs && port_number >= 0 && port_number <= 4 && *cn == '.'){
+        cs = ++cn;
+        this->pin = strtol(cs, &cn, 10);
+        if (cn > cs && pin < 32){
+            this->port = gpios[(unsigned int) this->port_number];
+            this->valid= true;
+            for (;*cn;cn++) {
+                if(*cn == '!') this->inverting = true;
+            }
+            return this;
+        }
+    }
+
+    port_number = 0;
+    port = gpios[0];
+    pin = 32;
+    return this;
+}
+
+Pin* Pin::as_open_drain() { return this; }
+Pin* Pin::as_repeater() { return this; }
+Pin* Pin::pull_up() { return this; }
+Pin* Pin::pull_down() { return this; }
+Pin* Pin::pull_none() { return this; }
+
+mbed::PwmOut* Pin::hardware_pwm()
+{
+    return nullptr;
+}
+
+mbed::InterruptIn* Pin::interrupt_pin()
+{
+    return nullptr;
+}
@@ -0,0 +1,450 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+A virtual StepTicker for the host simulation, it replaces libs/StepTicker.cpp.
+The timers are counters advanced by sim_run_ticks(), which runs the interrupts in the order they run on the board:
+TIMER0 steps the motors, PendSV follows it when a move finished, TIMER1 unsteps and the RIT does the acceleration.
+*/
+
+#include "StepTicker.h"
+#include "Sim.h"
+
+#include "libs/Kernel.h"
+#include "StepperMotor.h"
+#include "StreamOutput.h"
+
+#include <math.h>
+#include <string.h>
+#include <mri.h>
+
+StepTicker* StepTicker::global_step_ticker;
+
+// the virtual timers, there is only one StepTicker
+static uint64_t ticks;                      // base stepping ticks since the start
+static uint32_t rit_period;                 // base stepping ticks per acceleration tick
+static uint32_t rit_counter;
+static bool rit_pending;
+static bool timer0_enabled;
+static uint32_t timer0_counter;             // ticks since TIMER0 last fired
+static uint32_t timer0_skip= 1;             // it fires when the counter gets to this, StepTicker::skip
+static bool pendsv_pending;
+static uint64_t interrupt_ns;
+
+static sim_timing_t *timer0_timing;
+static sim_timing_t *pendsv_timing;
+static sim_timing_t *rit_timing;
+static FILE *step_file;                     // the steps are recorded to, see sim_record_steps()
+static uint64_t step_file_tick;             // of the last steps recorded
+
+StepTicker::StepTicker(){
+    StepTicker::global_step_ticker = this;
+
+    // Default start values
+    this->a_move_finished = false;
+    this->step_hook_mask = 0;
+    this->handoff_wait= this->handoff_start= 0;
+    this->handoff_done= false;
+    this->lead= nullptr;
+    this->follow_mask= this->lead_mask= 0;
+    this->num_acceleration_tick_handlers= 0;
+    this->acceleration_tick_mask= 0;
+    this->do_move_finished = 0;
+    this->skip= 1;
+    this->max_skip= 1;
+    this->scheduled= false;
+    this->num_pin_groups= 0;
+    memset(this->pin_group, 0, sizeof(this->pin_group));
+    memset(this->pulse, 0, sizeof(this->pulse));
+    memset((void*)this->unstep, 0, sizeof(this->unstep));
+    this->set_frequency(100000);
+    this->set_reset_delay(100);
+    this->set_acceleration_ticks_per_second(1000);
+    this->num_motors= 0;
+    this->active_motor= 0;
+    this->steps_held= false;
+    memset(this->motor, 0, sizeof(this->motor));
+    this->tick_cnt= 0;
+
+    timer0_timing= sim_timing("isr", "StepTicker::TIMER0_IRQHandler");
+    pendsv_timing= sim_timing("isr", "StepTicker::PendSV_IRQHandler");
+    rit_timing= sim_timing("isr", "StepTicker::acceleration_tick");
+}
+
+StepTicker::~StepTicker() {
+}
+
+void StepTicker::start() {
+}
+
+void StepTicker::set_frequency( float frequency ){
+    this->frequency = frequency;
+    this->period = floorf((SystemCoreClock/4.0F)/frequency);
+    this->skip= timer0_skip= 1;
+}
+
+// the step pulse is ended at the end of the tick it started in
+void StepTicker::set_reset_delay( float microseconds ){
+}
+
+// this is the number of acceleration ticks per second, must be set after set_frequency
+void StepTicker::set_acceleration_ticks_per_second(uint32_t acceleration_ticks_per_second) {
+    rit_period= roundf(this->frequency / acceleration_ticks_per_second);
+    if(rit_period == 0) rit_period= 1;
+    rit_counter= 0;
+    this->max_skip= rit_period;
+}
+
+void StepTicker::synchronize_acceleration(bool fire_now) {
+    rit_counter= 0;
+    rit_pending= fire_now;
+}
+
+// see StepTicker.cpp
+void StepTicker::signal_a_move_finished(){
+    uint32_t bits= this->active_motor;
+    while(bits != 0) {
+        uint32_t m= __builtin_ctz(bits);
+        bits &= bits - 1;
+        if (this->motor[m]->is_move_finished){
+            this->motor[m]->signal_move_finished();
+        }
+    }
+}
+
+void StepTicker::unstep_tick(){
+    for (uint8_t g = 0; g < this->num_pin_groups; ++g) {
+        uint32_t pins= this->unstep[g];
+        if(pins == 0) continue;
+        if(this->pin_group[g].inverting) this->pin_group[g].port->FIOSET= pins;
+        else this->pin_group[g].port->FIOCLR= pins;
+        this->unstep[g]= 0;
+    }
+}
+
+// see StepTicker.cpp
+void StepTicker::handoff(){
+    uint32_t bits= this->handoff_wait;
+    while(bits != 0) {
+        uint32_t m= __builtin_ctz(bits);
+        bits &= bits - 1;
+        StepperMotor *a= this->motor[m];
+        if(a->force_finish) {
+            this->handoff_start= 0;
+            return;
+        }
+        if(a->moving && !a->is_move_finished) return;
+    }
+
+    bits= this->handoff_start;
+    this->handoff_start= 0;
+    while(bits != 0) {
+        uint32_t m= __builtin_ctz(bits);
+        bits &= bits - 1;
+        this->motor[m]->start_next_move();
+    }
+    this->handoff_done= true;
+}
+
+// see StepTicker.cpp
+void StepTicker::set_followers(StepperMotor *lead, uint32_t mask)
+{
+    for(uint32_t bits= this->follow_mask; bits != 0; bits &= bits - 1) this->motor[__builtin_ctz(bits)]->follow_lead= nullptr;
+    this->follow_mask= 0;
+    this->lead= lead;
+    if(lead == nullptr || mask == 0) return;
+
+    for(uint32_t bits= mask; bits != 0; bits &= bits - 1) {
+        StepperMotor *f= this->motor[__builtin_ctz(bits)];
+        f->follow_error= lead->steps_to_move / 2;
+        f->follow_lead= lead;
+    }
+    this->lead_mask= 1 << lead->index;
+    this->follow_mask= mask;
+}
+
+// see StepTicker.cpp
+uint32_t StepTicker::step_followers()
+{
+    uint32_t stepped= 0;
+    uint32_t lead_steps= this->lead->steps_to_move;
+    for(uint32_t bits= this->follow_mask & this->active_motor; bits != 0; bits &= bits - 1) {
+        uint32_t m= __builtin_ctz(bits);
+        StepperMotor *f= this->motor[m];
+        if(!f->force_finish) {
+            f->follow_error += f->steps_to_move;
+            if(f->follow_error < lead_steps) continue;
+            f->follow_error -= lead_steps;
+        }
+        if(f->step()) {
+            stepped |= (1 << m);
+            this->pulse[this->step_group[m]] |= this->step_bit[m];
+        }
+    }
+    return stepped;
+}
+
+void StepTicker::PendSV_IRQHandler (void) {
+    if(this->handoff_done) {
+        this->handoff_done= false;
+        this->handoff_hook();
+    }
+    if(this->do_move_finished.load() > 0) {
+        this->do_move_finished--;
+        this->signal_a_move_finished();
+    }
+    this->reschedule();
+}
+
+// the handlers are timed by the simulation instead of the cycle profile
+uint8_t StepTicker::register_acceleration_tick_handler(acceleration_tick_fn fn, void *context, const char *name, bool enabled)
+{
+    if(this->num_acceleration_tick_handlers >= max_acceleration_tick_handlers) {
+        __debugbreak();
+        return max_acceleration_tick_handlers - 1;
+    }
+    uint8_t id= this->num_acceleration_tick_handlers++;
+    this->acceleration_tick_handlers[id]= {fn, context, nullptr};
+    enable_acceleration_tick_handler(id, enabled);
+    return id;
+}
+
+void StepTicker::enable_acceleration_tick_handler(uint8_t id, bool on)
+{
+    if(on) this->acceleration_tick_mask |= (1 << id);
+    else this->acceleration_tick_mask &= ~(1 << id);
+}
+
+void StepTicker::acceleration_tick() {
+    for (uint32_t bits= this->acceleration_tick_mask; bits != 0; bits &= bits - 1) {
+        acceleration_tick_handler_t &h= this->acceleration_tick_handlers[__builtin_ctz(bits)];
+        h.fn(h.context);
+    }
+}
+
+void StepTicker::TIMER0_IRQHandler (void){
+    uint32_t ticks= this->skip;
+    tick_cnt += ticks;
+
+    uint32_t bits= this->steps_held ? 0 : this->active_motor & ~this->follow_mask;
+    if(ticks > 1) {
+        uint32_t fx_skipped= (ticks - 1) << StepperMotor::fx_shift;
+        for(uint32_t b= bits; b != 0; b &= b - 1) this->motor[__builtin_ctz(b)]->fx_counter += fx_skipped;
+    }
+    uint32_t stepped= 0;
+    while(bits != 0) {
+        uint32_t m= __builtin_ctz(bits);
+        bits &= bits - 1;
+        if(this->motor[m]->tick()){
+            stepped |= (1 << m);
+            this->pulse[this->step_group[m]] |= this->step_bit[m];
+        }
+    }
+    if(this->follow_mask != 0 && !this->steps_held && ((stepped & this->lead_mask) != 0 || this->lead->force_finish)) {
+        stepped |= step_followers();
+    }
+
+    if(stepped != 0 && step_file != nullptr) {
+        uint8_t dirs= 0;
+        for(uint32_t b= stepped; b != 0; b &= b - 1) {
+            uint32_t m= __builtin_ctz(b);
+            if(this->motor[m]->direction) dirs |= 1 << m;
+        }
+        sim_record_step(stepped, dirs);
+    }
+
+    if(stepped != 0) {
+        for (uint8_t g = 0; g < this->num_pin_groups; ++g) {
+            uint32_t pins= this->pulse[g];
+            if(pins == 0) continue;
+            if(this->pin_group[g].inverting) this->pin_group[g].port->FIOCLR= pins;
+            else this->pin_group[g].port->FIOSET= pins;
+            this->unstep[g] |= pins;
+            this->pulse[g]= 0;
+        }
+    }
+
+    if((stepped & this->step_hook_mask) != 0) {
+        this->step_hook();
+    }
+
+    if(this->a_move_finished) {
+        this->a_move_finished= false;
+        if(this->handoff_start != 0) this->handoff();
+        this->do_move_finished++;
+    }
+
+    if(this->do_move_finished.load() > 0){
+        pendsv_pending= true;
+    }
+
+    if(this->scheduled) schedule_next();
+}
+
+// see StepTicker.cpp
+void StepTicker::schedule_next()
+{
+    uint32_t ticks= this->max_skip;
+    if(this->do_move_finished.load() > 0 || this->a_move_finished) {
+        ticks= 1;
+
+    } else if(!this->steps_held) {
+        for(uint32_t bits= this->active_motor & ~this->follow_mask; bits != 0 && ticks > 1; bits &= bits - 1) {
+            StepperMotor *a= this->motor[__builtin_ctz(bits)];
+            if(a->is_move_finished || a->force_finish || a->fx_counter >= a->fx_ticks_per_step) {
+                ticks= 1;
+                break;
+            }
+            uint32_t n= ((a->fx_ticks_per_step - a->fx_counter - 1) >> StepperMotor::fx_shift) + 1;
+            if(n < ticks) ticks= n;
+        }
+    }
+    this->skip= timer0_skip= ticks;
+}
+
+// the wait is cut short to the tick after this one, as TIMER0 counts them
+void StepTicker::reschedule()
+{
+    if(this->scheduled && this->skip > timer0_counter + 1) this->skip= timer0_skip= timer0_counter + 1;
+}
+
+int StepTicker::register_motor(StepperMotor* motor)
+{
+    if(this->num_motors >= max_motors) {
+        __debugbreak();
+        return this->num_motors-1;
+    }
+    this->motor[this->num_motors]= motor;
+    add_step_pin(this->num_motors);
+    return this->num_motors++;
+}
+
+// see StepTicker.cpp
+void StepTicker::add_step_pin(uint8_t m)
+{
+    Pin &pin= this->motor[m]->step_pin;
+    this->step_group[m]= 0;
+    this->step_bit[m]= 0;
+    if(!pin.connected()) return;
+
+    uint8_t g= 0;
+    while(g < this->num_pin_groups && !(this->pin_group[g].port == pin.port && this->pin_group[g].inverting == pin.is_inverting())) ++g;
+    if(g == this->num_pin_groups) {
+        if(g == max_pin_groups) return;
+        this->pin_group[g].port= pin.port;
+        this->pin_group[g].inverting= pin.is_inverting();
+        this->num_pin_groups++;
+    }
+    this->step_group[m]= g;
+    this->step_bit[m]= 1 << pin.pin;
+}
+
+void StepTicker::add_motor_to_active_list(StepperMotor* motor)
+{
+    if(active_motor == 0) {
+        this->skip= timer0_skip= 1;
+        timer0_counter= 0;
+    }
+    active_motor |= (1 << motor->index);
+    timer0_enabled= true;
+}
+
+void StepTicker::set_step_hook_motor(StepperMotor* motor)
+{
+    this->step_hook_mask = (motor == nullptr) ? 0 : (1 << motor->index);
+}
+
+void StepTicker::remove_motor_from_active_list(StepperMotor* motor)
+{
+    active_motor &= ~(1 << motor->index);
+    if(this->active_motor == 0){
+        timer0_enabled= false;
+        tick_cnt= 0;
+    }
+}
+
+uint64_t sim_get_ticks()
+{
+    return ticks;
+}
+
+bool sim_record_steps(const char *fn)
+{
+    step_file= fopen(fn, "wb");
+    if(step_file == nullptr) return false;
+    StepTicker *st= StepTicker::global_step_ticker;
+    uint32_t frequency= THEKERNEL->base_stepping_frequency;
+    fwrite("SMSTEPS1", 1, 8, step_file);
+    fwrite(&frequency, sizeof(frequency), 1, step_file);
+    fputc(st->get_num_motors(), step_file);
+    step_file_tick= 0;
+    return true;
+}
+
+void sim_record_step(uint8_t stepped, uint8_t dirs)
+{
+    // the ticks since the last ones as 7 bits a byte, then the motors that stepped and their directions
+    uint64_t dt= ticks - step_file_tick;
+    step_file_tick= ticks;
+    while(dt >= 0x80) {
+        fputc((dt & 0x7F) | 0x80, step_file);
+        dt >>= 7;
+    }
+    fputc(dt, step_file);
+    fputc(stepped, step_file);
+    fputc(dirs, step_file);
+}
+
+void sim_stop_recording_steps()
+{
+    if(step_file == nullptr) return;
+    fclose(step_file);
+    step_file= nullptr;
+}
+
+uint64_t sim_get_interrupt_ns()
+{
+    return interrupt_ns;
+}
+
+// TIMER0 is charged the time of the whole loop less the other interrupts, it is too short to time every tick
+void sim_run_ticks(uint32_t n)
+{
+    StepTicker *st= StepTicker::global_step_ticker;
+    uint64_t start= sim_now_ns();
+    uint32_t steps= 0;
+
+    sim_timing_begin(timer0_timing);
+    for (uint32_t i = 0; i < n; ++i) {
+        ++ticks;
+        if(timer0_enabled && ++timer0_counter >= timer0_skip) {
+            timer0_counter= 0;
+            st->TIMER0_IRQHandler();
+            ++steps;
+        }
+        if(pendsv_pending) {
+            pendsv_pending= false;
+            SimScope s(pendsv_timing);
+            st->PendSV_IRQHandler();
+        }
+        st->unstep_tick();
+
+        if(++rit_counter >= rit_period || rit_pending) {
+            rit_counter= 0;
+            rit_pending= false;
+            SimScope s(rit_timing);
+            st->acceleration_tick();
+            st->reschedule();
+        }
+    }
+    sim_timing_end();
+    // the loop counted as one call
+    timer0_timing->calls= timer0_timing->calls - 1 + steps;
+    timer0_timing->max_ns= 0;
+
+    interrupt_ns += sim_now_ns() - start;
+}
@@ -0,0 +1,110 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+Host timing of the event handlers, the interrupts and with SIM_PROFILE every function of the motion code.
+Each part is charged its own time, the time in the timed parts it calls is taken off.
+*/
+
+#include "Sim.h"
+
+#include <map>
+#include <unordered_map>
+
+#ifdef SIM_PROFILE
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <stdlib.h>
+#endif
+
+struct frame_t {
+    sim_timing_t *t;
+    uint64_t start;
+    uint64_t child_ns;                  // time taken by the timed parts called from this one
+};
+
+static std::vector<frame_t> stack;
+static std::map<std::string, sim_timing_t*> timings;
+
+sim_timing_t *sim_timing(const char *group, const std::string &name)
+{
+    std::string key= std::string(group) + " " + name;
+    auto i= timings.find(key);
+    if(i != timings.end()) return i->second;
+
+    sim_timing_t *t= new sim_timing_t{group, name, nullptr, 0, 0, 0};
+    timings[key]= t;
+    return t;
+}
+
+void sim_timing_begin(sim_timing_t *t)
+{
+    stack.push_back({t, sim_now_ns(), 0});
+}
+
+void sim_timing_end()
+{
+    uint64_t elapsed= sim_now_ns() - stack.back().start;
+    frame_t &f= stack.back();
+    uint64_t self= elapsed - f.child_ns;
+    f.t->ns += self;
+    f.t->calls++;
+    if(self > f.t->max_ns) f.t->max_ns= self;
+    stack.pop_back();
+
+    if(!stack.empty()) stack.back().child_ns += elapsed;
+}
+
+#ifdef SIM_PROFILE
+// the motion code is built with -finstrument-functions, these are called on the way in and out of every function
+static std::unordered_map<void*, sim_timing_t*> functions;
+
+extern "C" __attribute__((no_instrument_function)) void __cyg_profile_func_enter(void *fn, void *call_site)
+{
+    sim_timing_t *&t= functions[fn];
+    if(t == nullptr) {
+        t= new sim_timing_t{"function", "", fn, 0, 0, 0};
+    }
+    sim_timing_begin(t);
+}
+
+extern "C" __attribute__((no_instrument_function)) void __cyg_profile_func_exit(void *fn, void *call_site)
+{
+    sim_timing_end();
+}
+
+// name the function from the symbols exported with -rdynamic, or by its address if it has none
+static void name_function(sim_timing_t *t)
+{
+    Dl_info info;
+    char buf[32];
+    if(dladdr(t->fn, &info) != 0 && info.dli_sname != nullptr) {
+        int status;
+        char *demangled= abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        t->name= (status == 0) ? demangled : info.dli_sname;
+        free(demangled);
+    } else {
+        snprintf(buf, sizeof(buf), "%p", t->fn);
+        t->name= buf;
+    }
+}
+#endif
+
+std::vector<sim_timing_t*> sim_get_timings()
+{
+    std::vector<sim_timing_t*> v;
+    for(auto &i : timings) {
+        v.push_back(i.second);
+    }
+#ifdef SIM_PROFILE
+    for(auto &i : functions) {
+        if(i.second->name.empty()) name_function(i.second);
+        v.push_back(i.second);
+    }
+#endif
+    return v;
+}
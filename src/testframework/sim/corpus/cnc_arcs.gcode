@@ -0,0 +1,30 @@
+; cnc arcs: circles and slots cut with G2 and G3, plunges in Z, and a helix
+G21
+G90
+G17
+G0 Z5
+G0 X20 Y20
+G1 Z-0.5 F300
+G2 X20 Y20 I5 J0 F900
+G3 X30 Y20 I5 J0
+G1 X40 Y20 F900
+G2 X40 Y30 I0 J5
+G1 X30 Y30
+G3 X30 Y20 I0 J-5
+G0 Z5
+G0 X20 Y20
+G1 Z-1.0 F300
+G2 X20 Y20 I5 J0 F900
+G3 X30 Y20 I5 J0
+G1 X40 Y20 F900
+G2 X40 Y30 I0 J5
+G1 X30 Y30
+G3 X30 Y20 I0 J-5
+G0 Z5
+G0 X20 Y20
+G0 X50 Y20
+G1 Z0 F300
+G2 X50 Y20 Z-1 I5 J0 F600
+G2 X50 Y20 Z-2 I5 J0
+G0 Z5
+G0 X0 Y0
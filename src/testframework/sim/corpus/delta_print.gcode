@@ -0,0 +1,604 @@
+; delta print: perimeters of a 30mm round part, a layer at a time
+G21
+G90
+M83
+G92 E0
+G1 Z5 F3000
+G1 X15 Y0 Z0.3 F6000
+G1 X15.000 Y0 Z0.30 F6000
+G1 X14.943 Y1.307 E0.0340 F2400
+G1 X14.772 Y2.605 E0.0340 F2400
+G1 X14.489 Y3.882 E0.0340 F2400
+G1 X14.095 Y5.130 E0.0340 F2400
+G1 X13.595 Y6.339 E0.0340 F2400
+G1 X12.990 Y7.500 E0.0340 F2400
+G1 X12.287 Y8.604 E0.0340 F2400
+G1 X11.491 Y9.642 E0.0340 F2400
+G1 X10.607 Y10.607 E0.0340 F2400
+G1 X9.642 Y11.491 E0.0340 F2400
+G1 X8.604 Y12.287 E0.0340 F2400
+G1 X7.500 Y12.990 E0.0340 F2400
+G1 X6.339 Y13.595 E0.0340 F2400
+G1 X5.130 Y14.095 E0.0340 F2400
+G1 X3.882 Y14.489 E0.0340 F2400
+G1 X2.605 Y14.772 E0.0340 F2400
+G1 X1.307 Y14.943 E0.0340 F2400
+G1 X0.000 Y15.000 E0.0340 F2400
+G1 X-1.307 Y14.943 E0.0340 F2400
+G1 X-2.605 Y14.772 E0.0340 F2400
+G1 X-3.882 Y14.489 E0.0340 F2400
+G1 X-5.130 Y14.095 E0.0340 F2400
+G1 X-6.339 Y13.595 E0.0340 F2400
+G1 X-7.500 Y12.990 E0.0340 F2400
+G1 X-8.604 Y12.287 E0.0340 F2400
+G1 X-9.642 Y11.491 E0.0340 F2400
+G1 X-10.607 Y10.607 E0.0340 F2400
+G1 X-11.491 Y9.642 E0.0340 F2400
+G1 X-12.287 Y8.604 E0.0340 F2400
+G1 X-12.990 Y7.500 E0.0340 F2400
+G1 X-13.595 Y6.339 E0.0340 F2400
+G1 X-14.095 Y5.130 E0.0340 F2400
+G1 X-14.489 Y3.882 E0.0340 F2400
+G1 X-14.772 Y2.605 E0.0340 F2400
+G1 X-14.943 Y1.307 E0.0340 F2400
+G1 X-15.000 Y0.000 E0.0340 F2400
+G1 X-14.943 Y-1.307 E0.0340 F2400
+G1 X-14.772 Y-2.605 E0.0340 F2400
+G1 X-14.489 Y-3.882 E0.0340 F2400
+G1 X-14.095 Y-5.130 E0.0340 F2400
+G1 X-13.595 Y-6.339 E0.0340 F2400
+G1 X-12.990 Y-7.500 E0.0340 F2400
+G1 X-12.287 Y-8.604 E0.0340 F2400
+G1 X-11.491 Y-9.642 E0.0340 F2400
+G1 X-10.607 Y-10.607 E0.0340 F2400
+G1 X-9.642 Y-11.491 E0.0340 F2400
+G1 X-8.604 Y-12.287 E0.0340 F2400
+G1 X-7.500 Y-12.990 E0.0340 F2400
+G1 X-6.339 Y-13.595 E0.0340 F2400
+G1 X-5.130 Y-14.095 E0.0340 F2400
+G1 X-3.882 Y-14.489 E0.0340 F2400
+G1 X-2.605 Y-14.772 E0.0340 F2400
+G1 X-1.307 Y-14.943 E0.0340 F2400
+G1 X-0.000 Y-15.000 E0.0340 F2400
+G1 X1.307 Y-14.943 E0.0340 F2400
+G1 X2.605 Y-14.772 E0.0340 F2400
+G1 X3.882 Y-14.489 E0.0340 F2400
+G1 X5.130 Y-14.095 E0.0340 F2400
+G1 X6.339 Y-13.595 E0.0340 F2400
+G1 X7.500 Y-12.990 E0.0340 F2400
+G1 X8.604 Y-12.287 E0.0340 F2400
+G1 X9.642 Y-11.491 E0.0340 F2400
+G1 X10.607 Y-10.607 E0.0340 F2400
+G1 X11.491 Y-9.642 E0.0340 F2400
+G1 X12.287 Y-8.604 E0.0340 F2400
+G1 X12.990 Y-7.500 E0.0340 F2400
+G1 X13.595 Y-6.339 E0.0340 F2400
+G1 X14.095 Y-5.130 E0.0340 F2400
+G1 X14.489 Y-3.882 E0.0340 F2400
+G1 X14.772 Y-2.605 E0.0340 F2400
+G1 X14.943 Y-1.307 E0.0340 F2400
+G1 X15.000 Y-0.000 E0.0340 F2400
+G1 X14.600 Y0 Z0.30 F6000
+G1 X14.544 Y1.272 E0.0340 F2400
+G1 X14.378 Y2.535 E0.0340 F2400
+G1 X14.103 Y3.779 E0.0340 F2400
+G1 X13.720 Y4.993 E0.0340 F2400
+G1 X13.232 Y6.170 E0.0340 F2400
+G1 X12.644 Y7.300 E0.0340 F2400
+G1 X11.960 Y8.374 E0.0340 F2400
+G1 X11.184 Y9.385 E0.0340 F2400
+G1 X10.324 Y10.324 E0.0340 F2400
+G1 X9.385 Y11.184 E0.0340 F2400
+G1 X8.374 Y11.960 E0.0340 F2400
+G1 X7.300 Y12.644 E0.0340 F2400
+G1 X6.170 Y13.232 E0.0340 F2400
+G1 X4.993 Y13.720 E0.0340 F2400
+G1 X3.779 Y14.103 E0.0340 F2400
+G1 X2.535 Y14.378 E0.0340 F2400
+G1 X1.272 Y14.544 E0.0340 F2400
+G1 X0.000 Y14.600 E0.0340 F2400
+G1 X-1.272 Y14.544 E0.0340 F2400
+G1 X-2.535 Y14.378 E0.0340 F2400
+G1 X-3.779 Y14.103 E0.0340 F2400
+G1 X-4.993 Y13.720 E0.0340 F2400
+G1 X-6.170 Y13.232 E0.0340 F2400
+G1 X-7.300 Y12.644 E0.0340 F2400
+G1 X-8.374 Y11.960 E0.0340 F2400
+G1 X-9.385 Y11.184 E0.0340 F2400
+G1 X-10.324 Y10.324 E0.0340 F2400
+G1 X-11.184 Y9.385 E0.0340 F2400
+G1 X-11.960 Y8.374 E0.0340 F2400
+G1 X-12.644 Y7.300 E0.0340 F2400
+G1 X-13.232 Y6.170 E0.0340 F2400
+G1 X-13.720 Y4.993 E0.0340 F2400
+G1 X-14.103 Y3.779 E0.0340 F2400
+G1 X-14.378 Y2.535 E0.0340 F2400
+G1 X-14.544 Y1.272 E0.0340 F2400
+G1 X-14.600 Y0.000 E0.0340 F2400
+G1 X-14.544 Y-1.272 E0.0340 F2400
+G1 X-14.378 Y-2.535 E0.0340 F2400
+G1 X-14.103 Y-3.779 E0.0340 F2400
+G1 X-13.720 Y-4.993 E0.0340 F2400
+G1 X-13.232 Y-6.170 E0.0340 F2400
+G1 X-12.644 Y-7.300 E0.0340 F2400
+G1 X-11.960 Y-8.374 E0.0340 F2400
+G1 X-11.184 Y-9.385 E0.0340 F2400
+G1 X-10.324 Y-10.324 E0.0340 F2400
+G1 X-9.385 Y-11.184 E0.0340 F2400
+G1 X-8.374 Y-11.960 E0.0340 F2400
+G1 X-7.300 Y-12.644 E0.0340 F2400
+G1 X-6.170 Y-13.232 E0.0340 F2400
+G1 X-4.993 Y-13.720 E0.0340 F2400
+G1 X-3.779 Y-14.103 E0.0340 F2400
+G1 X-2.535 Y-14.378 E0.0340 F2400
+G1 X-1.272 Y-14.544 E0.0340 F2400
+G1 X-0.000 Y-14.600 E0.0340 F2400
+G1 X1.272 Y-14.544 E0.0340 F2400
+G1 X2.535 Y-14.378 E0.0340 F2400
+G1 X3.779 Y-14.103 E0.0340 F2400
+G1 X4.993 Y-13.720 E0.0340 F2400
+G1 X6.170 Y-13.232 E0.0340 F2400
+G1 X7.300 Y-12.644 E0.0340 F2400
+G1 X8.374 Y-11.960 E0.0340 F2400
+G1 X9.385 Y-11.184 E0.0340 F2400
+G1 X10.324 Y-10.324 E0.0340 F2400
+G1 X11.184 Y-9.385 E0.0340 F2400
+G1 X11.960 Y-8.374 E0.0340 F2400
+G1 X12.644 Y-7.300 E0.0340 F2400
+G1 X13.232 Y-6.170 E0.0340 F2400
+G1 X13.720 Y-4.993 E0.0340 F2400
+G1 X14.103 Y-3.779 E0.0340 F2400
+G1 X14.378 Y-2.535 E0.0340 F2400
+G1 X14.544 Y-1.272 E0.0340 F2400
+G1 X14.600 Y-0.000 E0.0340 F2400
+G1 E-1 F2400
+G1 Z0.50 F6000
+G1 E1 F2400
+G1 X15.000 Y0 Z0.50 F6000
+G1 X14.943 Y1.307 E0.0340 F2400
+G1 X14.772 Y2.605 E0.0340 F2400
+G1 X14.489 Y3.882 E0.0340 F2400
+G1 X14.095 Y5.130 E0.0340 F2400
+G1 X13.595 Y6.339 E0.0340 F2400
+G1 X12.990 Y7.500 E0.0340 F2400
+G1 X12.287 Y8.604 E0.0340 F2400
+G1 X11.491 Y9.642 E0.0340 F2400
+G1 X10.607 Y10.607 E0.0340 F2400
+G1 X9.642 Y11.491 E0.0340 F2400
+G1 X8.604 Y12.287 E0.0340 F2400
+G1 X7.500 Y12.990 E0.0340 F2400
+G1 X6.339 Y13.595 E0.0340 F2400
+G1 X5.130 Y14.095 E0.0340 F2400
+G1 X3.882 Y14.489 E0.0340 F2400
+G1 X2.605 Y14.772 E0.0340 F2400
+G1 X1.307 Y14.943 E0.0340 F2400
+G1 X0.000 Y15.000 E0.0340 F2400
+G1 X-1.307 Y14.943 E0.0340 F2400
+G1 X-2.605 Y14.772 E0.0340 F2400
+G1 X-3.882 Y14.489 E0.0340 F2400
+G1 X-5.130 Y14.095 E0.0340 F2400
+G1 X-6.339 Y13.595 E0.0340 F2400
+G1 X-7.500 Y12.990 E0.0340 F2400
+G1 X-8.604 Y12.287 E0.0340 F2400
+G1 X-9.642 Y11.491 E0.0340 F2400
+G1 X-10.607 Y10.607 E0.0340 F2400
+G1 X-11.491 Y9.642 E0.0340 F2400
+G1 X-12.287 Y8.604 E0.0340 F2400
+G1 X-12.990 Y7.500 E0.0340 F2400
+G1 X-13.595 Y6.339 E0.0340 F2400
+G1 X-14.095 Y5.130 E0.0340 F2400
+G1 X-14.489 Y3.882 E0.0340 F2400
+G1 X-14.772 Y2.605 E0.0340 F2400
+G1 X-14.943 Y1.307 E0.0340 F2400
+G1 X-15.000 Y0.000 E0.0340 F2400
+G1 X-14.943 Y-1.307 E0.0340 F2400
+G1 X-14.772 Y-2.605 E0.0340 F2400
+G1 X-14.489 Y-3.882 E0.0340 F2400
+G1 X-14.095 Y-5.130 E0.0340 F2400
+G1 X-13.595 Y-6.339 E0.0340 F2400
+G1 X-12.990 Y-7.500 E0.0340 F2400
+G1 X-12.287 Y-8.604 E0.0340 F2400
+G1 X-11.491 Y-9.642 E0.0340 F2400
+G1 X-10.607 Y-10.607 E0.0340 F2400
+G1 X-9.642 Y-11.491 E0.0340 F2400
+G1 X-8.604 Y-12.287 E0.0340 F2400
+G1 X-7.500 Y-12.990 E0.0340 F2400
+G1 X-6.339 Y-13.595 E0.0340 F2400
+G1 X-5.130 Y-14.095 E0.0340 F2400
+G1 X-3.882 Y-14.489 E0.0340 F2400
+G1 X-2.605 Y-14.772 E0.0340 F2400
+G1 X-1.307 Y-14.943 E0.0340 F2400
+G1 X-0.000 Y-15.000 E0.0340 F2400
+G1 X1.307 Y-14.943 E0.0340 F2400
+G1 X2.605 Y-14.772 E0.0340 F2400
+G1 X3.882 Y-14.489 E0.0340 F2400
+G1 X5.130 Y-14.095 E0.0340 F2400
+G1 X6.339 Y-13.595 E0.0340 F2400
+G1 X7.500 Y-12.990 E0.0340 F2400
+G1 X8.604 Y-12.287 E0.0340 F2400
+G1 X9.642 Y-11.491 E0.0340 F2400
+G1 X10.607 Y-10.607 E0.0340 F2400
+G1 X11.491 Y-9.642 E0.0340 F2400
+G1 X12.287 Y-8.604 E0.0340 F2400
+G1 X12.990 Y-7.500 E0.0340 F2400
+G1 X13.595 Y-6.339 E0.0340 F2400
+G1 X14.095 Y-5.130 E0.0340 F2400
+G1 X14.489 Y-3.882 E0.0340 F2400
+G1 X14.772 Y-2.605 E0.0340 F2400
+G1 X14.943 Y-1.307 E0.0340 F2400
+G1 X15.000 Y-0.000 E0.0340 F2400
+G1 X14.600 Y0 Z0.50 F6000
+G1 X14.544 Y1.272 E0.0340 F2400
+G1 X14.378 Y2.535 E0.0340 F2400
+G1 X14.103 Y3.779 E0.0340 F2400
+G1 X13.720 Y4.993 E0.0340 F2400
+G1 X13.232 Y6.170 E0.0340 F2400
+G1 X12.644 Y7.300 E0.0340 F2400
+G1 X11.960 Y8.374 E0.0340 F2400
+G1 X11.184 Y9.385 E0.0340 F2400
+G1 X10.324 Y10.324 E0.0340 F2400
+G1 X9.385 Y11.184 E0.0340 F2400
+G1 X8.374 Y11.960 E0.0340 F2400
+G1 X7.300 Y12.644 E0.0340 F2400
+G1 X6.170 Y13.232 E0.0340 F2400
+G1 X4.993 Y13.720 E0.0340 F2400
+G1 X3.779 Y14.103 E0.0340 F2400
+G1 X2.535 Y14.378 E0.0340 F2400
+G1 X1.272 Y14.544 E0.0340 F2400
+G1 X0.000 Y14.600 E0.0340 F2400
+G1 X-1.272 Y14.544 E0.0340 F2400
+G1 X-2.535 Y14.378 E0.0340 F2400
+G1 X-3.779 Y14.103 E0.0340 F2400
+G1 X-4.993 Y13.720 E0.0340 F2400
+G1 X-6.170 Y13.232 E0.0340 F2400
+G1 X-7.300 Y12.644 E0.0340 F2400
+G1 X-8.374 Y11.960 E0.0340 F2400
+G1 X-9.385 Y11.184 E0.0340 F2400
+G1 X-10.324 Y10.324 E0.0340 F2400
+G1 X-11.184 Y9.385 E0.0340 F2400
+G1 X-11.960 Y8.374 E0.0340 F2400
+G1 X-12.644 Y7.300 E0.0340 F2400
+G1 X-13.232 Y6.170 E0.0340 F2400
+G1 X-13.720 Y4.993 E0.0340 F2400
+G1 X-14.103 Y3.779 E0.0340 F2400
+G1 X-14.378 Y2.535 E0.0340 F2400
+G1 X-14.544 Y1.272 E0.0340 F2400
+G1 X-14.600 Y0.000 E0.0340 F2400
+G1 X-14.544 Y-1.272 E0.0340 F2400
+G1 X-14.378 Y-2.535 E0.0340 F2400
+G1 X-14.103 Y-3.779 E0.0340 F2400
+G1 X-13.720 Y-4.993 E0.0340 F2400
+G1 X-13.232 Y-6.170 E0.0340 F2400
+G1 X-12.644 Y-7.300 E0.0340 F2400
+G1 X-11.960 Y-8.374 E0.0340 F2400
+G1 X-11.184 Y-9.385 E0.0340 F2400
+G1 X-10.324 Y-10.324 E0.0340 F2400
+G1 X-9.385 Y-11.184 E0.0340 F2400
+G1 X-8.374 Y-11.960 E0.0340 F2400
+G1 X-7.300 Y-12.644 E0.0340 F2400
+G1 X-6.170 Y-13.232 E0.0340 F2400
+G1 X-4.993 Y-13.720 E0.0340 F2400
+G1 X-3.779 Y-14.103 E0.0340 F2400
+G1 X-2.535 Y-14.378 E0.0340 F2400
+G1 X-1.272 Y-14.544 E0.0340 F2400
+G1 X-0.000 Y-14.600 E0.0340 F2400
+G1 X1.272 Y-14.544 E0.0340 F2400
+G1 X2.535 Y-14.378 E0.0340 F2400
+G1 X3.779 Y-14.103 E0.0340 F2400
+G1 X4.993 Y-13.720 E0.0340 F2400
+G1 X6.170 Y-13.232 E0.0340 F2400
+G1 X7.300 Y-12.644 E0.0340 F2400
+G1 X8.374 Y-11.960 E0.0340 F2400
+G1 X9.385 Y-11.184 E0.0340 F2400
+G1 X10.324 Y-10.324 E0.0340 F2400
+G1 X11.184 Y-9.385 E0.0340 F2400
+G1 X11.960 Y-8.374 E0.0340 F2400
+G1 X12.644 Y-7.300 E0.0340 F2400
+G1 X13.232 Y-6.170 E0.0340 F2400
+G1 X13.720 Y-4.993 E0.0340 F2400
+G1 X14.103 Y-3.779 E0.0340 F2400
+G1 X14.378 Y-2.535 E0.0340 F2400
+G1 X14.544 Y-1.272 E0.0340 F2400
+G1 X14.600 Y-0.000 E0.0340 F2400
+G1 E-1 F2400
+G1 Z0.70 F6000
+G1 E1 F2400
+G1 X15.000 Y0 Z0.70 F6000
+G1 X14.943 Y1.307 E0.0340 F2400
+G1 X14.772 Y2.605 E0.0340 F2400
+G1 X14.489 Y3.882 E0.0340 F2400
+G1 X14.095 Y5.130 E0.0340 F2400
+G1 X13.595 Y6.339 E0.0340 F2400
+G1 X12.990 Y7.500 E0.0340 F2400
+G1 X12.287 Y8.604 E0.0340 F2400
+G1 X11.491 Y9.642 E0.0340 F2400
+G1 X10.607 Y10.607 E0.0340 F2400
+G1 X9.642 Y11.491 E0.0340 F2400
+G1 X8.604 Y12.287 E0.0340 F2400
+G1 X7.500 Y12.990 E0.0340 F2400
+G1 X6.339 Y13.595 E0.0340 F2400
+G1 X5.130 Y14.095 E0.0340 F2400
+G1 X3.882 Y14.489 E0.0340 F2400
+G1 X2.605 Y14.772 E0.0340 F2400
+G1 X1.307 Y14.943 E0.0340 F2400
+G1 X0.000 Y15.000 E0.0340 F2400
+G1 X-1.307 Y14.943 E0.0340 F2400
+G1 X-2.605 Y14.772 E0.0340 F2400
+G1 X-3.882 Y14.489 E0.0340 F2400
+G1 X-5.130 Y14.095 E0.0340 F2400
+G1 X-6.339 Y13.595 E0.0340 F2400
+G1 X-7.500 Y12.990 E0.0340 F2400
+G1 X-8.604 Y12.287 E0.0340 F2400
+G1 X-9.642 Y11.491 E0.0340 F2400
+G1 X-10.607 Y10.607 E0.0340 F2400
+G1 X-11.491 Y9.642 E0.0340 F2400
+G1 X-12.287 Y8.604 E0.0340 F2400
+G1 X-12.990 Y7.500 E0.0340 F2400
+G1 X-13.595 Y6.339 E0.0340 F2400
+G1 X-14.095 Y5.130 E0.0340 F2400
+G1 X-14.489 Y3.882 E0.0340 F2400
+G1 X-14.772 Y2.605 E0.0340 F2400
+G1 X-14.943 Y1.307 E0.0340 F2400
+G1 X-15.000 Y0.000 E0.0340 F2400
+G1 X-14.943 Y-1.307 E0.0340 F2400
+G1 X-14.772 Y-2.605 E0.0340 F2400
+G1 X-14.489 Y-3.882 E0.0340 F2400
+G1 X-14.095 Y-5.130 E0.0340 F2400
+G1 X-13.595 Y-6.339 E0.0340 F2400
+G1 X-12.990 Y-7.500 E0.0340 F2400
+G1 X-12.287 Y-8.604 E0.0340 F2400
+G1 X-11.491 Y-9.642 E0.0340 F2400
+G1 X-10.607 Y-10.607 E0.0340 F2400
+G1 X-9.642 Y-11.491 E0.0340 F2400
+G1 X-8.604 Y-12.287 E0.0340 F2400
+G1 X-7.500 Y-12.990 E0.0340 F2400
+G1 X-6.339 Y-13.595 E0.0340 F2400
+G1 X-5.130 Y-14.095 E0.0340 F2400
+G1 X-3.882 Y-14.489 E0.0340 F2400
+G1 X-2.605 Y-14.772 E0.0340 F2400
+G1 X-1.307 Y-14.943 E0.0340 F2400
+G1 X-0.000 Y-15.000 E0.0340 F2400
+G1 X1.307 Y-14.943 E0.0340 F2400
+G1 X2.605 Y-14.772 E0.0340 F2400
+G1 X3.882 Y-14.489 E0.0340 F2400
+G1 X5.130 Y-14.095 E0.0340 F2400
+G1 X6.339 Y-13.595 E0.0340 F2400
+G1 X7.500 Y-12.990 E0.0340 F2400
+G1 X8.604 Y-12.287 E0.0340 F2400
+G1 X9.642 Y-11.491 E0.0340 F2400
+G1 X10.607 Y-10.607 E0.0340 F2400
+G1 X11.491 Y-9.642 E0.0340 F2400
+G1 X12.287 Y-8.604 E0.0340 F2400
+G1 X12.990 Y-7.500 E0.0340 F2400
+G1 X13.595 Y-6.339 E0.0340 F2400
+G1 X14.095 Y-5.130 E0.0340 F2400
+G1 X14.489 Y-3.882 E0.0340 F2400
+G1 X14.772 Y-2.605 E0.0340 F2400
+G1 X14.943 Y-1.307 E0.0340 F2400
+G1 X15.000 Y-0.000 E0.0340 F2400
+G1 X14.600 Y0 Z0.70 F6000
+G1 X14.544 Y1.272 E0.0340 F2400
+G1 X14.378 Y2.535 E0.0340 F2400
+G1 X14.103 Y3.779 E0.0340 F2400
+G1 X13.720 Y4.993 E0.0340 F2400
+G1 X13.232 Y6.170 E0.0340 F2400
+G1 X12.644 Y7.300 E0.0340 F2400
+G1 X11.960 Y8.374 E0.0340 F2400
+G1 X11.184 Y9.385 E0.0340 F2400
+G1 X10.324 Y10.324 E0.0340 F2400
+G1 X9.385 Y11.184 E0.0340 F2400
+G1 X8.374 Y11.960 E0.0340 F2400
+G1 X7.300 Y12.644 E0.0340 F2400
+G1 X6.170 Y13.232 E0.0340 F2400
+G1 X4.993 Y13.720 E0.0340 F2400
+G1 X3.779 Y14.103 E0.0340 F2400
+G1 X2.535 Y14.378 E0.0340 F2400
+G1 X1.272 Y14.544 E0.0340 F2400
+G1 X0.000 Y14.600 E0.0340 F2400
+G1 X-1.272 Y14.544 E0.0340 F2400
+G1 X-2.535 Y14.378 E0.0340 F2400
+G1 X-3.779 Y14.103 E0.0340 F2400
+G1 X-4.993 Y13.720 E0.0340 F2400
+G1 X-6.170 Y13.232 E0.0340 F2400
+G1 X-7.300 Y12.644 E0.0340 F2400
+G1 X-8.374 Y11.960 E0.0340 F2400
+G1 X-9.385 Y11.184 E0.0340 F2400
+G1 X-10.324 Y10.324 E0.0340 F2400
+G1 X-11.184 Y9.385 E0.0340 F2400
+G1 X-11.960 Y8.374 E0.0340 F2400
+G1 X-12.644 Y7.300 E0.0340 F2400
+G1 X-13.232 Y6.170 E0.0340 F2400
+G1 X-13.720 Y4.993 E0.0340 F2400
+G1 X-14.103 Y3.779 E0.0340 F2400
+G1 X-14.378 Y2.535 E0.0340 F2400
+G1 X-14.544 Y1.272 E0.0340 F2400
+G1 X-14.600 Y0.000 E0.0340 F2400
+G1 X-14.544 Y-1.272 E0.0340 F2400
+G1 X-14.378 Y-2.535 E0.0340 F2400
+G1 X-14.103 Y-3.779 E0.0340 F2400
+G1 X-13.720 Y-4.993 E0.0340 F2400
+G1 X-13.232 Y-6.170 E0.0340 F2400
+G1 X-12.644 Y-7.300 E0.0340 F2400
+G1 X-11.960 Y-8.374 E0.0340 F2400
+G1 X-11.184 Y-9.385 E0.0340 F2400
+G1 X-10.324 Y-10.324 E0.0340 F2400
+G1 X-9.385 Y-11.184 E0.0340 F2400
+G1 X-8.374 Y-11.960 E0.0340 F2400
+G1 X-7.300 Y-12.644 E0.0340 F2400
+G1 X-6.170 Y-13.232 E0.0340 F2400
+G1 X-4.993 Y-13.720 E0.0340 F2400
+G1 X-3.779 Y-14.103 E0.0340 F2400
+G1 X-2.535 Y-14.378 E0.0340 F2400
+G1 X-1.272 Y-14.544 E0.0340 F2400
+G1 X-0.000 Y-14.600 E0.0340 F2400
+G1 X1.272 Y-14.544 E0.0340 F2400
+G1 X2.535 Y-14.378 E0.0340 F2400
+G1 X3.779 Y-14.103 E0.0340 F2400
+G1 X4.993 Y-13.720 E0.0340 F2400
+G1 X6.170 Y-13.232 E0.0340 F2400
+G1 X7.300 Y-12.644 E0.0340 F2400
+G1 X8.374 Y-11.960 E0.0340 F2400
+G1 X9.385 Y-11.184 E0.0340 F2400
+G1 X10.324 Y-10.324 E0.0340 F2400
+G1 X11.184 Y-9.385 E0.0340 F2400
+G1 X11.960 Y-8.374 E0.0340 F2400
+G1 X12.644 Y-7.300 E0.0340 F2400
+G1 X13.232 Y-6.170 E0.0340 F2400
+G1 X13.720 Y-4.993 E0.0340 F2400
+G1 X14.103 Y-3.779 E0.0340 F2400
+G1 X14.378 Y-2.535 E0.0340 F2400
+G1 X14.544 Y-1.272 E0.0340 F2400
+G1 X14.600 Y-0.000 E0.0340 F2400
+G1 E-1 F2400
+G1 Z0.90 F6000
+G1 E1 F2400
+G1 X15.000 Y0 Z0.90 F6000
+G1 X14.943 Y1.307 E0.0340 F2400
+G1 X14.772 Y2.605 E0.0340 F2400
+G1 X14.489 Y3.882 E0.0340 F2400
+G1 X14.095 Y5.130 E0.0340 F2400
+G1 X13.595 Y6.339 E0.0340 F2400
+G1 X12.990 Y7.500 E0.0340 F2400
+G1 X12.287 Y8.604 E0.0340 F2400
+G1 X11.491 Y9.642 E0.0340 F2400
+G1 X10.607 Y10.607 E0.0340 F2400
+G1 X9.642 Y11.491 E0.0340 F2400
+G1 X8.604 Y12.287 E0.0340 F2400
+G1 X7.500 Y12.990 E0.0340 F2400
+G1 X6.339 Y13.595 E0.0340 F2400
+G1 X5.130 Y14.095 E0.0340 F2400
+G1 X3.882 Y14.489 E0.0340 F2400
+G1 X2.605 Y14.772 E0.0340 F2400
+G1 X1.307 Y14.943 E0.0340 F2400
+G1 X0.000 Y15.000 E0.0340 F2400
+G1 X-1.307 Y14.943 E0.0340 F2400
+G1 X-2.605 Y14.772 E0.0340 F2400
+G1 X-3.882 Y14.489 E0.0340 F2400
+G1 X-5.130 Y14.095 E0.0340 F2400
+G1 X-6.339 Y13.595 E0.0340 F2400
+G1 X-7.500 Y12.990 E0.0340 F2400
+G1 X-8.604 Y12.287 E0.0340 F2400
+G1 X-9.642 Y11.491 E0.0340 F2400
+G1 X-10.607 Y10.607 E0.0340 F2400
+G1 X-11.491 Y9.642 E0.0340 F2400
+G1 X-12.287 Y8.604 E0.0340 F2400
+G1 X-12.990 Y7.500 E0.0340 F2400
+G1 X-13.595 Y6.339 E0.0340 F2400
+G1 X-14.095 Y5.130 E0.0340 F2400
+G1 X-14.489 Y3.882 E0.0340 F2400
+G1 X-14.772 Y2.605 E0.0340 F2400
+G1 X-14.943 Y1.307 E0.0340 F2400
+G1 X-15.000 Y0.000 E0.0340 F2400
+G1 X-14.943 Y-1.307 E0.0340 F2400
+G1 X-14.772 Y-2.605 E0.0340 F2400
+G1 X-14.489 Y-3.882 E0.0340 F2400
+G1 X-14.095 Y-5.130 E0.0340 F2400
+G1 X-13.595 Y-6.339 E0.0340 F2400
+G1 X-12.990 Y-7.500 E0.0340 F2400
+G1 X-12.287 Y-8.604 E0.0340 F2400
+G1 X-11.491 Y-9.642 E0.0340 F2400
+G1 X-10.607 Y-10.607 E0.0340 F2400
+G1 X-9.642 Y-11.491 E0.0340 F2400
+G1 X-8.604 Y-12.287 E0.0340 F2400
+G1 X-7.500 Y-12.990 E0.0340 F2400
+G1 X-6.339 Y-13.595 E0.0340 F2400
+G1 X-5.130 Y-14.095 E0.0340 F2400
+G1 X-3.882 Y-14.489 E0.0340 F2400
+G1 X-2.605 Y-14.772 E0.0340 F2400
+G1 X-1.307 Y-14.943 E0.0340 F2400
+G1 X-0.000 Y-15.000 E0.0340 F2400
+G1 X1.307 Y-14.943 E0.0340 F2400
+G1 X2.605 Y-14.772 E0.0340 F2400
+G1 X3.882 Y-14.489 E0.0340 F2400
+G1 X5.130 Y-14.095 E0.0340 F2400
+G1 X6.339 Y-13.595 E0.0340 F2400
+G1 X7.500 Y-12.990 E0.0340 F2400
+G1 X8.604 Y-12.287 E0.0340 F2400
+G1 X9.642 Y-11.491 E0.0340 F2400
+G1 X10.607 Y-10.607 E0.0340 F2400
+G1 X11.491 Y-9.642 E0.0340 F2400
+G1 X12.287 Y-8.604 E0.0340 F2400
+G1 X12.990 Y-7.500 E0.0340 F2400
+G1 X13.595 Y-6.339 E0.0340 F2400
+G1 X14.095 Y-5.130 E0.0340 F2400
+G1 X14.489 Y-3.882 E0.0340 F2400
+G1 X14.772 Y-2.605 E0.0340 F2400
+G1 X14.943 Y-1.307 E0.0340 F2400
+G1 X15.000 Y-0.000 E0.0340 F2400
+G1 X14.600 Y0 Z0.90 F6000
+G1 X14.544 Y1.272 E0.0340 F2400
+G1 X14.378 Y2.535 E0.0340 F2400
+G1 X14.103 Y3.779 E0.0340 F2400
+G1 X13.720 Y4.993 E0.0340 F2400
+G1 X13.232 Y6.170 E0.0340 F2400
+G1 X12.644 Y7.300 E0.0340 F2400
+G1 X11.960 Y8.374 E0.0340 F2400
+G1 X11.184 Y9.385 E0.0340 F2400
+G1 X10.324 Y10.324 E0.0340 F2400
+G1 X9.385 Y11.184 E0.0340 F2400
+G1 X8.374 Y11.960 E0.0340 F2400
+G1 X7.300 Y12.644 E0.0340 F2400
+G1 X6.170 Y13.232 E0.0340 F2400
+G1 X4.993 Y13.720 E0.0340 F2400
+G1 X3.779 Y14.103 E0.0340 F2400
+G1 X2.535 Y14.378 E0.0340 F2400
+G1 X1.272 Y14.544 E0.0340 F2400
+G1 X0.000 Y14.600 E0.0340 F2400
+G1 X-1.272 Y14.544 E0.0340 F2400
+G1 X-2.535 Y14.378 E0.0340 F2400
+G1 X-3.779 Y14.103 E0.0340 F2400
+G1 X-4.993 Y13.720 E0.0340 F2400
+G1 X-6.170 Y13.232 E0.0340 F2400
+G1 X-7.300 Y12.644 E0.0340 F2400
+G1 X-8.374 Y11.960 E0.0340 F2400
+G1 X-9.385 Y11.184 E0.0340 F2400
+G1 X-10.324 Y10.324 E0.0340 F2400
+G1 X-11.184 Y9.385 E0.0340 F2400
+G1 X-11.960 Y8.374 E0.0340 F2400
+G1 X-12.644 Y7.300 E0.0340 F2400
+G1 X-13.232 Y6.170 E0.0340 F2400
+G1 X-13.720 Y4.993 E0.0340 F2400
+G1 X-14.103 Y3.779 E0.0340 F2400
+G1 X-14.378 Y2.535 E0.0340 F2400
+G1 X-14.544 Y1.272 E0.0340 F2400
+G1 X-14.600 Y0.000 E0.0340 F2400
+G1 X-14.544 Y-1.272 E0.0340 F2400
+G1 X-14.378 Y-2.535 E0.0340 F2400
+G1 X-14.103 Y-3.779 E0.0340 F2400
+G1 X-13.720 Y-4.993 E0.0340 F2400
+G1 X-13.232 Y-6.170 E0.0340 F2400
+G1 X-12.644 Y-7.300 E0.0340 F2400
+G1 X-11.960 Y-8.374 E0.0340 F2400
+G1 X-11.184 Y-9.385 E0.0340 F2400
+G1 X-10.324 Y-10.324 E0.0340 F2400
+G1 X-9.385 Y-11.184 E0.0340 F2400
+G1 X-8.374 Y-11.960 E0.0340 F2400
+G1 X-7.300 Y-12.644 E0.0340 F2400
+G1 X-6.170 Y-13.232 E0.0340 F2400
+G1 X-4.993 Y-13.720 E0.0340 F2400
+G1 X-3.779 Y-14.103 E0.0340 F2400
+G1 X-2.535 Y-14.378 E0.0340 F2400
+G1 X-1.272 Y-14.544 E0.0340 F2400
+G1 X-0.000 Y-14.600 E0.0340 F2400
+G1 X1.272 Y-14.544 E0.0340 F2400
+G1 X2.535 Y-14.378 E0.0340 F2400
+G1 X3.779 Y-14.103 E0.0340 F2400
+G1 X4.993 Y-13.720 E0.0340 F2400
+G1 X6.170 Y-13.232 E0.0340 F2400
+G1 X7.300 Y-12.644 E0.0340 F2400
+G1 X8.374 Y-11.960 E0.0340 F2400
+G1 X9.385 Y-11.184 E0.0340 F2400
+G1 X10.324 Y-10.324 E0.0340 F2400
+G1 X11.184 Y-9.385 E0.0340 F2400
+G1 X11.960 Y-8.374 E0.0340 F2400
+G1 X12.644 Y-7.300 E0.0340 F2400
+G1 X13.232 Y-6.170 E0.0340 F2400
+G1 X13.720 Y-4.993 E0.0340 F2400
+G1 X14.103 Y-3.779 E0.0340 F2400
+G1 X14.378 Y-2.535 E0.0340 F2400
+G1 X14.544 Y-1.272 E0.0340 F2400
+G1 X14.600 Y-0.000 E0.0340 F2400
+G1 E-1 F2400
+G1 Z1.10 F6000
+G1 E1 F2400
+G1 Z20 F6000
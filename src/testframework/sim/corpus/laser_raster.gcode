@@ -0,0 +1,661 @@
+; laser raster: 16 lines of 20mm, back and forth, the power changing every 0.5mm
+G21
+G90
+G0 X10 Y10 F6000
+G0 X10.00 Y10.00
+G1 X10.50 S0.500 F4800
+G1 X11.00 S0.695 F4800
+G1 X11.50 S0.859 F4800
+G1 X12.00 S0.966 F4800
+G1 X12.50 S1.000 F4800
+G1 X13.00 S0.955 F4800
+G1 X13.50 S0.838 F4800
+G1 X14.00 S0.667 F4800
+G1 X14.50 S0.471 F4800
+G1 X15.00 S0.279 F4800
+G1 X15.50 S0.122 F4800
+G1 X16.00 S0.024 F4800
+G1 X16.50 S0.002 F4800
+G1 X17.00 S0.058 F4800
+G1 X17.50 S0.184 F4800
+G1 X18.00 S0.360 F4800
+G1 X18.50 S0.558 F4800
+G1 X19.00 S0.747 F4800
+G1 X19.50 S0.897 F4800
+G1 X20.00 S0.984 F4800
+G1 X20.50 S0.995 F4800
+G1 X21.00 S0.927 F4800
+G1 X21.50 S0.792 F4800
+G1 X22.00 S0.611 F4800
+G1 X22.50 S0.413 F4800
+G1 X23.00 S0.228 F4800
+G1 X23.50 S0.086 F4800
+G1 X24.00 S0.010 F4800
+G1 X24.50 S0.010 F4800
+G1 X25.00 S0.089 F4800
+G1 X25.50 S0.232 F4800
+G1 X26.00 S0.417 F4800
+G1 X26.50 S0.616 F4800
+G1 X27.00 S0.796 F4800
+G1 X27.50 S0.930 F4800
+G1 X28.00 S0.995 F4800
+G1 X28.50 S0.983 F4800
+G1 X29.00 S0.894 F4800
+G1 X29.50 S0.743 F4800
+G1 X30.00 S0.554 F4800
+G0 X30.00 Y10.25
+G1 X29.50 S0.822 F4800
+G1 X29.00 S0.946 F4800
+G1 X28.50 S0.999 F4800
+G1 X28.00 S0.973 F4800
+G1 X27.50 S0.873 F4800
+G1 X27.00 S0.714 F4800
+G1 X26.50 S0.521 F4800
+G1 X26.00 S0.325 F4800
+G1 X25.50 S0.156 F4800
+G1 X25.00 S0.042 F4800
+G1 X24.50 S0.000 F4800
+G1 X24.00 S0.037 F4800
+G1 X23.50 S0.147 F4800
+G1 X23.00 S0.313 F4800
+G1 X22.50 S0.508 F4800
+G1 X22.00 S0.702 F4800
+G1 X21.50 S0.864 F4800
+G1 X21.00 S0.969 F4800
+G1 X20.50 S0.999 F4800
+G1 X20.00 S0.951 F4800
+G1 X19.50 S0.831 F4800
+G1 X19.00 S0.660 F4800
+G1 X18.50 S0.462 F4800
+G1 X18.00 S0.271 F4800
+G1 X17.50 S0.116 F4800
+G1 X17.00 S0.022 F4800
+G1 X16.50 S0.003 F4800
+G1 X16.00 S0.062 F4800
+G1 X15.50 S0.191 F4800
+G1 X15.00 S0.368 F4800
+G1 X14.50 S0.567 F4800
+G1 X14.00 S0.754 F4800
+G1 X13.50 S0.902 F4800
+G1 X13.00 S0.986 F4800
+G1 X12.50 S0.993 F4800
+G1 X12.00 S0.923 F4800
+G1 X11.50 S0.786 F4800
+G1 X11.00 S0.603 F4800
+G1 X10.50 S0.405 F4800
+G1 X10.00 S0.221 F4800
+G0 X10.00 Y10.50
+G1 X10.50 S0.993 F4800
+G1 X11.00 S0.987 F4800
+G1 X11.50 S0.904 F4800
+G1 X12.00 S0.758 F4800
+G1 X12.50 S0.571 F4800
+G1 X13.00 S0.372 F4800
+G1 X13.50 S0.194 F4800
+G1 X14.00 S0.064 F4800
+G1 X14.50 S0.003 F4800
+G1 X15.00 S0.021 F4800
+G1 X15.50 S0.114 F4800
+G1 X16.00 S0.268 F4800
+G1 X16.50 S0.458 F4800
+G1 X17.00 S0.656 F4800
+G1 X17.50 S0.828 F4800
+G1 X18.00 S0.949 F4800
+G1 X18.50 S0.999 F4800
+G1 X19.00 S0.970 F4800
+G1 X19.50 S0.867 F4800
+G1 X20.00 S0.706 F4800
+G1 X20.50 S0.512 F4800
+G1 X21.00 S0.317 F4800
+G1 X21.50 S0.150 F4800
+G1 X22.00 S0.039 F4800
+G1 X22.50 S0.000 F4800
+G1 X23.00 S0.040 F4800
+G1 X23.50 S0.153 F4800
+G1 X24.00 S0.321 F4800
+G1 X24.50 S0.517 F4800
+G1 X25.00 S0.710 F4800
+G1 X25.50 S0.870 F4800
+G1 X26.00 S0.972 F4800
+G1 X26.50 S0.999 F4800
+G1 X27.00 S0.947 F4800
+G1 X27.50 S0.825 F4800
+G1 X28.00 S0.652 F4800
+G1 X28.50 S0.454 F4800
+G1 X29.00 S0.264 F4800
+G1 X29.50 S0.111 F4800
+G1 X30.00 S0.019 F4800
+G0 X30.00 Y10.75
+G1 X29.50 S0.932 F4800
+G1 X29.00 S0.799 F4800
+G1 X28.50 S0.620 F4800
+G1 X28.00 S0.421 F4800
+G1 X27.50 S0.235 F4800
+G1 X27.00 S0.091 F4800
+G1 X26.50 S0.011 F4800
+G1 X26.00 S0.009 F4800
+G1 X25.50 S0.084 F4800
+G1 X25.00 S0.225 F4800
+G1 X24.50 S0.409 F4800
+G1 X24.00 S0.608 F4800
+G1 X23.50 S0.789 F4800
+G1 X23.00 S0.925 F4800
+G1 X22.50 S0.994 F4800
+G1 X22.00 S0.985 F4800
+G1 X21.50 S0.899 F4800
+G1 X21.00 S0.751 F4800
+G1 X20.50 S0.562 F4800
+G1 X20.00 S0.364 F4800
+G1 X19.50 S0.187 F4800
+G1 X19.00 S0.060 F4800
+G1 X18.50 S0.002 F4800
+G1 X18.00 S0.023 F4800
+G1 X17.50 S0.119 F4800
+G1 X17.00 S0.275 F4800
+G1 X16.50 S0.467 F4800
+G1 X16.00 S0.664 F4800
+G1 X15.50 S0.835 F4800
+G1 X15.00 S0.953 F4800
+G1 X14.50 S1.000 F4800
+G1 X14.00 S0.967 F4800
+G1 X13.50 S0.861 F4800
+G1 X13.00 S0.698 F4800
+G1 X12.50 S0.504 F4800
+G1 X12.00 S0.309 F4800
+G1 X11.50 S0.144 F4800
+G1 X11.00 S0.035 F4800
+G1 X10.50 S0.000 F4800
+G1 X10.00 S0.044 F4800
+G0 X10.00 Y11.00
+G1 X10.50 S0.667 F4800
+G1 X11.00 S0.471 F4800
+G1 X11.50 S0.279 F4800
+G1 X12.00 S0.122 F4800
+G1 X12.50 S0.024 F4800
+G1 X13.00 S0.002 F4800
+G1 X13.50 S0.058 F4800
+G1 X14.00 S0.184 F4800
+G1 X14.50 S0.360 F4800
+G1 X15.00 S0.558 F4800
+G1 X15.50 S0.747 F4800
+G1 X16.00 S0.897 F4800
+G1 X16.50 S0.984 F4800
+G1 X17.00 S0.995 F4800
+G1 X17.50 S0.927 F4800
+G1 X18.00 S0.792 F4800
+G1 X18.50 S0.611 F4800
+G1 X19.00 S0.413 F4800
+G1 X19.50 S0.228 F4800
+G1 X20.00 S0.086 F4800
+G1 X20.50 S0.010 F4800
+G1 X21.00 S0.010 F4800
+G1 X21.50 S0.089 F4800
+G1 X22.00 S0.232 F4800
+G1 X22.50 S0.417 F4800
+G1 X23.00 S0.616 F4800
+G1 X23.50 S0.796 F4800
+G1 X24.00 S0.930 F4800
+G1 X24.50 S0.995 F4800
+G1 X25.00 S0.983 F4800
+G1 X25.50 S0.894 F4800
+G1 X26.00 S0.743 F4800
+G1 X26.50 S0.554 F4800
+G1 X27.00 S0.356 F4800
+G1 X27.50 S0.181 F4800
+G1 X28.00 S0.056 F4800
+G1 X28.50 S0.002 F4800
+G1 X29.00 S0.026 F4800
+G1 X29.50 S0.125 F4800
+G1 X30.00 S0.283 F4800
+G0 X30.00 Y11.25
+G1 X29.50 S0.325 F4800
+G1 X29.00 S0.156 F4800
+G1 X28.50 S0.042 F4800
+G1 X28.00 S0.000 F4800
+G1 X27.50 S0.037 F4800
+G1 X27.00 S0.147 F4800
+G1 X26.50 S0.313 F4800
+G1 X26.00 S0.508 F4800
+G1 X25.50 S0.702 F4800
+G1 X25.00 S0.864 F4800
+G1 X24.50 S0.969 F4800
+G1 X24.00 S0.999 F4800
+G1 X23.50 S0.951 F4800
+G1 X23.00 S0.831 F4800
+G1 X22.50 S0.660 F4800
+G1 X22.00 S0.462 F4800
+G1 X21.50 S0.271 F4800
+G1 X21.00 S0.116 F4800
+G1 X20.50 S0.022 F4800
+G1 X20.00 S0.003 F4800
+G1 X19.50 S0.062 F4800
+G1 X19.00 S0.191 F4800
+G1 X18.50 S0.368 F4800
+G1 X18.00 S0.567 F4800
+G1 X17.50 S0.754 F4800
+G1 X17.00 S0.902 F4800
+G1 X16.50 S0.986 F4800
+G1 X16.00 S0.993 F4800
+G1 X15.50 S0.923 F4800
+G1 X15.00 S0.786 F4800
+G1 X14.50 S0.603 F4800
+G1 X14.00 S0.405 F4800
+G1 X13.50 S0.221 F4800
+G1 X13.00 S0.081 F4800
+G1 X12.50 S0.008 F4800
+G1 X12.00 S0.012 F4800
+G1 X11.50 S0.093 F4800
+G1 X11.00 S0.239 F4800
+G1 X10.50 S0.426 F4800
+G1 X10.00 S0.624 F4800
+G0 X10.00 Y11.50
+G1 X10.50 S0.064 F4800
+G1 X11.00 S0.003 F4800
+G1 X11.50 S0.021 F4800
+G1 X12.00 S0.114 F4800
+G1 X12.50 S0.268 F4800
+G1 X13.00 S0.458 F4800
+G1 X13.50 S0.656 F4800
+G1 X14.00 S0.828 F4800
+G1 X14.50 S0.949 F4800
+G1 X15.00 S0.999 F4800
+G1 X15.50 S0.970 F4800
+G1 X16.00 S0.867 F4800
+G1 X16.50 S0.706 F4800
+G1 X17.00 S0.512 F4800
+G1 X17.50 S0.317 F4800
+G1 X18.00 S0.150 F4800
+G1 X18.50 S0.039 F4800
+G1 X19.00 S0.000 F4800
+G1 X19.50 S0.040 F4800
+G1 X20.00 S0.153 F4800
+G1 X20.50 S0.321 F4800
+G1 X21.00 S0.517 F4800
+G1 X21.50 S0.710 F4800
+G1 X22.00 S0.870 F4800
+G1 X22.50 S0.972 F4800
+G1 X23.00 S0.999 F4800
+G1 X23.50 S0.947 F4800
+G1 X24.00 S0.825 F4800
+G1 X24.50 S0.652 F4800
+G1 X25.00 S0.454 F4800
+G1 X25.50 S0.264 F4800
+G1 X26.00 S0.111 F4800
+G1 X26.50 S0.019 F4800
+G1 X27.00 S0.004 F4800
+G1 X27.50 S0.066 F4800
+G1 X28.00 S0.198 F4800
+G1 X28.50 S0.377 F4800
+G1 X29.00 S0.575 F4800
+G1 X29.50 S0.762 F4800
+G1 X30.00 S0.907 F4800
+G0 X30.00 Y11.75
+G1 X29.50 S0.009 F4800
+G1 X29.00 S0.084 F4800
+G1 X28.50 S0.225 F4800
+G1 X28.00 S0.409 F4800
+G1 X27.50 S0.608 F4800
+G1 X27.00 S0.789 F4800
+G1 X26.50 S0.925 F4800
+G1 X26.00 S0.994 F4800
+G1 X25.50 S0.985 F4800
+G1 X25.00 S0.899 F4800
+G1 X24.50 S0.751 F4800
+G1 X24.00 S0.562 F4800
+G1 X23.50 S0.364 F4800
+G1 X23.00 S0.187 F4800
+G1 X22.50 S0.060 F4800
+G1 X22.00 S0.002 F4800
+G1 X21.50 S0.023 F4800
+G1 X21.00 S0.119 F4800
+G1 X20.50 S0.275 F4800
+G1 X20.00 S0.467 F4800
+G1 X19.50 S0.664 F4800
+G1 X19.00 S0.835 F4800
+G1 X18.50 S0.953 F4800
+G1 X18.00 S1.000 F4800
+G1 X17.50 S0.967 F4800
+G1 X17.00 S0.861 F4800
+G1 X16.50 S0.698 F4800
+G1 X16.00 S0.504 F4800
+G1 X15.50 S0.309 F4800
+G1 X15.00 S0.144 F4800
+G1 X14.50 S0.035 F4800
+G1 X14.00 S0.000 F4800
+G1 X13.50 S0.044 F4800
+G1 X13.00 S0.159 F4800
+G1 X12.50 S0.329 F4800
+G1 X12.00 S0.525 F4800
+G1 X11.50 S0.718 F4800
+G1 X11.00 S0.876 F4800
+G1 X10.50 S0.975 F4800
+G1 X10.00 S0.998 F4800
+G0 X10.00 Y12.00
+G1 X10.50 S0.184 F4800
+G1 X11.00 S0.360 F4800
+G1 X11.50 S0.558 F4800
+G1 X12.00 S0.747 F4800
+G1 X12.50 S0.897 F4800
+G1 X13.00 S0.984 F4800
+G1 X13.50 S0.995 F4800
+G1 X14.00 S0.927 F4800
+G1 X14.50 S0.792 F4800
+G1 X15.00 S0.611 F4800
+G1 X15.50 S0.413 F4800
+G1 X16.00 S0.228 F4800
+G1 X16.50 S0.086 F4800
+G1 X17.00 S0.010 F4800
+G1 X17.50 S0.010 F4800
+G1 X18.00 S0.089 F4800
+G1 X18.50 S0.232 F4800
+G1 X19.00 S0.417 F4800
+G1 X19.50 S0.616 F4800
+G1 X20.00 S0.796 F4800
+G1 X20.50 S0.930 F4800
+G1 X21.00 S0.995 F4800
+G1 X21.50 S0.983 F4800
+G1 X22.00 S0.894 F4800
+G1 X22.50 S0.743 F4800
+G1 X23.00 S0.554 F4800
+G1 X23.50 S0.356 F4800
+G1 X24.00 S0.181 F4800
+G1 X24.50 S0.056 F4800
+G1 X25.00 S0.002 F4800
+G1 X25.50 S0.026 F4800
+G1 X26.00 S0.125 F4800
+G1 X26.50 S0.283 F4800
+G1 X27.00 S0.475 F4800
+G1 X27.50 S0.672 F4800
+G1 X28.00 S0.841 F4800
+G1 X28.50 S0.956 F4800
+G1 X29.00 S1.000 F4800
+G1 X29.50 S0.964 F4800
+G1 X30.00 S0.856 F4800
+G0 X30.00 Y12.25
+G1 X29.50 S0.508 F4800
+G1 X29.00 S0.702 F4800
+G1 X28.50 S0.864 F4800
+G1 X28.00 S0.969 F4800
+G1 X27.50 S0.999 F4800
+G1 X27.00 S0.951 F4800
+G1 X26.50 S0.831 F4800
+G1 X26.00 S0.660 F4800
+G1 X25.50 S0.462 F4800
+G1 X25.00 S0.271 F4800
+G1 X24.50 S0.116 F4800
+G1 X24.00 S0.022 F4800
+G1 X23.50 S0.003 F4800
+G1 X23.00 S0.062 F4800
+G1 X22.50 S0.191 F4800
+G1 X22.00 S0.368 F4800
+G1 X21.50 S0.567 F4800
+G1 X21.00 S0.754 F4800
+G1 X20.50 S0.902 F4800
+G1 X20.00 S0.986 F4800
+G1 X19.50 S0.993 F4800
+G1 X19.00 S0.923 F4800
+G1 X18.50 S0.786 F4800
+G1 X18.00 S0.603 F4800
+G1 X17.50 S0.405 F4800
+G1 X17.00 S0.221 F4800
+G1 X16.50 S0.081 F4800
+G1 X16.00 S0.008 F4800
+G1 X15.50 S0.012 F4800
+G1 X15.00 S0.093 F4800
+G1 X14.50 S0.239 F4800
+G1 X14.00 S0.426 F4800
+G1 X13.50 S0.624 F4800
+G1 X13.00 S0.803 F4800
+G1 X12.50 S0.934 F4800
+G1 X12.00 S0.996 F4800
+G1 X11.50 S0.981 F4800
+G1 X11.00 S0.889 F4800
+G1 X10.50 S0.736 F4800
+G1 X10.00 S0.546 F4800
+G0 X10.00 Y12.50
+G1 X10.50 S0.828 F4800
+G1 X11.00 S0.949 F4800
+G1 X11.50 S0.999 F4800
+G1 X12.00 S0.970 F4800
+G1 X12.50 S0.867 F4800
+G1 X13.00 S0.706 F4800
+G1 X13.50 S0.512 F4800
+G1 X14.00 S0.317 F4800
+G1 X14.50 S0.150 F4800
+G1 X15.00 S0.039 F4800
+G1 X15.50 S0.000 F4800
+G1 X16.00 S0.040 F4800
+G1 X16.50 S0.153 F4800
+G1 X17.00 S0.321 F4800
+G1 X17.50 S0.517 F4800
+G1 X18.00 S0.710 F4800
+G1 X18.50 S0.870 F4800
+G1 X19.00 S0.972 F4800
+G1 X19.50 S0.999 F4800
+G1 X20.00 S0.947 F4800
+G1 X20.50 S0.825 F4800
+G1 X21.00 S0.652 F4800
+G1 X21.50 S0.454 F4800
+G1 X22.00 S0.264 F4800
+G1 X22.50 S0.111 F4800
+G1 X23.00 S0.019 F4800
+G1 X23.50 S0.004 F4800
+G1 X24.00 S0.066 F4800
+G1 X24.50 S0.198 F4800
+G1 X25.00 S0.377 F4800
+G1 X25.50 S0.575 F4800
+G1 X26.00 S0.762 F4800
+G1 X26.50 S0.907 F4800
+G1 X27.00 S0.988 F4800
+G1 X27.50 S0.992 F4800
+G1 X28.00 S0.918 F4800
+G1 X28.50 S0.779 F4800
+G1 X29.00 S0.595 F4800
+G1 X29.50 S0.396 F4800
+G1 X30.00 S0.214 F4800
+G0 X30.00 Y12.75
+G1 X29.50 S0.994 F4800
+G1 X29.00 S0.985 F4800
+G1 X28.50 S0.899 F4800
+G1 X28.00 S0.751 F4800
+G1 X27.50 S0.562 F4800
+G1 X27.00 S0.364 F4800
+G1 X26.50 S0.187 F4800
+G1 X26.00 S0.060 F4800
+G1 X25.50 S0.002 F4800
+G1 X25.00 S0.023 F4800
+G1 X24.50 S0.119 F4800
+G1 X24.00 S0.275 F4800
+G1 X23.50 S0.467 F4800
+G1 X23.00 S0.664 F4800
+G1 X22.50 S0.835 F4800
+G1 X22.00 S0.953 F4800
+G1 X21.50 S1.000 F4800
+G1 X21.00 S0.967 F4800
+G1 X20.50 S0.861 F4800
+G1 X20.00 S0.698 F4800
+G1 X19.50 S0.504 F4800
+G1 X19.00 S0.309 F4800
+G1 X18.50 S0.144 F4800
+G1 X18.00 S0.035 F4800
+G1 X17.50 S0.000 F4800
+G1 X17.00 S0.044 F4800
+G1 X16.50 S0.159 F4800
+G1 X16.00 S0.329 F4800
+G1 X15.50 S0.525 F4800
+G1 X15.00 S0.718 F4800
+G1 X14.50 S0.876 F4800
+G1 X14.00 S0.975 F4800
+G1 X13.50 S0.998 F4800
+G1 X13.00 S0.944 F4800
+G1 X12.50 S0.819 F4800
+G1 X12.00 S0.644 F4800
+G1 X11.50 S0.446 F4800
+G1 X11.00 S0.256 F4800
+G1 X10.50 S0.106 F4800
+G1 X10.00 S0.017 F4800
+G0 X10.00 Y13.00
+G1 X10.50 S0.927 F4800
+G1 X11.00 S0.792 F4800
+G1 X11.50 S0.611 F4800
+G1 X12.00 S0.413 F4800
+G1 X12.50 S0.228 F4800
+G1 X13.00 S0.086 F4800
+G1 X13.50 S0.010 F4800
+G1 X14.00 S0.010 F4800
+G1 X14.50 S0.089 F4800
+G1 X15.00 S0.232 F4800
+G1 X15.50 S0.417 F4800
+G1 X16.00 S0.616 F4800
+G1 X16.50 S0.796 F4800
+G1 X17.00 S0.930 F4800
+G1 X17.50 S0.995 F4800
+G1 X18.00 S0.983 F4800
+G1 X18.50 S0.894 F4800
+G1 X19.00 S0.743 F4800
+G1 X19.50 S0.554 F4800
+G1 X20.00 S0.356 F4800
+G1 X20.50 S0.181 F4800
+G1 X21.00 S0.056 F4800
+G1 X21.50 S0.002 F4800
+G1 X22.00 S0.026 F4800
+G1 X22.50 S0.125 F4800
+G1 X23.00 S0.283 F4800
+G1 X23.50 S0.475 F4800
+G1 X24.00 S0.672 F4800
+G1 X24.50 S0.841 F4800
+G1 X25.00 S0.956 F4800
+G1 X25.50 S1.000 F4800
+G1 X26.00 S0.964 F4800
+G1 X26.50 S0.856 F4800
+G1 X27.00 S0.691 F4800
+G1 X27.50 S0.496 F4800
+G1 X28.00 S0.301 F4800
+G1 X28.50 S0.138 F4800
+G1 X29.00 S0.032 F4800
+G1 X29.50 S0.000 F4800
+G1 X30.00 S0.047 F4800
+G0 X30.00 Y13.25
+G1 X29.50 S0.660 F4800
+G1 X29.00 S0.462 F4800
+G1 X28.50 S0.271 F4800
+G1 X28.00 S0.116 F4800
+G1 X27.50 S0.022 F4800
+G1 X27.00 S0.003 F4800
+G1 X26.50 S0.062 F4800
+G1 X26.00 S0.191 F4800
+G1 X25.50 S0.368 F4800
+G1 X25.00 S0.567 F4800
+G1 X24.50 S0.754 F4800
+G1 X24.00 S0.902 F4800
+G1 X23.50 S0.986 F4800
+G1 X23.00 S0.993 F4800
+G1 X22.50 S0.923 F4800
+G1 X22.00 S0.786 F4800
+G1 X21.50 S0.603 F4800
+G1 X21.00 S0.405 F4800
+G1 X20.50 S0.221 F4800
+G1 X20.00 S0.081 F4800
+G1 X19.50 S0.008 F4800
+G1 X19.00 S0.012 F4800
+G1 X18.50 S0.093 F4800
+G1 X18.00 S0.239 F4800
+G1 X17.50 S0.426 F4800
+G1 X17.00 S0.624 F4800
+G1 X16.50 S0.803 F4800
+G1 X16.00 S0.934 F4800
+G1 X15.50 S0.996 F4800
+G1 X15.00 S0.981 F4800
+G1 X14.50 S0.889 F4800
+G1 X14.00 S0.736 F4800
+G1 X13.50 S0.546 F4800
+G1 X13.00 S0.348 F4800
+G1 X12.50 S0.175 F4800
+G1 X12.00 S0.052 F4800
+G1 X11.50 S0.001 F4800
+G1 X11.00 S0.028 F4800
+G1 X10.50 S0.130 F4800
+G1 X10.00 S0.290 F4800
+G0 X10.00 Y13.50
+G1 X10.50 S0.317 F4800
+G1 X11.00 S0.150 F4800
+G1 X11.50 S0.039 F4800
+G1 X12.00 S0.000 F4800
+G1 X12.50 S0.040 F4800
+G1 X13.00 S0.153 F4800
+G1 X13.50 S0.321 F4800
+G1 X14.00 S0.517 F4800
+G1 X14.50 S0.710 F4800
+G1 X15.00 S0.870 F4800
+G1 X15.50 S0.972 F4800
+G1 X16.00 S0.999 F4800
+G1 X16.50 S0.947 F4800
+G1 X17.00 S0.825 F4800
+G1 X17.50 S0.652 F4800
+G1 X18.00 S0.454 F4800
+G1 X18.50 S0.264 F4800
+G1 X19.00 S0.111 F4800
+G1 X19.50 S0.019 F4800
+G1 X20.00 S0.004 F4800
+G1 X20.50 S0.066 F4800
+G1 X21.00 S0.198 F4800
+G1 X21.50 S0.377 F4800
+G1 X22.00 S0.575 F4800
+G1 X22.50 S0.762 F4800
+G1 X23.00 S0.907 F4800
+G1 X23.50 S0.988 F4800
+G1 X24.00 S0.992 F4800
+G1 X24.50 S0.918 F4800
+G1 X25.00 S0.779 F4800
+G1 X25.50 S0.595 F4800
+G1 X26.00 S0.396 F4800
+G1 X26.50 S0.214 F4800
+G1 X27.00 S0.077 F4800
+G1 X27.50 S0.007 F4800
+G1 X28.00 S0.014 F4800
+G1 X28.50 S0.098 F4800
+G1 X29.00 S0.246 F4800
+G1 X29.50 S0.434 F4800
+G1 X30.00 S0.632 F4800
+G0 X30.00 Y13.75
+G1 X29.50 S0.060 F4800
+G1 X29.00 S0.002 F4800
+G1 X28.50 S0.023 F4800
+G1 X28.00 S0.119 F4800
+G1 X27.50 S0.275 F4800
+G1 X27.00 S0.467 F4800
+G1 X26.50 S0.664 F4800
+G1 X26.00 S0.835 F4800
+G1 X25.50 S0.953 F4800
+G1 X25.00 S1.000 F4800
+G1 X24.50 S0.967 F4800
+G1 X24.00 S0.861 F4800
+G1 X23.50 S0.698 F4800
+G1 X23.00 S0.504 F4800
+G1 X22.50 S0.309 F4800
+G1 X22.00 S0.144 F4800
+G1 X21.50 S0.035 F4800
+G1 X21.00 S0.000 F4800
+G1 X20.50 S0.044 F4800
+G1 X20.00 S0.159 F4800
+G1 X19.50 S0.329 F4800
+G1 X19.00 S0.525 F4800
+G1 X18.50 S0.718 F4800
+G1 X18.00 S0.876 F4800
+G1 X17.50 S0.975 F4800
+G1 X17.00 S0.998 F4800
+G1 X16.50 S0.944 F4800
+G1 X16.00 S0.819 F4800
+G1 X15.50 S0.644 F4800
+G1 X15.00 S0.446 F4800
+G1 X14.50 S0.256 F4800
+G1 X14.00 S0.106 F4800
+G1 X13.50 S0.017 F4800
+G1 X13.00 S0.005 F4800
+G1 X12.50 S0.071 F4800
+G1 X12.00 S0.204 F4800
+G1 X11.50 S0.385 F4800
+G1 X11.00 S0.583 F4800
+G1 X10.50 S0.769 F4800
+G1 X10.00 S0.912 F4800
+G0 X0 Y0
@@ -0,0 +1,82 @@
+/* Host stand in for the LPC17xx device header, just the parts the motion code touches.
+   The GPIO ports are plain memory, and the interrupt controls do nothing as the simulation is single threaded */
+#ifndef __LPC17xx_H__
+#define __LPC17xx_H__
+
+#include <stdint.h>
+
+#define __I     volatile const
+#define __O     volatile
+#define __IO    volatile
+
+typedef enum IRQn {
+    PendSV_IRQn = -2,
+    TIMER0_IRQn = 1,
+    TIMER1_IRQn = 2,
+    TIMER2_IRQn = 3,
+    UART0_IRQn  = 5,
+    UART1_IRQn  = 6,
+    UART2_IRQn  = 7,
+    UART3_IRQn  = 8,
+    RIT_IRQn    = 29,
+    ADC_IRQn    = 22,
+    USB_IRQn    = 24
+} IRQn_Type;
+
+typedef struct {
+    __IO uint32_t FIODIR;
+    uint32_t RESERVED0[3];
+    __IO uint32_t FIOMASK;
+    __IO uint32_t FIOPIN;
+    __IO uint32_t FIOSET;
+    __O  uint32_t FIOCLR;
+} LPC_GPIO_TypeDef;
+
+extern LPC_GPIO_TypeDef sim_gpio[5];
+#define LPC_GPIO0 (&sim_gpio[0])
+#define LPC_GPIO1 (&sim_gpio[1])
+#define LPC_GPIO2 (&sim_gpio[2])
+#define LPC_GPIO3 (&sim_gpio[3])
+#define LPC_GPIO4 (&sim_gpio[4])
+
+typedef struct {
+    __IO uint32_t WDMOD;
+    __IO uint32_t WDTC;
+    __O  uint32_t WDFEED;
+    __IO uint32_t WDTV;
+    __IO uint32_t WDCLKSEL;
+} LPC_WDT_TypeDef;
+
+extern LPC_WDT_TypeDef sim_wdt;
+#define LPC_WDT (&sim_wdt)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern uint32_t SystemCoreClock;
+
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t) {}
+static inline void __DMB(void) {}
+static inline void __DSB(void) {}
+static inline void __ISB(void) {}
+void __WFI(void);
+
+static inline void NVIC_SetPriorityGrouping(uint32_t) {}
+static inline void NVIC_SetPriority(IRQn_Type, uint32_t) {}
+static inline uint32_t NVIC_GetPriority(IRQn_Type) { return 0; }
+static inline void NVIC_EnableIRQ(IRQn_Type) {}
+static inline void NVIC_DisableIRQ(IRQn_Type) {}
+static inline void NVIC_SetPendingIRQ(IRQn_Type) {}
+static inline void NVIC_ClearPendingIRQ(IRQn_Type) {}
+static inline uint32_t NVIC_GetPendingIRQ(IRQn_Type) { return 0; }
+void NVIC_SystemReset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
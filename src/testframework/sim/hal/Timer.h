@@ -0,0 +1,29 @@
+#ifndef MBED_TIMER_H
+#define MBED_TIMER_H
+
+#include "us_ticker_api.h"
+
+namespace mbed {
+
+class Timer {
+public:
+    Timer() : _start(0), _time(0), _running(false) {}
+    void start() { _start= us_ticker_read(); _running= true; }
+    void stop() { _time += slicetime(); _running= false; }
+    void reset() { _start= us_ticker_read(); _time= 0; }
+    int read_us() { return _time + slicetime(); }
+    int read_ms() { return read_us() / 1000; }
+    float read() { return read_us() / 1000000.0F; }
+
+private:
+    int slicetime() { return _running ? us_ticker_read() - _start : 0; }
+    uint32_t _start;
+    int _time;
+    bool _running;
+};
+
+}
+
+using namespace mbed;
+
+#endif
@@ -0,0 +1,2 @@
+/* newlib header, the host math library has the same functions */
+#include <math.h>
@@ -0,0 +1,2 @@
+/* Pin.h includes the smoothed device header by path, it is the same host stand in */
+#include "LPC17xx.h"
@@ -0,0 +1,11 @@
+/* Host stand in for the mbed library, the simulation only uses its timing calls */
+#ifndef MBED_H
+#define MBED_H
+
+#include "LPC17xx.h"
+#include "PinNames.h"
+#include "us_ticker_api.h"
+#include "wait_api.h"
+#include "Timer.h"
+
+#endif
@@ -0,0 +1,13 @@
+/* Host stand in for the debug monitor, a break into the debugger stops the simulation */
+#ifndef _MRI_H_
+#define _MRI_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MRI_ENABLE 0
+
+#define __debugbreak()  { fprintf(stderr, "__debugbreak() at %s:%d\n", __FILE__, __LINE__); abort(); }
+
+#endif
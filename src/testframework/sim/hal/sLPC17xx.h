@@ -0,0 +1,2 @@
+/* RingBuffer.h and others include the smoothed device header by name, it is the same host stand in */
+#include "LPC17xx.h"
@@ -0,0 +1 @@
+#include "LPC17xx.h"
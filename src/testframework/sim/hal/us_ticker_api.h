@@ -0,0 +1,17 @@
+#ifndef US_TICKER_API_H
+#define US_TICKER_API_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// microseconds of host time
+uint32_t us_ticker_read(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef WAIT_API_H
+#define WAIT_API_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// nothing in the simulation has to wait for hardware, these return at once
+void wait(float s);
+void wait_ms(int ms);
+void wait_us(int us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,85 @@
+#include "ConfigCache.h"
+#include "ConfigValue.h"
+#include "checksumm.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "easyunit/test.h"
+
+static void make_checksums(int i, uint16_t cs[3])
+{
+    cs[0]= 1000 - i * 7;
+    cs[1]= i % 3;
+    cs[2]= i;
+}
+
+TEST(ConfigCacheTest,indexed_lookup)
+{
+    ConfigCache cache;
+    ConfigValue *v[50];
+    uint16_t cs[3];
+    for (int i = 0; i < 50; ++i) {
+        make_checksums(i, cs);
+        v[i]= new ConfigValue(cs);
+        cache.add(v[i]);
+    }
+
+    uint16_t missing[3]{1, 2, 3};
+
+    // same answers from the linear scan and from the index
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < 50; ++i) {
+            make_checksums(i, cs);
+            ASSERT_TRUE(cache.lookup(cs) == v[i]);
+        }
+        ASSERT_TRUE(cache.lookup(missing) == nullptr);
+        cache.build_index();
+    }
+
+    // the index follows replaced and added values
+    make_checksums(5, cs);
+    ConfigValue *r= new ConfigValue(cs);
+    cache.replace_or_push_back(r);
+    ASSERT_TRUE(cache.lookup(cs) == r);
+
+    ConfigValue *n= new ConfigValue(missing);
+    cache.add(n);
+    ASSERT_TRUE(cache.lookup(missing) == n);
+    make_checksums(49, cs);
+    ASSERT_TRUE(cache.lookup(cs) == v[49]);
+}
+
+TEST(ConfigCacheTest,interned_values)
+{
+    ConfigCache cache;
+    const char *p[100];
+    char buf[16];
+    // enough values to fill several blocks, each keeps its own copy
+    for (int i = 0; i < 100; ++i) {
+        snprintf(buf, sizeof(buf), "value%d", i);
+        p[i]= cache.intern(buf, strlen(buf));
+    }
+    for (int i = 0; i < 100; ++i) {
+        snprintf(buf, sizeof(buf), "value%d", i);
+        ASSERT_TRUE(strcmp(p[i], buf) == 0);
+    }
+    ASSERT_TRUE(cache.saved_bytes() > 0);
+}
+
+TEST(ConfigCacheTest,family_filter)
+{
+    ConfigCache cache;
+    uint16_t a[3]{100, 1, 2};
+    uint16_t b[3]{200, 1, 2};
+    uint16_t inc[3]{CHECKSUM("include"), 0, 0};
+    ASSERT_TRUE(cache.wants(a));
+    ASSERT_TRUE(cache.wants(b));
+
+    // a family reload keeps its own values and the includes they could be in
+    cache.set_family(100);
+    ASSERT_TRUE(cache.wants(a));
+    ASSERT_TRUE(!cache.wants(b));
+    ASSERT_TRUE(cache.wants(inc));
+}
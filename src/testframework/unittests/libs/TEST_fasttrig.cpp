@@ -0,0 +1,71 @@
+#include "FastTrig.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "us_ticker_api.h"
+#include "system_LPC17xx.h"
+
+#include "easyunit/test.h"
+
+// the largest difference from libm over points all around the circle, and angles over a few turns
+static void max_errors(const FastTrig &t, float &e_atan2, float &e_atan, float &e_sincos)
+{
+    e_atan2= e_atan= e_sincos= 0.0F;
+    for (int i = -50; i <= 50; ++i) {
+        for (int j = -50; j <= 50; ++j) {
+            if(i == 0 && j == 0) continue;
+            float y= i * 3.7F, x= j * 2.9F;
+            e_atan2= fmaxf(e_atan2, fabsf(t.atan2(y, x) - atan2f(y, x)));
+        }
+    }
+    for (int i = -2000; i <= 2000; ++i) {
+        float a= i * 0.01F;
+        e_atan= fmaxf(e_atan, fabsf(t.atan(a * 5.0F) - atanf(a * 5.0F)));
+        float s, c;
+        t.sincos(a, s, c);
+        e_sincos= fmaxf(e_sincos, fmaxf(fabsf(s - sinf(a)), fabsf(c - cosf(a))));
+    }
+}
+
+TEST(FastTrigTest,matches_libm)
+{
+    float e_atan2, e_atan, e_sincos;
+    max_errors(FastTrig(FastTrig::HIGH), e_atan2, e_atan, e_sincos);
+    printf("FastTrig high: atan2 %g atan %g sincos %g\n", e_atan2, e_atan, e_sincos);
+    ASSERT_TRUE(e_atan2 < 6e-7F && e_atan < 6e-7F && e_sincos < 6e-7F);
+
+    max_errors(FastTrig(FastTrig::LOW), e_atan2, e_atan, e_sincos);
+    printf("FastTrig low: atan2 %g atan %g sincos %g\n", e_atan2, e_atan, e_sincos);
+    ASSERT_TRUE(e_atan2 < 4e-5F && e_atan < 4e-5F && e_sincos < 4e-5F);
+
+    max_errors(FastTrig(FastTrig::EXACT), e_atan2, e_atan, e_sincos);
+    ASSERT_TRUE(e_atan2 == 0.0F && e_atan == 0.0F && e_sincos == 0.0F);
+
+    // the special cases atan2f has
+    FastTrig t;
+    ASSERT_TRUE(t.atan2(0.0F, 0.0F) == 0.0F);
+    ASSERT_TRUE(fabsf(t.atan2(1.0F, 0.0F) - 1.57079632679F) < 1e-6F);
+    ASSERT_TRUE(fabsf(t.atan2(0.0F, -1.0F) - 3.14159265359F) < 1e-6F);
+    ASSERT_TRUE(FastTrig::precision_from_string("exact") == FastTrig::EXACT && FastTrig::precision_from_string("Low") == FastTrig::LOW);
+}
+
+TEST(FastTrigTest,cycles)
+{
+    const int n= 1000;
+    FastTrig t(FastTrig::HIGH);
+    volatile float sink= 0.0F;
+
+    uint32_t start= us_ticker_read();
+    for (int i = 0; i < n; ++i) sink= sink + atan2f(i * 0.37F - 150.0F, 100.0F - i * 0.21F);
+    uint32_t libm_us= us_ticker_read() - start;
+
+    start= us_ticker_read();
+    for (int i = 0; i < n; ++i) sink= sink + t.atan2(i * 0.37F - 150.0F, 100.0F - i * 0.21F);
+    uint32_t fast_us= us_ticker_read() - start;
+
+    uint32_t mhz= SystemCoreClock / 1000000;
+    printf("atan2: libm %lu cycles, FastTrig %lu cycles\n", libm_us * mhz / n, fast_us * mhz / n);
+    ASSERT_TRUE(fast_us < libm_us);
+}
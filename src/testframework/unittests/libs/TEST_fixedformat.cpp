@@ -0,0 +1,59 @@
+#include "FixedFormat.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "us_ticker_api.h"
+#include "system_LPC17xx.h"
+
+#include "easyunit/test.h"
+
+TEST(FixedFormatTest,matches_printf)
+{
+    char buf[32];
+    char expect[32];
+    static const float values[]{0, 1.5F, -2.25F, 123.4567F, -0.25F, 999.99995F, 1234.5F, 0.00049F};
+    for(float v : values) {
+        FixedFormat f(buf, sizeof(buf));
+        f.fixed(v, 3, 9);
+        snprintf(expect, sizeof(expect), "%9.3f", v);
+        ASSERT_TRUE(strcmp(buf, expect) == 0);
+    }
+
+    FixedFormat f(buf, sizeof(buf));
+    f.integer(-42, 4).chr(',').integer(7);
+    ASSERT_TRUE(strcmp(buf, " -42,7") == 0);
+
+    // cut off but still terminated
+    char small[8];
+    FixedFormat s(small, sizeof(small));
+    s.str("MPos:").fixed(12.5F);
+    ASSERT_TRUE(s.length() == 7 && strcmp(small, "MPos:12") == 0);
+}
+
+TEST(FixedFormatTest,status_report_cycles)
+{
+    const float mpos[3]{123.4567F, -45.25F, 10.125F};
+    const float wpos[3]{23.4567F, -5.25F, 0.125F};
+    const int n= 1000;
+    char buf[128];
+
+    uint32_t start= us_ticker_read();
+    for (int i = 0; i < n; ++i) {
+        snprintf(buf, sizeof(buf), "<Idle,MPos:%1.4f,%1.4f,%1.4f,WPos:%1.4f,%1.4f,%1.4f>\r\n", mpos[0], mpos[1], mpos[2], wpos[0], wpos[1], wpos[2]);
+    }
+    uint32_t printf_us= us_ticker_read() - start;
+
+    start= us_ticker_read();
+    for (int i = 0; i < n; ++i) {
+        FixedFormat f(buf, sizeof(buf));
+        f.str("<Idle,MPos:").fixed(mpos[0]).chr(',').fixed(mpos[1]).chr(',').fixed(mpos[2]);
+        f.str(",WPos:").fixed(wpos[0]).chr(',').fixed(wpos[1]).chr(',').fixed(wpos[2]).str(">\r\n");
+    }
+    uint32_t fixed_us= us_ticker_read() - start;
+
+    uint32_t mhz= SystemCoreClock / 1000000;
+    printf("Status report: snprintf %lu cycles, FixedFormat %lu cycles\n", printf_us * mhz / n, fixed_us * mhz / n);
+    ASSERT_TRUE(fixed_us < printf_us);
+}
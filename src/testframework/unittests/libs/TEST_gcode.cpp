@@ -1,11 +1,14 @@
 #include "utils.h"
 
 #include "Gcode.h"
+#include "CommandPool.h"
 
 #include <vector>
 #include <stdio.h>
 #include <string.h>
 
+#include "us_ticker_api.h"
+
 #include "easyunit/test.h"
 
 TEST(GCodeTest,subcode)
@@ -60,3 +63,131 @@ TEST(GCodeTest,subcode)
     ASSERT_EQUALS_DELTA_V(2.3, gc4.get_value('Y'), 0.001);
 
 }
+
+TEST(GCodeTest,words_table)
+{
+    Gcode gc("G1 X10.5 Y-2 Z0.3 E1.25 F3000", nullptr);
+    ASSERT_EQUALS_V(5, gc.get_num_args());
+    ASSERT_TRUE(!gc.has_letter('I'));
+    ASSERT_EQUALS_DELTA_V(10.5, gc.get_value('X'), 0.0001);
+    ASSERT_EQUALS_DELTA_V(-2, gc.get_value('Y'), 0.0001);
+    ASSERT_EQUALS_DELTA_V(0.3, gc.get_value('Z'), 0.0001);
+    ASSERT_EQUALS_DELTA_V(1.25, gc.get_value('E'), 0.0001);
+    ASSERT_EQUALS_V(3000, gc.get_int('F'));
+
+    // an exponent must give the same integer as strtol would
+    Gcode gc2("G4 P1E3", nullptr);
+    ASSERT_EQUALS_V(1, gc2.get_int('P'));
+
+    // letters without a number read as 0
+    Gcode gc3("G28 X Y", nullptr);
+    ASSERT_TRUE(gc3.has_letter('X'));
+    ASSERT_EQUALS_DELTA_V(0, gc3.get_value('X'), 0.0001);
+
+    // stripped parameters are no longer visible
+    Gcode gc4("G1 X1 Y2 E3", nullptr);
+    gc4.strip_parameters();
+    ASSERT_TRUE(!gc4.has_letter('X'));
+    ASSERT_TRUE(gc4.has_letter('E'));
+    ASSERT_EQUALS_DELTA_V(3, gc4.get_value('E'), 0.0001);
+}
+
+TEST(GCodeTest,packed)
+{
+    // G1 X10.5 Y-3.25 S0.8 F6000 as made by smoothie-pack.py
+    const char *line= "\x01" "AQAENwQpOE7zMiADZXAX+5Y\n";
+    Gcode *gc= Gcode::decode_packed(line, nullptr);
+    ASSERT_TRUE(gc != nullptr);
+    ASSERT_TRUE(gc->has_g);
+    ASSERT_TRUE(!gc->has_m);
+    ASSERT_EQUALS_V(1, gc->g);
+    ASSERT_EQUALS_V(4, gc->get_num_args());
+    ASSERT_EQUALS_DELTA_V(10.5, gc->get_value('X'), 0.0001);
+    ASSERT_EQUALS_DELTA_V(-3.25, gc->get_value('Y'), 0.0001);
+    ASSERT_EQUALS_DELTA_V(0.8, gc->get_value('S'), 0.0001);
+    ASSERT_EQUALS_V(6000, gc->get_int('F'));
+
+    gc->strip_parameters();
+    ASSERT_TRUE(!gc->has_letter('X'));
+    ASSERT_TRUE(!gc->has_letter('Y'));
+    ASSERT_EQUALS_DELTA_V(0.8, gc->get_value('S'), 0.0001);
+    ASSERT_EQUALS_V(6000, gc->get_int('F'));
+    delete gc;
+
+    // corrupt it
+    ASSERT_TRUE(Gcode::decode_packed("\x01" "AQAEMwQpOE7zMiADZXAX+5Y\n", nullptr) == nullptr);
+}
+
+TEST(GCodeTest,command_pool)
+{
+    ASSERT_TRUE(CommandPool::resize(2));
+    {
+        Gcode gc1("G1 X1 Y2", nullptr);
+        Gcode gc2(gc1);
+        ASSERT_EQUALS_V(2, CommandPool::get_used());
+
+        // no slabs left and too long for one, both go on the heap
+        Gcode gc3("G1 X3", nullptr);
+        string line("M117 ");
+        line.append(CommandPool::slab_size, 'x');
+        Gcode gc4(line, nullptr);
+        ASSERT_EQUALS_V(2, CommandPool::get_fallbacks());
+        ASSERT_EQUALS_DELTA_V(2.0, gc2.get_value('Y'), 0.0001);
+        ASSERT_EQUALS_V(CommandPool::slab_size + 1, strlen(gc4.get_command()));
+    }
+    ASSERT_EQUALS_V(0, CommandPool::get_used());
+    ASSERT_EQUALS_V(2, CommandPool::get_peak());
+    ASSERT_TRUE(CommandPool::resize(0));
+}
+
+TEST(GCodeTest,parse_throughput)
+{
+    static const char *lines[] = {
+        "G1 X123.456 Y78.9 E0.0345",
+        "G1 X124.1 Y80.25 Z0.3 E0.0412 F1800",
+        "G0 X10 Y10 F6000",
+        "G2 X20.5 Y15.25 I5.0 J-2.5 E1.02",
+        "M104 S210",
+    };
+    const int n= 1000;
+    const int nlines= sizeof(lines) / sizeof(lines[0]);
+
+    uint32_t start= us_ticker_read();
+    float sum= 0;
+    for (int i = 0; i < n; ++i) {
+        Gcode gc(lines[i % nlines], nullptr);
+        // query letters the way Robot, Extruder etc do
+        if(gc.has_letter('X')) sum += gc.get_value('X');
+        if(gc.has_letter('Y')) sum += gc.get_value('Y');
+        if(gc.has_letter('Z')) sum += gc.get_value('Z');
+        if(gc.has_letter('E')) sum += gc.get_value('E');
+        if(gc.has_letter('F')) sum += gc.get_value('F');
+    }
+    uint32_t elapsed= us_ticker_read() - start;
+    if(elapsed == 0) elapsed= 1;
+
+    printf("Gcode parse: %d lines in %lu us, %lu lines/sec\n", n, elapsed, (uint32_t)(n * 1000000ULL / elapsed));
+    ASSERT_TRUE(sum > 0);
+}
+
+TEST(GCodeTest,set_value)
+{
+    // the X of a subprogram line whose value comes from the call
+    Gcode gc("G1 X Y10.5 F1200", nullptr);
+    ASSERT_TRUE(gc.has_letter('X'));
+    ASSERT_EQUALS_DELTA_V(0.0F, gc.get_value('X'), 0.0001F);
+
+    ASSERT_TRUE(gc.set_value('X', 2.5F));
+    ASSERT_EQUALS_DELTA_V(2.5F, gc.get_value('X'), 0.0001F);
+    ASSERT_EQUALS_DELTA_V(10.5F, gc.get_value('Y'), 0.0001F);
+    ASSERT_EQUALS_DELTA_V(1200.0F, gc.get_value('F'), 0.0001F);
+    ASSERT_EQUALS_V(2, gc.get_int('X'));
+
+    // a letter it did not have, or one it had with a value
+    ASSERT_TRUE(gc.set_value('Z', -1.0F));
+    ASSERT_TRUE(gc.has_letter('Z'));
+    ASSERT_EQUALS_DELTA_V(-1.0F, gc.get_value('Z'), 0.0001F);
+    ASSERT_TRUE(gc.set_value('Y', 3.0F));
+    ASSERT_EQUALS_DELTA_V(3.0F, gc.get_value('Y'), 0.0001F);
+    ASSERT_EQUALS_DELTA_V(2.5F, gc.get_value('X'), 0.0001F);
+}
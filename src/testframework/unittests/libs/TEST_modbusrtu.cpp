@@ -0,0 +1,55 @@
+#include "ModbusRTU.h"
+
+#include "easyunit/test.h"
+
+TEST(ModbusRTUTest,crc)
+{
+    // read 2 registers from 0x0000 of slave 1, the example everyone quotes
+    uint8_t req[6]{0x01, 0x03, 0x00, 0x00, 0x00, 0x02};
+    ASSERT_EQUALS_V(0x0BC4, ModbusRTU::crc16(req, 6));
+
+    uint8_t frame[8];
+    ASSERT_EQUALS_V(8, (int)ModbusRTU::build_request(frame, 1, ModbusRTU::read_holding_registers, 0x0000, 2));
+    ASSERT_EQUALS_V(0xC4, frame[6]);
+    ASSERT_EQUALS_V(0x0B, frame[7]);
+}
+
+TEST(ModbusRTUTest,parse_read)
+{
+    uint8_t reply[7]{0x01, 0x03, 0x02, 0x12, 0x34, 0, 0};
+    uint16_t crc= ModbusRTU::crc16(reply, 5);
+    reply[5]= crc & 0xFF;
+    reply[6]= crc >> 8;
+
+    uint16_t value= 0;
+    // more to come until all of it is there
+    for (int n = 0; n < 7; ++n) {
+        ASSERT_EQUALS_V(0, ModbusRTU::parse_reply(reply, n, 1, ModbusRTU::read_holding_registers, value));
+    }
+    ASSERT_EQUALS_V(1, ModbusRTU::parse_reply(reply, 7, 1, ModbusRTU::read_holding_registers, value));
+    ASSERT_EQUALS_V(0x1234, value);
+
+    // some other slave, or a bad CRC
+    ASSERT_EQUALS_V(-1, ModbusRTU::parse_reply(reply, 7, 2, ModbusRTU::read_holding_registers, value));
+    reply[4]^= 1;
+    ASSERT_EQUALS_V(-1, ModbusRTU::parse_reply(reply, 7, 1, ModbusRTU::read_holding_registers, value));
+}
+
+TEST(ModbusRTUTest,parse_write)
+{
+    // a write is answered with the echo of the request
+    uint8_t frame[8];
+    ModbusRTU::build_request(frame, 1, ModbusRTU::write_single_register, 0x2001, 40000);
+    uint16_t value= 0;
+    ASSERT_EQUALS_V(0, ModbusRTU::parse_reply(frame, 7, 1, ModbusRTU::write_single_register, value));
+    ASSERT_EQUALS_V(1, ModbusRTU::parse_reply(frame, 8, 1, ModbusRTU::write_single_register, value));
+    ASSERT_EQUALS_V(40000, value);
+
+    // an exception is 5 bytes
+    uint8_t ex[5]{0x01, 0x86, 0x02, 0, 0};
+    uint16_t crc= ModbusRTU::crc16(ex, 3);
+    ex[3]= crc & 0xFF;
+    ex[4]= crc >> 8;
+    ASSERT_EQUALS_V(0, ModbusRTU::parse_reply(ex, 4, 1, ModbusRTU::write_single_register, value));
+    ASSERT_EQUALS_V(-1, ModbusRTU::parse_reply(ex, 5, 1, ModbusRTU::write_single_register, value));
+}
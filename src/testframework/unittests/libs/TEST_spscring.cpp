@@ -0,0 +1,44 @@
+#include "SpscRing.h"
+
+#include "easyunit/test.h"
+
+TEST(SpscRingTest,push_pop)
+{
+    SpscRing<int, 8> ring;
+    ASSERT_TRUE(ring.empty());
+    ASSERT_EQUALS_V(8, (int)ring.capacity());
+
+    // all the slots can be used
+    for (int i = 0; i < 8; ++i) {
+        ASSERT_TRUE(ring.push(i));
+    }
+    ASSERT_TRUE(ring.full());
+    ASSERT_TRUE(!ring.push(8));
+    ASSERT_EQUALS_V(3, ring[3]);
+
+    int v;
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_TRUE(ring.pop(v));
+        ASSERT_EQUALS_V(i, v);
+    }
+    ASSERT_EQUALS_V(3, (int)ring.size());
+    ASSERT_EQUALS_V(5, (int)ring.free());
+
+    // bulk push wraps around the end of the buffer and stops when full
+    int in[6]{10, 11, 12, 13, 14, 15};
+    ASSERT_EQUALS_V(5, (int)ring.push(in, 6));
+    ASSERT_EQUALS_V(10, ring[3]);
+
+    int out[10];
+    ASSERT_EQUALS_V(8, (int)ring.pop(out, 10));
+    ASSERT_EQUALS_V(5, out[0]);
+    ASSERT_EQUALS_V(14, out[7]);
+    ASSERT_TRUE(!ring.pop(v));
+
+    ring.push(1);
+    ring.push(2);
+    ring.drop();
+    ASSERT_EQUALS_V(2, ring[0]);
+    ring.clear();
+    ASSERT_TRUE(ring.empty());
+}
@@ -1,4 +1,5 @@
 #include "utils.h"
+#include "checksumm.h"
 
 #include <vector>
 #include <stdio.h>
@@ -45,3 +46,35 @@ TEST(UtilsTest,append_parameters)
     ASSERT_TRUE(n == 24);
     ASSERT_TRUE(strcmp(buf, "X1.0000 Y2.0000 Z3.0000 ") == 0);
 }
+
+TEST(UtilsTest,get_checksums)
+{
+    uint16_t cs[3];
+    const char *key= "temperature_control.hotend.enable  true";
+    uint16_t family= CHECKSUM("temperature_control"), name= CHECKSUM("hotend"), setting= CHECKSUM("enable");
+    ASSERT_EQUALS_V(3, get_checksums(cs, key, 33));
+    ASSERT_EQUALS_V(family, cs[0]);
+    ASSERT_EQUALS_V(name, cs[1]);
+    ASSERT_EQUALS_V(setting, cs[2]);
+
+    ASSERT_EQUALS_V(1, get_checksums(cs, "alpha_steps_per_mm", 18));
+    ASSERT_EQUALS_V(get_checksum("alpha_steps_per_mm"), cs[0]);
+    ASSERT_EQUALS_V(0, cs[1]);
+}
+
+TEST(UtilsTest,shift_parameter_view)
+{
+    const char *line= "get  temp hotend";
+    ParameterView cmd= shift_parameter(line);
+    ASSERT_TRUE(cmd == "get");
+    ASSERT_TRUE(cmd != "ge");
+    ASSERT_TRUE(cmd != "gets");
+    ASSERT_TRUE(strcmp(line, "temp hotend") == 0);
+
+    ParameterView what= shift_parameter(line);
+    ASSERT_TRUE(what == "temp");
+    ASSERT_TRUE(what.checksum() == get_checksum("temp"));
+    ASSERT_TRUE(shift_parameter(line).str() == "hotend");
+    ASSERT_TRUE(shift_parameter(line).empty());
+    ASSERT_TRUE(*line == '\0');
+}
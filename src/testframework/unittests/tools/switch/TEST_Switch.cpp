@@ -48,6 +48,7 @@ switch.fan.input_on_command M106 \n\
 switch.fan.input_off_command M107 \n\
 switch.fan.output_pin 2.6  \n\
 switch.fan.output_type digital  \n\
+switch.fan.sync none  \n\
 ";
 
 static bool get_switch_state(Switch *ts, struct pad_switch& s)
@@ -88,3 +89,21 @@ TESTF(Switch,set_on_off_with_gcode)
     ASSERT_TRUE(get_switch_state(ts, s));
     ASSERT_TRUE(!s.state);
 }
+
+TESTF(Switch,set_on_off_when_executed)
+{
+    // a gcode attached to the queue is acted on when its block begins
+    test_kernel_setup_config(switch_config, &switch_config[sizeof(switch_config)]);
+    ts->on_config_reload(nullptr);
+
+    struct pad_switch s;
+    Gcode gc1("M106", (StreamOutput *)THEKERNEL->serial);
+    ts->on_gcode_execute(&gc1);
+    ASSERT_TRUE(get_switch_state(ts, s));
+    ASSERT_TRUE(s.state);
+
+    Gcode gc2("M107", (StreamOutput *)THEKERNEL->serial);
+    ts->on_gcode_execute(&gc2);
+    ASSERT_TRUE(get_switch_state(ts, s));
+    ASSERT_TRUE(!s.state);
+}